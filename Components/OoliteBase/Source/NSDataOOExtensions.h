@@ -43,4 +43,21 @@ SOFTWARE.
 
 + (id) oo_dataWithContentsOfFile:(NSString *)path options:(NSUInteger)readOptionsMask error:(NSError **)errorPtr;
 
+/*	oo_dataWithSequentialMappingOfURL:error:
+	
+	Returns an NSData whose bytes are a read-only memory mapping of the file,
+	advised for sequential access (MADV_SEQUENTIAL). Pages are read in ahead of
+	a front-to-back scan and may be dropped behind it, so a parser working
+	directly on -bytes doesn’t hold a second full copy of the file in memory.
+	Unlike NSDataReadingMapped, this maps on every platform with mmap(), and
+	never falls back to copying on Mac OS X. On platforms without mmap(), the
+	file is read normally.
+	
+	As with any mapping, the file must not be truncated while the data object
+	exists.
+*/
++ (id) oo_dataWithSequentialMappingOfURL:(NSURL *)url error:(NSError **)errorPtr;
+
++ (id) oo_dataWithSequentialMappingOfFile:(NSString *)path error:(NSError **)errorPtr;
+
 @end
@@ -29,6 +29,34 @@ SOFTWARE.
 #import "MYCollectionUtilities.h"
 #import "OOBaseErrors.h"
 
+#if !OOLITE_WINDOWS
+#define OO_HAVE_MMAP		1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#define OO_HAVE_MMAP		0
+#endif
+
+
+#if OO_HAVE_MMAP
+@interface OOSequentialMappedData: NSData
+{
+@private
+	void					*_bytes;
+	size_t					_length;
+}
+
+- (id) initWithPath:(NSString *)path error:(NSError **)errorPtr;
+
+@end
+
+
+static NSError *MappingError(NSString *path, int err);
+#endif
+
 
 @implementation NSData (OOExtensions)
 
@@ -77,4 +105,130 @@ SOFTWARE.
 #endif
 }
 
+
++ (id) oo_dataWithSequentialMappingOfURL:(NSURL *)url error:(NSError **)errorPtr
+{
+	if ([url isFileURL])
+	{
+		return [self oo_dataWithSequentialMappingOfFile:[url path] error:errorPtr];
+	}
+	else
+	{
+		if (errorPtr != NULL)
+		{
+			*errorPtr = [NSError errorWithDomain:kOoliteBaseErrorDomain code:kOOBaseNonFileURLError userInfo:$dict(NSLocalizedFailureReasonErrorKey, $sprintf(@"Could not read from non-file URL %@", [url absoluteString]))];
+		}
+		return nil;
+	}
+}
+
+
++ (id) oo_dataWithSequentialMappingOfFile:(NSString *)path error:(NSError **)errorPtr
+{
+#if OO_HAVE_MMAP
+	return [[[OOSequentialMappedData alloc] initWithPath:path error:errorPtr] autorelease];
+#else
+	return [self oo_dataWithContentsOfFile:path options:0 error:errorPtr];
+#endif
+}
+
 @end
+
+
+#if OO_HAVE_MMAP
+@implementation OOSequentialMappedData
+
+- (id) initWithPath:(NSString *)path error:(NSError **)errorPtr
+{
+	int					fd;
+	struct stat			info;
+	void				*bytes = NULL;
+	int					err = 0;
+	
+	fd = open([path fileSystemRepresentation], O_RDONLY);
+	if (fd == -1)
+	{
+		err = errno;
+	}
+	else
+	{
+		if (fstat(fd, &info) == -1)  err = errno;
+		else if (info.st_size > 0)
+		{
+			if ((uint64_t)info.st_size > SIZE_MAX)  err = EFBIG;
+			else
+			{
+				bytes = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (bytes == MAP_FAILED)
+				{
+					bytes = NULL;
+					err = errno;
+				}
+			}
+		}
+		// The mapping keeps its own reference to the file.
+		close(fd);
+	}
+	
+	if (err != 0)
+	{
+		if (errorPtr != NULL)  *errorPtr = MappingError(path, err);
+		[self release];
+		return nil;
+	}
+	
+	if ((self = [super init]))
+	{
+		_bytes = bytes;
+		_length = (bytes != NULL) ? (size_t)info.st_size : 0;
+		
+#ifdef MADV_SEQUENTIAL
+		if (_bytes != NULL)  madvise(_bytes, _length, MADV_SEQUENTIAL);
+#endif
+	}
+	else if (bytes != NULL)
+	{
+		munmap(bytes, (size_t)info.st_size);
+	}
+	
+	return self;
+}
+
+
+/*	GNUstep’s -[NSData init] calls this, and NSData’s version is abstract.
+	Only the empty case can occur here; the mapping is set up afterwards.
+*/
+- (id) initWithBytesNoCopy:(void *)bytes length:(NSUInteger)length freeWhenDone:(BOOL)freeWhenDone
+{
+	NSParameterAssert(bytes == NULL && length == 0);
+	return self;
+}
+
+
+- (void) dealloc
+{
+	if (_bytes != NULL)  munmap(_bytes, _length);
+	
+	[super dealloc];
+}
+
+
+- (const void *) bytes
+{
+	return _bytes;
+}
+
+
+- (NSUInteger) length
+{
+	return _length;
+}
+
+@end
+
+
+static NSError *MappingError(NSString *path, int err)
+{
+	return [NSError errorWithDomain:kOoliteBaseErrorDomain code:kOOBaseReadError userInfo:$dict(NSLocalizedFailureReasonErrorKey, $sprintf(@"Could not read file %@ (%s)", path, strerror(err)))];
+}
+#endif
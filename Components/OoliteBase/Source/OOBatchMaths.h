@@ -0,0 +1,82 @@
+/*
+
+OOBatchMaths.h
+
+Operations on arrays of vectors, for loops that would otherwise call the
+scalar vector, matrix and quaternion functions once per element.
+
+Each operation gives the same results as the scalar function it's named
+after, up to floating-point rounding. Kernels are selected at run time from
+the features reported by OOCPUGetFeatures(): AVX2 or SSE2 on x86, NEON on
+64-bit ARM, and plain C elsewhere.
+
+Input and output arrays may be the same, but must not otherwise overlap.
+
+
+Oolite
+Copyright © 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+
+#ifndef INCLUDED_OOMATHS_h
+	#error Do not include OOBatchMaths.h directly; include OOMaths.h.
+#else
+
+
+typedef enum
+{
+	kOOBatchMathsScalar,
+	kOOBatchMathsSSE2,
+	kOOBatchMathsAVX2,
+	kOOBatchMathsNEON,
+
+	kOOBatchMathsImplementationCount
+} OOBatchMathsImplementation;
+
+
+/* out[i] = OOVectorMultiplyMatrix(in[i], m) */
+void OOBatchVectorMultiplyMatrix(const Vector *in, Vector *out, NSUInteger count, OOMatrix m);
+
+/* out[i] = quaternion_rotate_vector(q, in[i]) */
+void OOBatchQuaternionRotateVectors(const Vector *in, Vector *out, NSUInteger count, Quaternion q);
+
+/* out[i] = distance2(in[i], point) */
+void OOBatchDistance2(const Vector *in, OOScalar *out, NSUInteger count, Vector point);
+
+/*	Smallest box containing the points, or kOOZeroBoundingBox if count is 0. */
+OOBoundingBox OOBatchBoundingBox(const Vector *points, NSUInteger count);
+
+/*	Bounding box of OOVectorMultiplyMatrix(points[i], m), without storing the
+	transformed points. kOOZeroBoundingBox if count is 0.
+*/
+OOBoundingBox OOBatchBoundingBoxOfTransformedVectors(const Vector *points, NSUInteger count, OOMatrix m);
+
+
+/*	Kernel selection. The best available implementation is chosen the first
+	time a batch function is called. Setting an implementation which isn't
+	available (or built in) does nothing and returns NO. Intended for
+	benchmarking and testing; not thread-safe with respect to batch calls.
+*/
+OOBatchMathsImplementation OOBatchMathsGetImplementation(void);
+BOOL OOBatchMathsSetImplementation(OOBatchMathsImplementation implementation);
+BOOL OOBatchMathsImplementationAvailable(OOBatchMathsImplementation implementation);
+OOBatchMathsImplementation OOBatchMathsBestImplementation(void);
+const char *OOBatchMathsImplementationName(OOBatchMathsImplementation implementation);
+
+#endif	/* INCLUDED_OOMATHS_h */
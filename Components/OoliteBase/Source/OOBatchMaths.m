@@ -0,0 +1,524 @@
+/*
+
+OOBatchMaths.m
+
+
+Oolite
+Copyright © 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOMaths.h"
+#import "OOCPUInfo.h"
+
+
+/*	x86 kernels are compiled with per-function target attributes, so they're
+	available whatever -march the file is built with, and only run if
+	OOCPUGetFeatures() says so.
+*/
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define OO_BATCH_MATHS_X86		1
+#include <immintrin.h>
+#else
+#define OO_BATCH_MATHS_X86		0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define OO_BATCH_MATHS_NEON		1
+#include <arm_neon.h>
+#else
+#define OO_BATCH_MATHS_NEON		0
+#endif
+
+
+typedef struct
+{
+	void (*multiplyMatrix)(const Vector *in, Vector *out, NSUInteger count, const OOMatrix *m);
+	void (*rotateVectors)(const Vector *in, Vector *out, NSUInteger count, const Quaternion *q);
+	void (*distance2)(const Vector *in, OOScalar *out, NSUInteger count, const Vector *point);
+	void (*boundingBox)(const Vector *in, NSUInteger count, const OOMatrix *m, OOBoundingBox *outBox);
+} OOBatchMathsKernels;
+
+
+static const OOBatchMathsKernels *sKernels = NULL;
+static OOBatchMathsImplementation sImplementation = kOOBatchMathsScalar;
+
+
+static const OOBatchMathsKernels *KernelsForImplementation(OOBatchMathsImplementation implementation);
+static void SelectKernels(void);
+
+
+OOINLINE const OOBatchMathsKernels *Kernels(void)
+{
+	if (EXPECT_NOT(sKernels == NULL))  SelectKernels();
+	return sKernels;
+}
+
+
+void OOBatchVectorMultiplyMatrix(const Vector *in, Vector *out, NSUInteger count, OOMatrix m)
+{
+	Kernels()->multiplyMatrix(in, out, count, &m);
+}
+
+
+void OOBatchQuaternionRotateVectors(const Vector *in, Vector *out, NSUInteger count, Quaternion q)
+{
+	Kernels()->rotateVectors(in, out, count, &q);
+}
+
+
+void OOBatchDistance2(const Vector *in, OOScalar *out, NSUInteger count, Vector point)
+{
+	Kernels()->distance2(in, out, count, &point);
+}
+
+
+OOBoundingBox OOBatchBoundingBox(const Vector *points, NSUInteger count)
+{
+	OOBoundingBox result = kOOZeroBoundingBox;
+	if (count != 0)  Kernels()->boundingBox(points, count, NULL, &result);
+	return result;
+}
+
+
+OOBoundingBox OOBatchBoundingBoxOfTransformedVectors(const Vector *points, NSUInteger count, OOMatrix m)
+{
+	OOBoundingBox result = kOOZeroBoundingBox;
+	if (count != 0)  Kernels()->boundingBox(points, count, &m, &result);
+	return result;
+}
+
+
+OOBatchMathsImplementation OOBatchMathsGetImplementation(void)
+{
+	Kernels();
+	return sImplementation;
+}
+
+
+BOOL OOBatchMathsSetImplementation(OOBatchMathsImplementation implementation)
+{
+	if (!OOBatchMathsImplementationAvailable(implementation))  return NO;
+
+	sKernels = KernelsForImplementation(implementation);
+	sImplementation = implementation;
+	return YES;
+}
+
+
+BOOL OOBatchMathsImplementationAvailable(OOBatchMathsImplementation implementation)
+{
+	if (KernelsForImplementation(implementation) == NULL)  return NO;
+
+	OOCPUFeatures features = OOCPUGetFeatures();
+	switch (implementation)
+	{
+		case kOOBatchMathsScalar:
+			return YES;
+
+		case kOOBatchMathsSSE2:
+			return (features & kOOCPUFeatureSSE2) != 0;
+
+		case kOOBatchMathsAVX2:
+			return (features & kOOCPUFeatureAVX2) != 0;
+
+		case kOOBatchMathsNEON:
+			return (features & kOOCPUFeatureNEON) != 0;
+
+		case kOOBatchMathsImplementationCount:
+			break;
+	}
+
+	return NO;
+}
+
+
+OOBatchMathsImplementation OOBatchMathsBestImplementation(void)
+{
+	if (OOBatchMathsImplementationAvailable(kOOBatchMathsAVX2))  return kOOBatchMathsAVX2;
+	if (OOBatchMathsImplementationAvailable(kOOBatchMathsSSE2))  return kOOBatchMathsSSE2;
+	if (OOBatchMathsImplementationAvailable(kOOBatchMathsNEON))  return kOOBatchMathsNEON;
+	return kOOBatchMathsScalar;
+}
+
+
+const char *OOBatchMathsImplementationName(OOBatchMathsImplementation implementation)
+{
+	switch (implementation)
+	{
+		case kOOBatchMathsScalar:
+			return "scalar";
+
+		case kOOBatchMathsSSE2:
+			return "SSE2";
+
+		case kOOBatchMathsAVX2:
+			return "AVX2";
+
+		case kOOBatchMathsNEON:
+			return "NEON";
+
+		case kOOBatchMathsImplementationCount:
+			break;
+	}
+
+	return "unknown";
+}
+
+
+static void SelectKernels(void)
+{
+	OOBatchMathsImplementation best = OOBatchMathsBestImplementation();
+
+	sImplementation = best;
+	sKernels = KernelsForImplementation(best);
+}
+
+
+/*** Scalar kernels ***/
+
+static void ScalarMultiplyMatrix(const Vector *in, Vector *out, NSUInteger count, const OOMatrix *m)
+{
+	NSUInteger i;
+	for (i = 0; i < count; i++)  out[i] = OOVectorMultiplyMatrix(in[i], *m);
+}
+
+
+static void ScalarRotateVectors(const Vector *in, Vector *out, NSUInteger count, const Quaternion *q)
+{
+	NSUInteger i;
+	for (i = 0; i < count; i++)  out[i] = quaternion_rotate_vector(*q, in[i]);
+}
+
+
+static void ScalarDistance2(const Vector *in, OOScalar *out, NSUInteger count, const Vector *point)
+{
+	NSUInteger i;
+	for (i = 0; i < count; i++)  out[i] = distance2(in[i], *point);
+}
+
+
+static void ScalarBoundingBox(const Vector *in, NSUInteger count, const OOMatrix *m, OOBoundingBox *outBox)
+{
+	NSUInteger i;
+
+	if (m != NULL)
+	{
+		OOBoundingBoxResetToVector(outBox, OOVectorMultiplyMatrix(in[0], *m));
+		for (i = 1; i < count; i++)  OOBoundingBoxAddVector(outBox, OOVectorMultiplyMatrix(in[i], *m));
+	}
+	else
+	{
+		OOBoundingBoxResetToVector(outBox, in[0]);
+		for (i = 1; i < count; i++)  OOBoundingBoxAddVector(outBox, in[i]);
+	}
+}
+
+
+static const OOBatchMathsKernels kScalarKernels =
+{
+	ScalarMultiplyMatrix,
+	ScalarRotateVectors,
+	ScalarDistance2,
+	ScalarBoundingBox
+};
+
+
+#if OO_BATCH_MATHS_X86
+
+/*** SSE2 kernels ***/
+
+#define SSE2_FUNC __attribute__((target("sse2")))
+
+/*	Four packed Vectors are three registers:
+		a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+*/
+SSE2_FUNC OOINLINE void SSE2LoadVectors(const Vector *p, __m128 *x, __m128 *y, __m128 *z)
+{
+	const float *f = (const float *)p;
+	__m128 a = _mm_loadu_ps(f), b = _mm_loadu_ps(f + 4), c = _mm_loadu_ps(f + 8);
+
+	__m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));		// x2 x2 x3 x3
+	*x = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0));
+
+	__m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));		// y0 y0 y1 y1
+	bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));				// y2 y2 y3 y3
+	*y = _mm_shuffle_ps(ab, bc, _MM_SHUFFLE(2, 0, 2, 0));
+
+	ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));				// z0 z0 z1 z1
+	*z = _mm_shuffle_ps(ab, c, _MM_SHUFFLE(3, 0, 2, 0));
+}
+
+
+SSE2_FUNC OOINLINE void SSE2StoreVectors(Vector *p, __m128 x, __m128 y, __m128 z)
+{
+	float *f = (float *)p;
+	__m128 xyLo = _mm_unpacklo_ps(x, y);							// x0 y0 x1 y1
+	__m128 xyHi = _mm_unpackhi_ps(x, y);							// x2 y2 x3 y3
+
+	__m128 t = _mm_shuffle_ps(z, xyLo, _MM_SHUFFLE(2, 2, 0, 0));	// z0 z0 x1 x1
+	_mm_storeu_ps(f, _mm_shuffle_ps(xyLo, t, _MM_SHUFFLE(2, 0, 1, 0)));
+
+	t = _mm_shuffle_ps(xyLo, z, _MM_SHUFFLE(1, 1, 3, 3));			// y1 y1 z1 z1
+	_mm_storeu_ps(f + 4, _mm_shuffle_ps(t, xyHi, _MM_SHUFFLE(1, 0, 2, 0)));
+
+	t = _mm_shuffle_ps(z, xyHi, _MM_SHUFFLE(2, 2, 2, 2));			// z2 z2 x3 x3
+	__m128 u = _mm_shuffle_ps(xyHi, z, _MM_SHUFFLE(3, 3, 3, 3));	// y3 y3 z3 z3
+	_mm_storeu_ps(f + 8, _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+
+SSE2_FUNC OOINLINE float SSE2HorizontalMin(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+
+SSE2_FUNC OOINLINE float SSE2HorizontalMax(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtss_f32(v);
+}
+
+
+#define KERNEL(name)				SSE2##name
+#define KERNEL_FUNC					SSE2_FUNC
+#define VEC							__m128
+#define WIDTH						4
+#define VSPLAT(f)					_mm_set1_ps(f)
+#define VADD						_mm_add_ps
+#define VSUB						_mm_sub_ps
+#define VMUL						_mm_mul_ps
+#define VDIV						_mm_div_ps
+#define VMIN						_mm_min_ps
+#define VMAX						_mm_max_ps
+#define LOAD_VECTORS(p, x, y, z)	SSE2LoadVectors((p), &(x), &(y), &(z))
+#define STORE_VECTORS(p, x, y, z)	SSE2StoreVectors((p), (x), (y), (z))
+#define VSTORE(p, v)				_mm_storeu_ps((p), (v))
+#define HMIN(v)						SSE2HorizontalMin(v)
+#define HMAX(v)						SSE2HorizontalMax(v)
+
+#include "OOBatchMathsKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VSPLAT
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VMIN
+#undef VMAX
+#undef LOAD_VECTORS
+#undef STORE_VECTORS
+#undef VSTORE
+#undef HMIN
+#undef HMAX
+
+
+static const OOBatchMathsKernels kSSE2Kernels =
+{
+	SSE2MultiplyMatrix,
+	SSE2RotateVectors,
+	SSE2Distance2,
+	SSE2BoundingBox
+};
+
+
+/*** AVX2 kernels ***/
+
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+// Eight Vectors are loaded as two groups of four, using the SSE2 transposition for each half.
+AVX2_FUNC OOINLINE void AVX2LoadVectors(const Vector *p, __m256 *x, __m256 *y, __m256 *z)
+{
+	__m128 x0, y0, z0, x1, y1, z1;
+	SSE2LoadVectors(p, &x0, &y0, &z0);
+	SSE2LoadVectors(p + 4, &x1, &y1, &z1);
+	*x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+	*y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+	*z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+}
+
+
+AVX2_FUNC OOINLINE void AVX2StoreVectors(Vector *p, __m256 x, __m256 y, __m256 z)
+{
+	SSE2StoreVectors(p, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z));
+	SSE2StoreVectors(p + 4, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(z, 1));
+}
+
+
+AVX2_FUNC OOINLINE float AVX2HorizontalMin(__m256 v)
+{
+	return SSE2HorizontalMin(_mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+
+AVX2_FUNC OOINLINE float AVX2HorizontalMax(__m256 v)
+{
+	return SSE2HorizontalMax(_mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+
+#define KERNEL(name)				AVX2##name
+#define KERNEL_FUNC					AVX2_FUNC
+#define VEC							__m256
+#define WIDTH						8
+#define VSPLAT(f)					_mm256_set1_ps(f)
+#define VADD						_mm256_add_ps
+#define VSUB						_mm256_sub_ps
+#define VMUL						_mm256_mul_ps
+#define VDIV						_mm256_div_ps
+#define VMIN						_mm256_min_ps
+#define VMAX						_mm256_max_ps
+#define LOAD_VECTORS(p, x, y, z)	AVX2LoadVectors((p), &(x), &(y), &(z))
+#define STORE_VECTORS(p, x, y, z)	AVX2StoreVectors((p), (x), (y), (z))
+#define VSTORE(p, v)				_mm256_storeu_ps((p), (v))
+#define HMIN(v)						AVX2HorizontalMin(v)
+#define HMAX(v)						AVX2HorizontalMax(v)
+
+#include "OOBatchMathsKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VSPLAT
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VMIN
+#undef VMAX
+#undef LOAD_VECTORS
+#undef STORE_VECTORS
+#undef VSTORE
+#undef HMIN
+#undef HMAX
+
+
+static const OOBatchMathsKernels kAVX2Kernels =
+{
+	AVX2MultiplyMatrix,
+	AVX2RotateVectors,
+	AVX2Distance2,
+	AVX2BoundingBox
+};
+
+#endif	// OO_BATCH_MATHS_X86
+
+
+#if OO_BATCH_MATHS_NEON
+
+/*** NEON kernels ***/
+
+OOINLINE void NEONLoadVectors(const Vector *p, float32x4_t *x, float32x4_t *y, float32x4_t *z)
+{
+	float32x4x3_t v = vld3q_f32((const float *)p);
+	*x = v.val[0];
+	*y = v.val[1];
+	*z = v.val[2];
+}
+
+
+OOINLINE void NEONStoreVectors(Vector *p, float32x4_t x, float32x4_t y, float32x4_t z)
+{
+	float32x4x3_t v = {{ x, y, z }};
+	vst3q_f32((float *)p, v);
+}
+
+
+#define KERNEL(name)				NEON##name
+#define KERNEL_FUNC
+#define VEC							float32x4_t
+#define WIDTH						4
+#define VSPLAT(f)					vdupq_n_f32(f)
+#define VADD						vaddq_f32
+#define VSUB						vsubq_f32
+#define VMUL						vmulq_f32
+#define VDIV						vdivq_f32
+#define VMIN						vminq_f32
+#define VMAX						vmaxq_f32
+#define LOAD_VECTORS(p, x, y, z)	NEONLoadVectors((p), &(x), &(y), &(z))
+#define STORE_VECTORS(p, x, y, z)	NEONStoreVectors((p), (x), (y), (z))
+#define VSTORE(p, v)				vst1q_f32((p), (v))
+#define HMIN(v)						vminvq_f32(v)
+#define HMAX(v)						vmaxvq_f32(v)
+
+#include "OOBatchMathsKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VSPLAT
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VMIN
+#undef VMAX
+#undef LOAD_VECTORS
+#undef STORE_VECTORS
+#undef VSTORE
+#undef HMIN
+#undef HMAX
+
+
+static const OOBatchMathsKernels kNEONKernels =
+{
+	NEONMultiplyMatrix,
+	NEONRotateVectors,
+	NEONDistance2,
+	NEONBoundingBox
+};
+
+#endif	// OO_BATCH_MATHS_NEON
+
+
+static const OOBatchMathsKernels *KernelsForImplementation(OOBatchMathsImplementation implementation)
+{
+	switch (implementation)
+	{
+		case kOOBatchMathsScalar:
+			return &kScalarKernels;
+
+#if OO_BATCH_MATHS_X86
+		case kOOBatchMathsSSE2:
+			return &kSSE2Kernels;
+
+		case kOOBatchMathsAVX2:
+			return &kAVX2Kernels;
+#endif
+
+#if OO_BATCH_MATHS_NEON
+		case kOOBatchMathsNEON:
+			return &kNEONKernels;
+#endif
+
+		default:
+			break;
+	}
+
+	return NULL;
+}
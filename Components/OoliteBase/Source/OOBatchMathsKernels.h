@@ -0,0 +1,171 @@
+/*
+
+OOBatchMathsKernels.h
+
+SIMD kernel bodies for OOBatchMaths.m, which includes this file once for
+each instruction set after defining:
+	KERNEL(name)			Function name for this instruction set.
+	KERNEL_FUNC				Function attributes (target selection).
+	VEC						Vector register type.
+	WIDTH					Number of floats in a VEC.
+	VSPLAT(f)				VEC with every lane set to f.
+	VADD, VSUB, VMUL, VDIV, VMIN, VMAX
+	LOAD_VECTORS(p, x, y, z)	Load WIDTH Vectors from p and transpose them into x, y and z.
+	STORE_VECTORS(p, x, y, z)	The reverse.
+	VSTORE(p, v)			Store WIDTH floats, unaligned.
+	HMIN(v), HMAX(v)		Smallest and largest lane.
+
+The arithmetic is done in the same order as in the scalar functions, so that
+without fused multiply-add the results are identical.
+
+
+Oolite
+Copyright © 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+
+#define MATRIX_TRANSFORM(x, y, z, rx, ry, rz) \
+do { \
+	VEC w_ = VADD(VADD(VADD(VMUL(m03, x), VMUL(m13, y)), VMUL(m23, z)), m33); \
+	w_ = VDIV(one, w_); \
+	rx = VMUL(VADD(VADD(VADD(VMUL(m00, x), VMUL(m10, y)), VMUL(m20, z)), m30), w_); \
+	ry = VMUL(VADD(VADD(VADD(VMUL(m01, x), VMUL(m11, y)), VMUL(m21, z)), m31), w_); \
+	rz = VMUL(VADD(VADD(VADD(VMUL(m02, x), VMUL(m12, y)), VMUL(m22, z)), m32), w_); \
+} while (0)
+
+#define MATRIX_SPLAT(m) \
+	const VEC one = VSPLAT(1.0f); \
+	const VEC m00 = VSPLAT((m)->m[0][0]), m01 = VSPLAT((m)->m[0][1]), m02 = VSPLAT((m)->m[0][2]), m03 = VSPLAT((m)->m[0][3]); \
+	const VEC m10 = VSPLAT((m)->m[1][0]), m11 = VSPLAT((m)->m[1][1]), m12 = VSPLAT((m)->m[1][2]), m13 = VSPLAT((m)->m[1][3]); \
+	const VEC m20 = VSPLAT((m)->m[2][0]), m21 = VSPLAT((m)->m[2][1]), m22 = VSPLAT((m)->m[2][2]), m23 = VSPLAT((m)->m[2][3]); \
+	const VEC m30 = VSPLAT((m)->m[3][0]), m31 = VSPLAT((m)->m[3][1]), m32 = VSPLAT((m)->m[3][2]), m33 = VSPLAT((m)->m[3][3])
+
+
+KERNEL_FUNC static void KERNEL(MultiplyMatrix)(const Vector *in, Vector *out, NSUInteger count, const OOMatrix *m)
+{
+	NSUInteger			i = 0;
+	VEC					x, y, z, rx, ry, rz;
+	MATRIX_SPLAT(m);
+
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		LOAD_VECTORS(in + i, x, y, z);
+		MATRIX_TRANSFORM(x, y, z, rx, ry, rz);
+		STORE_VECTORS(out + i, rx, ry, rz);
+	}
+
+	for (; i < count; i++)  out[i] = OOVectorMultiplyMatrix(in[i], *m);
+}
+
+
+KERNEL_FUNC static void KERNEL(RotateVectors)(const Vector *in, Vector *out, NSUInteger count, const Quaternion *q)
+{
+	NSUInteger			i = 0;
+	VEC					x, y, z;
+	const VEC			zero = VSPLAT(0.0f);
+	const VEC			qx = VSPLAT(q->x), qy = VSPLAT(q->y), qz = VSPLAT(q->z);
+	const VEC			nqw = VSPLAT(-q->w), nqx = VSPLAT(-q->x), nqy = VSPLAT(-q->y), nqz = VSPLAT(-q->z);
+
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		LOAD_VECTORS(in + i, x, y, z);
+
+		VEC vw = VSUB(VSUB(VSUB(zero, VMUL(qx, x)), VMUL(qy, y)), VMUL(qz, z));
+		VEC vx = VSUB(VADD(VMUL(nqw, x), VMUL(qy, z)), VMUL(qz, y));
+		VEC vy = VSUB(VADD(VMUL(nqw, y), VMUL(qz, x)), VMUL(qx, z));
+		VEC vz = VSUB(VADD(VMUL(nqw, z), VMUL(qx, y)), VMUL(qy, x));
+
+		x = VSUB(VADD(VADD(VMUL(vw, nqx), VMUL(vx, nqw)), VMUL(vy, nqz)), VMUL(vz, nqy));
+		y = VSUB(VADD(VADD(VMUL(vw, nqy), VMUL(vy, nqw)), VMUL(vz, nqx)), VMUL(vx, nqz));
+		z = VSUB(VADD(VADD(VMUL(vw, nqz), VMUL(vz, nqw)), VMUL(vx, nqy)), VMUL(vy, nqx));
+
+		STORE_VECTORS(out + i, x, y, z);
+	}
+
+	for (; i < count; i++)  out[i] = quaternion_rotate_vector(*q, in[i]);
+}
+
+
+KERNEL_FUNC static void KERNEL(Distance2)(const Vector *in, OOScalar *out, NSUInteger count, const Vector *point)
+{
+	NSUInteger			i = 0;
+	VEC					x, y, z;
+	const VEC			px = VSPLAT(point->x), py = VSPLAT(point->y), pz = VSPLAT(point->z);
+
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		LOAD_VECTORS(in + i, x, y, z);
+		x = VSUB(x, px);
+		y = VSUB(y, py);
+		z = VSUB(z, pz);
+		VSTORE(out + i, VADD(VADD(VMUL(x, x), VMUL(y, y)), VMUL(z, z)));
+	}
+
+	for (; i < count; i++)  out[i] = distance2(in[i], *point);
+}
+
+
+/*	count must be at least 1. If m is not NULL, the box is of the transformed
+	points.
+*/
+KERNEL_FUNC static void KERNEL(BoundingBox)(const Vector *in, NSUInteger count, const OOMatrix *m, OOBoundingBox *outBox)
+{
+	NSUInteger			i = 0;
+	VEC					x, y, z;
+	Vector				first = (m != NULL) ? OOVectorMultiplyMatrix(in[0], *m) : in[0];
+	VEC					minX = VSPLAT(first.x), minY = VSPLAT(first.y), minZ = VSPLAT(first.z);
+	VEC					maxX = minX, maxY = minY, maxZ = minZ;
+
+	if (m != NULL)
+	{
+		VEC rx, ry, rz;
+		MATRIX_SPLAT(m);
+
+		for (; i + WIDTH <= count; i += WIDTH)
+		{
+			LOAD_VECTORS(in + i, x, y, z);
+			MATRIX_TRANSFORM(x, y, z, rx, ry, rz);
+			minX = VMIN(minX, rx);  maxX = VMAX(maxX, rx);
+			minY = VMIN(minY, ry);  maxY = VMAX(maxY, ry);
+			minZ = VMIN(minZ, rz);  maxZ = VMAX(maxZ, rz);
+		}
+	}
+	else
+	{
+		for (; i + WIDTH <= count; i += WIDTH)
+		{
+			LOAD_VECTORS(in + i, x, y, z);
+			minX = VMIN(minX, x);  maxX = VMAX(maxX, x);
+			minY = VMIN(minY, y);  maxY = VMAX(maxY, y);
+			minZ = VMIN(minZ, z);  maxZ = VMAX(maxZ, z);
+		}
+	}
+
+	outBox->min = make_vector(HMIN(minX), HMIN(minY), HMIN(minZ));
+	outBox->max = make_vector(HMAX(maxX), HMAX(maxY), HMAX(maxZ));
+
+	for (; i < count; i++)
+	{
+		OOBoundingBoxAddVector(outBox, (m != NULL) ? OOVectorMultiplyMatrix(in[i], *m) : in[i]);
+	}
+}
+
+
+#undef MATRIX_TRANSFORM
+#undef MATRIX_SPLAT
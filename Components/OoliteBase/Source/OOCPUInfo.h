@@ -37,6 +37,22 @@ void OOCPUInfoInit(void);
 NSUInteger OOCPUCount(void);
 
 
+/*	SIMD instruction sets which can be used by this process, as determined at
+	run time. SSE2 and AVX2 are only reported on x86 and x86-64, and only if
+	the OS saves the relevant registers. NEON is reported on 64-bit ARM, where
+	it's always available. Used by OOBatchMaths to select its kernels.
+*/
+enum
+{
+	kOOCPUFeatureSSE2			= 0x00000001,
+	kOOCPUFeatureAVX2			= 0x00000002,
+	kOOCPUFeatureNEON			= 0x00000004
+};
+typedef uint32_t OOCPUFeatures;
+
+OOCPUFeatures OOCPUGetFeatures(void);
+
+
 /*	Set up OOLITE_BIG_ENDIAN and OOLITE_LITTLE_ENDIAN macros. Exactly one must
 	be non-zero. If you're porting Oolite to a middle-endian platform, you'll
 	need to work out what to do with endian-sensitive stuff -- currently, that
@@ -30,6 +30,13 @@ MA 02110-1301, USA.
 #import <sys/sysctl.h>
 #endif
 
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#define OO_CPUID_AVAILABLE		1
+#include <cpuid.h>
+#else
+#define OO_CPUID_AVAILABLE		0
+#endif
+
 
 #if 0
 // Confirm settings
@@ -51,6 +58,10 @@ static BOOL				sInited = NO;
 
 
 static NSUInteger		sNumberOfCPUs = 0;	// Yes, really 0.
+static OOCPUFeatures	sFeatures = 0;
+
+
+static OOCPUFeatures DetectFeatures(void);
 
 
 void OOCPUInfoInit(void)
@@ -103,6 +114,8 @@ void OOCPUInfoInit(void)
 	#warning Do not know how to find number of CPUs on this architecture.
 #endif	// OS selection
 	
+	sFeatures = DetectFeatures();
+	
 	sInited = YES;
 }
 
@@ -112,3 +125,50 @@ NSUInteger OOCPUCount(void)
 	if (!sInited)  OOCPUInfoInit();
 	return (sNumberOfCPUs != 0) ? sNumberOfCPUs : 1;
 }
+
+
+OOCPUFeatures OOCPUGetFeatures(void)
+{
+	if (!sInited)  OOCPUInfoInit();
+	return sFeatures;
+}
+
+
+static OOCPUFeatures DetectFeatures(void)
+{
+	OOCPUFeatures		features = 0;
+	
+#if OO_CPUID_AVAILABLE
+	unsigned			eax, ebx, ecx, edx, maxLeaf;
+	
+	maxLeaf = __get_cpuid_max(0, NULL);
+	if (maxLeaf >= 1 && __get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	{
+		if (edx & (1 << 26))  features |= kOOCPUFeatureSSE2;
+		
+		// AVX state has to be enabled by the OS (OSXSAVE, then XCR0 bits 1 and 2) as well as supported by the CPU.
+		BOOL osSavesAVX = NO;
+		if ((ecx & (1 << 27)) && (ecx & (1 << 28)))
+		{
+			unsigned xcr0Low, xcr0High;
+			__asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));	// xgetbv
+			osSavesAVX = (xcr0Low & 0x6) == 0x6;
+		}
+		
+		if (osSavesAVX && maxLeaf >= 7)
+		{
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			if (ebx & (1 << 5))  features |= kOOCPUFeatureAVX2;
+		}
+	}
+#elif defined(__aarch64__)
+	features |= kOOCPUFeatureNEON;
+#endif
+	
+	OOLog(@"cpuInfo.features", @"CPU SIMD features:%s%s%s",
+		  (features & kOOCPUFeatureSSE2) ? " SSE2" : "",
+		  (features & kOOCPUFeatureAVX2) ? " AVX2" : "",
+		  (features & kOOCPUFeatureNEON) ? " NEON" : "");
+	
+	return features;
+}
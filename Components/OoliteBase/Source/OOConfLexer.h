@@ -95,6 +95,14 @@ typedef enum OOConfTokenType
 - (BOOL) getKeywordOrString:(NSString **)outString;
 - (BOOL) getToken:(OOConfTokenType)type;
 
+/*	Raw bytes of the current token, valid until the lexer advances. For string
+	tokens, the range excludes the quotes and escape sequences are not
+	decoded; -currentTokenHasEscapes indicates whether -currentTokenString
+	would differ from the raw bytes.
+*/
+- (BOOL) getTokenBytes:(const uint8_t **)outBytes length:(size_t *)outLength;
+- (BOOL) currentTokenHasEscapes;
+
 // "Consume" methods advance to the next token, and in some cases further.
 
 - (BOOL) consumeToken:(OOConfTokenType)type;
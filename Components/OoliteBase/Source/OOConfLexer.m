@@ -27,6 +27,7 @@
 #import "OOFunctionAttributes.h"
 #import "OOProblemReporting.h"
 #import "MYCollectionUtilities.h"
+#import "NSDataOOExtensions.h"
 
 
 @interface OOConfLexer (Private)
@@ -42,11 +43,16 @@
 {
 	if ([inURL isFileURL])
 	{
+		/*	Lex directly over a mapping of the file rather than reading it
+			into a buffer first, so large files (especially .oomesh) aren’t
+			held in memory twice while the parsed form is being built.
+		*/
 		NSError *error = nil;
-		NSData *fileData = [[NSData alloc] initWithContentsOfURL:inURL options:0 error:&error];
+		NSData *fileData = [NSData oo_dataWithSequentialMappingOfURL:inURL error:&error];
 		if (fileData == nil)
 		{
-			OOReportError(issues, @"The document could not be loaded, because an error occurred: %@", [error localizedDescription]);
+			OOReportError(issues, @"The document could not be loaded, because an error occurred: %@", [error localizedFailureReason] ?: [error localizedDescription]);
+			[self release];
 			return nil;
 		}
 		return [self initWithData:fileData issues:issues];
@@ -305,6 +311,36 @@
 }
 
 
+- (BOOL) getTokenBytes:(const uint8_t **)outBytes length:(size_t *)outLength
+{
+	NSParameterAssert(outBytes != NULL && outLength != NULL);
+	
+	switch (_state.tokenType)
+	{
+		case kOOConfTokenString:
+		case kOOConfTokenStringWithEscapes:
+			*outBytes = _state.cursor + 1;
+			*outLength = _state.tokenLength - 2;
+			return YES;
+			
+		case kOOConfTokenEOF:
+		case kOOConfTokenInvalid:
+			return NO;
+			
+		default:
+			*outBytes = _state.cursor;
+			*outLength = _state.tokenLength;
+			return YES;
+	}
+}
+
+
+- (BOOL) currentTokenHasEscapes
+{
+	return _state.tokenType == kOOConfTokenStringWithEscapes;
+}
+
+
 - (BOOL) consumeToken:(OOConfTokenType)type
 {
 	return [self advance] && _state.tokenType == type;
@@ -45,6 +45,10 @@ typedef BOOL (*ParseActionIMP)(id self, SEL _cmd, OOConfParserActionEventType ev
 - (BOOL) priv_parseDictionaryWithAction:(SEL)action result:(id *)result;
 - (BOOL) priv_parseArrayWithAction:(SEL)action result:(id *)result;
 
+- (BOOL) priv_streamValueWithHandler:(OOConfStreamHandler)handler context:(void *)context depth:(unsigned)depth;
+- (BOOL) priv_streamDictionaryWithHandler:(OOConfStreamHandler)handler context:(void *)context depth:(unsigned)depth;
+- (BOOL) priv_streamArrayWithHandler:(OOConfStreamHandler)handler context:(void *)context depth:(unsigned)depth;
+
 - (void) priv_reportParseError:(NSString *)format, ...;
 - (void) priv_reportBasicParseError:(NSString *)string;
 
@@ -55,6 +59,10 @@ typedef BOOL (*ParseActionIMP)(id self, SEL _cmd, OOConfParserActionEventType ev
 #define DO_NOTHING_SEL		@selector(priv_nullParseEvent:key:object:)
 
 
+static BOOL SetStreamEventText(OOConfStreamEvent *event, OOConfLexer *lexer);
+OOINLINE BOOL TokenIs(OOConfStreamEvent *event, const char *keyword);
+
+
 @implementation NSObject (OOConfParsing)
 
 + (id) objectFromOOConfString:(NSString *)ooConfString error:(NSError **)outError
@@ -92,7 +100,7 @@ typedef BOOL (*ParseActionIMP)(id self, SEL _cmd, OOConfParserActionEventType ev
 
 + (id) objectWithContentsOfOOConfURL:(NSURL *)url error:(NSError **)outError
 {
-	NSData *data = [NSData oo_dataWithContentsOfURL:url options:NSDataReadingMapped error:outError];
+	NSData *data = [NSData oo_dataWithSequentialMappingOfURL:url error:outError];
 	if (data != nil)  return [self objectFromOOConfData:data error:outError];
 	else  return nil;
 }
@@ -133,7 +141,7 @@ typedef BOOL (*ParseActionIMP)(id self, SEL _cmd, OOConfParserActionEventType ev
 + (id) objectWithContentsOfOOConfURL:(NSURL *)url problemReporter:(id<OOProblemReporting>)problemReporter
 {
 	NSError *error = nil;
-	NSData *data = [NSData oo_dataWithContentsOfURL:url options:NSDataReadingMapped error:&error];
+	NSData *data = [NSData oo_dataWithSequentialMappingOfURL:url error:&error];
 	if (data != nil)  return [self objectFromOOConfData:data problemReporter:problemReporter];
 	else
 	{
@@ -290,6 +298,151 @@ typedef BOOL (*ParseActionIMP)(id self, SEL _cmd, OOConfParserActionEventType ev
 }
 
 
+- (BOOL) parseWithStreamHandler:(OOConfStreamHandler)handler context:(void *)context
+{
+	NSParameterAssert(handler != NULL);
+	
+	return [self priv_streamValueWithHandler:handler context:context depth:0];
+}
+
+
+- (BOOL) priv_streamValueWithHandler:(OOConfStreamHandler)handler context:(void *)context depth:(unsigned)depth
+{
+	OOConfStreamEvent event = { .depth = depth, .lexer = _lexer };
+	
+	switch ([_lexer currentTokenType])
+	{
+		case kOOConfTokenString:
+			event.type = kOOConfStreamString;
+			SetStreamEventText(&event, _lexer);
+			return handler(&event, context);
+			
+		case kOOConfTokenNatural:
+			event.type = kOOConfStreamNatural;
+			if (![_lexer getNatural:&event.value.natural])  break;
+			return handler(&event, context);
+			
+		case kOOConfTokenReal:
+			event.type = kOOConfStreamReal;
+			if (![_lexer getDouble:&event.value.real])  break;
+			return handler(&event, context);
+			
+		case kOOConfTokenOpenBrace:
+			return [self priv_streamDictionaryWithHandler:handler context:context depth:depth];
+			
+		case kOOConfTokenOpenBracket:
+			return [self priv_streamArrayWithHandler:handler context:context depth:depth];
+			
+		case kOOConfTokenKeyword:
+			SetStreamEventText(&event, _lexer);
+			if (TokenIs(&event, "true"))  event.type = kOOConfStreamTrue;
+			else if (TokenIs(&event, "false"))  event.type = kOOConfStreamFalse;
+			else if (TokenIs(&event, "null"))  event.type = kOOConfStreamNull;
+			else  break;
+			return handler(&event, context);
+			
+		default:
+			break;
+	}
+	
+	[self priv_reportBasicParseError:@"value"];
+	return NO;
+}
+
+
+- (BOOL) priv_streamDictionaryWithHandler:(OOConfStreamHandler)handler context:(void *)context depth:(unsigned)depth
+{
+	OOConfStreamEvent event = { .type = kOOConfStreamDictionaryBegin, .depth = depth, .lexer = _lexer };
+	if (!handler(&event, context))  return NO;
+	
+	[_lexer advance];
+	BOOL stop = [_lexer currentTokenType] == kOOConfTokenCloseBrace;
+	
+	while (!stop)
+	{
+		// We should be at a key.
+		OOConfTokenType token = [_lexer currentTokenType];
+		if (token != kOOConfTokenString && (token != kOOConfTokenKeyword || _strictJSON))
+		{
+			[self priv_reportBasicParseError:@"key"];
+			return NO;
+		}
+		
+		event.type = kOOConfStreamKey;
+		event.depth = depth + 1;
+		SetStreamEventText(&event, _lexer);
+		if (!handler(&event, context))  return NO;
+		
+		// Skip the colon.
+		if (![_lexer consumeToken:kOOConfTokenColon])
+		{
+			[self priv_reportBasicParseError:@"\":\""];
+			return NO;
+		}
+		[_lexer advance];
+		
+		if (![self priv_streamValueWithHandler:handler context:context depth:depth + 1])  return NO;
+		
+		// We now expect a comma or closing brace.
+		[_lexer advance];
+		token = [_lexer currentTokenType];
+		if (token == kOOConfTokenComma)
+		{
+			[_lexer advance];
+		}
+		else if (token == kOOConfTokenCloseBrace)
+		{
+			stop = YES;
+		}
+		else
+		{
+			[self priv_reportBasicParseError:@"\",\" or \"}\""];
+			return NO;
+		}
+	}
+	
+	event.type = kOOConfStreamDictionaryEnd;
+	event.depth = depth;
+	return handler(&event, context);
+}
+
+
+- (BOOL) priv_streamArrayWithHandler:(OOConfStreamHandler)handler context:(void *)context depth:(unsigned)depth
+{
+	OOConfStreamEvent event = { .type = kOOConfStreamArrayBegin, .depth = depth, .lexer = _lexer };
+	if (!handler(&event, context))  return NO;
+	
+	[_lexer advance];
+	BOOL stop = [_lexer currentTokenType] == kOOConfTokenCloseBracket;
+	
+	while (!stop)
+	{
+		if (![self priv_streamValueWithHandler:handler context:context depth:depth + 1])  return NO;
+		
+		// We now expect a comma or closing bracket.
+		[_lexer advance];
+		OOConfTokenType token = [_lexer currentTokenType];
+		if (token == kOOConfTokenComma)
+		{
+			[_lexer advance];
+		}
+		else if (token == kOOConfTokenCloseBracket)
+		{
+			stop = YES;
+		}
+		else
+		{
+			[self priv_reportBasicParseError:@"\",\" or \"]\""];
+			return NO;
+		}
+	}
+	
+	event.type = kOOConfStreamArrayEnd;
+	event.depth = depth;
+	return handler(&event, context);
+}
+
+
 - (BOOL) priv_parseDictionaryWithAction:(SEL)actionSEL result:(id *)result
 {
 	ParseActionIMP actionIMP = (ParseActionIMP)[_delegate methodForSelector:actionSEL];
@@ -546,3 +699,35 @@ typedef BOOL (*ParseActionIMP)(id self, SEL _cmd, OOConfParserActionEventType ev
 }
 
 @end
+
+
+static BOOL SetStreamEventText(OOConfStreamEvent *event, OOConfLexer *lexer)
+{
+	event->value.text.hasEscapes = [lexer currentTokenHasEscapes];
+	return [lexer getTokenBytes:&event->value.text.bytes length:&event->value.text.length];
+}
+
+
+OOINLINE BOOL TokenIs(OOConfStreamEvent *event, const char *keyword)
+{
+	size_t length = strlen(keyword);
+	return event->value.text.length == length && memcmp(event->value.text.bytes, keyword, length) == 0;
+}
+
+
+BOOL OOConfStreamEventTextEquals(const OOConfStreamEvent *event, const char *string)
+{
+	NSCParameterAssert(event != NULL && string != NULL);
+	
+	if (event->type != kOOConfStreamKey && event->type != kOOConfStreamString)  return NO;
+	
+	if (!event->value.text.hasEscapes)
+	{
+		size_t length = strlen(string);
+		return event->value.text.length == length && memcmp(event->value.text.bytes, string, length) == 0;
+	}
+	else
+	{
+		return strcmp([[event->lexer currentTokenString] UTF8String], string) == 0;
+	}
+}
@@ -49,6 +49,60 @@ typedef enum
 } OOConfParserActionEventType;
 
 
+/*	Events for -parseWithStreamHandler:context:.
+	
+	Begin/End events bracket each dictionary and array. Inside a dictionary,
+	each value is preceded by a Key event. Text (keys and strings) is passed as
+	a range of the input buffer, and numbers as uint64_t (naturals) or double
+	(everything else), so no objects are created during parsing.
+*/
+typedef enum
+{
+	kOOConfStreamDictionaryBegin,
+	kOOConfStreamDictionaryEnd,
+	kOOConfStreamKey,
+	kOOConfStreamArrayBegin,
+	kOOConfStreamArrayEnd,
+	kOOConfStreamString,
+	kOOConfStreamNatural,
+	kOOConfStreamReal,
+	kOOConfStreamTrue,
+	kOOConfStreamFalse,
+	kOOConfStreamNull
+} OOConfStreamEventType;
+
+
+typedef struct OOConfStreamEvent
+{
+	OOConfStreamEventType		type;
+	unsigned					depth;		// Number of enclosing collections; 0 for the value being parsed.
+	OOConfLexer					*lexer;		// Positioned at the event's token.
+	union
+	{
+		struct
+		{
+			const uint8_t		*bytes;		// Not NUL-terminated. Only valid during the handler call.
+			size_t				length;
+			BOOL				hasEscapes;	// If YES, use [lexer currentTokenString] to get the decoded text.
+		}						text;
+		uint64_t				natural;
+		double					real;
+	}							value;
+} OOConfStreamEvent;
+
+
+/*	Return NO to stop parsing; -parseWithStreamHandler:context: will then
+	return NO. The handler is responsible for reporting why.
+*/
+typedef BOOL (*OOConfStreamHandler)(const OOConfStreamEvent *event, void *context);
+
+
+/*	Compare key or string event text to a UTF-8 C string, decoding escapes if
+	necessary.
+*/
+BOOL OOConfStreamEventTextEquals(const OOConfStreamEvent *event, const char *string);
+
+
 @interface OOConfParser: NSObject
 {
 @private
@@ -104,4 +158,12 @@ typedef enum
 */
 - (id) parseAsPropertyList;
 
+/*	parseWithStreamHandler:context:
+	Parse the next value, calling the handler for each element in document
+	order. Like -parseWithDelegateAction:result:, it leaves the lexer at the
+	last token of the value. Syntax errors are reported to the problem
+	reporter.
+*/
+- (BOOL) parseWithStreamHandler:(OOConfStreamHandler)handler context:(void *)context;
+
 @end
@@ -100,6 +100,7 @@ typedef float OOScalar;
 #include "OOQuaternion.h"
 #include "OOMatrix.h"
 #include "OOBoundingBox.h"
+#include "OOBatchMaths.h"
 
 
 #ifdef __cplusplus
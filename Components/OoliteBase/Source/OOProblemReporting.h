@@ -122,4 +122,25 @@ NSString *OOLocalizeProblemString(id <OOProblemReporting> probMgr, NSString *str
 @end
 
 
+/*	Implementation of OOProblemReporting which stores problems so they can be
+	passed on to another problem reporter later. This allows work to be done
+	on another thread with a reporter that isn't thread-safe, and keeps
+	problem reports in a predictable order when several jobs run at once.
+	Strings are not localized. Each instance may only be used by one thread at
+	a time.
+*/
+@interface OODeferredProblemReporter: NSObject <OOProblemReporting>
+{
+@private
+	NSMutableArray			*_problems;
+}
+
+- (NSUInteger) problemCount;
+
+// Report stored problems to problemReporter, in the order they were added.
+- (void) replayToProblemReporter:(id <OOProblemReporting>)problemReporter;
+
+@end
+
+
 extern NSString * const kOOErrorConvertingProblemReporterDomain;
@@ -302,3 +302,47 @@ void OOReportNSError(id <OOProblemReporting> probMgr, NSString *context, NSError
 }
 
 @end
+
+
+@implementation OODeferredProblemReporter
+
+- (void) dealloc
+{
+	DESTROY(_problems);
+	
+	[super dealloc];
+}
+
+
+- (NSUInteger) problemCount
+{
+	return [_problems count];
+}
+
+
+- (void) replayToProblemReporter:(id <OOProblemReporting>)problemReporter
+{
+	NSArray					*problem = nil;
+	
+	foreach (problem, _problems)
+	{
+		[problemReporter addProblemOfType:[[problem objectAtIndex:0] unsignedIntValue] message:[problem objectAtIndex:1]];
+	}
+}
+
+
+- (void) addProblemOfType:(OOProblemReportType)type message:(NSString *)message
+{
+	if (message == nil)  return;
+	if (_problems == nil)  _problems = [[NSMutableArray alloc] init];
+	
+	[_problems addObject:[NSArray arrayWithObjects:[NSNumber numberWithUnsignedInt:type], message, nil]];
+}
+
+
+- (NSString *) localizedProblemStringForKey:(NSString *)string
+{
+	return string;
+}
+
+@end
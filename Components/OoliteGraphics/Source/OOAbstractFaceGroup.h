@@ -40,6 +40,9 @@
 @private
 	NSString					*_name;
 	NSMutableArray				*_faces;
+	NSDictionary				*_packedAttributes;
+	OOIndexArray				*_packedIndices;
+	NSUInteger					_packedVertexCount;
 	OOMaterialSpecification		*_material;
 	NSDictionary				*_vertexSchema;
 	NSMutableSet				*_temporaryAttributes;
@@ -58,6 +61,9 @@
 		multiples of vertexCount; the ratio defines the attribute size.
 	indexArray: indices into attribute arrays. Values must be less than
 		vertexCount. Count must be multiple of three.
+	
+	The arrays are kept as they are, and face and vertex objects are only
+	created if the faces are accessed individually.
 */
 - (id) initWithAttributeArrays:(NSDictionary *)attributeArrays
 				   vertexCount:(NSUInteger)vertexCount
@@ -41,11 +41,27 @@ NSString * const kOOAbstractFaceGroupChangeAffectsRenderMesh = @"kOOAbstractFace
 NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMask";
 
 
+enum
+{
+	kFacesPerPool				= 256
+};
+
+
+static NSDictionary *SchemaForAttributeArrays(NSDictionary *attributeArrays, NSUInteger vertexCount);
+
+
 @interface OOAbstractFaceGroup (Private)
 
 - (id) priv_initWithCapacity:(NSUInteger)capacity;
 - (void) priv_updateSchemaForFace:(OOAbstractFace *)face;
 
+- (BOOL) priv_setAttributeArrays:(NSDictionary *)attributeArrays
+					 vertexCount:(NSUInteger)vertexCount
+					  indexArray:(OOIndexArray *)indexArray;
+
+//	Convert packed storage to face objects. Must be called before touching _faces.
+- (void) priv_materializeFaces;
+
 @end
 
 
@@ -73,79 +89,11 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 				   vertexCount:(NSUInteger)vertexCount
 					indexArray:(OOIndexArray *)indexArray
 {
-	NSUInteger faceCount = [indexArray count];
-	if (EXPECT_NOT(faceCount % 3 != 0))
+	if ((self = [self priv_initWithCapacity:0]))
 	{
-		[self release];
-		return nil;
-	}
-	faceCount /= 3;
-	
-	if ((self = [self priv_initWithCapacity:faceCount]))
-	{
-		NSUInteger aIter = 0, attrCount = [attributeArrays count];
-		NSMutableDictionary *schema = [NSMutableDictionary dictionaryWithCapacity:attrCount];
-		NSString *attrKey = nil;
-		unsigned attrSizes[attrCount];
-		NSString *attrKeys[attrCount];
-		OOFloatArray *attrValues[attrCount];
-		OOFloatArray *sourceArrays[attrCount];
-		
-		//	Determine schema.
-		foreachkey (attrKey, attributeArrays)
+		if (EXPECT_NOT(![self priv_setAttributeArrays:attributeArrays vertexCount:vertexCount indexArray:indexArray]))
 		{
-			attrKeys[aIter] = attrKey;
-			OOFloatArray *attrArray = [attributeArrays oo_objectOfClass:[OOFloatArray class] forKey:attrKey];
-			sourceArrays[aIter] = attrArray;
-			NSUInteger attrCount = [attrArray count];
-			if (EXPECT_NOT(attrKey == nil || attrCount % vertexCount != 0))
-			{
-				[self release];
-				return nil;
-			}
-			
-			attrSizes[aIter] = attrCount / vertexCount;
-			[schema setObject:[NSNumber numberWithUnsignedInt:attrSizes[aIter]] forKey:attrKey];
-			aIter++;
-		}
-		
-		_vertexSchema = [[NSDictionary alloc] initWithDictionary:schema];
-		_homogeneous = YES;
-		
-		
-		// Set up faces.
-		NSUInteger fIter, vIter;
-		GLuint vIdx, elemIdx = 0;
-		for (fIter = 0; fIter < faceCount; fIter++)
-		{
-			NSAutoreleasePool *pool = [NSAutoreleasePool new];
-			
-			OOAbstractVertex *verts[3];
-			
-			for (vIter = 0; vIter < 3; vIter++)
-			{
-				vIdx = [indexArray unsignedIntAtIndex:elemIdx++];
-				
-				for (aIter = 0; aIter < attrCount; aIter++)
-				{
-					NSRange range = { vIdx * attrSizes[aIter], attrSizes[aIter] };
-					attrValues[aIter] = (OOFloatArray *)[sourceArrays[aIter] subarrayWithRange:range];
-				}
-				
-				// FIXME: extend vertex to bypass dict?
-				NSDictionary *dict = [NSDictionary dictionaryWithObjects:attrValues forKeys:attrKeys count:attrCount];
-				verts[vIter] = [(OOAbstractVertex *)[OOAbstractVertex alloc] initWithAttributes:dict];
-			}
-			
-			OOAbstractFace *face = [[OOAbstractFace alloc] initWithVertices:verts];
-			[_faces addObject:face];
-			
-			[face release];
-			[verts[0] release];
-			[verts[1] release];
-			[verts[2] release];
-			
-			[pool drain];
+			DESTROY(self);
 		}
 	}
 	
@@ -158,6 +106,8 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 	[[NSNotificationCenter defaultCenter] removeObserver:nil name:kOOAbstractFaceGroupChangedNotification object:self];
 	
 	DESTROY(_faces);
+	DESTROY(_packedAttributes);
+	DESTROY(_packedIndices);
 	DESTROY(_vertexSchema);
 	DESTROY(_temporaryAttributes);
 	
@@ -176,7 +126,17 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 	
 	[result setName:[self name]];
 	[result setMaterial:[self material]];
-	[result->_faces addObjectsFromArray:_faces];
+	if (_faces != nil)
+	{
+		[result->_faces addObjectsFromArray:_faces];
+	}
+	else
+	{
+		DESTROY(result->_faces);
+		result->_packedAttributes = [_packedAttributes retain];
+		result->_packedIndices = [_packedIndices retain];
+		result->_packedVertexCount = _packedVertexCount;
+	}
 	result->_vertexSchema = [_vertexSchema retain];
 	result->_homogeneous = _homogeneous;
 	
@@ -216,24 +176,28 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 
 - (NSUInteger) faceCount
 {
+	if (_faces == nil)  return [_packedIndices count] / 3;
 	return [_faces count];
 }
 
 
 - (NSArray *) faces
 {
+	[self priv_materializeFaces];
 	return _faces;
 }
 
 
 - (OOAbstractFace *) faceAtIndex:(NSUInteger)index
 {
+	[self priv_materializeFaces];
 	return [_faces objectAtIndex:index];
 }
 
 
 - (void) addFace:(OOAbstractFace *)face
 {
+	[self priv_materializeFaces];
 	[_faces addObject:face];
 	[self priv_updateSchemaForFace:face];
 	
@@ -243,6 +207,7 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 
 - (void) insertFace:(OOAbstractFace *)face atIndex:(NSUInteger)index
 {
+	[self priv_materializeFaces];
 	[_faces insertObject:face atIndex:index];
 	[self priv_updateSchemaForFace:face];
 	
@@ -252,6 +217,7 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 
 - (void) removeLastFace
 {
+	[self priv_materializeFaces];
 	if (!_homogeneous)  DESTROY(_vertexSchema);
 	[_faces removeLastObject];
 	
@@ -261,6 +227,7 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 
 - (void) removeFaceAtIndex:(NSUInteger)index
 {
+	[self priv_materializeFaces];
 	if (!_homogeneous)  DESTROY(_vertexSchema);
 	[_faces removeObjectAtIndex:index];
 	
@@ -269,7 +236,8 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 
 
 - (void) replaceFaceAtIndex:(NSUInteger)index withFace:(OOAbstractFace *)face
-{	
+{
+	[self priv_materializeFaces];
 	if (!_homogeneous)  DESTROY(_vertexSchema);
 	[_faces replaceObjectAtIndex:index withObject:face];
 	_boundingBoxIsValid = NO;
@@ -289,12 +257,47 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 					  withEffects:(OOAbstractMeshEffectMask)effects
 {
 	DESTROY(_faces);
+	DESTROY(_packedAttributes);
+	DESTROY(_packedIndices);
+	_packedVertexCount = 0;
 	_faces = [faces mutableCopy];
 	
 	[self internal_becomeDirtyWithEffects:effects];
 }
 
 
+- (void) internal_replaceAllFacesWithAttributeArrays:(NSDictionary *)attributeArrays
+										 vertexCount:(NSUInteger)vertexCount
+										  indexArray:(OOIndexArray *)indexArray
+										 withEffects:(OOAbstractMeshEffectMask)effects
+{
+	if (EXPECT_NOT(![self priv_setAttributeArrays:attributeArrays vertexCount:vertexCount indexArray:indexArray]))
+	{
+		[NSException raise:NSInvalidArgumentException format:@"Invalid packed face data passed to %@.", NSStringFromSelector(_cmd)];
+	}
+	
+	[self internal_becomeDirtyWithEffects:effects];
+}
+
+
+- (NSDictionary *) internal_packedAttributeArrays
+{
+	return _packedAttributes;
+}
+
+
+- (OOIndexArray *) internal_packedIndexArray
+{
+	return _packedIndices;
+}
+
+
+- (NSUInteger) internal_packedVertexCount
+{
+	return _packedVertexCount;
+}
+
+
 - (BOOL) isAttributeTemporary:(NSString *)attributeKey
 {
 	return [_temporaryAttributes containsObject:attributeKey];
@@ -320,12 +323,14 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 
 - (NSEnumerator *) faceEnumerator
 {
+	[self priv_materializeFaces];
 	return [_faces objectEnumerator];
 }
 
 
 - (NSEnumerator *) objectEnumerator
 {
+	[self priv_materializeFaces];
 	return [_faces objectEnumerator];
 }
 
@@ -334,13 +339,19 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 								   objects:(id *)stackbuf
 									 count:(NSUInteger)len
 {
+	[self priv_materializeFaces];
 	return [_faces countByEnumeratingWithState:state objects:stackbuf count:len];
 }
 
 
 - (NSDictionary *) vertexSchema
 {
-	if (_vertexSchema == nil)
+	if (_vertexSchema == nil && _faces == nil)
+	{
+		_vertexSchema = [SchemaForAttributeArrays(_packedAttributes, _packedVertexCount) retain];
+		_homogeneous = YES;
+	}
+	else if (_vertexSchema == nil)
 	{
 		OOAbstractFace *face = nil;
 		foreach (face, _faces)
@@ -383,7 +394,7 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 		[NSException raise:NSInvalidArgumentException format:@"Cannot restrict a face group to a schema that does not include position."];
 	}
 	
-	NSMutableArray *newFaces = [[NSMutableArray alloc] initWithCapacity:[_faces count]];
+	NSMutableArray *newFaces = [[NSMutableArray alloc] initWithCapacity:[self faceCount]];
 	OOAbstractFace *face = nil;
 	
 	foreach (face, self)
@@ -397,7 +408,33 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 
 - (OOBoundingBox) boundingBox
 {
-	if (!_boundingBoxIsValid)
+	if (!_boundingBoxIsValid && _faces == nil)
+	{
+		//	Packed: only count vertices that are actually referenced.
+		_boundingBox = kOOZeroBoundingBox;
+		
+		OOFloatArray *positions = [_packedAttributes objectForKey:kOOPositionAttributeKey];
+		const float *positionData = [positions floatData];
+		NSUInteger stride = (_packedVertexCount != 0) ? [positions count] / _packedVertexCount : 0;
+		NSUInteger size = MIN(stride, 3U);
+		NSUInteger iIter, indexCount = [_packedIndices count];
+		
+		for (iIter = 0; iIter < indexCount; iIter++)
+		{
+			Vector position = kZeroVector;
+			if (size != 0)
+			{
+				const float *p = positionData + [_packedIndices unsignedIntAtIndex:iIter] * stride;
+				position.x = p[0];
+				if (size > 1)  position.y = p[1];
+				if (size > 2)  position.z = p[2];
+			}
+			OOBoundingBoxAddVector(&_boundingBox, position);
+		}
+		
+		_boundingBoxIsValid = YES;
+	}
+	else if (!_boundingBoxIsValid)
 	{
 		_boundingBox = kOOZeroBoundingBox;
 		
@@ -446,6 +483,114 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 }
 
 
+- (BOOL) priv_setAttributeArrays:(NSDictionary *)attributeArrays
+					 vertexCount:(NSUInteger)vertexCount
+					  indexArray:(OOIndexArray *)indexArray
+{
+	NSUInteger iIter, indexCount = [indexArray count];
+	if (EXPECT_NOT(indexCount % 3 != 0 || (vertexCount == 0 && indexCount != 0)))  return NO;
+	
+	NSDictionary *schema = SchemaForAttributeArrays(attributeArrays, vertexCount);
+	if (EXPECT_NOT(schema == nil))  return NO;
+	
+	for (iIter = 0; iIter < indexCount; iIter++)
+	{
+		if (EXPECT_NOT([indexArray unsignedIntAtIndex:iIter] >= vertexCount))  return NO;
+	}
+	
+	DESTROY(_faces);
+	[_packedAttributes autorelease];
+	_packedAttributes = [attributeArrays copy];
+	[_packedIndices autorelease];
+	_packedIndices = [indexArray retain];
+	_packedVertexCount = vertexCount;
+	
+	[_vertexSchema autorelease];
+	_vertexSchema = [schema retain];
+	_homogeneous = YES;
+	_boundingBoxIsValid = NO;
+	
+	return YES;
+}
+
+
+- (void) priv_materializeFaces
+{
+	if (EXPECT(_faces != nil))  return;
+	
+	NSUInteger aIter, attrCount = [_packedAttributes count];
+	NSUInteger fIter, faceCount = [_packedIndices count] / 3;
+	NSUInteger iIdx = 0;
+	NSString *attrKeys[attrCount + 1];
+	OOFloatArray *sourceArrays[attrCount + 1];
+	OOFloatArray *attrValues[attrCount + 1];
+	NSUInteger attrSizes[attrCount + 1];
+	
+	NSString *attrKey = nil;
+	aIter = 0;
+	foreachkey (attrKey, _packedAttributes)
+	{
+		attrKeys[aIter] = attrKey;
+		sourceArrays[aIter] = [_packedAttributes objectForKey:attrKey];
+		attrSizes[aIter] = (_packedVertexCount != 0) ? [sourceArrays[aIter] count] / _packedVertexCount : 0;
+		aIter++;
+	}
+	
+	/*	Vertices are shared between the faces that use them, so each one is
+		only created once.
+	*/
+	OOAbstractVertex **vertices = calloc(_packedVertexCount + 1, sizeof *vertices);
+	if (EXPECT_NOT(vertices == NULL))
+	{
+		[NSException raise:NSMallocException format:@"Could not allocate memory for OOAbstractFaceGroup."];
+	}
+	
+	_faces = [[NSMutableArray alloc] initWithCapacity:faceCount];
+	NSAutoreleasePool *pool = [NSAutoreleasePool new];
+	
+	for (fIter = 0; fIter < faceCount; fIter++)
+	{
+		OOAbstractVertex *verts[3];
+		
+		for (unsigned vIter = 0; vIter < 3; vIter++)
+		{
+			NSUInteger vIdx = [_packedIndices unsignedIntAtIndex:iIdx++];
+			if (vertices[vIdx] == nil)
+			{
+				for (aIter = 0; aIter < attrCount; aIter++)
+				{
+					NSRange range = { vIdx * attrSizes[aIter], attrSizes[aIter] };
+					attrValues[aIter] = (OOFloatArray *)[sourceArrays[aIter] subarrayWithRange:range];
+				}
+				
+				NSDictionary *dict = [NSDictionary dictionaryWithObjects:attrValues forKeys:attrKeys count:attrCount];
+				vertices[vIdx] = [(OOAbstractVertex *)[OOAbstractVertex alloc] initWithAttributes:dict];
+			}
+			verts[vIter] = vertices[vIdx];
+		}
+		
+		OOAbstractFace *face = [[OOAbstractFace alloc] initWithVertices:verts];
+		[_faces addObject:face];
+		[face release];
+		
+		if ((fIter + 1) % kFacesPerPool == 0)
+		{
+			[pool drain];
+			pool = [NSAutoreleasePool new];
+		}
+	}
+	
+	[pool drain];
+	
+	for (NSUInteger i = 0; i < _packedVertexCount; i++)  [vertices[i] release];
+	free(vertices);
+	
+	DESTROY(_packedAttributes);
+	DESTROY(_packedIndices);
+	_packedVertexCount = 0;
+}
+
+
 - (void) internal_becomeDirtyWithEffects:(OOAbstractMeshEffectMask)effects
 {
 	NSParameterAssert(((effects & kOOChangeInvalidatesUniqueness) == 0) || ((effects & kOOChangeGuaranteesUniqueness) == 0));
@@ -466,6 +611,25 @@ NSString * const kOOAbstractFaceGroupEffectMask = @"kOOAbstractFaceGroupEffectMa
 @end
 
 
+static NSDictionary *SchemaForAttributeArrays(NSDictionary *attributeArrays, NSUInteger vertexCount)
+{
+	NSMutableDictionary *schema = [NSMutableDictionary dictionaryWithCapacity:[attributeArrays count]];
+	NSString *attrKey = nil;
+	
+	foreachkey (attrKey, attributeArrays)
+	{
+		OOFloatArray *attrArray = [attributeArrays oo_objectOfClass:[OOFloatArray class] forKey:attrKey];
+		NSUInteger attrCount = [attrArray count];
+		if (EXPECT_NOT(attrArray == nil || (vertexCount == 0 ? attrCount != 0 : attrCount % vertexCount != 0)))  return nil;
+		
+		NSUInteger size = (vertexCount != 0) ? attrCount / vertexCount : 0;
+		[schema setObject:[NSNumber numberWithUnsignedInteger:size] forKey:attrKey];
+	}
+	
+	return [NSDictionary dictionaryWithDictionary:schema];
+}
+
+
 NSDictionary *OOUnionOfSchemata(NSDictionary *a, NSDictionary *b)
 {
 	if ([a isEqualToDictionary:b])  return a;
@@ -52,6 +52,18 @@ typedef uint32_t OOAbstractMeshEffectMask;
 - (void) internal_replaceAllFaces:(NSMutableArray *)faces
 					  withEffects:(OOAbstractMeshEffectMask)effects;
 
+/*	Packed storage, as passed to -initWithAttributeArrays:vertexCount:indexArray:.
+	These are nil if the group has been converted to face objects.
+*/
+- (NSDictionary *) internal_packedAttributeArrays;
+- (OOIndexArray *) internal_packedIndexArray;
+- (NSUInteger) internal_packedVertexCount;
+
+- (void) internal_replaceAllFacesWithAttributeArrays:(NSDictionary *)attributeArrays
+										 vertexCount:(NSUInteger)vertexCount
+										  indexArray:(OOIndexArray *)indexArray
+										 withEffects:(OOAbstractMeshEffectMask)effects;
+
 @end
 
 #endif
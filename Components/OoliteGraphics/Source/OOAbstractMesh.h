@@ -32,6 +32,8 @@
 #import "OOMaterialSpecification.h"
 #import "OORenderMesh.h"
 
+@class OOAbstractMeshStreams;
+
 
 @interface OOAbstractMesh: NSObject <NSFastEnumeration, NSCopying>
 {
@@ -42,6 +44,7 @@
 	
 	OORenderMesh				*_renderMesh;
 	NSArray						*_materialSpecs;
+	OOAbstractMeshStreams		*_packedStreams;
 	
 	OOBoundingBox				_boundingBox;
 	
@@ -87,6 +90,11 @@
 
 - (void) uniqueVertices;
 
+/*	Uniqued vertices in packed form (see OOAbstractMeshStreams.h). The result
+	is cached until the mesh is modified.
+*/
+- (OOAbstractMeshStreams *) packedStreams;
+
 // - (void) mergeVerticesWithTolerance:(float)tolerance;
 
 
@@ -27,6 +27,7 @@
 
 #import "OOAbstractMesh.h"
 #import "OOAbstractFaceGroupInternal.h"
+#import "OOAbstractMeshStreams.h"
 
 
 NSString * const kOOAbstractMeshChangedNotification = @"org.oolite OOAbstractMesh changed";
@@ -48,11 +49,6 @@ NSString * const kOOAbstractMeshChangeAffectsRenderMesh = @"kOOAbstractMeshChang
 
 - (void) priv_buildRenderMesh;
 
-- (void) priv_uniqueVerticesGettingResults:(NSArray **)outVertices
-								   indices:(NSDictionary **)outIndices
-								 useCounts:(NSArray **)outUseCounts
-							 updatingFaces:(BOOL)updatingFaces;
-
 @end
 
 
@@ -78,6 +74,7 @@ NSString * const kOOAbstractMeshChangeAffectsRenderMesh = @"kOOAbstractMeshChang
 	
 	DESTROY(_renderMesh);
 	DESTROY(_materialSpecs);
+	DESTROY(_packedStreams);
 	
 	[[NSNotificationCenter defaultCenter] removeObserver:nil
 													name:kOOAbstractMeshChangedNotification
@@ -329,7 +326,76 @@ NSString * const kOOAbstractMeshChangeAffectsRenderMesh = @"kOOAbstractMeshChang
 
 - (void) uniqueVertices
 {
-	[self priv_uniqueVerticesGettingResults:NULL indices:NULL useCounts:NULL updatingFaces:YES];
+	if (_verticesAreUnique)  return;
+	
+	OOAbstractMeshStreams *streams = [self packedStreams];
+	if (EXPECT_NOT(streams == nil))  return;
+	
+	NSAutoreleasePool *pool = [NSAutoreleasePool new];
+	NSUInteger gIter, groupCount = [self faceGroupCount];
+	
+	[self beginBatchEdit];
+	
+	if ([streams isHomogeneous])
+	{
+		//	The streams describe the vertices exactly, so the groups can share them directly.
+		NSDictionary *attributeArrays = [streams attributeArrays];
+		NSUInteger vertexCount = [streams vertexCount];
+		
+		for (gIter = 0; gIter < groupCount; gIter++)
+		{
+			[[self faceGroupAtIndex:gIter] internal_replaceAllFacesWithAttributeArrays:attributeArrays
+																		   vertexCount:vertexCount
+																			indexArray:[streams indexArrayForGroupAtIndex:gIter]
+																		   withEffects:kOOChangeGuaranteesUniqueness];
+		}
+	}
+	else
+	{
+		//	Build one vertex object per unique vertex, and faces referring to them.
+		NSUInteger vIter, vertexCount = [streams vertexCount];
+		NSMutableArray *vertices = [NSMutableArray arrayWithCapacity:vertexCount];
+		for (vIter = 0; vIter < vertexCount; vIter++)
+		{
+			[vertices addObject:[streams vertexAtIndex:vIter]];
+		}
+		
+		for (gIter = 0; gIter < groupCount; gIter++)
+		{
+			OOIndexArray *indices = [streams indexArrayForGroupAtIndex:gIter];
+			NSUInteger iIter, indexCount = [indices count];
+			NSMutableArray *newFaces = [NSMutableArray arrayWithCapacity:indexCount / 3];
+			
+			for (iIter = 0; iIter < indexCount; iIter += 3)
+			{
+				OOAbstractVertex *faceVerts[3] =
+				{
+					[vertices objectAtIndex:[indices unsignedIntAtIndex:iIter]],
+					[vertices objectAtIndex:[indices unsignedIntAtIndex:iIter + 1]],
+					[vertices objectAtIndex:[indices unsignedIntAtIndex:iIter + 2]]
+				};
+				[newFaces addObject:[OOAbstractFace faceWithVertices:faceVerts]];
+			}
+			
+			[[self faceGroupAtIndex:gIter] internal_replaceAllFaces:newFaces withEffects:kOOChangeGuaranteesUniqueness];
+		}
+	}
+	
+	[self endBatchEdit];
+	_verticesAreUnique = YES;
+	
+	[pool drain];
+}
+
+
+- (OOAbstractMeshStreams *) packedStreams
+{
+	if (_packedStreams == nil)
+	{
+		_packedStreams = [[OOAbstractMeshStreams alloc] initWithMesh:self];
+	}
+	
+	return _packedStreams;
 }
 
 
@@ -368,6 +434,9 @@ NSString * const kOOAbstractMeshChangeAffectsRenderMesh = @"kOOAbstractMeshChang
 
 - (void) internal_becomeDirtyWithEffects:(OOAbstractMeshEffectMask)effects
 {
+	//	Streams are dropped immediately, so that they are never stale within a batch edit.
+	if (effects & kOOChangeInvalidatesEverything)  DESTROY(_packedStreams);
+	
 	if (_batchLevel == 0)
 	{
 		if (effects & kOOChangeInvalidatesUniqueness)
@@ -420,157 +489,22 @@ NSString * const kOOAbstractMeshChangeAffectsRenderMesh = @"kOOAbstractMeshChang
 }
 
 
-- (void) priv_uniqueVerticesGettingResults:(NSArray **)outVertices
-								   indices:(NSDictionary **)outIndices
-								 useCounts:(NSArray **)outUseCounts
-							 updatingFaces:(BOOL)updatingFaces
-{
-	NSAutoreleasePool		*pool = [NSAutoreleasePool new];
-	
-	NSMutableArray			*vertices = [NSMutableArray array];
-	NSMutableDictionary		*indices = [NSMutableDictionary dictionary];
-	NSMutableArray			*useCounts = nil;
-	NSUInteger				vertexCount = 0;
-	OOAbstractFaceGroup		*faceGroup = nil;
-	OOAbstractFace			*face = nil;
-	
-	if (_verticesAreUnique)
-	{
-		// updatingFaces should have no effect if _verticesAreUnique is legitimately true.
-		updatingFaces = NO;
-	}
-	
-	if (outVertices == NULL && outIndices == NULL && outUseCounts == NULL && !updatingFaces)
-	{
-		// Nothing to do.
-		[pool drain];
-		return;
-	}
-	
-	if (outUseCounts != NULL)  useCounts = [NSMutableArray array];
-	[self beginBatchEdit];
-	
-	foreach (faceGroup, self)
-	{
-		NSUInteger faceIndex = 0;
-		NSMutableArray *newFaces = [NSMutableArray arrayWithCapacity:[faceGroup faceCount]];
-		BOOL changedInGroup = NO;
-		
-		foreach (face, faceGroup)
-		{
-			NSAutoreleasePool *innerPool = [NSAutoreleasePool new];
-			
-			OOAbstractVertex *faceVerts[3];
-			BOOL changedVert = NO;
-			[face getVertices:faceVerts];
-			
-			for (uint_fast8_t vIter = 0; vIter < 3; vIter++)
-			{
-				NSNumber *index = [indices objectForKey:faceVerts[vIter]];
-				if (index == nil)
-				{
-					// Previously unseen vertex.
-					index = [NSNumber numberWithUnsignedInteger:vertexCount++];
-					[indices setObject:index forKey:faceVerts[vIter]];
-					[vertices addObject:faceVerts[vIter]];
-					
-					if (useCounts != nil)
-					{
-						[useCounts addObject:[NSNumber numberWithUnsignedInteger:1]];
-					}
-				}
-				else
-				{
-					// Reuse existing vertex.
-					if (updatingFaces)
-					{
-						changedVert = YES;
-						faceVerts[vIter] = [vertices objectAtIndex:[index unsignedIntegerValue]];
-					}
-					
-					if (useCounts != nil)
-					{
-						NSUInteger indexVal = [index unsignedIntegerValue];
-						NSUInteger useCount = [[useCounts objectAtIndex:indexVal] unsignedIntegerValue];
-						useCount++;
-						[useCounts replaceObjectAtIndex:indexVal withObject:[NSNumber numberWithUnsignedInteger:useCount]];
-					}
-				}
-			}
-			
-			if (changedVert)
-			{
-				// Apply uniqued face.
-				face = [OOAbstractFace faceWithVertices:faceVerts];
-				changedInGroup = YES;
-			}
-			[newFaces addObject:face];
-			
-			[innerPool drain];
-			faceIndex++;
-		}
-		
-		if (changedInGroup)  [faceGroup internal_replaceAllFaces:newFaces withEffects:kOOChangeGuaranteesUniqueness];
-	}
-	
-	[self endBatchEdit];
-	
-	if (outVertices != NULL)  *outVertices = [vertices retain];
-	if (outIndices != NULL)  *outIndices = [indices retain];
-	if (outUseCounts != NULL)  *outUseCounts = [useCounts retain];
-	
-	if (updatingFaces)  _verticesAreUnique = YES;
-	
-	[pool drain];
-	
-	if (outVertices != NULL)  [*outVertices autorelease];
-	if (outIndices != NULL)  [*outIndices autorelease];
-	if (outUseCounts != NULL)  [*outUseCounts autorelease];
-}
-
-
 - (void) priv_buildRenderMesh
 {
-	NSArray					*vertices = nil;
-	NSDictionary			*indices = nil;
-	
 	DESTROY(_renderMesh);
 	DESTROY(_materialSpecs);
 	
 	// Get uniqued vertices.
-	[self priv_uniqueVerticesGettingResults:&vertices indices:&indices useCounts:NULL updatingFaces:NO];
+	OOAbstractMeshStreams *streams = [self packedStreams];
+	if (EXPECT_NOT(streams == nil))  return;
 	
-	// Build group index arrays and material array.
+	// Build material array.
 	OOAbstractFaceGroup		*faceGroup = nil;
 	OOMaterialSpecification	*anonMaterial = nil;
 	
-	GLuint vertexCount = [vertices count];
 	NSMutableArray *materials = [NSMutableArray arrayWithCapacity:[self faceGroupCount]];
-	NSMutableArray *groups = [NSMutableArray arrayWithCapacity:[self faceGroupCount]];
 	foreach (faceGroup, self)
 	{
-		// Index array.
-		GLuint indexCount = [faceGroup faceCount] * 3;
-		GLuint *indexArray = malloc(indexCount * sizeof (GLuint));
-		if (indexArray == NULL)  return;
-		
-		OOAbstractFace *face = nil;
-		GLuint *next = indexArray;
-		foreach (face, faceGroup)
-		{
-			OOAbstractVertex *vertices[3];
-			[face getVertices:vertices];
-			
-			for (unsigned vIter = 0; vIter < 3; vIter++)
-			{
-				*next++ = [indices oo_unsignedIntForKey:vertices[vIter]];
-			}
-		}
-		
-		[groups addObject:[OOIndexArray arrayWithUnsignedInts:indexArray count:indexCount maximum:vertexCount]];
-		free(indexArray);
-		
-		// Material array.
 		OOMaterialSpecification *material = [faceGroup material];
 		if (material == nil)
 		{
@@ -584,38 +518,10 @@ NSString * const kOOAbstractMeshChangeAffectsRenderMesh = @"kOOAbstractMeshChang
 		[materials addObject:material];
 	}
 	
-	// Build attribute arrays.
-	NSDictionary *schema = [self vertexSchema];
-	NSString *attrKey = nil;
-	OOFloatArray *emptyAttr = [OOFloatArray array];
-	NSMutableDictionary *attributes = [NSMutableDictionary dictionaryWithCapacity:[schema count]];
-	
-	foreachkey (attrKey, schema)
-	{
-		unsigned size = [schema oo_unsignedIntForKey:attrKey];
-		float *attrArray = malloc(sizeof (float) * size * vertexCount);
-		if (attrArray == NULL)  return;
-		float *next = attrArray;
-		
-		for (GLuint vIter = 0; vIter < vertexCount; vIter++)
-		{
-			OOAbstractVertex *vertex = [vertices objectAtIndex:vIter];
-			OOFloatArray *attribute = [vertex attributeForKey:attrKey];
-			if (attribute == nil)  attribute = emptyAttr;
-			
-			for (unsigned cIter = 0; cIter < size; cIter++)
-			{
-				*next++ = [attribute floatAtIndex:cIter];
-			}
-		}
-		
-		[attributes setObject:[OOFloatArray arrayWithFloatsNoCopy:attrArray
-															count:size * vertexCount
-													 freeWhenDone:YES]
-					   forKey:attrKey];
-	}
-	
-	_renderMesh = [[OORenderMesh alloc] initWithName:[self name] vertexCount:vertexCount attributes:attributes groups:groups];
+	_renderMesh = [[OORenderMesh alloc] initWithName:[self name]
+										 vertexCount:[streams vertexCount]
+										  attributes:[streams attributeArrays]
+											  groups:[streams indexArrays]];
 	_materialSpecs = [[NSArray alloc] initWithArray:materials];
 }
 
@@ -0,0 +1,104 @@
+/*
+	OOAbstractMeshStreams.h
+
+	Packed representation of the vertices of an OOAbstractMesh.
+
+	The vertices of the mesh are uniqued and stored as one stream per
+	attribute: a float buffer whose stride is the size of the attribute in the
+	mesh’s vertex schema. Attributes that are shorter than the schema size for
+	a particular vertex, or missing, are zero-filled; the actual length is
+	also stored so that the original vertex can be reconstructed. Each face
+	group is stored as an index array of vertex triples.
+
+	Vertices are uniqued by value with the same rules as
+	-[OOAbstractVertex isEqual:], using an open-addressing hash table over the
+	raw bytes of the packed vertex. Uniqued vertices are numbered in order of
+	first use, going through the face groups and faces in order, so the
+	numbering is the same as uniquing vertex objects one at a time.
+
+	Streams are immutable. They are obtained from -[OOAbstractMesh packedStreams],
+	which caches them until the mesh is modified.
+
+
+	Copyright © 2010 Jens Ayton.
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the “Software”),
+	to deal in the Software without restriction, including without limitation
+	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+	and/or sell copies of the Software, and to permit persons to whom the
+	Software is furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#if !OOLITE_LEAN
+
+#import <OoliteBase/OoliteBase.h>
+
+@class OOAbstractMesh, OOAbstractVertex, OOFloatArray, OOIndexArray;
+
+
+@interface OOAbstractMeshStreams: NSObject
+{
+@private
+	NSDictionary				*_vertexSchema;
+	NSArray						*_attributeKeys;
+	NSDictionary				*_attributeArrays;
+	NSArray						*_indexArrays;
+	
+	NSUInteger					_attributeCount;
+	NSUInteger					*_attributeSizes;
+	const float					**_streams;
+	uint16_t					**_lengths;
+	NSUInteger					*_useCounts;
+	NSUInteger					_vertexCount;
+	
+	BOOL						_homogeneous;
+}
+
+- (id) initWithMesh:(OOAbstractMesh *)mesh;
+
+- (NSUInteger) vertexCount;
+
+// Schema of the whole mesh, including temporary attributes.
+- (NSDictionary *) vertexSchema;
+
+// Attribute keys in canonical order (see -oo_compareByVertexAttributeOrder:).
+- (NSArray *) attributeKeys;
+
+/*	Attribute streams, as OOFloatArrays of vertexCount * size floats, keyed by
+	attribute name. This is the form used by OORenderMesh.
+*/
+- (NSDictionary *) attributeArrays;
+- (OOFloatArray *) attributeArrayForKey:(NSString *)key;
+- (NSUInteger) attributeSizeForKey:(NSString *)key;
+
+/*	True if every vertex has every attribute in the schema at full size, so
+	the attribute streams describe the vertices exactly.
+*/
+- (BOOL) isHomogeneous;
+
+// One index array per face group, three indices per face.
+- (NSUInteger) groupCount;
+- (NSArray *) indexArrays;
+- (OOIndexArray *) indexArrayForGroupAtIndex:(NSUInteger)index;
+
+// Number of face corners using the vertex.
+- (NSUInteger) useCountForVertexAtIndex:(NSUInteger)index;
+
+// Object view of a vertex, with its original attribute lengths.
+- (OOAbstractVertex *) vertexAtIndex:(NSUInteger)index;
+
+@end
+
+#endif	// OOLITE_LEAN
@@ -0,0 +1,706 @@
+/*
+	OOAbstractMeshStreams.m
+
+
+	Copyright © 2010 Jens Ayton.
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the “Software”),
+	to deal in the Software without restriction, including without limitation
+	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+	and/or sell copies of the Software, and to permit persons to whom the
+	Software is furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#if !OOLITE_LEAN
+
+#import "OOAbstractMeshStreams.h"
+#import "OOAbstractMesh.h"
+#import "OOAbstractFaceGroupInternal.h"
+#import "OOAbstractVertex.h"
+#import "OOFloatArray.h"
+#import "OOIndexArray.h"
+
+
+enum
+{
+	kInitialVertexCapacity		= 256,
+	kFacesPerPool				= 256,
+	
+	/*	Per-vertex attribute lengths are stored as 0 for a missing attribute
+		and count + 1 otherwise, so the largest representable count is one
+		less than UINT16_MAX.
+	*/
+	kMaxAttributeSize			= UINT16_MAX - 1
+};
+
+
+#define kEmptySlot UINT32_MAX
+
+
+/*	Table of unique vertices under construction.
+
+	Vertices are appended to the per-attribute streams as they are first seen.
+	The hash table is open-addressed with linear probing, and stores vertex
+	indices; the hash of each vertex is kept alongside it so that growing the
+	table doesn’t require rehashing the vertex data.
+*/
+typedef struct
+{
+	NSUInteger				attributeCount;
+	const NSUInteger		*sizes;
+	NSUInteger				rowSize;
+	
+	float					**streams;
+	uint16_t				**lengths;
+	uint32_t				*hashes;
+	NSUInteger				*useCounts;
+	NSUInteger				count;
+	NSUInteger				capacity;
+	
+	uint32_t				*table;
+	NSUInteger				tableMask;
+} VertexTable;
+
+
+static BOOL VertexTableInit(VertexTable *table, NSUInteger attributeCount, const NSUInteger *sizes);
+static void VertexTableDestroy(VertexTable *table);
+static NSUInteger VertexTableAdd(VertexTable *table, const float *row, const uint16_t *rowLengths);
+
+static uint32_t HashRow(const float *row, NSUInteger rowSize, const uint16_t *rowLengths, NSUInteger attributeCount, BOOL *outHasNaN);
+
+
+@interface OOAbstractMeshStreams (Private)
+
+- (BOOL) priv_addFaceGroup:(OOAbstractFaceGroup *)faceGroup toTable:(VertexTable *)table indices:(GLuint *)indices;
+- (BOOL) priv_addPackedFaceGroup:(OOAbstractFaceGroup *)faceGroup toTable:(VertexTable *)table indices:(GLuint *)indices;
+
+@end
+
+
+@implementation OOAbstractMeshStreams
+
+- (id) initWithMesh:(OOAbstractMesh *)mesh
+{
+	if ((self = [super init]))
+	{
+		NSUInteger			aIter, gIter, groupCount = [mesh faceGroupCount];
+		VertexTable			table;
+		GLuint				*groupIndices[groupCount + 1];
+		NSUInteger			groupIndexCounts[groupCount + 1];
+		BOOL				OK = YES;
+		
+		_vertexSchema = [[mesh vertexSchema] retain];
+		_attributeKeys = [[[_vertexSchema allKeys] sortedArrayUsingSelector:@selector(oo_compareByVertexAttributeOrder:)] retain];
+		_attributeCount = [_attributeKeys count];
+		
+		_attributeSizes = calloc(_attributeCount + 1, sizeof *_attributeSizes);
+		_streams = calloc(_attributeCount + 1, sizeof *_streams);
+		_lengths = calloc(_attributeCount + 1, sizeof *_lengths);
+		if (EXPECT_NOT(_attributeSizes == NULL || _streams == NULL || _lengths == NULL))
+		{
+			[self release];
+			return nil;
+		}
+		
+		for (aIter = 0; aIter < _attributeCount; aIter++)
+		{
+			_attributeSizes[aIter] = [_vertexSchema oo_unsignedIntegerForKey:[_attributeKeys objectAtIndex:aIter]];
+			if (EXPECT_NOT(_attributeSizes[aIter] > kMaxAttributeSize))
+			{
+				[self release];
+				return nil;
+			}
+		}
+		
+		if (EXPECT_NOT(!VertexTableInit(&table, _attributeCount, _attributeSizes)))
+		{
+			[self release];
+			return nil;
+		}
+		
+		//	Unique vertices group by group, building index arrays as we go.
+		for (gIter = 0; gIter < groupCount; gIter++)
+		{
+			groupIndices[gIter] = NULL;
+			groupIndexCounts[gIter] = 0;
+		}
+		
+		for (gIter = 0; OK && gIter < groupCount; gIter++)
+		{
+			OOAbstractFaceGroup *faceGroup = [mesh faceGroupAtIndex:gIter];
+			NSUInteger indexCount = [faceGroup faceCount] * 3;
+			
+			groupIndices[gIter] = malloc(indexCount * sizeof (GLuint) + 1);
+			groupIndexCounts[gIter] = indexCount;
+			OK = (groupIndices[gIter] != NULL);
+			
+			if (OK)
+			{
+				if ([faceGroup internal_packedIndexArray] != nil)
+				{
+					OK = [self priv_addPackedFaceGroup:faceGroup toTable:&table indices:groupIndices[gIter]];
+				}
+				else
+				{
+					OK = [self priv_addFaceGroup:faceGroup toTable:&table indices:groupIndices[gIter]];
+				}
+			}
+		}
+		
+		_vertexCount = table.count;
+		_useCounts = table.useCounts;
+		table.useCounts = NULL;
+		
+		if (OK)
+		{
+			//	Hand streams over to float arrays.
+			NSMutableDictionary *attributeArrays = [NSMutableDictionary dictionaryWithCapacity:_attributeCount];
+			_homogeneous = YES;
+			
+			for (aIter = 0; aIter < _attributeCount; aIter++)
+			{
+				NSUInteger size = _attributeSizes[aIter];
+				OOFloatArray *array = nil;
+				if (_vertexCount * size != 0)
+				{
+					array = [OOFloatArray arrayWithFloatsNoCopy:table.streams[aIter] count:_vertexCount * size freeWhenDone:YES];
+				}
+				else
+				{
+					free(table.streams[aIter]);
+					array = [OOFloatArray array];
+				}
+				table.streams[aIter] = NULL;
+				
+				// NoCopy is only a hint, so always read back through the array.
+				_streams[aIter] = [array floatData];
+				[attributeArrays setObject:array forKey:[_attributeKeys objectAtIndex:aIter]];
+				
+				_lengths[aIter] = table.lengths[aIter];
+				table.lengths[aIter] = NULL;
+				
+				for (NSUInteger vIter = 0; _homogeneous && vIter < _vertexCount; vIter++)
+				{
+					if (_lengths[aIter][vIter] != size + 1)  _homogeneous = NO;
+				}
+			}
+			
+			_attributeArrays = [attributeArrays copy];
+			
+			NSMutableArray *indexArrays = [NSMutableArray arrayWithCapacity:groupCount];
+			for (gIter = 0; gIter < groupCount; gIter++)
+			{
+				OOIndexArray *indexArray = [OOIndexArray newWithUnsignedIntsNoCopy:groupIndices[gIter]
+																			 count:groupIndexCounts[gIter]
+																		   maximum:_vertexCount
+																	  freeWhenDone:YES];
+				groupIndices[gIter] = NULL;
+				if (EXPECT_NOT(indexArray == nil))
+				{
+					OK = NO;
+					break;
+				}
+				
+				[indexArrays addObject:indexArray];
+				[indexArray release];
+			}
+			
+			_indexArrays = [indexArrays copy];
+		}
+		
+		for (gIter = 0; gIter < groupCount; gIter++)
+		{
+			free(groupIndices[gIter]);
+		}
+		VertexTableDestroy(&table);
+		
+		if (EXPECT_NOT(!OK))
+		{
+			[self release];
+			return nil;
+		}
+	}
+	
+	return self;
+}
+
+
+- (void) dealloc
+{
+	NSUInteger i;
+	
+	if (_lengths != NULL)
+	{
+		for (i = 0; i < _attributeCount; i++)  free(_lengths[i]);
+		free(_lengths);
+	}
+	
+	// Stream data belongs to _attributeArrays.
+	free(_streams);
+	free(_attributeSizes);
+	free(_useCounts);
+	
+	DESTROY(_vertexSchema);
+	DESTROY(_attributeKeys);
+	DESTROY(_attributeArrays);
+	DESTROY(_indexArrays);
+	
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%lu vertices, %lu groups", (unsigned long)_vertexCount, (unsigned long)[_indexArrays count]];
+}
+
+
+- (NSUInteger) vertexCount
+{
+	return _vertexCount;
+}
+
+
+- (NSDictionary *) vertexSchema
+{
+	return _vertexSchema;
+}
+
+
+- (NSArray *) attributeKeys
+{
+	return _attributeKeys;
+}
+
+
+- (NSDictionary *) attributeArrays
+{
+	return _attributeArrays;
+}
+
+
+- (OOFloatArray *) attributeArrayForKey:(NSString *)key
+{
+	return [_attributeArrays objectForKey:key];
+}
+
+
+- (NSUInteger) attributeSizeForKey:(NSString *)key
+{
+	return [_vertexSchema oo_unsignedIntegerForKey:key];
+}
+
+
+- (BOOL) isHomogeneous
+{
+	return _homogeneous;
+}
+
+
+- (NSUInteger) groupCount
+{
+	return [_indexArrays count];
+}
+
+
+- (NSArray *) indexArrays
+{
+	return _indexArrays;
+}
+
+
+- (OOIndexArray *) indexArrayForGroupAtIndex:(NSUInteger)index
+{
+	return [_indexArrays objectAtIndex:index];
+}
+
+
+- (NSUInteger) useCountForVertexAtIndex:(NSUInteger)index
+{
+	if (EXPECT_NOT(index >= _vertexCount))  return 0;
+	return _useCounts[index];
+}
+
+
+- (OOAbstractVertex *) vertexAtIndex:(NSUInteger)index
+{
+	if (EXPECT_NOT(index >= _vertexCount))  return nil;
+	
+	NSString *keys[_attributeCount + 1];
+	OOFloatArray *values[_attributeCount + 1];
+	NSUInteger aIter, count = 0;
+	
+	for (aIter = 0; aIter < _attributeCount; aIter++)
+	{
+		NSUInteger length = _lengths[aIter][index];
+		if (length == 0)  continue;
+		
+		keys[count] = [_attributeKeys objectAtIndex:aIter];
+		values[count] = [OOFloatArray arrayWithFloats:_streams[aIter] + index * _attributeSizes[aIter] count:length - 1];
+		count++;
+	}
+	
+	return [OOAbstractVertex vertexWithAttributes:[NSDictionary dictionaryWithObjects:values forKeys:keys count:count]];
+}
+
+
+- (BOOL) priv_addFaceGroup:(OOAbstractFaceGroup *)faceGroup toTable:(VertexTable *)table indices:(GLuint *)indices
+{
+	NSAutoreleasePool		*pool = [NSAutoreleasePool new];
+	float					row[table->rowSize + 1];
+	uint16_t				rowLengths[_attributeCount + 1];
+	OOAbstractFace			*face = nil;
+	NSUInteger				aIter, faceIter = 0;
+	BOOL					OK = YES;
+	
+	foreach (face, faceGroup)
+	{
+		OOAbstractVertex *vertices[3];
+		[face getVertices:vertices];
+		
+		for (unsigned vIter = 0; OK && vIter < 3; vIter++)
+		{
+			float *next = row;
+			for (aIter = 0; aIter < _attributeCount; aIter++)
+			{
+				NSUInteger size = _attributeSizes[aIter];
+				OOFloatArray *attr = [vertices[vIter] attributeForKey:[_attributeKeys objectAtIndex:aIter]];
+				NSUInteger count = 0;
+				
+				if (attr != nil)
+				{
+					if (EXPECT_NOT(![attr isKindOfClass:[OOFloatArray class]]))  attr = [OOFloatArray arrayWithArray:attr];
+					count = MIN([attr count], size);
+					memcpy(next, [attr floatData], count * sizeof (float));
+					rowLengths[aIter] = count + 1;
+				}
+				else
+				{
+					rowLengths[aIter] = 0;
+				}
+				
+				memset(next + count, 0, (size - count) * sizeof (float));
+				next += size;
+			}
+			
+			NSUInteger index = VertexTableAdd(table, row, rowLengths);
+			OK = (index != NSNotFound);
+			*indices++ = index;
+		}
+		
+		if (!OK)  break;
+		
+		if (++faceIter % kFacesPerPool == 0)
+		{
+			[pool drain];
+			pool = [NSAutoreleasePool new];
+		}
+	}
+	
+	[pool drain];
+	return OK;
+}
+
+
+/*	Fast path for groups still in the packed form they were loaded in. Each
+	source vertex is uniqued once and the result is remembered, since source
+	vertices are normally shared between several faces.
+*/
+- (BOOL) priv_addPackedFaceGroup:(OOAbstractFaceGroup *)faceGroup toTable:(VertexTable *)table indices:(GLuint *)indices
+{
+	NSDictionary			*sourceArrays = [faceGroup internal_packedAttributeArrays];
+	OOIndexArray			*sourceIndices = [faceGroup internal_packedIndexArray];
+	NSUInteger				sourceVertexCount = [faceGroup internal_packedVertexCount];
+	const float				*sources[_attributeCount + 1];
+	NSUInteger				sourceStrides[_attributeCount + 1];
+	NSUInteger				sourceSizes[_attributeCount + 1];
+	float					row[table->rowSize + 1];
+	uint16_t				rowLengths[_attributeCount + 1];
+	NSUInteger				aIter, iIter, indexCount = [sourceIndices count];
+	NSUInteger				*memo = NULL;
+	
+	if (sourceVertexCount == 0)  return indexCount == 0;
+	
+	for (aIter = 0; aIter < _attributeCount; aIter++)
+	{
+		OOFloatArray *array = [sourceArrays objectForKey:[_attributeKeys objectAtIndex:aIter]];
+		if (array != nil)
+		{
+			sources[aIter] = [array floatData];
+			sourceStrides[aIter] = [array count] / sourceVertexCount;
+			sourceSizes[aIter] = MIN(sourceStrides[aIter], _attributeSizes[aIter]);
+		}
+		else
+		{
+			sources[aIter] = NULL;
+			sourceStrides[aIter] = 0;
+			sourceSizes[aIter] = 0;
+		}
+	}
+	
+	memo = malloc(sourceVertexCount * sizeof *memo + 1);
+	if (EXPECT_NOT(memo == NULL))  return NO;
+	for (iIter = 0; iIter < sourceVertexCount; iIter++)  memo[iIter] = NSNotFound;
+	
+	for (iIter = 0; iIter < indexCount; iIter++)
+	{
+		NSUInteger sourceIndex = [sourceIndices unsignedIntAtIndex:iIter];
+		NSUInteger index = memo[sourceIndex];
+		
+		if (index == NSNotFound)
+		{
+			float *next = row;
+			for (aIter = 0; aIter < _attributeCount; aIter++)
+			{
+				NSUInteger size = _attributeSizes[aIter];
+				NSUInteger count = sourceSizes[aIter];
+				
+				if (sources[aIter] != NULL)
+				{
+					memcpy(next, sources[aIter] + sourceIndex * sourceStrides[aIter], count * sizeof (float));
+					rowLengths[aIter] = count + 1;
+				}
+				else
+				{
+					rowLengths[aIter] = 0;
+				}
+				
+				memset(next + count, 0, (size - count) * sizeof (float));
+				next += size;
+			}
+			
+			index = VertexTableAdd(table, row, rowLengths);
+			if (EXPECT_NOT(index == NSNotFound))
+			{
+				free(memo);
+				return NO;
+			}
+			memo[sourceIndex] = index;
+		}
+		else
+		{
+			table->useCounts[index]++;
+		}
+		
+		*indices++ = index;
+	}
+	
+	free(memo);
+	return YES;
+}
+
+@end
+
+
+static BOOL VertexTableInit(VertexTable *table, NSUInteger attributeCount, const NSUInteger *sizes)
+{
+	NSUInteger i;
+	
+	memset(table, 0, sizeof *table);
+	table->attributeCount = attributeCount;
+	table->sizes = sizes;
+	for (i = 0; i < attributeCount; i++)  table->rowSize += sizes[i];
+	
+	table->streams = calloc(attributeCount + 1, sizeof *table->streams);
+	table->lengths = calloc(attributeCount + 1, sizeof *table->lengths);
+	table->table = malloc(kInitialVertexCapacity * 2 * sizeof *table->table);
+	if (EXPECT_NOT(table->streams == NULL || table->lengths == NULL || table->table == NULL))
+	{
+		VertexTableDestroy(table);
+		return NO;
+	}
+	
+	table->tableMask = kInitialVertexCapacity * 2 - 1;
+	for (i = 0; i <= table->tableMask; i++)  table->table[i] = kEmptySlot;
+	
+	return YES;
+}
+
+
+static void VertexTableDestroy(VertexTable *table)
+{
+	NSUInteger i;
+	
+	for (i = 0; i < table->attributeCount; i++)
+	{
+		if (table->streams != NULL)  free(table->streams[i]);
+		if (table->lengths != NULL)  free(table->lengths[i]);
+	}
+	free(table->streams);
+	free(table->lengths);
+	free(table->hashes);
+	free(table->useCounts);
+	free(table->table);
+	
+	memset(table, 0, sizeof *table);
+}
+
+
+static BOOL VertexTableGrowStorage(VertexTable *table)
+{
+	NSUInteger i, capacity = table->capacity ? table->capacity * 2 : kInitialVertexCapacity;
+	if (EXPECT_NOT(capacity >= kEmptySlot))  return NO;
+	
+	for (i = 0; i < table->attributeCount; i++)
+	{
+		float *stream = realloc(table->streams[i], capacity * table->sizes[i] * sizeof (float) + 1);
+		if (EXPECT_NOT(stream == NULL))  return NO;
+		table->streams[i] = stream;
+		
+		uint16_t *lengths = realloc(table->lengths[i], capacity * sizeof (uint16_t));
+		if (EXPECT_NOT(lengths == NULL))  return NO;
+		table->lengths[i] = lengths;
+	}
+	
+	uint32_t *hashes = realloc(table->hashes, capacity * sizeof *hashes);
+	if (EXPECT_NOT(hashes == NULL))  return NO;
+	table->hashes = hashes;
+	
+	NSUInteger *useCounts = realloc(table->useCounts, capacity * sizeof *useCounts);
+	if (EXPECT_NOT(useCounts == NULL))  return NO;
+	table->useCounts = useCounts;
+	
+	table->capacity = capacity;
+	return YES;
+}
+
+
+static BOOL VertexTableGrowHash(VertexTable *table)
+{
+	NSUInteger i, size = (table->tableMask + 1) * 2;
+	uint32_t *slots = malloc(size * sizeof *slots);
+	if (EXPECT_NOT(slots == NULL))  return NO;
+	
+	for (i = 0; i < size; i++)  slots[i] = kEmptySlot;
+	for (i = 0; i < table->count; i++)
+	{
+		NSUInteger slot = table->hashes[i] & (size - 1);
+		while (slots[slot] != kEmptySlot)  slot = (slot + 1) & (size - 1);
+		slots[slot] = i;
+	}
+	
+	free(table->table);
+	table->table = slots;
+	table->tableMask = size - 1;
+	return YES;
+}
+
+
+OOINLINE BOOL VertexTableRowIsEqual(VertexTable *table, NSUInteger index, const float *row, const uint16_t *rowLengths)
+{
+	for (NSUInteger i = 0; i < table->attributeCount; i++)
+	{
+		NSUInteger size = table->sizes[i];
+		if (table->lengths[i][index] != rowLengths[i])  return NO;
+		if (memcmp(table->streams[i] + index * size, row, size * sizeof (float)) != 0)  return NO;
+		row += size;
+	}
+	return YES;
+}
+
+
+/*	Returns the index of the vertex, adding it if it hasn’t been seen before,
+	or NSNotFound if memory runs out.
+
+	Matches the semantics of -[OOAbstractVertex isEqual:]: floats must have the
+	same bits (so 0 and -0 are different, as they hash differently), and NaN
+	is never equal to anything, so vertices containing NaNs are never merged.
+*/
+static NSUInteger VertexTableAdd(VertexTable *table, const float *row, const uint16_t *rowLengths)
+{
+	BOOL hasNaN;
+	uint32_t hash = HashRow(row, table->rowSize, rowLengths, table->attributeCount, &hasNaN);
+	NSUInteger slot = hash & table->tableMask;
+	
+	if (!hasNaN)
+	{
+		uint32_t index;
+		while ((index = table->table[slot]) != kEmptySlot)
+		{
+			if (table->hashes[index] == hash && VertexTableRowIsEqual(table, index, row, rowLengths))
+			{
+				table->useCounts[index]++;
+				return index;
+			}
+			slot = (slot + 1) & table->tableMask;
+		}
+	}
+	
+	// New vertex.
+	if (table->count == table->capacity && !VertexTableGrowStorage(table))  return NSNotFound;
+	
+	NSUInteger i, index = table->count++;
+	for (i = 0; i < table->attributeCount; i++)
+	{
+		NSUInteger size = table->sizes[i];
+		memcpy(table->streams[i] + index * size, row, size * sizeof (float));
+		table->lengths[i][index] = rowLengths[i];
+		row += size;
+	}
+	table->hashes[index] = hash;
+	table->useCounts[index] = 1;
+	
+	if (table->count * 2 > table->tableMask + 1)
+	{
+		// Rehashing also inserts the new vertex.
+		if (!VertexTableGrowHash(table))  return NSNotFound;
+	}
+	else
+	{
+		if (hasNaN)
+		{
+			// Didn’t probe, so find a free slot.
+			while (table->table[slot] != kEmptySlot)  slot = (slot + 1) & table->tableMask;
+		}
+		table->table[slot] = index;
+	}
+	
+	return index;
+}
+
+
+//	FNV-1a over the raw bits of the row and the attribute lengths, with the MurmurHash3 finalizer.
+static uint32_t HashRow(const float *row, NSUInteger rowSize, const uint16_t *rowLengths, NSUInteger attributeCount, BOOL *outHasNaN)
+{
+	uint32_t hash = 2166136261U;
+	BOOL hasNaN = NO;
+	NSUInteger i;
+	
+	for (i = 0; i < rowSize; i++)
+	{
+		uint32_t bits;
+		memcpy(&bits, &row[i], sizeof bits);
+		hash = (hash ^ bits) * 16777619U;
+		
+		// NaN: all exponent bits set and non-zero mantissa.
+		if ((bits & 0x7FFFFFFFU) > 0x7F800000U)  hasNaN = YES;
+	}
+	
+	for (i = 0; i < attributeCount; i++)
+	{
+		hash = (hash ^ rowLengths[i]) * 16777619U;
+	}
+	
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6BU;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35U;
+	hash ^= hash >> 16;
+	
+	*outHasNaN = hasNaN;
+	return hash;
+}
+
+#endif	// OOLITE_LEAN
@@ -0,0 +1,168 @@
+/*
+	OOBinaryMeshDefinitions.h
+
+	Layout of binary mesh files (.oobmesh).
+
+	A binary mesh holds the same data as an .oomesh file, laid out so that a
+	reader can map the file and use the vertex and index data in place. All
+	values are little-endian. All offsets are from the start of the file.
+
+	The file consists of:
+	  • An OOBinaryMeshHeader.
+	  • attributeCount OOBinaryMeshAttributes, starting at headerSize.
+	  • groupCount OOBinaryMeshGroups, immediately following the attributes.
+	  • The sections referred to by the header and descriptors, in any order.
+	    Vertex and index data sections are aligned to
+	    kOOBinaryMeshDataAlignment bytes.
+
+	Sections:
+	  • strings: UTF-8 text referred to by OOBinaryMeshStrings. Strings are
+	    not null-terminated.
+	  • materials: an XML property list. This is an array of materialCount
+	    dictionaries, each with a "name" string and a "properties" dictionary
+	    in the same format as the materials section of an .oomesh file.
+	  • octree: optional precomputed collision octree. The format of this is
+	    defined by the game, not by OoliteGraphics; readers that don’t
+	    understand it ignore it.
+	  • Each attribute’s data: vertexCount * size floats.
+	  • Each group’s data: indexCount indices of elementSize bytes each.
+
+	Readers must reject files with a different version. A later version with
+	a larger header may be read by an older reader only if the version is
+	unchanged, so fields may only be added to the end of the header.
+
+
+	Copyright © 2011 Jens Ayton.
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the “Software”),
+	to deal in the Software without restriction, including without limitation
+	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+	and/or sell copies of the Software, and to permit persons to whom the
+	Software is furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define kOOBinaryMeshMagic				"OOBMESH\x1A"
+#define kOOBinaryMeshFileExtension		@"oobmesh"
+
+// Keys in material dictionaries.
+#define kOOBinaryMeshMaterialNameKey	@"name"
+#define kOOBinaryMeshMaterialPropertiesKey	@"properties"
+
+
+enum
+{
+	kOOBinaryMeshVersion			= 1,
+	kOOBinaryMeshDataAlignment		= 16,
+	kOOBinaryMeshNoString			= 0xFFFFFFFFU
+};
+
+
+enum
+{
+	kOOBinaryMeshHasBoundingBox		= 0x00000001U,
+	kOOBinaryMeshHasOctree			= 0x00000002U
+};
+
+
+typedef struct
+{
+	uint32_t			offset;		// Relative to the strings section; kOOBinaryMeshNoString for nil.
+	uint32_t			length;		// In bytes.
+} OOBinaryMeshString;
+
+
+typedef struct
+{
+	uint32_t			offset;
+	uint32_t			size;		// In bytes.
+} OOBinaryMeshSection;
+
+
+typedef struct
+{
+	char				magic[8];	// kOOBinaryMeshMagic
+	uint32_t			version;
+	uint32_t			headerSize;
+	uint32_t			flags;
+	
+	uint32_t			vertexCount;
+	uint32_t			attributeCount;
+	uint32_t			groupCount;
+	uint32_t			materialCount;
+	
+	OOBinaryMeshString	name;
+	OOBinaryMeshString	description;
+	
+	OOBinaryMeshSection	strings;
+	OOBinaryMeshSection	materials;
+	OOBinaryMeshSection	octree;		// Only if flags & kOOBinaryMeshHasOctree.
+	
+	float				boundsMin[3];	// Only if flags & kOOBinaryMeshHasBoundingBox.
+	float				boundsMax[3];
+} OOBinaryMeshHeader;
+
+
+typedef struct
+{
+	OOBinaryMeshString	name;
+	uint32_t			size;		// Floats per vertex.
+	OOBinaryMeshSection	data;
+} OOBinaryMeshAttribute;
+
+
+typedef struct
+{
+	OOBinaryMeshString	name;
+	uint32_t			material;	// Index into the materials array.
+	uint32_t			indexCount;	// Multiple of three.
+	uint32_t			elementSize;	// 1, 2 or 4.
+	OOBinaryMeshSection	data;
+} OOBinaryMeshGroup;
+
+
+//	Byte order conversion for header fields and data.
+OOINLINE uint32_t OOBinaryMeshSwap32(uint32_t value)
+{
+#if OOLITE_BIG_ENDIAN
+	return ((value & 0xFF) << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+#else
+	return value;
+#endif
+}
+
+
+OOINLINE uint16_t OOBinaryMeshSwap16(uint16_t value)
+{
+#if OOLITE_BIG_ENDIAN
+	return (value << 8) | (value >> 8);
+#else
+	return value;
+#endif
+}
+
+
+OOINLINE float OOBinaryMeshSwapFloat(float value)
+{
+#if OOLITE_BIG_ENDIAN
+	union { float f; uint32_t u; } bits = { value };
+	bits.u = OOBinaryMeshSwap32(bits.u);
+	return bits.f;
+#else
+	return value;
+#endif
+}
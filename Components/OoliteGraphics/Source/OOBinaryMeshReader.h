@@ -0,0 +1,83 @@
+/*
+	OOBinaryMeshReader.h
+
+	Reader for binary mesh files (.oobmesh). See OOBinaryMeshDefinitions.h
+	for the format.
+
+	The file is memory-mapped, and on little-endian systems the vertex and
+	index data of the render mesh refer directly to the mapping; nothing is
+	parsed or converted except the header, descriptors and materials.
+
+
+	Copyright © 2011 Jens Ayton.
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the “Software”),
+	to deal in the Software without restriction, including without limitation
+	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+	and/or sell copies of the Software, and to permit persons to whom the
+	Software is furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+
+#import "OOMeshReading.h"
+
+
+@interface OOBinaryMeshReader: NSObject <OOMeshReading>
+{
+@private
+	id <OOProblemReporting>			_issues;
+	NSString						*_path;
+	NSData							*_data;
+	BOOL							_parsed;
+	
+	OORenderMesh					*_renderMesh;
+	
+	NSString						*_meshName;
+	NSString						*_meshDescription;
+	
+	NSUInteger						_vertexCount;
+	NSMutableDictionary				*_attributeArrays;
+	
+	NSMutableArray					*_groupIndexArrays;
+	NSMutableArray					*_groupMaterials;
+	NSMutableArray					*_groupNames;
+	
+	OOBoundingBox					_boundingBox;
+	BOOL							_hasBoundingBox;
+	NSData							*_octreeData;
+}
+
+- (id) initWithPath:(NSString *)path
+   progressReporter:(id < OOProgressReporting>)progressReporter
+			 issues:(id <OOProblemReporting>)issues;
+
+- (void) parse;
+
+#if !OOLITE_LEAN
+- (OOAbstractMesh *) abstractMesh;
+
+- (NSString *) meshName;
+- (NSString *) meshDescription;
+#endif
+
+- (void) getRenderMesh:(OORenderMesh **)renderMesh andMaterialSpecs:(NSArray **)materialSpecifications;
+
+// Precomputed bounding box, if the file has one.
+- (BOOL) getBoundingBox:(OOBoundingBox *)outBox;
+
+// Precomputed octree data, or nil. The format is defined by the game.
+- (NSData *) octreeData;
+
+@end
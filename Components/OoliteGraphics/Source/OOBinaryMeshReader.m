@@ -0,0 +1,558 @@
+/*
+	OOBinaryMeshReader.m
+
+
+	Copyright © 2011 Jens Ayton.
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the “Software”),
+	to deal in the Software without restriction, including without limitation
+	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+	and/or sell copies of the Software, and to permit persons to whom the
+	Software is furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#import "OOBinaryMeshReader.h"
+#import "OOBinaryMeshDefinitions.h"
+
+#import "OOFloatArray.h"
+#import "OOIndexArray.h"
+#import "OORenderMesh.h"
+#import "OOMaterialSpecification.h"
+#import "OOAbstractMesh.h"
+
+
+enum
+{
+	// Same limits as OOMeshReader.
+	kMaximumVertexCount			= 500000000,
+	kMaximumFaceCount			= 500000000,
+};
+
+
+@interface OOBinaryMeshReader (OOPrivate)
+
+- (void) priv_reportFormatError:(NSString *)format, ...;
+
+- (BOOL) priv_readHeader:(OOBinaryMeshHeader *)header;
+- (NSString *) priv_stringForReference:(OOBinaryMeshString)reference header:(const OOBinaryMeshHeader *)header;
+- (NSArray *) priv_readMaterialsWithHeader:(const OOBinaryMeshHeader *)header;
+- (BOOL) priv_readAttributesWithHeader:(const OOBinaryMeshHeader *)header;
+- (BOOL) priv_readGroupsWithHeader:(const OOBinaryMeshHeader *)header materials:(NSArray *)materials;
+
+@end
+
+
+static BOOL SectionIsValid(OOBinaryMeshSection section, NSUInteger length);
+static BOOL IndicesAreValid(const void *indices, size_t elementSize, NSUInteger count, NSUInteger vertexCount);
+
+
+@implementation OOBinaryMeshReader
+
+- (id) initWithPath:(NSString *)path
+   progressReporter:(id < OOProgressReporting>)progressReporter
+			 issues:(id <OOProblemReporting>)issues
+{
+	if ((self = [super init]))
+	{
+		_issues = [issues retain];
+		_path = [path copy];
+		
+		if (_path == nil)  DESTROY(self);
+	}
+	
+	return self;
+}
+
+
+- (void) dealloc
+{
+	DESTROY(_issues);
+	DESTROY(_path);
+	DESTROY(_data);
+	DESTROY(_renderMesh);
+	
+	DESTROY(_meshName);
+	DESTROY(_meshDescription);
+	DESTROY(_attributeArrays);
+	DESTROY(_groupIndexArrays);
+	DESTROY(_groupMaterials);
+	DESTROY(_groupNames);
+	DESTROY(_octreeData);
+	
+	[super dealloc];
+}
+
+
+- (void) parse
+{
+	if (_parsed)  return;
+	_parsed = YES;
+	
+	NSAutoreleasePool *pool = [NSAutoreleasePool new];
+	
+	_attributeArrays = [[NSMutableDictionary alloc] init];
+	_groupIndexArrays = [[NSMutableArray alloc] init];
+	_groupMaterials = [[NSMutableArray alloc] init];
+	_groupNames = [[NSMutableArray alloc] init];
+	
+	NSError *error = nil;
+	_data = [[NSData oo_dataWithContentsOfFile:_path options:NSDataReadingMapped error:&error] retain];
+	if (_data == nil)
+	{
+		OOReportNSError(_issues, $sprintf(OOLocalizeProblemString(_issues, @"Could not read %@"), [[NSFileManager defaultManager] displayNameAtPath:_path]), error);
+	}
+	
+	OOBinaryMeshHeader header;
+	BOOL OK = (_data != nil) && [self priv_readHeader:&header];
+	
+	if (OK)
+	{
+		_vertexCount = header.vertexCount;
+		_meshName = [[self priv_stringForReference:header.name header:&header] retain];
+		_meshDescription = [[self priv_stringForReference:header.description header:&header] retain];
+		
+		NSArray *materials = [self priv_readMaterialsWithHeader:&header];
+		OK = (materials != nil) &&
+			 [self priv_readAttributesWithHeader:&header] &&
+			 [self priv_readGroupsWithHeader:&header materials:materials];
+	}
+	
+	if (OK && (header.flags & kOOBinaryMeshHasBoundingBox))
+	{
+		_boundingBox.min.x = OOBinaryMeshSwapFloat(header.boundsMin[0]);
+		_boundingBox.min.y = OOBinaryMeshSwapFloat(header.boundsMin[1]);
+		_boundingBox.min.z = OOBinaryMeshSwapFloat(header.boundsMin[2]);
+		_boundingBox.max.x = OOBinaryMeshSwapFloat(header.boundsMax[0]);
+		_boundingBox.max.y = OOBinaryMeshSwapFloat(header.boundsMax[1]);
+		_boundingBox.max.z = OOBinaryMeshSwapFloat(header.boundsMax[2]);
+		_hasBoundingBox = YES;
+	}
+	
+	if (OK && (header.flags & kOOBinaryMeshHasOctree))
+	{
+		if (SectionIsValid(header.octree, [_data length]))
+		{
+			_octreeData = [[_data subdataWithRange:NSMakeRange(header.octree.offset, header.octree.size)] retain];
+		}
+		else
+		{
+			OOReportWarning(_issues, @"Ignoring octree in %@ because it is outside the file.", [[NSFileManager defaultManager] displayNameAtPath:_path]);
+		}
+	}
+	
+	if (!OK)
+	{
+		[_attributeArrays removeAllObjects];
+		[_groupIndexArrays removeAllObjects];
+		[_groupMaterials removeAllObjects];
+		[_groupNames removeAllObjects];
+	}
+	
+	[pool drain];
+}
+
+
+#if !OOLITE_LEAN
+
+- (OOAbstractMesh *) abstractMesh
+{
+	OORenderMesh *renderMesh = nil;
+	[self getRenderMesh:&renderMesh andMaterialSpecs:NULL];
+	
+	OOAbstractMesh *mesh = [renderMesh abstractMeshWithMaterialSpecs:_groupMaterials];
+	
+	if (_meshName != nil)  [mesh setName:_meshName];
+	if (_meshDescription != nil)  [mesh setModelDescription:_meshDescription];
+	
+	NSUInteger i, count = [mesh faceGroupCount];
+	for (i = 0; i < count; i++)
+	{
+		id name = [_groupNames objectAtIndex:i];
+		if (name != [NSNull null])  [[mesh faceGroupAtIndex:i] setName:name];
+	}
+	
+	return mesh;
+}
+
+
+- (BOOL) prefersAbstractMesh
+{
+	return NO;
+}
+
+
+- (NSString *) meshName
+{
+	[self parse];
+	
+	return _meshName;
+}
+
+
+- (NSString *) meshDescription
+{
+	[self parse];
+	
+	return _meshDescription;
+}
+
+#endif
+
+
+- (void) getRenderMesh:(OORenderMesh **)renderMesh andMaterialSpecs:(NSArray **)materialSpecifications
+{
+	[self parse];
+	
+	if (renderMesh != NULL)
+	{
+		if (_renderMesh == nil)
+		{
+			if ([_attributeArrays count] > 0 && [_groupIndexArrays count] > 0)
+			{
+				_renderMesh = [[OORenderMesh alloc] initWithName:_meshName
+													 vertexCount:_vertexCount
+													  attributes:_attributeArrays
+														  groups:_groupIndexArrays];
+			}
+			else
+			{
+				_renderMesh = (id)[[NSNull null] retain];
+			}
+		}
+		
+		if (_renderMesh != (id)[NSNull null])
+		{
+			*renderMesh = _renderMesh;
+		}
+		else
+		{
+			*renderMesh = nil;
+		}
+	}
+	
+	if (materialSpecifications != NULL)
+	{
+		*materialSpecifications = _groupMaterials;
+	}
+}
+
+
+- (BOOL) getBoundingBox:(OOBoundingBox *)outBox
+{
+	[self parse];
+	
+	if (_hasBoundingBox && outBox != NULL)  *outBox = _boundingBox;
+	return _hasBoundingBox;
+}
+
+
+- (NSData *) octreeData
+{
+	[self parse];
+	
+	return _octreeData;
+}
+
+
+- (void) priv_reportFormatError:(NSString *)format, ...
+{
+	NSString *base = OOLocalizeProblemString(_issues, @"%@ is not a valid binary mesh: %@.");
+	format = OOLocalizeProblemString(_issues, format);
+	
+	va_list args;
+	va_start(args, format);
+	NSString *message = [[[NSString alloc] initWithFormat:format arguments:args] autorelease];
+	va_end(args);
+	
+	message = [NSString stringWithFormat:base, [[NSFileManager defaultManager] displayNameAtPath:_path], message];
+	[_issues addProblemOfType:kOOProblemTypeError message:message];
+}
+
+
+- (BOOL) priv_readHeader:(OOBinaryMeshHeader *)header
+{
+	NSUInteger length = [_data length];
+	
+	if (length < sizeof *header)
+	{
+		[self priv_reportFormatError:@"the file is too short"];
+		return NO;
+	}
+	
+	memcpy(header, [_data bytes], sizeof *header);
+	if (memcmp(header->magic, kOOBinaryMeshMagic, sizeof header->magic) != 0)
+	{
+		[self priv_reportFormatError:@"the file is not a binary mesh"];
+		return NO;
+	}
+	
+#if OOLITE_BIG_ENDIAN
+	uint32_t *words = (uint32_t *)((char *)header + sizeof header->magic);
+	NSUInteger i, count = (sizeof *header - sizeof header->magic) / sizeof (uint32_t);
+	for (i = 0; i < count; i++)  words[i] = OOBinaryMeshSwap32(words[i]);
+#endif
+	
+	if (header->version != kOOBinaryMeshVersion)
+	{
+		[self priv_reportFormatError:@"the file is version %u, but only version %u is supported", header->version, kOOBinaryMeshVersion];
+		return NO;
+	}
+	
+	if (header->headerSize < sizeof *header || header->headerSize % sizeof (uint32_t) != 0)
+	{
+		[self priv_reportFormatError:@"the header size is invalid"];
+		return NO;
+	}
+	
+	if (header->vertexCount >= kMaximumVertexCount)
+	{
+		[self priv_reportFormatError:@"the vertex count may not be more than %u", kMaximumVertexCount];
+		return NO;
+	}
+	
+	uint64_t descriptorsEnd = (uint64_t)header->headerSize +
+							  (uint64_t)header->attributeCount * sizeof (OOBinaryMeshAttribute) +
+							  (uint64_t)header->groupCount * sizeof (OOBinaryMeshGroup);
+	if (descriptorsEnd > length || !SectionIsValid(header->strings, length) || !SectionIsValid(header->materials, length))
+	{
+		[self priv_reportFormatError:@"the file is truncated"];
+		return NO;
+	}
+	
+	return YES;
+}
+
+
+- (NSString *) priv_stringForReference:(OOBinaryMeshString)reference header:(const OOBinaryMeshHeader *)header
+{
+	if (reference.offset == kOOBinaryMeshNoString)  return nil;
+	
+	if ((uint64_t)reference.offset + reference.length > header->strings.size)
+	{
+		[self priv_reportFormatError:@"a string is outside the string table"];
+		return nil;
+	}
+	
+	const char *bytes = (const char *)[_data bytes] + header->strings.offset + reference.offset;
+	return [[[NSString alloc] initWithBytes:bytes length:reference.length encoding:NSUTF8StringEncoding] autorelease];
+}
+
+
+- (NSArray *) priv_readMaterialsWithHeader:(const OOBinaryMeshHeader *)header
+{
+	NSData *plistData = [_data subdataWithRange:NSMakeRange(header->materials.offset, header->materials.size)];
+	NSArray *plist = [NSPropertyListSerialization propertyListFromData:plistData
+													  mutabilityOption:NSPropertyListImmutable
+																format:NULL
+													  errorDescription:NULL];
+	if (![plist isKindOfClass:[NSArray class]] || [plist count] != header->materialCount)
+	{
+		[self priv_reportFormatError:@"the materials could not be read"];
+		return nil;
+	}
+	
+	NSMutableArray *result = [NSMutableArray arrayWithCapacity:[plist count]];
+	NSDictionary *materialDict = nil;
+	foreach (materialDict, plist)
+	{
+		NSString *name = [materialDict oo_stringForKey:kOOBinaryMeshMaterialNameKey];
+		NSDictionary *properties = [materialDict oo_dictionaryForKey:kOOBinaryMeshMaterialPropertiesKey];
+		if (name == nil || properties == nil)
+		{
+			[self priv_reportFormatError:@"the materials could not be read"];
+			return nil;
+		}
+		
+		OOMaterialSpecification *material = [[OOMaterialSpecification alloc] initWithMaterialKey:name
+																	  propertyListRepresentation:properties
+																						  issues:_issues];
+		if (material == nil)  return nil;
+		
+		[result addObject:material];
+		[material release];
+	}
+	
+	return result;
+}
+
+
+- (BOOL) priv_readAttributesWithHeader:(const OOBinaryMeshHeader *)header
+{
+	const uint8_t *bytes = [_data bytes];
+	NSUInteger i, length = [_data length];
+	const uint8_t *descriptor = bytes + header->headerSize;
+	
+	for (i = 0; i < header->attributeCount; i++)
+	{
+		OOBinaryMeshAttribute attribute;
+		memcpy(&attribute, descriptor + i * sizeof attribute, sizeof attribute);
+#if OOLITE_BIG_ENDIAN
+		attribute.name.offset = OOBinaryMeshSwap32(attribute.name.offset);
+		attribute.name.length = OOBinaryMeshSwap32(attribute.name.length);
+		attribute.size = OOBinaryMeshSwap32(attribute.size);
+		attribute.data.offset = OOBinaryMeshSwap32(attribute.data.offset);
+		attribute.data.size = OOBinaryMeshSwap32(attribute.data.size);
+#endif
+		
+		NSString *name = [self priv_stringForReference:attribute.name header:header];
+		if (name == nil || [_attributeArrays objectForKey:name] != nil)
+		{
+			[self priv_reportFormatError:@"attribute %lu has a missing or duplicate name", (unsigned long)i];
+			return NO;
+		}
+		
+		uint64_t count = (uint64_t)header->vertexCount * attribute.size;
+		if (attribute.size == 0 || count * sizeof (float) != attribute.data.size || attribute.data.offset % sizeof (float) != 0 || !SectionIsValid(attribute.data, length))
+		{
+			[self priv_reportFormatError:@"the data for attribute \"%@\" is invalid", name];
+			return NO;
+		}
+		
+		const float *floats = (const float *)(bytes + attribute.data.offset);
+		OOFloatArray *array = nil;
+#if OOLITE_BIG_ENDIAN
+		uint32_t *swapped = malloc(attribute.data.size);
+		if (swapped == NULL)
+		{
+			OOReportError(_issues, @"Not enough memory to read %@.", [[NSFileManager defaultManager] displayNameAtPath:_path]);
+			return NO;
+		}
+		for (uint64_t j = 0; j < count; j++)  swapped[j] = OOBinaryMeshSwap32(((const uint32_t *)floats)[j]);
+		array = [OOFloatArray arrayWithFloatsNoCopy:(float *)swapped count:count freeWhenDone:YES];
+#else
+		array = [OOFloatArray arrayWithFloatsNoCopy:floats count:count owner:_data];
+#endif
+		
+		[_attributeArrays setObject:array forKey:name];
+	}
+	
+	return YES;
+}
+
+
+- (BOOL) priv_readGroupsWithHeader:(const OOBinaryMeshHeader *)header materials:(NSArray *)materials
+{
+	const uint8_t *bytes = [_data bytes];
+	NSUInteger i, length = [_data length];
+	const uint8_t *descriptor = bytes + header->headerSize + header->attributeCount * sizeof (OOBinaryMeshAttribute);
+	
+	for (i = 0; i < header->groupCount; i++)
+	{
+		OOBinaryMeshGroup group;
+		memcpy(&group, descriptor + i * sizeof group, sizeof group);
+#if OOLITE_BIG_ENDIAN
+		group.name.offset = OOBinaryMeshSwap32(group.name.offset);
+		group.name.length = OOBinaryMeshSwap32(group.name.length);
+		group.material = OOBinaryMeshSwap32(group.material);
+		group.indexCount = OOBinaryMeshSwap32(group.indexCount);
+		group.elementSize = OOBinaryMeshSwap32(group.elementSize);
+		group.data.offset = OOBinaryMeshSwap32(group.data.offset);
+		group.data.size = OOBinaryMeshSwap32(group.data.size);
+#endif
+		
+		NSString *name = [self priv_stringForReference:group.name header:header];
+		
+		if (group.material >= [materials count])
+		{
+			[self priv_reportFormatError:@"group %lu has an invalid material", (unsigned long)i];
+			return NO;
+		}
+		
+		if (group.indexCount % 3 != 0 || group.indexCount / 3 >= kMaximumFaceCount ||
+			(group.elementSize != 1 && group.elementSize != 2 && group.elementSize != 4) ||
+			(uint64_t)group.indexCount * group.elementSize != group.data.size ||
+			group.data.offset % group.elementSize != 0 ||
+			!SectionIsValid(group.data, length))
+		{
+			[self priv_reportFormatError:@"the data for group %lu is invalid", (unsigned long)i];
+			return NO;
+		}
+		
+		const void *indices = bytes + group.data.offset;
+		if (!IndicesAreValid(indices, group.elementSize, group.indexCount, header->vertexCount))
+		{
+			[self priv_reportFormatError:@"group %lu has vertex indices out of range", (unsigned long)i];
+			return NO;
+		}
+		
+		OOIndexArray *array = nil;
+#if OOLITE_BIG_ENDIAN
+		if (group.elementSize != 1)
+		{
+			GLuint *swapped = malloc(group.indexCount * sizeof (GLuint));
+			if (swapped == NULL)
+			{
+				OOReportError(_issues, @"Not enough memory to read %@.", [[NSFileManager defaultManager] displayNameAtPath:_path]);
+				return NO;
+			}
+			for (NSUInteger j = 0; j < group.indexCount; j++)
+			{
+				swapped[j] = (group.elementSize == 2) ? OOBinaryMeshSwap16(((const uint16_t *)indices)[j]) : OOBinaryMeshSwap32(((const uint32_t *)indices)[j]);
+			}
+			array = [OOIndexArray arrayWithUnsignedIntsNoCopy:swapped count:group.indexCount maximum:header->vertexCount freeWhenDone:YES];
+		}
+		else
+#endif
+		{
+			array = [OOIndexArray arrayWithIndicesNoCopy:indices elementSize:group.elementSize count:group.indexCount owner:_data];
+		}
+		
+		[_groupIndexArrays addObject:array];
+		[_groupMaterials addObject:[materials objectAtIndex:group.material]];
+		[_groupNames addObject:(name != nil) ? (id)name : (id)[NSNull null]];
+	}
+	
+	return YES;
+}
+
+@end
+
+
+static BOOL SectionIsValid(OOBinaryMeshSection section, NSUInteger length)
+{
+	return (uint64_t)section.offset + section.size <= length;
+}
+
+
+static BOOL IndicesAreValid(const void *indices, size_t elementSize, NSUInteger count, NSUInteger vertexCount)
+{
+	NSUInteger i;
+	
+	switch (elementSize)
+	{
+		case 1:
+		{
+			const uint8_t *values = indices;
+			for (i = 0; i < count; i++)  if (values[i] >= vertexCount)  return NO;
+			return YES;
+		}
+		
+		case 2:
+		{
+			const uint16_t *values = indices;
+			for (i = 0; i < count; i++)  if (OOBinaryMeshSwap16(values[i]) >= vertexCount)  return NO;
+			return YES;
+		}
+		
+		case 4:
+		{
+			const uint32_t *values = indices;
+			for (i = 0; i < count; i++)  if (OOBinaryMeshSwap32(values[i]) >= vertexCount)  return NO;
+			return YES;
+		}
+	}
+	
+	return NO;
+}
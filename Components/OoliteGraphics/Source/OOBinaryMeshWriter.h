@@ -0,0 +1,42 @@
+/*
+	OOBinaryMeshWriter.h
+	
+	Binary mesh (.oobmesh) format exporter. See OOBinaryMeshDefinitions.h.
+	
+	The octree is optional precomputed data for the game, stored as-is; pass
+	nil to omit it.
+	
+	
+	Copyright © 2011 Jens Ayton.
+	
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the “Software”),
+	to deal in the Software without restriction, including without limitation
+	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+	and/or sell copies of the Software, and to permit persons to whom the
+	Software is furnished to do so, subject to the following conditions:
+	
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+	
+	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#if !OOLITE_LEAN
+
+#import <OoliteBase/OoliteBase.h>
+
+@protocol OOProblemReporting;
+@class OOAbstractMesh;
+
+
+NSData *OOBinaryMeshDataFromMesh(OOAbstractMesh *mesh, NSData *octree, id <OOProblemReporting> issues);
+BOOL OOWriteBinaryMesh(OOAbstractMesh *mesh, NSString *path, NSData *octree, id <OOProblemReporting> issues);
+
+#endif	// OOLITE_LEAN
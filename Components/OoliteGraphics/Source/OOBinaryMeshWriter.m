@@ -0,0 +1,322 @@
+/*
+	OOBinaryMeshWriter.m
+
+
+	Copyright © 2011 Jens Ayton.
+
+	Permission is hereby granted, free of charge, to any person obtaining a
+	copy of this software and associated documentation files (the “Software”),
+	to deal in the Software without restriction, including without limitation
+	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+	and/or sell copies of the Software, and to permit persons to whom the
+	Software is furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in
+	all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+	THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+	DEALINGS IN THE SOFTWARE.
+*/
+
+#if !OOLITE_LEAN
+
+#import "OOBinaryMeshWriter.h"
+#import "OOBinaryMeshDefinitions.h"
+#import "OOAbstractMesh.h"
+#import "OOAbstractMeshStreams.h"
+#import "OOFloatArray.h"
+#import "OOIndexArray.h"
+
+
+static OOBinaryMeshString AddString(NSMutableData *strings, NSString *string);
+OOINLINE uint64_t Align(uint64_t offset)  INLINE_CONST_FUNC;
+static void SwapWords(void *words, size_t size);
+
+
+BOOL OOWriteBinaryMesh(OOAbstractMesh *mesh, NSString *path, NSData *octree, id <OOProblemReporting> issues)
+{
+	NSAutoreleasePool *pool = [NSAutoreleasePool new];
+	BOOL OK = YES;
+	NSError *error = nil;
+	NSString *name = [path lastPathComponent];
+	
+	NSData *data = OOBinaryMeshDataFromMesh(mesh, octree, issues);
+	OK = (data != nil);
+	
+	if (OK)
+	{
+		OK = [data writeToFile:path options:NSAtomicWrite error:&error];
+		if (!OK)
+		{
+			OOReportNSError(issues, $sprintf(@"Could not write to file \"%@\"", name), error);
+		}
+	}
+	
+	[pool drain];
+	return OK;
+}
+
+
+NSData *OOBinaryMeshDataFromMesh(OOAbstractMesh *mesh, NSData *octree, id <OOProblemReporting> issues)
+{
+	if (mesh == nil)  return nil;
+	
+	OOAbstractMeshStreams		*streams = [mesh packedStreams];
+	if (EXPECT_NOT(streams == nil))
+	{
+		OOReportError(issues, @"Could not build vertex data for mesh \"%@\".", [mesh name]);
+		return nil;
+	}
+	
+	NSAutoreleasePool			*pool = [NSAutoreleasePool new];
+	NSUInteger					vertexCount = [streams vertexCount];
+	NSUInteger					i, groupCount = [mesh faceGroupCount];
+	OOAbstractFaceGroup			*faceGroup = nil;
+	
+	//	Unique materials by name, in order of first use.
+	NSMutableArray				*materialPList = [NSMutableArray array];
+	NSMutableDictionary			*materialIndices = [NSMutableDictionary dictionary];
+	uint32_t					*groupMaterials = calloc(groupCount + 1, sizeof *groupMaterials);
+	OOMaterialSpecification		*anonMaterial = nil;
+	
+	for (i = 0; i < groupCount; i++)
+	{
+		faceGroup = [mesh faceGroupAtIndex:i];
+		OOMaterialSpecification *material = [faceGroup material];
+		
+		if (material == nil)
+		{
+			// Generate a blank material.
+			if (anonMaterial == nil)
+			{
+				anonMaterial = [OOMaterialSpecification anonymousMaterial];
+			}
+			material = anonMaterial;
+		}
+		
+		NSString *materialKey = [material materialKey];
+		NSNumber *index = [materialIndices objectForKey:materialKey];
+		if (index == nil)
+		{
+			index = [NSNumber numberWithUnsignedInteger:[materialPList count]];
+			[materialIndices setObject:index forKey:materialKey];
+			
+			id properties = [material ja_propertyListRepresentation];
+			if (properties == nil)  properties = [NSDictionary dictionary];
+			[materialPList addObject:$dict(kOOBinaryMeshMaterialNameKey, materialKey, kOOBinaryMeshMaterialPropertiesKey, properties)];
+		}
+		groupMaterials[i] = [index unsignedIntValue];
+	}
+	
+	NSData *materialData = [NSPropertyListSerialization dataFromPropertyList:materialPList
+																	  format:NSPropertyListXMLFormat_v1_0
+															errorDescription:NULL];
+	if (materialData == nil)
+	{
+		OOReportError(issues, @"The materials of mesh \"%@\" could not be written.", [mesh name]);
+		free(groupMaterials);
+		[pool drain];
+		return nil;
+	}
+	
+	//	Same attributes as an .oomesh file.
+	NSDictionary *vertexSchema = [mesh vertexSchemaIgnoringTemporary];
+	if ([vertexSchema objectForKey:kOOSmoothGroupAttributeKey] != nil)
+	{
+		NSMutableDictionary *mutableSchema = [NSMutableDictionary dictionaryWithDictionary:vertexSchema];
+		[mutableSchema removeObjectForKey:kOOSmoothGroupAttributeKey];
+		vertexSchema = mutableSchema;
+	}
+	NSArray *attributeKeys = [[vertexSchema allKeys] sortedArrayUsingSelector:@selector(oo_compareByVertexAttributeOrder:)];
+	NSUInteger attributeCount = [attributeKeys count];
+	
+	//	Lay out the file: header, descriptors, strings, materials, octree, then the aligned data sections.
+	OOBinaryMeshHeader header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, kOOBinaryMeshMagic, sizeof header.magic);
+	header.version = kOOBinaryMeshVersion;
+	header.headerSize = sizeof header;
+	header.vertexCount = vertexCount;
+	header.attributeCount = attributeCount;
+	header.groupCount = groupCount;
+	header.materialCount = [materialPList count];
+	
+	NSMutableData *strings = [NSMutableData data];
+	header.name = AddString(strings, [mesh name]);
+	header.description = AddString(strings, [mesh modelDescription]);
+	
+	OOBinaryMeshAttribute *attributes = calloc(attributeCount + 1, sizeof *attributes);
+	OOBinaryMeshGroup *groups = calloc(groupCount + 1, sizeof *groups);
+	uint64_t offset = sizeof header + attributeCount * sizeof *attributes + groupCount * sizeof *groups;
+	
+	for (i = 0; i < attributeCount; i++)
+	{
+		attributes[i].name = AddString(strings, [attributeKeys objectAtIndex:i]);
+		attributes[i].size = [vertexSchema oo_unsignedIntegerForKey:[attributeKeys objectAtIndex:i]];
+	}
+	
+	for (i = 0; i < groupCount; i++)
+	{
+		OOIndexArray *indices = [streams indexArrayForGroupAtIndex:i];
+		groups[i].name = AddString(strings, [[mesh faceGroupAtIndex:i] name]);
+		groups[i].material = groupMaterials[i];
+		groups[i].indexCount = [indices count];
+		groups[i].elementSize = [indices elementSize];
+	}
+	free(groupMaterials);
+	
+	header.strings.offset = offset;
+	header.strings.size = [strings length];
+	offset += header.strings.size;
+	
+	header.materials.offset = offset;
+	header.materials.size = [materialData length];
+	offset += header.materials.size;
+	
+	if (octree != nil)
+	{
+		header.flags |= kOOBinaryMeshHasOctree;
+		header.octree.offset = offset;
+		header.octree.size = [octree length];
+		offset += header.octree.size;
+	}
+	
+	for (i = 0; i < attributeCount; i++)
+	{
+		offset = Align(offset);
+		attributes[i].data.offset = offset;
+		uint64_t size = (uint64_t)vertexCount * attributes[i].size * sizeof (float);
+		attributes[i].data.size = size;
+		offset += size;
+	}
+	
+	for (i = 0; i < groupCount; i++)
+	{
+		offset = Align(offset);
+		groups[i].data.offset = offset;
+		uint64_t size = (uint64_t)groups[i].indexCount * groups[i].elementSize;
+		groups[i].data.size = size;
+		offset += size;
+	}
+	
+	if (offset > UINT32_MAX || vertexCount > UINT32_MAX)
+	{
+		OOReportError(issues, @"Mesh \"%@\" is too large to be written as a binary mesh.", [mesh name]);
+		free(attributes);
+		free(groups);
+		[pool drain];
+		return nil;
+	}
+	
+	if (vertexCount > 0)
+	{
+		OOBoundingBox bbox = [mesh boundingBox];
+		header.flags |= kOOBinaryMeshHasBoundingBox;
+		header.boundsMin[0] = bbox.min.x;
+		header.boundsMin[1] = bbox.min.y;
+		header.boundsMin[2] = bbox.min.z;
+		header.boundsMax[0] = bbox.max.x;
+		header.boundsMax[1] = bbox.max.y;
+		header.boundsMax[2] = bbox.max.z;
+	}
+	
+	//	Fill in the data sections.
+	NSMutableData *result = [[NSMutableData alloc] initWithLength:offset];
+	uint8_t *bytes = [result mutableBytes];
+	
+	memcpy(bytes + header.strings.offset, [strings bytes], header.strings.size);
+	memcpy(bytes + header.materials.offset, [materialData bytes], header.materials.size);
+	if (octree != nil)  memcpy(bytes + header.octree.offset, [octree bytes], header.octree.size);
+	
+	for (i = 0; i < attributeCount; i++)
+	{
+		NSString *key = [attributeKeys objectAtIndex:i];
+		const uint32_t *src = (const uint32_t *)[[streams attributeArrayForKey:key] floatData];
+		uint32_t *dst = (uint32_t *)(bytes + attributes[i].data.offset);
+		NSUInteger size = attributes[i].size, stride = [streams attributeSizeForKey:key];
+		
+		if (!OOLITE_BIG_ENDIAN && size == stride)
+		{
+			memcpy(dst, src, attributes[i].data.size);
+		}
+		else
+		{
+			for (NSUInteger vertexIter = 0; vertexIter < vertexCount; vertexIter++)
+			{
+				for (NSUInteger elemIter = 0; elemIter < size; elemIter++)
+				{
+					*dst++ = OOBinaryMeshSwap32(src[vertexIter * stride + elemIter]);
+				}
+			}
+		}
+	}
+	
+	for (i = 0; i < groupCount; i++)
+	{
+		uint8_t *dst = bytes + groups[i].data.offset;
+		memcpy(dst, [[streams indexArrayForGroupAtIndex:i] data], groups[i].data.size);
+#if OOLITE_BIG_ENDIAN
+		NSUInteger j, count = groups[i].indexCount;
+		if (groups[i].elementSize == 2)
+		{
+			for (j = 0; j < count; j++)  ((uint16_t *)dst)[j] = OOBinaryMeshSwap16(((uint16_t *)dst)[j]);
+		}
+		else if (groups[i].elementSize == 4)
+		{
+			SwapWords(dst, groups[i].data.size);
+		}
+#endif
+	}
+	
+	//	Finally, the header and descriptors, which are all 32-bit words after the magic.
+	SwapWords((uint8_t *)&header + sizeof header.magic, sizeof header - sizeof header.magic);
+	SwapWords(attributes, attributeCount * sizeof *attributes);
+	SwapWords(groups, groupCount * sizeof *groups);
+	
+	memcpy(bytes, &header, sizeof header);
+	memcpy(bytes + sizeof header, attributes, attributeCount * sizeof *attributes);
+	memcpy(bytes + sizeof header + attributeCount * sizeof *attributes, groups, groupCount * sizeof *groups);
+	
+	free(attributes);
+	free(groups);
+	
+	[pool drain];
+	return [result autorelease];
+}
+
+
+static OOBinaryMeshString AddString(NSMutableData *strings, NSString *string)
+{
+	OOBinaryMeshString result = { kOOBinaryMeshNoString, 0 };
+	if (string == nil)  return result;
+	
+	NSData *utf8 = [string dataUsingEncoding:NSUTF8StringEncoding];
+	result.offset = [strings length];
+	result.length = [utf8 length];
+	[strings appendData:utf8];
+	
+	return result;
+}
+
+
+OOINLINE uint64_t Align(uint64_t offset)
+{
+	return (offset + kOOBinaryMeshDataAlignment - 1) & ~(uint64_t)(kOOBinaryMeshDataAlignment - 1);
+}
+
+
+static void SwapWords(void *words, size_t size)
+{
+#if OOLITE_BIG_ENDIAN
+	uint32_t *values = words;
+	size_t i, count = size / sizeof (uint32_t);
+	for (i = 0; i < count; i++)  values[i] = OOBinaryMeshSwap32(values[i]);
+#endif
+}
+
+#endif	// OOLITE_LEAN
@@ -53,9 +53,21 @@
 + (id) arrayWithFloatsNoCopy:(const float *)values count:(NSUInteger)count freeWhenDone:(BOOL)freeWhenDone OO_RETURNS_NOT_RETAINED;
 - (id) initWithFloatsNoCopy:(const float *)values count:(NSUInteger)count freeWhenDone:(BOOL)freeWhenDone;
 
+/*	Wrap values that belong to another object, such as a memory-mapped
+	NSData. The owner is retained for as long as the array uses the values.
+	As above, small arrays may be copied instead.
+*/
++ (id) newWithFloatsNoCopy:(const float *)values count:(NSUInteger)count owner:(id)owner;
++ (id) arrayWithFloatsNoCopy:(const float *)values count:(NSUInteger)count owner:(id)owner OO_RETURNS_NOT_RETAINED;
+
 //	Returns NaN if index is out of range.
 - (float) floatAtIndex:(NSUInteger)index;
 
+/*	NOTE: exposes internal pointer for speed. This does not outlive the
+	OOFloatArray, and writing to it would break the array’s immutability.
+*/
+- (const float *) floatData;
+
 /*	The default NSArray hash, at least under Mac OS X, is awful. However, a
 	subclass can't change the hash because it must be equal to the hash of
 	a normal NSArray with the corresponding NSNumbers.
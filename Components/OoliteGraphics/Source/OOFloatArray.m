@@ -83,11 +83,13 @@ enum
 	NSUInteger					_freeWhenDone: 1,
 								_count: ((sizeof (NSUInteger) * CHAR_BIT) - 1);
 	const float					*_floats;
+	id							_owner;
 }
 
 // Create a new array with allocated space and count but no values filled in.
 + (id) priv_newWithCapacity:(NSUInteger)count;
 - (id) priv_initWithFloatsNoCopy:(const float *)values count:(NSUInteger)count freeWhenDone:(BOOL)freeWhenDone;
+- (id) priv_initWithFloatsNoCopy:(const float *)values count:(NSUInteger)count owner:(id)owner;
 
 @end
 
@@ -219,6 +221,27 @@ static inline Class ClassForNormalArrayOfSize(NSUInteger size)
 }
 
 
++ (id) newWithFloatsNoCopy:(const float *)values count:(NSUInteger)count owner:(id)owner
+{
+	NSParameterAssert(values != NULL || count == 0);
+	
+	if (count > kMinExternCount && owner != nil)
+	{
+		return [[OOExternFloatArray alloc] priv_initWithFloatsNoCopy:values count:count owner:owner];
+	}
+	else
+	{
+		return [self newWithFloats:values count:count];
+	}
+}
+
+
++ (id) arrayWithFloatsNoCopy:(const float *)values count:(NSUInteger)count owner:(id)owner
+{
+	return [[self newWithFloatsNoCopy:values count:count owner:owner] autorelease];
+}
+
+
 - (id) copyWithZone:(NSZone *)zone
 {
 	return [self retain];
@@ -232,6 +255,12 @@ static inline Class ClassForNormalArrayOfSize(NSUInteger size)
 }
 
 
+- (const float *) floatData
+{
+	return [self priv_floatArray];
+}
+
+
 - (NSUInteger) betterHash
 {
 	NSUInteger hash = 5381;
@@ -375,6 +404,7 @@ static inline Class ClassForNormalArrayOfSize(NSUInteger size)
 	NSUInteger					_freeWhenDone: 1,
 								_count: ((sizeof (NSUInteger) * CHAR_BIT) - 1);
 	float						*_floats;
+	id							_owner;
 }
 #endif
 
@@ -408,6 +438,16 @@ static inline Class ClassForNormalArrayOfSize(NSUInteger size)
 }
 
 
+- (id) priv_initWithFloatsNoCopy:(const float *)values count:(NSUInteger)count owner:(id)owner
+{
+	if ((self = [self priv_initWithFloatsNoCopy:values count:count freeWhenDone:NO]))
+	{
+		_owner = [owner retain];
+	}
+	return self;
+}
+
+
 - (void) dealloc
 {
 	if (_freeWhenDone)
@@ -415,6 +455,7 @@ static inline Class ClassForNormalArrayOfSize(NSUInteger size)
 		free((void *)_floats);
 		_floats = NULL;
 	}
+	DESTROY(_owner);
 	
 	[super dealloc];
 }
@@ -48,6 +48,14 @@
 + (id) arrayWithUnsignedIntsNoCopy:(const GLuint *)values count:(GLuint)count maximum:(GLuint)maximum freeWhenDone:(BOOL)freeWhenDone OO_RETURNS_NOT_RETAINED;
 - (id) initWithUnsignedIntsNoCopy:(const GLuint *)values count:(GLuint)count maximum:(GLuint)maximum freeWhenDone:(BOOL)freeWhenDone;
 
+/*	Wrap index data that belongs to another object, such as a memory-mapped
+	NSData, without copying it. elementSize must be 1, 2 or 4; the values are
+	used as they are. The owner is retained for as long as the array uses the
+	data.
+*/
++ (id) newWithIndicesNoCopy:(const void *)values elementSize:(size_t)elementSize count:(GLuint)count owner:(id)owner;
++ (id) arrayWithIndicesNoCopy:(const void *)values elementSize:(size_t)elementSize count:(GLuint)count owner:(id)owner OO_RETURNS_NOT_RETAINED;
+
 - (GLenum) glType;
 - (size_t) elementSize;
 
@@ -31,9 +31,11 @@
 @private
 	GLuint					_count;
 	GLubyte					*_values;
+	id						_owner;
 }
 
 - (id) priv_initWithUnsignedInts:(const GLuint *)values count:(GLuint)count;
+- (id) priv_initWithValuesNoCopy:(const void *)values count:(GLuint)count owner:(id)owner;
 
 @end
 
@@ -43,9 +45,11 @@
 @private
 	GLuint					_count;
 	GLushort				*_values;
+	id						_owner;
 }
 
 - (id) priv_initWithUnsignedInts:(const GLuint *)values count:(GLuint)count;
+- (id) priv_initWithValuesNoCopy:(const void *)values count:(GLuint)count owner:(id)owner;
 
 @end
 
@@ -56,10 +60,12 @@
 	GLuint					_count;
 	GLuint					*_values;
 	BOOL					_freeWhenDone;
+	id						_owner;
 }
 
 - (id) priv_initWithUnsignedInts:(const GLuint *)values count:(GLuint)count;
 - (id) priv_initWithUnsignedIntsNoCopy:(const GLuint *)values count:(GLuint)count freeWhenDone:(BOOL)freeWhenDone;
+- (id) priv_initWithValuesNoCopy:(const void *)values count:(GLuint)count owner:(id)owner;
 
 @end
 
@@ -179,6 +185,38 @@
 }
 
 
++ (id) newWithIndicesNoCopy:(const void *)values elementSize:(size_t)elementSize count:(GLuint)count owner:(id)owner
+{
+	NSParameterAssert(values != NULL || count == 0);
+	
+	Class aClass = Nil;
+	switch (elementSize)
+	{
+		case sizeof (GLubyte):
+			aClass = [OOUByteIndexArray class];
+			break;
+			
+		case sizeof (GLushort):
+			aClass = [OOUShortIndexArray class];
+			break;
+			
+		case sizeof (GLuint):
+			aClass = [OOUIntIndexArray class];
+			break;
+			
+		default:
+			return nil;
+	}
+	return [[aClass alloc] priv_initWithValuesNoCopy:values count:count owner:owner];
+}
+
+
++ (id) arrayWithIndicesNoCopy:(const void *)values elementSize:(size_t)elementSize count:(GLuint)count owner:(id)owner
+{
+	return [[self newWithIndicesNoCopy:values elementSize:elementSize count:count owner:owner] autorelease];
+}
+
+
 + (id) array
 {
 	return [self arrayWithUnsignedInts:NULL count:0 maximum:0];
@@ -299,9 +337,23 @@
 }
 
 
+- (id) priv_initWithValuesNoCopy:(const void *)values count:(GLuint)count owner:(id)owner
+{
+	if ((self = [super priv_init]))
+	{
+		_values = (void *)values;
+		_count = count;
+		_owner = [owner retain];
+	}
+	
+	return self;
+}
+
+
 - (void) dealloc
 {
-	free(_values);
+	if (_owner == nil)  free(_values);
+	DESTROY(_owner);
 	
 	[super dealloc];
 }
@@ -309,7 +361,7 @@
 
 - (void) finalize
 {
-	free(_values);
+	if (_owner == nil)  free(_values);
 	
 	[super finalize];
 }
@@ -385,9 +437,23 @@
 }
 
 
+- (id) priv_initWithValuesNoCopy:(const void *)values count:(GLuint)count owner:(id)owner
+{
+	if ((self = [super priv_init]))
+	{
+		_values = (void *)values;
+		_count = count;
+		_owner = [owner retain];
+	}
+	
+	return self;
+}
+
+
 - (void) dealloc
 {
-	free(_values);
+	if (_owner == nil)  free(_values);
+	DESTROY(_owner);
 	
 	[super dealloc];
 }
@@ -395,7 +461,7 @@
 
 - (void) finalize
 {
-	free(_values);
+	if (_owner == nil)  free(_values);
 	
 	[super finalize];
 }
@@ -473,9 +539,21 @@
 }
 
 
+- (id) priv_initWithValuesNoCopy:(const void *)values count:(GLuint)count owner:(id)owner
+{
+	if ((self = [self priv_initWithUnsignedIntsNoCopy:values count:count freeWhenDone:NO]))
+	{
+		_owner = [owner retain];
+	}
+	
+	return self;
+}
+
+
 - (void) dealloc
 {
 	if (_freeWhenDone)  free(_values);
+	DESTROY(_owner);
 	
 	[super dealloc];
 }
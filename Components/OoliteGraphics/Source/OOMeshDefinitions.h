@@ -33,3 +33,9 @@
 #define kFaceCountKey			@"faceCount"
 #define kMeshDescriptionKey		@"description"
 #define kMaterialKey			@"material"
+
+// C string versions, for matching keys in streamed data without creating strings.
+#define kSizeKeyUTF8			"size"
+#define kDataKeyUTF8			"data"
+#define kFaceCountKeyUTF8		"faceCount"
+#define kMaterialKeyUTF8		"material"
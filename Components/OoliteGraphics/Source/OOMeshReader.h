@@ -44,8 +44,6 @@
 	NSString						*_meshName;
 	NSString						*_meshDescription;
 	
-	NSString						*_currentElementName;
-	
 	NSUInteger						_vertexCount;
 	NSMutableDictionary				*_attributeArrays;
 	
@@ -87,17 +87,53 @@ typedef enum
 - (BOOL)priv_readMaterialDictionaryNamed:(NSString *)name;
 
 - (BOOL) priv_attributesDictionaryParseEvent:(OOConfParserActionEventType)event key:(void *)key object:(id *)object;
-- (BOOL) priv_attributeParseEvent:(OOConfParserActionEventType)event key:(void *)key object:(id *)object;
-- (OOFloatArray *) priv_readAttributeDataWithDictionary:(NSMutableDictionary *)dictionary;
+- (BOOL) priv_readAttributeNamed:(NSString *)name;
 
 - (BOOL) priv_groupsDictionaryParseEvent:(OOConfParserActionEventType)event key:(void *)key object:(id *)object;
-- (BOOL) priv_groupParseEvent:(OOConfParserActionEventType)event key:(void *)key object:(id *)object;
-- (OOIndexArray *) priv_readGroupDataWithDictionary:(NSMutableDictionary *)dictionary;
-- (BOOL) priv_finishGroupWithDictionary:(NSMutableDictionary *)dictionary;
+- (BOOL) priv_readGroupNamed:(NSString *)name;
 
 @end
 
 
+/*	Attribute and group dictionaries are read with the streaming parser, so
+	that their data arrays are decoded straight into the final buffers without
+	creating an NSNumber (or anything else) per element.
+*/
+typedef enum
+{
+	kElementKeyOther,
+	kElementKeySize,		// "size" for attributes, "faceCount" for groups.
+	kElementKeyMaterial,
+	kElementKeyData
+} ElementKey;
+
+
+typedef struct
+{
+	OOMeshReader			*reader;
+	NSString				*name;
+	BOOL					isGroup;
+	NSUInteger				vertexCount;
+	
+	ElementKey				currentKey;
+	NSUInteger				size;
+	NSString				*materialKey;
+	
+	union
+	{
+		float				*floats;
+		GLuint				*indices;
+		void				*bytes;
+	}						data;
+	NSUInteger				count;
+	NSUInteger				index;
+} ElementStreamState;
+
+
+static BOOL ElementStreamHandler(const OOConfStreamEvent *event, void *context);
+static BOOL ElementDataEvent(const OOConfStreamEvent *event, ElementStreamState *state);
+
+
 @implementation OOMeshReader
 
 - (id) initWithPath:(NSString *)path
@@ -489,19 +525,43 @@ typedef enum
 			return YES;
 			
 		case kOOConfDictionaryElement:
-			_currentElementName = key;
-			BOOL result = [_parser parseWithDelegateAction:@selector(priv_attributeParseEvent:key:object:) result:object];
-			_currentElementName = nil;
-			return result;
+			return [self priv_readAttributeNamed:key];
 	}
 	
 	return NO;
 }
 
 
-- (BOOL) priv_attributeParseEvent:(OOConfParserActionEventType)event
-							  key:(void *)key
-						   object:(id *)object
+- (BOOL) priv_readAttributeNamed:(NSString *)name
+{
+	NSAssert(_vertexCount != NSNotFound, @"Vertex count should have been validated already");
+	
+	if (![_lexer getToken:kOOConfTokenOpenBrace])
+	{
+		[self priv_reportStructuralError:@"attribute \"%@\" must be a dictionary", name];
+		return NO;
+	}
+	
+	ElementStreamState state = { .reader = self, .name = name, .isGroup = NO, .vertexCount = _vertexCount };
+	if (![_parser parseWithStreamHandler:ElementStreamHandler context:&state])
+	{
+		free(state.data.bytes);
+		return NO;
+	}
+	
+	if (state.data.floats == NULL)
+	{
+		[self priv_reportStructuralError:@"Attribute \"%@\" has no vertex data", name];
+		return NO;
+	}
+	
+	[_attributeArrays setObject:[OOFloatArray arrayWithFloatsNoCopy:state.data.floats count:state.count freeWhenDone:YES]
+						 forKey:name];
+	return YES;
+}
+
+
+- (BOOL) priv_groupsDictionaryParseEvent:(OOConfParserActionEventType)event key:(void *)key object:(id *)object
 {
 	switch (event)
 	{
@@ -513,268 +573,210 @@ typedef enum
 			return NO;
 			
 		case kOOConfDictionaryBegin:
-			*object = [NSMutableDictionary dictionary];
-			return YES;
-			
 		case kOOConfDictionaryEnd:
-		{
-			OOFloatArray *attributeData = [*object objectForKey:kDataKey];
-			if (attributeData == nil)
-			{
-				[self priv_reportStructuralError:@"Attribute \"%@\" has no vertex data", _currentElementName];
-				return NO;
-			}
-			
-			[_attributeArrays setObject:attributeData forKey:_currentElementName];
-			[*object removeAllObjects];
-			return YES;
-		}
-			
 		case kOOConfDictionaryFailed:
+			// Ignore these events.
 			return YES;
 			
 		case kOOConfDictionaryElement:
-		{
-			id value = nil;
-			if ([kDataKey isEqualToString:key])
-			{
-				value = [self priv_readAttributeDataWithDictionary:*object];
-			}
-			else
-			{
-				value = [_parser parseAsPropertyList];
-			}
-			if (value == nil)  return NO;
-			[*object setObject:value forKey:key];
-			return YES;
-		}
+			return [self priv_readGroupNamed:key];
 	}
 	
 	return NO;
 }
 
 
-- (OOFloatArray *) priv_readAttributeDataWithDictionary:(NSMutableDictionary *)dictionary
+- (BOOL) priv_readGroupNamed:(NSString *)name
 {
-	NSUInteger size = [dictionary oo_unsignedIntegerForKey:kSizeKey];
-	if (size < 1 || 4 < size)
+	NSAssert(_vertexCount != NSNotFound, @"Vertex count should have been validated already.");
+	
+	if (![_lexer getToken:kOOConfTokenOpenBrace])
 	{
-		[self priv_reportStructuralError:@"attribute \"%@@\" does not specify a valid size (must be 1 to 4)", _currentElementName];
-		return nil;
+		[self priv_reportStructuralError:@"Mesh group \"%@\" must be a dictionary", name];
+		return NO;
 	}
-	NSAssert(_vertexCount != NSNotFound, @"Vertex count should have been validated already");
 	
-	OOConfLexer *lexer = _lexer;
-	if (![lexer getToken:kOOConfTokenOpenBracket])
+	ElementStreamState state = { .reader = self, .name = name, .isGroup = YES, .vertexCount = _vertexCount };
+	if (![_parser parseWithStreamHandler:ElementStreamHandler context:&state])
 	{
-		[self priv_reportBasicParseError:@"["];
-		return nil;
+		free(state.data.bytes);
+		return NO;
 	}
-	[lexer advance];
 	
-	NSUInteger i = 0, count = _vertexCount * size;
-	float *buffer = malloc(count * sizeof (float));
-	if (buffer == NULL)
+	// Groups must have materials.
+	OOMaterialSpecification *materialSpec = nil;
+	if (state.materialKey == nil)
 	{
-		[self priv_reportMallocFailure];
-		return nil;
+		[self priv_reportStructuralError:@"Mesh group \"%@\" does not specify a material", name];
 	}
-	
-	// Read <count> reals.
-	for (;;)
+	else
 	{
-		if (EXPECT_NOT(![lexer getFloat:&buffer[i]]))
+		materialSpec = [_materialsByName objectForKey:state.materialKey];
+		if (materialSpec == nil)
 		{
-			[self priv_reportBasicParseError:@"number"];
-			return nil;
+			[self priv_reportStructuralError:@"Mesh group \"%@\" specifies undefined material \"%@\"", name, state.materialKey];
 		}
-		
-		if (++i == count)  break;
-		
-		if (EXPECT_NOT(![lexer consumeToken:kOOConfTokenComma]))
-		{
-			[self priv_reportBasicParseError:@"\",\""];
-			return nil;
-		}
-		[lexer advance];
 	}
 	
-	if (![lexer consumeToken:kOOConfTokenCloseBracket])
+	if (materialSpec != nil && state.data.indices == NULL)
+	{
+		[self priv_reportStructuralError:@"Mesh group \"%@\" has no vertex index data", name];
+	}
+	
+	if (materialSpec == nil || state.data.indices == NULL)
 	{
-		[self priv_reportBasicParseError:@"\"]\""];
-		return nil;
+		free(state.data.bytes);
+		return NO;
 	}
 	
-	return [OOFloatArray arrayWithFloatsNoCopy:buffer count:count freeWhenDone:YES];
+	[_groupIndexArrays addObject:[OOIndexArray arrayWithUnsignedIntsNoCopy:state.data.indices
+																	 count:state.count
+																   maximum:_vertexCount
+															  freeWhenDone:YES]];
+	[_groupMaterials addObject:materialSpec];
 	
+	return YES;
 }
 
+@end
 
-- (BOOL) priv_groupsDictionaryParseEvent:(OOConfParserActionEventType)event key:(void *)key object:(id *)object
+
+static BOOL ElementStreamHandler(const OOConfStreamEvent *event, void *context)
 {
-	switch (event)
+	ElementStreamState *state = context;
+	
+	if (event->depth == 0)
 	{
-		case kOOConfArrayBegin:
-		case kOOConfArrayElement:
-		case kOOConfArrayEnd:
-		case kOOConfArrayFailed:
-			// Should have been checked already.
-			return NO;
-			
-		case kOOConfDictionaryBegin:
-		case kOOConfDictionaryEnd:
-		case kOOConfDictionaryFailed:
-			// Ignore these events.
-			return YES;
-			
-		case kOOConfDictionaryElement:
-			_currentElementName = key;
-			BOOL result = [_parser parseWithDelegateAction:@selector(priv_groupParseEvent:key:object:) result:object];
-			_currentElementName = nil;
-			return result;
+		// The attribute or group dictionary itself; checked by the caller.
+		return YES;
 	}
 	
-	return NO;
-}
-
-
-- (BOOL) priv_groupParseEvent:(OOConfParserActionEventType)event
-						  key:(void *)key
-					   object:(id *)object
-{
-	switch (event)
+	if (event->depth == 1 && event->type == kOOConfStreamKey)
 	{
-		case kOOConfArrayBegin:
-		case kOOConfArrayElement:
-		case kOOConfArrayEnd:
-		case kOOConfArrayFailed:
-			// Should have been checked already.
-			return NO;
-			
-		case kOOConfDictionaryBegin:
-			*object = [NSMutableDictionary dictionary];
-			return YES;
-			
-		case kOOConfDictionaryEnd:
-		{
-			BOOL OK = [self priv_finishGroupWithDictionary:*object];
-			[*object removeAllObjects];
-			return OK;
-		}
-			
-		case kOOConfDictionaryFailed:
+		if (OOConfStreamEventTextEquals(event, kDataKeyUTF8))  state->currentKey = kElementKeyData;
+		else if (OOConfStreamEventTextEquals(event, state->isGroup ? kFaceCountKeyUTF8 : kSizeKeyUTF8))  state->currentKey = kElementKeySize;
+		else if (state->isGroup && OOConfStreamEventTextEquals(event, kMaterialKeyUTF8))  state->currentKey = kElementKeyMaterial;
+		else  state->currentKey = kElementKeyOther;
+		return YES;
+	}
+	
+	switch (state->currentKey)
+	{
+		case kElementKeyOther:
+			// Unknown values, including any nested contents, are ignored.
 			return YES;
 			
-		case kOOConfDictionaryElement:
-		{
-			id value = nil;
-			if ([kDataKey isEqualToString:key])
+		case kElementKeySize:
+			// A size that isn't a natural is reported when the data is reached.
+			if (event->depth == 1 && event->type == kOOConfStreamNatural)
 			{
-				value = [self priv_readGroupDataWithDictionary:*object];
+				state->size = (event->value.natural <= NSUIntegerMax) ? (NSUInteger)event->value.natural : 0;
 			}
-			else
+			return YES;
+			
+		case kElementKeyMaterial:
+			if (event->depth == 1 && event->type == kOOConfStreamString)
 			{
-				value = [_parser parseAsPropertyList];
+				state->materialKey = [event->lexer currentTokenString];
 			}
-			if (value == nil)  return NO;
-			[*object setObject:value forKey:key];
 			return YES;
-		}
+			
+		case kElementKeyData:
+			return ElementDataEvent(event, state);
 	}
 	
 	return NO;
 }
 
 
-- (OOIndexArray *) priv_readGroupDataWithDictionary:(NSMutableDictionary *)dictionary
+static BOOL ElementDataEvent(const OOConfStreamEvent *event, ElementStreamState *state)
 {
-	NSUInteger size = [dictionary oo_unsignedIntegerForKey:kFaceCountKey];
-	if (size < 1 || kMaximumFaceCount < size)
-	{
-		[self priv_reportStructuralError:@"group \"%@\" does not specify a valid size (must be 1 to %u)", _currentElementName, kMaximumFaceCount];
-		return nil;
-	}
-	NSAssert(_vertexCount != NSNotFound, @"Vertex count should have been validated already.");
+	OOMeshReader *reader = state->reader;
 	
-	OOConfLexer *lexer = _lexer;
-	if (![lexer getToken:kOOConfTokenOpenBracket])
+	if (event->depth == 1)
 	{
-		[self priv_reportBasicParseError:@"["];
-		return nil;
-	}
-	[lexer advance];
-	
-	NSUInteger i = 0, count = 3 * size, vertexCount = _vertexCount;
-	GLuint *buffer = malloc(count * sizeof (GLuint));
-	if (buffer == NULL)
-	{
-		[self priv_reportMallocFailure];
-		return nil;
-	}
-	
-	// Read <count> integers.
-	for (;;)
-	{
-		uint64_t value;
-		if (EXPECT_NOT(![lexer getNatural:&value]))
+		if (event->type == kOOConfStreamArrayBegin)
 		{
-			[self priv_reportBasicParseError:@"integer"];
-			return nil;
+			size_t elementSize;
+			if (!state->isGroup)
+			{
+				if (state->size < 1 || 4 < state->size)
+				{
+					[reader priv_reportStructuralError:@"attribute \"%@\" does not specify a valid size (must be 1 to 4)", state->name];
+					return NO;
+				}
+				state->count = state->vertexCount * state->size;
+				elementSize = sizeof (float);
+			}
+			else
+			{
+				if (state->size < 1 || kMaximumFaceCount < state->size)
+				{
+					[reader priv_reportStructuralError:@"group \"%@\" does not specify a valid size (must be 1 to %u)", state->name, kMaximumFaceCount];
+					return NO;
+				}
+				state->count = 3 * state->size;
+				elementSize = sizeof (GLuint);
+			}
+			
+			free(state->data.bytes);
+			state->data.bytes = malloc(state->count * elementSize);
+			state->index = 0;
+			if (state->data.bytes == NULL)
+			{
+				[reader priv_reportMallocFailure];
+				return NO;
+			}
+			return YES;
 		}
-		if (EXPECT_NOT(value >= vertexCount))
+		else if (event->type == kOOConfStreamArrayEnd)
 		{
-			[self priv_reportParseError:@"vertex index %llu is out of range (vertex count is %lu)", (unsigned long long)value, (unsigned long)vertexCount];
-			return nil;
+			if (EXPECT_NOT(state->index != state->count))
+			{
+				[reader priv_reportBasicParseError:@"\",\""];
+				return NO;
+			}
+			return YES;
 		}
-		buffer[i] = value;
-		
-		if (++i == count)  break;
 		
-		if (EXPECT_NOT(![lexer consumeToken:kOOConfTokenComma]))
-		{
-			[self priv_reportBasicParseError:@"\",\""];
-			return nil;
-		}
-		[lexer advance];
-	}
-	
-	if (![lexer consumeToken:kOOConfTokenCloseBracket])
-	{
-		[self priv_reportBasicParseError:@"\"]\""];
-		return nil;
+		[reader priv_reportBasicParseError:@"["];
+		return NO;
 	}
 	
-	return [OOIndexArray arrayWithUnsignedIntsNoCopy:buffer count:count maximum:vertexCount freeWhenDone:YES];
-}
-
-
-- (BOOL) priv_finishGroupWithDictionary:(NSMutableDictionary *)dictionary
-{
-	// Groups must have materials.
-	NSString *materialKey = [dictionary oo_stringForKey:kMaterialKey];
-	if (materialKey == nil)
+	// Elements of the data array.
+	if (EXPECT_NOT(state->index == state->count))
 	{
-		[self priv_reportStructuralError:@"Mesh group \"%@\" does not specify a material", _currentElementName];
+		[reader priv_reportBasicParseError:@"\"]\""];
 		return NO;
 	}
-	OOMaterialSpecification *materialSpec = [_materialsByName objectForKey:materialKey];
-	if (materialSpec == nil)
+	
+	if (!state->isGroup)
 	{
-		[self priv_reportStructuralError:@"Mesh group \"%@\" specifies undefined material \"%@\"", _currentElementName, materialKey];
-		return NO;
+		/*	Converted straight from the token with strtof(); narrowing the
+			stream's double rounds twice, and can give a different float.
+		*/
+		float value;
+		if (EXPECT_NOT((event->type != kOOConfStreamReal && event->type != kOOConfStreamNatural) || ![event->lexer getFloat:&value]))
+		{
+			[reader priv_reportBasicParseError:@"number"];
+			return NO;
+		}
+		state->data.floats[state->index++] = value;
 	}
-	
-	OOIndexArray *data = [dictionary objectForKey:kDataKey];
-	if (data == nil)
+	else
 	{
-		[self priv_reportStructuralError:@"Mesh group \"%@\" has no vertex index data", _currentElementName];
-		return NO;
+		if (EXPECT_NOT(event->type != kOOConfStreamNatural))
+		{
+			[reader priv_reportBasicParseError:@"integer"];
+			return NO;
+		}
+		if (EXPECT_NOT(event->value.natural >= state->vertexCount))
+		{
+			[reader priv_reportParseError:@"vertex index %llu is out of range (vertex count is %lu)", (unsigned long long)event->value.natural, (unsigned long)state->vertexCount];
+			return NO;
+		}
+		state->data.indices[state->index++] = event->value.natural;
 	}
 	
-	[_groupIndexArrays addObject:data];
-	[_groupMaterials addObject:materialSpec];
-	
 	return YES;
 }
-
-@end
@@ -26,6 +26,8 @@
 #import "OOMeshReading.h"
 
 #import "OOMeshReader.h"
+#import "OOBinaryMeshReader.h"
+#import "OOBinaryMeshDefinitions.h"
 #import "OODATReader.h"
 #import "OOOBJReader.h"
 #import "OOCTMReader.h"
@@ -37,6 +39,10 @@ Class OOSelectMeshReaderForExtension(NSString *fileNameExtension)
 	{
 		return [OOMeshReader class];
 	}
+	else if ([fileNameExtension isEqualToString:kOOBinaryMeshFileExtension])
+	{
+		return [OOBinaryMeshReader class];
+	}
 #if !OOLITE_LEAN
 	else if ([fileNameExtension isEqualToString:@"dat"])
 	{
@@ -63,6 +69,10 @@ Class OOSelectMeshReaderForUTI(NSString *uti)
 	{
 		return [OOMeshReader class];
 	}
+	else if ([uti isEqualToString:@"org.oolite.oobmesh"])
+	{
+		return [OOBinaryMeshReader class];
+	}
 	else if ([uti isEqualToString:@"org.aegidian.oolite.mesh"])
 	{
 		return [OODATReader class];
@@ -29,6 +29,7 @@
 #import "OOMeshDefinitions.h"
 #import <OoliteBase/OOConfGenerationInternal.h>
 #import "OOAbstractMesh.h"
+#import "OOAbstractMeshStreams.h"
 
 
 enum
@@ -115,51 +116,18 @@ NSData *OOMeshDataFromMesh(OOAbstractMesh *mesh, OOMeshWriteOptions options, id
 	BOOL						annotate = options & kOOMeshWriteWithAnnotations;
 	BOOL						annotateExtended = annotate && (options & kOOMeshWriteWithExtendedAnnotations);
 	
-	//	Generate list of unique vertex indices (pointer uniquing only).
-	NSMutableArray				*vertices = [NSMutableArray array];
-	NSMutableDictionary			*indices = [NSMutableDictionary dictionary];
-	NSUInteger					vertexCount = 0;
-	
-	OOAbstractFaceGroup			*faceGroup = nil;
-	OOAbstractFace				*face = nil;
-	OOAbstractVertex			*vertex = nil;
-	OOMaterialSpecification		*material = nil;
-	
 	//	Unique vertices across groups, and count ’em.
-	NSMutableArray *annVertexUseCounts = nil;
-	if (annotateExtended)  annVertexUseCounts = [NSMutableArray array];
-	
-	foreach (faceGroup, mesh)
+	OOAbstractMeshStreams		*streams = [mesh packedStreams];
+	if (EXPECT_NOT(streams == nil))
 	{
-		foreach (face, faceGroup)
-		{
-			NSAutoreleasePool *pool = [NSAutoreleasePool new];
-			
-			for (NSUInteger vIter = 0; vIter < 3; vIter++)
-			{
-				vertex = [face vertexAtIndex:vIter];
-				
-				NSNumber *index = [indices objectForKey:vertex];
-				if (index == nil)
-				{
-					index = [NSNumber numberWithUnsignedInteger:vertexCount++];
-					[indices setObject:index forKey:vertex];
-					[vertices addObject:vertex];
-					
-					if (annotateExtended)  [annVertexUseCounts addObject:[NSNumber numberWithUnsignedInteger:1]];
-				}
-				else if (annotateExtended)
-				{
-					NSUInteger indexVal = [index unsignedIntegerValue];
-					NSUInteger useCount = [annVertexUseCounts oo_unsignedIntegerAtIndex:indexVal];
-					useCount++;
-					[annVertexUseCounts replaceObjectAtIndex:indexVal withObject:[NSNumber numberWithUnsignedInteger:useCount]];
-				}
-			}
-			
-			[pool drain];
-		}
+		OOReportError(issues, @"Could not build vertex data for mesh \"%@\".", [mesh name]);
+		[pool drain];
+		return nil;
 	}
+	NSUInteger					vertexCount = [streams vertexCount];
+	
+	OOAbstractFaceGroup			*faceGroup = nil;
+	OOMaterialSpecification		*material = nil;
 	
 	//	Unique materials by name.
 	NSMutableDictionary			*materials = [NSMutableDictionary dictionaryWithCapacity:[mesh faceGroupCount]];
@@ -280,9 +248,11 @@ NSData *OOMeshDataFromMesh(OOAbstractMesh *mesh, OOMeshWriteOptions options, id
 				annNoteUseCounts = YES;
 			}
 			
+			const float *attr = [[streams attributeArrayForKey:attributeKey] floatData];
+			NSUInteger stride = [streams attributeSizeForKey:attributeKey];
+			
 			for (NSUInteger vertexIter = 0; vertexIter < vertexCount; vertexIter++)
 			{
-				vertex = [vertices objectAtIndex:vertexIter];
 				[result appendString:@"\t\t\t\t"];
 				
 				if (annotate && (vertexIter % kAnnGroupRate) == 0 && vertexIter != 0)
@@ -290,10 +260,9 @@ NSData *OOMeshDataFromMesh(OOAbstractMesh *mesh, OOMeshWriteOptions options, id
 					[result appendFormat:@"\n\t\t\t\t// %lu:\n\t\t\t\t", (unsigned long)vertexIter];
 				}
 				
-				OOFloatArray *attr = [vertex attributeForKey:attributeKey];
 				for (elemIter = 0; elemIter < size; elemIter++)
 				{
-					[result appendString:FloatString([attr floatAtIndex:elemIter])];
+					[result appendString:FloatString(attr[vertexIter * stride + elemIter])];
 					
 					if (elemIter + 1 < size)
 					{
@@ -305,7 +274,7 @@ NSData *OOMeshDataFromMesh(OOAbstractMesh *mesh, OOMeshWriteOptions options, id
 						if (!annNoteUseCounts)  [result appendString:@"\n"];
 						else
 						{
-							[result appendFormat:@"\t// Uses: %@\n", [annVertexUseCounts objectAtIndex:vertexIter]];
+							[result appendFormat:@"\t// Uses: %lu\n", (unsigned long)[streams useCountForVertexAtIndex:vertexIter]];
 						}
 					}
 				}
@@ -333,6 +302,7 @@ NSData *OOMeshDataFromMesh(OOAbstractMesh *mesh, OOMeshWriteOptions options, id
 		NSString *name = [faceGroup name];
 		if (name == nil)  name = material;
 		
+		OOIndexArray *indices = [streams indexArrayForGroupAtIndex:groupIter];
 		NSUInteger faceIter, faceCount = [faceGroup faceCount];
 		
 		/*
@@ -347,10 +317,6 @@ NSData *OOMeshDataFromMesh(OOAbstractMesh *mesh, OOMeshWriteOptions options, id
 		
 		for (faceIter = 0; faceIter < faceCount; faceIter++)
 		{
-			OOAbstractFace *face = [faceGroup faceAtIndex:faceIter];
-			OOAbstractVertex *vertices[3];
-			[face getVertices:vertices];
-			
 			[result appendString:@"\t\t\t\t"];
 			
 			if (annotate && (faceIter % kAnnGroupRate) == 0 && faceIter != 0)
@@ -360,7 +326,7 @@ NSData *OOMeshDataFromMesh(OOAbstractMesh *mesh, OOMeshWriteOptions options, id
 			
 			for (NSUInteger vertexIter = 0; vertexIter < 3; vertexIter++)
 			{
-				NSUInteger index = [indices oo_unsignedIntegerForKey:vertices[vertexIter]];
+				NSUInteger index = [indices unsignedIntAtIndex:faceIter * 3 + vertexIter];
 				[result appendFormat:@"%lu", (unsigned long)index];
 				
 				if (vertexIter < 2)  [result appendString:@", "];
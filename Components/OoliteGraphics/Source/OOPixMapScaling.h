@@ -45,3 +45,29 @@ OOPixMap OOScalePixMap(OOPixMap srcPixMap, OOPixMapDimension dstWidth, OOPixMapD
 	Buffer must have space for (4 * width * height) / 3 pixels.
 */
 BOOL OOGenerateMipMaps(void *textureBytes, OOPixMapDimension width, OOPixMapDimension height, OOPixMapFormat format);
+
+
+/*	SIMD kernel selection, along the lines of OOBatchMaths. The scalers use
+	SSE2, AVX2 or NEON kernels for mip-map generation and vertical stretching
+	and squeezing, which give exactly the same results as the scalar code.
+	The best available implementation is chosen the first time it's needed.
+	Setting an implementation which isn't available (or built in) does
+	nothing and returns NO. Intended for benchmarking and testing; not
+	thread-safe with respect to scaling calls.
+*/
+typedef enum
+{
+	kOOPixMapScalingScalar,
+	kOOPixMapScalingSSE2,
+	kOOPixMapScalingAVX2,
+	kOOPixMapScalingNEON,
+	
+	kOOPixMapScalingImplementationCount
+} OOPixMapScalingImplementation;
+
+
+OOPixMapScalingImplementation OOPixMapScalingGetImplementation(void);
+BOOL OOPixMapScalingSetImplementation(OOPixMapScalingImplementation implementation);
+BOOL OOPixMapScalingImplementationAvailable(OOPixMapScalingImplementation implementation);
+OOPixMapScalingImplementation OOPixMapScalingBestImplementation(void);
+const char *OOPixMapScalingImplementationName(OOPixMapScalingImplementation implementation);
@@ -28,6 +28,25 @@ SOFTWARE.
 #import "OOPixMapScaling.h"
 
 
+/*	x86 kernels are compiled with per-function target attributes, so they're
+	available whatever -march the file is built with, and only run if
+	OOCPUGetFeatures() says so.
+*/
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define OO_PIXMAP_SCALING_X86	1
+#include <immintrin.h>
+#else
+#define OO_PIXMAP_SCALING_X86	0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define OO_PIXMAP_SCALING_NEON	1
+#include <arm_neon.h>
+#else
+#define OO_PIXMAP_SCALING_NEON	0
+#endif
+
+
 #define DUMP_MIP_MAPS	0
 #define DUMP_SCALE		0
 
@@ -86,13 +105,73 @@ static void SqueezeHorizontally4(OOPixMap srcPx, OOPixMapDimension dstWidth);
 static BOOL EnsureCorrectDataSize(OOPixMap *pixMap, BOOL leaveSpaceForMipMaps) NONNULL_FUNC;
 
 
+/*	SIMD kernels.
+	A kernel set provides row functions for the scalers which can be done a
+	row at a time with the same weights across the row: 2x2 box filtering
+	for mip-maps, vertical stretching (linear interpolation between two rows)
+	and vertical squeezing (weighted sum of a run of rows). They work on
+	bytes, without regard to channels, and give exactly the same results as
+	the scalar code. The scalar set has NULL entries, meaning the original
+	code is used.
+	
+	Horizontal stretching and squeezing sample at a different position for
+	each pixel, and remain scalar.
+*/
+typedef void (*HalveRowFunc)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count);
+typedef void (*LerpRowFunc)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count, unsigned weight0, unsigned weight1);
+typedef void (*SqueezeRowFunc)(const uint8_t *src, size_t srcRowBytes, uint8_t *dst, size_t count, unsigned startWeight, size_t middleRows, unsigned endWeight, uint32_t weight);
+
+typedef struct
+{
+	HalveRowFunc		halveRow1;
+	HalveRowFunc		halveRow2;
+	HalveRowFunc		halveRow4;
+	LerpRowFunc			lerpRow;
+	SqueezeRowFunc		squeezeRow;
+} OOPixMapScalingKernels;
+
+
+enum
+{
+	/*	Squeeze kernels accumulate in 32 bits and divide using a reciprocal
+		(see kSqueezeDivisionBias); this limit keeps weights below 2^22.
+	*/
+	kMaxKernelSqueezeHeight		= 16384
+};
+
+
+static const OOPixMapScalingKernels *sKernels = NULL;
+static OOPixMapScalingImplementation sImplementation = kOOPixMapScalingScalar;
+
+
+static const OOPixMapScalingKernels *KernelsForImplementation(OOPixMapScalingImplementation implementation);
+static void SelectKernels(void);
+
+
+OOINLINE const OOPixMapScalingKernels *Kernels(void)
+{
+	if (EXPECT_NOT(sKernels == NULL))  SelectKernels();
+	return sKernels;
+}
+
+
+static void ScaleToHalfWithKernel(HalveRowFunc halveRow, void *srcBytes, void *dstBytes, OOPixMapDimension srcWidth, OOPixMapDimension srcHeight, size_t bytesPerPixel) NONNULL_FUNC;
+static void StretchVerticallyWithKernel(OOPixMap srcPx, OOPixMap dstPx, LerpRowFunc lerpRow);
+static void SqueezeVerticallyWithKernel(OOPixMap srcPx, OOPixMapDimension dstHeight, SqueezeRowFunc squeezeRow);
+
+
 #if !OOLITE_NATIVE_64_BIT
 
 static void StretchVerticallyN_x4(OOPixMap srcPx, OOPixMap dstPx);
 
 OOINLINE void StretchVertically(OOPixMap srcPx, OOPixMap dstPx)
 {
-	if (!((srcPx.rowBytes) & 3))
+	LerpRowFunc lerpRow = Kernels()->lerpRow;
+	if (lerpRow != NULL)
+	{
+		StretchVerticallyWithKernel(srcPx, dstPx, lerpRow);
+	}
+	else if (!((srcPx.rowBytes | (srcPx.width * OOPixMapBytesPerPixel(srcPx))) & 3))
 	{
 		StretchVerticallyN_x4(srcPx, dstPx);
 	}
@@ -108,7 +187,12 @@ static void StretchVerticallyN_x8(OOPixMap srcPx, OOPixMap dstPx);
 
 OOINLINE void StretchVertically(OOPixMap srcPx, OOPixMap dstPx)
 {
-	if (!((srcPx.rowBytes) & 7))
+	LerpRowFunc lerpRow = Kernels()->lerpRow;
+	if (lerpRow != NULL)
+	{
+		StretchVerticallyWithKernel(srcPx, dstPx, lerpRow);
+	}
+	else if (!((srcPx.rowBytes | (srcPx.width * OOPixMapBytesPerPixel(srcPx))) & 7))
 	{
 		StretchVerticallyN_x8(srcPx, dstPx);
 	}
@@ -123,6 +207,13 @@ OOINLINE void StretchVertically(OOPixMap srcPx, OOPixMap dstPx)
 
 OOINLINE void SqueezeVertically(OOPixMap pixMap, OOPixMapDimension dstHeight)
 {
+	SqueezeRowFunc squeezeRow = Kernels()->squeezeRow;
+	if (squeezeRow != NULL && pixMap.height <= kMaxKernelSqueezeHeight && OOIsValidPixMapFormat(pixMap.format))
+	{
+		SqueezeVerticallyWithKernel(pixMap, dstHeight, squeezeRow);
+		return;
+	}
+	
 	switch (pixMap.format)
 	{
 		case kOOPixMapRGBA:
@@ -377,6 +468,22 @@ static BOOL GenerateMipMaps1(void *textureBytes, OOPixMapDimension width, OOPixM
 	DUMP_MIP_MAP_PREPARE(1);
 	curr = textureBytes;
 	
+	HalveRowFunc halveRow = Kernels()->halveRow1;
+	if (halveRow != NULL)
+	{
+		while (1 < w && 1 < h)
+		{
+			DUMP_MIP_MAP_DUMP(curr, w, h);
+			
+			next = curr + w * h;
+			ScaleToHalfWithKernel(halveRow, curr, next, w, h, 1);
+			
+			w >>= 1;
+			h >>= 1;
+			curr = next;
+		}
+	}
+	
 #if OOLITE_NATIVE_64_BIT
 	while (8 < w && 1 < h)
 	{
@@ -599,6 +706,22 @@ static BOOL GenerateMipMaps2(void *textureBytes, OOPixMapDimension width, OOPixM
 	DUMP_MIP_MAP_PREPARE(2);
 	curr = textureBytes;
 	
+	HalveRowFunc halveRow = Kernels()->halveRow2;
+	if (halveRow != NULL)
+	{
+		while (1 < w && 1 < h)
+		{
+			DUMP_MIP_MAP_DUMP(curr, w, h);
+			
+			next = curr + w * h;
+			ScaleToHalfWithKernel(halveRow, curr, next, w, h, 2);
+			
+			w >>= 1;
+			h >>= 1;
+			curr = next;
+		}
+	}
+	
 	// TODO: multiple pixel two-plane scalers.
 #if 0
 #if OOLITE_NATIVE_64_BIT
@@ -696,6 +819,22 @@ static BOOL GenerateMipMaps4(void *textureBytes, OOPixMapDimension width, OOPixM
 	DUMP_MIP_MAP_PREPARE(4);
 	curr = textureBytes;
 	
+	HalveRowFunc halveRow = Kernels()->halveRow4;
+	if (halveRow != NULL)
+	{
+		while (1 < w && 1 < h)
+		{
+			DUMP_MIP_MAP_DUMP(curr, w, h);
+			
+			next = curr + w * h;
+			ScaleToHalfWithKernel(halveRow, curr, next, w, h, 4);
+			
+			w >>= 1;
+			h >>= 1;
+			curr = next;
+		}
+	}
+	
 #if OOLITE_NATIVE_64_BIT
 	while (2 < w && 1 < h)
 	{
@@ -918,6 +1057,7 @@ static void StretchVerticallyN_x1(OOPixMap srcPx, OOPixMap dstPx)
 	}
 	
 	// Copy last row (without referring to the last-plus-oneth row)
+	src0 = (src + srcRowBytes * (srcPx.height - 1));
 	x = xCount;
 	while (x--)
 	{
@@ -969,6 +1109,7 @@ static void StretchVerticallyN_x4(OOPixMap srcPx, OOPixMap dstPx)
 	}
 	
 	// Copy last row (without referring to the last-plus-oneth row)
+	src0 = (uint32_t *)(src + srcRowBytes * (srcPx.height - 1));
 	x = xCount;
 	while (x--)
 	{
@@ -1019,6 +1160,7 @@ static void StretchVerticallyN_x8(OOPixMap srcPx, OOPixMap dstPx)
 	}
 	
 	// Copy last row (without referring to the last-plus-oneth row)
+	src0 = (uint64_t *)(src + srcRowBytes * (srcPx.height - 1));
 	x = xCount;
 	while (x--)
 	{
@@ -1682,3 +1824,641 @@ static BOOL EnsureCorrectDataSize(OOPixMap *pixMap, BOOL leaveSpaceForMipMaps)
 	
 	return YES;
 }
+
+
+
+OOPixMapScalingImplementation OOPixMapScalingGetImplementation(void)
+{
+	Kernels();
+	return sImplementation;
+}
+
+
+BOOL OOPixMapScalingSetImplementation(OOPixMapScalingImplementation implementation)
+{
+	if (!OOPixMapScalingImplementationAvailable(implementation))  return NO;
+	
+	sKernels = KernelsForImplementation(implementation);
+	sImplementation = implementation;
+	return YES;
+}
+
+
+BOOL OOPixMapScalingImplementationAvailable(OOPixMapScalingImplementation implementation)
+{
+	if (KernelsForImplementation(implementation) == NULL)  return NO;
+	
+	OOCPUFeatures features = OOCPUGetFeatures();
+	switch (implementation)
+	{
+		case kOOPixMapScalingScalar:
+			return YES;
+		
+		case kOOPixMapScalingSSE2:
+			return (features & kOOCPUFeatureSSE2) != 0;
+		
+		case kOOPixMapScalingAVX2:
+			return (features & kOOCPUFeatureAVX2) != 0;
+		
+		case kOOPixMapScalingNEON:
+			return (features & kOOCPUFeatureNEON) != 0;
+		
+		case kOOPixMapScalingImplementationCount:
+			break;
+	}
+	
+	return NO;
+}
+
+
+OOPixMapScalingImplementation OOPixMapScalingBestImplementation(void)
+{
+	if (OOPixMapScalingImplementationAvailable(kOOPixMapScalingAVX2))  return kOOPixMapScalingAVX2;
+	if (OOPixMapScalingImplementationAvailable(kOOPixMapScalingSSE2))  return kOOPixMapScalingSSE2;
+	if (OOPixMapScalingImplementationAvailable(kOOPixMapScalingNEON))  return kOOPixMapScalingNEON;
+	return kOOPixMapScalingScalar;
+}
+
+
+const char *OOPixMapScalingImplementationName(OOPixMapScalingImplementation implementation)
+{
+	switch (implementation)
+	{
+		case kOOPixMapScalingScalar:
+			return "scalar";
+		
+		case kOOPixMapScalingSSE2:
+			return "SSE2";
+		
+		case kOOPixMapScalingAVX2:
+			return "AVX2";
+		
+		case kOOPixMapScalingNEON:
+			return "NEON";
+		
+		case kOOPixMapScalingImplementationCount:
+			break;
+	}
+	
+	return "unknown";
+}
+
+
+static void SelectKernels(void)
+{
+	OOPixMapScalingImplementation best = OOPixMapScalingBestImplementation();
+	
+	sImplementation = best;
+	sKernels = KernelsForImplementation(best);
+}
+
+
+static void ScaleToHalfWithKernel(HalveRowFunc halveRow, void *srcBytes, void *dstBytes, OOPixMapDimension srcWidth, OOPixMapDimension srcHeight, size_t bytesPerPixel)
+{
+	const uint8_t		*src = srcBytes;
+	uint8_t				*dst = dstBytes;
+	size_t				srcRowBytes, dstRowBytes;
+	OOPixMapDimension	y;
+	
+	srcRowBytes = srcWidth * bytesPerPixel;
+	dstRowBytes = (srcWidth >> 1) * bytesPerPixel;
+	
+	y = srcHeight >> 1;
+	do
+	{
+		halveRow(src, src + srcRowBytes, dst, dstRowBytes);
+		
+		// Skip a row for each source row
+		src += srcRowBytes * 2;
+		dst += dstRowBytes;
+	} while (--y);
+}
+
+
+//	Same sampling as StretchVerticallyN_x1(), a row at a time.
+static void StretchVerticallyWithKernel(OOPixMap srcPx, OOPixMap dstPx, LerpRowFunc lerpRow)
+{
+	uint8_t				*src, *src0, *src1, *prev, *dst;
+	uint_fast32_t		y, xCount, srcRowBytes;
+	uint_fast16_t		weight0, weight1;
+	uint_fast32_t		fractY;	// Y coordinate, fixed-point (24.8)
+	
+	src = srcPx.pixels;
+	srcRowBytes = srcPx.rowBytes;
+	dst = dstPx.pixels;	// Assumes dstPx.width == dstPx.rowBytes.
+	
+	src0 = prev = src;
+	
+	xCount = srcPx.width * OOPixMapBytesPerPixel(srcPx);
+	
+	for (y = 1; y != dstPx.height; ++y)
+	{
+		fractY = ((srcPx.height * y) << 8) / dstPx.height;
+		
+		src0 = prev;
+		prev = src1 = src + srcRowBytes * (fractY >> 8);
+		
+		weight1 = fractY & 0xFF;
+		weight0 = 0x100 - weight1;
+		
+		lerpRow(src0, src1, dst, xCount, weight0, weight1);
+		dst += xCount;
+	}
+	
+	// Copy last row (without referring to the last-plus-oneth row)
+	memcpy(dst, src + srcRowBytes * (srcPx.height - 1), xCount);
+}
+
+
+/*	Same sampling as SqueezeVertically1(), SqueezeVertically2() and
+	SqueezeVertically4(), a row at a time. The one-channel version counts the
+	end row's weight even when it doesn't read the end row, and has a
+	different idea of when to read it.
+*/
+static void SqueezeVerticallyWithKernel(OOPixMap srcPx, OOPixMapDimension dstHeight, SqueezeRowFunc squeezeRow)
+{
+	uint8_t				*dst;
+	uint_fast32_t		xCount, startY, endY, srcRowBytes, lastRow, middleRows;
+	uint_fast32_t		endFractY, deltaY;
+	uint_fast32_t		weight;
+	uint_fast8_t		startWeight, endWeight, includedEndWeight;
+	BOOL				oneChannel;
+	
+	NSCParameterAssert(OOIsValidPixMap(srcPx));
+	
+	dst = srcPx.pixels;	// Output is placed in same buffer, without line padding.
+	srcRowBytes = srcPx.rowBytes;
+	xCount = srcPx.width * OOPixMapBytesPerPixel(srcPx);
+	oneChannel = OOPixMapBytesPerPixel(srcPx) == 1;
+	
+	deltaY = (srcPx.height << 12) / dstHeight;
+	endFractY = 0;
+	
+	endWeight = 0;
+	endY = 0;
+	
+	lastRow = srcPx.height - 1;
+	
+	while (endY < lastRow)
+	{
+		endFractY += deltaY;
+		startY = endY;
+		endY = endFractY >> 12;
+		
+		startWeight = 0xFF - endWeight;
+		endWeight = (endFractY >> 4) & 0xFF;
+		middleRows = endY - startY - 1;
+		
+		if (oneChannel)
+		{
+			includedEndWeight = (endY < lastRow) ? endWeight : 0;
+			weight = startWeight + endWeight;
+		}
+		else
+		{
+			includedEndWeight = (endY <= lastRow) ? endWeight : 0;
+			weight = startWeight + includedEndWeight;
+		}
+		weight += middleRows * 0xFF;
+		
+		squeezeRow((uint8_t *)srcPx.pixels + srcRowBytes * startY, srcRowBytes, dst, xCount, startWeight, middleRows, includedEndWeight, weight);
+		dst += xCount;
+	}
+}
+
+
+/*	Scalar kernel set. The NULL entries mean "use the original scalers";
+	they are what the SIMD kernels are tested against.
+*/
+static const OOPixMapScalingKernels kScalarKernels =
+{
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
+
+
+#if OO_PIXMAP_SCALING_X86 || OO_PIXMAP_SCALING_NEON
+
+/*** Kernel support ***/
+
+/*	Squeeze kernels divide by multiplying by the reciprocal of the weight, in
+	double precision. For sums below 2^30 and weights below 2^22, the product
+	is within 2^-44 of the exact quotient, while a quotient which isn't an
+	integer is at least 2^-22 below the next integer; adding the bias before
+	truncating gives the same result as integer division.
+*/
+static const double kSqueezeDivisionBias = 1.0 / (1 << 24);
+
+
+//	Scalar tails, for bytes left over after the last full vector.
+OOINLINE void HalveRowTail(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t i, size_t count, size_t bytesPerPixel)
+{
+	for (; i < count; i++)
+	{
+		// Byte i is channel i % bytesPerPixel of pixel i / bytesPerPixel, which comes from source pixels 2 * (i / bytesPerPixel) and the one after.
+		size_t s = 2 * i - i % bytesPerPixel;
+		dst[i] = (src0[s] + src0[s + bytesPerPixel] + src1[s] + src1[s + bytesPerPixel]) >> 2;
+	}
+}
+
+
+OOINLINE void LerpRowTail(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t i, size_t count, unsigned weight0, unsigned weight1)
+{
+	for (; i < count; i++)
+	{
+		dst[i] = (src0[i] * weight0 + src1[i] * weight1) >> 8;
+	}
+}
+
+
+OOINLINE void SqueezeRowTail(const uint8_t *src, size_t srcRowBytes, uint8_t *dst, size_t i, size_t count, unsigned startWeight, size_t middleRows, unsigned endWeight, uint32_t weight)
+{
+	const uint8_t		*px;
+	uint_fast32_t		accum;
+	size_t				y;
+	
+	for (; i < count; i++)
+	{
+		px = src + i;
+		accum = startWeight * *px;
+		
+		for (y = 0; y != middleRows; ++y)
+		{
+			px += srcRowBytes;
+			accum += *px * 0xFF;
+		}
+		
+		if (endWeight != 0)  accum += px[srcRowBytes] * endWeight;
+		
+		dst[i] = accum / weight;
+	}
+}
+
+#endif
+
+
+#if OO_PIXMAP_SCALING_X86
+
+/*** SSE2 kernels ***/
+
+#define SSE2_FUNC __attribute__((target("sse2")))
+
+#define KERNEL(name)				SSE2##name
+#define KERNEL_FUNC					SSE2_FUNC
+#define VEC							__m128i
+#define WIDTH						16
+#define VLOAD(p)					_mm_loadu_si128((const __m128i *)(p))
+#define VSTORE(p, v)				_mm_storeu_si128((__m128i *)(p), (v))
+#define VZERO()						_mm_setzero_si128()
+#define VSPLAT16(n)					_mm_set1_epi16((short)(n))
+#define VUNPACKLO8					_mm_unpacklo_epi8
+#define VUNPACKHI8					_mm_unpackhi_epi8
+#define VUNPACKLO64					_mm_unpacklo_epi64
+#define VADD16						_mm_add_epi16
+#define VMULLO16					_mm_mullo_epi16
+#define VMADD16						_mm_madd_epi16
+#define VPACKS32					_mm_packs_epi32
+#define VPACKUS16					_mm_packus_epi16
+#define VSRLI16(v, n)				_mm_srli_epi16((v), (n))
+#define VSRLI64(v, n)				_mm_srli_epi64((v), (n))
+#define VBSRLI8(v)					_mm_srli_si128((v), 8)
+#define VEVENDWORDS(v)				_mm_shuffle_epi32((v), _MM_SHUFFLE(3, 1, 2, 0))
+#define VHALVEORDER(v)				(v)
+
+#include "OOPixMapScalingKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VLOAD
+#undef VSTORE
+#undef VZERO
+#undef VSPLAT16
+#undef VUNPACKLO8
+#undef VUNPACKHI8
+#undef VUNPACKLO64
+#undef VADD16
+#undef VMULLO16
+#undef VMADD16
+#undef VPACKS32
+#undef VPACKUS16
+#undef VSRLI16
+#undef VSRLI64
+#undef VBSRLI8
+#undef VEVENDWORDS
+#undef VHALVEORDER
+
+
+/*	Squeezing accumulates 16 bytes at a time in four vectors of 32-bit sums.
+	Each weight is at most 0xFF, so each product fits in an unsigned 16-bit
+	lane. This is also used by the AVX2 kernel set; the division dominates,
+	and doesn't get any wider.
+*/
+SSE2_FUNC OOINLINE void SSE2AccumulateRow(const uint8_t *src, __m128i weight, __m128i accum[4])
+{
+	const __m128i		zero = _mm_setzero_si128();
+	__m128i				px = _mm_loadu_si128((const __m128i *)src);
+	__m128i				lo = _mm_mullo_epi16(_mm_unpacklo_epi8(px, zero), weight);
+	__m128i				hi = _mm_mullo_epi16(_mm_unpackhi_epi8(px, zero), weight);
+	
+	accum[0] = _mm_add_epi32(accum[0], _mm_unpacklo_epi16(lo, zero));
+	accum[1] = _mm_add_epi32(accum[1], _mm_unpackhi_epi16(lo, zero));
+	accum[2] = _mm_add_epi32(accum[2], _mm_unpacklo_epi16(hi, zero));
+	accum[3] = _mm_add_epi32(accum[3], _mm_unpackhi_epi16(hi, zero));
+}
+
+
+SSE2_FUNC OOINLINE __m128i SSE2DivideSums(__m128i accum, __m128d reciprocal, __m128d bias)
+{
+	__m128d lo = _mm_cvtepi32_pd(accum);
+	__m128d hi = _mm_cvtepi32_pd(_mm_srli_si128(accum, 8));
+	
+	lo = _mm_add_pd(_mm_mul_pd(lo, reciprocal), bias);
+	hi = _mm_add_pd(_mm_mul_pd(hi, reciprocal), bias);
+	
+	return _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+}
+
+
+SSE2_FUNC static void SSE2SqueezeRow(const uint8_t *src, size_t srcRowBytes, uint8_t *dst, size_t count, unsigned startWeight, size_t middleRows, unsigned endWeight, uint32_t weight)
+{
+	size_t				i = 0, y;
+	const uint8_t		*px;
+	__m128i				accum[4];
+	const __m128i		startW = _mm_set1_epi16((short)startWeight);
+	const __m128i		middleW = _mm_set1_epi16(0xFF);
+	const __m128i		endW = _mm_set1_epi16((short)endWeight);
+	const __m128d		reciprocal = _mm_set1_pd(1.0 / weight);
+	const __m128d		bias = _mm_set1_pd(kSqueezeDivisionBias);
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		px = src + i;
+		accum[0] = accum[1] = accum[2] = accum[3] = _mm_setzero_si128();
+		
+		SSE2AccumulateRow(px, startW, accum);
+		for (y = 0; y != middleRows; ++y)
+		{
+			px += srcRowBytes;
+			SSE2AccumulateRow(px, middleW, accum);
+		}
+		if (endWeight != 0)  SSE2AccumulateRow(px + srcRowBytes, endW, accum);
+		
+		__m128i lo = _mm_packs_epi32(SSE2DivideSums(accum[0], reciprocal, bias), SSE2DivideSums(accum[1], reciprocal, bias));
+		__m128i hi = _mm_packs_epi32(SSE2DivideSums(accum[2], reciprocal, bias), SSE2DivideSums(accum[3], reciprocal, bias));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	
+	SqueezeRowTail(src, srcRowBytes, dst, i, count, startWeight, middleRows, endWeight, weight);
+}
+
+
+static const OOPixMapScalingKernels kSSE2Kernels =
+{
+	SSE2HalveRow1,
+	SSE2HalveRow2,
+	SSE2HalveRow4,
+	SSE2LerpRow,
+	SSE2SqueezeRow
+};
+
+
+/*** AVX2 kernels ***/
+
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+#define KERNEL(name)				AVX2##name
+#define KERNEL_FUNC					AVX2_FUNC
+#define VEC							__m256i
+#define WIDTH						32
+#define VLOAD(p)					_mm256_loadu_si256((const __m256i *)(p))
+#define VSTORE(p, v)				_mm256_storeu_si256((__m256i *)(p), (v))
+#define VZERO()						_mm256_setzero_si256()
+#define VSPLAT16(n)					_mm256_set1_epi16((short)(n))
+#define VUNPACKLO8					_mm256_unpacklo_epi8
+#define VUNPACKHI8					_mm256_unpackhi_epi8
+#define VUNPACKLO64					_mm256_unpacklo_epi64
+#define VADD16						_mm256_add_epi16
+#define VMULLO16					_mm256_mullo_epi16
+#define VMADD16						_mm256_madd_epi16
+#define VPACKS32					_mm256_packs_epi32
+#define VPACKUS16					_mm256_packus_epi16
+#define VSRLI16(v, n)				_mm256_srli_epi16((v), (n))
+#define VSRLI64(v, n)				_mm256_srli_epi64((v), (n))
+#define VBSRLI8(v)					_mm256_srli_si256((v), 8)
+#define VEVENDWORDS(v)				_mm256_shuffle_epi32((v), _MM_SHUFFLE(3, 1, 2, 0))
+// Halving packs the 128-bit lanes as 0 2 1 3 (in 64-bit units).
+#define VHALVEORDER(v)				_mm256_permute4x64_epi64((v), _MM_SHUFFLE(3, 1, 2, 0))
+
+#include "OOPixMapScalingKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VLOAD
+#undef VSTORE
+#undef VZERO
+#undef VSPLAT16
+#undef VUNPACKLO8
+#undef VUNPACKHI8
+#undef VUNPACKLO64
+#undef VADD16
+#undef VMULLO16
+#undef VMADD16
+#undef VPACKS32
+#undef VPACKUS16
+#undef VSRLI16
+#undef VSRLI64
+#undef VBSRLI8
+#undef VEVENDWORDS
+#undef VHALVEORDER
+
+
+static const OOPixMapScalingKernels kAVX2Kernels =
+{
+	AVX2HalveRow1,
+	AVX2HalveRow2,
+	AVX2HalveRow4,
+	AVX2LerpRow,
+	SSE2SqueezeRow
+};
+
+#endif	// OO_PIXMAP_SCALING_X86
+
+
+#if OO_PIXMAP_SCALING_NEON
+
+/*** NEON kernels ***/
+
+/*	The halving kernels use de-interleaving loads to separate even and odd
+	pixels, so all three formats reduce to adding four byte vectors.
+*/
+OOINLINE uint8x16_t NEONHalveBytes(uint8x16_t a0, uint8x16_t a1, uint8x16_t b0, uint8x16_t b1)
+{
+	uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a0), vget_low_u8(a1)), vaddl_u8(vget_low_u8(b0), vget_low_u8(b1)));
+	uint16x8_t hi = vaddq_u16(vaddl_high_u8(a0, a1), vaddl_high_u8(b0, b1));
+	
+	return vcombine_u8(vshrn_n_u16(lo, 2), vshrn_n_u16(hi, 2));
+}
+
+
+static void NEONHalveRow1(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count)
+{
+	size_t				i = 0;
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16x2_t a = vld2q_u8(src0 + 2 * i), b = vld2q_u8(src1 + 2 * i);
+		vst1q_u8(dst + i, NEONHalveBytes(a.val[0], a.val[1], b.val[0], b.val[1]));
+	}
+	
+	HalveRowTail(src0, src1, dst, i, count, 1);
+}
+
+
+static void NEONHalveRow2(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count)
+{
+	size_t				i = 0;
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		uint16x8x2_t a = vld2q_u16((const uint16_t *)(src0 + 2 * i)), b = vld2q_u16((const uint16_t *)(src1 + 2 * i));
+		vst1q_u8(dst + i, NEONHalveBytes(vreinterpretq_u8_u16(a.val[0]), vreinterpretq_u8_u16(a.val[1]), vreinterpretq_u8_u16(b.val[0]), vreinterpretq_u8_u16(b.val[1])));
+	}
+	
+	HalveRowTail(src0, src1, dst, i, count, 2);
+}
+
+
+static void NEONHalveRow4(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count)
+{
+	size_t				i = 0;
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		uint32x4x2_t a = vld2q_u32((const uint32_t *)(src0 + 2 * i)), b = vld2q_u32((const uint32_t *)(src1 + 2 * i));
+		vst1q_u8(dst + i, NEONHalveBytes(vreinterpretq_u8_u32(a.val[0]), vreinterpretq_u8_u32(a.val[1]), vreinterpretq_u8_u32(b.val[0]), vreinterpretq_u8_u32(b.val[1])));
+	}
+	
+	HalveRowTail(src0, src1, dst, i, count, 4);
+}
+
+
+static void NEONLerpRow(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count, unsigned weight0, unsigned weight1)
+{
+	size_t				i = 0;
+	const uint16x8_t	w0 = vdupq_n_u16(weight0), w1 = vdupq_n_u16(weight1);
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16_t a = vld1q_u8(src0 + i), b = vld1q_u8(src1 + i);
+		uint16x8_t lo = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(a)), w0), vmovl_u8(vget_low_u8(b)), w1);
+		uint16x8_t hi = vmlaq_u16(vmulq_u16(vmovl_high_u8(a), w0), vmovl_high_u8(b), w1);
+		vst1q_u8(dst + i, vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+	}
+	
+	LerpRowTail(src0, src1, dst, i, count, weight0, weight1);
+}
+
+
+OOINLINE void NEONAccumulateRow(const uint8_t *src, uint8x16_t weight, uint32x4_t accum[4])
+{
+	uint8x16_t px = vld1q_u8(src);
+	uint16x8_t lo = vmull_u8(vget_low_u8(px), vget_low_u8(weight));
+	uint16x8_t hi = vmull_high_u8(px, weight);
+	
+	accum[0] = vaddw_u16(accum[0], vget_low_u16(lo));
+	accum[1] = vaddw_high_u16(accum[1], lo);
+	accum[2] = vaddw_u16(accum[2], vget_low_u16(hi));
+	accum[3] = vaddw_high_u16(accum[3], hi);
+}
+
+
+OOINLINE uint16x4_t NEONDivideSums(uint32x4_t accum, float64x2_t reciprocal, float64x2_t bias)
+{
+	float64x2_t lo = vcvtq_f64_u64(vmovl_u32(vget_low_u32(accum)));
+	float64x2_t hi = vcvtq_f64_u64(vmovl_high_u32(accum));
+	
+	lo = vaddq_f64(vmulq_f64(lo, reciprocal), bias);
+	hi = vaddq_f64(vmulq_f64(hi, reciprocal), bias);
+	
+	return vmovn_u32(vcombine_u32(vmovn_u64(vcvtq_u64_f64(lo)), vmovn_u64(vcvtq_u64_f64(hi))));
+}
+
+
+static void NEONSqueezeRow(const uint8_t *src, size_t srcRowBytes, uint8_t *dst, size_t count, unsigned startWeight, size_t middleRows, unsigned endWeight, uint32_t weight)
+{
+	size_t				i = 0, y;
+	const uint8_t		*px;
+	uint32x4_t			accum[4];
+	const uint8x16_t	startW = vdupq_n_u8(startWeight);
+	const uint8x16_t	middleW = vdupq_n_u8(0xFF);
+	const uint8x16_t	endW = vdupq_n_u8(endWeight);
+	const float64x2_t	reciprocal = vdupq_n_f64(1.0 / weight);
+	const float64x2_t	bias = vdupq_n_f64(kSqueezeDivisionBias);
+	
+	for (; i + 16 <= count; i += 16)
+	{
+		px = src + i;
+		accum[0] = accum[1] = accum[2] = accum[3] = vdupq_n_u32(0);
+		
+		NEONAccumulateRow(px, startW, accum);
+		for (y = 0; y != middleRows; ++y)
+		{
+			px += srcRowBytes;
+			NEONAccumulateRow(px, middleW, accum);
+		}
+		if (endWeight != 0)  NEONAccumulateRow(px + srcRowBytes, endW, accum);
+		
+		uint16x8_t lo = vcombine_u16(NEONDivideSums(accum[0], reciprocal, bias), NEONDivideSums(accum[1], reciprocal, bias));
+		uint16x8_t hi = vcombine_u16(NEONDivideSums(accum[2], reciprocal, bias), NEONDivideSums(accum[3], reciprocal, bias));
+		vst1q_u8(dst + i, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+	}
+	
+	SqueezeRowTail(src, srcRowBytes, dst, i, count, startWeight, middleRows, endWeight, weight);
+}
+
+
+static const OOPixMapScalingKernels kNEONKernels =
+{
+	NEONHalveRow1,
+	NEONHalveRow2,
+	NEONHalveRow4,
+	NEONLerpRow,
+	NEONSqueezeRow
+};
+
+#endif	// OO_PIXMAP_SCALING_NEON
+
+
+static const OOPixMapScalingKernels *KernelsForImplementation(OOPixMapScalingImplementation implementation)
+{
+	switch (implementation)
+	{
+		case kOOPixMapScalingScalar:
+			return &kScalarKernels;
+	
+#if OO_PIXMAP_SCALING_X86
+		case kOOPixMapScalingSSE2:
+			return &kSSE2Kernels;
+		
+		case kOOPixMapScalingAVX2:
+			return &kAVX2Kernels;
+#endif
+	
+#if OO_PIXMAP_SCALING_NEON
+		case kOOPixMapScalingNEON:
+			return &kNEONKernels;
+#endif
+		
+		default:
+			break;
+	}
+	
+	return NULL;
+}
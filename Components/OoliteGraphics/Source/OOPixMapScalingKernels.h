@@ -0,0 +1,149 @@
+/*
+
+OOPixMapScalingKernels.h
+
+x86 SIMD kernel bodies for OOPixMapScaling.m, which includes this file once
+for each instruction set after defining:
+	KERNEL(name)			Function name for this instruction set.
+	KERNEL_FUNC				Function attributes (target selection).
+	VEC						Integer vector register type.
+	WIDTH					Number of bytes in a VEC.
+	VLOAD(p), VSTORE(p, v)	Unaligned load and store.
+	VZERO()					All bits clear.
+	VSPLAT16(n)				16-bit lanes set to n.
+	VUNPACKLO8, VUNPACKHI8, VUNPACKLO64
+	VADD16, VMULLO16, VMADD16, VPACKS32, VPACKUS16
+	VSRLI16(v, n), VSRLI64(v, n)	Logical right shift of each lane by n bits.
+	VBSRLI8(v)				Shift each 128-bit lane right by 8 bytes.
+	VEVENDWORDS(v)			Dwords 0 and 2 of each 128-bit lane in its low half.
+	VHALVEORDER(v)			Undo the 64-bit lane interleaving of a halved row.
+
+All operations except VHALVEORDER work within 128-bit lanes, so the same
+body serves SSE2 and AVX2. Results are identical to the scalar scalers.
+
+
+Copyright (C) 2007-2011 Jens Ayton
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+/*	Load 2 * WIDTH bytes from each of two rows and add the rows together,
+	giving four vectors of 16-bit sums. Within each 128-bit lane, s0 and s1
+	come from the first load and s2 and s3 from the second.
+*/
+KERNEL_FUNC OOINLINE void KERNEL(AddRows)(const uint8_t *src0, const uint8_t *src1, VEC *s0, VEC *s1, VEC *s2, VEC *s3)
+{
+	const VEC	zero = VZERO();
+	VEC			a = VLOAD(src0), b = VLOAD(src0 + WIDTH);
+	VEC			c = VLOAD(src1), d = VLOAD(src1 + WIDTH);
+	
+	*s0 = VADD16(VUNPACKLO8(a, zero), VUNPACKLO8(c, zero));
+	*s1 = VADD16(VUNPACKHI8(a, zero), VUNPACKHI8(c, zero));
+	*s2 = VADD16(VUNPACKLO8(b, zero), VUNPACKLO8(d, zero));
+	*s3 = VADD16(VUNPACKHI8(b, zero), VUNPACKHI8(d, zero));
+}
+
+
+// Divide the 2x2 sums by four and store WIDTH output bytes.
+KERNEL_FUNC OOINLINE void KERNEL(StoreHalved)(uint8_t *dst, VEC h01, VEC h23)
+{
+	VSTORE(dst, VHALVEORDER(VPACKUS16(VSRLI16(h01, 2), VSRLI16(h23, 2))));
+}
+
+
+// Adjacent 16-bit sums are adjacent pixels.
+KERNEL_FUNC static void KERNEL(HalveRow1)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count)
+{
+	size_t				i = 0;
+	VEC					s0, s1, s2, s3;
+	const VEC			ones = VSPLAT16(1);
+	
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		KERNEL(AddRows)(src0 + 2 * i, src1 + 2 * i, &s0, &s1, &s2, &s3);
+		KERNEL(StoreHalved)(dst + i, VPACKS32(VMADD16(s0, ones), VMADD16(s1, ones)), VPACKS32(VMADD16(s2, ones), VMADD16(s3, ones)));
+	}
+	
+	HalveRowTail(src0, src1, dst, i, count, 1);
+}
+
+
+// Pixels are 32-bit pairs of 16-bit sums; add each pair of pixels and keep the even ones.
+KERNEL_FUNC OOINLINE VEC KERNEL(AddPixelPairs2)(VEC s)
+{
+	return VEVENDWORDS(VADD16(s, VSRLI64(s, 32)));
+}
+
+
+KERNEL_FUNC static void KERNEL(HalveRow2)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count)
+{
+	size_t				i = 0;
+	VEC					s0, s1, s2, s3;
+	
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		KERNEL(AddRows)(src0 + 2 * i, src1 + 2 * i, &s0, &s1, &s2, &s3);
+		KERNEL(StoreHalved)(dst + i, VUNPACKLO64(KERNEL(AddPixelPairs2)(s0), KERNEL(AddPixelPairs2)(s1)), VUNPACKLO64(KERNEL(AddPixelPairs2)(s2), KERNEL(AddPixelPairs2)(s3)));
+	}
+	
+	HalveRowTail(src0, src1, dst, i, count, 2);
+}
+
+
+// Pixels are the 64-bit halves of each lane.
+KERNEL_FUNC static void KERNEL(HalveRow4)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count)
+{
+	size_t				i = 0;
+	VEC					s0, s1, s2, s3;
+	
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		KERNEL(AddRows)(src0 + 2 * i, src1 + 2 * i, &s0, &s1, &s2, &s3);
+		s0 = VADD16(s0, VBSRLI8(s0));
+		s1 = VADD16(s1, VBSRLI8(s1));
+		s2 = VADD16(s2, VBSRLI8(s2));
+		s3 = VADD16(s3, VBSRLI8(s3));
+		KERNEL(StoreHalved)(dst + i, VUNPACKLO64(s0, s1), VUNPACKLO64(s2, s3));
+	}
+	
+	HalveRowTail(src0, src1, dst, i, count, 4);
+}
+
+
+/*	dst[i] = (src0[i] * weight0 + src1[i] * weight1) >> 8, where weight0 +
+	weight1 = 256, so each product and the sum fit in 16 bits.
+*/
+KERNEL_FUNC static void KERNEL(LerpRow)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, size_t count, unsigned weight0, unsigned weight1)
+{
+	size_t				i = 0;
+	const VEC			zero = VZERO();
+	const VEC			w0 = VSPLAT16(weight0), w1 = VSPLAT16(weight1);
+	
+	for (; i + WIDTH <= count; i += WIDTH)
+	{
+		VEC a = VLOAD(src0 + i), b = VLOAD(src1 + i);
+		VEC lo = VADD16(VMULLO16(VUNPACKLO8(a, zero), w0), VMULLO16(VUNPACKLO8(b, zero), w1));
+		VEC hi = VADD16(VMULLO16(VUNPACKHI8(a, zero), w0), VMULLO16(VUNPACKHI8(b, zero), w1));
+		VSTORE(dst + i, VPACKUS16(VSRLI16(lo, 8), VSRLI16(hi, 8)));
+	}
+	
+	LerpRowTail(src0, src1, dst, i, count, weight0, weight1);
+}
@@ -20,6 +20,7 @@ extern "C" {
 	
 #import "OOAbstractMesh+NormalSynthesis.h"
 #import "OOAbstractMesh+Winding.h"
+#import "OOAbstractMeshStreams.h"
 #endif
 
 // Concrete representations
@@ -38,6 +39,9 @@ extern "C" {
 #import "OOMeshReader.h"
 #import "OOMeshWriter.h"
 
+#import "OOBinaryMeshReader.h"
+#import "OOBinaryMeshWriter.h"
+
 #import "OOCTMReader.h"
 
 
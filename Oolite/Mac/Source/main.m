@@ -1,19 +1,72 @@
 #import <OoliteBase/OoliteBase.h>
 #import "OoliteLogOutputHandler.h"
 #import "OOLogHeader.h"
+#import "OOUpdateBenchmark.h"
+#import <OpenGL/OpenGL.h>
 
 
 #ifndef NDEBUG
 uint32_t gDebugFlags = 0;
 #endif
 
+static int RunHeadlessUpdateBenchmark(NSArray *arguments);
+
 
 int main(int argc, const char *argv[])
 {
 	NSAutoreleasePool *pool = [NSAutoreleasePool new];
 	OOLoggingInit([OoliteLogOutputHandler sharedLogOutputHandler]);
 	OOPrintLogHeader();
+	
+	NSArray *arguments = [[NSProcessInfo processInfo] arguments];
+	if (OOUpdateBenchmarkHeadlessRunRequested(arguments))
+	{
+		int status = RunHeadlessUpdateBenchmark(arguments);
+		[pool drain];
+		OOLoggingTerminate();
+		return status;
+	}
+	
 	[pool drain];
 	
 	return NSApplicationMain(argc, argv);
 }
+
+
+/*	Run an update benchmark with no window, on a context using Apple's
+	software renderer so that no GPU is needed. Everything but the context is
+	in OOUpdateBenchmarkRunHeadless(), which other platforms can call the
+	same way once they have made a context current.
+*/
+static int RunHeadlessUpdateBenchmark(NSArray *arguments)
+{
+	CGLPixelFormatAttribute attributes[] =
+	{
+		kCGLPFARendererID, (CGLPixelFormatAttribute)kCGLRendererGenericFloatID,
+		kCGLPFAColorSize, (CGLPixelFormatAttribute)24,
+		kCGLPFADepthSize, (CGLPixelFormatAttribute)24,
+		(CGLPixelFormatAttribute)0
+	};
+	CGLPixelFormatObj		pixelFormat = NULL;
+	CGLContextObj			context = NULL;
+	GLint					formatCount;
+	int						status;
+	
+	if (CGLChoosePixelFormat(attributes, &pixelFormat, &formatCount) != kCGLNoError || pixelFormat == NULL ||
+		CGLCreateContext(pixelFormat, NULL, &context) != kCGLNoError)
+	{
+		if (pixelFormat != NULL)  CGLDestroyPixelFormat(pixelFormat);
+		fprintf(stderr, "Could not create a software OpenGL context for the update benchmark.\n");
+		return EXIT_FAILURE;
+	}
+	CGLDestroyPixelFormat(pixelFormat);
+	CGLSetCurrentContext(context);
+	
+	// Some start-up code talks to NSApp, but the application is never run.
+	[NSApplication sharedApplication];
+	status = OOUpdateBenchmarkRunHeadless(arguments);
+	
+	CGLSetCurrentContext(NULL);
+	CGLDestroyContext(context);
+	return status;
+}
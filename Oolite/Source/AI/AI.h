@@ -25,8 +25,10 @@ MA 02110-1301, USA.
 */
 
 #import "OOTypes.h"
+#import "OOAIStateMachine.h"
 
 #define AI_THINK_INTERVAL					0.125
+#define AI_MAX_PENDING_MESSAGES				33
 
 
 @class OOShipEntity;
@@ -40,10 +42,15 @@ MA 02110-1301, USA.
 	id					_owner;						// OOWeakReference to the OOShipEntity this is the AI for
 	NSString			*ownerDesc;					// describes the object this is the AI for
 	
-	NSDictionary		*stateMachine;
+	OOAIStateMachine	*stateMachine;
 	NSString			*stateMachineName;
 	NSString			*currentState;
-	NSMutableSet		*pendingMessages;
+	NSUInteger			currentStateIndex;			// Index of currentState in stateMachine, or NSNotFound
+	
+	// Messages awaiting the next think, in order of arrival, without duplicates.
+	NSUInteger			pendingMessageCount;
+	OOAIMessageID		pendingMessages[AI_MAX_PENDING_MESSAGES];
+	NSMutableArray		*pendingUninternedMessages;	// Messages no compiled state machine handles, which only -interpretAIMessage: sees.
 	
 	NSMutableArray		*aiStack;
 	
@@ -61,6 +68,7 @@ MA 02110-1301, USA.
 
 - (NSString *) name;
 - (NSString *) state;
+- (OOAIStateMachine *) stateMachine;
 
 - (void) setStateMachine:(NSString *)smName;
 - (void) setState:(NSString *)stateName;
@@ -53,6 +53,8 @@ typedef struct
 
 static AI *sCurrentlyRunningAI = nil;
 
+static OOAIMessageID sUpdateMessage, sEnterMessage, sExitMessage, sRestartedMessage;
+
 
 @interface AI (OOPrivate)
 
@@ -62,6 +64,11 @@ static AI *sCurrentlyRunningAI = nil;
 
 - (void)refreshOwnerDesc;
 
+// Core dispatcher; message is the string form of messageID, which may be kOOAIMessageNone.
+- (void) priv_reactToMessage:(NSString *)message messageID:(OOAIMessageID)messageID context:(NSString *)debugContext;
+- (void) priv_performAction:(OOAIAction *)action;
+- (void) priv_setCurrentState:(NSString *)stateName;
+
 // Loading/whitelisting
 - (NSDictionary *) loadStateMachine:(NSString *)smName;
 - (NSDictionary *) cleanHandlers:(NSDictionary *)handlers forState:(NSString *)stateKey stateMachine:(NSString *)smName;
@@ -77,6 +84,18 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 
 @implementation AI
 
++ (void) initialize
+{
+	if (self == [AI class])
+	{
+		sUpdateMessage = OOAIMessageIDForString(@"UPDATE");
+		sEnterMessage = OOAIMessageIDForString(@"ENTER");
+		sExitMessage = OOAIMessageIDForString(@"EXIT");
+		sRestartedMessage = OOAIMessageIDForString(@"RESTARTED");
+	}
+}
+
+
 + (AI *) currentlyRunningAI
 {
 	return sCurrentlyRunningAI;
@@ -101,7 +120,7 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 	self = [super init];
 	
 	aiStack = [[NSMutableArray alloc] init];
-	pendingMessages = [[NSMutableSet alloc] init];
+	currentStateIndex = NSNotFound;
 	
 	nextThinkTime = INFINITY;	// don't think for a while
 	thinkTimeInterval = AI_THINK_INTERVAL;
@@ -117,7 +136,7 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 	self = [self init];
 	
 	if (smName != nil)  [self setStateMachine:smName];
-	if (stateName != nil)  currentState = [stateName retain];
+	if (stateName != nil)  [self priv_setCurrentState:stateName];
 	
 	return self;
 }
@@ -131,7 +150,7 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 	[stateMachine release];
 	[stateMachineName release];
 	[currentState release];
-	[pendingMessages release];
+	[pendingUninternedMessages release];
 	
 	if (sCurrentlyRunningAI == self)  sCurrentlyRunningAI = nil;
 	
@@ -217,12 +236,13 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 	if (!stateMachine)
 		return;
 	
-	NSMutableDictionary *pickledMachine = [NSMutableDictionary dictionaryWithCapacity:3];
+	NSMutableDictionary *pickledMachine = [NSMutableDictionary dictionaryWithCapacity:4];
 	
 	[pickledMachine setObject:stateMachine forKey:@"stateMachine"];
 	[pickledMachine setObject:currentState forKey:@"currentState"];
 	[pickledMachine setObject:stateMachineName forKey:@"stateMachineName"];
-	[pickledMachine setObject:[[pendingMessages copy] autorelease] forKey:@"pendingMessages"];
+	[pickledMachine setObject:[NSData dataWithBytes:pendingMessages length:pendingMessageCount * sizeof *pendingMessages] forKey:@"pendingMessages"];
+	if (pendingUninternedMessages != nil)  [pickledMachine setObject:[[pendingUninternedMessages copy] autorelease] forKey:@"pendingUninternedMessages"];
 	
 	if (aiStack == nil)  aiStack = [[NSMutableArray alloc] init];
 	
@@ -254,14 +274,16 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 	[stateMachine release];
 	stateMachine = [[pickledMachine objectForKey:@"stateMachine"] retain];
 	
-	[currentState release];
-	currentState = [[pickledMachine objectForKey:@"currentState"] retain];
+	[self priv_setCurrentState:[pickledMachine objectForKey:@"currentState"]];
 	
 	[stateMachineName release];
 	stateMachineName = [[pickledMachine objectForKey:@"stateMachineName"] retain];
 	
-	[pendingMessages release];
-	pendingMessages = [[pickledMachine objectForKey:@"pendingMessages"] mutableCopy];  // restore a MUTABLE set
+	NSData *pickledMessages = [pickledMachine objectForKey:@"pendingMessages"];
+	pendingMessageCount = MIN([pickledMessages length] / sizeof *pendingMessages, (NSUInteger)AI_MAX_PENDING_MESSAGES);
+	[pickledMessages getBytes:pendingMessages length:pendingMessageCount * sizeof *pendingMessages];
+	[pendingUninternedMessages release];
+	pendingUninternedMessages = [[pickledMachine objectForKey:@"pendingUninternedMessages"] mutableCopy];
 	
 	[aiStack removeObjectAtIndex:0];   //  POP
 }
@@ -278,15 +300,16 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 	if ([aiStack count] != 0)
 	{
 		[self restorePreviousStateMachine];
-		if (message == nil)  message = @"RESTARTED";
-		[self reactToMessage:message context:@"suspended AI restart"];
+		if (message == nil)  [self priv_reactToMessage:@"RESTARTED" messageID:sRestartedMessage context:@"suspended AI restart"];
+		else  [self reactToMessage:message context:@"suspended AI restart"];
 	}
 }
 
 
 - (void) setStateMachine:(NSString *) smName
 {
-	NSDictionary *newSM = [self loadStateMachine:smName];
+	NSDictionary *smDictionary = [self loadStateMachine:smName];
+	OOAIStateMachine *newSM = [OOAIStateMachine stateMachineWithName:smName dictionary:smDictionary];
 	
 	if (newSM)
 	{
@@ -295,8 +318,7 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 		stateMachine = [newSM retain];
 		nextThinkTime = 0.0;	// think at next tick
 		
-		[currentState release];
-		currentState = @"GLOBAL";
+		[self priv_setCurrentState:@"GLOBAL"];
 		
 		// refresh stateMachineName
 		[stateMachineName release];
@@ -309,7 +331,7 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 			Attempted fix: new delayed dispatch with trampoline, see -[AI setStateMachine:afterDelay:].
 			 -- Ahruman, 20070706
 		*/
-		[self reactToMessage:@"ENTER" context:@"changing AI"];
+		[self priv_reactToMessage:@"ENTER" messageID:sEnterMessage context:@"changing AI"];
 		
 		// refresh name
 		[self refreshOwnerDesc];
@@ -320,7 +342,7 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 
 - (void) setState:(NSString *) stateName
 {
-	if ([stateMachine objectForKey:stateName])
+	if (stateMachine != nil && [stateMachine indexOfState:stateName] != NSNotFound)
 	{
 		/*	CRASH in objc_msgSend, apparently on [self reactToMessage:@"EXIT"] (1.69, OS X/x86).
 			Analysis: self corrupted. We're being called by __NSFireDelayedPerform, which doesn't go
@@ -329,13 +351,9 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 			Attempted fix: new delayed dispatch with trampoline, see -[AI setState:afterDelay:].
 			 -- Ahruman, 20070706
 		*/
-		[self reactToMessage:@"EXIT" context:@"changing state"];
-		if (currentState != stateName)
-		{
-			[currentState release];
-			currentState = [stateName copy];
-		}
-		[self reactToMessage:@"ENTER" context:@"changing state"];
+		[self priv_reactToMessage:@"EXIT" messageID:sExitMessage context:@"changing state"];
+		[self priv_setCurrentState:stateName];
+		[self priv_reactToMessage:@"ENTER" messageID:sEnterMessage context:@"changing state"];
 	}
 }
 
@@ -364,6 +382,12 @@ extern void GenerateGraphVizForAIStateMachine(NSDictionary *stateMachine, NSStri
 }
 
 
+- (OOAIStateMachine *) stateMachine
+{
+	return [[stateMachine retain] autorelease];
+}
+
+
 - (unsigned) stackDepth
 {
 	return [aiStack count];
@@ -388,9 +412,16 @@ static AIStackElement *sStack;
 
 - (void) reactToMessage:(NSString *) message context:(NSString *)debugContext
 {
-	unsigned		i;
-	NSArray			*actions = nil;
-	NSDictionary	*messagesForState = nil;
+	if (message == nil)  return;
+	[self priv_reactToMessage:message messageID:OOAIExistingMessageIDForString(message) context:debugContext];
+}
+
+
+- (void) priv_reactToMessage:(NSString *)message messageID:(OOAIMessageID)messageID context:(NSString *)debugContext
+{
+	NSUInteger		i, actionCount = 0;
+	OOAIAction		*actions = NULL;
+	OOAIStateMachine *machine = nil;
 	OOShipEntity		*owner = [self owner];
 	static unsigned	recursionLimiter = 0;
 	AI				*previousRunning = sCurrentlyRunningAI;
@@ -438,30 +469,40 @@ static AIStackElement *sStack;
 		return;
 	}
 	
-	messagesForState = [stateMachine objectForKey:currentState];
-	if (messagesForState == nil)  return;
+	if (currentStateIndex == NSNotFound)
+	{
+#ifndef NDEBUG
+		if (sStack != NULL)  sStack = sStack->back;
+#endif
+		return;
+	}
 	
 #ifndef NDEBUG
-	if (currentState != nil && ![message isEqual:@"UPDATE"] && [owner reportAIMessages])
+	if (messageID != sUpdateMessage && [owner reportAIMessages])
 	{
 		OOLog(@"ai.message.receive", @"AI %@ for %@ in state '%@' receives message '%@'. Context: %@, stack depth: %u", stateMachineName, ownerDesc, currentState, message, debugContext, recursionLimiter);
 	}
 #endif
 	
-	actions = [[[messagesForState objectForKey:message] copy] autorelease];
+	/*	Actions may replace the state machine, so hold on to this one until
+		they're done. Its action table is immutable, so this takes the place
+		of copying the actions array.
+	*/
+	machine = [stateMachine retain];
+	actions = [machine actionsForMessage:messageID inState:currentStateIndex count:&actionCount];
 	
 #ifdef OO_BRAIN_AI
 	if (rulingInstinct != nil)  [rulingInstinct freezeShipVars];	// preserve the pre-thinking state
 #endif
 	
 	sCurrentlyRunningAI = self;
-	if ([actions count] > 0)
+	if (actionCount > 0)
 	{
 		++recursionLimiter;
 		NS_DURING
-			for (i = 0; i < [actions count]; i++)
+			for (i = 0; i < actionCount; i++)
 			{
-				[self takeAction:[actions objectAtIndex:i]];
+				[self priv_performAction:&actions[i]];
 			}
 		NS_HANDLER
 			OOLog(kOOLogException, @"Squashing exception %@:%@ in AI handler %@:%@.%@", [localException name], [localException reason], stateMachineName, currentState, message);
@@ -471,14 +512,12 @@ static AIStackElement *sStack;
 	}
 	else
 	{
-		if (currentState != nil)
+		if ([owner respondsToSelector:@selector(interpretAIMessage:)])
 		{
-			if ([owner respondsToSelector:@selector(interpretAIMessage:)])
-			{
-				[owner performSelector:@selector(interpretAIMessage:) withObject:message];
-			}
+			[owner performSelector:@selector(interpretAIMessage:) withObject:message];
 		}
 	}
+	[machine release];
 	
 	sCurrentlyRunningAI = previousRunning;
 #ifndef NDEBUG
@@ -498,60 +537,58 @@ static AIStackElement *sStack;
 
 - (void) takeAction:(NSString *) action
 {
-	NSArray			*tokens = ScanTokensFromString(action);
-	NSString		*dataString = nil;
-	NSString		*selectorStr;
-	SEL				selector;
+	OOAIAction		parsedAction;
+	
+	if (OOAIActionFromString(action, &parsedAction))
+	{
+		[self priv_performAction:&parsedAction];
+	}
+	else
+	{
+#ifndef NDEBUG
+		if ([[self owner] reportAIMessages])  OOLog(@"ai.takeAction.noAction", @"DEBUG: - no action '%@'", action);
+#endif
+	}
+}
+
+
+- (void) priv_performAction:(OOAIAction *)action
+{
 	OOShipEntity		*owner = [self owner];
+	IMP				method = NULL;
 	
 #ifndef NDEBUG
 	BOOL report = [owner reportAIMessages];
 	if (report)
 	{
-		OOLog(@"ai.takeAction", @"%@ to take action %@", ownerDesc, action);
+		OOLog(@"ai.takeAction", @"%@ to take action %@", ownerDesc, action->source);
 		OOLogIndent();
 	}
 #endif
 	
-	if ([tokens count] != 0)
+	if (owner != nil)
 	{
-		selectorStr = [tokens objectAtIndex:0];
-		
-		if (owner != nil)
+		method = OOAIActionIMPForClass(action, [owner class]);
+		if (method != NULL)
 		{
-			if ([tokens count] > 1)
-			{
-				dataString = [[tokens subarrayWithRange:NSMakeRange(1, [tokens count] - 1)] componentsJoinedByString:@" "];
-			}
-			
-			selector = NSSelectorFromString(selectorStr);
-			if ([owner respondsToSelector:selector])
+			if (action->argument != nil)  ((void (*)(id, SEL, id))method)(owner, action->selector, action->argument);
+			else  ((void (*)(id, SEL))method)(owner, action->selector);
+		}
+		else
+		{
+			if (action->isDebugMessage)
 			{
-				if (dataString)  [owner performSelector:selector withObject:dataString];
-				else  [owner performSelector:selector];
+				OOLog(@"ai.takeAction.debugMessage", @"DEBUG: AI MESSAGE from %@: %@", ownerDesc, action->argument);
 			}
 			else
 			{
-				if ([selectorStr isEqual:@"debugMessage:"])
-				{
-					OOLog(@"ai.takeAction.debugMessage", @"DEBUG: AI MESSAGE from %@: %@", ownerDesc, dataString);
-				}
-				else
-				{
-					OOLogERR(@"ai.takeAction.badSelector", @"in AI %@ in state %@: %@ does not respond to %@", stateMachineName, currentState, ownerDesc, selectorStr);
-				}
+				OOLogERR(@"ai.takeAction.badSelector", @"in AI %@ in state %@: %@ does not respond to %@", stateMachineName, currentState, ownerDesc, NSStringFromSelector(action->selector));
 			}
 		}
-		else
-		{
-			OOLog(@"ai.takeAction.orphaned", @"***** AI %@, trying to perform %@, is orphaned (no owner)", stateMachineName, selectorStr);
-		}
 	}
 	else
 	{
-#ifndef NDEBUG
-		if (report)  OOLog(@"ai.takeAction.noAction", @"DEBUG: - no action '%@'", action);
-#endif
+		OOLog(@"ai.takeAction.orphaned", @"***** AI %@, trying to perform %@, is orphaned (no owner)", stateMachineName, NSStringFromSelector(action->selector));
 	}
 	
 #ifndef NDEBUG
@@ -565,50 +602,113 @@ static AIStackElement *sStack;
 
 - (void) think
 {
-	NSArray			*ms_list = nil;
-	unsigned		i;
+	OOAIMessageID	messages[AI_MAX_PENDING_MESSAGES];
+	NSArray			*uninternedMessages = nil;
+	NSString		*message = nil;
+	NSUInteger		i, count;
 	
 	if (![[self owner] isInWorld] || stateMachine == nil)  return;  // don't think until launched
 	
-	[self reactToMessage:@"UPDATE" context:@"periodic update"];
-
-	if ([pendingMessages count] > 0)  ms_list = [pendingMessages allObjects];
-	[pendingMessages removeAllObjects];
+	[self priv_reactToMessage:@"UPDATE" messageID:sUpdateMessage context:@"periodic update"];
 	
-	if (ms_list != nil)
+	// Handlers may post new messages, which are for the next think.
+	count = pendingMessageCount;
+	memcpy(messages, pendingMessages, count * sizeof *messages);
+	pendingMessageCount = 0;
+	if ([pendingUninternedMessages count] != 0)
 	{
-		for (i = 0; i < [ms_list count]; i++)
-		{
-			[self reactToMessage:[ms_list objectAtIndex:i] context:@"handling deferred message"];
-		}
+		uninternedMessages = [[pendingUninternedMessages copy] autorelease];
+		[pendingUninternedMessages removeAllObjects];
+	}
+	
+	for (i = 0; i < count; i++)
+	{
+		[self priv_reactToMessage:OOAIMessageString(messages[i]) messageID:messages[i] context:@"handling deferred message"];
+	}
+	
+	// Look these up again in case a state machine compiled since they arrived handles them.
+	for (i = 0; i < [uninternedMessages count]; i++)
+	{
+		message = [uninternedMessages objectAtIndex:i];
+		[self priv_reactToMessage:message messageID:OOAIExistingMessageIDForString(message) context:@"handling deferred message"];
 	}
 }
 
 
 - (void) message:(NSString *) ms
 {
-	if (![[self owner] isInWorld])  return;  // don't think until launched
-
-	if ([pendingMessages count] > 32)
+	OOAIMessageID	messageID;
+	NSUInteger		i;
+	
+	if (ms == nil || ![[self owner] isInWorld])  return;  // don't think until launched
+	
+	messageID = OOAIExistingMessageIDForString(ms);
+	if (messageID != kOOAIMessageNone)
+	{
+		for (i = 0; i < pendingMessageCount; i++)
+		{
+			if (pendingMessages[i] == messageID)  return;
+		}
+	}
+	else
+	{
+		if ([pendingUninternedMessages containsObject:ms])  return;
+	}
+	
+	if (pendingMessageCount + [pendingUninternedMessages count] >= AI_MAX_PENDING_MESSAGES)
 	{
-		OOLogERR(@"ai.message.failed.overflow", @"AI pending messages overflow for '%@'; pending messages:\n%@", ownerDesc, pendingMessages);
+		OOLogERR(@"ai.message.failed.overflow", @"AI pending messages overflow for '%@'; pending messages:\n%@", ownerDesc, [self pendingMessages]);
 		[NSException raise:@"OoliteException"
 					format:@"AI pendingMessages overflow for %@", ownerDesc];
 	}
 	
-	[pendingMessages addObject:ms];
+	if (messageID != kOOAIMessageNone)
+	{
+		pendingMessages[pendingMessageCount++] = messageID;
+	}
+	else
+	{
+		if (pendingUninternedMessages == nil)  pendingUninternedMessages = [[NSMutableArray alloc] init];
+		[pendingUninternedMessages addObject:[[ms copy] autorelease]];
+	}
 }
 
 
 - (void) dropMessage:(NSString *) ms
 {
-	[pendingMessages removeObject:ms];
+	OOAIMessageID	messageID = OOAIExistingMessageIDForString(ms);
+	NSUInteger		i;
+	
+	if (messageID == kOOAIMessageNone)
+	{
+		[pendingUninternedMessages removeObject:ms];
+		return;
+	}
+	
+	for (i = 0; i < pendingMessageCount; i++)
+	{
+		if (pendingMessages[i] == messageID)
+		{
+			pendingMessageCount--;
+			memmove(&pendingMessages[i], &pendingMessages[i + 1], (pendingMessageCount - i) * sizeof *pendingMessages);
+			return;
+		}
+	}
 }
 	
 
 - (NSSet *) pendingMessages
 {
-	return [[pendingMessages copy] autorelease];
+	NSMutableSet	*result = [NSMutableSet setWithCapacity:pendingMessageCount + [pendingUninternedMessages count]];
+	NSUInteger		i;
+	
+	for (i = 0; i < pendingMessageCount; i++)
+	{
+		[result addObject:OOAIMessageString(pendingMessages[i])];
+	}
+	if (pendingUninternedMessages != nil)  [result addObjectsFromArray:pendingUninternedMessages];
+	
+	return result;
 }
 
 
@@ -617,9 +717,9 @@ static AIStackElement *sStack;
 	NSArray				*sortedMessages = nil;
 	NSString			*displayMessages = nil;
 	
-	if ([pendingMessages count] > 0)
+	if (pendingMessageCount + [pendingUninternedMessages count] > 0)
 	{
-		sortedMessages = [[pendingMessages allObjects] sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)];
+		sortedMessages = [[[self pendingMessages] allObjects] sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)];
 		displayMessages = [sortedMessages componentsJoinedByString:@", "];
 	}
 	else
@@ -667,7 +767,8 @@ static AIStackElement *sStack;
 - (void) clearAllData
 {
 	[aiStack removeAllObjects];
-	[pendingMessages removeAllObjects];
+	pendingMessageCount = 0;
+	[pendingUninternedMessages removeAllObjects];
 	
 	nextThinkTime += OOHOURS(10);	// Should dealloc in under ten hours!
 }
@@ -758,6 +859,18 @@ static AIStackElement *sStack;
 }
 
 
+- (void) priv_setCurrentState:(NSString *)stateName
+{
+	if (currentState != stateName)
+	{
+		[currentState release];
+		currentState = [stateName copy];
+	}
+	
+	currentStateIndex = (stateMachine != nil && currentState != nil) ? [stateMachine indexOfState:currentState] : NSNotFound;
+}
+
+
 - (NSDictionary *) loadStateMachine:(NSString *)smName
 {
 	NSDictionary			*newSM = nil;
@@ -0,0 +1,119 @@
+/*
+
+OOAIStateMachine.h
+
+Compiled form of an AI state machine plist.
+
+A state machine is compiled once per process from the sanitized dictionary
+AI loads (and caches through OOCacheManager). States are numbered, messages
+are interned as integer IDs shared by all state machines, and each action is
+pre-split into a selector and argument string, with the implementation of
+the selector cached for the owner's class. Dispatching a message is then a
+binary search on integers, with no string parsing.
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+typedef uint32_t OOAIMessageID;
+
+enum
+{
+	kOOAIMessageNone		= 0
+};
+
+
+typedef struct OOAIAction
+{
+	SEL					selector;
+	NSString			*argument;		// Parameters joined with single spaces, or nil if there are none.
+	NSString			*source;		// Action as written, for diagnostics.
+	BOOL				isDebugMessage;	// debugMessage: is handled by the AI itself.
+	
+	// One-entry implementation cache, see OOAIActionIMPForClass().
+	Class				cachedClass;
+	IMP					cachedIMP;
+} OOAIAction;
+
+
+/*	Message interning. IDs are never reused or released, so only messages
+	that state machines handle are interned, when they're compiled; the
+	messages sent to AIs include arbitrary strings, such as
+	AGGRESSOR_SWITCHED_TARGET with entity IDs appended, which would grow the
+	table without bound. Not thread-safe; AIs only run on the main thread.
+	
+	OOAIExistingMessageIDForString() returns kOOAIMessageNone for strings
+	that have never been interned. Such messages can't have a handler in any
+	state machine compiled so far.
+*/
+OOAIMessageID OOAIMessageIDForString(NSString *message);
+OOAIMessageID OOAIExistingMessageIDForString(NSString *message);
+NSString *OOAIMessageString(OOAIMessageID messageID);
+
+
+/*	Parse an action string ("selector: param1 param2") into *outAction.
+	argument and source are autoreleased. Returns NO for empty actions.
+*/
+BOOL OOAIActionFromString(NSString *source, OOAIAction *outAction);
+
+
+/*	Implementation of action's selector for instances of ownerClass, or NULL
+	if they don't respond to it. The result for the last class seen is cached
+	in the action; nearly all owners of a given AI share a class, so this is
+	normally a single comparison.
+*/
+IMP OOAIActionIMPForClass(OOAIAction *action, Class ownerClass);
+
+
+@interface OOAIStateMachine: NSObject
+{
+@private
+	NSString			*_name;
+	NSDictionary		*_dictionary;
+	NSDictionary		*_stateIndices;		// State name -> NSNumber.
+	NSUInteger			_stateCount;
+	struct OOAIState	*_states;
+	NSUInteger			_actionCount;
+	OOAIAction			*_actions;
+}
+
+/*	Returns the compiled version of dictionary, which must be a sanitized
+	state machine as produced by AI's loader. Compiled machines are cached by
+	name, and recompiled if a different dictionary is passed for the same
+	name.
+*/
++ (id) stateMachineWithName:(NSString *)name dictionary:(NSDictionary *)dictionary;
+
+- (NSString *) name;
+- (NSDictionary *) dictionary;
+
+- (NSUInteger) stateCount;
+- (NSUInteger) indexOfState:(NSString *)stateName;	// NSNotFound if there is no such state.
+- (NSString *) nameOfStateAtIndex:(NSUInteger)stateIndex;
+
+/*	Actions for message in a state, or NULL (with *outCount set to 0) if the
+	state has no handler for the message. The pointer remains valid for the
+	lifetime of the state machine.
+*/
+- (OOAIAction *) actionsForMessage:(OOAIMessageID)message inState:(NSUInteger)stateIndex count:(NSUInteger *)outCount;
+
+@end
@@ -0,0 +1,358 @@
+/*
+
+OOAIStateMachine.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOAIStateMachine.h"
+#import "OOShipEntity.h"
+
+
+typedef struct OOAIHandler
+{
+	OOAIMessageID			message;
+	NSUInteger				actionCount;
+	OOAIAction				*actions;
+} OOAIHandler;
+
+
+struct OOAIState
+{
+	NSString				*name;
+	NSUInteger				handlerCount;
+	OOAIHandler				*handlers;
+};
+
+
+static NSMutableDictionary	*sMessageIDs = nil;		// NSString -> NSNumber
+static NSMutableArray		*sMessageStrings = nil;	// Indexed by ID; element 0 is a placeholder for kOOAIMessageNone.
+static NSMutableDictionary	*sCompiledMachines = nil;
+
+
+static int CompareHandlers(const void *a, const void *b);
+
+
+@interface OOAIStateMachine (OOPrivate)
+
+- (id) priv_initWithName:(NSString *)name dictionary:(NSDictionary *)dictionary;
+
+@end
+
+
+@implementation OOAIStateMachine
+
++ (id) stateMachineWithName:(NSString *)name dictionary:(NSDictionary *)dictionary
+{
+	OOAIStateMachine		*result = nil;
+
+	if (name == nil || dictionary == nil)  return nil;
+
+	result = [sCompiledMachines objectForKey:name];
+	if (result != nil && result->_dictionary == dictionary)  return result;
+
+	result = [[[self alloc] priv_initWithName:name dictionary:dictionary] autorelease];
+	if (result != nil)
+	{
+		if (sCompiledMachines == nil)  sCompiledMachines = [[NSMutableDictionary alloc] init];
+		[sCompiledMachines setObject:result forKey:name];
+	}
+
+	return result;
+}
+
+
+- (id) priv_initWithName:(NSString *)name dictionary:(NSDictionary *)dictionary
+{
+	NSArray					*stateNames = nil;
+	NSMutableDictionary		*stateIndices = nil;
+	NSUInteger				stateIdx, handlerTotal = 0, actionTotal = 0;
+	NSUInteger				handlerIdx = 0, actionIdx = 0;
+	OOAIHandler				*handlers = NULL;
+	NSString				*stateName = nil;
+
+	if ((self = [super init]))
+	{
+		_name = [name copy];
+		_dictionary = [dictionary retain];
+
+		// Sort state names so that indices don't depend on hash order.
+		stateNames = [[dictionary allKeys] sortedArrayUsingSelector:@selector(compare:)];
+		_stateCount = [stateNames count];
+
+		foreach (stateName, stateNames)
+		{
+			NSDictionary *stateHandlers = [dictionary oo_dictionaryForKey:stateName];
+			NSArray *actions = nil;
+			handlerTotal += [stateHandlers count];
+			foreach (actions, [stateHandlers allValues])  actionTotal += [actions count];
+		}
+
+		_states = calloc(_stateCount, sizeof *_states);
+		handlers = calloc(handlerTotal, sizeof *handlers);
+		_actions = calloc(actionTotal, sizeof *_actions);
+		if ((_stateCount != 0 && _states == NULL) || (handlerTotal != 0 && handlers == NULL) || (actionTotal != 0 && _actions == NULL))
+		{
+			free(handlers);
+			[self release];
+			return nil;
+		}
+
+		stateIndices = [NSMutableDictionary dictionaryWithCapacity:_stateCount];
+
+		for (stateIdx = 0; stateIdx < _stateCount; stateIdx++)
+		{
+			struct OOAIState *state = &_states[stateIdx];
+			NSDictionary *stateHandlers = nil;
+			NSString *messageName = nil;
+
+			stateName = [stateNames objectAtIndex:stateIdx];
+			stateHandlers = [dictionary oo_dictionaryForKey:stateName];
+
+			state->name = [stateName copy];
+			state->handlers = handlers + handlerIdx;
+			[stateIndices setObject:[NSNumber numberWithUnsignedInteger:stateIdx] forKey:stateName];
+
+			foreach (messageName, [stateHandlers allKeys])
+			{
+				OOAIHandler *handler = &state->handlers[state->handlerCount++];
+				NSString *actionString = nil;
+
+				handler->message = OOAIMessageIDForString(messageName);
+				handler->actions = _actions + actionIdx;
+
+				foreach (actionString, [stateHandlers oo_arrayForKey:messageName])
+				{
+					OOAIAction *action = &handler->actions[handler->actionCount];
+
+					// The loader has already discarded non-strings and empty actions, but play it safe.
+					if (OOAIActionFromString(actionString, action))
+					{
+						[action->argument retain];
+						[action->source retain];
+						handler->actionCount++;
+					}
+				}
+				actionIdx += handler->actionCount;
+			}
+			handlerIdx += state->handlerCount;
+
+			qsort(state->handlers, state->handlerCount, sizeof *state->handlers, CompareHandlers);
+		}
+
+		_actionCount = actionIdx;
+		_stateIndices = [stateIndices copy];
+	}
+
+	return self;
+}
+
+
+- (void) dealloc
+{
+	NSUInteger				i;
+
+	for (i = 0; i < _actionCount; i++)
+	{
+		[_actions[i].argument release];
+		[_actions[i].source release];
+	}
+	free(_actions);
+
+	if (_states != NULL)
+	{
+		for (i = 0; i < _stateCount; i++)  [_states[i].name release];
+		// All handlers are allocated in one block, starting at the first state's.
+		if (_stateCount != 0)  free(_states[0].handlers);
+		free(_states);
+	}
+
+	DESTROY(_name);
+	DESTROY(_dictionary);
+	DESTROY(_stateIndices);
+
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"\"%@\", %lu states, %lu actions", _name, (unsigned long)_stateCount, (unsigned long)_actionCount];
+}
+
+
+- (NSString *) name
+{
+	return _name;
+}
+
+
+- (NSDictionary *) dictionary
+{
+	return _dictionary;
+}
+
+
+- (NSUInteger) stateCount
+{
+	return _stateCount;
+}
+
+
+- (NSUInteger) indexOfState:(NSString *)stateName
+{
+	NSNumber *index = [_stateIndices objectForKey:stateName];
+	if (index == nil)  return NSNotFound;
+	return [index unsignedIntegerValue];
+}
+
+
+- (NSString *) nameOfStateAtIndex:(NSUInteger)stateIndex
+{
+	if (stateIndex >= _stateCount)  return nil;
+	return _states[stateIndex].name;
+}
+
+
+- (OOAIAction *) actionsForMessage:(OOAIMessageID)message inState:(NSUInteger)stateIndex count:(NSUInteger *)outCount
+{
+	NSParameterAssert(outCount != NULL);
+	*outCount = 0;
+
+	if (EXPECT_NOT(stateIndex >= _stateCount || message == kOOAIMessageNone))  return NULL;
+
+	struct OOAIState *state = &_states[stateIndex];
+	NSUInteger low = 0, high = state->handlerCount;
+
+	while (low < high)
+	{
+		NSUInteger mid = (low + high) / 2;
+		OOAIMessageID midMessage = state->handlers[mid].message;
+
+		if (midMessage < message)  low = mid + 1;
+		else if (midMessage > message)  high = mid;
+		else
+		{
+			*outCount = state->handlers[mid].actionCount;
+			return (*outCount != 0) ? state->handlers[mid].actions : NULL;
+		}
+	}
+
+	return NULL;
+}
+
+@end
+
+
+OOAIMessageID OOAIMessageIDForString(NSString *message)
+{
+	OOAIMessageID			result;
+
+	if (message == nil)  return kOOAIMessageNone;
+
+	result = OOAIExistingMessageIDForString(message);
+	if (result == kOOAIMessageNone)
+	{
+		if (sMessageStrings == nil)
+		{
+			sMessageIDs = [[NSMutableDictionary alloc] init];
+			sMessageStrings = [[NSMutableArray alloc] initWithObjects:@"", nil];
+		}
+
+		message = [[message copy] autorelease];
+		result = (OOAIMessageID)[sMessageStrings count];
+		[sMessageStrings addObject:message];
+		[sMessageIDs setObject:[NSNumber numberWithUnsignedInt:result] forKey:message];
+	}
+
+	return result;
+}
+
+
+OOAIMessageID OOAIExistingMessageIDForString(NSString *message)
+{
+	NSNumber *number = [sMessageIDs objectForKey:message];
+	if (number == nil)  return kOOAIMessageNone;
+	return [number unsignedIntValue];
+}
+
+
+NSString *OOAIMessageString(OOAIMessageID messageID)
+{
+	if (messageID == kOOAIMessageNone || messageID >= [sMessageStrings count])  return nil;
+	return [sMessageStrings objectAtIndex:messageID];
+}
+
+
+BOOL OOAIActionFromString(NSString *source, OOAIAction *outAction)
+{
+	NSArray					*tokens = nil;
+	NSString				*selectorString = nil;
+	NSUInteger				count;
+
+	NSCParameterAssert(outAction != NULL);
+
+	tokens = OOScanTokensFromString(source);
+	count = [tokens count];
+	if (count == 0)  return NO;
+
+	selectorString = [tokens objectAtIndex:0];
+
+	outAction->selector = NSSelectorFromString(selectorString);
+	outAction->argument = (count > 1) ? [[tokens subarrayWithRange:NSMakeRange(1, count - 1)] componentsJoinedByString:@" "] : nil;
+	outAction->source = source;
+	outAction->isDebugMessage = [selectorString isEqualToString:@"debugMessage:"];
+
+	// Prime the cache for the usual case.
+	outAction->cachedClass = Nil;
+	OOAIActionIMPForClass(outAction, [OOShipEntity class]);
+
+	return YES;
+}
+
+
+IMP OOAIActionIMPForClass(OOAIAction *action, Class ownerClass)
+{
+	if (EXPECT_NOT(action->cachedClass != ownerClass))
+	{
+		action->cachedClass = ownerClass;
+		if ([ownerClass instancesRespondToSelector:action->selector])
+		{
+			action->cachedIMP = [ownerClass instanceMethodForSelector:action->selector];
+		}
+		else
+		{
+			action->cachedIMP = NULL;
+		}
+	}
+
+	return action->cachedIMP;
+}
+
+
+static int CompareHandlers(const void *a, const void *b)
+{
+	OOAIMessageID ma = ((const OOAIHandler *)a)->message;
+	OOAIMessageID mb = ((const OOAIHandler *)b)->message;
+
+	if (ma < mb)  return -1;
+	if (ma > mb)  return 1;
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+
+OOAIThinkScheduler.h
+
+Spreads AI thinking over frames.
+
+Each frame, OOUniverse hands every AI whose next think time has passed to
+-addAI:ifDueAtTime:, then calls -runThinksAtTime:. The due AIs are kept in a
+binary heap ordered by due time, and think in that order until the frame's
+budget of think count or think time runs out. The rest are dropped without
+thinking; since their next think times are unchanged they are due again in
+the next frame. The scheduler remembers when each of them first became due
+(which matters for AIs whose next think time is zero, meaning "as soon as
+possible"), so having been due for longer they go ahead of AIs that have
+only just become due. A burst of AIs that all become due together,
+for instance after a large group is spawned, therefore thinks over several
+frames, and since each AI's next think time is set relative to when it
+actually thought, their think phases stay spread out afterwards.
+
+At least AI_THINK_MIN_PER_FRAME AIs think every frame, and any AI that has
+been due for more than the maximum deferral thinks regardless of the
+budget. A budget of zero means no limit.
+
+The budgets are read from the user defaults ai-think-budget-count,
+ai-think-budget-ms and ai-think-max-deferral (in seconds).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+#import "OOTypes.h"
+
+@class AI;
+
+
+#define AI_THINK_DEFAULT_BUDGET_COUNT		48
+#define AI_THINK_DEFAULT_BUDGET_MS			2.0
+#define AI_THINK_DEFAULT_MAX_DEFERRAL		0.5
+#define AI_THINK_MIN_PER_FRAME				4
+
+
+@interface OOAIThinkScheduler: NSObject
+{
+@private
+	struct OOAIThinkEntry	*_heap;
+	NSUInteger				_count;
+	NSUInteger				_capacity;
+	NSUInteger				_sequence;
+
+	NSUInteger				_budgetCount;
+	OOTimeDelta				_budgetTime;
+	OOTimeDelta				_maxDeferral;
+	NSMapTable				*_dueSince;			// AI -> NSNumber, when each AI deferred in the last frame first became due.
+
+	// Statistics.
+	unsigned long long		_frames;
+	unsigned long long		_framesOverBudget;
+	unsigned long long		_thinks;
+	unsigned long long		_deferrals;
+	unsigned long long		_forcedThinks;
+	double					_totalLatency;
+	OOTimeDelta				_maxLatency;
+	NSUInteger				_lastFrameThinks;
+	NSUInteger				_lastFrameDeferrals;
+}
+
+// Reads the budgets from the user defaults.
+- (id) init;
+- (id) initWithBudgetCount:(NSUInteger)count budgetTime:(OOTimeDelta)seconds maxDeferral:(OOTimeDelta)maxDeferral;
+
+/*	Queue ai to think in this frame's -runThinksAtTime: if its next think
+	time is before now, or zero (meaning as soon as possible). The AI is
+	retained until then.
+*/
+- (void) addAI:(AI *)ai ifDueAtTime:(OOTimeAbsolute)now;
+
+/*	Think the queued AIs in order of due time until the budget is spent, and
+	forget the rest. Exceptions from -think are propagated after the queue
+	has been cleared.
+*/
+- (void) runThinksAtTime:(OOTimeAbsolute)now;
+
+// Forget the queued AIs without thinking.
+- (void) cancelThinks;
+
+/*	Keys: frames, framesOverBudget, thinks, deferrals, forcedThinks,
+	meanLatency, maxLatency, lastFrameThinks, lastFrameDeferrals. Latencies
+	are the time, in seconds, from when an AI first became due to when it
+	actually thought, which is normally less than one frame.
+*/
+- (NSDictionary *) statistics;
+- (void) resetStatistics;
+
+@end
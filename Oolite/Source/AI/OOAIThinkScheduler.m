@@ -0,0 +1,296 @@
+/*
+
+OOAIThinkScheduler.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOAIThinkScheduler.h"
+#import "AI.h"
+#import "OOProfilingStopwatch.h"
+
+
+typedef struct OOAIThinkEntry
+{
+	OOTimeAbsolute			dueTime;
+	NSUInteger				sequence;	// Tie breaker, so equally due AIs think in the order they were added.
+	AI						*ai;
+} OOAIThinkEntry;
+
+
+OOINLINE BOOL EntryPrecedes(const OOAIThinkEntry *a, const OOAIThinkEntry *b)
+{
+	if (a->dueTime != b->dueTime)  return a->dueTime < b->dueTime;
+	return a->sequence < b->sequence;
+}
+
+
+static void SiftUp(OOAIThinkEntry *heap, NSUInteger index);
+static void SiftDown(OOAIThinkEntry *heap, NSUInteger count, NSUInteger index);
+
+
+@interface OOAIThinkScheduler (OOPrivate)
+
+- (void) priv_removeAll;
+
+@end
+
+
+@implementation OOAIThinkScheduler
+
+- (id) init
+{
+	NSUserDefaults *prefs = [NSUserDefaults standardUserDefaults];
+
+	return [self initWithBudgetCount:[prefs oo_unsignedIntForKey:@"ai-think-budget-count" defaultValue:AI_THINK_DEFAULT_BUDGET_COUNT]
+						  budgetTime:[prefs oo_nonNegativeDoubleForKey:@"ai-think-budget-ms" defaultValue:AI_THINK_DEFAULT_BUDGET_MS] / 1000.0
+						 maxDeferral:[prefs oo_nonNegativeDoubleForKey:@"ai-think-max-deferral" defaultValue:AI_THINK_DEFAULT_MAX_DEFERRAL]];
+}
+
+
+- (id) initWithBudgetCount:(NSUInteger)count budgetTime:(OOTimeDelta)seconds maxDeferral:(OOTimeDelta)maxDeferral
+{
+	if ((self = [super init]))
+	{
+		_budgetCount = count;
+		_budgetTime = seconds;
+		_maxDeferral = maxDeferral;
+		_dueSince = NSCreateMapTable(NSObjectMapKeyCallBacks, NSObjectMapValueCallBacks, 0);
+	}
+
+	return self;
+}
+
+
+- (void) dealloc
+{
+	[self priv_removeAll];
+	free(_heap);
+	if (_dueSince != NULL)  NSFreeMapTable(_dueSince);
+
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%lu queued, budget %lu thinks/%g ms", (unsigned long)_count, (unsigned long)_budgetCount, _budgetTime * 1000.0];
+}
+
+
+- (void) addAI:(AI *)ai ifDueAtTime:(OOTimeAbsolute)now
+{
+	OOTimeAbsolute			dueTime;
+	NSNumber				*dueSince = nil;
+
+	if (ai == nil)  return;
+
+	dueTime = [ai nextThinkTime];
+	if (!(now > dueTime || dueTime == 0.0))  return;
+
+	/*	A next think time of zero means "as soon as possible", but treating it
+		literally would let a stream of newly switched AIs starve ones that
+		have been waiting. It is keyed by the time it was first seen instead,
+		which is kept for as long as the AI is deferred, so that it ages like
+		any other and the maximum deferral applies to it.
+	*/
+	dueSince = NSMapGet(_dueSince, ai);
+	if (dueSince != nil)  dueTime = [dueSince doubleValue];
+	else if (dueTime == 0.0)  dueTime = now;
+
+	if (_count == _capacity)
+	{
+		NSUInteger newCapacity = (_capacity != 0) ? _capacity * 2 : 64;
+		OOAIThinkEntry *newHeap = realloc(_heap, newCapacity * sizeof *newHeap);
+		if (EXPECT_NOT(newHeap == NULL))
+		{
+			// Can't defer it, so think now.
+			[ai setNextThinkTime:now + [ai thinkTimeInterval]];
+			[ai think];
+			return;
+		}
+		_heap = newHeap;
+		_capacity = newCapacity;
+	}
+
+	_heap[_count].dueTime = dueTime;
+	_heap[_count].sequence = _sequence++;
+	_heap[_count].ai = [ai retain];
+	SiftUp(_heap, _count);
+	_count++;
+}
+
+
+- (void) runThinksAtTime:(OOTimeAbsolute)now
+{
+	NSUInteger				thinks = 0;
+	OOHighResTimeValue		start;
+
+	if (_count == 0)  return;
+
+	start = OOGetHighResTime();
+
+	NS_DURING
+		while (_count != 0)
+		{
+			OOAIThinkEntry entry = _heap[0];
+			OOTimeDelta latency = now - entry.dueTime;
+
+			if (thinks >= AI_THINK_MIN_PER_FRAME)
+			{
+				BOOL overBudget = (_budgetCount != 0 && thinks >= _budgetCount);
+				if (!overBudget && _budgetTime != 0.0)
+				{
+					OOHighResTimeValue current = OOGetHighResTime();
+					overBudget = OOHighResTimeDeltaInSeconds(start, current) >= _budgetTime;
+					OODisposeHighResTime(current);
+				}
+
+				if (overBudget)
+				{
+					// The heap is in due order, so if this one can wait, so can the rest.
+					if (_maxDeferral == 0.0 || latency <= _maxDeferral)  break;
+					_forcedThinks++;
+				}
+			}
+
+			_heap[0] = _heap[--_count];
+			SiftDown(_heap, _count, 0);
+
+			_thinks++;
+			_totalLatency += latency;
+			if (_maxLatency < latency)  _maxLatency = latency;
+			thinks++;
+
+			[entry.ai setNextThinkTime:now + [entry.ai thinkTimeInterval]];
+			[entry.ai autorelease];	// Released after -think so that an exception doesn't leak it.
+			[entry.ai think];
+		}
+	NS_HANDLER
+		OODisposeHighResTime(start);
+		[self priv_removeAll];
+		NSResetMapTable(_dueSince);
+		[localException raise];
+	NS_ENDHANDLER
+
+	OODisposeHighResTime(start);
+
+	// Remember when the deferred AIs became due, and forget the rest.
+	NSResetMapTable(_dueSince);
+	_frames++;
+	_lastFrameThinks = thinks;
+	_lastFrameDeferrals = _count;
+	if (_count != 0)
+	{
+		NSUInteger i;
+		for (i = 0; i < _count; i++)
+		{
+			NSMapInsert(_dueSince, _heap[i].ai, [NSNumber numberWithDouble:_heap[i].dueTime]);
+		}
+
+		_framesOverBudget++;
+		_deferrals += _count;
+		[self priv_removeAll];
+	}
+}
+
+
+- (void) cancelThinks
+{
+	[self priv_removeAll];
+	NSResetMapTable(_dueSince);
+}
+
+
+- (NSDictionary *) statistics
+{
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedLongLong:_frames], @"frames",
+			[NSNumber numberWithUnsignedLongLong:_framesOverBudget], @"framesOverBudget",
+			[NSNumber numberWithUnsignedLongLong:_thinks], @"thinks",
+			[NSNumber numberWithUnsignedLongLong:_deferrals], @"deferrals",
+			[NSNumber numberWithUnsignedLongLong:_forcedThinks], @"forcedThinks",
+			[NSNumber numberWithDouble:(_thinks != 0) ? _totalLatency / _thinks : 0.0], @"meanLatency",
+			[NSNumber numberWithDouble:_maxLatency], @"maxLatency",
+			[NSNumber numberWithUnsignedInteger:_lastFrameThinks], @"lastFrameThinks",
+			[NSNumber numberWithUnsignedInteger:_lastFrameDeferrals], @"lastFrameDeferrals",
+			nil];
+}
+
+
+- (void) resetStatistics
+{
+	_frames = 0;
+	_framesOverBudget = 0;
+	_thinks = 0;
+	_deferrals = 0;
+	_forcedThinks = 0;
+	_totalLatency = 0.0;
+	_maxLatency = 0.0;
+	_lastFrameThinks = 0;
+	_lastFrameDeferrals = 0;
+}
+
+
+- (void) priv_removeAll
+{
+	NSUInteger				i;
+
+	for (i = 0; i < _count; i++)  [_heap[i].ai release];
+	_count = 0;
+	_sequence = 0;
+}
+
+@end
+
+
+static void SiftUp(OOAIThinkEntry *heap, NSUInteger index)
+{
+	OOAIThinkEntry			entry = heap[index];
+
+	while (index > 0)
+	{
+		NSUInteger parent = (index - 1) / 2;
+		if (!EntryPrecedes(&entry, &heap[parent]))  break;
+		heap[index] = heap[parent];
+		index = parent;
+	}
+	heap[index] = entry;
+}
+
+
+static void SiftDown(OOAIThinkEntry *heap, NSUInteger count, NSUInteger index)
+{
+	OOAIThinkEntry			entry;
+
+	if (index >= count)  return;
+	entry = heap[index];
+
+	for (;;)
+	{
+		NSUInteger child = index * 2 + 1;
+		if (child >= count)  break;
+		if (child + 1 < count && EntryPrecedes(&heap[child + 1], &heap[child]))  child++;
+		if (!EntryPrecedes(&heap[child], &entry))  break;
+		heap[index] = heap[child];
+		index = child;
+	}
+	heap[index] = entry;
+}
@@ -31,6 +31,7 @@ MA 02110-1301, USA.
 #define	COLLISION_MAX_ENTITIES			128
 
 @class	OOEntity;
+struct OOBroadPhasePair;
 
 @interface CollisionRegion : NSObject
 {
@@ -83,6 +84,8 @@ NSArray* subregionsContainingPosition( Vector position, CollisionRegion* region)
 - (BOOL) checkEntity:(OOEntity*) ent;
 //
 - (void) findCollisions;
+// Narrow phase for pairs from OOBroadPhase; indices in pairs refer to entities.
+- (void) findCollisionsWithPairs:(const struct OOBroadPhasePair *)pairs count:(NSUInteger)count entities:(OOEntity **)entities;
 - (void) findShadowedEntities;
 
 - (NSString*) debugOut;
@@ -31,6 +31,15 @@ MA 02110-1301, USA.
 #import "OOStationEntity.h"
 #import "OOPlayerShipEntity.h"
 #import "OODebugFlags.h"
+#import "OOBroadPhase.h"
+
+
+@interface CollisionRegion (OOPrivate)
+
+- (int) prepareEntitiesToTest:(OOEntity **)entities_to_test;
+- (void) checkPairWith:(OOEntity *)e1 and:(OOEntity *)e2;
+
+@end
 
 
 @implementation CollisionRegion
@@ -291,25 +300,16 @@ NSArray* subregionsContainingPosition( Vector position, CollisionRegion* region)
 }
 
 
-- (void) findCollisions
+/*	Collect the entities to test and clear their collision state. Returns the
+	number of entities stored in entities_to_test, which must have room for
+	n_entities entries.
+*/
+- (int) prepareEntitiesToTest:(OOEntity **)entities_to_test
 {
-	//
-	// According to Shark, when this was in OOUniverse this was where Oolite spent most time!
-	//
-	OOEntity *e1,*e2;
-	Vector p1, p2;
-	double dist2, r1, r2, r0, min_dist2;
-	int i;
-	OOEntity*	entities_to_test[n_entities];
-	//
-	
-	// reject trivial cases
-	//
-	if (n_entities < 2)
-		return;
+	OOEntity *e1;
+	int i, n_entities_to_test = 0;
 	
 	// only check unfiltered entities
-	int n_entities_to_test = 0;
 	for (i = 0; i < n_entities; i++)
 	{
 		e1 = entity_array[i];
@@ -323,7 +323,7 @@ NSArray* subregionsContainingPosition( Vector position, CollisionRegion* region)
 #endif
 	
 	if (n_entities_to_test < 2)
-		return;
+		return n_entities_to_test;
 
 	//	clear collision variables
 	//
@@ -338,6 +338,109 @@ NSArray* subregionsContainingPosition( Vector position, CollisionRegion* region)
 		e1->collider = nil;
 	}
 	
+	checks_this_tick = 0;
+	checks_within_range = 0;
+	
+	return n_entities_to_test;
+}
+
+
+- (void) checkPairWith:(OOEntity *)e1 and:(OOEntity *)e2
+{
+	Vector p1, p2;
+	double dist2, r1, r2, r0, min_dist2;
+	
+	checks_this_tick++;
+	
+	p1 = e1->position;
+	r1 = e1->collision_radius;
+	p2 = e2->position;
+	r2 = e2->collision_radius;
+	r0 = r1 + r2;
+	p2 = vector_subtract(p2, p1);
+	dist2 = magnitude2(p2);
+	min_dist2 = r0 * r0;
+	if (dist2 < PROXIMITY_WARN_DISTANCE2 * min_dist2)
+	{
+#ifndef NDEBUG
+		if (gDebugFlags & DEBUG_COLLISIONS)
+		{
+			OOLog(@"collisionRegion.debug", @"DEBUG Testing collision between %@ (%@) and %@ (%@)",
+				  e1, (e1->collisionTestFilter)?@"YES":@"NO", e2, (e2->collisionTestFilter)?@"YES":@"NO");
+		}
+#endif
+		checks_within_range++;
+		
+		if ((e1->isShip) && (e2->isShip))
+		{
+			if ((dist2 < PROXIMITY_WARN_DISTANCE2 * r2 * r2) || (dist2 < PROXIMITY_WARN_DISTANCE2 * r1 * r1))
+			{
+				[(OOShipEntity*)e1 notePotentialCollsion:(OOShipEntity*)e2];
+				[(OOShipEntity*)e2 notePotentialCollsion:(OOShipEntity*)e1];
+			}
+		}
+		if (dist2 < min_dist2)
+		{
+			BOOL collision = NO;
+			
+			if (e1->isStation)
+			{
+				OOStationEntity* se1 = (OOStationEntity*) e1;
+				if ([se1 shipIsInDockingCorridor: (OOShipEntity*)e2])
+					collision = NO;
+				else
+					collision = [e1 checkCloseCollisionWith: e2];
+			}
+			else if (e2->isStation)
+			{
+				OOStationEntity* se2 = (OOStationEntity*) e2;
+				if ([se2 shipIsInDockingCorridor: (OOShipEntity*)e1])
+					collision = NO;
+				else
+					collision = [e2 checkCloseCollisionWith: e1];
+			}
+			else
+				collision = [e1 checkCloseCollisionWith: e2];
+		
+			if (collision)
+			{
+				// now we have no need to check the e2-e1 collision
+				if (e1->collider)
+					[[e1 collisionArray] addObject:e1->collider];
+				else
+					[[e1 collisionArray] addObject:e2];
+				e1->hasCollided = YES;
+				//
+				if (e2->collider)
+					[[e2 collisionArray] addObject:e2->collider];
+				else
+					[[e2 collisionArray] addObject:e1];
+				e2->hasCollided = YES;
+			}
+		}
+	}
+}
+
+
+- (void) findCollisions
+{
+	//
+	// According to Shark, when this was in OOUniverse this was where Oolite spent most time!
+	//
+	OOEntity *e1,*e2;
+	int i;
+	OOEntity*	entities_to_test[n_entities];
+	//
+	
+	// reject trivial cases
+	//
+	if (n_entities < 2)
+		return;
+	
+	int n_entities_to_test = [self prepareEntitiesToTest:entities_to_test];
+	if (n_entities_to_test < 2)
+		return;
+	
 	// test for collisions in each subregion
 	//
 	/* There are never subregions created in the current code, so skip this check for now.
@@ -349,94 +452,52 @@ NSArray* subregionsContainingPosition( Vector position, CollisionRegion* region)
 	*/
 	//
 	
-	checks_this_tick = 0;
-	checks_within_range = 0;
-	
 	// test each entity in this region against the entities in its collision chain
 	//
 	for (i = 0; i < n_entities_to_test; i++)
 	{
 		e1 = entities_to_test[i];
-		p1 = e1->position;
-		r1 = e1->collision_radius;
 		
 		// check against the first in the collision chain
 		e2 = e1->collision_chain;
 		while (e2 != nil)
 		{
-			checks_this_tick++;
+			[self checkPairWith:e1 and:e2];
 			
-			p2 = e2->position;
-			r2 = e2->collision_radius;
-			r0 = r1 + r2;
-			p2 = vector_subtract(p2, p1);
-			dist2 = magnitude2(p2);
-			min_dist2 = r0 * r0;
-			if (dist2 < PROXIMITY_WARN_DISTANCE2 * min_dist2)
-			{
-#ifndef NDEBUG
-				if (gDebugFlags & DEBUG_COLLISIONS)
-				{
-					OOLog(@"collisionRegion.debug", @"DEBUG Testing collision between %@ (%@) and %@ (%@)",
-						  e1, (e1->collisionTestFilter)?@"YES":@"NO", e2, (e2->collisionTestFilter)?@"YES":@"NO");
-				}
-#endif
-				checks_within_range++;
-				
-				if ((e1->isShip) && (e2->isShip))
-				{
-					if ((dist2 < PROXIMITY_WARN_DISTANCE2 * r2 * r2) || (dist2 < PROXIMITY_WARN_DISTANCE2 * r1 * r1))
-					{
-						[(OOShipEntity*)e1 notePotentialCollsion:(OOShipEntity*)e2];
-						[(OOShipEntity*)e2 notePotentialCollsion:(OOShipEntity*)e1];
-					}
-				}
-				if (dist2 < min_dist2)
-				{
-					BOOL collision = NO;
-					
-					if (e1->isStation)
-					{
-						OOStationEntity* se1 = (OOStationEntity*) e1;
-						if ([se1 shipIsInDockingCorridor: (OOShipEntity*)e2])
-							collision = NO;
-						else
-							collision = [e1 checkCloseCollisionWith: e2];
-					}
-					else if (e2->isStation)
-					{
-						OOStationEntity* se2 = (OOStationEntity*) e2;
-						if ([se2 shipIsInDockingCorridor: (OOShipEntity*)e1])
-							collision = NO;
-						else
-							collision = [e2 checkCloseCollisionWith: e1];
-					}
-					else
-						collision = [e1 checkCloseCollisionWith: e2];
-				
-					if (collision)
-					{
-						// now we have no need to check the e2-e1 collision
-						if (e1->collider)
-							[[e1 collisionArray] addObject:e1->collider];
-						else
-							[[e1 collisionArray] addObject:e2];
-						e1->hasCollided = YES;
-						//
-						if (e2->collider)
-							[[e2 collisionArray] addObject:e2->collider];
-						else
-							[[e2 collisionArray] addObject:e1];
-						e2->hasCollided = YES;
-					}
-				}
-			}
 			// check the next in the collision chain
 			e2 = e2->collision_chain;
 		}
 	}
 }
 
+
+- (void) findCollisionsWithPairs:(const OOBroadPhasePair *)pairs count:(NSUInteger)count entities:(OOEntity **)entities
+{
+	OOEntity *e1,*e2;
+	NSUInteger i;
+	OOEntity*	entities_to_test[n_entities];
+	
+	if (n_entities < 2)
+		return;
+	
+	if ([self prepareEntitiesToTest:entities_to_test] < 2)
+		return;
+	
+	for (i = 0; i < count; i++)
+	{
+		e1 = entities[pairs[i].a];
+		e2 = entities[pairs[i].b];
+		
+		// Pairs are built for the whole universe; skip any that were filtered out or belong to another region.
+		if (e1->collisionTestFilter || e2->collisionTestFilter)
+			continue;
+		if (e1->collisionRegion != self || e2->collisionRegion != self)
+			continue;
+		
+		[self checkPairWith:e1 and:e2];
+	}
+}
+
 static BOOL testEntityOccludedByEntity(OOEntity* e1, OOEntity* e2, OOSunEntity* the_sun)
 {
 	// simple tests
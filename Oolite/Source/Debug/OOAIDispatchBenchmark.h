@@ -0,0 +1,56 @@
+/*
+
+OOAIDispatchBenchmark.h
+
+Timing of AI message dispatch, comparing compiled state machines with the
+old approach of looking up state and message names in the state machine
+dictionary and parsing each action string as it's performed.
+
+Every built-in AI is loaded and compiled, then a deterministic synthetic
+trace of (AI, state, message) events is generated, roughly one in four of
+which has no handler in its state. Each path resolves every event to the
+owner method and argument for each action, as far as the point of calling
+it; no actions are actually performed, so this measures dispatch overhead
+only.
+
+Only available in debug builds. Can be run from the debug console with
+console.runAIDispatchBenchmark([eventCount [, iterations]]).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define AI_DISPATCH_BENCHMARK_DEFAULT_EVENTS		20000
+#define AI_DISPATCH_BENCHMARK_DEFAULT_ITERATIONS	10
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary with the keys stateMachines, events, handledEvents,
+	actions, legacyNsPerEvent and compiledNsPerEvent. Results are also written
+	to the log under ai.dispatch.benchmark. Returns nil if eventCount or
+	iterations is zero, or no AIs could be loaded.
+*/
+NSDictionary *OOAIDispatchRunBenchmark(NSUInteger eventCount, NSUInteger iterations);
+
+#endif
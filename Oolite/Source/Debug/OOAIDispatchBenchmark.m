@@ -0,0 +1,248 @@
+/*
+
+OOAIDispatchBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOAIDispatchBenchmark.h"
+#import "OOProfilingStopwatch.h"
+#import "AI.h"
+#import "OOShipEntity.h"
+#import "ResourceManager.h"
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogAIDispatchBenchmark			= @"ai.dispatch.benchmark";
+
+enum
+{
+	kUnhandledEventOneIn		= 4,
+	kLegacyPoolInterval			= 256	// Events between autorelease pool drains in the legacy path.
+};
+
+
+typedef struct
+{
+	OOAIStateMachine		*machine;
+	NSDictionary			*dictionary;
+	NSString				*stateName;
+	NSUInteger				stateIndex;
+	NSString				*message;
+	OOAIMessageID			messageID;
+} BenchmarkEvent;
+
+
+static NSArray *LoadBuiltInStateMachines(void);
+static NSUInteger DispatchLegacy(const BenchmarkEvent *event, Class ownerClass);
+static NSUInteger DispatchCompiled(const BenchmarkEvent *event, Class ownerClass);
+
+
+NSDictionary *OOAIDispatchRunBenchmark(NSUInteger eventCount, NSUInteger iterations)
+{
+	NSArray					*machines = nil;
+	NSMutableArray			*allMessages = nil;
+	NSMutableSet			*messageSet = nil;
+	BenchmarkEvent			*events = NULL;
+	NSUInteger				i, iteration, machineCount, handledEvents = 0, actionTotal = 0;
+	NSUInteger				legacyActions = 0, compiledActions = 0;
+	Class					ownerClass = [OOShipEntity class];
+	RANROTSeed				seed = MakeRanrotSeed(8086);
+	NSAutoreleasePool		*pool = nil;
+	OOAIStateMachine		*machine = nil;
+
+	if (eventCount == 0 || iterations == 0)  return nil;
+
+	machines = LoadBuiltInStateMachines();
+	machineCount = [machines count];
+	if (machineCount == 0)  return nil;
+
+	// Every message any built-in AI handles, plus some nobody does.
+	messageSet = [NSMutableSet set];
+	foreach (machine, machines)
+	{
+		NSDictionary *state = nil;
+		foreach (state, [[machine dictionary] allValues])  [messageSet addObjectsFromArray:[state allKeys]];
+	}
+	allMessages = [NSMutableArray arrayWithArray:[[messageSet allObjects] sortedArrayUsingSelector:@selector(compare:)]];
+	for (i = 0; i < 8; i++)  [allMessages addObject:[NSString stringWithFormat:@"BENCHMARK_UNHANDLED_%lu", (unsigned long)i]];
+
+	events = calloc(eventCount, sizeof *events);
+	if (events == NULL)  return nil;
+
+	for (i = 0; i < eventCount; i++)
+	{
+		BenchmarkEvent *event = &events[i];
+		NSArray *handled = nil;
+
+		machine = [machines objectAtIndex:RanrotWithSeed(&seed) % machineCount];
+
+		event->machine = machine;
+		event->dictionary = [machine dictionary];
+		event->stateIndex = RanrotWithSeed(&seed) % [machine stateCount];
+		event->stateName = [machine nameOfStateAtIndex:event->stateIndex];
+
+		handled = [[[event->dictionary objectForKey:event->stateName] allKeys] sortedArrayUsingSelector:@selector(compare:)];
+		if ([handled count] != 0 && RanrotWithSeed(&seed) % kUnhandledEventOneIn != 0)
+		{
+			event->message = [handled objectAtIndex:RanrotWithSeed(&seed) % [handled count]];
+		}
+		else
+		{
+			event->message = [allMessages objectAtIndex:RanrotWithSeed(&seed) % [allMessages count]];
+		}
+		event->messageID = OOAIExistingMessageIDForString(event->message);
+
+		if ([[event->dictionary objectForKey:event->stateName] objectForKey:event->message] != nil)  handledEvents++;
+	}
+
+	// Warm up, and check both paths find the same actions.
+	for (i = 0; i < eventCount; i++)
+	{
+		legacyActions += DispatchLegacy(&events[i], ownerClass);
+		compiledActions += DispatchCompiled(&events[i], ownerClass);
+	}
+	actionTotal = compiledActions;
+	if (legacyActions != compiledActions)
+	{
+		OOLogWARN(kOOLogAIDispatchBenchmark, @"Legacy and compiled dispatch found different numbers of actions (%lu and %lu).", (unsigned long)legacyActions, (unsigned long)compiledActions);
+	}
+
+	OOHighResTimeValue start = OOGetHighResTime();
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		pool = [[NSAutoreleasePool alloc] init];
+		for (i = 0; i < eventCount; i++)
+		{
+			DispatchLegacy(&events[i], ownerClass);
+			if ((i % kLegacyPoolInterval) == kLegacyPoolInterval - 1)
+			{
+				[pool release];
+				pool = [[NSAutoreleasePool alloc] init];
+			}
+		}
+		[pool release];
+	}
+	OOHighResTimeValue middle = OOGetHighResTime();
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		for (i = 0; i < eventCount; i++)
+		{
+			DispatchCompiled(&events[i], ownerClass);
+		}
+	}
+	OOHighResTimeValue end = OOGetHighResTime();
+
+	double legacyNs = OOHighResTimeDeltaInSeconds(start, middle) * 1e9 / ((double)iterations * eventCount);
+	double compiledNs = OOHighResTimeDeltaInSeconds(middle, end) * 1e9 / ((double)iterations * eventCount);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(middle);
+	OODisposeHighResTime(end);
+
+	free(events);
+
+	OOLog(kOOLogAIDispatchBenchmark, @"AI dispatch benchmark, %lu state machines, %lu events (%lu handled, %lu actions) x %lu iterations:\n  legacy:   %10.1f ns/event\n  compiled: %10.1f ns/event (%.1fx)",
+		  (unsigned long)machineCount, (unsigned long)eventCount, (unsigned long)handledEvents, (unsigned long)actionTotal, (unsigned long)iterations,
+		  legacyNs, compiledNs, (compiledNs > 0.0) ? legacyNs / compiledNs : 0.0);
+
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:machineCount], @"stateMachines",
+			[NSNumber numberWithUnsignedInteger:eventCount], @"events",
+			[NSNumber numberWithUnsignedInteger:handledEvents], @"handledEvents",
+			[NSNumber numberWithUnsignedInteger:actionTotal], @"actions",
+			[NSNumber numberWithDouble:legacyNs], @"legacyNsPerEvent",
+			[NSNumber numberWithDouble:compiledNs], @"compiledNsPerEvent",
+			nil];
+}
+
+
+static NSArray *LoadBuiltInStateMachines(void)
+{
+	NSString				*folder = [[ResourceManager builtInPath] stringByAppendingPathComponent:@"AIs"];
+	NSArray					*files = [[[NSFileManager defaultManager] directoryContentsAtPath:folder] sortedArrayUsingSelector:@selector(compare:)];
+	NSMutableArray			*result = [NSMutableArray arrayWithCapacity:[files count]];
+	NSString				*file = nil;
+
+	foreach (file, files)
+	{
+		if (![[[file pathExtension] lowercaseString] isEqualToString:@"plist"])  continue;
+
+		// With no owner, the ENTER message sent on loading is ignored.
+		AI *ai = [[AI alloc] initWithStateMachine:file andState:nil];
+		OOAIStateMachine *machine = [ai stateMachine];
+		if ([machine stateCount] != 0)  [result addObject:machine];
+		[ai release];
+	}
+
+	return result;
+}
+
+
+/*	What -reactToMessage:context: and -takeAction: used to do before actually
+	calling the owner, minus logging.
+*/
+static NSUInteger DispatchLegacy(const BenchmarkEvent *event, Class ownerClass)
+{
+	NSDictionary			*messagesForState = nil;
+	NSArray					*actions = nil;
+	NSString				*action = nil;
+	NSUInteger				count = 0;
+
+	messagesForState = [event->dictionary objectForKey:event->stateName];
+	if (messagesForState == nil)  return 0;
+
+	actions = [[[messagesForState objectForKey:event->message] copy] autorelease];
+	foreach (action, actions)
+	{
+		NSArray *tokens = OOScanTokensFromString(action);
+		NSString *dataString = nil;
+		if ([tokens count] == 0)  continue;
+
+		if ([tokens count] > 1)
+		{
+			dataString = [[tokens subarrayWithRange:NSMakeRange(1, [tokens count] - 1)] componentsJoinedByString:@" "];
+		}
+
+		SEL selector = NSSelectorFromString([tokens objectAtIndex:0]);
+		(void)[ownerClass instancesRespondToSelector:selector];
+		(void)dataString;
+		count++;
+	}
+
+	return count;
+}
+
+
+static NSUInteger DispatchCompiled(const BenchmarkEvent *event, Class ownerClass)
+{
+	NSUInteger				i, count;
+	OOAIAction				*actions = NULL;
+
+	actions = [event->machine actionsForMessage:event->messageID inState:event->stateIndex count:&count];
+	for (i = 0; i < count; i++)
+	{
+		(void)OOAIActionIMPForClass(&actions[i], ownerClass);
+	}
+
+	return count;
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+
+OOBatchMathsBenchmark.h
+
+Validation and timing of the OOBatchMaths kernels.
+
+For each kernel set available on this machine, every batch operation is run
+over the same pseudo-random vectors and checked against the scalar function
+it replaces (OOVectorMultiplyMatrix(), quaternion_rotate_vector(),
+distance2() and OOBoundingBoxAddVector()), then timed over a number of
+iterations. Results within BATCH_MATHS_BENCHMARK_TOLERANCE (relative) of the
+scalar results count as matching; the kernels are normally exact, but fused
+multiply-add in the scalar code can change the last bit or two.
+
+Only available in debug builds. Can be run from the debug console with
+console.runBatchMathsBenchmark([vectorCount [, iterations]]).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define BATCH_MATHS_BENCHMARK_DEFAULT_COUNT			4096
+#define BATCH_MATHS_BENCHMARK_DEFAULT_ITERATIONS	200
+#define BATCH_MATHS_BENCHMARK_TOLERANCE				1e-5f
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary keyed by kernel set name ("scalar", "SSE2" etc.),
+	each containing a dictionary for each operation with the keys
+	nsPerVector, mismatches and maxRelativeError. Results are also written to
+	the log under maths.batch.benchmark. Returns nil if vectorCount or
+	iterations is zero, or memory can't be allocated.
+*/
+NSDictionary *OOBatchMathsRunBenchmark(NSUInteger vectorCount, NSUInteger iterations);
+
+#endif
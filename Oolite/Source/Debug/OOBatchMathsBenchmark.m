@@ -0,0 +1,303 @@
+/*
+
+OOBatchMathsBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOBatchMathsBenchmark.h"
+#import "OOProfilingStopwatch.h"
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogBatchMathsBenchmark			= @"maths.batch.benchmark";
+static NSString * const kOOLogBatchMathsBenchmarkMismatch	= @"maths.batch.benchmark.mismatch";
+
+
+typedef enum
+{
+	kOpMultiplyMatrix,
+	kOpRotateVectors,
+	kOpDistance2,
+	kOpBoundingBox,
+	kOpTransformedBoundingBox,
+
+	kOpCount
+} BenchmarkOp;
+
+
+typedef struct
+{
+	NSUInteger				count;
+	const Vector			*input;
+	OOMatrix				matrix;
+	Quaternion				rotation;
+	Vector					point;
+
+	// Scalar reference results.
+	Vector					*transformed;
+	Vector					*rotated;
+	OOScalar				*distances;
+	OOBoundingBox			box;
+	OOBoundingBox			transformedBox;
+
+	// Output buffers for the batch functions.
+	Vector					*vectorOut;
+	OOScalar				*scalarOut;
+} BenchmarkData;
+
+
+static NSString * const kOpNames[kOpCount] =
+{
+	@"vectorMultiplyMatrix",
+	@"quaternionRotateVectors",
+	@"distance2",
+	@"boundingBox",
+	@"boundingBoxOfTransformedVectors"
+};
+
+
+static void ComputeReferenceResults(BenchmarkData *data);
+static void RunOp(BenchmarkOp op, BenchmarkData *data, OOBoundingBox *outBox);
+static NSUInteger CheckOp(BenchmarkOp op, BenchmarkData *data, float *outMaxError);
+OOINLINE float RelativeError(float value, float expected);
+OOINLINE float VectorRelativeError(Vector value, Vector expected);
+
+
+NSDictionary *OOBatchMathsRunBenchmark(NSUInteger vectorCount, NSUInteger iterations)
+{
+	BenchmarkData			data;
+	Vector					*input = NULL;
+	NSUInteger				i, iteration;
+	unsigned				op;
+	OOBatchMathsImplementation implementation, previous;
+	NSMutableDictionary		*result = nil;
+	NSMutableString			*report = nil;
+	RANROTSeed				seed = MakeRanrotSeed(12345);
+
+	if (vectorCount == 0 || iterations == 0)  return nil;
+
+	input = malloc(vectorCount * sizeof *input);
+	data.transformed = malloc(vectorCount * sizeof *data.transformed);
+	data.rotated = malloc(vectorCount * sizeof *data.rotated);
+	data.distances = malloc(vectorCount * sizeof *data.distances);
+	data.vectorOut = malloc(vectorCount * sizeof *data.vectorOut);
+	data.scalarOut = malloc(vectorCount * sizeof *data.scalarOut);
+	if (input == NULL || data.transformed == NULL || data.rotated == NULL || data.distances == NULL || data.vectorOut == NULL || data.scalarOut == NULL)
+	{
+		free(input);
+		free(data.transformed);
+		free(data.rotated);
+		free(data.distances);
+		free(data.vectorOut);
+		free(data.scalarOut);
+		return nil;
+	}
+
+	// Ship-sized coordinates, and a typical subentity transformation.
+	for (i = 0; i < vectorCount; i++)
+	{
+		input[i].x = (RanrotWithSeed(&seed) & 0xFFFF) / 32.0f - 1024.0f;
+		input[i].y = (RanrotWithSeed(&seed) & 0xFFFF) / 32.0f - 1024.0f;
+		input[i].z = (RanrotWithSeed(&seed) & 0xFFFF) / 32.0f - 1024.0f;
+	}
+	data.count = vectorCount;
+	data.input = input;
+	data.rotation = make_quaternion(0.8f, 0.2f, -0.4f, 0.4f);
+	quaternion_normalize(&data.rotation);
+	data.matrix = OOMatrixFromOrientationAndPosition(data.rotation, make_vector(120.0f, -35.5f, 900.25f));
+	data.point = make_vector(-250.0f, 17.0f, 3.5f);
+
+	ComputeReferenceResults(&data);
+
+	result = [NSMutableDictionary dictionary];
+	report = [NSMutableString string];
+	[report appendFormat:@"%-32s %-8s %12s %10s %12s\n", "operation", "kernels", "ns/vector", "mismatch", "max error"];
+
+	previous = OOBatchMathsGetImplementation();
+
+	for (implementation = 0; implementation < kOOBatchMathsImplementationCount; implementation++)
+	{
+		if (!OOBatchMathsSetImplementation(implementation))  continue;
+
+		NSString *implementationName = [NSString stringWithUTF8String:OOBatchMathsImplementationName(implementation)];
+		NSMutableDictionary *opResults = [NSMutableDictionary dictionaryWithCapacity:kOpCount];
+
+		for (op = 0; op < kOpCount; op++)
+		{
+			float maxError = 0.0f;
+			OOBoundingBox box;
+
+			NSUInteger mismatches = CheckOp(op, &data, &maxError);
+			if (mismatches != 0)
+			{
+				OOLog(kOOLogBatchMathsBenchmarkMismatch, @"***** %@ %@ differs from the scalar function for %lu of %lu vectors (max relative error %g).", implementationName, kOpNames[op], (unsigned long)mismatches, (unsigned long)vectorCount, maxError);
+			}
+
+			OOHighResTimeValue start = OOGetHighResTime();
+			for (iteration = 0; iteration < iterations; iteration++)  RunOp(op, &data, &box);
+			OOHighResTimeValue end = OOGetHighResTime();
+			double nsPerVector = OOHighResTimeDeltaInSeconds(start, end) * 1e9 / ((double)iterations * vectorCount);
+			OODisposeHighResTime(start);
+			OODisposeHighResTime(end);
+
+			[opResults setObject:[NSDictionary dictionaryWithObjectsAndKeys:
+								  [NSNumber numberWithDouble:nsPerVector], @"nsPerVector",
+								  [NSNumber numberWithUnsignedInteger:mismatches], @"mismatches",
+								  [NSNumber numberWithFloat:maxError], @"maxRelativeError",
+								  nil]
+						  forKey:kOpNames[op]];
+			[report appendFormat:@"%-32s %-8s %12.3f %10lu %12g\n", [kOpNames[op] UTF8String], [implementationName UTF8String], nsPerVector, (unsigned long)mismatches, maxError];
+		}
+
+		[result setObject:opResults forKey:implementationName];
+	}
+
+	OOBatchMathsSetImplementation(previous);
+
+	OOLog(kOOLogBatchMathsBenchmark, @"Batch maths benchmark, %lu vectors x %lu iterations, using %s by default:\n%@", (unsigned long)vectorCount, (unsigned long)iterations, OOBatchMathsImplementationName(previous), report);
+
+	free(input);
+	free(data.transformed);
+	free(data.rotated);
+	free(data.distances);
+	free(data.vectorOut);
+	free(data.scalarOut);
+
+	return result;
+}
+
+
+static void ComputeReferenceResults(BenchmarkData *data)
+{
+	NSUInteger				i;
+
+	for (i = 0; i < data->count; i++)
+	{
+		data->transformed[i] = OOVectorMultiplyMatrix(data->input[i], data->matrix);
+		data->rotated[i] = quaternion_rotate_vector(data->rotation, data->input[i]);
+		data->distances[i] = distance2(data->input[i], data->point);
+
+		if (i == 0)
+		{
+			OOBoundingBoxResetToVector(&data->box, data->input[i]);
+			OOBoundingBoxResetToVector(&data->transformedBox, data->transformed[i]);
+		}
+		else
+		{
+			OOBoundingBoxAddVector(&data->box, data->input[i]);
+			OOBoundingBoxAddVector(&data->transformedBox, data->transformed[i]);
+		}
+	}
+}
+
+
+static void RunOp(BenchmarkOp op, BenchmarkData *data, OOBoundingBox *outBox)
+{
+	switch (op)
+	{
+		case kOpMultiplyMatrix:
+			OOBatchVectorMultiplyMatrix(data->input, data->vectorOut, data->count, data->matrix);
+			break;
+
+		case kOpRotateVectors:
+			OOBatchQuaternionRotateVectors(data->input, data->vectorOut, data->count, data->rotation);
+			break;
+
+		case kOpDistance2:
+			OOBatchDistance2(data->input, data->scalarOut, data->count, data->point);
+			break;
+
+		case kOpBoundingBox:
+			*outBox = OOBatchBoundingBox(data->input, data->count);
+			break;
+
+		case kOpTransformedBoundingBox:
+			*outBox = OOBatchBoundingBoxOfTransformedVectors(data->input, data->count, data->matrix);
+			break;
+
+		case kOpCount:
+			break;
+	}
+}
+
+
+static NSUInteger CheckOp(BenchmarkOp op, BenchmarkData *data, float *outMaxError)
+{
+	NSUInteger				i, mismatches = 0;
+	float					error, maxError = 0.0f;
+	OOBoundingBox			box;
+	const Vector			*expected = NULL;
+
+	RunOp(op, data, &box);
+
+	switch (op)
+	{
+		case kOpMultiplyMatrix:
+		case kOpRotateVectors:
+			expected = (op == kOpMultiplyMatrix) ? data->transformed : data->rotated;
+			for (i = 0; i < data->count; i++)
+			{
+				error = VectorRelativeError(data->vectorOut[i], expected[i]);
+				if (error > BATCH_MATHS_BENCHMARK_TOLERANCE)  mismatches++;
+				maxError = fmaxf(maxError, error);
+			}
+			break;
+
+		case kOpDistance2:
+			for (i = 0; i < data->count; i++)
+			{
+				error = RelativeError(data->scalarOut[i], data->distances[i]);
+				if (error > BATCH_MATHS_BENCHMARK_TOLERANCE)  mismatches++;
+				maxError = fmaxf(maxError, error);
+			}
+			break;
+
+		case kOpBoundingBox:
+		case kOpTransformedBoundingBox:
+		{
+			OOBoundingBox expectedBox = (op == kOpBoundingBox) ? data->box : data->transformedBox;
+			maxError = fmaxf(VectorRelativeError(box.min, expectedBox.min), VectorRelativeError(box.max, expectedBox.max));
+			if (maxError > BATCH_MATHS_BENCHMARK_TOLERANCE)  mismatches = 1;
+			break;
+		}
+
+		case kOpCount:
+			break;
+	}
+
+	*outMaxError = maxError;
+	return mismatches;
+}
+
+
+OOINLINE float RelativeError(float value, float expected)
+{
+	return fabsf(value - expected) / fmaxf(fabsf(expected), 1.0f);
+}
+
+
+OOINLINE float VectorRelativeError(Vector value, Vector expected)
+{
+	return fmaxf(RelativeError(value.x, expected.x), fmaxf(RelativeError(value.y, expected.y), RelativeError(value.z, expected.z)));
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*
+
+OOCacheStoreBenchmark.h
+
+Load time and memory use of the data cache, comparing the per-cache shard
+files used by OOCacheManager with the old single property list.
+
+The current contents of every cache are written in both formats to a
+temporary folder. Each iteration then "starts up" from each store and looks
+up one entry in every cache, as happens early in a normal launch: the plist
+store has to be read and parsed in full first, while each shard is mapped
+when its cache is first used and only the requested entry is decoded. The
+shards are also timed decoding every entry, as an upper bound. Resident set
+size is sampled before and after each load, while the loaded data is still
+alive. Files are read through the OS file cache in all cases, so this
+measures parsing and decoding rather than disk speed.
+
+Only available in debug builds. Can be run from the debug console with
+console.runCacheStoreBenchmark([iterations]).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define CACHE_STORE_BENCHMARK_DEFAULT_ITERATIONS	10
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary with the keys caches, entries, plistBytes,
+	shardBytes, plistLoadMs, shardLookupMs, shardFullLoadMs, plistRSSDelta,
+	shardLookupRSSDelta and shardFullRSSDelta. Times are means over the
+	iterations; RSS deltas are the largest seen, in bytes, and are zero where
+	the platform doesn't provide them. Results are also written to the log
+	under dataCache.benchmark. Returns nil if iterations is zero or the caches
+	are empty.
+*/
+NSDictionary *OOCacheStoreRunBenchmark(NSUInteger iterations);
+
+#endif
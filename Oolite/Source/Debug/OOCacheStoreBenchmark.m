@@ -0,0 +1,252 @@
+/*
+
+OOCacheStoreBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOCacheStoreBenchmark.h"
+#import "OOCacheManager.h"
+#import "OOCacheShard.h"
+#import "OOProfilingStopwatch.h"
+#import "OOVersion.h"
+
+#if OOLITE_MAC_OS_X
+#import <mach/mach.h>
+#endif
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogCacheStoreBenchmark		= @"dataCache.benchmark";
+
+
+#if OOLITE_MAC_OS_X
+#define CACHE_PLIST_FORMAT	NSPropertyListBinaryFormat_v1_0
+#else
+#define CACHE_PLIST_FORMAT	NSPropertyListGNUstepBinaryFormat
+#endif
+
+
+static size_t ResidentSetSize(void);
+OOINLINE size_t RSSDelta(size_t before, size_t after)  { return (after > before) ? after - before : 0; }
+
+
+NSDictionary *OOCacheStoreRunBenchmark(NSUInteger iterations)
+{
+	NSDictionary			*caches = nil;
+	NSMutableArray			*probeCaches = nil;
+	NSMutableArray			*probeKeys = nil;
+	NSString				*folder = nil;
+	NSString				*plistPath = nil;
+	NSString				*cacheKey = nil;
+	NSData					*data = nil;
+	NSFileManager			*fmgr = [NSFileManager defaultManager];
+	NSAutoreleasePool		*pool = nil;
+	NSUInteger				i, iteration, cacheCount, entryCount = 0, plistBytes = 0, shardBytes = 0;
+	NSUInteger				plistFound = 0, shardFound = 0;
+	size_t					plistRSS = 0, shardLookupRSS = 0, shardFullRSS = 0;
+	double					plistTime = 0.0, shardLookupTime = 0.0, shardFullTime = 0.0;
+	uint64_t				endianTagValue = 0x0123456789ABCDEFULL;
+	RANROTSeed				seed = MakeRanrotSeed(1138);
+	
+	if (iterations == 0)  return nil;
+	
+	caches = [[OOCacheManager sharedCache] contentsOfAllCaches];
+	cacheCount = [caches count];
+	if (cacheCount == 0)  return nil;
+	
+	folder = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"Oolite cache benchmark %u", (unsigned)getpid()]];
+	if (![fmgr createDirectoryAtPath:folder withIntermediateDirectories:YES attributes:nil error:NULL])
+	{
+		OOLogERR(kOOLogCacheStoreBenchmark, @"Could not create temporary folder %@.", folder);
+		return nil;
+	}
+	
+	// Write both stores, and pick an entry to look up in each cache.
+	probeCaches = [NSMutableArray arrayWithCapacity:cacheCount];
+	probeKeys = [NSMutableArray arrayWithCapacity:cacheCount];
+	foreach (cacheKey, [[caches allKeys] sortedArrayUsingSelector:@selector(compare:)])
+	{
+		NSDictionary *cache = [caches objectForKey:cacheKey];
+		NSArray *keys = [[cache allKeys] sortedArrayUsingSelector:@selector(compare:)];
+		entryCount += [keys count];
+		if ([keys count] == 0)  continue;
+		
+		data = [OOCacheShard dataWithContents:cache name:cacheKey];
+		if (![data writeToFile:[folder stringByAppendingPathComponent:[OOCacheShard fileNameForCacheName:cacheKey]] atomically:NO])
+		{
+			OOLogERR(kOOLogCacheStoreBenchmark, @"Could not write benchmark data for cache \"%@\".", cacheKey);
+			[fmgr removeFileAtPath:folder handler:nil];
+			return nil;
+		}
+		shardBytes += [data length];
+		
+		[probeCaches addObject:cacheKey];
+		[probeKeys addObject:[keys objectAtIndex:RanrotWithSeed(&seed) % [keys count]]];
+	}
+	
+	data = [NSPropertyListSerialization dataFromPropertyList:[NSDictionary dictionaryWithObjectsAndKeys:
+															  OoliteVersion(), @"version",
+															  [NSNumber numberWithUnsignedInt:0], @"format version",
+															  [NSData dataWithBytes:&endianTagValue length:sizeof endianTagValue], @"endian tag",
+															  caches, @"caches",
+															  nil]
+													  format:CACHE_PLIST_FORMAT
+											errorDescription:NULL];
+	plistPath = [folder stringByAppendingPathComponent:@"Data Cache.plist"];
+	if (![data writeToFile:plistPath atomically:NO])
+	{
+		OOLogERR(kOOLogCacheStoreBenchmark, @"Could not write benchmark data for plist store.");
+		[fmgr removeFileAtPath:folder handler:nil];
+		return nil;
+	}
+	plistBytes = [data length];
+	
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		// Old store: parse everything, then look up.
+		pool = [[NSAutoreleasePool alloc] init];
+		size_t rssBefore = ResidentSetSize();
+		OOHighResTimeValue start = OOGetHighResTime();
+		
+		NSDictionary *plist = [NSPropertyListSerialization propertyListFromData:[NSData dataWithContentsOfFile:plistPath]
+															   mutabilityOption:NSPropertyListImmutable
+																		 format:NULL
+															   errorDescription:NULL];
+		NSDictionary *plistCaches = [plist oo_dictionaryForKey:@"caches"];
+		plistFound = 0;
+		for (i = 0; i < [probeCaches count]; i++)
+		{
+			if ([[plistCaches oo_dictionaryForKey:[probeCaches objectAtIndex:i]] objectForKey:[probeKeys objectAtIndex:i]] != nil)  plistFound++;
+		}
+		
+		OOHighResTimeValue end = OOGetHighResTime();
+		plistTime += OOHighResTimeDeltaInSeconds(start, end);
+		plistRSS = MAX(plistRSS, RSSDelta(rssBefore, ResidentSetSize()));
+		OODisposeHighResTime(start);
+		OODisposeHighResTime(end);
+		[pool release];
+		
+		// Shards: open each cache on first use, decoding only what is looked up.
+		pool = [[NSAutoreleasePool alloc] init];
+		rssBefore = ResidentSetSize();
+		start = OOGetHighResTime();
+		
+		NSMutableDictionary *shards = [NSMutableDictionary dictionaryWithCapacity:cacheCount];
+		shardFound = 0;
+		for (i = 0; i < [probeCaches count]; i++)
+		{
+			cacheKey = [probeCaches objectAtIndex:i];
+			OOCacheShard *shard = [shards objectForKey:cacheKey];
+			if (shard == nil)
+			{
+				shard = [[OOCacheShard alloc] initWithContentsOfFile:[folder stringByAppendingPathComponent:[OOCacheShard fileNameForCacheName:cacheKey]] name:cacheKey];
+				if (shard != nil)  [shards setObject:shard forKey:cacheKey];
+				[shard release];
+			}
+			if ([shard objectForKey:[probeKeys objectAtIndex:i]] != nil)  shardFound++;
+		}
+		
+		end = OOGetHighResTime();
+		shardLookupTime += OOHighResTimeDeltaInSeconds(start, end);
+		shardLookupRSS = MAX(shardLookupRSS, RSSDelta(rssBefore, ResidentSetSize()));
+		OODisposeHighResTime(start);
+		OODisposeHighResTime(end);
+		[pool release];
+		
+		// Shards, decoding everything.
+		pool = [[NSAutoreleasePool alloc] init];
+		rssBefore = ResidentSetSize();
+		start = OOGetHighResTime();
+		
+		NSMutableArray *contents = [NSMutableArray arrayWithCapacity:cacheCount];
+		foreach (cacheKey, probeCaches)
+		{
+			OOCacheShard *shard = [[OOCacheShard alloc] initWithContentsOfFile:[folder stringByAppendingPathComponent:[OOCacheShard fileNameForCacheName:cacheKey]] name:cacheKey];
+			NSDictionary *dict = [shard dictionaryRepresentation];
+			if (dict != nil)  [contents addObject:dict];
+			[shard release];
+		}
+		
+		end = OOGetHighResTime();
+		shardFullTime += OOHighResTimeDeltaInSeconds(start, end);
+		shardFullRSS = MAX(shardFullRSS, RSSDelta(rssBefore, ResidentSetSize()));
+		OODisposeHighResTime(start);
+		OODisposeHighResTime(end);
+		[pool release];
+	}
+	
+	[fmgr removeFileAtPath:folder handler:nil];
+	
+	if (plistFound != shardFound || shardFound != [probeCaches count])
+	{
+		OOLogWARN(kOOLogCacheStoreBenchmark, @"Lookups found different numbers of entries (plist %lu, shards %lu, of %lu).", (unsigned long)plistFound, (unsigned long)shardFound, (unsigned long)[probeCaches count]);
+	}
+	
+	double plistMs = plistTime * 1000.0 / iterations;
+	double shardLookupMs = shardLookupTime * 1000.0 / iterations;
+	double shardFullMs = shardFullTime * 1000.0 / iterations;
+	
+	OOLog(kOOLogCacheStoreBenchmark, @"Data cache store benchmark, %lu caches, %lu entries, x %lu iterations:\n  plist, load and look up:   %8.2f ms, %10lu bytes on disk, RSS +%lu KiB\n  shards, look up:           %8.2f ms, %10lu bytes on disk, RSS +%lu KiB (%.1fx)\n  shards, decode everything: %8.2f ms,                       RSS +%lu KiB",
+		  (unsigned long)cacheCount, (unsigned long)entryCount, (unsigned long)iterations,
+		  plistMs, (unsigned long)plistBytes, (unsigned long)(plistRSS / 1024),
+		  shardLookupMs, (unsigned long)shardBytes, (unsigned long)(shardLookupRSS / 1024), (shardLookupMs > 0.0) ? plistMs / shardLookupMs : 0.0,
+		  shardFullMs, (unsigned long)(shardFullRSS / 1024));
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:cacheCount], @"caches",
+			[NSNumber numberWithUnsignedInteger:entryCount], @"entries",
+			[NSNumber numberWithUnsignedInteger:plistBytes], @"plistBytes",
+			[NSNumber numberWithUnsignedInteger:shardBytes], @"shardBytes",
+			[NSNumber numberWithDouble:plistMs], @"plistLoadMs",
+			[NSNumber numberWithDouble:shardLookupMs], @"shardLookupMs",
+			[NSNumber numberWithDouble:shardFullMs], @"shardFullLoadMs",
+			[NSNumber numberWithUnsignedLongLong:plistRSS], @"plistRSSDelta",
+			[NSNumber numberWithUnsignedLongLong:shardLookupRSS], @"shardLookupRSSDelta",
+			[NSNumber numberWithUnsignedLongLong:shardFullRSS], @"shardFullRSSDelta",
+			nil];
+}
+
+
+static size_t ResidentSetSize(void)
+{
+#if OOLITE_MAC_OS_X
+	struct task_basic_info	info;
+	mach_msg_type_number_t	count = TASK_BASIC_INFO_COUNT;
+	
+	if (task_info(mach_task_self(), TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)  return 0;
+	return info.resident_size;
+#elif OOLITE_LINUX
+	FILE					*statm = NULL;
+	unsigned long			size, resident = 0;
+	
+	statm = fopen("/proc/self/statm", "r");
+	if (statm == NULL)  return 0;
+	if (fscanf(statm, "%lu %lu", &size, &resident) != 2)  resident = 0;
+	fclose(statm);
+	
+	return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+#endif
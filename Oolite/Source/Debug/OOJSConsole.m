@@ -43,6 +43,19 @@ SOFTWARE.
 #import "OODebugMonitor.h"
 #import "OOProfilingStopwatch.h"
 #import "ResourceManager.h"
+#import "OOUpdateBenchmark.h"
+#import "OOBatchMathsBenchmark.h"
+#import "OOAIDispatchBenchmark.h"
+#import "OOOctreeBenchmark.h"
+#import "OOCacheStoreBenchmark.h"
+#import "OOPlanetTextureBenchmark.h"
+#import "OOScriptTimerBenchmark.h"
+#import "OOJSVectorBenchmark.h"
+#import "OOLogFilterBenchmark.h"
+#import "OOSpatialQueryBenchmark.h"
+#import "OOAIThinkScheduler.h"
+#import "OOEntity.h"
+#import "OOPlayerShipEntity.h"
 
 
 @interface OOEntity (OODebugInspector)
@@ -74,6 +87,21 @@ static JSBool ConsoleSetDisplayMessagesInClass(JSContext *context, uintN argc, j
 static JSBool ConsoleWriteLogMarker(JSContext *context, uintN argc, jsval *vp);
 static JSBool ConsoleWriteMemoryStats(JSContext *context, uintN argc, jsval *vp);
 static JSBool ConsoleGarbageCollect(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleGetWorldScriptEventStatistics(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunUpdateBenchmark(JSContext *context, uintN argc, jsval *vp);
+#ifndef NDEBUG
+static JSBool ConsoleRunSpatialQueryBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunBatchMathsBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunAIDispatchBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunOctreeBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleSetOctreeBenchmarkTracing(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunCacheStoreBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunPlanetTextureBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunScriptTimerBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunVectorBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleRunLogFilterBenchmark(JSContext *context, uintN argc, jsval *vp);
+static JSBool ConsoleGetAIThinkStatistics(JSContext *context, uintN argc, jsval *vp);
+#endif
 #if DEBUG
 static JSBool ConsoleDumpNamedRoots(JSContext *context, uintN argc, jsval *vp);
 static JSBool ConsoleDumpHeap(JSContext *context, uintN argc, jsval *vp);
@@ -196,6 +224,21 @@ static JSFunctionSpec sConsoleMethods[] =
 	{ "writeLogMarker",					ConsoleWriteLogMarker,				0 },
 	{ "writeMemoryStats",				ConsoleWriteMemoryStats,			0 },
 	{ "garbageCollect",					ConsoleGarbageCollect,				0 },
+	{ "getWorldScriptEventStatistics",	ConsoleGetWorldScriptEventStatistics, 0 },
+	{ "runUpdateBenchmark",				ConsoleRunUpdateBenchmark,			2 },
+#ifndef NDEBUG
+	{ "runSpatialQueryBenchmark",		ConsoleRunSpatialQueryBenchmark,	1 },
+	{ "runBatchMathsBenchmark",			ConsoleRunBatchMathsBenchmark,		0 },
+	{ "runAIDispatchBenchmark",			ConsoleRunAIDispatchBenchmark,		0 },
+	{ "runOctreeBenchmark",				ConsoleRunOctreeBenchmark,			0 },
+	{ "setOctreeBenchmarkTracing",		ConsoleSetOctreeBenchmarkTracing,	1 },
+	{ "runCacheStoreBenchmark",			ConsoleRunCacheStoreBenchmark,		0 },
+	{ "runPlanetTextureBenchmark",		ConsoleRunPlanetTextureBenchmark,	0 },
+	{ "runScriptTimerBenchmark",		ConsoleRunScriptTimerBenchmark,		0 },
+	{ "runVectorBenchmark",				ConsoleRunVectorBenchmark,			0 },
+	{ "runLogFilterBenchmark",			ConsoleRunLogFilterBenchmark,		0 },
+	{ "getAIThinkStatistics",			ConsoleGetAIThinkStatistics,		0 },
+#endif
 #if DEBUG
 	{ "dumpNamedRoots",					ConsoleDumpNamedRoots,				0 },
 	{ "dumpHeap",						ConsoleDumpHeap,					0 },
@@ -892,6 +935,346 @@ static JSBool ConsoleGarbageCollect(JSContext *context, uintN argc, jsval *vp)
 }
 
 
+// function getWorldScriptEventStatistics([reset : Boolean]) : Object
+static JSBool ConsoleGetWorldScriptEventStatistics(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	JSBool					reset = NO;
+	NSDictionary			*result = nil;
+	OOPlayerShipEntity		*player = PLAYER;
+	
+	if (argc > 0 && EXPECT_NOT(!JS_ValueToBoolean(context, OOJS_ARGV[0], &reset)))
+	{
+		OOJSReportBadArguments(context, @"Console", @"getWorldScriptEventStatistics", argc, OOJS_ARGV, nil, @"optional boolean");
+		return NO;
+	}
+	
+	result = [player worldScriptEventStatistics];
+	if (reset)  [player resetWorldScriptEventStatistics];
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runUpdateBenchmark(shipCount : Number, frameCount : Number [, role : String [, timeDelta : Number]]) : Object
+static JSBool ConsoleRunUpdateBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					shipCount, frameCount;
+	NSString				*role = UPDATE_BENCHMARK_DEFAULT_ROLE;
+	jsdouble				timeDelta = UPDATE_BENCHMARK_DEFAULT_DELTA_T;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT(argc < 2 ||
+				   !JS_ValueToECMAUint32(context, OOJS_ARGV[0], &shipCount) ||
+				   !JS_ValueToECMAUint32(context, OOJS_ARGV[1], &frameCount) ||
+				   frameCount == 0 ||
+				   (argc > 2 && (role = OOStringFromJSValue(context, OOJS_ARGV[2])) == nil) ||
+				   (argc > 3 && (!JS_ValueToNumber(context, OOJS_ARGV[3], &timeDelta) || !(timeDelta > 0.0)))))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runUpdateBenchmark", argc, OOJS_ARGV, nil, @"ship count, frame count, optional role and time delta");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	OOUpdateBenchmark *benchmark = [[OOUpdateBenchmark alloc] initWithShipCount:shipCount
+																	 frameCount:frameCount
+																	  timeDelta:timeDelta
+																		   role:role
+																		   seed:UPDATE_BENCHMARK_DEFAULT_SEED];
+	result = [benchmark run];
+	[benchmark release];
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+#ifndef NDEBUG
+// function runSpatialQueryBenchmark(queryCount : Number [, range : Number]) : Object
+static JSBool ConsoleRunSpatialQueryBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					queryCount;
+	jsdouble				range = SCANNER_MAX_RANGE;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT(argc < 1 ||
+				   !JS_ValueToECMAUint32(context, OOJS_ARGV[0], &queryCount) ||
+				   queryCount == 0 ||
+				   (argc > 1 && (!JS_ValueToNumber(context, OOJS_ARGV[1], &range) || !(range >= 0.0)))))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runSpatialQueryBenchmark", argc, OOJS_ARGV, nil, @"query count and optional range");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOSpatialQueryRunBenchmark(queryCount, range);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runBatchMathsBenchmark([vectorCount : Number [, iterations : Number]]) : Object
+static JSBool ConsoleRunBatchMathsBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					vectorCount = BATCH_MATHS_BENCHMARK_DEFAULT_COUNT;
+	uint32					iterations = BATCH_MATHS_BENCHMARK_DEFAULT_ITERATIONS;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT((argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &vectorCount) || vectorCount == 0)) ||
+				   (argc > 1 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[1], &iterations) || iterations == 0))))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runBatchMathsBenchmark", argc, OOJS_ARGV, nil, @"optional vector count and iteration count");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOBatchMathsRunBenchmark(vectorCount, iterations);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runAIDispatchBenchmark([eventCount : Number [, iterations : Number]]) : Object
+static JSBool ConsoleRunAIDispatchBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					eventCount = AI_DISPATCH_BENCHMARK_DEFAULT_EVENTS;
+	uint32					iterations = AI_DISPATCH_BENCHMARK_DEFAULT_ITERATIONS;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT((argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &eventCount) || eventCount == 0)) ||
+				   (argc > 1 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[1], &iterations) || iterations == 0))))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runAIDispatchBenchmark", argc, OOJS_ARGV, nil, @"optional event count and iteration count");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOAIDispatchRunBenchmark(eventCount, iterations);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runOctreeBenchmark([iterations : Number]) : Object
+static JSBool ConsoleRunOctreeBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					iterations = OCTREE_BENCHMARK_DEFAULT_ITERATIONS;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT(argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &iterations) || iterations == 0)))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runOctreeBenchmark", argc, OOJS_ARGV, nil, @"optional iteration count");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOOctreeRunBenchmark(iterations);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function setOctreeBenchmarkTracing(flag : Boolean) : void
+static JSBool ConsoleSetOctreeBenchmarkTracing(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	JSBool					flag;
+	
+	if (EXPECT_NOT(argc < 1 || !JS_ValueToBoolean(context, OOJS_ARGV[0], &flag)))
+	{
+		OOJSReportBadArguments(context, @"Console", @"setOctreeBenchmarkTracing", argc, OOJS_ARGV, nil, @"boolean");
+		return NO;
+	}
+	
+	OOOctreeBenchmarkSetTracing(flag);
+	OOJS_RETURN_VOID;
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runCacheStoreBenchmark([iterations : Number]) : Object
+static JSBool ConsoleRunCacheStoreBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					iterations = CACHE_STORE_BENCHMARK_DEFAULT_ITERATIONS;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT(argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &iterations) || iterations == 0)))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runCacheStoreBenchmark", argc, OOJS_ARGV, nil, @"optional iteration count");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOCacheStoreRunBenchmark(iterations);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runPlanetTextureBenchmark([entryCount : Number [, maxSize : Number]]) : Object
+static JSBool ConsoleRunPlanetTextureBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					entryCount = PLANET_TEXTURE_BENCHMARK_DEFAULT_ENTRIES;
+	uint32					maxSize = PLANET_TEXTURE_BENCHMARK_DEFAULT_MAX_SIZE;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT((argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &entryCount) || entryCount == 0)) ||
+				   (argc > 1 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[1], &maxSize) || maxSize < 256))))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runPlanetTextureBenchmark", argc, OOJS_ARGV, nil, @"optional planet count and maximum texture size");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOPlanetTextureRunBenchmark(entryCount, maxSize);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runScriptTimerBenchmark([timerCount : Number [, seconds : Number]]) : Object
+static JSBool ConsoleRunScriptTimerBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					timerCount = SCRIPT_TIMER_BENCHMARK_DEFAULT_TIMERS;
+	uint32					seconds = SCRIPT_TIMER_BENCHMARK_DEFAULT_SECONDS;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT((argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &timerCount) || timerCount == 0)) ||
+				   (argc > 1 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[1], &seconds) || seconds == 0))))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runScriptTimerBenchmark", argc, OOJS_ARGV, nil, @"optional timer count and number of seconds");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOScriptTimerRunBenchmark(timerCount, seconds);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runVectorBenchmark([operations : Number]) : Object
+static JSBool ConsoleRunVectorBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					operations = VECTOR_BENCHMARK_DEFAULT_OPERATIONS;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT(argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &operations) || operations == 0)))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runVectorBenchmark", argc, OOJS_ARGV, nil, @"optional number of operations");
+		return NO;
+	}
+	
+	// Not a full native block, since the benchmark runs JavaScript.
+	OOJSPauseTimeLimiter();
+	result = OOJSVectorRunBenchmark(context, [[OOJavaScriptEngine sharedEngine] globalObject], OOJSValueFromNativeObject(context, PLAYER), operations);
+	OOJSResumeTimeLimiter();
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function runLogFilterBenchmark([threadCount : Number [, calls : Number]]) : Object
+static JSBool ConsoleRunLogFilterBenchmark(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	uint32					threadCount = 0;
+	uint32					calls = LOG_FILTER_BENCHMARK_DEFAULT_CALLS;
+	NSDictionary			*result = nil;
+	
+	if (EXPECT_NOT((argc > 0 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[0], &threadCount) || threadCount > LOG_FILTER_BENCHMARK_MAX_THREADS)) ||
+				   (argc > 1 && (!JS_ValueToECMAUint32(context, OOJS_ARGV[1], &calls) || calls == 0))))
+	{
+		OOJSReportBadArguments(context, @"Console", @"runLogFilterBenchmark", argc, OOJS_ARGV, nil, @"optional thread count (0 for one per CPU) and number of calls per thread");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = OOLogFilterRunBenchmark(threadCount, calls);
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// function getAIThinkStatistics([reset : Boolean]) : Object
+static JSBool ConsoleGetAIThinkStatistics(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	JSBool					reset = NO;
+	NSDictionary			*result = nil;
+	OOAIThinkScheduler		*scheduler = [UNIVERSE thinkScheduler];
+	
+	if (argc > 0 && EXPECT_NOT(!JS_ValueToBoolean(context, OOJS_ARGV[0], &reset)))
+	{
+		OOJSReportBadArguments(context, @"Console", @"getAIThinkStatistics", argc, OOJS_ARGV, nil, @"optional boolean");
+		return NO;
+	}
+	
+	OOJS_BEGIN_FULL_NATIVE(context)
+	result = [scheduler statistics];
+	if (reset)  [scheduler resetStatistics];
+	OOJS_END_FULL_NATIVE
+	
+	OOJS_RETURN_OBJECT(result);
+	
+	OOJS_NATIVE_EXIT
+}
+#endif
+
+
 #if DEBUG
 typedef struct
 {
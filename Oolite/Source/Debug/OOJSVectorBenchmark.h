@@ -0,0 +1,73 @@
+/*
+
+OOJSVectorBenchmark.h
+
+Measures what Vector3D and Quaternion traffic costs JavaScript, and how much
+of it the in-place APIs save.
+
+Each case is a small JavaScript loop, compiled into the given context
+and run for the given number of operations: reading entity.position against
+entity.getPosition(v), Vector3D.add() with and without a result parameter,
+Quaternion.rotateX() with and without a result parameter, Vector3D.dot()
+(which converts its argument but creates nothing) and reading vector
+components. The allocating and in-place version of each operation must
+give the same result, or a mismatch is logged.
+
+For each case the benchmark reports the time taken, the number of Vector3D
+and Quaternion private cells allocated and pool chunks malloc()ed (see
+OOJSPrivatePool.h), and the number of garbage collections SpiderMonkey ran,
+all scaled to per million operations. A full collection is done before each
+case so that they start alike.
+
+Nothing beyond the context, its global object and an Entity to read is
+used; the game's script engine and universe are not touched.
+
+Only available in debug builds. Can be run from the debug console with
+console.runVectorBenchmark([operations]), which uses the player ship.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+#include <jsapi.h>
+
+
+#define VECTOR_BENCHMARK_DEFAULT_OPERATIONS		1000000
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary with the keys operations, mismatches and cases. Cases
+	is an array of dictionaries with the keys name, ms, allocationsPerMillion,
+	chunksPerMillion and gcsPerMillion. Results are also written to the log
+	under script.vector.benchmark. Returns nil if operations is zero or a case
+	fails to compile or run.
+
+	Entity must be a JavaScript Entity (or an object of a subclass) whose
+	position and getPosition() are used by the position cases. Global is the
+	scope the cases are compiled in.
+	
+	Must be called on the main thread in a request on context. In the game,
+	the caller is responsible for pausing the script time limiter.
+*/
+NSDictionary *OOJSVectorRunBenchmark(JSContext *context, JSObject *global, jsval entity, NSUInteger operations);
+
+#endif
@@ -0,0 +1,240 @@
+/*
+
+OOJSVectorBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOJSVectorBenchmark.h"
+#import "OOJSVector.h"
+#import "OOJSQuaternion.h"
+#import "OOProfilingStopwatch.h"
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogVectorBenchmark			= @"script.vector.benchmark";
+static NSString * const kOOLogVectorBenchmarkMismatch	= @"script.vector.benchmark.mismatch";
+
+
+/*	Each case is the body of a function with the arguments n (the number of
+	operations) and entity (an Entity), returning a number which depends
+	on every result so that the paired cases can be checked against each
+	other.
+*/
+typedef struct
+{
+	const char				*name;
+	const char				*body;
+	int						pairedWith;		// Index of the case that must return the same value, or -1.
+} BenchmarkCase;
+
+
+static const BenchmarkCase kBenchmarkCases[] =
+{
+	{
+		"position",
+		"var p, sum = 0; for (var i = 0; i < n; i++) { p = entity.position; sum += p.x; } return sum;",
+		-1
+	},
+	{
+		"getPosition",
+		"var p = new Vector3D(), sum = 0; for (var i = 0; i < n; i++) { entity.getPosition(p); sum += p.x; } return sum;",
+		0
+	},
+	{
+		"add",
+		"var v = new Vector3D(1, 2, 3), d = new Vector3D(0.5, 0.25, 0.125); for (var i = 0; i < n; i++) { v = v.add(d); } return v.x + v.y + v.z;",
+		-1
+	},
+	{
+		"addInPlace",
+		"var v = new Vector3D(1, 2, 3), d = new Vector3D(0.5, 0.25, 0.125); for (var i = 0; i < n; i++) { v.add(d, v); } return v.x + v.y + v.z;",
+		2
+	},
+	{
+		"rotateX",
+		"var q = new Quaternion(1, 0, 0, 0); for (var i = 0; i < n; i++) { q = q.rotateX(0.001); } return q.w + q.x;",
+		-1
+	},
+	{
+		"rotateXInPlace",
+		"var q = new Quaternion(1, 0, 0, 0); for (var i = 0; i < n; i++) { q.rotateX(0.001, q); } return q.w + q.x;",
+		4
+	},
+	{
+		"dot",
+		"var a = new Vector3D(1, 2, 3), b = new Vector3D(4, 5, 6), sum = 0; for (var i = 0; i < n; i++) { sum += a.dot(b); } return sum;",
+		-1
+	},
+	{
+		"components",
+		"var a = new Vector3D(1, 2, 3), sum = 0; for (var i = 0; i < n; i++) { sum += a.x + a.y + a.z; } return sum;",
+		-1
+	}
+};
+
+enum
+{
+	kBenchmarkCaseCount = sizeof kBenchmarkCases / sizeof *kBenchmarkCases
+};
+
+
+typedef struct
+{
+	double					seconds;
+	NSUInteger				allocations;
+	NSUInteger				chunks;
+	uint32_t				gcs;
+	jsdouble				value;
+} CaseResult;
+
+
+static BOOL RunCase(JSContext *context, JSObject *global, const BenchmarkCase *benchCase, NSUInteger operations, jsval entity, CaseResult *outResult);
+static OOJSPrivatePoolStatistics CombinedPoolStatistics(void);
+
+
+NSDictionary *OOJSVectorRunBenchmark(JSContext *context, JSObject *global, jsval entity, NSUInteger operations)
+{
+	CaseResult				results[kBenchmarkCaseCount];
+	NSUInteger				i, mismatches = 0;
+	BOOL					OK = YES;
+	
+	NSCParameterAssert(context != NULL && JS_IsInRequest(context) && global != NULL);
+	
+	if (operations == 0)  return nil;
+	if (operations > UINT32_MAX)  operations = UINT32_MAX;
+	
+	for (i = 0; i < kBenchmarkCaseCount && OK; i++)
+	{
+		OK = RunCase(context, global, &kBenchmarkCases[i], operations, entity, &results[i]);
+	}
+	
+	if (!OK)  return nil;
+	
+	double scale = 1e6 / operations;
+	NSMutableArray *cases = [NSMutableArray arrayWithCapacity:kBenchmarkCaseCount];
+	NSMutableString *report = [NSMutableString stringWithFormat:@"JavaScript vector benchmark, %lu operations per case; counts per million operations:", (unsigned long)operations];
+	
+	for (i = 0; i < kBenchmarkCaseCount; i++)
+	{
+		const BenchmarkCase *benchCase = &kBenchmarkCases[i];
+		const CaseResult *result = &results[i];
+		NSString *name = [NSString stringWithUTF8String:benchCase->name];
+		
+		[report appendFormat:@"\n  %-16s %9.2f ms %10.0f allocations %8.1f chunks %6.1f GCs",
+		 benchCase->name, result->seconds * 1000.0, result->allocations * scale, result->chunks * scale, result->gcs * scale];
+		
+		if (benchCase->pairedWith >= 0 && result->value != results[benchCase->pairedWith].value)
+		{
+			OOLogERR(kOOLogVectorBenchmarkMismatch, @"Case %s returned %g, but %s returned %g.",
+					 benchCase->name, result->value, kBenchmarkCases[benchCase->pairedWith].name, results[benchCase->pairedWith].value);
+			mismatches++;
+		}
+		
+		[cases addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+						  name, @"name",
+						  [NSNumber numberWithDouble:result->seconds * 1000.0], @"ms",
+						  [NSNumber numberWithDouble:result->allocations * scale], @"allocationsPerMillion",
+						  [NSNumber numberWithDouble:result->chunks * scale], @"chunksPerMillion",
+						  [NSNumber numberWithDouble:result->gcs * scale], @"gcsPerMillion",
+						  nil]];
+	}
+	
+	[report appendFormat:@"\n  %lu mismatched results.", (unsigned long)mismatches];
+	OOLog(kOOLogVectorBenchmark, @"%@", report);
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:operations], @"operations",
+			[NSNumber numberWithUnsignedInteger:mismatches], @"mismatches",
+			cases, @"cases",
+			nil];
+}
+
+
+static BOOL RunCase(JSContext *context, JSObject *global, const BenchmarkCase *benchCase, NSUInteger operations, jsval entity, CaseResult *outResult)
+{
+	static const char		*argNames[] = { "n", "entity" };
+	JSFunction				*function = NULL;
+	JSObject				*functionObj = NULL;
+	JSRuntime				*runtime = JS_GetRuntime(context);
+	jsval					argv[2];
+	jsval					rval = JSVAL_VOID;
+	BOOL					OK;
+	
+	function = JS_CompileFunction(context, global, benchCase->name, 2, argNames, benchCase->body, strlen(benchCase->body), "OOJSVectorBenchmark", 1);
+	if (function == NULL)
+	{
+		JS_ReportPendingException(context);
+		OOLogERR(kOOLogVectorBenchmark, @"Could not compile benchmark case %s.", benchCase->name);
+		return NO;
+	}
+	
+	// Keep the function alive across the collection below.
+	functionObj = JS_GetFunctionObject(function);
+	JS_AddNamedObjectRoot(context, &functionObj, "vector benchmark function");
+	
+	JS_NewNumberValue(context, operations, &argv[0]);
+	argv[1] = entity;
+	
+	JS_GC(context);
+	OOJSPrivatePoolStatistics poolStart = CombinedPoolStatistics();
+	uint32_t gcStart = JS_GetGCParameter(runtime, JSGC_NUMBER);
+	OOHighResTimeValue start = OOGetHighResTime();
+	
+	OK = JS_CallFunction(context, global, function, 2, argv, &rval);
+	
+	OOHighResTimeValue end = OOGetHighResTime();
+	uint32_t gcEnd = JS_GetGCParameter(runtime, JSGC_NUMBER);
+	OOJSPrivatePoolStatistics poolEnd = CombinedPoolStatistics();
+	
+	outResult->seconds = OOHighResTimeDeltaInSeconds(start, end);
+	outResult->allocations = poolEnd.allocations - poolStart.allocations;
+	outResult->chunks = poolEnd.chunks - poolStart.chunks;
+	outResult->gcs = gcEnd - gcStart;
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	
+	if (OK)  OK = JS_ValueToNumber(context, rval, &outResult->value);
+	
+	JS_RemoveObjectRoot(context, &functionObj);
+	
+	if (!OK)
+	{
+		JS_ReportPendingException(context);
+		OOLogERR(kOOLogVectorBenchmark, @"Benchmark case %s failed.", benchCase->name);
+	}
+	
+	return OK;
+}
+
+
+static OOJSPrivatePoolStatistics CombinedPoolStatistics(void)
+{
+	OOJSPrivatePoolStatistics vectorStats = JSVectorGetPoolStatistics();
+	OOJSPrivatePoolStatistics quaternionStats = JSQuaternionGetPoolStatistics();
+	
+	vectorStats.allocations += quaternionStats.allocations;
+	vectorStats.chunks += quaternionStats.chunks;
+	vectorStats.live += quaternionStats.live;
+	return vectorStats;
+}
+
+#endif
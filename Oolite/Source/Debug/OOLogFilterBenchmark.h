@@ -0,0 +1,70 @@
+/*
+
+OOLogFilterBenchmark.h
+
+Measures what a log call costs when its message class is filtered out, as
+most are, with several threads logging at once.
+
+Each worker thread asks an OoliteLogOutputHandler whether to show messages
+the given number of times, calling it the way
+OOLogWillDisplayMessagesInClass() does and cycling through a set of message
+classes which are turned off (under logging.benchmark.filtered). For
+comparison, the same threads then look the classes up the way
+OoliteLogOutputHandler used to, in a dictionary guarded by a single NSLock. Each comparison is run with one
+thread and with the requested number, so that contention shows up as the
+difference between the two.
+
+While the lock-free workers run, the calling thread changes the setting of
+an unrelated class a few times, so that readers also see new settings
+snapshots being published under them. Both ways of looking up the classes
+must agree on how many calls would have been shown, or a mismatch is
+logged.
+
+The handler is a private one made for the run, so the game's log settings
+are left alone, and the settings snapshots the run publishes are freed
+when it finishes.
+
+Only available in debug builds. Can be run from the debug console with
+console.runLogFilterBenchmark([threadCount [, calls]]).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define LOG_FILTER_BENCHMARK_DEFAULT_CALLS		1000000
+#define LOG_FILTER_BENCHMARK_MAX_THREADS		64
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary with the keys threads, calls (per thread),
+	reconfigurations, mismatches and cases. Cases is an array of dictionaries
+	with the keys name, threads, ms and nsPerCall, where nsPerCall is the
+	elapsed time divided by the total number of calls on all threads.
+	Results are also written to the log under logging.benchmark. A
+	threadCount of zero means one per CPU. Returns nil if calls is zero or
+	the worker threads can't be set up.
+*/
+NSDictionary *OOLogFilterRunBenchmark(NSUInteger threadCount, NSUInteger calls);
+
+#endif
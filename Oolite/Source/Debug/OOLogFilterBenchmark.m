@@ -0,0 +1,343 @@
+/*
+
+OOLogFilterBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOLogFilterBenchmark.h"
+#import "OoliteLogOutputHandler.h"
+#import "OOProfilingStopwatch.h"
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogLogFilterBenchmark			= @"logging.benchmark";
+static NSString * const kOOLogLogFilterBenchmarkMismatch	= @"logging.benchmark.mismatch";
+
+static NSString * const kFilteredClass						= @"logging.benchmark.filtered";
+static NSString * const kToggledClass						= @"logging.benchmark.toggled";
+
+
+// Message classes the workers cycle through; all inherit from kFilteredClass.
+static NSString * const kBenchmarkClasses[] =
+{
+	@"logging.benchmark.filtered.a",
+	@"logging.benchmark.filtered.b",
+	@"logging.benchmark.filtered.c",
+	@"logging.benchmark.filtered.d",
+	@"logging.benchmark.filtered.a.detail",
+	@"logging.benchmark.filtered.b.detail",
+	@"logging.benchmark.filtered.c.detail",
+	@"logging.benchmark.filtered.d.detail"
+};
+
+enum
+{
+	kBenchmarkClassCount		= sizeof kBenchmarkClasses / sizeof *kBenchmarkClasses,
+	kReconfigurationsPerRun		= 8
+};
+
+// Stand-ins for the old cache dictionary's values.
+static NSString * const kShownToken = @"on";
+static NSString * const kHiddenToken = @"off";
+
+
+enum
+{
+	kConditionWaiting,
+	kConditionGo
+};
+
+
+// Called the way OOLogWillDisplayMessagesInClass() calls the installed handler.
+typedef BOOL (*ShouldShowMessageInClassIMP)(id self, SEL _cmd, NSString *messageClass);
+
+
+@interface OOLogFilterBenchmarkRun: NSObject
+{
+@private
+	NSUInteger				_threadCount;
+	NSUInteger				_calls;
+	OoliteLogOutputHandler	*_handler;
+	ShouldShowMessageInClassIMP _shouldShowMessageInClass;
+	NSDictionary			*_referenceSettings;	// nil to use _handler.
+	NSLock					*_referenceLock;
+	
+	NSConditionLock			*_startLock;
+	NSConditionLock			*_doneLock;			// Condition is the number of workers still running.
+	NSUInteger				_shown;
+	NSUInteger				_reconfigurations;
+}
+
+- (id) initWithThreadCount:(NSUInteger)threadCount calls:(NSUInteger)calls handler:(OoliteLogOutputHandler *)handler referenceSettings:(NSDictionary *)referenceSettings;
+
+// Returns elapsed time in seconds.
+- (double) run;
+
+- (NSUInteger) shownCount;
+- (NSUInteger) reconfigurationCount;
+
+@end
+
+
+typedef struct
+{
+	const char				*name;
+	NSUInteger				threads;
+	double					seconds;
+	NSUInteger				shown;
+} CaseResult;
+
+
+static BOOL RunCase(const char *name, NSUInteger threadCount, NSUInteger calls, OoliteLogOutputHandler *handler, NSDictionary *referenceSettings, CaseResult *outResult, NSUInteger *ioReconfigurations);
+
+
+NSDictionary *OOLogFilterRunBenchmark(NSUInteger threadCount, NSUInteger calls)
+{
+	CaseResult				results[4];
+	NSUInteger				i, caseCount = 0, reconfigurations = 0, mismatches = 0;
+	BOOL					OK = YES;
+	
+	if (calls == 0)  return nil;
+	if (threadCount == 0)  threadCount = OOCPUCount();
+	threadCount = MIN(threadCount, (NSUInteger)LOG_FILTER_BENCHMARK_MAX_THREADS);
+	
+	/*	A private handler, so that the game's log settings are left alone and
+		the snapshots published by the run are freed with it.
+	*/
+	NSDictionary *settings = [NSDictionary dictionaryWithObject:[NSNumber numberWithBool:NO] forKey:kFilteredClass];
+	OoliteLogOutputHandler *handler = [[OoliteLogOutputHandler alloc] initWithExplicitSettings:settings];
+	if (handler == nil)  return nil;
+	
+	// The old handler's cache, as it would stand once every class had been seen.
+	NSMutableDictionary *referenceSettings = [NSMutableDictionary dictionaryWithCapacity:kBenchmarkClassCount];
+	for (i = 0; i < kBenchmarkClassCount; i++)
+	{
+		BOOL shown = [handler shouldShowMessageInClass:kBenchmarkClasses[i]];
+		[referenceSettings setObject:shown ? kShownToken : kHiddenToken forKey:kBenchmarkClasses[i]];
+	}
+	
+	OK = RunCase("lockFree", 1, calls, handler, nil, &results[caseCount++], &reconfigurations) &&
+		 RunCase("locked", 1, calls, handler, referenceSettings, &results[caseCount++], &reconfigurations);
+	if (OK && threadCount > 1)
+	{
+		OK = RunCase("lockFree", threadCount, calls, handler, nil, &results[caseCount++], &reconfigurations) &&
+			 RunCase("locked", threadCount, calls, handler, referenceSettings, &results[caseCount++], &reconfigurations);
+	}
+	
+	// Every worker has finished with it.
+	[handler release];
+	
+	if (!OK)  return nil;
+	
+	NSMutableArray *cases = [NSMutableArray arrayWithCapacity:caseCount];
+	NSMutableString *report = [NSMutableString stringWithFormat:@"Log filter benchmark, %lu filtered-out calls per thread; %lu reconfigurations during lock-free runs:", (unsigned long)calls, (unsigned long)reconfigurations];
+	
+	for (i = 0; i < caseCount; i++)
+	{
+		const CaseResult *result = &results[i];
+		double nsPerCall = result->seconds * 1e9 / (result->threads * calls);
+		
+		[report appendFormat:@"\n  %-10s %3lu thread%s %9.2f ms %8.2f ns per call",
+		 result->name, (unsigned long)result->threads, (result->threads == 1) ? " " : "s", result->seconds * 1000.0, nsPerCall];
+		
+		// Cases come in lock-free/locked pairs with the same thread count.
+		if ((i & 1) != 0 && result->shown != results[i - 1].shown)
+		{
+			OOLogERR(kOOLogLogFilterBenchmarkMismatch, @"With %lu threads, %lu calls would have been shown with the lock-free filter, but %lu with the locked one.",
+					 (unsigned long)result->threads, (unsigned long)results[i - 1].shown, (unsigned long)result->shown);
+			mismatches++;
+		}
+		
+		[cases addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+						  [NSString stringWithUTF8String:result->name], @"name",
+						  [NSNumber numberWithUnsignedInteger:result->threads], @"threads",
+						  [NSNumber numberWithDouble:result->seconds * 1000.0], @"ms",
+						  [NSNumber numberWithDouble:nsPerCall], @"nsPerCall",
+						  nil]];
+	}
+	
+	[report appendFormat:@"\n  %lu mismatched results.", (unsigned long)mismatches];
+	OOLog(kOOLogLogFilterBenchmark, @"%@", report);
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:threadCount], @"threads",
+			[NSNumber numberWithUnsignedInteger:calls], @"calls",
+			[NSNumber numberWithUnsignedInteger:reconfigurations], @"reconfigurations",
+			[NSNumber numberWithUnsignedInteger:mismatches], @"mismatches",
+			cases, @"cases",
+			nil];
+}
+
+
+static BOOL RunCase(const char *name, NSUInteger threadCount, NSUInteger calls, OoliteLogOutputHandler *handler, NSDictionary *referenceSettings, CaseResult *outResult, NSUInteger *ioReconfigurations)
+{
+	OOLogFilterBenchmarkRun *run = [[OOLogFilterBenchmarkRun alloc] initWithThreadCount:threadCount calls:calls handler:handler referenceSettings:referenceSettings];
+	if (run == nil)
+	{
+		OOLogERR(kOOLogLogFilterBenchmark, @"Could not set up benchmark case %s.", name);
+		return NO;
+	}
+	
+	outResult->name = name;
+	outResult->threads = threadCount;
+	outResult->seconds = [run run];
+	outResult->shown = [run shownCount];
+	*ioReconfigurations += [run reconfigurationCount];
+	
+	[run release];
+	return YES;
+}
+
+
+@interface OOLogFilterBenchmarkRun (Private)
+
+- (void) worker:(id)unused;
+
+@end
+
+
+@implementation OOLogFilterBenchmarkRun
+
+- (id) initWithThreadCount:(NSUInteger)threadCount calls:(NSUInteger)calls handler:(OoliteLogOutputHandler *)handler referenceSettings:(NSDictionary *)referenceSettings
+{
+	if ((self = [super init]))
+	{
+		_threadCount = threadCount;
+		_calls = calls;
+		_handler = [handler retain];
+		_shouldShowMessageInClass = (ShouldShowMessageInClassIMP)[handler methodForSelector:@selector(shouldShowMessageInClass:)];
+		_referenceSettings = [referenceSettings copy];
+		_referenceLock = [[NSLock alloc] init];
+		_startLock = [[NSConditionLock alloc] initWithCondition:kConditionWaiting];
+		_doneLock = [[NSConditionLock alloc] initWithCondition:threadCount];
+		
+		if (_shouldShowMessageInClass == NULL || _referenceLock == nil || _startLock == nil || _doneLock == nil)
+		{
+			[self release];
+			return nil;
+		}
+	}
+	
+	return self;
+}
+
+
+- (void) dealloc
+{
+	DESTROY(_handler);
+	DESTROY(_referenceSettings);
+	DESTROY(_referenceLock);
+	DESTROY(_startLock);
+	DESTROY(_doneLock);
+	
+	[super dealloc];
+}
+
+
+- (double) run
+{
+	NSUInteger				i;
+	
+	for (i = 0; i < _threadCount; i++)
+	{
+		[NSThread detachNewThreadSelector:@selector(worker:) toTarget:self withObject:nil];
+	}
+	
+	// Release the workers together, so thread startup isn't timed.
+	OOHighResTimeValue start = OOGetHighResTime();
+	[_startLock lock];
+	[_startLock unlockWithCondition:kConditionGo];
+	
+	if (_referenceSettings == nil)
+	{
+		for (i = 0; i < kReconfigurationsPerRun && [_doneLock condition] != 0; i++)
+		{
+			[_handler setShouldShowMessage:(i & 1) != 0 inClass:kToggledClass];
+			_reconfigurations++;
+			[NSThread sleepForTimeInterval:0.001];
+		}
+	}
+	
+	[_doneLock lockWhenCondition:0];
+	OOHighResTimeValue end = OOGetHighResTime();
+	[_doneLock unlock];
+	
+	double seconds = OOHighResTimeDeltaInSeconds(start, end);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	
+	return seconds;
+}
+
+
+- (NSUInteger) shownCount
+{
+	return _shown;
+}
+
+
+- (NSUInteger) reconfigurationCount
+{
+	return _reconfigurations;
+}
+
+
+- (void) worker:(id)unused
+{
+	NSAutoreleasePool		*pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger				i, classIndex = 0, shown = 0;
+	
+	[_startLock lockWhenCondition:kConditionGo];
+	[_startLock unlockWithCondition:kConditionGo];
+	
+	if (_referenceSettings == nil)
+	{
+		SEL selector = @selector(shouldShowMessageInClass:);
+		for (i = 0; i < _calls; i++)
+		{
+			if (_shouldShowMessageInClass(_handler, selector, kBenchmarkClasses[classIndex]))  shown++;
+			if (++classIndex == kBenchmarkClassCount)  classIndex = 0;
+		}
+	}
+	else
+	{
+		for (i = 0; i < _calls; i++)
+		{
+			[_referenceLock lock];
+			id value = [_referenceSettings objectForKey:kBenchmarkClasses[classIndex]];
+			[_referenceLock unlock];
+			
+			if (value == kShownToken)  shown++;
+			if (++classIndex == kBenchmarkClassCount)  classIndex = 0;
+		}
+	}
+	
+	[_doneLock lock];
+	_shown += shown;
+	[_doneLock unlockWithCondition:[_doneLock condition] - 1];
+	
+	[pool release];
+}
+
+@end
+
+#endif
@@ -0,0 +1,74 @@
+/*
+
+OOOctreeBenchmark.h
+
+Timing of octree hit tests, comparing the flat iterative traversal with the
+original recursive one.
+
+While tracing is turned on, every line and octree-octree query made through
+Octree's public hit test methods is recorded in a ring buffer holding the
+most recent OCTREE_BENCHMARK_TRACE_SIZE of each kind. The benchmark replays the trace
+through both traversals, checks that they give exactly the same results,
+and times each. Results include the collision marks left on the octrees'
+nodes (as drawn by -drawOctreeCollisions), not just hit or miss. If nothing
+has been recorded yet, a synthetic trace is generated from the octrees of
+the ships currently in the universe.
+
+The trace retains the octrees it refers to, so tracing is off by default,
+and the trace is cleared both when tracing is turned off and at the end of
+each run; the next run uses queries recorded since.
+
+Only available in debug builds. Can be run from the debug console with
+console.setOctreeBenchmarkTracing(flag) and
+console.runOctreeBenchmark([iterations]).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+#import "OOTriangle.h"
+
+@class Octree;
+
+
+#define OCTREE_BENCHMARK_TRACE_SIZE				4096
+#define OCTREE_BENCHMARK_DEFAULT_ITERATIONS		20
+
+
+#ifndef NDEBUG
+
+// Called by Octree; ignored unless tracing, or while the benchmark is replaying.
+void OOOctreeBenchmarkRecordLineQuery(Octree *octree, Vector v0, Vector v1);
+void OOOctreeBenchmarkRecordPairQuery(Octree *octree, Octree *other, Vector origin, Triangle ijk, GLfloat s1, GLfloat s2);
+
+/*	Returns a dictionary with the keys lineQueries, lineHits, pairQueries,
+	pairHits, mismatches, legacyLineNsPerQuery, flatLineNsPerQuery,
+	legacyPairNsPerQuery and flatPairNsPerQuery. Results are also written to
+	the log under octree.benchmark. Returns nil if iterations is zero or there
+	is nothing to test.
+*/
+NSDictionary *OOOctreeRunBenchmark(NSUInteger iterations);
+
+//	Turning tracing off discards any recorded queries.
+void OOOctreeBenchmarkSetTracing(BOOL flag);
+BOOL OOOctreeBenchmarkIsTracing(void);
+
+#endif
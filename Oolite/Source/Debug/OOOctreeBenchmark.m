@@ -0,0 +1,354 @@
+/*
+
+OOOctreeBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOOctreeBenchmark.h"
+#import "Octree.h"
+#import "OOProfilingStopwatch.h"
+#import "OOUniverse.h"
+#import "OOShipEntity.h"
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogOctreeBenchmark			= @"octree.benchmark";
+static NSString * const kOOLogOctreeBenchmarkMismatch	= @"octree.benchmark.mismatch";
+
+enum
+{
+	kSyntheticQueriesPerOctree		= 64
+};
+
+
+typedef struct
+{
+	Octree					*octree;
+	Vector					v0, v1;
+} LineQueryRecord;
+
+
+typedef struct
+{
+	Octree					*octree;
+	Octree					*other;
+	Vector					origin;
+	Triangle				ijk;
+	GLfloat					s1, s2;
+} PairQueryRecord;
+
+
+static LineQueryRecord		sLineTrace[OCTREE_BENCHMARK_TRACE_SIZE];
+static NSUInteger			sLineCount, sNextLine;
+static PairQueryRecord		sPairTrace[OCTREE_BENCHMARK_TRACE_SIZE];
+static NSUInteger			sPairCount, sNextPair;
+static BOOL					sTracing = NO;
+static BOOL					sReplaying = NO;
+
+
+static void RecordLineQuery(Octree *octree, Vector v0, Vector v1);
+static void RecordPairQuery(Octree *octree, Octree *other, Vector origin, Triangle ijk, GLfloat s1, GLfloat s2);
+static void GenerateSyntheticTrace(void);
+static void ClearTrace(void);
+static Vector RandomVectorInCube(RANROTSeed *seed, GLfloat radius);
+static void ClearCollisionMarks(Octree *octree);
+static NSData *CollisionMarks(Octree *octree);
+
+
+OOINLINE void SetRecordedOctree(Octree **slot, Octree *octree)
+{
+	if (*slot != octree)
+	{
+		[*slot release];
+		*slot = [octree retain];
+	}
+}
+
+
+void OOOctreeBenchmarkRecordLineQuery(Octree *octree, Vector v0, Vector v1)
+{
+	if (EXPECT(!sTracing) || sReplaying || octree == nil)  return;
+	
+	RecordLineQuery(octree, v0, v1);
+}
+
+
+void OOOctreeBenchmarkRecordPairQuery(Octree *octree, Octree *other, Vector origin, Triangle ijk, GLfloat s1, GLfloat s2)
+{
+	if (EXPECT(!sTracing) || sReplaying || octree == nil || other == nil)  return;
+	
+	RecordPairQuery(octree, other, origin, ijk, s1, s2);
+}
+
+
+void OOOctreeBenchmarkSetTracing(BOOL flag)
+{
+	flag = !!flag;
+	if (flag == sTracing)  return;
+	
+	sTracing = flag;
+	if (!sTracing)  ClearTrace();
+}
+
+
+BOOL OOOctreeBenchmarkIsTracing(void)
+{
+	return sTracing;
+}
+
+
+static void RecordLineQuery(Octree *octree, Vector v0, Vector v1)
+{
+	LineQueryRecord *record = &sLineTrace[sNextLine];
+	SetRecordedOctree(&record->octree, octree);
+	record->v0 = v0;
+	record->v1 = v1;
+	
+	sNextLine = (sNextLine + 1) % OCTREE_BENCHMARK_TRACE_SIZE;
+	if (sLineCount < OCTREE_BENCHMARK_TRACE_SIZE)  sLineCount++;
+}
+
+
+static void RecordPairQuery(Octree *octree, Octree *other, Vector origin, Triangle ijk, GLfloat s1, GLfloat s2)
+{
+	PairQueryRecord *record = &sPairTrace[sNextPair];
+	SetRecordedOctree(&record->octree, octree);
+	SetRecordedOctree(&record->other, other);
+	record->origin = origin;
+	record->ijk = ijk;
+	record->s1 = s1;
+	record->s2 = s2;
+	
+	sNextPair = (sNextPair + 1) % OCTREE_BENCHMARK_TRACE_SIZE;
+	if (sPairCount < OCTREE_BENCHMARK_TRACE_SIZE)  sPairCount++;
+}
+
+
+NSDictionary *OOOctreeRunBenchmark(NSUInteger iterations)
+{
+	NSUInteger				i, iteration, lineHits = 0, pairHits = 0, mismatches = 0;
+	
+	if (iterations == 0)  return nil;
+	
+	if (sLineCount == 0 && sPairCount == 0)  GenerateSyntheticTrace();
+	if (sLineCount == 0 && sPairCount == 0)
+	{
+		OOLog(kOOLogOctreeBenchmark, @"No octree queries have been recorded, and there are no ships to generate them from.");
+		return nil;
+	}
+	
+	sReplaying = YES;
+	
+	/*	Warm up, and check both traversals agree exactly, including hit
+		distances and the nodes they mark. Marks are cleared before each
+		query, since pair queries add to whatever is already there.
+	*/
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	for (i = 0; i < sLineCount; i++)
+	{
+		LineQueryRecord *record = &sLineTrace[i];
+		
+		ClearCollisionMarks(record->octree);
+		GLfloat legacy = [record->octree legacyIsHitByLine:record->v0 :record->v1];
+		NSData *legacyMarks = CollisionMarks(record->octree);
+		
+		ClearCollisionMarks(record->octree);
+		GLfloat flat = [record->octree isHitByLine:record->v0 :record->v1];
+		NSData *flatMarks = CollisionMarks(record->octree);
+		
+		if (legacy != 0.0f)  lineHits++;
+		if (memcmp(&legacy, &flat, sizeof legacy) != 0 || ![legacyMarks isEqualToData:flatMarks])
+		{
+			if (mismatches++ == 0)
+			{
+				OOLogERR(kOOLogOctreeBenchmarkMismatch, @"Line query %lu: legacy hit distance %g, flat hit distance %g, collision marks %@.", (unsigned long)i, legacy, flat, [legacyMarks isEqualToData:flatMarks] ? @"match" : @"differ");
+			}
+		}
+	}
+	for (i = 0; i < sPairCount; i++)
+	{
+		PairQueryRecord *record = &sPairTrace[i];
+		
+		ClearCollisionMarks(record->octree);
+		ClearCollisionMarks(record->other);
+		BOOL legacy = [record->octree legacyIsHitByOctree:record->other withOrigin:record->origin andIJK:record->ijk andScales:record->s1 :record->s2];
+		NSData *legacyMarks = CollisionMarks(record->octree);
+		NSData *legacyOtherMarks = CollisionMarks(record->other);
+		
+		ClearCollisionMarks(record->octree);
+		ClearCollisionMarks(record->other);
+		BOOL flat = [record->octree isHitByOctree:record->other withOrigin:record->origin andIJK:record->ijk andScales:record->s1 :record->s2];
+		BOOL marksMatch = [legacyMarks isEqualToData:CollisionMarks(record->octree)] && [legacyOtherMarks isEqualToData:CollisionMarks(record->other)];
+		
+		if (legacy)  pairHits++;
+		if (legacy != flat || !marksMatch)
+		{
+			if (mismatches++ == 0)
+			{
+				OOLogERR(kOOLogOctreeBenchmarkMismatch, @"Pair query %lu: legacy %@, flat %@, collision marks %@.", (unsigned long)i, legacy ? @"hit" : @"miss", flat ? @"hit" : @"miss", marksMatch ? @"match" : @"differ");
+			}
+		}
+	}
+	[pool release];
+	
+	OOHighResTimeValue lineStart = OOGetHighResTime();
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		for (i = 0; i < sLineCount; i++)  [sLineTrace[i].octree legacyIsHitByLine:sLineTrace[i].v0 :sLineTrace[i].v1];
+	}
+	OOHighResTimeValue lineMiddle = OOGetHighResTime();
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		for (i = 0; i < sLineCount; i++)  [sLineTrace[i].octree isHitByLine:sLineTrace[i].v0 :sLineTrace[i].v1];
+	}
+	OOHighResTimeValue lineEnd = OOGetHighResTime();
+	
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		for (i = 0; i < sPairCount; i++)
+		{
+			PairQueryRecord *record = &sPairTrace[i];
+			[record->octree legacyIsHitByOctree:record->other withOrigin:record->origin andIJK:record->ijk andScales:record->s1 :record->s2];
+		}
+	}
+	OOHighResTimeValue pairMiddle = OOGetHighResTime();
+	for (iteration = 0; iteration < iterations; iteration++)
+	{
+		for (i = 0; i < sPairCount; i++)
+		{
+			PairQueryRecord *record = &sPairTrace[i];
+			[record->octree isHitByOctree:record->other withOrigin:record->origin andIJK:record->ijk andScales:record->s1 :record->s2];
+		}
+	}
+	OOHighResTimeValue pairEnd = OOGetHighResTime();
+	
+	sReplaying = NO;
+	
+	NSUInteger lineCount = sLineCount, pairCount = sPairCount;
+	ClearTrace();
+	
+	double lineQueries = (double)iterations * lineCount, pairQueries = (double)iterations * pairCount;
+	double legacyLineNs = (lineCount != 0) ? OOHighResTimeDeltaInSeconds(lineStart, lineMiddle) * 1e9 / lineQueries : 0.0;
+	double flatLineNs = (lineCount != 0) ? OOHighResTimeDeltaInSeconds(lineMiddle, lineEnd) * 1e9 / lineQueries : 0.0;
+	double legacyPairNs = (pairCount != 0) ? OOHighResTimeDeltaInSeconds(lineEnd, pairMiddle) * 1e9 / pairQueries : 0.0;
+	double flatPairNs = (pairCount != 0) ? OOHighResTimeDeltaInSeconds(pairMiddle, pairEnd) * 1e9 / pairQueries : 0.0;
+	OODisposeHighResTime(lineStart);
+	OODisposeHighResTime(lineMiddle);
+	OODisposeHighResTime(lineEnd);
+	OODisposeHighResTime(pairMiddle);
+	OODisposeHighResTime(pairEnd);
+	
+	OOLog(kOOLogOctreeBenchmark, @"Octree benchmark, %lu line queries (%lu hits) and %lu pair queries (%lu hits) x %lu iterations, %lu mismatches:\n  line legacy: %10.1f ns/query\n  line flat:   %10.1f ns/query (%.1fx)\n  pair legacy: %10.1f ns/query\n  pair flat:   %10.1f ns/query (%.1fx)",
+		  (unsigned long)lineCount, (unsigned long)lineHits, (unsigned long)pairCount, (unsigned long)pairHits, (unsigned long)iterations, (unsigned long)mismatches,
+		  legacyLineNs, flatLineNs, (flatLineNs > 0.0) ? legacyLineNs / flatLineNs : 0.0,
+		  legacyPairNs, flatPairNs, (flatPairNs > 0.0) ? legacyPairNs / flatPairNs : 0.0);
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:lineCount], @"lineQueries",
+			[NSNumber numberWithUnsignedInteger:lineHits], @"lineHits",
+			[NSNumber numberWithUnsignedInteger:pairCount], @"pairQueries",
+			[NSNumber numberWithUnsignedInteger:pairHits], @"pairHits",
+			[NSNumber numberWithUnsignedInteger:mismatches], @"mismatches",
+			[NSNumber numberWithDouble:legacyLineNs], @"legacyLineNsPerQuery",
+			[NSNumber numberWithDouble:flatLineNs], @"flatLineNsPerQuery",
+			[NSNumber numberWithDouble:legacyPairNs], @"legacyPairNsPerQuery",
+			[NSNumber numberWithDouble:flatPairNs], @"flatPairNsPerQuery",
+			nil];
+}
+
+
+/*	Lines through each ship's octree, and each ship's octree against the
+	others' at random orientations and overlapping positions.
+*/
+static void GenerateSyntheticTrace(void)
+{
+	NSMutableArray			*octrees = [NSMutableArray array];
+	OOEntity				*entity = nil;
+	RANROTSeed				seed = MakeRanrotSeed(8086);
+	NSUInteger				i, j, count;
+	
+	foreach (entity, [UNIVERSE entityList])
+	{
+		if (![entity isShip])  continue;
+		Octree *octree = [(OOShipEntity *)entity octree];
+		if (octree != nil && [octree radius] > 0.0f && ![octrees containsObject:octree])  [octrees addObject:octree];
+	}
+	
+	count = [octrees count];
+	for (i = 0; i < count; i++)
+	{
+		Octree *octree = [octrees objectAtIndex:i];
+		GLfloat radius = [octree radius];
+		
+		for (j = 0; j < kSyntheticQueriesPerOctree; j++)
+		{
+			RecordLineQuery(octree, RandomVectorInCube(&seed, 1.5f * radius), RandomVectorInCube(&seed, 1.5f * radius));
+			
+			Octree *other = [octrees objectAtIndex:RanrotWithSeed(&seed) % count];
+			Quaternion q = make_quaternion(randfWithSeed(&seed) - 0.5f, randfWithSeed(&seed) - 0.5f, randfWithSeed(&seed) - 0.5f, randfWithSeed(&seed) - 0.5f);
+			quaternion_normalize(&q);
+			
+			Triangle ijk;
+			ijk.v[0] = vector_right_from_quaternion(q);
+			ijk.v[1] = vector_up_from_quaternion(q);
+			ijk.v[2] = vector_forward_from_quaternion(q);
+			ijk.v[3] = kZeroVector;
+			
+			RecordPairQuery(octree, other, RandomVectorInCube(&seed, radius + [other radius]), ijk, 1.0f, 1.0f);
+		}
+	}
+}
+
+
+static void ClearTrace(void)
+{
+	NSUInteger				i;
+	
+	for (i = 0; i < sLineCount; i++)  DESTROY(sLineTrace[i].octree);
+	for (i = 0; i < sPairCount; i++)
+	{
+		DESTROY(sPairTrace[i].octree);
+		DESTROY(sPairTrace[i].other);
+	}
+	sLineCount = sNextLine = 0;
+	sPairCount = sNextPair = 0;
+}
+
+
+static Vector RandomVectorInCube(RANROTSeed *seed, GLfloat radius)
+{
+	return make_vector((randfWithSeed(seed) * 2.0f - 1.0f) * radius, (randfWithSeed(seed) * 2.0f - 1.0f) * radius, (randfWithSeed(seed) * 2.0f - 1.0f) * radius);
+}
+
+
+static void ClearCollisionMarks(Octree *octree)
+{
+	memset([octree octree_collision], 0, [octree leafs]);
+}
+
+
+static NSData *CollisionMarks(Octree *octree)
+{
+	return [NSData dataWithBytes:[octree octree_collision] length:[octree leafs]];
+}
+
+#endif
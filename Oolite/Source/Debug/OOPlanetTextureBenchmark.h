@@ -0,0 +1,74 @@
+/*
+
+OOPlanetTextureBenchmark.h
+
+Checks and times procedural planet texture generation (see
+OOPlanetTextureGenerator.m). Planet parameters are set up from the system
+data of the first few systems of the current galaxy, including any
+planetinfo.plist overrides, the same way OOPlanetEntity does (with a fixed
+seed for each system instead of the planet description PRNG). Diffuse,
+normal and atmosphere textures for each planet are generated at each size
+from 256x256 up to the given maximum, three ways:
+  reference: single-threaded, scalar kernels - equivalent to the
+             original generator;
+  vectorized: single-threaded, SIMD kernels;
+  parallel:   row tiles spread over OOAsyncWorkManager, SIMD kernels.
+The vectorized and parallel results are compared byte for byte with the
+reference.
+
+Only available in debug builds with NEW_PLANETS. Can be run from the debug
+console with console.runPlanetTextureBenchmark([entryCount [, maxSize]]).
+
+The texture generator test rig (TEXGEN_TEST_RIG) has no game to run in, so
+it runs the same size sweep with OOPlanetTextureRunBenchmarkWithPlanetInfo(),
+taking system data from the contents of a planetinfo.plist. There, the
+"parallel" case runs on one thread and the SIMD kernels are the ones the
+compiler targets, since the rig has no OOAsyncWorkManager or OOCPUInfo.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define PLANET_TEXTURE_BENCHMARK_DEFAULT_ENTRIES	4
+#define PLANET_TEXTURE_BENCHMARK_DEFAULT_MAX_SIZE	1024
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary with the keys kernels (the name of the SIMD kernel
+	set), entries, mismatches (total differing bytes) and sizes, an array with
+	one dictionary per texture size with the keys size, referenceMs,
+	vectorizedMs and parallelMs. Times are means per planet. Results are also
+	written to the log under planetTex.benchmark. Returns nil if entryCount is
+	zero, maxSize is less than 256, or NEW_PLANETS is off.
+*/
+#ifndef TEXGEN_TEST_RIG
+NSDictionary *OOPlanetTextureRunBenchmark(NSUInteger entryCount, unsigned maxSize);
+#else
+/*	As above, for systems 0 to entryCount - 1 of galaxy 0, with system data
+	taken from the "universal" and "0 n" entries of planetInfo.
+*/
+NSDictionary *OOPlanetTextureRunBenchmarkWithPlanetInfo(NSDictionary *planetInfo, NSUInteger entryCount, unsigned maxSize);
+#endif
+
+#endif
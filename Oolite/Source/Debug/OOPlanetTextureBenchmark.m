@@ -0,0 +1,350 @@
+/*
+
+OOPlanetTextureBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOPlanetTextureBenchmark.h"
+#import "OOStellarBody.h"
+
+#if NEW_PLANETS
+#import "OOPlanetTextureGenerator.h"
+#import "OOProfilingStopwatch.h"
+
+#ifndef TEXGEN_TEST_RIG
+#import "OOUniverse.h"
+#import "OOColor.h"
+#import "OOStringParsing.h"
+#endif
+#endif
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogPlanetTextureBenchmark			= @"planetTex.benchmark";
+
+
+#if NEW_PLANETS
+
+static NSString * const kOOLogPlanetTextureBenchmarkMismatch	= @"planetTex.benchmark.mismatch";
+
+
+// Textures are size pixels high; with 3D noise, they're twice as wide.
+#define ASPECT_RATIO	(PERLIN_3D ? 2 : 1)
+
+
+enum
+{
+	kModeReference,
+	kModeVectorized,
+	kModeParallel,
+	
+	kModeCount
+};
+
+
+static NSDictionary *RunBenchmark(NSArray *planetInfos, unsigned maxSize);
+static NSDictionary *PlanetInfoForSystem(NSUInteger system, NSDictionary *systemData);
+#ifdef TEXGEN_TEST_RIG
+static BOOL ScanVectorFromString(NSString *xyzString, Vector *outVector);
+#endif
+static BOOL GenerateTextures(NSDictionary *planetInfo, unsigned size, unsigned mode, uint8_t *outBuffers[3], double *ioTime);
+static size_t CountMismatches(uint8_t *result[3], uint8_t *expected[3], size_t size);
+static void FreeBuffers(uint8_t *buffers[3]);
+
+
+#ifndef TEXGEN_TEST_RIG
+
+NSDictionary *OOPlanetTextureRunBenchmark(NSUInteger entryCount, unsigned maxSize)
+{
+	NSMutableArray			*planetInfos = nil;
+	NSUInteger				i;
+	
+	if (entryCount == 0 || maxSize < 256)  return nil;
+	if (entryCount > 256)  entryCount = 256;
+	
+	planetInfos = [NSMutableArray arrayWithCapacity:entryCount];
+	for (i = 0; i < entryCount; i++)
+	{
+		NSDictionary *systemData = [UNIVERSE generateSystemData:[UNIVERSE systemSeedForSystemNumber:i]];
+		[planetInfos addObject:PlanetInfoForSystem(i, systemData)];
+	}
+	
+	return RunBenchmark(planetInfos, maxSize);
+}
+
+#else
+
+NSDictionary *OOPlanetTextureRunBenchmarkWithPlanetInfo(NSDictionary *planetInfo, NSUInteger entryCount, unsigned maxSize)
+{
+	NSMutableArray			*planetInfos = nil;
+	NSDictionary			*universal = nil;
+	NSMutableDictionary		*systemData = nil;
+	NSUInteger				i;
+	
+	if (entryCount == 0 || maxSize < 256)  return nil;
+	if (entryCount > 256)  entryCount = 256;
+	
+	// Overrides are applied in the same order as -[Universe generateSystemData:].
+	universal = [planetInfo oo_dictionaryForKey:@"universal"];
+	planetInfos = [NSMutableArray arrayWithCapacity:entryCount];
+	for (i = 0; i < entryCount; i++)
+	{
+		systemData = [NSMutableDictionary dictionary];
+		if (universal != nil)  [systemData addEntriesFromDictionary:universal];
+		[systemData addEntriesFromDictionary:[planetInfo oo_dictionaryForKey:[NSString stringWithFormat:@"0 %lu", (unsigned long)i]]];
+		[planetInfos addObject:PlanetInfoForSystem(i, systemData)];
+	}
+	
+	return RunBenchmark(planetInfos, maxSize);
+}
+
+#endif
+
+
+static NSDictionary *RunBenchmark(NSArray *planetInfos, unsigned maxSize)
+{
+	NSMutableArray			*sizeResults = nil;
+	NSMutableString			*report = nil;
+	NSDictionary			*planetInfo = nil;
+	NSAutoreleasePool		*pool = nil;
+	NSUInteger				entryCount = [planetInfos count];
+	unsigned				size, mode;
+	size_t					bufferSize, mismatches, totalMismatches = 0;
+	uint8_t					*reference[3], *result[3];
+	double					times[kModeCount];
+	
+	sizeResults = [NSMutableArray array];
+	report = [NSMutableString stringWithFormat:@"Planet texture benchmark, %lu planets, %@ kernels:", (unsigned long)entryCount, [OOPlanetTextureGenerator benchmarkKernelName]];
+	
+	for (size = 256; size <= maxSize; size *= 2)
+	{
+		bufferSize = 4 * size * size * ASPECT_RATIO;
+		for (mode = 0; mode < kModeCount; mode++)  times[mode] = 0.0;
+		
+		foreach (planetInfo, planetInfos)
+		{
+			pool = [[NSAutoreleasePool alloc] init];
+			
+			if (!GenerateTextures(planetInfo, size, kModeReference, reference, &times[kModeReference]))
+			{
+				OOLogERR(kOOLogPlanetTextureBenchmark, @"Could not generate %ux%u planet textures.", size, size);
+				[pool release];
+				return nil;
+			}
+			
+			for (mode = kModeReference + 1; mode < kModeCount; mode++)
+			{
+				if (!GenerateTextures(planetInfo, size, mode, result, &times[mode]))
+				{
+					OOLogERR(kOOLogPlanetTextureBenchmark, @"Could not generate %ux%u planet textures.", size, size);
+					FreeBuffers(reference);
+					[pool release];
+					return nil;
+				}
+				
+				mismatches = CountMismatches(result, reference, bufferSize);
+				if (mismatches != 0)
+				{
+					OOLog(kOOLogPlanetTextureBenchmarkMismatch, @"%ux%u %@ textures differ from reference in %lu bytes.", size, size, (mode == kModeParallel) ? @"parallel" : @"vectorized", (unsigned long)mismatches);
+					totalMismatches += mismatches;
+				}
+				FreeBuffers(result);
+			}
+			
+			FreeBuffers(reference);
+			[pool release];
+		}
+		
+		for (mode = 0; mode < kModeCount; mode++)  times[mode] *= 1000.0 / entryCount;
+		
+		[report appendFormat:@"\n  %4ux%-4u reference %9.2f ms, vectorized %9.2f ms (%.2fx), parallel %9.2f ms (%.2fx)",
+			size, size, times[kModeReference],
+			times[kModeVectorized], (times[kModeVectorized] > 0.0) ? times[kModeReference] / times[kModeVectorized] : 0.0,
+			times[kModeParallel], (times[kModeParallel] > 0.0) ? times[kModeReference] / times[kModeParallel] : 0.0];
+		
+		[sizeResults addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+								[NSNumber numberWithUnsignedInt:size], @"size",
+								[NSNumber numberWithDouble:times[kModeReference]], @"referenceMs",
+								[NSNumber numberWithDouble:times[kModeVectorized]], @"vectorizedMs",
+								[NSNumber numberWithDouble:times[kModeParallel]], @"parallelMs",
+								nil]];
+	}
+	
+	[report appendFormat:@"\n  %lu mismatched bytes.", (unsigned long)totalMismatches];
+	OOLog(kOOLogPlanetTextureBenchmark, @"%@", report);
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[OOPlanetTextureGenerator benchmarkKernelName], @"kernels",
+			[NSNumber numberWithUnsignedInteger:entryCount], @"entries",
+			[NSNumber numberWithUnsignedLongLong:totalMismatches], @"mismatches",
+			sizeResults, @"sizes",
+			nil];
+}
+
+
+static OOColor *ColorWithHSBColor(Vector c)
+{
+	return [OOColor colorWithCalibratedHue:c.x saturation:c.y brightness:c.z alpha:1.0];
+}
+
+
+static Vector LighterHSBColor(Vector c)
+{
+	return (Vector){ c.x, c.y * 0.25f, 1.0f - (c.z * 0.1f) };
+}
+
+
+static Vector RandomHSBColor(RANROTSeed *seed)
+{
+	return (Vector){ randfWithSeed(seed), randfWithSeed(seed), 0.5f + 0.5f * randfWithSeed(seed) };
+}
+
+
+/*	Like -[OOPlanetEntity initFromDictionary:withAtmosphere:andSeed:], but
+	with colours and fractions that aren't overridden taken from a RANROT
+	seed based on the system number, so results don't depend on what has
+	been generated before.
+*/
+static NSDictionary *PlanetInfoForSystem(NSUInteger system, NSDictionary *systemData)
+{
+	NSMutableDictionary		*result = [NSMutableDictionary dictionary];
+	RANROTSeed				seed = MakeRanrotSeed(system + 1);
+	RANROTSeed				noiseSeed = MakeRanrotSeed(0x10000 + system);
+	Vector					landHSB, seaHSB, airHSB, cloudHSB;
+	OOColor					*color = nil;
+	
+	[result setObject:[NSNumber numberWithFloat:0.01f * [systemData oo_intForKey:@"percent_land" defaultValue:24 + RanrotWithSeed(&seed) % 48]] forKey:@"land_fraction"];
+	[result setObject:[NSValue valueWithBytes:&noiseSeed objCType:@encode(RANROTSeed)] forKey:@"noise_map_seed"];
+	
+	landHSB = RandomHSBColor(&seed);
+	seaHSB = RandomHSBColor(&seed);
+	ScanVectorFromString([systemData oo_stringForKey:@"land_hsb_color"], &landHSB);
+	ScanVectorFromString([systemData oo_stringForKey:@"sea_hsb_color"], &seaHSB);
+	
+	[result setObject:ColorWithHSBColor(landHSB) forKey:@"land_color"];
+	[result setObject:ColorWithHSBColor(seaHSB) forKey:@"sea_color"];
+	[result setObject:ColorWithHSBColor(LighterHSBColor(landHSB)) forKey:@"polar_land_color"];
+	[result setObject:ColorWithHSBColor(LighterHSBColor(seaHSB)) forKey:@"polar_sea_color"];
+	
+	// Atmosphere.
+	[result setObject:[NSNumber numberWithFloat:OOClamp_0_1_f([systemData oo_floatForKey:@"cloud_alpha" defaultValue:1.0f])] forKey:@"cloud_alpha"];
+	[result setObject:[NSNumber numberWithFloat:0.01f * (100 - [systemData oo_intForKey:@"percent_cloud" defaultValue:100 - (3 + (RanrotWithSeed(&seed) & 31) + (RanrotWithSeed(&seed) & 31))])] forKey:@"cloud_fraction"];
+	
+	airHSB = RandomHSBColor(&seed);
+	cloudHSB = RandomHSBColor(&seed);
+	color = [OOColor colorWithDescription:[systemData objectForKey:@"cloud_color"]];
+	[result setObject:(color != nil) ? color : ColorWithHSBColor(airHSB) forKey:@"air_color"];
+	color = [OOColor colorWithDescription:[systemData objectForKey:@"clear_sky_color"]];
+	[result setObject:(color != nil) ? color : ColorWithHSBColor(cloudHSB) forKey:@"cloud_color"];
+	[result setObject:ColorWithHSBColor(LighterHSBColor(airHSB)) forKey:@"polar_air_color"];
+	[result setObject:ColorWithHSBColor(LighterHSBColor(cloudHSB)) forKey:@"polar_cloud_color"];
+	
+	return result;
+}
+
+
+#ifdef TEXGEN_TEST_RIG
+// The test rig has no OOStringParsing; this is its ScanVectorFromString() without the logging.
+static BOOL ScanVectorFromString(NSString *xyzString, Vector *outVector)
+{
+	float					xyz[] = {0.0f, 0.0f, 0.0f};
+	int						i = 0;
+	NSScanner				*scanner = nil;
+	
+	if (xyzString == nil) return NO;
+	
+	scanner = [NSScanner scannerWithString:xyzString];
+	while (![scanner isAtEnd] && i < 3)
+	{
+		if (![scanner scanFloat:&xyz[i++]])  return NO;
+	}
+	if (i < 3)  return NO;
+	
+	*outVector = make_vector(xyz[0], xyz[1], xyz[2]);
+	return YES;
+}
+#endif
+
+
+static BOOL GenerateTextures(NSDictionary *planetInfo, unsigned size, unsigned mode, uint8_t *outBuffers[3], double *ioTime)
+{
+	OOPlanetTextureGenerator *generator = [[OOPlanetTextureGenerator alloc] initWithPlanetInfo:planetInfo];
+	if (generator == nil)  return NO;
+	
+	outBuffers[0] = outBuffers[1] = outBuffers[2] = NULL;
+	
+	OOHighResTimeValue start = OOGetHighResTime();
+	BOOL OK = [generator generateBenchmarkTexturesWithSize:size
+												  parallel:mode == kModeParallel
+												vectorized:mode != kModeReference
+												   diffuse:&outBuffers[0]
+												   normals:&outBuffers[1]
+												atmosphere:&outBuffers[2]];
+	OOHighResTimeValue end = OOGetHighResTime();
+	
+	*ioTime += OOHighResTimeDeltaInSeconds(start, end);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	[generator release];
+	
+	return OK;
+}
+
+
+static size_t CountMismatches(uint8_t *result[3], uint8_t *expected[3], size_t size)
+{
+	size_t					i, j, count = 0;
+	
+	for (i = 0; i < 3; i++)
+	{
+		for (j = 0; j < size; j++)
+		{
+			if (result[i][j] != expected[i][j])  count++;
+		}
+	}
+	
+	return count;
+}
+
+
+static void FreeBuffers(uint8_t *buffers[3])
+{
+	unsigned				i;
+	
+	for (i = 0; i < 3; i++)
+	{
+		free(buffers[i]);
+		buffers[i] = NULL;
+	}
+}
+
+#elif !defined(TEXGEN_TEST_RIG)
+
+NSDictionary *OOPlanetTextureRunBenchmark(NSUInteger entryCount, unsigned maxSize)
+{
+	OOLog(kOOLogPlanetTextureBenchmark, @"The planet texture benchmark requires NEW_PLANETS.");
+	return nil;
+}
+
+#endif	// NEW_PLANETS
+
+#endif	// NDEBUG
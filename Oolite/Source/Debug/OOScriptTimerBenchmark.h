@@ -0,0 +1,67 @@
+/*
+
+OOScriptTimerBenchmark.h
+
+Times script timer scheduling with the timing wheel used by OOScriptTimer,
+against the priority queue it replaced.
+
+A set of timers, half one-shot and half repeating, is scheduled at time zero
+and then run for the given number of seconds of game time at 60 frames per
+second, the same way +[OOScriptTimer updateTimers] does: due timers fire in
+order, repeating timers are rescheduled, and timers scheduled while firing
+are deferred to the end of the frame. About one fire in 32 unschedules a
+random timer, and another one in 32 schedules a random idle timer as a
+one-shot, as OXPs stopping and starting timers from their callbacks do.
+Some delays and intervals are rounded to quarter seconds so that many
+timers fall due at exactly the same time.
+
+The benchmark timers are lightweight objects with an empty callback, rather
+than OOScriptTimers, so that game time can be simulated and the game's
+timers aren't disturbed. The wheel run uses OOTimingWheelRunDue(), the same
+loop as +[OOScriptTimer updateTimers]. The priority queue run uses the loop
+it replaced. In the priority queue, ties are broken by the order timers
+were scheduled in, so the two runs can be checked against each other fire
+by fire.
+
+Only available in debug builds. Can be run from the debug console with
+console.runScriptTimerBenchmark([timerCount [, seconds]]).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define SCRIPT_TIMER_BENCHMARK_DEFAULT_TIMERS	10000
+#define SCRIPT_TIMER_BENCHMARK_DEFAULT_SECONDS	60
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary with the keys timers, frames, fires, unschedules,
+	queueMs, wheelMs and mismatches (the number of fires that differ between
+	the two runs). Times are totals over the whole run. Results are also
+	written to the log under script.timer.benchmark. Returns nil if
+	timerCount or seconds is zero.
+*/
+NSDictionary *OOScriptTimerRunBenchmark(NSUInteger timerCount, NSUInteger seconds);
+
+#endif
@@ -0,0 +1,439 @@
+/*
+
+OOScriptTimerBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOScriptTimerBenchmark.h"
+#import "OOTimingWheel.h"
+#import "OOProfilingStopwatch.h"
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogScriptTimerBenchmark			= @"script.timer.benchmark";
+static NSString * const kOOLogScriptTimerBenchmarkMismatch	= @"script.timer.benchmark.mismatch";
+
+
+#define FRAMES_PER_SECOND		60
+#define BENCHMARK_SEED			0x7153
+
+
+enum
+{
+	kModeQueue,
+	kModeWheel,
+	
+	kModeCount
+};
+
+
+@interface OOBenchmarkTimer: NSObject
+{
+@public
+	OOTimingWheelEntry		entry;
+	OOTimeAbsolute			nextTime;
+	OOTimeDelta				interval;		// Negative for one-shot timers.
+	uint64_t				sequence;		// Used by the queue only.
+	uint32_t				identifier;
+	BOOL					scheduled;
+}
+
+- (NSComparisonResult) compareByNextFireTime:(OOBenchmarkTimer *)other;
+
+@end
+
+
+typedef struct
+{
+	OOTimeAbsolute			firstTime;
+	OOTimeDelta				interval;
+} TimerParams;
+
+
+typedef struct
+{
+	uint32_t				*identifiers;
+	NSUInteger				count;
+	NSUInteger				capacity;
+} FireLog;
+
+
+typedef struct
+{
+	unsigned				mode;
+	OOBenchmarkTimer		**timers;
+	NSUInteger				timerCount;
+	RANROTSeed				seed;
+	FireLog					log;
+	NSUInteger				unschedules;
+	
+	// kModeQueue.
+	OOPriorityQueue			*queue;
+	NSMutableArray			*deferredTimers;
+	uint64_t				nextSequence;
+	BOOL					updating;
+	
+	// kModeWheel.
+	OOTimingWheelScheduler	scheduler;
+	OOTimeAbsolute			now;			// Game time of the current frame, for FireWheelTimer().
+} Simulation;
+
+
+static TimerParams *GenerateTimerParams(NSUInteger count, NSUInteger seconds);
+static double RunSimulation(Simulation *simulation, const TimerParams *params, NSUInteger frames);
+static void RunQueueFrame(Simulation *simulation, OOTimeAbsolute now);
+static void FireWheelTimer(OOTimingWheelEntry *entry, void *context);
+static void FireTimer(Simulation *simulation, OOBenchmarkTimer *timer, OOTimeAbsolute now);
+static void ScheduleTimer(Simulation *simulation, OOBenchmarkTimer *timer);
+static void UnscheduleTimer(Simulation *simulation, OOBenchmarkTimer *timer);
+static void DestroySimulation(Simulation *simulation);
+static void AppendToFireLog(FireLog *log, uint32_t identifier);
+
+
+NSDictionary *OOScriptTimerRunBenchmark(NSUInteger timerCount, NSUInteger seconds)
+{
+	Simulation				simulations[kModeCount];
+	TimerParams				*params = NULL;
+	NSUInteger				i, frames, mismatches = 0;
+	double					times[kModeCount];
+	unsigned				mode;
+	
+	if (timerCount == 0 || seconds == 0)  return nil;
+	if (timerCount > UINT32_MAX)  timerCount = UINT32_MAX;
+	
+	params = GenerateTimerParams(timerCount, seconds);
+	if (params == NULL)
+	{
+		OOLogERR(kOOLogScriptTimerBenchmark, @"Could not allocate %lu timers.", (unsigned long)timerCount);
+		return nil;
+	}
+	
+	frames = seconds * FRAMES_PER_SECOND;
+	memset(simulations, 0, sizeof simulations);
+	for (mode = 0; mode < kModeCount; mode++)
+	{
+		simulations[mode].mode = mode;
+		simulations[mode].timerCount = timerCount;
+		times[mode] = RunSimulation(&simulations[mode], params, frames);
+	}
+	free(params);
+	
+	// Compare fire by fire.
+	FireLog *queueLog = &simulations[kModeQueue].log, *wheelLog = &simulations[kModeWheel].log;
+	for (i = 0; i < queueLog->count && i < wheelLog->count; i++)
+	{
+		if (queueLog->identifiers[i] != wheelLog->identifiers[i])
+		{
+			if (mismatches++ == 0)
+			{
+				OOLogERR(kOOLogScriptTimerBenchmarkMismatch, @"Fire %lu: queue fired timer %u, wheel fired timer %u.", (unsigned long)i, queueLog->identifiers[i], wheelLog->identifiers[i]);
+			}
+		}
+	}
+	if (queueLog->count != wheelLog->count)
+	{
+		OOLogERR(kOOLogScriptTimerBenchmarkMismatch, @"Queue fired %lu timers, wheel fired %lu.", (unsigned long)queueLog->count, (unsigned long)wheelLog->count);
+		mismatches += (queueLog->count > wheelLog->count) ? queueLog->count - wheelLog->count : wheelLog->count - queueLog->count;
+	}
+	
+	NSUInteger fires = queueLog->count, unschedules = simulations[kModeQueue].unschedules;
+	for (mode = 0; mode < kModeCount; mode++)  DestroySimulation(&simulations[mode]);
+	
+	OOLog(kOOLogScriptTimerBenchmark, @"Script timer benchmark, %lu timers, %lu frames, %lu fires, %lu unschedules:\n  queue %9.2f ms\n  wheel %9.2f ms (%.2fx)\n  %lu mismatched fires.",
+		  (unsigned long)timerCount, (unsigned long)frames, (unsigned long)fires, (unsigned long)unschedules,
+		  times[kModeQueue] * 1000.0, times[kModeWheel] * 1000.0, (times[kModeWheel] > 0.0) ? times[kModeQueue] / times[kModeWheel] : 0.0,
+		  (unsigned long)mismatches);
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:timerCount], @"timers",
+			[NSNumber numberWithUnsignedInteger:frames], @"frames",
+			[NSNumber numberWithUnsignedInteger:fires], @"fires",
+			[NSNumber numberWithUnsignedInteger:unschedules], @"unschedules",
+			[NSNumber numberWithDouble:times[kModeQueue] * 1000.0], @"queueMs",
+			[NSNumber numberWithDouble:times[kModeWheel] * 1000.0], @"wheelMs",
+			[NSNumber numberWithUnsignedInteger:mismatches], @"mismatches",
+			nil];
+}
+
+
+/*	Even timers are one-shot, due some time in the run; odd timers repeat
+	every 0.05 to 5 seconds, starting at a random phase. Half of each kind
+	have their delay or interval rounded to a quarter second.
+*/
+static TimerParams *GenerateTimerParams(NSUInteger count, NSUInteger seconds)
+{
+	TimerParams *params = malloc(count * sizeof *params);
+	if (params == NULL)  return NULL;
+	
+	RANROTSeed seed = MakeRanrotSeed(BENCHMARK_SEED);
+	NSUInteger i;
+	for (i = 0; i < count; i++)
+	{
+		BOOL rounded = (i % 4) < 2;
+		if ((i % 2) == 0)
+		{
+			params[i].interval = -1.0;
+			params[i].firstTime = randfWithSeed(&seed) * seconds;
+			if (rounded)  params[i].firstTime = floor(params[i].firstTime * 4.0) * 0.25;
+		}
+		else
+		{
+			params[i].interval = 0.05 + randfWithSeed(&seed) * 4.95;
+			if (rounded)  params[i].interval = 0.25 * (1 + RanrotWithSeed(&seed) % 20);
+			params[i].firstTime = randfWithSeed(&seed) * params[i].interval;
+		}
+	}
+	
+	return params;
+}
+
+
+static double RunSimulation(Simulation *simulation, const TimerParams *params, NSUInteger frames)
+{
+	NSUInteger				i, frame;
+	
+	simulation->timers = calloc(simulation->timerCount, sizeof *simulation->timers);
+	if (simulation->timers == NULL)  return 0.0;
+	for (i = 0; i < simulation->timerCount; i++)
+	{
+		OOBenchmarkTimer *timer = [[OOBenchmarkTimer alloc] init];
+		timer->entry.owner = timer;
+		timer->identifier = i;
+		timer->nextTime = params[i].firstTime;
+		timer->interval = params[i].interval;
+		simulation->timers[i] = timer;
+	}
+	simulation->seed = MakeRanrotSeed(BENCHMARK_SEED + 1);
+	
+	OOHighResTimeValue start = OOGetHighResTime();
+	
+	if (simulation->mode == kModeQueue)
+	{
+		simulation->queue = [[OOPriorityQueue alloc] initWithComparator:@selector(compareByNextFireTime:)];
+		simulation->deferredTimers = [[NSMutableArray alloc] init];
+	}
+	else
+	{
+		simulation->scheduler.wheel = OOTimingWheelCreate(0.0);
+	}
+	
+	for (i = 0; i < simulation->timerCount; i++)  ScheduleTimer(simulation, simulation->timers[i]);
+	
+	for (frame = 1; frame <= frames; frame++)
+	{
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		OOTimeAbsolute now = (OOTimeAbsolute)frame / FRAMES_PER_SECOND;
+		
+		if (simulation->mode == kModeQueue)  RunQueueFrame(simulation, now);
+		else
+		{
+			simulation->now = now;
+			OOTimingWheelRunDue(&simulation->scheduler, now, FireWheelTimer, simulation);
+		}
+		
+		[pool release];
+	}
+	
+	OOHighResTimeValue end = OOGetHighResTime();
+	double result = OOHighResTimeDeltaInSeconds(start, end);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	
+	return result;
+}
+
+
+/*	The loop +[OOScriptTimer updateTimers] used with the priority queue,
+	before it was replaced by the wheel. The wheel side runs the real loop,
+	OOTimingWheelRunDue().
+*/
+static void RunQueueFrame(Simulation *simulation, OOTimeAbsolute now)
+{
+	OOBenchmarkTimer		*timer = nil;
+	
+	simulation->updating = YES;
+	
+	for (;;)
+	{
+		timer = [simulation->queue peekAtNextObject];
+		if (timer == nil || now < timer->nextTime)  break;
+		
+		[simulation->queue removeNextObject];
+		FireTimer(simulation, timer, now);
+	}
+	
+	foreach (timer, simulation->deferredTimers)
+	{
+		timer->sequence = simulation->nextSequence++;
+	}
+	[simulation->queue addObjects:simulation->deferredTimers];
+	[simulation->deferredTimers removeAllObjects];
+	
+	simulation->updating = NO;
+}
+
+
+//	Like -[OOScriptTimer fireDueTimer]: the due list's reference to the timer is now ours.
+static void FireWheelTimer(OOTimingWheelEntry *entry, void *context)
+{
+	Simulation *simulation = context;
+	OOBenchmarkTimer *timer = entry->owner;
+	
+	FireTimer(simulation, timer, simulation->now);
+	[timer release];
+}
+
+
+static void FireTimer(Simulation *simulation, OOBenchmarkTimer *timer, OOTimeAbsolute now)
+{
+	AppendToFireLog(&simulation->log, timer->identifier);
+	
+	// The "callback": sometimes stop a timer, sometimes start an idle one.
+	uint32_t r = RanrotWithSeed(&simulation->seed);
+	OOBenchmarkTimer *other = simulation->timers[(r >> 5) % simulation->timerCount];
+	if ((r & 31) == 0 && other->scheduled)
+	{
+		UnscheduleTimer(simulation, other);
+		simulation->unschedules++;
+	}
+	else if ((r & 31) == 1 && !other->scheduled)
+	{
+		other->nextTime = now + 0.125 * (1 + (r >> 24) % 64);
+		other->interval = -1.0;
+		ScheduleTimer(simulation, other);
+	}
+	
+	if (timer->scheduled)
+	{
+		timer->scheduled = NO;
+		if (timer->interval > 0.0)
+		{
+			// As in -[OOScriptTimer isValidForScheduling].
+			timer->nextTime += ceil((now - timer->nextTime) / timer->interval) * timer->interval;
+			if (timer->nextTime <= now)  timer->nextTime += timer->interval;
+			ScheduleTimer(simulation, timer);
+		}
+	}
+}
+
+
+static void ScheduleTimer(Simulation *simulation, OOBenchmarkTimer *timer)
+{
+	timer->scheduled = YES;
+	
+	if (simulation->mode == kModeQueue)
+	{
+		if (simulation->updating)  [simulation->deferredTimers addObject:timer];
+		else
+		{
+			timer->sequence = simulation->nextSequence++;
+			[simulation->queue addObject:timer];
+		}
+	}
+	else
+	{
+		[timer retain];
+		OOTimingWheelSchedule(&simulation->scheduler, &timer->entry, timer->nextTime);
+	}
+}
+
+
+static void UnscheduleTimer(Simulation *simulation, OOBenchmarkTimer *timer)
+{
+	timer->scheduled = NO;
+	
+	if (simulation->mode == kModeQueue)
+	{
+		[simulation->queue removeExactObject:timer];
+		[simulation->deferredTimers removeObjectIdenticalTo:timer];
+	}
+	else if (OOTimingWheelEntryIsLinked(&timer->entry))
+	{
+		OOTimingWheelEntryUnlink(&timer->entry);
+		[timer release];
+	}
+}
+
+
+static void DestroySimulation(Simulation *simulation)
+{
+	NSUInteger i;
+	
+	if (simulation->timers != NULL)
+	{
+		for (i = 0; i < simulation->timerCount; i++)
+		{
+			if (simulation->mode == kModeWheel && OOTimingWheelEntryIsLinked(&simulation->timers[i]->entry))
+			{
+				OOTimingWheelEntryUnlink(&simulation->timers[i]->entry);
+				[simulation->timers[i] release];
+			}
+		}
+	}
+	
+	DESTROY(simulation->queue);
+	DESTROY(simulation->deferredTimers);
+	OOTimingWheelFree(simulation->scheduler.wheel);
+	simulation->scheduler.wheel = NULL;
+	
+	if (simulation->timers != NULL)
+	{
+		for (i = 0; i < simulation->timerCount; i++)  [simulation->timers[i] release];
+		free(simulation->timers);
+		simulation->timers = NULL;
+	}
+	
+	free(simulation->log.identifiers);
+	simulation->log.identifiers = NULL;
+}
+
+
+static void AppendToFireLog(FireLog *log, uint32_t identifier)
+{
+	if (log->count == log->capacity)
+	{
+		NSUInteger capacity = (log->capacity != 0) ? log->capacity * 2 : 4096;
+		uint32_t *identifiers = realloc(log->identifiers, capacity * sizeof *identifiers);
+		if (EXPECT_NOT(identifiers == NULL))  return;	// Shows up as a mismatch.
+		
+		log->identifiers = identifiers;
+		log->capacity = capacity;
+	}
+	
+	log->identifiers[log->count++] = identifier;
+}
+
+
+@implementation OOBenchmarkTimer
+
+- (NSComparisonResult) compareByNextFireTime:(OOBenchmarkTimer *)other
+{
+	if (nextTime < other->nextTime)  return NSOrderedAscending;
+	if (nextTime > other->nextTime)  return NSOrderedDescending;
+	if (sequence < other->sequence)  return NSOrderedAscending;
+	if (sequence > other->sequence)  return NSOrderedDescending;
+	return NSOrderedSame;
+}
+
+@end
+
+#endif	// NDEBUG
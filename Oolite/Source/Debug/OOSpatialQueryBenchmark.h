@@ -0,0 +1,53 @@
+/*
+
+OOSpatialQueryBenchmark.h
+
+Timing of the universe's range and nearest entity queries through the
+spatial index (OOSpatialIndex), compared with the linear sweeps over the
+entity hot state that they replaced.
+
+Reference entities are spread through the distance-from-player list, and
+the same ones are used for both paths. After timing, every query is run
+again both ways with no predicate, and nearest queries once more with the
+ship predicate; the results must be identical, including which entity wins
+a tie, or a mismatch is counted.
+
+Only available in debug builds. Can be run from the debug console with
+console.runSpatialQueryBenchmark(queryCount [, range]).
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#ifndef NDEBUG
+
+/*	Returns a dictionary with the keys queryCount, entityCount,
+	indexedRangeQueryTime, linearRangeQueryTime, indexedNearestQueryTime,
+	linearNearestQueryTime (in seconds per query) and mismatches. Results are
+	also written to the log under universe.spatialIndex.benchmark. Returns nil
+	if the spatial index is turned off, there are no entities, queryCount is
+	zero or range is negative.
+*/
+NSDictionary *OOSpatialQueryRunBenchmark(unsigned queryCount, double range);
+
+#endif
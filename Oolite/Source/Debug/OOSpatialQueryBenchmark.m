@@ -0,0 +1,161 @@
+/*
+
+OOSpatialQueryBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOSpatialQueryBenchmark.h"
+#import "OOProfilingStopwatch.h"
+#import "OOUniverse.h"
+#import "OOSpatialIndex.h"
+#import "OOEntityFilterPredicate.h"
+
+
+#ifndef NDEBUG
+
+static NSString * const kOOLogSpatialQueryBenchmark			= @"universe.spatialIndex.benchmark";
+static NSString * const kOOLogSpatialQueryBenchmarkFailed	= @"universe.spatialIndex.benchmark.failed";
+
+
+@interface OOUniverse (Peek)
+
+- (NSMutableArray *) findEntitiesMatchingPredicateLinear:(EntityFilterPredicate)predicate
+											   parameter:(void *)parameter
+												 inRange:(double)range
+												ofEntity:(OOEntity *)e1;
+- (id) nearestEntityMatchingPredicateLinear:(EntityFilterPredicate)predicate
+								  parameter:(void *)parameter
+						   relativeToEntity:(OOEntity *)entity;
+
+@end
+
+
+// Reference entities are spread through the distance-from-player list.
+OOINLINE OOEntity *ReferenceEntity(OOUniverse *universe, unsigned i)
+{
+	return universe->sortedEntities[(i * 7919) % universe->n_entities];
+}
+
+
+NSDictionary *OOSpatialQueryRunBenchmark(unsigned queryCount, double range)
+{
+	OOUniverse			*universe = UNIVERSE;
+	OOSpatialIndex		*index = [universe spatialIndex];
+	unsigned			i, mismatches = 0;
+	OOHighResTimeValue	start, end;
+	OOTimeDelta			indexedRangeTime, linearRangeTime, indexedNearestTime, linearNearestTime;
+	NSAutoreleasePool	*pool = nil;
+	
+	if (index == nil || universe->n_entities == 0 || queryCount == 0 || !(range >= 0))
+	{
+		OOLog(kOOLogSpatialQueryBenchmarkFailed, @"Can't run spatial query benchmark: %@.", (index == nil) ? @"spatial-query-index is off" : @"nothing to query");
+		return nil;
+	}
+	
+	// Bring the index up to date so both paths see the same state.
+	[index rebuildWithSlots:universe->sortedSlots count:universe->n_entities];
+	
+	pool = [[NSAutoreleasePool alloc] init];
+	start = OOGetHighResTime();
+	for (i = 0; i < queryCount; i++)
+	{
+		[universe findEntitiesMatchingPredicate:NULL parameter:NULL inRange:range ofEntity:ReferenceEntity(universe, i)];
+	}
+	end = OOGetHighResTime();
+	indexedRangeTime = OOHighResTimeDeltaInSeconds(start, end);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	
+	start = OOGetHighResTime();
+	for (i = 0; i < queryCount; i++)
+	{
+		[universe findEntitiesMatchingPredicateLinear:NULL parameter:NULL inRange:range ofEntity:ReferenceEntity(universe, i)];
+	}
+	end = OOGetHighResTime();
+	linearRangeTime = OOHighResTimeDeltaInSeconds(start, end);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	
+	start = OOGetHighResTime();
+	for (i = 0; i < queryCount; i++)
+	{
+		[universe nearestEntityMatchingPredicate:NULL parameter:NULL relativeToEntity:ReferenceEntity(universe, i)];
+	}
+	end = OOGetHighResTime();
+	indexedNearestTime = OOHighResTimeDeltaInSeconds(start, end);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	
+	start = OOGetHighResTime();
+	for (i = 0; i < queryCount; i++)
+	{
+		[universe nearestEntityMatchingPredicateLinear:NULL parameter:NULL relativeToEntity:ReferenceEntity(universe, i)];
+	}
+	end = OOGetHighResTime();
+	linearNearestTime = OOHighResTimeDeltaInSeconds(start, end);
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(end);
+	[pool release];
+	
+	pool = [[NSAutoreleasePool alloc] init];
+	for (i = 0; i < queryCount; i++)
+	{
+		OOEntity *reference = ReferenceEntity(universe, i);
+		
+		if (![[universe findEntitiesMatchingPredicate:NULL parameter:NULL inRange:range ofEntity:reference] isEqualToArray:
+			  [universe findEntitiesMatchingPredicateLinear:NULL parameter:NULL inRange:range ofEntity:reference]])
+		{
+			mismatches++;
+		}
+		else if ([universe nearestEntityMatchingPredicate:NULL parameter:NULL relativeToEntity:reference] !=
+				 [universe nearestEntityMatchingPredicateLinear:NULL parameter:NULL relativeToEntity:reference])
+		{
+			mismatches++;
+		}
+		else if ([universe nearestEntityMatchingPredicate:IsShipPredicate parameter:NULL relativeToEntity:reference] !=
+				 [universe nearestEntityMatchingPredicateLinear:IsShipPredicate parameter:NULL relativeToEntity:reference])
+		{
+			mismatches++;
+		}
+	}
+	[pool release];
+	
+	OOLog(kOOLogSpatialQueryBenchmark, @"Spatial query benchmark, %u queries over %u entities (%lu index nodes), range %g:\n"
+		  "  range queries:   indexed %.3f us, linear %.3f us\n"
+		  "  nearest queries: indexed %.3f us, linear %.3f us\n"
+		  "  %u mismatches",
+		  queryCount, universe->n_entities, (unsigned long)[index nodeCount], range,
+		  indexedRangeTime * 1e6 / queryCount, linearRangeTime * 1e6 / queryCount,
+		  indexedNearestTime * 1e6 / queryCount, linearNearestTime * 1e6 / queryCount,
+		  mismatches);
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInt:queryCount], @"queryCount",
+			[NSNumber numberWithUnsignedInt:universe->n_entities], @"entityCount",
+			[NSNumber numberWithDouble:indexedRangeTime / queryCount], @"indexedRangeQueryTime",
+			[NSNumber numberWithDouble:linearRangeTime / queryCount], @"linearRangeQueryTime",
+			[NSNumber numberWithDouble:indexedNearestTime / queryCount], @"indexedNearestQueryTime",
+			[NSNumber numberWithDouble:linearNearestTime / queryCount], @"linearNearestQueryTime",
+			[NSNumber numberWithUnsignedInt:mismatches], @"mismatches",
+			nil];
+}
+
+#endif
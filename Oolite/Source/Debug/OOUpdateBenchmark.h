@@ -0,0 +1,133 @@
+/*
+
+OOUpdateBenchmark.h
+
+Repeatable timing of -[OOUniverse update:].
+
+An update benchmark seeds the random number generators, spawns a number of
+ships with a given role near the player, and steps the universe a fixed
+number of frames with a fixed time delta, without drawing. The time spent in
+each stage of -update: (using the same names as its update_stage labels) is
+recorded per frame, and summarised as mean and percentiles, along with the
+number of moves made keeping the distance-from-player list sorted. The spawned
+ships are removed and the random number generators restored afterwards.
+
+Stages are marked with OO_UPDATE_BENCHMARK_MARK(), which costs a single
+pointer test when no benchmark is running. Benchmarks are available in all
+builds, so that release builds can be measured.
+
+Benchmarks can be run from the debug console with
+console.runUpdateBenchmark(shipCount, frameCount [, role [, timeDelta]]),
+which works the same way on every platform. They can also be run without a
+window by starting the game with --update-benchmark shipCount frameCount
+[role], which sets up the universe with no game view, launches the player
+from the main station, prints the results to standard output and quits.
+Start-up still needs a current OpenGL context, which the platform's main()
+must make before calling OOUpdateBenchmarkRunHeadless(); the Mac OS X build
+uses Apple's software renderer for this, so it doesn't need a GPU either.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+#import "OOProfilingStopwatch.h"
+
+
+typedef enum
+{
+	kOOUpdateStageOther,				// Player controls, list maintenance and clean up.
+	kOOUpdateStageDemo,					// "demo management"
+	kOOUpdateStageEntity,				// "update:entity"
+	kOOUpdateStageListMaintenance,		// "update:list maintenance"
+	kOOUpdateStageThink,				// "update:think"
+	kOOUpdateStageZombies,				// "shootin' zombies"
+	kOOUpdateStageLinkedLists,			// "updating linked lists"
+	kOOUpdateStageBroadPhase,			// "collision and shadow detection", filterSortedLists or OOBroadPhase.
+	kOOUpdateStageCollisionsAndShadows,	// "collision and shadow detection", findCollisionsAndShadows.
+
+	kOOUpdateStageCount
+} OOUpdateStage;
+
+
+#define UPDATE_BENCHMARK_DEFAULT_ROLE		@"trader"
+#define UPDATE_BENCHMARK_DEFAULT_DELTA_T	(1.0 / 60.0)
+#define UPDATE_BENCHMARK_DEFAULT_SEED		12345
+#define UPDATE_BENCHMARK_SPAWN_DISTANCE		20000.0f
+#define UPDATE_BENCHMARK_SPAWN_RADIUS		10000.0f
+
+
+@interface OOUpdateBenchmark: NSObject
+{
+@private
+	unsigned				_shipCount;
+	unsigned				_frameCount;
+	OOTimeDelta				_timeDelta;
+	NSString				*_role;
+	unsigned				_seed;
+
+	double					*_samples;			// _frameCount rows of kOOUpdateStageCount + 1 (frame total) seconds.
+	unsigned				_currentFrame;
+	OOUpdateStage			_currentStage;
+	OOHighResTimeValue		_lastMark;
+	NSUInteger				_entityCount;
+
+	NSUInteger				_totalSwaps;		// -[OOUniverse zeroDistanceSwapCount] over all frames.
+	NSUInteger				_maxSwaps;
+	NSUInteger				_resortsAtStart;
+	NSUInteger				_resorts;
+}
+
+- (id) initWithShipCount:(unsigned)shipCount
+			  frameCount:(unsigned)frameCount
+			   timeDelta:(OOTimeDelta)timeDelta
+					role:(NSString *)role
+					seed:(unsigned)seed;
+
+/*	Run the benchmark and return a dictionary of results, or nil if the
+	benchmark can't be run (for instance, because another benchmark is
+	running or the game is paused). Results are also written to the log
+	under universe.benchmark.
+*/
+- (NSDictionary *) run;
+
+// Called through OO_UPDATE_BENCHMARK_MARK().
+- (void) markStage:(OOUpdateStage)stage;
+
+@end
+
+
+extern OOUpdateBenchmark *gActiveUpdateBenchmark;
+
+
+/*	Windowless entry point. OOUpdateBenchmarkHeadlessRunRequested() checks
+	the command line for --update-benchmark. OOUpdateBenchmarkRunHeadless()
+	creates the universe with a nil game view and runs the benchmark
+	described by the command line, returning a process exit status. The
+	caller must have made an OpenGL context current; it need not be attached
+	to a window.
+*/
+BOOL OOUpdateBenchmarkHeadlessRunRequested(NSArray *arguments);
+int OOUpdateBenchmarkRunHeadless(NSArray *arguments);
+
+#define OO_UPDATE_BENCHMARK_MARK(stage) \
+	do { if (EXPECT_NOT(gActiveUpdateBenchmark != nil))  [gActiveUpdateBenchmark markStage:(stage)]; } while (0)
+
+NSString *OOStringFromUpdateStage(OOUpdateStage stage) CONST_FUNC;
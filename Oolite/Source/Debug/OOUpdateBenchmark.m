@@ -0,0 +1,377 @@
+/*
+
+OOUpdateBenchmark.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOUpdateBenchmark.h"
+#import "OOUniverse.h"
+#import "OOPlayerShipEntity.h"
+#import "OOStationEntity.h"
+#import "OOGameController.h"
+
+
+static NSString * const kOOLogUpdateBenchmark			= @"universe.benchmark";
+static NSString * const kOOLogUpdateBenchmarkFailed		= @"universe.benchmark.failed";
+
+OOUpdateBenchmark *gActiveUpdateBenchmark = nil;
+
+
+static int CompareDoubles(const void *a, const void *b);
+static double Percentile(const double *sorted, unsigned count, double fraction);
+
+
+@interface OOUpdateBenchmark (OOPrivate)
+
+- (void) beginFrame;
+- (void) endFrame;
+- (NSDictionary *) summarize;
+
+@end
+
+
+@implementation OOUpdateBenchmark
+
+- (id) initWithShipCount:(unsigned)shipCount
+			  frameCount:(unsigned)frameCount
+			   timeDelta:(OOTimeDelta)timeDelta
+					role:(NSString *)role
+					seed:(unsigned)seed
+{
+	if (frameCount == 0 || !(timeDelta > 0.0))
+	{
+		[self release];
+		return nil;
+	}
+
+	if ((self = [super init]))
+	{
+		_shipCount = shipCount;
+		_frameCount = frameCount;
+		_timeDelta = timeDelta;
+		_role = [(role ?: UPDATE_BENCHMARK_DEFAULT_ROLE) copy];
+		_seed = seed;
+
+		_samples = calloc(frameCount * (kOOUpdateStageCount + 1), sizeof *_samples);
+		if (_samples == NULL)
+		{
+			[self release];
+			return nil;
+		}
+	}
+
+	return self;
+}
+
+
+- (void) dealloc
+{
+	DESTROY(_role);
+	free(_samples);
+
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%u \"%@\" ships, %u frames of %g s", _shipCount, _role, _frameCount, _timeDelta];
+}
+
+
+- (NSDictionary *) run
+{
+	OOUniverse			*universe = UNIVERSE;
+	OOPlayerShipEntity	*player = PLAYER;
+	NSArray				*ships = nil;
+	NSEnumerator		*shipEnum = nil;
+	OOShipEntity		*ship = nil;
+	NSDictionary		*result = nil;
+
+	if (gActiveUpdateBenchmark != nil)
+	{
+		OOLog(kOOLogUpdateBenchmarkFailed, @"Can't start update benchmark %@ while %@ is running.", self, gActiveUpdateBenchmark);
+		return nil;
+	}
+	if (universe == nil || [universe isGamePaused])
+	{
+		OOLog(kOOLogUpdateBenchmarkFailed, @"Can't run update benchmark %@ while the game is paused.", self);
+		return nil;
+	}
+
+	RANROTSeed savedRanrotSeed = RANROTGetFullSeed();
+	RNG_Seed savedRNGSeed = currentRandomSeed();
+	double savedTimeAcceleration = [universe timeAccelerationFactor];
+
+	ranrot_srand(_seed);
+	setRandomSeed((RNG_Seed){ _seed, _seed >> 8, _seed >> 16, _seed >> 24 });
+	[universe setTimeAccelerationFactor:1.0];
+
+	Vector spawnPos = vector_add([player position], vector_multiply_scalar(vector_forward_from_quaternion([player normalOrientation]), UPDATE_BENCHMARK_SPAWN_DISTANCE));
+	if (_shipCount != 0)
+	{
+		ships = [universe addShipsAt:spawnPos withRole:_role quantity:_shipCount withinRadius:UPDATE_BENCHMARK_SPAWN_RADIUS asGroup:NO];
+	}
+
+	_entityCount = [universe entityCount];
+	OOLog(kOOLogUpdateBenchmark, @"Running update benchmark %@ with %lu ships spawned, %lu entities.", self, (unsigned long)[ships count], (unsigned long)_entityCount);
+
+	_totalSwaps = 0;
+	_maxSwaps = 0;
+	_resortsAtStart = [universe zeroDistanceResortCount];
+
+	gActiveUpdateBenchmark = self;
+	NS_DURING
+		for (_currentFrame = 0; _currentFrame < _frameCount; _currentFrame++)
+		{
+			NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+			[self beginFrame];
+			[universe update:_timeDelta];
+			[self endFrame];
+
+			[pool release];
+		}
+	NS_HANDLER
+		gActiveUpdateBenchmark = nil;
+		[universe setTimeAccelerationFactor:savedTimeAcceleration];
+		[localException raise];
+	NS_ENDHANDLER
+	gActiveUpdateBenchmark = nil;
+	_resorts = [universe zeroDistanceResortCount] - _resortsAtStart;
+
+	result = [self summarize];
+
+	for (shipEnum = [ships objectEnumerator]; (ship = [shipEnum nextObject]); )
+	{
+		if ([ship status] != STATUS_DEAD)  [universe removeEntity:ship];
+	}
+
+	[universe setTimeAccelerationFactor:savedTimeAcceleration];
+	RANROTSetFullSeed(savedRanrotSeed);
+	setRandomSeed(savedRNGSeed);
+
+	return result;
+}
+
+
+- (void) markStage:(OOUpdateStage)stage
+{
+	OOHighResTimeValue now = OOGetHighResTime();
+	_samples[_currentFrame * (kOOUpdateStageCount + 1) + _currentStage] += OOHighResTimeDeltaInSeconds(_lastMark, now);
+	OODisposeHighResTime(_lastMark);
+	_lastMark = now;
+	_currentStage = stage;
+}
+
+@end
+
+
+@implementation OOUpdateBenchmark (OOPrivate)
+
+- (void) beginFrame
+{
+	OODisposeHighResTime(_lastMark);
+	_lastMark = OOGetHighResTime();
+	_currentStage = kOOUpdateStageOther;
+}
+
+
+- (void) endFrame
+{
+	unsigned			i;
+	double				*row = &_samples[_currentFrame * (kOOUpdateStageCount + 1)];
+	double				total = 0.0;
+
+	[self markStage:kOOUpdateStageOther];
+
+	NSUInteger swaps = [UNIVERSE zeroDistanceSwapCount];
+	_totalSwaps += swaps;
+	if (swaps > _maxSwaps)  _maxSwaps = swaps;
+
+	for (i = 0; i < kOOUpdateStageCount; i++)  total += row[i];
+	row[kOOUpdateStageCount] = total;
+}
+
+
+- (NSDictionary *) summarize
+{
+	unsigned			stage, frame;
+	unsigned			rowSize = kOOUpdateStageCount + 1;
+	double				sorted[_frameCount];
+	NSMutableDictionary	*stages = [NSMutableDictionary dictionaryWithCapacity:rowSize];
+	NSMutableString		*report = [NSMutableString string];
+
+	[report appendFormat:@"%-48s %10s %10s %10s %10s %10s\n", "stage (ms)", "mean", "p50", "p90", "p99", "max"];
+
+	for (stage = 0; stage < rowSize; stage++)
+	{
+		double sum = 0.0;
+		for (frame = 0; frame < _frameCount; frame++)
+		{
+			sorted[frame] = _samples[frame * rowSize + stage] * 1000.0;
+			sum += sorted[frame];
+		}
+		qsort(sorted, _frameCount, sizeof *sorted, CompareDoubles);
+
+		double mean = sum / _frameCount;
+		double p50 = Percentile(sorted, _frameCount, 0.50);
+		double p90 = Percentile(sorted, _frameCount, 0.90);
+		double p99 = Percentile(sorted, _frameCount, 0.99);
+		double max = sorted[_frameCount - 1];
+
+		NSString *name = (stage < kOOUpdateStageCount) ? OOStringFromUpdateStage(stage) : @"frame";
+		[stages setObject:[NSDictionary dictionaryWithObjectsAndKeys:
+						   [NSNumber numberWithDouble:mean], @"mean",
+						   [NSNumber numberWithDouble:p50], @"p50",
+						   [NSNumber numberWithDouble:p90], @"p90",
+						   [NSNumber numberWithDouble:p99], @"p99",
+						   [NSNumber numberWithDouble:max], @"max",
+						   nil]
+				   forKey:name];
+		[report appendFormat:@"%-48s %10.4f %10.4f %10.4f %10.4f %10.4f\n", [name UTF8String], mean, p50, p90, p99, max];
+	}
+
+	[report appendFormat:@"Distance-from-player list: %.1f moves/frame (max %lu), %lu full sorts.\n", (double)_totalSwaps / _frameCount, (unsigned long)_maxSwaps, (unsigned long)_resorts];
+
+	OOLog(kOOLogUpdateBenchmark, @"Update benchmark %@ finished:\n%@", self, report);
+
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInt:_shipCount], @"shipCount",
+			[NSNumber numberWithUnsignedInteger:_entityCount], @"entityCount",
+			[NSNumber numberWithUnsignedInt:_frameCount], @"frameCount",
+			[NSNumber numberWithDouble:_timeDelta], @"timeDelta",
+			_role, @"role",
+			stages, @"stages",
+			[NSNumber numberWithDouble:(double)_totalSwaps / _frameCount], @"zeroDistanceSwapsPerFrame",
+			[NSNumber numberWithUnsignedInteger:_maxSwaps], @"zeroDistanceMaxSwaps",
+			[NSNumber numberWithUnsignedInteger:_resorts], @"zeroDistanceResorts",
+			nil];
+}
+
+@end
+
+
+#define kHeadlessArgument	@"--update-benchmark"
+
+
+BOOL OOUpdateBenchmarkHeadlessRunRequested(NSArray *arguments)
+{
+	return [arguments containsObject:kHeadlessArgument];
+}
+
+
+int OOUpdateBenchmarkRunHeadless(NSArray *arguments)
+{
+	NSUInteger			index = [arguments indexOfObject:kHeadlessArgument];
+	NSUInteger			count = [arguments count];
+	int					shipCount, frameCount;
+	NSString			*role = nil;
+	NSDictionary		*result = nil;
+	
+	if (index == NSNotFound || index + 2 >= count)
+	{
+		fprintf(stderr, "Usage: --update-benchmark shipCount frameCount [role]\n");
+		return EXIT_FAILURE;
+	}
+	
+	shipCount = [[arguments objectAtIndex:index + 1] intValue];
+	frameCount = [[arguments objectAtIndex:index + 2] intValue];
+	if (index + 3 < count && ![[arguments objectAtIndex:index + 3] hasPrefix:@"-"])  role = [arguments objectAtIndex:index + 3];
+	if (shipCount < 0 || frameCount <= 0)
+	{
+		fprintf(stderr, "Usage: --update-benchmark shipCount frameCount [role]\n");
+		return EXIT_FAILURE;
+	}
+	
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NS_DURING
+		// Start-up as in -[OOGameController applicationDidFinishLaunching:], without the game view.
+		[OOGameController sharedController];
+		[[OOUniverse alloc] initWithGameView:nil];
+	
+		// Launch as from the INTRO2 screen and F1.
+		OOPlayerShipEntity *player = PLAYER;
+		[player setStatus:STATUS_DOCKED];
+		[UNIVERSE removeDemoShips];
+		[UNIVERSE setUpUniverseFromStation];
+		[player leaveDock:[UNIVERSE station]];
+	
+		OOUpdateBenchmark *benchmark = [[OOUpdateBenchmark alloc] initWithShipCount:shipCount
+																		 frameCount:frameCount
+																		  timeDelta:UPDATE_BENCHMARK_DEFAULT_DELTA_T
+																			   role:role
+																			   seed:UPDATE_BENCHMARK_DEFAULT_SEED];
+		result = [[benchmark run] retain];
+		[benchmark release];
+	NS_HANDLER
+		OOLog(kOOLogUpdateBenchmarkFailed, @"***** Windowless update benchmark failed: %@: %@", [localException name], [localException reason]);
+		result = nil;
+	NS_ENDHANDLER
+	
+	if (result != nil)  printf("%s\n", [[result description] UTF8String]);
+	BOOL OK = result != nil;
+	[result release];
+	[pool release];
+	
+	return OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+static int CompareDoubles(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+	if (da < db)  return -1;
+	if (da > db)  return 1;
+	return 0;
+}
+
+
+static double Percentile(const double *sorted, unsigned count, double fraction)
+{
+	// Nearest-rank percentile.
+	unsigned index = (unsigned)ceil(fraction * count);
+	if (index > 0)  index--;
+	if (index >= count)  index = count - 1;
+	return sorted[index];
+}
+
+
+NSString *OOStringFromUpdateStage(OOUpdateStage stage)
+{
+	switch (stage)
+	{
+		case kOOUpdateStageOther:					return @"other";
+		case kOOUpdateStageDemo:					return @"demo management";
+		case kOOUpdateStageEntity:					return @"update:entity";
+		case kOOUpdateStageListMaintenance:			return @"update:list maintenance";
+		case kOOUpdateStageThink:					return @"update:think";
+		case kOOUpdateStageZombies:					return @"shootin' zombies";
+		case kOOUpdateStageLinkedLists:				return @"updating linked lists";
+		case kOOUpdateStageBroadPhase:				return @"collision and shadow detection: broad phase";
+		case kOOUpdateStageCollisionsAndShadows:	return @"collision and shadow detection: narrow phase";
+
+		case kOOUpdateStageCount:
+			break;
+	}
+
+	return @"unknown";
+}
@@ -128,7 +128,7 @@ MA 02110-1301, USA.
 	[super update:delta_t];
 	
 	double movement = RING_SPEED * delta_t;
-	position = vector_subtract(position, vector_multiply_scalar(velocity, movement));
+	[self setPosition:vector_subtract(position, vector_multiply_scalar(velocity, movement))];
 	_lifetime -= movement;
 	
 	if (_lifetime < 0.0)
@@ -135,6 +135,17 @@ enum
 }
 
 
+- (BOOL) canUpdateConcurrently
+{
+#if OO_SHADERS
+	// -checkShaderMode looks at the universe's shader settings, so do it on the main thread.
+	return shaderMode != kShaderModeUnknown;
+#else
+	return YES;
+#endif
+}
+
+
 - (void) update:(OOTimeDelta) delta_t
 {
 #if OO_SHADERS
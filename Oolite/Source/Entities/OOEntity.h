@@ -27,6 +27,7 @@ MA 02110-1301, USA.
 #import <OoliteBase/OoliteBase.h>
 #import "OOCacheManager.h"
 #import "OOTypes.h"
+#import "OOEntityHotState.h"
 
 @class OOUniverse, Geometry, CollisionRegion, OOShipEntity;
 
@@ -109,6 +110,7 @@ enum OOScanClass
 	Quaternion				orientation;
 	
 	int						zero_index;
+	OOEntityStateSlot		stateSlot;				// Slot in the universe's OOEntityHotState, kOOEntityStateNoSlot if not in universe.
 	
 	// Linked lists of entites, sorted by position on each (world) axis
 	OOEntity					*x_previous, *x_next;
@@ -168,6 +170,9 @@ enum OOScanClass
 
 - (void) updateLinkedLists;
 
+// Copy position, velocity, collision radius, zero distance and collidability into stateSlot, if any.
+- (void) storeHotState:(OOEntityHotState *)state;
+
 - (void) wasAddedToUniverse;
 - (void) wasRemovedFromUniverse;
 
@@ -244,6 +249,13 @@ enum OOScanClass
 - (NSMutableArray *)collisionArray;
 
 - (void) update:(OOTimeDelta)delta_t;
+
+/*	YES if -update: only modifies the receiver, and otherwise only reads the
+	player and the receiver's owner, so that it can be called on a worker
+	thread alongside other such entities. -[OOUniverse removeEntity:] may be
+	called; it's deferred until all concurrent updates are done. Default: NO.
+*/
+- (BOOL) canUpdateConcurrently;
 - (void) applyVelocityWithTimeDelta:(OOTimeDelta)delta_t;	// Newtonion mechanics is opt-in. (FIXME: is there actually anything with a non-zero velocity that doesn't want this? -- Ahruman 2011-01-31)
 
 - (BOOL) checkCloseCollisionWith:(OOEntity *)other;
@@ -70,6 +70,7 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 	orientation = kIdentityQuaternion;
 	rotMatrix = kIdentityMatrix;
 	position = kZeroVector;
+	stateSlot = kOOEntityStateNoSlot;
 	
 	no_draw_distance = 100000.0;  //  10 km
 	
@@ -489,6 +490,18 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 }
 
 
+- (void) storeHotState:(OOEntityHotState *)state
+{
+	if (stateSlot == kOOEntityStateNoSlot)  return;
+	
+	state->radius[stateSlot] = collision_radius;
+	OOEntityHotStateSetPosition(state, stateSlot, position);	// Also notes drift in radius.
+	OOEntityHotStateSetVelocity(state, stateSlot, velocity);
+	state->zeroDistance[stateSlot] = zero_distance;
+	state->canCollide[stateSlot] = [self canCollide];
+}
+
+
 - (void) wasAddedToUniverse
 {
 	// Do nothing
@@ -590,6 +603,7 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 - (void) setPosition:(Vector) posn
 {
 	position = posn;
+	if (stateSlot != kOOEntityStateNoSlot)  OOEntityHotStateSetPosition([UNIVERSE entityHotState], stateSlot, position);
 }
 
 
@@ -598,6 +612,7 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 	position.x = x;
 	position.y = y;
 	position.z = z;
+	if (stateSlot != kOOEntityStateNoSlot)  OOEntityHotStateSetPosition([UNIVERSE entityHotState], stateSlot, position);
 }
 
 
@@ -688,6 +703,7 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 - (void) setVelocity:(Vector) vel
 {
 	velocity = vel;
+	if (stateSlot != kOOEntityStateNoSlot)  OOEntityHotStateSetVelocity([UNIVERSE entityHotState], stateSlot, velocity);
 }
 
 
@@ -829,9 +845,7 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 {
 	Vector		forward = vector_forward_from_quaternion(orientation);
 	distanceTravelled += amount;
-	position.x += amount * forward.x;
-	position.y += amount * forward.y;
-	position.z += amount * forward.z;
+	[self setPosition:vector_add(position, vector_multiply_scalar(forward, amount))];
 }
 
 
@@ -882,6 +896,7 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 - (void) setCollisionRadius:(GLfloat) amount
 {
 	collision_radius = amount;
+	if (stateSlot != kOOEntityStateNoSlot)  OOEntityHotStateSetRadius([UNIVERSE entityHotState], stateSlot, amount);
 }
 
 
@@ -891,6 +906,12 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 }
 
 
+- (BOOL) canUpdateConcurrently
+{
+	return NO;
+}
+
+
 - (void) update:(OOTimeDelta)delta_t
 {
 	if (_status != STATUS_COCKPIT_DISPLAY)
@@ -911,7 +932,7 @@ static NSString * const kOOLogEntityUpdateError				= @"entity.linkedList.update.
 
 - (void) applyVelocityWithTimeDelta:(OOTimeDelta)delta_t
 {
-	position = vector_add(position, vector_multiply_scalar(velocity, delta_t));
+	[self setPosition:vector_add(position, vector_multiply_scalar(velocity, delta_t))];
 }
 
 
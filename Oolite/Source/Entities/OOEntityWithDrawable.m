@@ -53,7 +53,7 @@ MA 02110-1301, USA.
 		drawable = [inDrawable retain];
 		[drawable setBindingTarget:self];
 		
-		collision_radius = [drawable collisionRadius];
+		[self setCollisionRadius:[drawable collisionRadius]];
 		no_draw_distance = [drawable maxDrawDistance];
 		boundingBox = [drawable boundingBox];
 	}
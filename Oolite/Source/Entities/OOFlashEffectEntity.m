@@ -110,7 +110,7 @@ static OOLegacyTexture *sFlashTexture = nil;
 	float tf1 = _duration - tf;
 	
 	// Move as necessary.
-	position = vector_add(position, vector_multiply_scalar(velocity, delta_t));
+	[self setPosition:vector_add(position, vector_multiply_scalar(velocity, delta_t))];
 	
 	// Scale up.
 	_diameter += delta_t * _growthRate;
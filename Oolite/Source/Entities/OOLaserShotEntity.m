@@ -148,6 +148,12 @@ MA 02110-1301, USA.
 }
 
 
+- (BOOL) canUpdateConcurrently
+{
+	return YES;
+}
+
+
 - (void) update:(OOTimeDelta)delta_t
 {
 	[super update:delta_t];
@@ -102,6 +102,12 @@ MA 02110-1301, USA.
 }
 
 
+- (BOOL) canUpdateConcurrently
+{
+	return YES;
+}
+
+
 - (BOOL) checkCloseCollisionWith:(OOEntity *)other
 {
 	if (other == [self owner])  return NO;
@@ -113,7 +119,7 @@ MA 02110-1301, USA.
 {
 	[super update:delta_t];
 	_timePassed += delta_t;
-	collision_radius += delta_t * _maxSpeed;
+	[self setCollisionRadius:collision_radius + delta_t * _maxSpeed];
 	
 	unsigned	i, count = _count;
 	Vector		*particlePosition = _particlePosition;
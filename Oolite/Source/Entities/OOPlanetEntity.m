@@ -138,7 +138,7 @@ MA 02110-1301, USA.
 	NSString *textureName = [dict oo_stringForKey:@"texture"];
 	[self setUpPlanetFromTexture:textureName];
 	
-	collision_radius = radius_km * 10.0;	// Scale down by a factor of 100
+	[self setCollisionRadius:radius_km * 10.0];	// Scale down by a factor of 100
 	_rotationAxis = kBasisYVector;
 	orientation = (Quaternion){ M_SQRT1_2, M_SQRT1_2, 0, 0 };	// do we want to do something more interesting here?
 										// EW: NO, setting orientation should be handled by the code that adds the planet, not by planetEntity itself.
@@ -294,7 +294,7 @@ static OOColor *ColorWithHSBColor(Vector c)
 	scanClass = CLASS_NO_DRAW;
 	[self setStatus:STATUS_COCKPIT_DISPLAY];
 	
-	collision_radius = planet->collision_radius * PLANET_MINIATURE_FACTOR;
+	[self setCollisionRadius:planet->collision_radius * PLANET_MINIATURE_FACTOR];
 	orientation = planet->orientation;
 	_rotationAxis = planet->_rotationAxis;
 	_rotationalVelocity = 0.04;
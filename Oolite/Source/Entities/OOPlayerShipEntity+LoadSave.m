@@ -484,7 +484,7 @@ static uint16_t PersonalityForCommanderDict(NSDictionary *dict);
 	dockedStation = [UNIVERSE station];
 	if (dockedStation)
 	{
-		position = [dockedStation position];
+		[self setPosition:[dockedStation position]];
 		[self setOrientation: kIdentityQuaternion];
 		v_forward = vector_forward_from_quaternion(orientation);
 		v_right = vector_right_from_quaternion(orientation);
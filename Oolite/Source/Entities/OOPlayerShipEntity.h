@@ -35,6 +35,7 @@ MA 02110-1301, USA.
 @class GuiDisplayGen, OOTrumble, MyOpenGLView, HeadUpDisplay, OOShipEntity;
 @class OOSound, OOSoundSource, OOSoundReferencePoint;
 @class OOJoystickManager, OOLegacyTexture, OOCamera, OOShipViewDescription;
+@class OOJSEventHandlerIndex;
 
 
 #define GUI_ROW_INIT(GUI) /*int n_rows = [(GUI) rows]*/
@@ -242,6 +243,7 @@ typedef enum
 	int						ship_trade_in_factor;
 	
 	NSDictionary			*worldScripts;
+	OOJSEventHandlerIndex	*worldScriptHandlers;
 	NSMutableDictionary		*mission_variables;
 	NSMutableDictionary		*localVariables;
 	int						missionTextRow;
@@ -788,6 +790,10 @@ typedef enum
 - (BOOL) doWorldEventUntilMissionScreen:(jsid)message;
 - (void) doWorldScriptEvent:(jsid)message inContext:(JSContext *)context withArguments:(jsval *)argv count:(uintN)argc timeLimit:(OOTimeDelta)limit;
 
+// See -[OOJSEventHandlerIndex statistics].
+- (NSDictionary *) worldScriptEventStatistics;
+- (void) resetWorldScriptEventStatistics;
+
 - (void) runMissionCallback;
 
 - (BOOL)showInfoFlag;
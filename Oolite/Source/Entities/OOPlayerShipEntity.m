@@ -61,6 +61,7 @@ MA 02110-1301, USA.
 #import "OOEquipmentType.h"
 
 #import "OOJSScript.h"
+#import "OOJSEventHandlerIndex.h"
 #import "OOScriptTimer.h"
 #import "OOJSEngineTimeManagement.h"
 #import "OOJSScript.h"
@@ -577,6 +578,8 @@ static GLfloat		sBaseMass = 0.0;
 	[UNIVERSE setBlockJSPlayerShipProps:NO];	// full access to player.ship properties!
 	[worldScripts release];
 	worldScripts = [[ResourceManager loadScripts] retain];
+	[worldScriptHandlers release];
+	worldScriptHandlers = [[OOJSEventHandlerIndex alloc] initWithScripts:[worldScripts allValues]];
 	
 	// if there is cargo remaining from previously (e.g. a game restart), remove it
 	if ([self cargoList] != nil)
@@ -874,6 +877,7 @@ static GLfloat		sBaseMass = 0.0;
 	DESTROY(hud);
 	DESTROY(commLog);
 	
+	DESTROY(worldScriptHandlers);
 	DESTROY(worldScripts);
 	DESTROY(mission_variables);
 	
@@ -1652,7 +1656,7 @@ static bool minShieldLevelPercentageInitialised = false;
 	autopilot_engaged = YES;
 	ident_engaged = NO;
 	[self safeAllMissiles];
-	velocity = kZeroVector;
+	[self setVelocity:kZeroVector];
 	[self setStatus:STATUS_AUTOPILOT_ENGAGED];
 	[self resetAutopilotAI];
 	[shipAI setState:@"BEGIN_DOCKING"];	// reboot the AI
@@ -1720,7 +1724,7 @@ static bool minShieldLevelPercentageInitialised = false;
 	UPDATE_STAGE(@"applying newtonian drift");
 	assert(VELOCITY_CLEANUP_FULL > VELOCITY_CLEANUP_MIN);
 	
-	position = vector_add(position, vector_multiply_scalar(velocity, (float)delta_t));
+	[self setPosition:vector_add(position, vector_multiply_scalar(velocity, (float)delta_t))];
 	
 	GLfloat velmag = magnitude(velocity);
 	GLfloat velmag2 = velmag - (float)delta_t * thrust;
@@ -1736,8 +1740,8 @@ static bool minShieldLevelPercentageInitialised = false;
 			else  rate = (velmag - VELOCITY_CLEANUP_MIN) / (VELOCITY_CLEANUP_FULL - VELOCITY_CLEANUP_MIN) * VELOCITY_CLEANUP_RATE;
 			velmag2 -= velmag * rate;
 		}
-		if (velmag2 < 0.0f)  velocity = kZeroVector;
-		else  velocity = vector_multiply_scalar(velocity, velmag2 / velmag);
+		if (velmag2 < 0.0f)  [self setVelocity:kZeroVector];
+		else  [self setVelocity:vector_multiply_scalar(velocity, velmag2 / velmag)];
 		
 	}
 	
@@ -2127,7 +2131,7 @@ static bool minShieldLevelPercentageInitialised = false;
 - (void) moveForward:(double) amount
 {
 	distanceTravelled += (float)amount;
-	position = vector_add(position, vector_multiply_scalar(v_forward, (float)amount));
+	[self setPosition:vector_add(position, vector_multiply_scalar(v_forward, (float)amount))];
 }
 
 
@@ -3571,7 +3575,7 @@ static bool minShieldLevelPercentageInitialised = false;
 	[self adjustVelocity:launchVector];
 	
 	float sheight = (float)(boundingBox.max.y - boundingBox.min.y);
-	position = vector_subtract(position, vector_multiply_scalar(v_up, sheight));
+	[self setPosition:vector_subtract(position, vector_multiply_scalar(v_up, sheight))];
 	
 	//remove escape pod
 	[self removeEquipmentItem:@"EQ_ESCAPE_POD"];
@@ -4427,7 +4431,7 @@ static bool minShieldLevelPercentageInitialised = false;
 	[wormhole release];
 	wormhole = nil;
 
-	position = pos;
+	[self setPosition:pos];
 	[self setOrientation:[UNIVERSE getWitchspaceExitRotation]];
 	flightRoll = 0.0f;
 	flightPitch = 0.0f;
@@ -7436,9 +7440,9 @@ static NSString *last_outfitting_key=nil;
 
 - (BOOL) doWorldEventUntilMissionScreen:(jsid)message
 {
-	NSEnumerator	*scriptEnum = [worldScripts objectEnumerator];
-	OOScript		*theScript;
-
+	NSArray			*handlers = nil;
+	NSUInteger		i, count;
+	
 	// Check for the pressence of report messages first.
 	if (gui_screen != GUI_SCREEN_MISSION && [dockingReport length] > 0 && [self isDocked] && ![dockedStation suppressArrivalReports])
 	{
@@ -7448,10 +7452,12 @@ static NSString *last_outfitting_key=nil;
 	}
 	
 	JSContext *context = OOJSAcquireContext();
-	while ((theScript = [scriptEnum nextObject]) && gui_screen != GUI_SCREEN_MISSION && [self isDocked])
+	handlers = [[worldScriptHandlers scriptsHandlingEvent:message inContext:context] retain];
+	for (i = 0, count = [handlers count]; i < count && gui_screen != GUI_SCREEN_MISSION && [self isDocked]; i++)
 	{
-		[theScript callMethod:message inContext:context withArguments:NULL count:0 result:NULL];
+		[[handlers objectAtIndex:i] callMethod:message inContext:context withArguments:NULL count:0 result:NULL];
 	}
+	[handlers release];
 	OOJSRelinquishContext(context);
 	
 	if (gui_screen == GUI_SCREEN_MISSION)
@@ -7469,15 +7475,33 @@ static NSString *last_outfitting_key=nil;
 {
 	NSParameterAssert(context != NULL && JS_IsInRequest(context));
 	
-	NSEnumerator			*scriptEnum = nil;
+	NSArray					*handlers = nil;
 	OOScript				*theScript = nil;
 	
-	for (scriptEnum = [worldScripts objectEnumerator]; (theScript = [scriptEnum nextObject]); )
+	/*	Only scripts with a handler for the event are called. The list is
+		retained because a handler adding or deleting a property on its
+		script invalidates it.
+	*/
+	handlers = [[worldScriptHandlers scriptsHandlingEvent:message inContext:context] retain];
+	foreach (theScript, handlers)
 	{
 		OOJSStartTimeLimiterWithTimeLimit(limit);
 		[theScript callMethod:message inContext:context withArguments:argv count:argc result:NULL];
 		OOJSStopTimeLimiter();
 	}
+	[handlers release];
+}
+
+
+- (NSDictionary *) worldScriptEventStatistics
+{
+	return [worldScriptHandlers statistics];
+}
+
+
+- (void) resetWorldScriptEventStatistics
+{
+	[worldScriptHandlers resetStatistics];
 }
 
 
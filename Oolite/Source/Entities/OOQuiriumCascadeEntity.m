@@ -90,7 +90,7 @@ MA 02110-1301, USA.
 	
 	velocity.z = expansionSpeed;	// What's this for? Velocity is never applied. -- Ahruman 2011-02-05
 	
-	collision_radius += delta_t * expansionSpeed;		// expand
+	[self setCollisionRadius:collision_radius + delta_t * expansionSpeed];		// expand
 	energy = delta_t * (100000 - 90000 * tf);	// adjusted to take into account delta_t
 	
 	_color[3] = OOClamp_0_1_f(0.5f * ((0.025f / tf) + 1.0f - stf));
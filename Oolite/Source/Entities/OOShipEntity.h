@@ -351,6 +351,7 @@ typedef enum
 	OOShipEntity*				scanned_ships[MAX_SCAN_NUMBER + 1];
 	OOScalar				distance2_scanned_ships[MAX_SCAN_NUMBER + 1];
 	unsigned				n_scanned_ships;
+	NSUInteger				scannerGeneration;		// -[OOUniverse scannerGeneration] the scan is from, or 0.
 	
 	// advanced navigation
 	Vector					navpoints[32];
@@ -806,6 +807,8 @@ Vector positionOffsetForShipInRotationToAlignment(OOShipEntity* ship, Quaternion
 - (void) checkScanner;
 - (OOShipEntity**) scannedShips;
 - (int) numberOfScannedShips;
+// Called by -[OOUniverse updateShipScanners]; ships are nearest first.
+- (void) setScannedShips:(OOShipEntity **)ships distancesSquared:(const GLfloat *)distancesSquared count:(unsigned)count generation:(NSUInteger)generation;
 
 - (id) primaryAggressor;
 - (void) setPrimaryAggressor:(OOEntity *)targetEntity;
@@ -782,7 +782,7 @@ static OOShipEntity *doOctreesCollide(OOShipEntity *prime, OOShipEntity *other);
 	DESTROY(subEntities);
 	
 	// reset size & mass!
-	collision_radius = [self findCollisionRadius];
+	[self setCollisionRadius:[self findCollisionRadius]];
 	_profileRadius = collision_radius;
 	[self calculateMass];
 }
@@ -1573,7 +1573,7 @@ OOShipEntity* doOctreesCollide(OOShipEntity* prime, OOShipEntity* other)
 	{
 		if (distance > collision_radius)
 		{
-			collision_radius = distance;
+			[self setCollisionRadius:distance];
 		}
 		
 		mass += [subent mass];
@@ -1886,7 +1886,7 @@ OOShipEntity* doOctreesCollide(OOShipEntity* prime, OOShipEntity* other)
 		[self applyRoll: delta_t * flightRoll andClimb: delta_t * flightPitch];
 		GLfloat range2 = 0.1 * distance2(position, destination) / (collision_radius * collision_radius);
 		if ((range2 > 1.0)||(velocity.z > 0.0))	range2 = 1.0;
-		position = vector_add(position, vector_multiply_scalar(velocity, range2 * delta_t));
+		[self setPosition:vector_add(position, vector_multiply_scalar(velocity, range2 * delta_t))];
 	}
 	else
 	{
@@ -2955,25 +2955,20 @@ OOShipEntity* doOctreesCollide(OOShipEntity* prime, OOShipEntity* other)
 		// adjust for difference in velocity (spring rule)
 		Vector dv = vector_between([self velocity], [hauler velocity]);
 		GLfloat moment = delta_t * 0.25 * tf;
-		velocity.x += moment * dv.x;
-		velocity.y += moment * dv.y;
-		velocity.z += moment * dv.z;
+		Vector vel = vector_add(velocity, vector_multiply_scalar(dv, moment));
 		// acceleration = force / mass
 		// force proportional to distance (spring rule)
 		Vector dp = vector_between(position, destination);
 		moment = delta_t * 0.5 * tf;
-		velocity.x += moment * dp.x;
-		velocity.y += moment * dp.y;
-		velocity.z += moment * dp.z;
+		vel = vector_add(vel, vector_multiply_scalar(dp, moment));
 		// force inversely proportional to distance
 		GLfloat d2 = magnitude2(dp);
 		moment = (d2 > 0.0)? delta_t * 5.0 * tf / d2 : 0.0;
 		if (d2 > 0.0)
 		{
-			velocity.x += moment * dp.x;
-			velocity.y += moment * dp.y;
-			velocity.z += moment * dp.z;
+			vel = vector_add(vel, vector_multiply_scalar(dp, moment));
 		}
+		[self setVelocity:vel];
 		//
 		if ([self status] == STATUS_BEING_SCOOPED)
 		{
@@ -6452,8 +6447,32 @@ Vector positionOffsetForShipInRotationToAlignment(OOShipEntity* ship, Quaternion
 
 - (void) checkScanner
 {
+	// The universe scans for every ship at once, once a frame, if it can. Otherwise, walk the z-ordered list.
+	if ([UNIVERSE updateShipScanners])
+	{
+		if (scannerGeneration == [UNIVERSE scannerGeneration])
+		{
+			// Drop ships removed from the universe since the scan.
+			unsigned i, kept = 0;
+			for (i = 0; i < n_scanned_ships; i++)
+			{
+				if (scanned_ships[i]->stateSlot == kOOEntityStateNoSlot)  continue;
+				scanned_ships[kept] = scanned_ships[i];
+				distance2_scanned_ships[kept] = distance2_scanned_ships[i];
+				kept++;
+			}
+			n_scanned_ships = kept;
+			scanned_ships[n_scanned_ships] = nil;	// terminate array
+			return;
+		}
+		
+		// Added since the scan.
+		if ([UNIVERSE updateScannerForShip:self])  return;
+	}
+	
 	OOEntity* scan;
 	n_scanned_ships = 0;
+	scannerGeneration = 0;
 	//
 	scan = z_previous;	while ((scan)&&(scan->isShip == NO))	scan = scan->z_previous;	// skip non-ships
 	while ((scan)&&(scan->position.z > position.z - scannerRange)&&(n_scanned_ships < MAX_SCAN_NUMBER))
@@ -6483,6 +6502,22 @@ Vector positionOffsetForShipInRotationToAlignment(OOShipEntity* ship, Quaternion
 }
 
 
+- (void) setScannedShips:(OOShipEntity **)ships distancesSquared:(const GLfloat *)distancesSquared count:(unsigned)count generation:(NSUInteger)generation
+{
+	unsigned i;
+	
+	count = MIN(count, (unsigned)MAX_SCAN_NUMBER);
+	for (i = 0; i < count; i++)
+	{
+		scanned_ships[i] = ships[i];
+		distance2_scanned_ships[i] = distancesSquared[i];
+	}
+	n_scanned_ships = count;
+	scanned_ships[n_scanned_ships] = nil;	// terminate array
+	scannerGeneration = generation;
+}
+
+
 - (OOShipEntity**) scannedShips
 {
 	scanned_ships[n_scanned_ships] = nil;	// terminate array
@@ -8240,7 +8275,7 @@ Vector positionOffsetForShipInRotationToAlignment(OOShipEntity* ship, Quaternion
 	v_eject.z += (randf() - randf())/eject_speed;
 	
 	vel = vector_add(vector_multiply_scalar(v_forward, flightSpeed), vector_multiply_scalar(v_eject, eject_speed));
-	velocity = vector_add(velocity, vector_multiply_scalar(v_eject, eject_reaction));
+	[self setVelocity:vector_add(velocity, vector_multiply_scalar(v_eject, eject_reaction))];
 	
 	[jetto setPosition:rpos];
 	if ([jetto crew]) // jetto has a crew, so assume it is an escape pod.
@@ -8377,7 +8412,7 @@ Vector positionOffsetForShipInRotationToAlignment(OOShipEntity* ship, Quaternion
 		if (v2b < -1.0f)  return NO;
 		else
 		{
-			position = vector_subtract(position, loc);	// adjust self position
+			[self setPosition:vector_subtract(position, loc)];	// adjust self position
 			v = kZeroVector;	// go for the 1m/s solution
 		}
 	}
@@ -8483,13 +8518,13 @@ Vector positionOffsetForShipInRotationToAlignment(OOShipEntity* ship, Quaternion
 
 - (void) adjustVelocity:(Vector) xVel
 {
-	velocity = vector_add(velocity, xVel);
+	[self setVelocity:vector_add(velocity, xVel)];
 }
 
 
 - (void) addImpactMoment:(Vector) moment fraction:(GLfloat) howmuch
 {
-	velocity = vector_add(velocity, vector_multiply_scalar(moment, howmuch / mass));
+	[self setVelocity:vector_add(velocity, vector_multiply_scalar(moment, howmuch / mass))];
 }
 
 
@@ -9085,10 +9120,7 @@ Vector positionOffsetForShipInRotationToAlignment(OOShipEntity* ship, Quaternion
 		d1 = SCANNER_MAX_RANGE * (randf() - randf());
 	}
 	
-	position = [UNIVERSE getWitchspaceExitPosition];
-	position.x += v1.x * d1; // randomise exit position
-	position.y += v1.y * d1;
-	position.z += v1.z * d1;
+	[self setPosition:vector_add([UNIVERSE getWitchspaceExitPosition], vector_multiply_scalar(v1, d1))];	// randomise exit position
 	[self witchspaceLeavingEffects];
 }
 
@@ -9912,6 +9944,7 @@ static BOOL AuthorityPredicate(OOEntity *entity, void *parameter)
 - (void) sendCoordinatesToPilot
 {
 	n_scanned_ships = 0;
+	scannerGeneration = 0;
 	OOEntity *scan = z_previous;
 	OOLog(@"ship.pilotage", @"searching for pilot boat");
 	while (scan &&(scan->isShip == NO))
@@ -162,7 +162,7 @@ MA 02110-1301, USA.
 {
 	OOPlayerShipEntity *player = PLAYER;
 	zero_distance = MAX_CLEAR_DEPTH * MAX_CLEAR_DEPTH;
-	if (player != nil)  position = player->position;
+	if (player != nil)  [self setPosition:player->position];
 }
 
 
@@ -59,6 +59,12 @@ MA 02110-1301, USA.
 }
 
 
+- (BOOL) canUpdateConcurrently
+{
+	return YES;
+}
+
+
 - (void) update:(OOTimeDelta)delta_t
 {
 	[super update:delta_t];
@@ -68,7 +74,7 @@ MA 02110-1301, USA.
 
 - (void) performUpdate:(OOTimeDelta)delta_t
 {
-	position = vector_add(position, vector_multiply_scalar(velocity, delta_t));
+	[self setPosition:vector_add(position, vector_multiply_scalar(velocity, delta_t))];
 	_timeRemaining -= delta_t;
 	
 	float mix = OOClamp_0_1_f(_timeRemaining / _duration);
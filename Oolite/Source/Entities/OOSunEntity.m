@@ -147,7 +147,7 @@ MA 02110-1301, USA.
 	
 	self = [super init];
 	
-	collision_radius = 100000.0; //  100km across
+	[self setCollisionRadius:100000.0]; //  100km across
 	
 	scanClass = CLASS_NO_DRAW;
 	
@@ -229,7 +229,7 @@ MA 02110-1301, USA.
 	{
 		if (velocity.x >= 0.0)	// countdown
 		{
-			velocity.x -= delta_t;
+			[self setVelocity:make_vector(velocity.x - delta_t, velocity.y, velocity.z)];
 			if (corona_speed_factor < 5.0)
 			{
 				corona_speed_factor += 0.75 * delta_t;
@@ -261,14 +261,14 @@ MA 02110-1301, USA.
 					OOLog(@"sun.nova.start", @"DEBUG: NOVA original radius %.1f", collision_radius);
 				}
 				discColor[0] = 1.0;	discColor[1] = 1.0;	discColor[2] = 1.0;
-				velocity.y += delta_t;
+				[self setVelocity:make_vector(velocity.x, velocity.y + delta_t, velocity.z)];
 				[self setRadius: collision_radius + delta_t * velocity.z];
 			}
 			else
 			{
 				OOLog(@"sun.nova.end", @"DEBUG: NOVA final radius %.1f", collision_radius);
 				// reset at the new size
-				velocity = kZeroVector;
+				[self setVelocity:kZeroVector];
 				throw_sparks = YES;	// keep throw_sparks at YES to indicate the higher temperature
 			}
 		}
@@ -466,13 +466,13 @@ MA 02110-1301, USA.
 	{
 		oldRadius =	[object doubleValue];	// clamp corona_flare in case planetinfo.plist / savegame contains the wrong value
 		[self setRadius: oldRadius + (0.66*MAX_CORONAFLARE * OOClamp_0_1_f([dict oo_floatForKey:@"corona_flare" defaultValue:0.0f]))];
-		collision_radius = oldRadius;								
+		[self setCollisionRadius:oldRadius];
 	}
 	else if ([key isEqualToString:@"corona_flare"])
 	{
 		double rad = collision_radius;
 		[self setRadius: rad + (0.66*MAX_CORONAFLARE * OOClamp_0_1_f([object floatValue]))];
-		collision_radius = rad;
+		[self setCollisionRadius:rad];
 	}
 	else if ([key isEqualToString:@"corona_shimmer"])
 	{
@@ -494,7 +494,7 @@ MA 02110-1301, USA.
 			[self setGoingNova:NO inTime:0];
 			// oldRadius is always the radius we had before going nova...
 			[self setRadius: oldRadius + (0.66*MAX_CORONAFLARE * OOClamp_0_1_f([dict oo_floatForKey:@"corona_flare" defaultValue:0.0f]))];
-			collision_radius = oldRadius;
+			[self setCollisionRadius:oldRadius];
 
 		}
 	}
@@ -535,7 +535,7 @@ MA 02110-1301, USA.
 
 - (void) setRadius:(double) rad
 {
-	collision_radius = rad;
+	[self setCollisionRadius:rad];
 	cor4k =		rad * 4 / 100;				lim4k =		cor4k	* cor4k	* NO_DRAW_DISTANCE_FACTOR*NO_DRAW_DISTANCE_FACTOR;
 	cor8k =		rad * 8 / 100;				lim8k =		cor8k	* cor8k	* NO_DRAW_DISTANCE_FACTOR*NO_DRAW_DISTANCE_FACTOR;
 	cor16k =	rad * rad * 16/ 10000000;	lim16k =	cor16k	* cor16k* NO_DRAW_DISTANCE_FACTOR*NO_DRAW_DISTANCE_FACTOR;
@@ -563,15 +563,16 @@ MA 02110-1301, USA.
 
 - (void) setGoingNova:(BOOL) yesno inTime:(double)interval
 {
+	// velocity holds the nova countdown, expansion time and expansion rate.
+	double countdown = velocity.x;
 	throw_sparks = yesno;
 	if (throw_sparks)
 	{
-		velocity.x = fmax(interval, 0.0);
-		OOLog(@"script.debug.setSunNovaIn", @"NOVA activated! time until Nova : %.1f s", velocity.x);
+		countdown = fmax(interval, 0.0);
+		OOLog(@"script.debug.setSunNovaIn", @"NOVA activated! time until Nova : %.1f s", countdown);
 	}
 	
-	velocity.y = 0;
-	velocity.z = 10000;
+	[self setVelocity:make_vector(countdown, 0, 10000)];
 }
 
 
@@ -56,7 +56,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 	{
 		witch_mass = 0.0;
 		shipsInTransit = [[NSMutableArray arrayWithCapacity:4] retain];
-		collision_radius = 0.0;
+		[self setCollisionRadius:0.0];
 		[self setStatus:STATUS_EFFECT];
 		scanClass = CLASS_WORMHOLE;
 		isWormhole = YES;
@@ -168,7 +168,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 			shrink_factor = 1;
 		}
 		
-		collision_radius = 0.5 * M_PI * pow(witch_mass, 1.0/3.0);
+		[self setCollisionRadius:0.5 * M_PI * pow(witch_mass, 1.0/3.0)];
 		expiry_time = now + (witch_mass / WORMHOLE_SHRINK_RATE / shrink_factor);
 		travel_time = OOHOURS(distance * distance);
 		arrival_time = now + travel_time;
@@ -242,7 +242,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 									@"shipBeacon", [ship beaconCode])];
 	witch_mass += [ship mass];
 	expiry_time = now + (witch_mass / WORMHOLE_SHRINK_RATE / shrink_factor);
-	collision_radius = 0.5 * M_PI * pow(witch_mass, 1.0/3.0);
+	[self setCollisionRadius:0.5 * M_PI * pow(witch_mass, 1.0/3.0)];
 
 	[UNIVERSE addWitchspaceJumpEffectForShip:ship];
 	
@@ -283,7 +283,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 			// Only calculate exit position once so that all ships arrive from the same point
 			if (!hasExitPosition)
 			{
-				position = [UNIVERSE getWitchspaceExitPosition];	// no need to reset PRNG.
+				Vector			exitPosition = [UNIVERSE getWitchspaceExitPosition];	// no need to reset PRNG.
 				double			d1 = SCANNER_MAX_RANGE*((ranrot_rand() % 256)/256.0 - 0.5);
 				const double	minD = 750.0;
 				Quaternion		q1;
@@ -296,7 +296,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 				}
 				
 				// randomise exit position
-				position = vector_add(position, vector_multiply_scalar(v1, d1));
+				[self setPosition:vector_add(exitPosition, vector_multiply_scalar(v1, d1))];
 			}
 			[ship setPosition:position];
 			
@@ -333,7 +333,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 			{
 				hasExitPosition = YES;
 				[ship update: time_passed]; // do this only for one ship or the next ships might appear at very different locations.
-				position = [ship position]; // e.g. when the player fist docks before following, time_passed is already > 10 minutes.
+				[self setPosition:[ship position]]; // e.g. when the player fist docks before following, time_passed is already > 10 minutes.
 			}
 			else if (now - ship_arrival_time > 1) // Only update the ship position if it was some time ago, otherwise we're in 'real time'.
 			{
@@ -502,7 +502,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 		witch_mass -= WORMHOLE_SHRINK_RATE * delta_t * shrink_factor;
 		if (witch_mass < 0.0)
 			witch_mass = 0.0;
-		collision_radius = 0.5 * M_PI * pow(witch_mass, 1.0/3.0);
+		[self setCollisionRadius:0.5 * M_PI * pow(witch_mass, 1.0/3.0)];
 		no_draw_distance = collision_radius * collision_radius * NO_DRAW_DISTANCE_FACTOR * NO_DRAW_DISTANCE_FACTOR;
 	}
 
@@ -511,7 +511,7 @@ static void DrawWormholeCorona(GLfloat inner_radius, GLfloat outer_radius, int s
 	if (now > expiry_time)
 	{
 		//position.x = position.y = position.z = 0;
-		position = kZeroVector;
+		[self setPosition:kZeroVector];
 		[UNIVERSE removeEntity: self];
 	}
 }
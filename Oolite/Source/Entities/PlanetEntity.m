@@ -312,9 +312,9 @@ static const BaseFace kTexturedFaces[][3] =
 	orientation = [planet orientation];
 	
 	if (planet->planet_type == STELLAR_TYPE_NORMAL_PLANET)
-		collision_radius = planet->collision_radius + ATMOSPHERE_DEPTH; //  atmosphere is 500m deep only
+		[self setCollisionRadius:planet->collision_radius + ATMOSPHERE_DEPTH]; //  atmosphere is 500m deep only
 	if (planet->planet_type == STELLAR_TYPE_MINIATURE)
-		collision_radius = planet->collision_radius + ATMOSPHERE_DEPTH * PLANET_MINIATURE_FACTOR*2.0; //not to scale: invisible otherwise
+		[self setCollisionRadius:planet->collision_radius + ATMOSPHERE_DEPTH * PLANET_MINIATURE_FACTOR*2.0]; //not to scale: invisible otherwise
 	
 	shuttles_on_ground = 0;
 	last_launch_time = 0.0;
@@ -362,11 +362,11 @@ static const BaseFace kTexturedFaces[][3] =
 	last_launch_time = 0.0;
 	shuttle_launch_interval = OOHOURS(1.0);
 	[self setStatus:STATUS_COCKPIT_DISPLAY];
-	collision_radius = [self collisionRadius] * PLANET_MINIATURE_FACTOR; // teeny tiny
+	[self setCollisionRadius:[self collisionRadius] * PLANET_MINIATURE_FACTOR]; // teeny tiny
 	[self scaleVertices];
 	if (atmosphere != nil)
 	{
-		atmosphere->collision_radius = collision_radius + ATMOSPHERE_DEPTH * PLANET_MINIATURE_FACTOR*2.0; //not to scale: invisible otherwise
+		[atmosphere setCollisionRadius:collision_radius + ATMOSPHERE_DEPTH * PLANET_MINIATURE_FACTOR*2.0]; //not to scale: invisible otherwise
 		[atmosphere scaleVertices];
 	}
 	rotational_velocity = 0.04;
@@ -438,7 +438,7 @@ static const BaseFace kTexturedFaces[][3] =
 
 	last_launch_time = OOSECONDS(30.0) - shuttle_launch_interval;   // debug - launch 30s after player enters universe
 
-	collision_radius = radius_km * 10.0; // scale down by a factor of 100 !
+	[self setCollisionRadius:radius_km * 10.0]; // scale down by a factor of 100 !
 	
 	scanClass = CLASS_NO_DRAW;
 	
@@ -717,7 +717,7 @@ static const BaseFace kTexturedFaces[][3] =
 
 - (void) setPosition:(Vector)posn
 {
-	position = posn;
+	[super setPosition:posn];
 	[atmosphere setPosition:posn];
 }
 
@@ -1076,7 +1076,7 @@ static const BaseFace kTexturedFaces[][3] =
 
 - (void) setRadius:(double) rad
 {
-	collision_radius = rad;
+	[self setCollisionRadius:rad];
 }
 
 - (double) rotationalVelocity
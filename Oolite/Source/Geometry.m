@@ -26,6 +26,16 @@ MA 02110-1301, USA.
 #import "Octree.h"
 
 
+/*	Octrees for different models may be built on several threads at once, so
+	the leaf count is kept per build rather than in a static.
+*/
+@interface Geometry (OOPrivate)
+
+- (id) priv_octreeWithinRadius:(GLfloat)octreeRadius toDepth:(int)depth leafCount:(int *)ioLeafCount;
+
+@end
+
+
 @implementation Geometry
 
 - (NSString *) descriptionComponents
@@ -171,17 +181,14 @@ MA 02110-1301, USA.
 	return result;
 }
 
-static int leafcount;
-static float volumecount;
 - (Octree*) findOctreeToDepth: (int) depth
 {
 	//
-	leafcount = 0;
-	volumecount = 0.0f;
+	int leafcount = 0;
 	//
 	GLfloat foundRadius = 0.5f + [self findMaxDimensionFromOrigin];	// pad out from geometry by a half meter
 	//	
-	NSObject* foundOctree = [self octreeWithinRadius:foundRadius toDepth:depth];
+	NSObject* foundOctree = [self priv_octreeWithinRadius:foundRadius toDepth:depth leafCount:&leafcount];
 	//
 	Octree*	octreeRepresentation = [[Octree alloc] initWithRepresentationOfOctree:foundRadius :foundOctree :leafcount];
 	//
@@ -189,21 +196,26 @@ static float volumecount;
 }
 
 - (id) octreeWithinRadius:(GLfloat)octreeRadius toDepth:(int)depth
+{
+	int leafcount = 0;
+	return [self priv_octreeWithinRadius:octreeRadius toDepth:depth leafCount:&leafcount];
+}
+
+- (id) priv_octreeWithinRadius:(GLfloat)octreeRadius toDepth:(int)depth leafCount:(int *)ioLeafCount
 {
 	//
 	GLfloat offset = 0.5f * octreeRadius;
 	//
 	if (![self testHasGeometry])
 	{
-		leafcount++;	// nil or zero or 0
+		(*ioLeafCount)++;	// nil or zero or 0
 		return [NSNumber numberWithBool:NO];	// empty octree
 	}
 	// there is geometry!
 	//
 	if ((octreeRadius <= OCTREE_MIN_RADIUS)||(depth <= 0))	// maximum resolution
 	{
-		leafcount++;	// partially full or -1
-		volumecount += octreeRadius * octreeRadius * octreeRadius * 0.5f;
+		(*ioLeafCount)++;	// partially full or -1
 		return [NSNumber numberWithBool:YES];	// at least partially full octree
 	}
 	//
@@ -214,8 +226,7 @@ static float volumecount;
 	{
 		if ([self testCornersWithinGeometry: octreeRadius])	// all eight corners inside or on!
 		{
-			leafcount++;	// full or -1
-			volumecount += octreeRadius * octreeRadius * octreeRadius;
+			(*ioLeafCount)++;	// full or -1
 			return [NSNumber numberWithBool:YES];	// full octree
 		}
 	}
@@ -279,16 +290,16 @@ static float volumecount;
 	[g_xx0 release];
 	[g_xx1 release];
 	
-	leafcount++;	// pointer to array
+	(*ioLeafCount)++;	// pointer to array
 	NSObject* result = [NSArray arrayWithObjects:
-		[g_000 octreeWithinRadius: offset toDepth:depth - 1],
-		[g_001 octreeWithinRadius: offset toDepth:depth - 1],
-		[g_010 octreeWithinRadius: offset toDepth:depth - 1],
-		[g_011 octreeWithinRadius: offset toDepth:depth - 1],
-		[g_100 octreeWithinRadius: offset toDepth:depth - 1],
-		[g_101 octreeWithinRadius: offset toDepth:depth - 1],
-		[g_110 octreeWithinRadius: offset toDepth:depth - 1],
-		[g_111 octreeWithinRadius: offset toDepth:depth - 1],
+		[g_000 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
+		[g_001 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
+		[g_010 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
+		[g_011 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
+		[g_100 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
+		[g_101 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
+		[g_110 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
+		[g_111 priv_octreeWithinRadius: offset toDepth:depth - 1 leafCount:ioLeafCount],
 		nil];
 	[g_000 release];
 	[g_001 release];
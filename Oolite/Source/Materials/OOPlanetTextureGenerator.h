@@ -92,4 +92,19 @@ typedef struct OOPlanetTextureGeneratorInfo
 + (BOOL) generatePlanetTexture:(OOTexture **)texture secondaryTexture:(OOTexture **)secondaryTexture withInfo:(NSDictionary *)planetInfo;
 + (BOOL) generatePlanetTexture:(OOTexture **)texture secondaryTexture:(OOTexture **)secondaryTexture andAtmosphere:(OOTexture **)atmosphere withInfo:(NSDictionary *)planetInfo;
 
+#ifndef NDEBUG
+/*	For OOPlanetTextureBenchmark: generate textures of size x size pixels
+	synchronously, optionally single-threaded and/or with the scalar kernels,
+	into malloced buffers owned by the caller. outNormals and outAtmosphere
+	may be NULL. In the test rig, parallel has no effect.
+*/
++ (NSString *) benchmarkKernelName;
+- (BOOL) generateBenchmarkTexturesWithSize:(unsigned)size
+								  parallel:(BOOL)parallel
+								vectorized:(BOOL)vectorized
+								   diffuse:(uint8_t **)outDiffuse
+								   normals:(uint8_t **)outNormals
+								atmosphere:(uint8_t **)outAtmosphere;
+#endif
+
 @end
@@ -42,6 +42,8 @@
 #import "OOColor.h"
 #import "OOTexture.h"
 #import "OOUniverse.h"
+#import "OOAsyncWorkManager.h"
+#import "OOCPUInfo.h"
 #endif
 
 #if DEBUG_DUMP
@@ -49,24 +51,135 @@
 #endif
 
 
+/*	x86 kernels are compiled with per-function target attributes and only
+	used if OOCPUGetFeatures() says so, as in OOPixMapScaling.m. The test rig
+	has no OOCPUInfo, so there they're used if the compiler targets them.
+*/
+#if (defined(__i386__) || defined(__x86_64__)) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define OO_PLANET_TEXTURE_X86	1
+#include <immintrin.h>
+#else
+#define OO_PLANET_TEXTURE_X86	0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define OO_PLANET_TEXTURE_NEON	1
+#include <arm_neon.h>
+#else
+#define OO_PLANET_TEXTURE_NEON	0
+#endif
+
+
 #define FREE(x) do { if (0) { void *x__ = x; x__ = x__; } /* Preceeding is for type checking only. */ void **x_ = (void **)&(x); free(*x_); *x_ = NULL; } while (0)
 
 
 #define PLANET_TEXTURE_OPTIONS	(kOOTextureMinFilterLinear | kOOTextureMagFilterLinear | kOOTextureRepeatS | kOOTextureNoShrink)
 
+#define PLANET_TEXTURE_MAX_WORKERS		7		// Plus the generating thread.
+
 
 enum
 {
-	kRandomBufferSize		= 128
+	kRandomBufferSize		= 128,
+	
+	kTilePixels				= 1 << 16		// Rows per tile is this divided by width, so a 1024x1024 texture has 16 tiles.
 };
 
 
+#if !PERLIN_3D
+/*	One octave of 2D value noise. ix, jx and qx depend only on x, so they're
+	calculated once for the whole texture. ix and jx are constant over runs of
+	cellWidth pixels. The first row uses the unsmoothed fractions in linearQx,
+	as the single-pass generator did.
+*/
+typedef struct
+{
+	float							rr;			// octave / width
+	unsigned						octaveMask;
+	float							scale;
+	unsigned						cellWidth;
+	int								*ix;
+	int								*jx;
+	float							*qx;
+	float							*linearQx;
+} OOPlanetNoiseOctave;
+#endif
+
+
+/*	Row kernels. The scalar versions are exactly the per-pixel code of the
+	original single-threaded generator; the SIMD versions do the same
+	operations four or eight pixels at a time.
+*/
+typedef struct
+{
+	const char						*name;
+#if !PERLIN_3D
+	void							(*addNoiseRow)(float *dst, const OOPlanetNoiseOctave *octave, const float *row0, const float *row1, float qy, unsigned count);
+#endif
+	void							(*qFactorRow)(float *dst, const float *fbm, unsigned count, float bias, float polarFactor, float polarTerm);
+	void							(*normalRow)(const float *q, const float *north, const float *south, float *nx, float *ny, float *nz, unsigned count, float normalScale);
+} OOPlanetTextureKernels;
+
+
+/*	Everything the tiles need. Tiles only write to their own rows of the
+	buffers, and only read what earlier phases have finished writing, so
+	there's no locking; failed is only ever set to YES.
+*/
+typedef struct
+{
+	OOPlanetTextureGeneratorInfo	*info;
+	const OOPlanetTextureKernels	*kernels;
+	
+#if PERLIN_3D
+	float							*latitudes;
+#else
+	float							*randomBuffer;
+	OOPlanetNoiseOctave				*octaves;
+	unsigned						octaveCount;
+	void							*octaveTables;
+#endif
+	
+	float							rHeight;
+	float							fHeight;
+	float							poleValue;
+	float							seaBias;
+	float							paleClouds;
+	float							normalScale;
+	FloatRGBA						cloudColor;
+	
+	uint8_t							*diffuse;
+	uint8_t							*normals;		// NULL if not generating a normal map.
+	uint8_t							*atmosphere;	// NULL if not generating an atmosphere.
+	
+	volatile BOOL					failed;
+} OOPlanetTextureJob;
+
+
+typedef void (*OOPlanetTextureTileFunction)(OOPlanetTextureJob *job, unsigned firstRow, unsigned endRow);
+
+
+// A tile function run over all rows of a texture, a tile at a time.
+typedef struct
+{
+	OOPlanetTextureJob				*job;
+	OOPlanetTextureTileFunction		function;
+	unsigned						rowCount;
+	unsigned						tileRows;
+} OOPlanetTextureTileRun;
+
+
 @interface OOPlanetTextureGenerator (Private)
 
 - (NSString *) cacheKeyForType:(NSString *)type;
 - (OOTextureGenerator *) normalMapGenerator;	// Must be called before generator is enqueued for rendering.
 - (OOTextureGenerator *) atmosphereGenerator;	// Must be called before generator is enqueued for rendering.
 
+- (BOOL) generateDiffuse:(uint8_t **)outDiffuse
+				 normals:(uint8_t **)outNormals
+			  atmosphere:(uint8_t **)outAtmosphere
+				 kernels:(const OOPlanetTextureKernels *)kernels
+				parallel:(BOOL)parallel;
+
 #if DEBUG_DUMP_RAW
 - (void) dumpNoiseBuffer:(float *)noise;
 #endif
@@ -110,10 +223,18 @@ enum
 
 static FloatRGB FloatRGBFromDictColor(NSDictionary *dictionary, NSString *key);
 
-static BOOL FillFBMBuffer(OOPlanetTextureGeneratorInfo *info);
+static BOOL PrepareFBMNoise(OOPlanetTextureJob *job);
+static void GenerateFBMNoiseRow(OOPlanetTextureJob *job, unsigned y);
+static void DisposeFBMNoise(OOPlanetTextureJob *job);
+
+static BOOL RunTiles(OOPlanetTextureJob *job, OOPlanetTextureTileFunction function, BOOL parallel);
+static void NoiseTile(OOPlanetTextureJob *job, unsigned firstRow, unsigned endRow);
+static void MixTile(OOPlanetTextureJob *job, unsigned firstRow, unsigned endRow);
+
+static const OOPlanetTextureKernels *ScalarKernels(void);
+static const OOPlanetTextureKernels *BestKernels(void);
 
 static float QFactor(float *accbuffer, int x, int y, unsigned width, float polar_y_value, float bias, float polar_y);
-static float GetQ(float *qbuffer, unsigned x, unsigned y, unsigned width, unsigned height, unsigned widthMask, unsigned heightMask);
 
 static FloatRGB Blend(float fraction, FloatRGB a, FloatRGB b);
 static void SetMixConstants(OOPlanetTextureGeneratorInfo *info, float temperatureFraction);
@@ -364,14 +485,74 @@ enum
 {
 	OOLog(@"planetTex.temp", @"Started generator %@", self);
 	
-	BOOL success = NO;
 	BOOL generateNormalMap = (_nMapGenerator != nil);
 	BOOL generateAtmosphere = (_atmoGenerator != nil);
 	
-	uint8_t		*buffer = NULL, *px = NULL;
-	uint8_t		*nBuffer = NULL, *npx = NULL;
-	uint8_t		*aBuffer = NULL, *apx = NULL;
-	float		*randomBuffer = NULL;
+	uint8_t		*buffer = NULL, *nBuffer = NULL, *aBuffer = NULL;
+	
+	BOOL success = [self generateDiffuse:&buffer
+								 normals:generateNormalMap ? &nBuffer : NULL
+							  atmosphere:generateAtmosphere ? &aBuffer : NULL
+								 kernels:BestKernels()
+								parallel:YES];
+	
+#if DEBUG_DUMP_RAW
+	if (success)  [self dumpNoiseBuffer:_info.fbmBuffer];
+#endif
+	FREE(_info.fbmBuffer);
+	FREE(_info.qBuffer);
+	
+	if (success)
+	{
+		data = buffer;
+		format = kOOTextureDataRGBA;
+		if (generateNormalMap) [_nMapGenerator completeWithData:nBuffer width:width height:height];
+		if (generateAtmosphere) [_atmoGenerator completeWithData:aBuffer width:width height:height];
+	}
+	DESTROY(_nMapGenerator);
+	DESTROY(_atmoGenerator);
+	
+	OOLog(@"planetTex.temp", @"Completed generator %@ %@successfully", self, success ? @"" : @"un");
+	
+#if DEBUG_DUMP
+	if (success)
+	{
+		NSString *diffuseName = [NSString stringWithFormat:@"planet-%u-%u-diffuse-new", _info.seed.high, _info.seed.low];
+		NSString *lightsName = [NSString stringWithFormat:@"planet-%u-%u-lights-new", _info.seed.high, _info.seed.low];
+		
+		[[UNIVERSE gameView] dumpRGBAToRGBFileNamed:diffuseName
+								   andGrayFileNamed:lightsName
+											  bytes:buffer
+											  width:width
+											 height:height
+										   rowBytes:width * 4];
+	}
+#endif
+}
+
+
+/*	Generate the textures into new buffers. The work is split into tiles of
+	rows, in two phases: first the fBM noise and q factor of each row, then,
+	once all of q is available (normals depend on the rows above and below),
+	the colours. Each row is calculated exactly as the single-threaded
+	generator did, so the result doesn't depend on the tiling or on which
+	thread does what.
+	
+	_info.fbmBuffer and _info.qBuffer are left for the caller to free, so the
+	noise can be dumped for debugging.
+*/
+- (BOOL) generateDiffuse:(uint8_t **)outDiffuse
+				 normals:(uint8_t **)outNormals
+			  atmosphere:(uint8_t **)outAtmosphere
+				 kernels:(const OOPlanetTextureKernels *)kernels
+				parallel:(BOOL)parallel
+{
+	BOOL success = NO;
+	OOPlanetTextureJob job;
+	
+	memset(&job, 0, sizeof job);
+	job.info = &_info;
+	job.kernels = kernels;
 	
 	height = _info.height = 1 << (_planetScale + kPlanetScaleOffset);
 	width = _info.width = height * kPlanetAspectRatio;
@@ -379,33 +560,30 @@ enum
 #define FAIL_IF(cond)  do { if (EXPECT_NOT(cond))  goto END; } while (0)
 #define FAIL_IF_NULL(x)  FAIL_IF((x) == NULL)
 	
-	buffer = malloc(4 * width * height);
-	FAIL_IF_NULL(buffer);
-	px = buffer;
+	job.diffuse = malloc(4 * width * height);
+	FAIL_IF_NULL(job.diffuse);
 	
-	if (generateNormalMap)
+	if (outNormals != NULL)
 	{
-		nBuffer = malloc(4 * width * height);
-		FAIL_IF_NULL(nBuffer);
-		npx = nBuffer;
+		job.normals = malloc(4 * width * height);
+		FAIL_IF_NULL(job.normals);
 	}
 	
-	if (generateAtmosphere)
+	if (outAtmosphere != NULL)
 	{
-		aBuffer = malloc(4 * width * height);
-		FAIL_IF_NULL(aBuffer);
-		apx = aBuffer;
+		job.atmosphere = malloc(4 * width * height);
+		FAIL_IF_NULL(job.atmosphere);
 	}
 	
-	FAIL_IF(!FillFBMBuffer(&_info));
-#if DEBUG_DUMP_RAW
-	[self dumpNoiseBuffer:_info.fbmBuffer];
-#endif
+	_info.qBuffer = malloc(width * height * sizeof (float));
+	FAIL_IF_NULL(_info.qBuffer);
 	
-	//TODO: sort out CloudMix
-	float paleClouds = (_info.cloudFraction * _info.fbmBuffer[0] < 1.0f - _info.cloudFraction) ? 0.0f : 1.0f;
-	float poleValue = (_info.landFraction > 0.5f) ? 0.5f * _info.landFraction : 0.0f;
-	float seaBias = _info.landFraction - 1.0f;
+	FAIL_IF(!PrepareFBMNoise(&job));
+	
+	job.poleValue = (_info.landFraction > 0.5f) ? 0.5f * _info.landFraction : 0.0f;
+	job.seaBias = _info.landFraction - 1.0f;
+	job.rHeight = 1.0f / height;
+	job.fHeight = height;
 	
 	/*	The system key 'polar_sea_colour' was used as 'paleSeaColour'.
 		The generated texture had presumably iceberg covered shallows.
@@ -415,153 +593,43 @@ enum
 		-- Kaks
 	*/
 	_info.paleSeaColor = Blend(0.45f, _info.polarSeaColor, Blend(0.7f, _info.seaColor, _info.landColor));
-	float normalScale = 1 << _planetScale;
-	if (!generateNormalMap)  normalScale *= 3.0f;
+	job.normalScale = 1 << _planetScale;
+	if (job.normals == NULL)  job.normalScale *= 3.0f;
 	
 	// Deep sea colour: slightly darkened so the sea isn't just a uniform colour.
 	_info.deepSeaColor = Blend(0.80f, _info.seaColor, (FloatRGB){ 0, 0, 0 });
 	
-	unsigned x, y;
-	FloatRGBA color;
-	FloatRGBA cloudColor = (FloatRGBA){_info.cloudColor.r, _info.cloudColor.g, _info.cloudColor.b, 1.0f};
-	Vector norm;
-	float q, yN, yS, yW, yE, nearPole;
-	GLfloat shade;
-	float rHeight = 1.0f / height;
-	float fy, fHeight = height;
+	job.cloudColor = (FloatRGBA){_info.cloudColor.r, _info.cloudColor.g, _info.cloudColor.b, 1.0f};
 	// The second parameter is the temperature fraction. Most favourable: 1.0f,  little ice. Most unfavourable: 0.0f, frozen planet. TODO: make it dependent on ranrot / planetinfo key...
 	SetMixConstants(&_info, 0.95f);	// no need to recalculate them inside each loop!
 	
-	// first pass, calculate q.
-	_info.qBuffer = malloc(width * height * sizeof (float));
-	FAIL_IF_NULL(_info.qBuffer);
+	// First phase: noise, and q from the noise.
+	FAIL_IF(!RunTiles(&job, NoiseTile, parallel));
 	
-	for (y = 0, fy = 0.0f; y < height; y++, fy++)
-	{
-		nearPole = (2.0f * fy - fHeight) * rHeight;
-		nearPole *= nearPole;
-		
-		for (x = 0; x < width; x++)
-		{
-			_info.qBuffer[y * width + x] = QFactor(_info.fbmBuffer, x, y, width, poleValue, seaBias, nearPole);
-		}
-	}
+	//TODO: sort out CloudMix
+	job.paleClouds = (_info.cloudFraction * _info.fbmBuffer[0] < 1.0f - _info.cloudFraction) ? 0.0f : 1.0f;
 	
-	// second pass, use q.
-	float cloudAlpha = _info.cloudAlpha;
-	float cloudFraction = _info.cloudFraction;
-	unsigned widthMask = width - 1;
-	unsigned heightMask = height - 1;
-	
-	for (y = 0, fy = 0.0f; y < height; y++, fy++)
-	{
-		nearPole = (2.0f * fy - fHeight) * rHeight;
-		nearPole *= nearPole;
-		
-		for (x = 0; x < width; x++)
-		{
-			q = _info.qBuffer[y * width + x];	// no need to use GetQ, x and y are always within bounds.
-			yN = GetQ(_info.qBuffer, x, y - 1, width, height, widthMask, heightMask);	// recalculates x & y if they go out of bounds.
-			yS = GetQ(_info.qBuffer, x, y + 1, width, height, widthMask, heightMask);
-			yW = GetQ(_info.qBuffer, x - 1, y, width, height, widthMask, heightMask);
-			yE = GetQ(_info.qBuffer, x + 1, y, width, height, widthMask, heightMask);
-			
-			color = PlanetMix(&_info, q, nearPole);
-			
-			norm = vector_normal(make_vector(normalScale * (yW - yE), normalScale * (yS - yN), 1.0f));
-			if (generateNormalMap)
-			{
-				shade = 1.0f;
-				
-				// Flatten in the sea.
-				norm = OOVectorInterpolate(norm, kBasisZVector, color.a);
-				
-				// Put norm in normal map, scaled from [-1..1] to [0..255].
-				*npx++ = 127.5f * (norm.y + 1.0f);
-				*npx++ = 127.5f * (-norm.x + 1.0f);
-				*npx++ = 127.5f * (norm.z + 1.0f);
-				
-				*npx++ = 255.0f * color.a;	// Specular channel.
-			}
-			else
-			{
-				//	Terrain shading - lambertian lighting from straight above.
-				shade = norm.z;
-				
-				/*	We don't want terrain shading in the sea. The alpha channel
-					of color is a measure of "seaishness" for the specular map,
-					so we can recycle that to avoid branching.
-					-- Ahruman
-				*/
-				shade += color.a - color.a * shade;	// equivalent to - but slightly faster than - previous implementation.
-			}
-			
-			*px++ = 255.0f * color.r * shade;
-			*px++ = 255.0f * color.g * shade;
-			*px++ = 255.0f * color.b * shade;
-			
-			*px++ = 0;	// FIXME: light map goes here.
-			
-			if (generateAtmosphere)
-			{
-				//TODO: sort out CloudMix
-				if (NO) 
-				{
-					q = QFactor(_info.fbmBuffer, x, y, width, paleClouds, cloudFraction, nearPole);
-					color = CloudMix(&_info, q, nearPole);
-				}
-				else
-				{
-					q = _info.fbmBuffer[y * width + x];
-					q *= q;
-					color = cloudColor;
-				}
-				*apx++ = 255.0f * color.r;
-				*apx++ = 255.0f * color.g;
-				*apx++ = 255.0f * color.b;
-				*apx++ = 255.0f * cloudAlpha * q;
-			}
-		}
-	}
+	// Second phase: use q.
+	FAIL_IF(!RunTiles(&job, MixTile, parallel));
 	
 	success = YES;
-	format = kOOTextureDataRGBA;
 	
 END:
-	FREE(_info.fbmBuffer);
-	FREE(_info.qBuffer);
-	FREE(randomBuffer);
+	DisposeFBMNoise(&job);
 	if (success)
 	{
-		data = buffer;
-		if (generateNormalMap) [_nMapGenerator completeWithData:nBuffer width:width height:height];
-		if (generateAtmosphere) [_atmoGenerator completeWithData:aBuffer width:width height:height];
+		*outDiffuse = job.diffuse;
+		if (outNormals != NULL)  *outNormals = job.normals;
+		if (outAtmosphere != NULL)  *outAtmosphere = job.atmosphere;
 	}
 	else
 	{
-		FREE(buffer);
-		FREE(nBuffer);
-		FREE(aBuffer);
+		FREE(job.diffuse);
+		FREE(job.normals);
+		FREE(job.atmosphere);
 	}
-	DESTROY(_nMapGenerator);
-	DESTROY(_atmoGenerator);
 	
-	OOLog(@"planetTex.temp", @"Completed generator %@ %@successfully", self, success ? @"" : @"un");
-	
-#if DEBUG_DUMP
-	if (success)
-	{
-		NSString *diffuseName = [NSString stringWithFormat:@"planet-%u-%u-diffuse-new", _info.seed.high, _info.seed.low];
-		NSString *lightsName = [NSString stringWithFormat:@"planet-%u-%u-lights-new", _info.seed.high, _info.seed.low];
-		
-		[[UNIVERSE gameView] dumpRGBAToRGBFileNamed:diffuseName
-								   andGrayFileNamed:lightsName
-											  bytes:buffer
-											  width:width
-											 height:height
-										   rowBytes:width * 4];
-	}
-#endif
+	return success;
 }
 
 
@@ -591,6 +659,43 @@ END:
 
 #endif
 
+
+#ifndef NDEBUG
+
++ (NSString *) benchmarkKernelName
+{
+	return [NSString stringWithUTF8String:BestKernels()->name];
+}
+
+
+- (BOOL) generateBenchmarkTexturesWithSize:(unsigned)size
+								  parallel:(BOOL)parallel
+								vectorized:(BOOL)vectorized
+								   diffuse:(uint8_t **)outDiffuse
+								   normals:(uint8_t **)outNormals
+								atmosphere:(uint8_t **)outAtmosphere
+{
+	unsigned scale;
+	for (scale = kPlanetScale256x256; scale <= kPlanetScale4096x4096; scale++)
+	{
+		if ((1U << (scale + kPlanetScaleOffset)) == size)  break;
+	}
+	if (scale > kPlanetScale4096x4096)  return NO;
+	
+	_planetScale = scale;
+	BOOL success = [self generateDiffuse:outDiffuse
+								 normals:outNormals
+							  atmosphere:outAtmosphere
+								 kernels:vectorized ? BestKernels() : ScalarKernels()
+								parallel:parallel];
+	
+	FREE(_info.fbmBuffer);
+	FREE(_info.qBuffer);
+	return success;
+}
+
+#endif
+
 @end
 
 
@@ -787,22 +892,20 @@ OOINLINE long fast_floor(double val)
 }
 
 
-static BOOL GenerateFBMNoise(OOPlanetTextureGeneratorInfo *info);
+static BOOL PrepareNoise(OOPlanetTextureJob *job);
 
 
-static BOOL FillFBMBuffer(OOPlanetTextureGeneratorInfo *info)
+static BOOL PrepareFBMNoise(OOPlanetTextureJob *job)
 {
-	NSCParameterAssert(info != NULL);
+	NSCParameterAssert(job != NULL);
+	
+	OOPlanetTextureGeneratorInfo *info = job->info;
 	
 	// Allocate result buffer.
 	info->fbmBuffer = calloc(info->width * info->height, sizeof (float));
-	if (info->fbmBuffer != NULL)
-	{
-		GenerateFBMNoise(info);
+	if (info->fbmBuffer == NULL)  return NO;
 	
-		return YES;
-	}
-	return NO;
+	return PrepareNoise(job);
 }
 
 
@@ -986,67 +1089,87 @@ static BOOL MakePermutationTable(OOPlanetTextureGeneratorInfo *info)
 }
 
 
-static BOOL GenerateFBMNoise(OOPlanetTextureGeneratorInfo *info)
+static BOOL PrepareNoise(OOPlanetTextureJob *job)
 {
-	BOOL OK = NO;
+	OOPlanetTextureGeneratorInfo *info = job->info;
+	unsigned y, height = info->height;
+	float lat;	// Latitude in radians.
+	float dlat = M_PI / height;
 	
-	FAIL_IF(!MakePermutationTable(info));
+	if (!MakePermutationTable(info))  return NO;
 	
-	unsigned x, y, width = info->width, height = info->height;
-	float lon, lat;	// Longitude and latitude in radians.
-	float dlon = 2.0f * M_PI / width;
-	float dlat = M_PI / height;
-	float *px = info->fbmBuffer;
+	/*	Latitude is accumulated row by row, so it's tabulated up front to
+		give each row the same value whichever tile it's in.
+	*/
+	job->latitudes = malloc(height * sizeof *job->latitudes);
+	if (job->latitudes == NULL)  return NO;
 	
 	for (y = 0, lat = -M_PI_2; y < height; y++, lat += dlat)
 	{
-		float las = sinf(lat);
-		float lac = cosf(lat);
+		job->latitudes[y] = lat;
+	}
+	
+	return YES;
+}
+
+
+static void GenerateFBMNoiseRow(OOPlanetTextureJob *job, unsigned y)
+{
+	OOPlanetTextureGeneratorInfo *info = job->info;
+	unsigned x, width = info->width, height = info->height;
+	float lon;	// Longitude in radians.
+	float dlon = 2.0f * M_PI / width;
+	float *px = info->fbmBuffer + y * width;
+	
+	float las = sinf(job->latitudes[y]);
+	float lac = cosf(job->latitudes[y]);
+	
+	for (x = 0, lon = -M_PI; x < width; x++, lon += dlon)
+	{
+		// FIXME: in real life, we really don't want sin and cos per pixel.
+		// Convert spherical coordinates to vector.
+		float los = sinf(lon);
+		float loc = cosf(lon);
 		
-		for (x = 0, lon = -M_PI; x < width; x++, lon += dlon)
+		Vector p =
 		{
-			// FIXME: in real life, we really don't want sin and cos per pixel.
-			// Convert spherical coordinates to vector.
-			float los = sinf(lon);
-			float loc = cosf(lon);
-			
-			Vector p =
-			{
-				los * lac,
-				las,
-				loc * lac
-			};
-			
+			los * lac,
+			las,
+			loc * lac
+		};
+	
 #if 1
-			// fBM
-			unsigned octaveMask = 4;
-			float octave = octaveMask;
-			octaveMask -= 1;
-			float scale = 0.4f;
-			float sum = 0;
+		// fBM
+		unsigned octaveMask = 4;
+		float octave = octaveMask;
+		octaveMask -= 1;
+		float scale = 0.4f;
+		float sum = 0;
+		
+		while ((octaveMask + 1) < height)
+		{
+			Vector ps = vector_multiply_scalar(p, octave);
+			sum += scale * SampleNoise3D(info, ps);
 			
-			while ((octaveMask + 1) < height)
-			{
-				Vector ps = vector_multiply_scalar(p, octave);
-				sum += scale * SampleNoise3D(info, ps);
-				
-				octave *= 2.0f;
-				octaveMask = (octaveMask << 1) | 1;
-				scale *= 0.5f;
-			}
+			octave *= 2.0f;
+			octaveMask = (octaveMask << 1) | 1;
+			scale *= 0.5f;
+		}
 #else
-			// Single octave
-			p = vector_multiply_scalar(p, 4.0f);
-			float sum = 0.5f * SampleNoise3D(info, p);
+		// Single octave
+		p = vector_multiply_scalar(p, 4.0f);
+		float sum = 0.5f * SampleNoise3D(info, p);
 #endif
-			
-			*px++ = sum + 0.5f;
-		}
+		
+		*px++ = sum + 0.5f;
 	}
-	
-END:
-	FREE(info->permutations);
-	return OK;
+}
+
+
+static void DisposeFBMNoise(OOPlanetTextureJob *job)
+{
+	FREE(job->info->permutations);
+	FREE(job->latitudes);
 }
 
 #else
@@ -1062,129 +1185,562 @@ static void FillRandomBuffer(float *randomBuffer, RANROTSeed seed)
 }
 
 
-static void AddNoise(OOPlanetTextureGeneratorInfo *info, float *randomBuffer, float octave, unsigned octaveMask, float scale, float *qxBuffer, int *ixBuffer)
+/*	Set up the octaves of fBM noise. For each octave, the values of ix, jx and
+	qx used for each column are calculated here once, rather than on the
+	first row. The first row used to get qx before smoothing, so that's kept
+	too.
+*/
+static BOOL PrepareNoise(OOPlanetTextureJob *job)
 {
-	unsigned	x, y;
-	unsigned	width = info->width, height = info->height;
-	int			ix, jx, iy, jy;
-	float		rr = octave / width;
-	float		fx, fy, qx, qy, rix, rjx, rfinal;
-	float		*dst = info->fbmBuffer;
+	OOPlanetTextureGeneratorInfo *info = job->info;
+	unsigned	i, x, width = info->width, height = info->height;
+	unsigned	octaveMask;
+	int			ix, jx;
+	float		octave, scale, fx, qx;
 	
-	for (fy = 0, y = 0; y < height; fy++, y++)
+	for (octaveMask = 8 * kPlanetAspectRatio; octaveMask < height; octaveMask <<= 1)
 	{
-		qy = fy * rr;
+		job->octaveCount++;
+	}
+	
+	job->randomBuffer = malloc(kRandomBufferSize * kRandomBufferSize * sizeof (float));
+	job->octaves = malloc(job->octaveCount * sizeof *job->octaves);
+	job->octaveTables = malloc(job->octaveCount * width * 2 * (sizeof (int) + sizeof (float)));
+	if (job->randomBuffer == NULL || job->octaves == NULL || job->octaveTables == NULL)  return NO;
+	
+	int *intTables = job->octaveTables;
+	float *floatTables = (float *)(intTables + 2 * job->octaveCount * width);
+	
+	// Get us some value noise.
+	FillRandomBuffer(job->randomBuffer, info->seed);
+	
+	// Generate basic fBM noise.
+	octaveMask = 8 * kPlanetAspectRatio;
+	octave = octaveMask;
+	octaveMask -= 1;
+	scale = 0.5f;
+	
+	for (i = 0; i < job->octaveCount; i++)
+	{
+		OOPlanetNoiseOctave *o = &job->octaves[i];
+		
+		o->rr = octave / width;
+		o->octaveMask = octaveMask;
+		o->scale = scale;
+		o->cellWidth = width / (octaveMask + 1);	// Width and octave are powers of two, so x * rr is exact and ix changes every cellWidth pixels.
+		o->ix = intTables + 2 * i * width;
+		o->jx = o->ix + width;
+		o->qx = floatTables + 2 * i * width;
+		o->linearQx = o->qx + width;
+		
+		for (fx = 0, x = 0; x < width; fx++, x++)
+		{
+			qx = fx * o->rr;
+			ix = fast_floor(qx);
+			qx -= ix;
+			ix &= (kRandomBufferSize - 1);
+			jx = (ix + 1) & octaveMask;
+			jx &= (kRandomBufferSize - 1);
+			
+			o->ix[x] = ix;
+			o->jx[x] = jx;
+			o->qx[x] = Hermite(qx);
+			o->linearQx[x] = qx;
+		}
+		
+		octave *= 2.0f;
+		octaveMask = (octaveMask << 1) | 1;
+		scale *= 0.5f;
+	}
+	
+	return YES;
+}
+
+
+// Add all octaves of noise to row y, in order, so each pixel is summed exactly as before tiling.
+static void GenerateFBMNoiseRow(OOPlanetTextureJob *job, unsigned y)
+{
+	OOPlanetTextureGeneratorInfo *info = job->info;
+	unsigned	i, width = info->width;
+	int			iy, jy;
+	float		fy = y, qy;
+	float		*dst = info->fbmBuffer + y * width;
+	
+	for (i = 0; i < job->octaveCount; i++)
+	{
+		OOPlanetNoiseOctave octave = job->octaves[i];
+		if (y == 0)  octave.qx = octave.linearQx;
+		
+		qy = fy * octave.rr;
 		iy = fast_floor(qy);
-		jy = (iy + 1) & octaveMask;
+		jy = (iy + 1) & octave.octaveMask;
 		qy = Hermite(qy - iy);
 		iy &= (kRandomBufferSize - 1);
 		jy &= (kRandomBufferSize - 1);
 		
-		for (fx = 0, x = 0; x < width; fx++, x++)
+		job->kernels->addNoiseRow(dst, &octave, job->randomBuffer + iy * kRandomBufferSize, job->randomBuffer + jy * kRandomBufferSize, qy, width);
+	}
+}
+
+
+static void DisposeFBMNoise(OOPlanetTextureJob *job)
+{
+	FREE(job->randomBuffer);
+	FREE(job->octaves);
+	FREE(job->octaveTables);
+}
+
+#endif
+
+
+static float QFactor(float *accbuffer, int x, int y, unsigned width, float polar_y_value, float bias, float polar_y)
+{
+	float q = accbuffer[y * width + x];	// 0.0 -> 1.0
+	q += bias;
+	
+	// Polar Y smooth.
+	q = q * (1.0f - polar_y) + polar_y * polar_y_value;
+
+	return q;
+}
+
+
+static void SetMixConstants(OOPlanetTextureGeneratorInfo *info, float temperatureFraction)
+{
+	info->mix_hi = 0.66667f * info->landFraction;
+	info->mix_oh = 1.0f / info->mix_hi;
+	info->mix_ih = 1.0f / (1.0f - info->mix_hi);
+	info->mix_polarCap = temperatureFraction * (0.28f + 0.24f * info->landFraction);	// landmasses make the polar cap proportionally bigger, but not too much bigger.
+}
+
+
+/*** Tiles ***/
+
+static void RunTile(NSUInteger index, void *context)
+{
+	OOPlanetTextureTileRun *run = context;
+	unsigned firstRow = index * run->tileRows;
+	
+	run->function(run->job, firstRow, MIN(firstRow + run->tileRows, run->rowCount));
+}
+
+
+static BOOL RunTiles(OOPlanetTextureJob *job, OOPlanetTextureTileFunction function, BOOL parallel)
+{
+	OOPlanetTextureTileRun		run;
+	
+	run.job = job;
+	run.function = function;
+	run.rowCount = job->info->height;
+	run.tileRows = MAX(kTilePixels / job->info->width, 1U);
+	
+	NSUInteger tileCount = (run.rowCount + run.tileRows - 1) / run.tileRows;
+	
+#ifndef TEXGEN_TEST_RIG
+	OORunIndexedTasks(tileCount, 1, parallel ? PLANET_TEXTURE_MAX_WORKERS : 0, RunTile, &run);
+#else
+	// No OOAsyncWorkManager in the test rig.
+	NSUInteger i;
+	for (i = 0; i < tileCount; i++)  RunTile(i, &run);
+	(void)parallel;
+#endif
+	
+	return !job->failed;
+}
+
+
+// First phase: fBM noise, and q from the noise.
+static void NoiseTile(OOPlanetTextureJob *job, unsigned firstRow, unsigned endRow)
+{
+	OOPlanetTextureGeneratorInfo *info = job->info;
+	unsigned	y, width = info->width;
+	float		fy, nearPole;
+	
+	for (y = firstRow; y < endRow; y++)
+	{
+		GenerateFBMNoiseRow(job, y);
+		
+		fy = y;
+		nearPole = (2.0f * fy - job->fHeight) * job->rHeight;
+		nearPole *= nearPole;
+		
+		job->kernels->qFactorRow(info->qBuffer + y * width, info->fbmBuffer + y * width, width, job->seaBias, 1.0f - nearPole, nearPole * job->poleValue);
+	}
+}
+
+
+/*	Beyond the poles, the neighbouring row is the same row on the far side of
+	the planet. Width is assumed to be a power of two.
+*/
+static const float *WrapRow(float *dst, const float *row, unsigned width)
+{
+	unsigned	x, widthMask = width - 1, halfWidth = width >> 1;
+	
+	for (x = 0; x < width; x++)
+	{
+		dst[x] = row[(x + halfWidth) & widthMask];
+	}
+	
+	return dst;
+}
+
+
+// Second phase: colours, normals and atmosphere from q.
+static void MixTile(OOPlanetTextureJob *job, unsigned firstRow, unsigned endRow)
+{
+	OOPlanetTextureGeneratorInfo *info = job->info;
+	unsigned	x, y, width = info->width, height = info->height;
+	FloatRGBA	color;
+	Vector		norm;
+	float		q, fy, nearPole;
+	GLfloat		shade;
+	
+	// Per-row scratch space: a wrapped neighbour row, and the three components of the normals.
+	float *scratch = malloc(4 * width * sizeof *scratch);
+	if (EXPECT_NOT(scratch == NULL))
+	{
+		job->failed = YES;
+		return;
+	}
+	float *wrapped = scratch;
+	float *nx = scratch + width;
+	float *ny = scratch + 2 * width;
+	float *nz = scratch + 3 * width;
+	
+	for (y = firstRow; y < endRow; y++)
+	{
+		const float *qRow = info->qBuffer + y * width;
+		const float *north = (y != 0) ? qRow - width : WrapRow(wrapped, qRow, width);
+		const float *south = (y != height - 1) ? qRow + width : WrapRow(wrapped, qRow, width);
+		const float *fbm = info->fbmBuffer + y * width;
+		
+		uint8_t *px = job->diffuse + 4 * width * y;
+		uint8_t *npx = (job->normals != NULL) ? job->normals + 4 * width * y : NULL;
+		uint8_t *apx = (job->atmosphere != NULL) ? job->atmosphere + 4 * width * y : NULL;
+		
+		fy = y;
+		nearPole = (2.0f * fy - job->fHeight) * job->rHeight;
+		nearPole *= nearPole;
+		
+		job->kernels->normalRow(qRow, north, south, nx, ny, nz, width, job->normalScale);
+		
+		for (x = 0; x < width; x++)
 		{
-			if (y == 0)
+			q = qRow[x];
+			color = PlanetMix(info, q, nearPole);
+			
+			norm = make_vector(nx[x], ny[x], nz[x]);
+			if (npx != NULL)
 			{
-				// first pass: initialise buffers.
-				qx = fx * rr;
-				ix = fast_floor(qx);
-				qx -= ix;
-				ix &= (kRandomBufferSize - 1);
-				ixBuffer[x] = ix;
-				qxBuffer[x] = Hermite(qx);
+				shade = 1.0f;
+				
+				// Flatten in the sea.
+				norm = OOVectorInterpolate(norm, kBasisZVector, color.a);
+				
+				// Put norm in normal map, scaled from [-1..1] to [0..255].
+				*npx++ = 127.5f * (norm.y + 1.0f);
+				*npx++ = 127.5f * (-norm.x + 1.0f);
+				*npx++ = 127.5f * (norm.z + 1.0f);
+				
+				*npx++ = 255.0f * color.a;	// Specular channel.
 			}
 			else
 			{
-				// later passes: grab the stored values.
-				ix = ixBuffer[x];
-				qx = qxBuffer[x];
+				//	Terrain shading - lambertian lighting from straight above.
+				shade = norm.z;
+				
+				/*	We don't want terrain shading in the sea. The alpha channel
+					of color is a measure of "seaishness" for the specular map,
+					so we can recycle that to avoid branching.
+					-- Ahruman
+				*/
+				shade += color.a - color.a * shade;	// equivalent to - but slightly faster than - previous implementation.
 			}
 			
-			jx = (ix + 1) & octaveMask;
-			jx &= (kRandomBufferSize - 1);
+			*px++ = 255.0f * color.r * shade;
+			*px++ = 255.0f * color.g * shade;
+			*px++ = 255.0f * color.b * shade;
 			
-			rix = Lerp(randomBuffer[iy * kRandomBufferSize + ix], randomBuffer[iy * kRandomBufferSize + jx], qx);
-			rjx = Lerp(randomBuffer[jy * kRandomBufferSize + ix], randomBuffer[jy * kRandomBufferSize + jx], qx);
-			rfinal = Lerp(rix, rjx, qy);
+			*px++ = 0;	// FIXME: light map goes here.
 			
-			*dst++ += scale * rfinal;
+			if (apx != NULL)
+			{
+				//TODO: sort out CloudMix
+				if (NO) 
+				{
+					q = QFactor(info->fbmBuffer, x, y, width, job->paleClouds, info->cloudFraction, nearPole);
+					color = CloudMix(info, q, nearPole);
+				}
+				else
+				{
+					q = fbm[x];
+					q *= q;
+					color = job->cloudColor;
+				}
+				*apx++ = 255.0f * color.r;
+				*apx++ = 255.0f * color.g;
+				*apx++ = 255.0f * color.b;
+				*apx++ = 255.0f * info->cloudAlpha * q;
+			}
 		}
 	}
+	
+	free(scratch);
 }
 
 
-static BOOL GenerateFBMNoise(OOPlanetTextureGeneratorInfo *info)
+/*** Kernels ***/
+
+#if !PERLIN_3D
+OOINLINE void AddNoiseRowTail(float *dst, const OOPlanetNoiseOctave *octave, const float *row0, const float *row1, float qy, unsigned x, unsigned count)
 {
-	// Allocate the temporary buffers we need in one fell swoop, to avoid administrative overhead.
-	size_t randomBufferSize = kRandomBufferSize * kRandomBufferSize * sizeof (float);
-	size_t qxBufferSize = info->width * sizeof (float);
-	size_t ixBufferSize = info->width * sizeof (int);
-	char *sharedBuffer = malloc(randomBufferSize + qxBufferSize + ixBufferSize);
-	if (sharedBuffer == NULL)  return NO;
-	
-	float *randomBuffer = (float *)sharedBuffer;
-	float *qxBuffer = (float *)(sharedBuffer + randomBufferSize);
-	int *ixBuffer = (int *)(sharedBuffer + randomBufferSize + qxBufferSize);
-	
-	// Get us some value noise.
-	FillRandomBuffer(randomBuffer, info->seed);
+	float		rix, rjx, rfinal;
 	
-	// Generate basic fBM noise.
-	unsigned height = info->height;
-	unsigned octaveMask = 8 * kPlanetAspectRatio;
-	float octave = octaveMask;
-	octaveMask -= 1;
-	float scale = 0.5f;
+	for (; x < count; x++)
+	{
+		rix = Lerp(row0[octave->ix[x]], row0[octave->jx[x]], octave->qx[x]);
+		rjx = Lerp(row1[octave->ix[x]], row1[octave->jx[x]], octave->qx[x]);
+		rfinal = Lerp(rix, rjx, qy);
+		
+		dst[x] += octave->scale * rfinal;
+	}
+}
+#endif
+
+
+// Equivalent to QFactor() with polarFactor = 1 - polar_y and polarTerm = polar_y * polar_y_value.
+OOINLINE void QFactorRowTail(float *dst, const float *fbm, unsigned x, unsigned count, float bias, float polarFactor, float polarTerm)
+{
+	float		q;
 	
-	while ((octaveMask + 1) < height)
+	for (; x < count; x++)
 	{
-		AddNoise(info, randomBuffer, octave, octaveMask, scale, qxBuffer, ixBuffer);
-		octave *= 2.0f;
-		octaveMask = (octaveMask << 1) | 1;
-		scale *= 0.5f;
+		q = fbm[x];	// 0.0 -> 1.0
+		q += bias;
+		
+		// Polar Y smooth.
+		dst[x] = q * polarFactor + polarTerm;
 	}
+}
+
+
+// Normals for pixels x to end of a row of count pixels, wrapping around at the ends.
+OOINLINE void NormalRowTail(const float *q, const float *north, const float *south, float *nx, float *ny, float *nz, unsigned x, unsigned end, unsigned count, float normalScale)
+{
+	unsigned	widthMask = count - 1;
+	Vector		norm;
 	
-	FREE(sharedBuffer);
-	return YES;
+	for (; x < end; x++)
+	{
+		norm = vector_normal(make_vector(normalScale * (q[(x - 1) & widthMask] - q[(x + 1) & widthMask]), normalScale * (south[x] - north[x]), 1.0f));
+		nx[x] = norm.x;
+		ny[x] = norm.y;
+		nz[x] = norm.z;
+	}
 }
 
+
+#if !PERLIN_3D
+static void ScalarAddNoiseRow(float *dst, const OOPlanetNoiseOctave *octave, const float *row0, const float *row1, float qy, unsigned count)
+{
+	AddNoiseRowTail(dst, octave, row0, row1, qy, 0, count);
+}
 #endif
 
 
-static float QFactor(float *accbuffer, int x, int y, unsigned width, float polar_y_value, float bias, float polar_y)
+static void ScalarQFactorRow(float *dst, const float *fbm, unsigned count, float bias, float polarFactor, float polarTerm)
 {
-	float q = accbuffer[y * width + x];	// 0.0 -> 1.0
-	q += bias;
-	
-	// Polar Y smooth.
-	q = q * (1.0f - polar_y) + polar_y * polar_y_value;
+	QFactorRowTail(dst, fbm, 0, count, bias, polarFactor, polarTerm);
+}
 
-	return q;
+
+static void ScalarNormalRow(const float *q, const float *north, const float *south, float *nx, float *ny, float *nz, unsigned count, float normalScale)
+{
+	NormalRowTail(q, north, south, nx, ny, nz, 0, count, count, normalScale);
 }
 
 
-static float GetQ(float *qbuffer, unsigned x, unsigned y, unsigned width, unsigned height, unsigned widthMask, unsigned heightMask)
+static const OOPlanetTextureKernels kScalarKernels =
+{
+	"scalar",
+#if !PERLIN_3D
+	ScalarAddNoiseRow,
+#endif
+	ScalarQFactorRow,
+	ScalarNormalRow
+};
+
+
+#if OO_PLANET_TEXTURE_X86
+
+/*** SSE2 kernels ***/
+
+#define SSE2_FUNC __attribute__((target("sse2")))
+
+#define KERNEL(name)				SSE2##name
+#define KERNEL_FUNC					SSE2_FUNC
+#define VEC							__m128
+#define WIDTH						4
+#define VLOAD(p)					_mm_loadu_ps(p)
+#define VSTORE(p, v)				_mm_storeu_ps((p), (v))
+#define VSPLAT(f)					_mm_set1_ps(f)
+#define VADD						_mm_add_ps
+#define VSUB						_mm_sub_ps
+#define VMUL						_mm_mul_ps
+#define VDIV						_mm_div_ps
+#define VSQRT						_mm_sqrt_ps
+
+#include "OOPlanetTextureKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VLOAD
+#undef VSTORE
+#undef VSPLAT
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VSQRT
+
+
+static const OOPlanetTextureKernels kSSE2Kernels =
+{
+	"SSE2",
+#if !PERLIN_3D
+	SSE2AddNoiseRow,
+#endif
+	SSE2QFactorRow,
+	SSE2NormalRow
+};
+
+
+/*** AVX2 kernels ***/
+
+// Only AVX is needed, but AVX2 is what OOCPUGetFeatures() reports.
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+#define KERNEL(name)				AVX2##name
+#define KERNEL_FUNC					AVX2_FUNC
+#define VEC							__m256
+#define WIDTH						8
+#define VLOAD(p)					_mm256_loadu_ps(p)
+#define VSTORE(p, v)				_mm256_storeu_ps((p), (v))
+#define VSPLAT(f)					_mm256_set1_ps(f)
+#define VADD						_mm256_add_ps
+#define VSUB						_mm256_sub_ps
+#define VMUL						_mm256_mul_ps
+#define VDIV						_mm256_div_ps
+#define VSQRT						_mm256_sqrt_ps
+
+#include "OOPlanetTextureKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VLOAD
+#undef VSTORE
+#undef VSPLAT
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VSQRT
+
+
+static const OOPlanetTextureKernels kAVX2Kernels =
+{
+	"AVX2",
+#if !PERLIN_3D
+	AVX2AddNoiseRow,
+#endif
+	AVX2QFactorRow,
+	AVX2NormalRow
+};
+
+#endif	// OO_PLANET_TEXTURE_X86
+
+
+#if OO_PLANET_TEXTURE_NEON
+
+/*** NEON kernels ***/
+
+#define KERNEL(name)				NEON##name
+#define KERNEL_FUNC
+#define VEC							float32x4_t
+#define WIDTH						4
+#define VLOAD(p)					vld1q_f32(p)
+#define VSTORE(p, v)				vst1q_f32((p), (v))
+#define VSPLAT(f)					vdupq_n_f32(f)
+#define VADD						vaddq_f32
+#define VSUB						vsubq_f32
+#define VMUL						vmulq_f32
+#define VDIV						vdivq_f32
+#define VSQRT						vsqrtq_f32
+
+#include "OOPlanetTextureKernels.h"
+
+#undef KERNEL
+#undef KERNEL_FUNC
+#undef VEC
+#undef WIDTH
+#undef VLOAD
+#undef VSTORE
+#undef VSPLAT
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VSQRT
+
+
+static const OOPlanetTextureKernels kNEONKernels =
 {
-	// Correct Y wrapping mode, unoptimised.
-	//if (y < 0) { y = -y - 1; x += width / 2; }
-	//else if (y >= height) { y = height - (y - height)  - 1; x += width / 2; }
-	// now let's wrap x.
-	//x = x % width;
+	"NEON",
+#if !PERLIN_3D
+	NEONAddNoiseRow,
+#endif
+	NEONQFactorRow,
+	NEONNormalRow
+};
 
-	// Correct Y wrapping mode, faster method. In the following lines of code, both
-	// width and height are assumed to be powers of 2: 512, 1024, 2048, etc...
-	if (y & height) { y = (y ^ heightMask) & heightMask; x += width >> 1; }
-	// x wrapping.
-	x &= widthMask;
-	return  qbuffer[y * width + x];
+#endif	// OO_PLANET_TEXTURE_NEON
+
+
+static const OOPlanetTextureKernels *ScalarKernels(void)
+{
+	return &kScalarKernels;
 }
 
 
-static void SetMixConstants(OOPlanetTextureGeneratorInfo *info, float temperatureFraction)
+static const OOPlanetTextureKernels *BestKernels(void)
 {
-	info->mix_hi = 0.66667f * info->landFraction;
-	info->mix_oh = 1.0f / info->mix_hi;
-	info->mix_ih = 1.0f / (1.0f - info->mix_hi);
-	info->mix_polarCap = temperatureFraction * (0.28f + 0.24f * info->landFraction);	// landmasses make the polar cap proportionally bigger, but not too much bigger.
+#ifndef TEXGEN_TEST_RIG
+	OOCPUFeatures features = OOCPUGetFeatures();
+	
+#if OO_PLANET_TEXTURE_X86
+	if (features & kOOCPUFeatureAVX2)  return &kAVX2Kernels;
+	if (features & kOOCPUFeatureSSE2)  return &kSSE2Kernels;
+#endif
+#if OO_PLANET_TEXTURE_NEON
+	if (features & kOOCPUFeatureNEON)  return &kNEONKernels;
+#endif
+	
+	(void)features;
+#else
+#if OO_PLANET_TEXTURE_X86 && defined(__AVX2__)
+	return &kAVX2Kernels;
+#elif OO_PLANET_TEXTURE_X86 && defined(__SSE2__)
+	return &kSSE2Kernels;
+#elif OO_PLANET_TEXTURE_NEON
+	return &kNEONKernels;
+#endif
+#endif
+	
+	return &kScalarKernels;
 }
 
 
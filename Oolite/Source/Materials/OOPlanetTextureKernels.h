@@ -0,0 +1,132 @@
+/*
+
+OOPlanetTextureKernels.h
+
+SIMD kernel bodies for OOPlanetTextureGenerator.m, which includes this file
+once for each instruction set after defining:
+	KERNEL(name)			Function name for this instruction set.
+	KERNEL_FUNC				Function attributes (target selection).
+	VEC						Float vector register type.
+	WIDTH					Number of floats in a VEC.
+	VLOAD(p), VSTORE(p, v)	Unaligned load and store.
+	VSPLAT(f)				All lanes set to f.
+	VADD, VSUB, VMUL, VDIV, VSQRT
+
+Only correctly rounded operations are used, in the same order as the scalar
+code, so the results are identical to the scalar kernels as long as the
+compiler doesn't fuse multiplies and adds in one but not the other.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+
+#if !PERLIN_3D
+/*	Add one octave of value noise to a row. Where the octave's cells are at
+	least a vector wide, all lanes share the same four random values;
+	otherwise they're gathered a lane at a time.
+*/
+KERNEL_FUNC static void KERNEL(AddNoiseRow)(float *dst, const OOPlanetNoiseOctave *octave, const float *row0, const float *row1, float qy, unsigned count)
+{
+	unsigned			x = 0, lane;
+	const VEC			scale = VSPLAT(octave->scale);
+	const VEC			vqy = VSPLAT(qy);
+	VEC					a, b, c, d;
+	float				la[WIDTH], lb[WIDTH], lc[WIDTH], ld[WIDTH];
+	
+	for (; x + WIDTH <= count; x += WIDTH)
+	{
+		if (octave->cellWidth >= WIDTH)
+		{
+			a = VSPLAT(row0[octave->ix[x]]);
+			b = VSPLAT(row0[octave->jx[x]]);
+			c = VSPLAT(row1[octave->ix[x]]);
+			d = VSPLAT(row1[octave->jx[x]]);
+		}
+		else
+		{
+			for (lane = 0; lane < WIDTH; lane++)
+			{
+				la[lane] = row0[octave->ix[x + lane]];
+				lb[lane] = row0[octave->jx[x + lane]];
+				lc[lane] = row1[octave->ix[x + lane]];
+				ld[lane] = row1[octave->jx[x + lane]];
+			}
+			a = VLOAD(la);
+			b = VLOAD(lb);
+			c = VLOAD(lc);
+			d = VLOAD(ld);
+		}
+		
+		VEC qx = VLOAD(octave->qx + x);
+		VEC rix = VADD(a, VMUL(qx, VSUB(b, a)));
+		VEC rjx = VADD(c, VMUL(qx, VSUB(d, c)));
+		VEC rfinal = VADD(rix, VMUL(vqy, VSUB(rjx, rix)));
+		
+		VSTORE(dst + x, VADD(VLOAD(dst + x), VMUL(scale, rfinal)));
+	}
+	
+	AddNoiseRowTail(dst, octave, row0, row1, qy, x, count);
+}
+#endif
+
+
+KERNEL_FUNC static void KERNEL(QFactorRow)(float *dst, const float *fbm, unsigned count, float bias, float polarFactor, float polarTerm)
+{
+	unsigned			x = 0;
+	const VEC			vbias = VSPLAT(bias);
+	const VEC			factor = VSPLAT(polarFactor);
+	const VEC			term = VSPLAT(polarTerm);
+	
+	for (; x + WIDTH <= count; x += WIDTH)
+	{
+		VSTORE(dst + x, VADD(VMUL(VADD(VLOAD(fbm + x), vbias), factor), term));
+	}
+	
+	QFactorRowTail(dst, fbm, x, count, bias, polarFactor, polarTerm);
+}
+
+
+/*	The first and last pixels wrap around, so they're left to the scalar
+	tail; everything in between is vectorized. The z component of the
+	unnormalized normal is 1, so the normalized z is the reciprocal of the
+	length.
+*/
+KERNEL_FUNC static void KERNEL(NormalRow)(const float *q, const float *north, const float *south, float *nx, float *ny, float *nz, unsigned count, float normalScale)
+{
+	unsigned			x = 1;
+	const VEC			scale = VSPLAT(normalScale);
+	const VEC			one = VSPLAT(1.0f);
+	
+	NormalRowTail(q, north, south, nx, ny, nz, 0, 1, count, normalScale);
+	
+	for (; x + WIDTH < count; x += WIDTH)
+	{
+		VEC vx = VMUL(scale, VSUB(VLOAD(q + x - 1), VLOAD(q + x + 1)));
+		VEC vy = VMUL(scale, VSUB(VLOAD(south + x), VLOAD(north + x)));
+		VEC rlen = VDIV(one, VSQRT(VADD(VADD(VMUL(vx, vx), VMUL(vy, vy)), one)));
+		
+		VSTORE(nx + x, VMUL(vx, rlen));
+		VSTORE(ny + x, VMUL(vy, rlen));
+		VSTORE(nz + x, rlen);
+	}
+	
+	NormalRowTail(q, north, south, nx, ny, nz, x, count, count, normalScale);
+}
@@ -78,3 +78,28 @@ OOLITE_OPTIONAL(OOAsyncWorkTask)
 - (void) completeAsyncTask;
 
 @end
+
+
+/*	OORunIndexedTasks()
+	
+	Call function(index, context) for each index from 0 to count - 1, spread
+	over the calling thread and up to maxWorkers async work manager threads,
+	and return when every call has returned.
+	
+	Indices are claimed chunkSize at a time, in order, by whichever thread is
+	free, so a thread that gets stuck on an expensive index doesn't hold up
+	the others. No more workers are woken than there are CPUs besides the
+	calling one, or chunks besides the first; with none, everything is run in
+	order on the calling thread. Each chunk gets its own autorelease pool.
+	
+	If a call raises an exception, the remaining indices are still run, and
+	the first exception is re-raised on the calling thread afterwards.
+	
+	The function may not add work to the async work manager and wait for it,
+	since every worker may be busy with this call. Worker tasks for a call may
+	be scheduled after it has returned; they find no indices left and exit
+	without touching context.
+*/
+typedef void (*OOIndexedTaskFunction)(NSUInteger index, void *context);
+
+void OORunIndexedTasks(NSUInteger count, NSUInteger chunkSize, NSUInteger maxWorkers, OOIndexedTaskFunction function, void *context);
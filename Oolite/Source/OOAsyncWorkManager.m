@@ -299,6 +299,9 @@ static void InitAsyncWorkManager(void)
 
 - (void) noteTaskQueued:(id<OOAsyncWorkTask>)task
 {
+	// Tasks without -completeAsyncTask never come back through _readyQueue, so tracking them would leak them.
+	if (![task respondsToSelector:@selector(completeAsyncTask)])  return;
+	
 	[_pendingOpsLock lock];
 	[_pendingCompletableOperations addObject:task];
 	[_pendingOpsLock unlock];
@@ -456,3 +459,172 @@ enum
 }
 
 @end
+
+
+
+/******* OORunIndexedTasks() - work sharing between the calling thread and workers *******/
+
+enum
+{
+	kConditionWorking,
+	kConditionDone
+};
+
+
+/*	Worker tasks retain the batch, so a worker that only gets scheduled after
+	the batch is finished finds no work left and exits.
+*/
+@interface OOIndexedTaskBatch: NSObject <OOAsyncWorkTask>
+{
+@private
+	OOIndexedTaskFunction	_function;
+	void					*_context;
+	NSUInteger				_count;
+	NSUInteger				_chunkSize;
+	NSUInteger				_next;
+	NSUInteger				_done;
+	
+	NSConditionLock			*_lock;
+	NSException				*_exception;
+}
+
+- (id) initWithCount:(NSUInteger)count chunkSize:(NSUInteger)chunkSize function:(OOIndexedTaskFunction)function context:(void *)context;
+
+- (void) run;
+- (void) waitUntilDone;
+
+- (NSException *) exception;
+
+@end
+
+
+void OORunIndexedTasks(NSUInteger count, NSUInteger chunkSize, NSUInteger maxWorkers, OOIndexedTaskFunction function, void *context)
+{
+	NSUInteger				i, cpuCount, taskCount;
+	OOIndexedTaskBatch		*batch = nil;
+	OOAsyncWorkManager		*workManager = nil;
+	
+	NSCParameterAssert(function != NULL);
+	if (count == 0)  return;
+	if (chunkSize == 0)  chunkSize = 1;
+	
+	// No point in waking more workers than there are CPUs or chunks left over for them.
+	cpuCount = OOCPUCount();
+	taskCount = (cpuCount > 1) ? MIN(cpuCount - 1, maxWorkers) : 0;
+	taskCount = MIN(taskCount, (count - 1) / chunkSize);
+	
+	batch = [[OOIndexedTaskBatch alloc] initWithCount:count chunkSize:chunkSize function:function context:context];
+	if (EXPECT_NOT(batch == nil))
+	{
+		for (i = 0; i < count; i++)  function(i, context);
+		return;
+	}
+	
+	workManager = [OOAsyncWorkManager sharedAsyncWorkManager];
+	for (i = 0; i < taskCount; i++)
+	{
+		if (![workManager addTask:batch priority:kOOAsyncPriorityHigh])  break;
+	}
+	
+	// The calling thread works on the batch too, then waits for any stragglers.
+	[batch run];
+	[batch waitUntilDone];
+	
+	NSException *exception = [[[batch exception] retain] autorelease];
+	[batch release];
+	
+	if (exception != nil)  [exception raise];
+}
+
+
+@implementation OOIndexedTaskBatch
+
+- (id) initWithCount:(NSUInteger)count chunkSize:(NSUInteger)chunkSize function:(OOIndexedTaskFunction)function context:(void *)context
+{
+	if ((self = [super init]))
+	{
+		_lock = [[NSConditionLock alloc] initWithCondition:(count != 0) ? kConditionWorking : kConditionDone];
+		if (_lock == nil)
+		{
+			[self release];
+			return nil;
+		}
+		
+		_function = function;
+		_context = context;
+		_count = count;
+		_chunkSize = chunkSize;
+	}
+	
+	return self;
+}
+
+
+- (void) dealloc
+{
+	DESTROY(_lock);
+	DESTROY(_exception);
+	
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%lu of %lu done", (unsigned long)_done, (unsigned long)_count];
+}
+
+
+- (void) run
+{
+	NSUInteger				i, start, end;
+	
+	for (;;)
+	{
+		[_lock lock];
+		start = _next;
+		end = MIN(start + _chunkSize, _count);
+		_next = end;
+		[_lock unlockWithCondition:(_done == _count) ? kConditionDone : kConditionWorking];
+		
+		if (start >= end)  break;
+		
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		for (i = start; i < end; i++)
+		{
+			NS_DURING
+				_function(i, _context);
+			NS_HANDLER
+				[_lock lock];
+				if (_exception == nil)  _exception = [localException retain];
+				[_lock unlockWithCondition:kConditionWorking];
+			NS_ENDHANDLER
+		}
+		[pool release];
+		
+		[_lock lock];
+		_done += end - start;
+		[_lock unlockWithCondition:(_done == _count) ? kConditionDone : kConditionWorking];
+	}
+}
+
+
+- (void) waitUntilDone
+{
+	[_lock lockWhenCondition:kConditionDone];
+	[_lock unlockWithCondition:kConditionDone];
+}
+
+
+- (NSException *) exception
+{
+	return _exception;
+}
+
+
+- (void) performAsyncTask
+{
+	[self run];
+}
+
+@end
@@ -0,0 +1,122 @@
+/*
+
+OOBroadPhase.h
+
+Broad-phase collision detection using a hashed uniform grid.
+
+Each frame, the universe fills the broad phase with one record per entity
+that can collide: position, collision radius and the entity's index in the
+universe's sorted entity list. -findPairs then buckets the records' bounding
+boxes into grid cells and emits candidate pairs, which are handed to
+-[CollisionRegion findCollisionsWithPairs:count:entities:] for the narrow
+phase.
+
+As with the old linked list filter in -[OOUniverse filterSortedLists], each
+record's box extends twice its collision radius from its centre, so that the
+candidate pairs can be used for proximity warnings as well as collisions.
+
+Records whose box is larger than a grid cell (stations, planets, the sun) are
+not put in the grid; instead they're tested against every other record. There
+are never more than a handful of these.
+
+This class is *not* thread-safe.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define BROAD_PHASE_CELL_SIZE				2048.0f
+#define BROAD_PHASE_RADIUS_FACTOR			2.0f	// Same expansion as filterSortedLists.
+
+
+typedef struct OOBroadPhaseRecord
+{
+	Vector					position;
+	GLfloat					radius;		// Already multiplied by BROAD_PHASE_RADIUS_FACTOR.
+	uint32_t				index;		// Caller-defined, usually index into UNIVERSE->sortedEntities.
+} OOBroadPhaseRecord;
+
+
+typedef struct OOBroadPhasePair
+{
+	uint32_t				a, b;		// Caller-defined indices, as passed to -addRecordAtPosition:radius:index:.
+} OOBroadPhasePair;
+
+
+typedef enum
+{
+	kOOBroadPhaseLinkedLists,			// Old x/y/z linked list filter and collision chains.
+	kOOBroadPhaseGrid,					// OOBroadPhase.
+	kOOBroadPhaseCompare				// Run both, use linked lists for collisions, log pair counts and timings.
+} OOBroadPhaseMode;
+
+
+@interface OOBroadPhase: NSObject
+{
+@private
+	OOBroadPhaseRecord		*_records;
+	NSUInteger				_recordCount,
+							_recordCapacity;
+
+	struct OOBroadPhaseCellEntry *_entries;
+	struct OOBroadPhaseCellEntry *_sortedEntries;
+	NSUInteger				_entryCount,
+							_entryCapacity;
+
+	uint32_t				*_bucketStarts;
+	NSUInteger				_bucketCount;
+
+	uint32_t				*_largeRecords;
+	NSUInteger				_largeCount,
+							_largeCapacity;
+
+	OOBroadPhasePair		*_pairs;
+	NSUInteger				_pairCount,
+							_pairCapacity;
+
+	GLfloat					_cellSize,
+							_inverseCellSize;
+
+	NSUInteger				_boxTests;
+}
+
+- (id) initWithCellSize:(GLfloat)cellSize;	// -init uses BROAD_PHASE_CELL_SIZE.
+
+- (void) removeAllRecords;
+- (void) addRecordAtPosition:(Vector)position radius:(GLfloat)radius index:(uint32_t)index;
+- (NSUInteger) recordCount;
+
+- (void) findPairs;
+
+- (NSUInteger) pairCount;
+- (const OOBroadPhasePair *) pairs;		// Valid until the next -removeAllRecords or -findPairs.
+
+// Statistics for the last -findPairs.
+- (NSUInteger) boxTestCount;
+- (NSUInteger) largeRecordCount;
+
+@end
+
+
+OOBroadPhaseMode OOBroadPhaseModeFromString(NSString *string);
+NSString *OOStringFromBroadPhaseMode(OOBroadPhaseMode mode);
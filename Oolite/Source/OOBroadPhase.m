@@ -0,0 +1,444 @@
+/*
+
+OOBroadPhase.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOBroadPhase.h"
+
+
+enum
+{
+	kMinCapacity				= 64,
+	kMinBucketCount				= 64
+};
+
+
+struct OOBroadPhaseCellEntry
+{
+	int32_t					cx, cy, cz;
+	uint32_t				record;		// Index into _records, not caller-defined index.
+	uint32_t				bucket;
+};
+typedef struct OOBroadPhaseCellEntry OOBroadPhaseCellEntry;
+
+
+static void GrowBuffer(void **buffer, NSUInteger *capacity, NSUInteger needed, size_t elementSize);
+
+OOINLINE int32_t CellCoordinate(GLfloat value, GLfloat inverseCellSize) INLINE_CONST_FUNC;
+OOINLINE uint32_t HashCell(int32_t cx, int32_t cy, int32_t cz) INLINE_CONST_FUNC;
+OOINLINE BOOL BoxesOverlap(const OOBroadPhaseRecord *a, const OOBroadPhaseRecord *b) INLINE_PURE_FUNC;
+
+
+@interface OOBroadPhase (OOPrivate)
+
+- (void) addEntryForRecord:(uint32_t)record cellX:(int32_t)cx y:(int32_t)cy z:(int32_t)cz;
+- (void) addPairForRecord:(uint32_t)ra record:(uint32_t)rb;
+- (void) sortEntriesIntoBuckets;
+- (void) findGridPairs;
+- (void) findLargeRecordPairs;
+
+@end
+
+
+@implementation OOBroadPhase
+
+- (id) init
+{
+	return [self initWithCellSize:BROAD_PHASE_CELL_SIZE];
+}
+
+
+- (id) initWithCellSize:(GLfloat)cellSize
+{
+	if (!(cellSize > 0.0f))
+	{
+		[self release];
+		return nil;
+	}
+
+	if ((self = [super init]))
+	{
+		_cellSize = cellSize;
+		_inverseCellSize = 1.0f / cellSize;
+	}
+
+	return self;
+}
+
+
+- (void) dealloc
+{
+	free(_records);
+	free(_entries);
+	free(_sortedEntries);
+	free(_bucketStarts);
+	free(_largeRecords);
+	free(_pairs);
+
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%lu records, %lu pairs", (unsigned long)_recordCount, (unsigned long)_pairCount];
+}
+
+
+- (void) removeAllRecords
+{
+	_recordCount = 0;
+	_entryCount = 0;
+	_largeCount = 0;
+	_pairCount = 0;
+	_boxTests = 0;
+}
+
+
+- (void) addRecordAtPosition:(Vector)position radius:(GLfloat)radius index:(uint32_t)index
+{
+	if (_recordCount == _recordCapacity)
+	{
+		GrowBuffer((void **)&_records, &_recordCapacity, _recordCount + 1, sizeof *_records);
+	}
+
+	OOBroadPhaseRecord *record = &_records[_recordCount++];
+	record->position = position;
+	record->radius = radius * BROAD_PHASE_RADIUS_FACTOR;
+	record->index = index;
+}
+
+
+- (NSUInteger) recordCount
+{
+	return _recordCount;
+}
+
+
+- (void) findPairs
+{
+	NSUInteger				i;
+	GLfloat					inv = _inverseCellSize;
+
+	_entryCount = 0;
+	_largeCount = 0;
+	_pairCount = 0;
+	_boxTests = 0;
+
+	for (i = 0; i < _recordCount; i++)
+	{
+		const OOBroadPhaseRecord *record = &_records[i];
+		Vector p = record->position;
+		GLfloat r = record->radius;
+
+		int32_t x0 = CellCoordinate(p.x - r, inv), x1 = CellCoordinate(p.x + r, inv);
+		int32_t y0 = CellCoordinate(p.y - r, inv), y1 = CellCoordinate(p.y + r, inv);
+		int32_t z0 = CellCoordinate(p.z - r, inv), z1 = CellCoordinate(p.z + r, inv);
+
+		if (EXPECT_NOT(x1 - x0 > 1 || y1 - y0 > 1 || z1 - z0 > 1 || 2.0f * r > _cellSize))
+		{
+			// Too big for the grid.
+			if (_largeCount == _largeCapacity)
+			{
+				GrowBuffer((void **)&_largeRecords, &_largeCapacity, _largeCount + 1, sizeof *_largeRecords);
+			}
+			_largeRecords[_largeCount++] = i;
+			continue;
+		}
+
+		// Box is at most two cells wide on each axis, so at most eight entries.
+		int32_t cx, cy, cz;
+		for (cx = x0; cx <= x1; cx++)
+		{
+			for (cy = y0; cy <= y1; cy++)
+			{
+				for (cz = z0; cz <= z1; cz++)
+				{
+					[self addEntryForRecord:i cellX:cx y:cy z:cz];
+				}
+			}
+		}
+	}
+
+	[self sortEntriesIntoBuckets];
+	[self findGridPairs];
+	[self findLargeRecordPairs];
+}
+
+
+- (NSUInteger) pairCount
+{
+	return _pairCount;
+}
+
+
+- (const OOBroadPhasePair *) pairs
+{
+	return _pairs;
+}
+
+
+- (NSUInteger) boxTestCount
+{
+	return _boxTests;
+}
+
+
+- (NSUInteger) largeRecordCount
+{
+	return _largeCount;
+}
+
+@end
+
+
+@implementation OOBroadPhase (OOPrivate)
+
+- (void) addEntryForRecord:(uint32_t)record cellX:(int32_t)cx y:(int32_t)cy z:(int32_t)cz
+{
+	if (_entryCount == _entryCapacity)
+	{
+		GrowBuffer((void **)&_entries, &_entryCapacity, _entryCount + 1, sizeof *_entries);
+		
+		// _sortedEntries always has the same capacity as _entries.
+		void *newSorted = realloc(_sortedEntries, _entryCapacity * sizeof *_sortedEntries);
+		if (EXPECT_NOT(newSorted == NULL))
+		{
+			[NSException raise:NSMallocException format:@"Could not expand capacity of OOBroadPhase."];
+		}
+		_sortedEntries = newSorted;
+	}
+
+	OOBroadPhaseCellEntry *entry = &_entries[_entryCount++];
+	entry->cx = cx;
+	entry->cy = cy;
+	entry->cz = cz;
+	entry->record = record;
+}
+
+
+- (void) addPairForRecord:(uint32_t)ra record:(uint32_t)rb
+{
+	if (_pairCount == _pairCapacity)
+	{
+		GrowBuffer((void **)&_pairs, &_pairCapacity, _pairCount + 1, sizeof *_pairs);
+	}
+
+	// Keep pairs in record order so results don't depend on the hash layout.
+	if (rb < ra)
+	{
+		uint32_t temp = ra;
+		ra = rb;
+		rb = temp;
+	}
+
+	_pairs[_pairCount].a = _records[ra].index;
+	_pairs[_pairCount].b = _records[rb].index;
+	_pairCount++;
+}
+
+
+/*	Counting sort of entries by bucket. Buckets are stored as a prefix sum in
+	_bucketStarts, so bucket b occupies
+	_sortedEntries[_bucketStarts[b]] .. _sortedEntries[_bucketStarts[b + 1] - 1].
+*/
+- (void) sortEntriesIntoBuckets
+{
+	NSUInteger				i, bucketCount = kMinBucketCount;
+
+	while (bucketCount < _entryCount * 2)  bucketCount *= 2;
+	if (bucketCount != _bucketCount)
+	{
+		uint32_t *newStarts = realloc(_bucketStarts, (bucketCount + 1) * sizeof *_bucketStarts);
+		if (EXPECT_NOT(newStarts == NULL))
+		{
+			[NSException raise:NSMallocException format:@"Could not expand bucket table of OOBroadPhase."];
+		}
+		_bucketStarts = newStarts;
+		_bucketCount = bucketCount;
+	}
+
+	uint32_t mask = bucketCount - 1;
+	memset(_bucketStarts, 0, (bucketCount + 1) * sizeof *_bucketStarts);
+
+	for (i = 0; i < _entryCount; i++)
+	{
+		OOBroadPhaseCellEntry *entry = &_entries[i];
+		entry->bucket = HashCell(entry->cx, entry->cy, entry->cz) & mask;
+		_bucketStarts[entry->bucket + 1]++;
+	}
+
+	for (i = 0; i < bucketCount; i++)
+	{
+		_bucketStarts[i + 1] += _bucketStarts[i];
+	}
+
+	// Scatter using a second pass over the starts; _bucketStarts[b] is advanced and restored afterwards.
+	for (i = 0; i < _entryCount; i++)
+	{
+		uint32_t bucket = _entries[i].bucket;
+		_sortedEntries[_bucketStarts[bucket]++] = _entries[i];
+	}
+	for (i = bucketCount; i > 0; i--)
+	{
+		_bucketStarts[i] = _bucketStarts[i - 1];
+	}
+	_bucketStarts[0] = 0;
+}
+
+
+/*	A pair of records can share up to eight cells. To report each pair once,
+	a pair is only accepted in the cell containing the minimum corner of the
+	intersection of the two boxes.
+*/
+- (void) findGridPairs
+{
+	NSUInteger				b, i, j;
+	GLfloat					inv = _inverseCellSize;
+
+	for (b = 0; b < _bucketCount; b++)
+	{
+		NSUInteger start = _bucketStarts[b], end = _bucketStarts[b + 1];
+		if (end - start < 2)  continue;
+
+		for (i = start; i < end; i++)
+		{
+			const OOBroadPhaseCellEntry *ei = &_sortedEntries[i];
+			const OOBroadPhaseRecord *ri = &_records[ei->record];
+
+			for (j = i + 1; j < end; j++)
+			{
+				const OOBroadPhaseCellEntry *ej = &_sortedEntries[j];
+
+				// Different cells can share a bucket.
+				if (ei->cx != ej->cx || ei->cy != ej->cy || ei->cz != ej->cz)  continue;
+
+				const OOBroadPhaseRecord *rj = &_records[ej->record];
+				_boxTests++;
+				if (!BoxesOverlap(ri, rj))  continue;
+
+				int32_t mx = CellCoordinate(fmaxf(ri->position.x - ri->radius, rj->position.x - rj->radius), inv);
+				int32_t my = CellCoordinate(fmaxf(ri->position.y - ri->radius, rj->position.y - rj->radius), inv);
+				int32_t mz = CellCoordinate(fmaxf(ri->position.z - ri->radius, rj->position.z - rj->radius), inv);
+				if (mx != ei->cx || my != ei->cy || mz != ei->cz)  continue;
+
+				[self addPairForRecord:ei->record record:ej->record];
+			}
+		}
+	}
+}
+
+
+- (void) findLargeRecordPairs
+{
+	NSUInteger				i, j, k;
+
+	if (_largeCount == 0)  return;
+
+	for (i = 0; i < _largeCount; i++)
+	{
+		uint32_t large = _largeRecords[i];
+		const OOBroadPhaseRecord *rl = &_records[large];
+
+		// Test against every record that isn't large, and against large records later in the list.
+		k = 0;
+		for (j = 0; j < _recordCount; j++)
+		{
+			if (k < _largeCount && _largeRecords[k] == j)
+			{
+				// _largeRecords is in ascending order, so this walks it in step.
+				BOOL later = k > i;
+				k++;
+				if (!later)  continue;
+			}
+
+			_boxTests++;
+			if (BoxesOverlap(rl, &_records[j]))
+			{
+				[self addPairForRecord:large record:j];
+			}
+		}
+	}
+}
+
+@end
+
+
+OOBroadPhaseMode OOBroadPhaseModeFromString(NSString *string)
+{
+	if ([string isEqualToString:@"grid"])  return kOOBroadPhaseGrid;
+	if ([string isEqualToString:@"compare"])  return kOOBroadPhaseCompare;
+	return kOOBroadPhaseLinkedLists;
+}
+
+
+NSString *OOStringFromBroadPhaseMode(OOBroadPhaseMode mode)
+{
+	switch (mode)
+	{
+		case kOOBroadPhaseLinkedLists:	return @"linked-lists";
+		case kOOBroadPhaseGrid:			return @"grid";
+		case kOOBroadPhaseCompare:		return @"compare";
+	}
+
+	return @"linked-lists";
+}
+
+
+static void GrowBuffer(void **buffer, NSUInteger *capacity, NSUInteger needed, size_t elementSize)
+{
+	NSUInteger newCapacity = *capacity * 3 / 2;
+	if (newCapacity < kMinCapacity)  newCapacity = kMinCapacity;
+	if (newCapacity < needed)  newCapacity = needed;
+
+	// Note: realloc(NULL, size) with non-zero size is equivalent to malloc(size), so this is OK starting from a NULL buffer.
+	void *newBuffer = realloc(*buffer, newCapacity * elementSize);
+	if (EXPECT_NOT(newBuffer == NULL))
+	{
+		[NSException raise:NSMallocException format:@"Could not expand capacity of OOBroadPhase."];
+	}
+
+	*buffer = newBuffer;
+	*capacity = newCapacity;
+}
+
+
+OOINLINE int32_t CellCoordinate(GLfloat value, GLfloat inverseCellSize)
+{
+	return (int32_t)floorf(value * inverseCellSize);
+}
+
+
+OOINLINE uint32_t HashCell(int32_t cx, int32_t cy, int32_t cz)
+{
+	// Teschner et al., "Optimized Spatial Hashing for Collision Detection of Deformable Objects".
+	return ((uint32_t)cx * 73856093U) ^ ((uint32_t)cy * 19349663U) ^ ((uint32_t)cz * 83492791U);
+}
+
+
+OOINLINE BOOL BoxesOverlap(const OOBroadPhaseRecord *a, const OOBroadPhaseRecord *b)
+{
+	GLfloat r = a->radius + b->radius;
+	return	fabsf(a->position.x - b->position.x) < r &&
+			fabsf(a->position.y - b->position.y) < r &&
+			fabsf(a->position.z - b->position.z) < r;
+}
@@ -0,0 +1,76 @@
+/*
+
+OOConcurrentEntityUpdater.h
+
+Runs -update: for entities which declare themselves safe to update
+concurrently (-[OOEntity canUpdateConcurrently]), spread over the
+OOAsyncWorkManager worker threads and the main thread by OORunIndexedTasks().
+
+The entities are split into small chunks which each thread claims in turn
+until none are left, so a thread that gets stuck on an expensive entity
+doesn't hold up the others. -updateEntities:count:delta: returns when every
+entity has been updated. Small batches, or any batch on a single-CPU
+machine, are simply updated in order on the calling thread.
+
+While a concurrent batch is running, -[OOUniverse removeEntity:] must not
+touch the universe; instead it hands the entity to -deferRemovalOfEntity:,
+and the universe removes it after the batch has finished.
+
+If an entity's -update: raises an exception, the remaining entities are
+still updated and the first exception is re-raised on the calling thread.
+
+-updateEntities:count:delta: must only be called on the main thread.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+#import "OOTypes.h"
+
+@class OOEntity;
+
+
+#define CONCURRENT_UPDATE_MIN_ENTITIES		64		// Below this, updating on the main thread is faster.
+#define CONCURRENT_UPDATE_CHUNK_SIZE		16
+#define CONCURRENT_UPDATE_MAX_WORKERS		7		// Plus the main thread.
+
+
+@interface OOConcurrentEntityUpdater: NSObject
+{
+@private
+	BOOL					_updating;
+
+	NSMutableArray			*_deferredRemovals;
+	NSLock					*_deferredRemovalsLock;
+}
+
+- (void) updateEntities:(OOEntity **)entities count:(NSUInteger)count delta:(OOTimeDelta)delta_t;
+
+// YES while a concurrent batch is running.
+- (BOOL) isUpdating;
+
+// Thread-safe. Only valid while -isUpdating.
+- (void) deferRemovalOfEntity:(OOEntity *)entity;
+
+// Entities passed to -deferRemovalOfEntity: since the last call, or nil.
+- (NSArray *) takeDeferredRemovals;
+
+@end
@@ -0,0 +1,130 @@
+/*
+
+OOConcurrentEntityUpdater.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOConcurrentEntityUpdater.h"
+#import "OOAsyncWorkManager.h"
+#import "OOEntity.h"
+
+
+typedef struct
+{
+	OOEntity				**entities;
+	OOTimeDelta				deltaT;
+} UpdateContext;
+
+
+static void UpdateEntity(NSUInteger index, void *context);
+
+
+@implementation OOConcurrentEntityUpdater
+
+- (id) init
+{
+	if ((self = [super init]))
+	{
+		_deferredRemovals = [[NSMutableArray alloc] init];
+		_deferredRemovalsLock = [[NSLock alloc] init];
+		if (_deferredRemovals == nil || _deferredRemovalsLock == nil)
+		{
+			[self release];
+			return nil;
+		}
+	}
+
+	return self;
+}
+
+
+- (void) dealloc
+{
+	DESTROY(_deferredRemovals);
+	DESTROY(_deferredRemovalsLock);
+
+	[super dealloc];
+}
+
+
+- (void) updateEntities:(OOEntity **)entities count:(NSUInteger)count delta:(OOTimeDelta)delta_t
+{
+	NSUInteger				i;
+	UpdateContext			context = { entities, delta_t };
+
+	NSAssert(!_updating, @"Concurrent entity updates may not be nested.");
+
+	if (count < CONCURRENT_UPDATE_MIN_ENTITIES)
+	{
+		for (i = 0; i < count; i++)  [entities[i] update:delta_t];
+		return;
+	}
+
+	_updating = YES;
+	NS_DURING
+		OORunIndexedTasks(count, CONCURRENT_UPDATE_CHUNK_SIZE, CONCURRENT_UPDATE_MAX_WORKERS, UpdateEntity, &context);
+	NS_HANDLER
+		_updating = NO;
+		[localException raise];
+	NS_ENDHANDLER
+	_updating = NO;
+}
+
+
+- (BOOL) isUpdating
+{
+	return _updating;
+}
+
+
+- (void) deferRemovalOfEntity:(OOEntity *)entity
+{
+	if (entity == nil)  return;
+
+	[_deferredRemovalsLock lock];
+	[_deferredRemovals addObject:entity];
+	[_deferredRemovalsLock unlock];
+}
+
+
+- (NSArray *) takeDeferredRemovals
+{
+	NSArray *result = nil;
+
+	[_deferredRemovalsLock lock];
+	if ([_deferredRemovals count] != 0)
+	{
+		result = [[_deferredRemovals copy] autorelease];
+		[_deferredRemovals removeAllObjects];
+	}
+	[_deferredRemovalsLock unlock];
+
+	return result;
+}
+
+@end
+
+
+static void UpdateEntity(NSUInteger index, void *context)
+{
+	UpdateContext *update = context;
+	[update->entities[index] update:update->deltaT];
+}
@@ -0,0 +1,170 @@
+/*
+
+OOEntityHotState.h
+
+Packed copy of the kinematic state of the entities in the universe.
+
+The universe keeps each entity's position, velocity, collision radius and
+distance from the player in structure-of-arrays form, indexed by a slot
+number which is stable for as long as the entity is in the universe. Scans
+over every entity (range queries, the zero-distance sort and the grid broad
+phase) can then sweep contiguous floats instead of visiting each entity
+object, and only look at the entities that pass the test.
+
+The entity's own ivars remain authoritative, but once an entity is in the
+universe they must only be changed through OOEntity's position, velocity
+and collision radius setters, which update its slot as well. (Initializers
+may set the ivars directly, since the entity has no slot yet.) The whole
+slot is also refreshed by -[OOEntity storeHotState:] when the entity is
+added and after each update.
+
+Entities updated on worker threads by OOConcurrentEntityUpdater only write
+their own slot, but may race on drift; this is harmless, since the
+universe stores each of them again on the main thread once the batch is
+done, which notes their drift afresh.
+
+Slots are handed out from a fixed capacity, which for the universe is
+UNIVERSE_MAX_ENTITIES.
+
+Spatial indices built from the hot state (OOSpatialIndex) call
+-markSlots:count: when they're rebuilt. From then on, the hot state tracks
+how far any marked slot has drifted from its marked position, or grown
+beyond its marked radius, so that the index can widen its searches instead
+of being rebuilt after every change. Slots allocated since the mark are
+listed by -unmarkedSlots.
+
+This class is *not* thread-safe.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+typedef uint32_t OOEntityStateSlot;
+
+enum
+{
+	kOOEntityStateNoSlot		= UINT32_MAX
+};
+
+
+@interface OOEntityHotState: NSObject
+{
+@public
+	// Each array has -capacity elements; only [0, -slotLimit) is meaningful.
+	GLfloat					*x, *y, *z;
+	GLfloat					*vx, *vy, *vz;
+	GLfloat					*radius;
+	GLfloat					*zeroDistance;
+	uint8_t					*canCollide;		// Refreshed by the broad phase; -canCollide depends on status and time.
+	uint8_t					*live;				// YES for allocated slots.
+
+	// State at the last -markSlots:count:, and the largest change since.
+	GLfloat					*markX, *markY, *markZ, *markRadius;
+	uint8_t					*marked;
+	GLfloat					drift;
+
+@private
+	NSUInteger				_capacity;
+	NSUInteger				_slotLimit;
+
+	OOEntityStateSlot		*_freeSlots;
+	NSUInteger				_freeCount;
+
+	OOEntityStateSlot		*_unmarkedSlots;
+	NSUInteger				_unmarkedCount;
+	uint8_t					*_unmarkedListed;
+}
+
+- (id) initWithCapacity:(NSUInteger)capacity;
+
+- (OOEntityStateSlot) allocateSlot;	// Returns kOOEntityStateNoSlot if full.
+- (void) freeSlot:(OOEntityStateSlot)slot;
+
+- (NSUInteger) capacity;
+- (NSUInteger) slotLimit;			// One more than the highest slot handed out; sweeps cover [0, slotLimit).
+- (NSUInteger) liveSlotCount;
+
+/*	Sweeps. The output arrays must have room for -slotLimit elements. Values
+	for free slots are meaningless.
+
+	-getDistancesSquaredFrom:into: gives the squared distance from point to
+	each slot's position.
+	-getRangeTestsFrom:range:into: gives distance² - (range + radius)², which
+	is negative for entities within range of point, as used by
+	-[OOUniverse findEntitiesMatchingPredicate:parameter:inRange:ofEntity:].
+*/
+- (void) getDistancesSquaredFrom:(Vector)point into:(GLfloat *)outDistances;
+- (void) getRangeTestsFrom:(Vector)point range:(GLfloat)range into:(GLfloat *)outTests;
+
+/*	Record the current position and radius of the given slots, reset drift
+	to zero, and forget the unmarked slots list.
+*/
+- (void) markSlots:(const OOEntityStateSlot *)slots count:(NSUInteger)count;
+
+// Slots allocated since the last -markSlots:count:, each listed once. Some may have been freed since.
+- (const OOEntityStateSlot *) unmarkedSlots;
+- (NSUInteger) unmarkedSlotCount;
+
+@end
+
+
+OOINLINE void OOEntityHotStateNoteDrift(OOEntityHotState *state, OOEntityStateSlot slot)
+{
+	if (!state->marked[slot])  return;
+
+	GLfloat d = fabsf(state->x[slot] - state->markX[slot]);
+	d = fmaxf(d, fabsf(state->y[slot] - state->markY[slot]));
+	d = fmaxf(d, fabsf(state->z[slot] - state->markZ[slot]));
+	d = fmaxf(d, state->radius[slot] - state->markRadius[slot]);
+	if (d > state->drift)  state->drift = d;
+}
+
+
+OOINLINE void OOEntityHotStateSetPosition(OOEntityHotState *state, OOEntityStateSlot slot, Vector position)
+{
+	state->x[slot] = position.x;
+	state->y[slot] = position.y;
+	state->z[slot] = position.z;
+	OOEntityHotStateNoteDrift(state, slot);
+}
+
+
+OOINLINE void OOEntityHotStateSetRadius(OOEntityHotState *state, OOEntityStateSlot slot, GLfloat radius)
+{
+	state->radius[slot] = radius;
+	OOEntityHotStateNoteDrift(state, slot);
+}
+
+
+OOINLINE void OOEntityHotStateSetVelocity(OOEntityHotState *state, OOEntityStateSlot slot, Vector velocity)
+{
+	state->vx[slot] = velocity.x;
+	state->vy[slot] = velocity.y;
+	state->vz[slot] = velocity.z;
+}
+
+
+OOINLINE Vector OOEntityHotStateGetPosition(OOEntityHotState *state, OOEntityStateSlot slot)
+{
+	return make_vector(state->x[slot], state->y[slot], state->z[slot]);
+}
@@ -0,0 +1,248 @@
+/*
+
+OOEntityHotState.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOEntityHotState.h"
+
+
+@implementation OOEntityHotState
+
+- (id) init
+{
+	return [self initWithCapacity:0];
+}
+
+
+- (id) initWithCapacity:(NSUInteger)capacity
+{
+	if (capacity == 0 || capacity > kOOEntityStateNoSlot)
+	{
+		[self release];
+		return nil;
+	}
+
+	if ((self = [super init]))
+	{
+		_capacity = capacity;
+
+		x = calloc(capacity, sizeof *x);
+		y = calloc(capacity, sizeof *y);
+		z = calloc(capacity, sizeof *z);
+		vx = calloc(capacity, sizeof *vx);
+		vy = calloc(capacity, sizeof *vy);
+		vz = calloc(capacity, sizeof *vz);
+		radius = calloc(capacity, sizeof *radius);
+		zeroDistance = calloc(capacity, sizeof *zeroDistance);
+		canCollide = calloc(capacity, sizeof *canCollide);
+		live = calloc(capacity, sizeof *live);
+		markX = calloc(capacity, sizeof *markX);
+		markY = calloc(capacity, sizeof *markY);
+		markZ = calloc(capacity, sizeof *markZ);
+		markRadius = calloc(capacity, sizeof *markRadius);
+		marked = calloc(capacity, sizeof *marked);
+		_freeSlots = malloc(capacity * sizeof *_freeSlots);
+		_unmarkedSlots = malloc(capacity * sizeof *_unmarkedSlots);
+		_unmarkedListed = calloc(capacity, sizeof *_unmarkedListed);
+
+		if (x == NULL || y == NULL || z == NULL ||
+			vx == NULL || vy == NULL || vz == NULL ||
+			radius == NULL || zeroDistance == NULL ||
+			canCollide == NULL || live == NULL || markX == NULL ||
+			markY == NULL || markZ == NULL ||
+			markRadius == NULL || marked == NULL ||
+			_freeSlots == NULL || _unmarkedSlots == NULL ||
+			_unmarkedListed == NULL)
+		{
+			[self release];
+			return nil;
+		}
+	}
+
+	return self;
+}
+
+
+- (void) dealloc
+{
+	free(x);
+	free(y);
+	free(z);
+	free(vx);
+	free(vy);
+	free(vz);
+	free(radius);
+	free(zeroDistance);
+	free(canCollide);
+	free(live);
+	free(markX);
+	free(markY);
+	free(markZ);
+	free(markRadius);
+	free(marked);
+	free(_freeSlots);
+	free(_unmarkedSlots);
+	free(_unmarkedListed);
+
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%lu of %lu slots in use", (unsigned long)[self liveSlotCount], (unsigned long)_capacity];
+}
+
+
+- (OOEntityStateSlot) allocateSlot
+{
+	OOEntityStateSlot		slot;
+
+	// Reuse the most recently freed slot, so that the live slots stay packed below _slotLimit.
+	if (_freeCount != 0)  slot = _freeSlots[--_freeCount];
+	else if (_slotLimit < _capacity)  slot = _slotLimit++;
+	else  return kOOEntityStateNoSlot;
+
+	x[slot] = y[slot] = z[slot] = 0.0f;
+	vx[slot] = vy[slot] = vz[slot] = 0.0f;
+	radius[slot] = 0.0f;
+	zeroDistance[slot] = 0.0f;
+	canCollide[slot] = NO;
+	live[slot] = YES;
+	marked[slot] = NO;
+
+	if (!_unmarkedListed[slot])
+	{
+		_unmarkedListed[slot] = YES;
+		_unmarkedSlots[_unmarkedCount++] = slot;
+	}
+
+	return slot;
+}
+
+
+- (void) freeSlot:(OOEntityStateSlot)slot
+{
+	if (EXPECT_NOT(slot >= _slotLimit || !live[slot]))  return;
+
+	canCollide[slot] = NO;
+	live[slot] = NO;
+	marked[slot] = NO;
+
+	if (slot == _slotLimit - 1)
+	{
+		_slotLimit--;
+	}
+	else
+	{
+		NSAssert(_freeCount < _capacity, @"OOEntityHotState free list overflow.");
+		_freeSlots[_freeCount++] = slot;
+	}
+}
+
+
+- (NSUInteger) capacity
+{
+	return _capacity;
+}
+
+
+- (NSUInteger) slotLimit
+{
+	return _slotLimit;
+}
+
+
+- (NSUInteger) liveSlotCount
+{
+	// The limit only drops when its top slot is freed, so free-listed slots are always below it.
+	return _slotLimit - _freeCount;
+}
+
+
+- (void) getDistancesSquaredFrom:(Vector)point into:(GLfloat *)outDistances
+{
+	NSUInteger		i, count = _slotLimit;
+	const GLfloat	*px = x, *py = y, *pz = z;
+	GLfloat			ox = point.x, oy = point.y, oz = point.z;
+
+	// Straight-line loop over packed arrays so the compiler can vectorize it.
+	for (i = 0; i < count; i++)
+	{
+		GLfloat dx = px[i] - ox;
+		GLfloat dy = py[i] - oy;
+		GLfloat dz = pz[i] - oz;
+		outDistances[i] = dx * dx + dy * dy + dz * dz;
+	}
+}
+
+
+- (void) getRangeTestsFrom:(Vector)point range:(GLfloat)range into:(GLfloat *)outTests
+{
+	NSUInteger		i, count = _slotLimit;
+	const GLfloat	*px = x, *py = y, *pz = z, *pr = radius;
+	GLfloat			ox = point.x, oy = point.y, oz = point.z;
+
+	for (i = 0; i < count; i++)
+	{
+		GLfloat dx = px[i] - ox;
+		GLfloat dy = py[i] - oy;
+		GLfloat dz = pz[i] - oz;
+		GLfloat cr = range + pr[i];
+		outTests[i] = dx * dx + dy * dy + dz * dz - cr * cr;
+	}
+}
+
+
+- (void) markSlots:(const OOEntityStateSlot *)slots count:(NSUInteger)count
+{
+	NSUInteger			i;
+
+	for (i = 0; i < count; i++)
+	{
+		OOEntityStateSlot slot = slots[i];
+		markX[slot] = x[slot];
+		markY[slot] = y[slot];
+		markZ[slot] = z[slot];
+		markRadius[slot] = radius[slot];
+		marked[slot] = YES;
+	}
+
+	for (i = 0; i < _unmarkedCount; i++)  _unmarkedListed[_unmarkedSlots[i]] = NO;
+
+	drift = 0.0f;
+	_unmarkedCount = 0;
+}
+
+
+- (const OOEntityStateSlot *) unmarkedSlots
+{
+	return _unmarkedSlots;
+}
+
+
+- (NSUInteger) unmarkedSlotCount
+{
+	return _unmarkedCount;
+}
+
+@end
@@ -322,6 +322,7 @@ static BOOL _switchRez = NO, _switchRezDeferred = NO;
 		[[self soundContext] update];
 	
 		OOJSFrameCallbacksInvoke(delta_t);
+		[[OoliteLogOutputHandler sharedLogOutputHandler] reclaimRetiredFilterSnapshots];
 		
 #if OOLITE_HAVE_APPKIT
 		if (fullscreen)
@@ -38,7 +38,7 @@ MA 02110-1301, USA.
 #import "OOLegacyOpenGL.h"
 #import "OOOpenGLExtensionManager.h"
 
-@class OOLegacyMaterial, Octree;
+@class OOLegacyMaterial, Octree, Geometry;
 
 
 #define OOMESH_PROFILE	0
@@ -143,6 +143,12 @@ materialDictionary:(NSDictionary *)materialDict
 	  shaderMacros:(NSDictionary *)macros
 shaderBindingTarget:(id<OOWeakReferenceSupport>)object;
 
+/*	Load just the geometry of a model, without setting up materials or
+	graphics state, for building its octree ahead of time. Returns nil if the
+	model can't be loaded. Main thread only, since it uses the mesh cache.
+*/
++ (Geometry *)octreeGeometryForModel:(NSString *)name smooth:(BOOL)smooth octreeDepth:(unsigned *)outDepth;
+
 + (OOLegacyMaterial *)placeholderMaterial;
 
 - (NSString *) modelName;
@@ -174,5 +180,9 @@ shaderBindingTarget:(id<OOWeakReferenceSupport>)object;
 
 + (Octree *)octreeForModel:(NSString *)inKey;
 + (void)setOctree:(Octree *)inOctree forModel:(NSString *)inKey;
++ (BOOL)hasOctreeForModel:(NSString *)inKey;
+
+// Adds several octrees at once, keyed by model name, in sorted key order.
++ (void)setOctrees:(NSDictionary *)inOctrees;
 
 @end
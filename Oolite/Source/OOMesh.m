@@ -139,6 +139,8 @@ materialDictionary:(NSDictionary *)materialDict
 	  shaderMacros:(NSDictionary *)macros
 shaderBindingTarget:(id<OOWeakReferenceSupport>)object;
 
+- (id)initForOctreeWithName:(NSString *)name smooth:(BOOL)smooth;
+
 - (BOOL) loadData:(NSString *)filename;
 - (void) checkNormalsAndAdjustWinding;
 - (void) generateFaceTangents;
@@ -180,11 +182,14 @@ shaderBindingTarget:(id<OOWeakReferenceSupport>)object;
 @interface OOCacheManager (OOMesh)
 
 + (NSDictionary *)meshDataForName:(NSString *)inShipName;
-+ (void)setMeshData:(NSDictionary *)inData forName:(NSString *)inShipName;
++ (void)setMeshData:(NSDictionary *)inData forName:(NSString *)inShipName sourceFile:(NSString *)inPath;
 
 @end
 
 
+static NSString *ModelPath(NSString *modelName);
+
+
 static BOOL IsLegacyNormalMode(OOMeshNormalMode mode)
 {
 	/*	True for modes that predate the "normal mode" concept, i.e. per-face
@@ -665,69 +670,69 @@ static NSString *NormalModeDescription(OOMeshNormalMode mode)
 }
 
 
++ (Geometry *)octreeGeometryForModel:(NSString *)name smooth:(BOOL)smooth octreeDepth:(unsigned *)outDepth
+{
+	OOMesh				*mesh = nil;
+	Geometry			*result = nil;
+	
+	NSParameterAssert(outDepth != NULL);
+	
+	mesh = [[self alloc] initForOctreeWithName:name smooth:smooth];
+	if (mesh != nil)
+	{
+		result = [mesh geometry];
+		*outDepth = [mesh octreeDepth];
+		[mesh release];
+	}
+	
+	return result;
+}
+
+
 - (OOBoundingBox) findBoundingBoxRelativeToPosition:(Vector)opv
 											  basis:(Vector)ri :(Vector)rj :(Vector)rk
 									   selfPosition:(Vector)position
 										  selfBasis:(Vector)si :(Vector)sj :(Vector)sk
 {
 	OOBoundingBox	result;
-	Vector			pv, rv;
+	Vector			rpos, rv;
+	OOMatrix		m;
 	
-	// FIXME: rewrite with matrices
-	Vector rpos = vector_subtract(position, opv);	// model origin relative to opv
-	
-	rv.x = dot_product(ri,rpos);
-	rv.y = dot_product(rj,rpos);
-	rv.z = dot_product(rk,rpos);	// model origin rel to opv in ijk
+	rpos = vector_subtract(position, opv);	// model origin relative to opv
 	
 	if (EXPECT_NOT(vertexCount < 1))
 	{
+		rv.x = dot_product(ri, rpos);
+		rv.y = dot_product(rj, rpos);
+		rv.z = dot_product(rk, rpos);	// model origin rel to opv in ijk
 		OOBoundingBoxResetToVector(&result, rv);
-	}
-	else
-	{
-		pv.x = rpos.x + si.x * _vertices[0].x + sj.x * _vertices[0].y + sk.x * _vertices[0].z;
-		pv.y = rpos.y + si.y * _vertices[0].x + sj.y * _vertices[0].y + sk.y * _vertices[0].z;
-		pv.z = rpos.z + si.z * _vertices[0].x + sj.z * _vertices[0].y + sk.z * _vertices[0].z;	// _vertices[0] position rel to opv
-		rv.x = dot_product(ri, pv);
-		rv.y = dot_product(rj, pv);
-		rv.z = dot_product(rk, pv);	// _vertices[0] position rel to opv in ijk
-		OOBoundingBoxResetToVector(&result, rv);
+		return result;
 	}
 	
-	OOMeshVertexCount i;
-	for (i = 1; i < vertexCount; i++)
-	{
-		pv.x = rpos.x + si.x * _vertices[i].x + sj.x * _vertices[i].y + sk.x * _vertices[i].z;
-		pv.y = rpos.y + si.y * _vertices[i].x + sj.y * _vertices[i].y + sk.y * _vertices[i].z;
-		pv.z = rpos.z + si.z * _vertices[i].x + sj.z * _vertices[i].y + sk.z * _vertices[i].z;
-		rv.x = dot_product(ri, pv);
-		rv.y = dot_product(rj, pv);
-		rv.z = dot_product(rk, pv);
-		OOBoundingBoxAddVector(&result, rv);
-	}
-
-	return result;
+	/*	A vertex v is at rpos + v.x * si + v.y * sj + v.z * sk relative to opv.
+		Projecting that onto ri, rj and rk is an affine transformation.
+	*/
+	m = OOMatrixConstruct(dot_product(ri, si), dot_product(rj, si), dot_product(rk, si), 0.0f,
+						  dot_product(ri, sj), dot_product(rj, sj), dot_product(rk, sj), 0.0f,
+						  dot_product(ri, sk), dot_product(rj, sk), dot_product(rk, sk), 0.0f,
+						  dot_product(ri, rpos), dot_product(rj, rpos), dot_product(rk, rpos), 1.0f);
+	
+	return OOBatchBoundingBoxOfTransformedVectors(_vertices, vertexCount, m);
 }
 
 
 - (OOBoundingBox)findSubentityBoundingBoxWithPosition:(Vector)position rotMatrix:(OOMatrix)rotMatrix
 {
 	// HACK! Should work out what the various bounding box things do and make it neat and consistent.
-	// FIXME: this is a bottleneck.
 	
 	OOBoundingBox		result;
-	Vector			v;
 	
-	v = vector_add(position, OOVectorMultiplyMatrix(_vertices[0], rotMatrix));
-	OOBoundingBoxResetToVector(&result,v);
+	result = OOBatchBoundingBoxOfTransformedVectors(_vertices, vertexCount, rotMatrix);
+	if (vertexCount == 0)  OOBoundingBoxResetToVector(&result, OOVectorMultiplyMatrix(kZeroVector, rotMatrix));
 	
-	OOMeshVertexCount i;
-	for (i = 1; i < vertexCount; i++)
-	{
-		v = vector_add(position, OOVectorMultiplyMatrix(_vertices[i], rotMatrix));
-		OOBoundingBoxAddVector(&result,v);
-	}
+	// Adding after taking the min and max gives the same result, since rounding is monotonic.
+	result.min = vector_add(result.min, position);
+	result.max = vector_add(result.max, position);
 	
 	return result;
 }
@@ -876,6 +881,32 @@ shaderBindingTarget:(id<OOWeakReferenceSupport>)target
 }
 
 
+- (id)initForOctreeWithName:(NSString *)name smooth:(BOOL)smooth
+{
+	self = [super init];
+	if (self == nil)  return nil;
+	
+	_normalMode = smooth ? kNormalModeSmooth : kNormalModePerFace;
+#if OO_MULTITEXTURE
+	_textureUnitCount = NSNotFound;
+#endif
+	
+	// Same cache entries as a full load, so the mesh data is ready when the model is actually used.
+	if ([self loadData:name])
+	{
+		[self calculateBoundingVolumes];
+		baseFile = [name copy];
+	}
+	else
+	{
+		[self release];
+		self = nil;
+	}
+	
+	return self;
+}
+
+
 - (id)mutableCopyWithZone:(NSZone *)zone
 {
 	OOMesh				*result = nil;
@@ -1107,9 +1138,11 @@ shaderBindingTarget:(id<OOWeakReferenceSupport>)target
 	unsigned			i, j;
 	NSMutableDictionary	*texFileName2Idx = nil;
 	NSString			*cacheKey = nil;
+	NSString			*path = nil;
 	BOOL				using_preloaded = NO;
 	
-	cacheKey = [NSString stringWithFormat:@"%@:%u", filename, _normalMode];
+	path = ModelPath(filename);
+	cacheKey = [NSString stringWithFormat:@"%@:%u", (path != nil) ? path : filename, _normalMode];
 	cacheData = [OOCacheManager meshDataForName:cacheKey];
 	if (cacheData != nil)
 	{
@@ -1555,7 +1588,7 @@ shaderBindingTarget:(id<OOWeakReferenceSupport>)target
 		}
 		
 		// save the resulting data for possible reuse
-		[OOCacheManager setMeshData:[self modelData] forName:cacheKey];
+		[OOCacheManager setMeshData:[self modelData] forName:cacheKey sourceFile:path];
 		PROFILE(@"saved to cache");
 		
 		if (failFlag)
@@ -2144,6 +2177,17 @@ static void Scribble(void *bytes, size_t size)
 @end
 
 
+/*	Cached meshes and octrees are keyed by the path the model is loaded from,
+	and depend on that file. This way they survive expansion packs being added
+	or removed, but not one overriding or changing the model.
+*/
+static NSString *ModelPath(NSString *modelName)
+{
+	if (modelName == nil)  return nil;
+	return [ResourceManager pathForFileNamed:modelName inFolder:@"Models"];
+}
+
+
 static NSString * const kOOCacheMeshes = @"OOMesh";
 
 @implementation OOCacheManager (OOMesh)
@@ -2154,11 +2198,12 @@ static NSString * const kOOCacheMeshes = @"OOMesh";
 }
 
 
-+ (void)setMeshData:(NSDictionary *)inData forName:(NSString *)inShipName
++ (void)setMeshData:(NSDictionary *)inData forName:(NSString *)inShipName sourceFile:(NSString *)inPath
 {
 	if (inData != nil && inShipName != nil)
 	{
-		[[self sharedCache] setObject:inData forKey:inShipName inCache:kOOCacheMeshes];
+		// Entries of the mesh cache without a dependency record are discarded, so one with no known source gets an empty record.
+		[[self sharedCache] setObject:inData forKey:inShipName inCache:kOOCacheMeshes dependingOnFiles:(inPath != nil) ? [NSArray arrayWithObject:inPath] : [NSArray array]];
 	}
 }
 
@@ -2171,12 +2216,14 @@ static NSString * const kOOCacheOctrees = @"octrees";
 
 + (Octree *)octreeForModel:(NSString *)inKey
 {
+	NSString			*path = nil;
 	NSDictionary		*dict = nil;
 	Octree				*result = nil;
 	
-	if (inKey == nil)  return nil;
+	path = ModelPath(inKey);
+	if (path == nil)  return nil;
 	
-	dict = [[self sharedCache] objectForKey:inKey inCache:kOOCacheOctrees];
+	dict = [[self sharedCache] objectForKey:path inCache:kOOCacheOctrees];
 	if (dict != nil)
 	{
 		result = [[Octree alloc] initWithDictionary:dict];
@@ -2189,9 +2236,31 @@ static NSString * const kOOCacheOctrees = @"octrees";
 
 + (void)setOctree:(Octree *)inOctree forModel:(NSString *)inKey
 {
-	if (inOctree != nil && inKey != nil)
+	NSString			*path = ModelPath(inKey);
+	
+	if (inOctree != nil && path != nil)
+	{
+		[[self sharedCache] setObject:[inOctree dictionaryRepresentation] forKey:path inCache:kOOCacheOctrees dependingOnFiles:[NSArray arrayWithObject:path]];
+	}
+}
+
+
++ (BOOL)hasOctreeForModel:(NSString *)inKey
+{
+	NSString			*path = ModelPath(inKey);
+	
+	if (path == nil)  return NO;
+	return [[self sharedCache] objectForKey:path inCache:kOOCacheOctrees] != nil;
+}
+
+
++ (void)setOctrees:(NSDictionary *)inOctrees
+{
+	NSString			*key = nil;
+	
+	foreach (key, [[inOctrees allKeys] sortedArrayUsingSelector:@selector(compare:)])
 	{
-		[[self sharedCache] setObject:[inOctree dictionaryRepresentation] forKey:inKey inCache:kOOCacheOctrees];
+		[self setOctree:[inOctrees objectForKey:key] forModel:key];
 	}
 }
 
@@ -0,0 +1,59 @@
+/*
+
+OOOctreeBatchBuilder.h
+
+Builds the octrees for all ship models at once, in parallel.
+
+Normally a model's octree is generated the first time a ship using it is set
+up, on the main thread, and then cached. With a cold cache and many OXPs
+installed, that adds up to a lot of time. +buildMissingOctreesForShipRegistry:
+finds every model used by a ship in the registry whose octree isn't cached,
+loads their geometry on the main thread (mesh loading uses the cache, which
+isn't thread-safe), then generates the octrees on the OOAsyncWorkManager
+worker threads and the main thread together. Each octree depends only on its
+model's geometry, so the results are the same as building them one at a
+time; they are added to the cache together, in model name order, once all
+are done.
+
+Models are loaded with the smooth setting of the first ship using them, in
+ship key order. Octrees of models that are only used rescaled (with
+model_scale_factor) are built but not used, since rescaled meshes build
+their own octrees.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+@class OOShipRegistry;
+
+
+#define OCTREE_BATCH_MAX_WORKERS			7		// Plus the main thread.
+
+
+@interface OOOctreeBatchBuilder: NSObject
+
+/*	Returns the number of octrees built. Must be called on the main thread,
+	and returns when they have all been added to the cache.
+*/
++ (NSUInteger) buildMissingOctreesForShipRegistry:(OOShipRegistry *)registry;
+
+@end
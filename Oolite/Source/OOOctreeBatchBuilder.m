@@ -0,0 +1,165 @@
+/*
+
+OOOctreeBatchBuilder.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOOctreeBatchBuilder.h"
+#import "OOAsyncWorkManager.h"
+#import "OOShipRegistry.h"
+#import "OOShipClass.h"
+#import "OOMesh.h"
+#import "Geometry.h"
+#import "Octree.h"
+#import "OOProfilingStopwatch.h"
+
+
+static NSString * const kOOLogOctreeBatch			= @"mesh.load.octree.batch";
+static NSString * const kOOLogOctreeBatchFailed		= @"mesh.load.octree.batch.failed";
+
+
+typedef struct
+{
+	NSString				*modelName;
+	Geometry				*geometry;
+	unsigned				depth;
+	Octree					*octree;
+} OOOctreeJob;
+
+
+static void BuildOctree(NSUInteger index, void *context);
+
+
+@implementation OOOctreeBatchBuilder
+
++ (NSUInteger) buildMissingOctreesForShipRegistry:(OOShipRegistry *)registry
+{
+	NSMutableDictionary		*smoothByModel = nil;
+	NSArray					*modelNames = nil;
+	NSString				*shipKey = nil;
+	NSString				*modelName = nil;
+	OOOctreeJob				*jobs = NULL;
+	NSUInteger				i, jobCount = 0;
+	NSMutableDictionary		*octrees = nil;
+	
+	if (registry == nil)  return 0;
+	
+	OOHighResTimeValue start = OOGetHighResTime();
+	
+	// Sorted, so that which ship's smooth setting is used doesn't depend on hash order.
+	smoothByModel = [NSMutableDictionary dictionary];
+	foreach (shipKey, [[registry shipKeys] sortedArrayUsingSelector:@selector(compare:)])
+	{
+		OOShipClass *shipClass = [registry shipClassForKey:shipKey];
+		BOOL smooth;
+		
+		if (shipClass != nil)
+		{
+			modelName = [shipClass modelName];
+			smooth = [shipClass smooth];
+		}
+		else
+		{
+			NSDictionary *shipInfo = [registry shipInfoForKey:shipKey];
+			modelName = [shipInfo oo_stringForKey:@"model"];
+			smooth = [shipInfo oo_boolForKey:@"smooth"];
+		}
+		
+		if (modelName == nil || [smoothByModel objectForKey:modelName] != nil)  continue;
+		[smoothByModel setObject:[NSNumber numberWithBool:smooth] forKey:modelName];
+	}
+	
+	modelNames = [[smoothByModel allKeys] sortedArrayUsingSelector:@selector(compare:)];
+	jobs = calloc([modelNames count], sizeof *jobs);
+	if (EXPECT_NOT(jobs == NULL && [modelNames count] != 0))
+	{
+		OODisposeHighResTime(start);
+		return 0;
+	}
+	
+	foreach (modelName, modelNames)
+	{
+		if ([OOCacheManager hasOctreeForModel:modelName])  continue;
+		
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		unsigned depth = 0;
+		Geometry *geometry = [OOMesh octreeGeometryForModel:modelName
+													 smooth:[smoothByModel oo_boolForKey:modelName]
+												octreeDepth:&depth];
+		if (geometry != nil)
+		{
+			jobs[jobCount].modelName = [modelName copy];
+			jobs[jobCount].geometry = [geometry retain];
+			jobs[jobCount].depth = depth;
+			jobCount++;
+		}
+		[pool release];
+	}
+	
+	if (jobCount == 0)
+	{
+		free(jobs);
+		OODisposeHighResTime(start);
+		return 0;
+	}
+	
+	OOHighResTimeValue loaded = OOGetHighResTime();
+	
+	OORunIndexedTasks(jobCount, 1, OCTREE_BATCH_MAX_WORKERS, BuildOctree, jobs);
+	
+	octrees = [NSMutableDictionary dictionaryWithCapacity:jobCount];
+	for (i = 0; i < jobCount; i++)
+	{
+		if (jobs[i].octree != nil)  [octrees setObject:jobs[i].octree forKey:jobs[i].modelName];
+		[jobs[i].modelName release];
+		[jobs[i].octree release];
+	}
+	free(jobs);
+	[OOCacheManager setOctrees:octrees];
+	
+	OOHighResTimeValue end = OOGetHighResTime();
+	OOLog(kOOLogOctreeBatch, @"Built %lu octrees for %lu models in %g seconds (%g loading geometry, %g building).",
+		  (unsigned long)[octrees count], (unsigned long)jobCount, OOHighResTimeDeltaInSeconds(start, end),
+		  OOHighResTimeDeltaInSeconds(start, loaded), OOHighResTimeDeltaInSeconds(loaded, end));
+	OODisposeHighResTime(start);
+	OODisposeHighResTime(loaded);
+	OODisposeHighResTime(end);
+	
+	return [octrees count];
+}
+
+@end
+
+
+static void BuildOctree(NSUInteger index, void *context)
+{
+	OOOctreeJob *job = (OOOctreeJob *)context + index;
+
+	NS_DURING
+		job->octree = [[job->geometry findOctreeToDepth:job->depth] retain];
+	NS_HANDLER
+		OOLogERR(kOOLogOctreeBatchFailed, @"Could not build octree for model \"%@\": %@: %@", job->modelName, [localException name], [localException reason]);
+	NS_ENDHANDLER
+		
+	// The geometry is no longer needed; free it now rather than at the end.
+	[job->geometry release];
+	job->geometry = nil;
+}
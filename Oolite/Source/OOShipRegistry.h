@@ -45,6 +45,7 @@ SOFTWARE.
 
 + (void) reload;
 
+- (NSArray *) shipKeys;
 - (OOShipClass *) shipClassForKey:(NSString *)key;
 - (NSDictionary *) shipInfoForKey:(NSString *)key;
 - (NSDictionary *) shipyardInfoForKey:(NSString *)key;
@@ -34,10 +34,15 @@ SOFTWARE.
 #import "OOGameController.h"
 #import "OOShipClass+Legacy.h"
 #import "OOShipClass+IO.h"
+#import "OOAsyncWorkManager.h"
+#import "OOProfilingStopwatch.h"
 
 
 #define PRELOAD 0
 
+#define SHIP_CLASS_BATCH_MAX_WORKERS		7		// Plus the main thread.
+#define SHIP_CLASS_BATCH_MIN_PER_WORKER		16		// Don't bother with threads for small registries.
+
 
 static OOShipRegistry	*sSingleton = nil;
 
@@ -48,6 +53,11 @@ static NSString * const	kDemoShipsCacheKey = @"demo ships";
 static NSString * const	kRoleWeightsCacheKey = @"role weights";
 static NSString * const	kDefaultDemoShip = @"coriolis-station";
 
+static NSString * const	kOOLogShipDataLoadTiming = @"shipData.load.timing";
+
+
+static void ReportLoadStage(NSMutableString *report, NSString *stage, OOProfilingStopwatch *stopwatch);
+
 
 @interface OOShipRegistry (OODataLoader)
 
@@ -102,6 +112,26 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 @end
 
 
+/*	The OOShipClasses for a list of ship keys, built by OORunIndexedTasks().
+	Each class is built from its own fully merged shipdata entry, and may look
+	at other entries, but the ship data isn't modified while they are built,
+	so the classes can be built in any order. Problems are collected
+	separately for each ship so they can be reported in ship key order
+	afterwards.
+*/
+typedef struct
+{
+	NSArray					*shipKeys;
+	NSDictionary			*shipData;
+	OOShipClass				**classes;
+	OODeferredProblemReporter **problems;
+	BOOL					*failed;		// YES if building the class raised an exception.
+} OOShipClassJob;
+
+
+static void BuildShipClass(NSUInteger index, void *context);
+
+
 @implementation OOShipRegistry
 
 + (OOShipRegistry *) sharedRegistry
@@ -150,10 +180,14 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 			}
 		}
 		
+		OOProfilingStopwatch *stopwatch = [OOProfilingStopwatch stopwatch];
+		NSMutableString *timingReport = [NSMutableString string];
+		
 		_demoShips = [[cache objectForKey:kDemoShipsCacheKey inCache:kShipRegistryCacheName] retain];
 		if ([_demoShips count] == 0)
 		{
 			[self loadDemoShips];
+			ReportLoadStage(timingReport, @"Demo ships", stopwatch);
 			if ([_demoShips count] == 0)
 			{
 				[NSException raise:@"OOShipRegistryLoadFailure" format:@"Could not load or synthesize any demo ships."];
@@ -168,6 +202,12 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 			{
 				[NSException raise:@"OOShipRegistryLoadFailure" format:@"Could not load or synthesize role probability sets."];
 			}
+			ReportLoadStage(timingReport, @"Role probability sets", stopwatch);
+		}
+		
+		if ([timingReport length] != 0)
+		{
+			OOLog(kOOLogShipDataLoadTiming, @"Ship registry setup times:%@", timingReport);
 		}
 		
 		[pool release];
@@ -187,6 +227,12 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 }
 
 
+- (NSArray *) shipKeys
+{
+	return [_shipData allKeys];
+}
+
+
 - (OOShipClass *) shipClassForKey:(NSString *)key
 {
 	return [_shipClasses objectForKey:key];
@@ -253,10 +299,14 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 		* Load shipyard.plist, add shipyard data into ship dictionaries, and
 		  create _playerShips array.
 		* Build role->ship type probability sets.
+	
+	The time taken by each stage is logged under shipData.load.timing.
 */
 - (void) loadShipData
 {
 	NSMutableDictionary		*result = nil;
+	OOProfilingStopwatch	*stopwatch = [OOProfilingStopwatch stopwatch];
+	NSMutableString			*timingReport = [NSMutableString string];
 	
 	OOLog(@"shipData.load.begin", @"Loading ship data.");
 	OOLogIndentIf(@"shipData.load.begin");
@@ -272,46 +322,57 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 											   mergeMode:MERGE_BASIC
 												   cache:NO] mutableCopy] autorelease];
 	if (result == nil)  return;
+	ReportLoadStage(timingReport, @"Loading shipdata.plist", stopwatch);
 	
 	// Make each entry mutable to simplify later stages. Also removes any entries that aren't dictionaries.
 	if (![self makeShipEntriesMutable:result])  return;
 	OOLog(@"shipData.load.done", @"Finished initial cleanup...");
+	ReportLoadStage(timingReport, @"Initial cleanup", stopwatch);
 	
 	// Apply patches.
 	if (![self loadAndApplyShipDataOverrides:result])  return;
 	OOLog(@"shipData.load.done", @"Finished applying patches...");
+	ReportLoadStage(timingReport, @"Applying patches", stopwatch);
 	
 	// Strip private keys (anything starting with _oo_).
 	if (![self stripPrivateKeys:result])  return;
 	OOLog(@"shipData.load.done", @"Finished stripping private keys...");
+	ReportLoadStage(timingReport, @"Stripping private keys", stopwatch);
 	
 	// Resolve like_ship entries.
 	if (![self applyLikeShips:result])  return;
 	OOLog(@"shipData.load.done", @"Finished resolving like_ships...");
+	ReportLoadStage(timingReport, @"Resolving like_ships", stopwatch);
 	
 	if (![self reifyShipClasses:result])  return;
 	OOLog(@"shipData.load.done", @"Finished building ship class models...");
+	ReportLoadStage(timingReport, @"Building ship classes", stopwatch);
 	
 	// Clean up subentity declarations and tag subentities so they won't be pruned.
 	if (![self canonicalizeAndTagSubentities:result])  return;
 	OOLog(@"shipData.load.done", @"Finished cleaning up subentities...");
+	ReportLoadStage(timingReport, @"Cleaning up subentities", stopwatch);
 	
 	// Clean out templates and invalid entries.
 	if (![self removeUnusableEntries:result])  return;
 	OOLog(@"shipData.load.done", @"Finished removing invalid entries...");
+	ReportLoadStage(timingReport, @"Removing invalid entries", stopwatch);
 	
 	// Add shipyard entries into shipdata entries.
 	if (![self loadAndMergeShipyard:result])  return;
 	OOLog(@"shipData.load.done", @"Finished adding shipyard entries...");
+	ReportLoadStage(timingReport, @"Adding shipyard entries", stopwatch);
 	
 #if PRELOAD
 	// Preload and cache meshes.
 	if (![self preloadShipMeshes:result])  return;
 	OOLog(@"shipData.load.done", @"Finished loading meshes...");
+	ReportLoadStage(timingReport, @"Loading meshes", stopwatch);
 #endif
 	
 	_shipData = OODeepCopy(result);
 	[[OOCacheManager sharedCache] setObject:_shipData forKey:kShipDataCacheKey inCache:kShipRegistryCacheName];
+	ReportLoadStage(timingReport, @"Caching ship data", stopwatch);
 	
 #if !OOLITE_LEAN
 	/*	TEMP DEBUG
@@ -324,6 +385,7 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 	
 	OOLogOutdentIf(@"shipData.load.begin");
 	OOLog(@"shipData.load.done", @"Ship data loaded.");
+	OOLog(kOOLogShipDataLoadTiming, @"Ship data load times for %lu ships:%@", (unsigned long)[_shipData count], timingReport);
 }
 
 
@@ -430,85 +492,97 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 /*	-applyLikeShips:
 	
 	Implement like_ship by copying inherited ship and overwriting with child
-	ship values. Done iteratively to report recursive references of arbitrary
-	depth. Also removes and reports ships whose like_ship entry does not
+	ship values. Also removes and reports ships whose like_ship entry does not
 	resolve, and handles reference loops by removing all ships involved.
  
-	We start with a set of keys all ships that have a like_ships entry. In
-	each iteration, every ship whose like_ship entry does not refer to a ship
-	which itself has a like_ship entry is finalized. If the set of pending
-	ships does not shrink in an iteration, the remaining ships cannot be
-	resolved (either their like_ships do not exist, or they form reference
-	cycles) so we stop looping and report it.
+	The like_ship references form a graph with an edge from each parent to
+	each of its children. This is walked breadth-first, starting from the
+	ships that have children but no like_ship entry of their own, so every
+	ship is merged after its parent has been finalized, at any depth. Ships
+	whose like_ship entry doesn't exist are never reached, and neither are
+	ships in reference cycles (or their descendants), since none of them has
+	a finalized parent to start from. Whatever is left over when the walk is
+	finished cannot be resolved, and is removed and reported.
 */
 - (BOOL) applyLikeShips:(NSMutableDictionary *)ioData
 {
+	NSMutableDictionary		*childrenByParent = nil;
 	NSMutableSet			*remainingLikeShips = nil;
+	NSMutableArray			*resolved = nil;
+	NSMutableArray			*children = nil;
 	NSEnumerator			*enumerator = nil;
 	NSString				*key = nil;
 	NSString				*parentKey = nil;
 	NSDictionary			*shipEntry = nil;
-	NSDictionary			*parentEntry = nil;
-	unsigned				count, lastCount;
+	NSUInteger				i;
 	NSMutableArray			*reportedBadShips = nil;
 	
-	// Build set of ships with like_ship references
+	// Build graph of like_ship references: parent key -> child keys.
+	childrenByParent = [NSMutableDictionary dictionary];
 	remainingLikeShips = [NSMutableSet set];
 	for (enumerator = [ioData keyEnumerator]; (key = [enumerator nextObject]); )
 	{
-		shipEntry = [ioData objectForKey:key];
-		if ([shipEntry oo_stringForKey:@"like_ship"] != nil)
+		parentKey = [[ioData objectForKey:key] oo_stringForKey:@"like_ship"];
+		if (parentKey != nil)
 		{
+			children = [childrenByParent objectForKey:parentKey];
+			if (children == nil)
+			{
+				children = [NSMutableArray array];
+				[childrenByParent setObject:children forKey:parentKey];
+			}
+			[children addObject:key];
 			[remainingLikeShips addObject:key];
 		}
 	}
 	
-	count = lastCount = [remainingLikeShips count];
-	while (count != 0)
+	// Roots: parents which exist and don't have a like_ship entry themselves.
+	resolved = [NSMutableArray arrayWithCapacity:[remainingLikeShips count] + [childrenByParent count]];
+	for (enumerator = [childrenByParent keyEnumerator]; (parentKey = [enumerator nextObject]); )
 	{
-		for (enumerator = [[[remainingLikeShips copy] autorelease] objectEnumerator]; (key = [enumerator nextObject]); )
+		if ([ioData objectForKey:parentKey] != nil && ![remainingLikeShips containsObject:parentKey])
 		{
-			// Look up like_ship entry
-			shipEntry = [ioData objectForKey:key];
-			parentKey = [shipEntry objectForKey:@"like_ship"];
-			if (![remainingLikeShips containsObject:parentKey])
-			{
-				// If parent is fully resolved, we can resolve this child.
-				parentEntry = [ioData objectForKey:parentKey];
-				shipEntry = [self mergeShip:shipEntry withParent:parentEntry];
-				if (shipEntry != nil)
-				{
-					[remainingLikeShips removeObject:key];
-					[ioData setObject:shipEntry forKey:key];
-				}
-			}
+			[resolved addObject:parentKey];
 		}
-		
-		count = [remainingLikeShips count];
-		if (count == lastCount)
+	}
+	
+	// Each resolved ship makes its children resolvable; resolved grows as we go.
+	for (i = 0; i < [resolved count]; i++)
+	{
+		parentKey = [resolved objectAtIndex:i];
+		for (enumerator = [[childrenByParent objectForKey:parentKey] objectEnumerator]; (key = [enumerator nextObject]); )
 		{
-			/*	Fail: we couldn't resolve all like_ship entries.
-				Remove unresolved entries, building a list of the ones that
-				don't have is_external_dependency set.
-			*/
-			reportedBadShips = [NSMutableArray array];
-			for (enumerator = [remainingLikeShips objectEnumerator]; (key = [enumerator nextObject]); )
+			shipEntry = [self mergeShip:[ioData objectForKey:key] withParent:[ioData objectForKey:parentKey]];
+			if (shipEntry != nil)
 			{
-				if (![[ioData oo_dictionaryForKey:key] oo_boolForKey:@"is_external_dependency"])
-				{
-					[reportedBadShips addObject:key];
-				}
-				[ioData removeObjectForKey:key];
+				[remainingLikeShips removeObject:key];
+				[ioData setObject:shipEntry forKey:key];
+				[resolved addObject:key];
 			}
-			
-			if ([reportedBadShips count] != 0)
+		}
+	}
+	
+	if ([remainingLikeShips count] != 0)
+	{
+		/*	Fail: we couldn't resolve all like_ship entries.
+			Remove unresolved entries, building a list of the ones that
+			don't have is_external_dependency set.
+		*/
+		reportedBadShips = [NSMutableArray array];
+		for (enumerator = [remainingLikeShips objectEnumerator]; (key = [enumerator nextObject]); )
+		{
+			if (![[ioData oo_dictionaryForKey:key] oo_boolForKey:@"is_external_dependency"])
 			{
-				[reportedBadShips sortUsingSelector:@selector(caseInsensitiveCompare:)];
-				OOLogERR(@"shipData.merge.failed", @"one or more shipdata.plist entries have like_ship references that cannot be resolved: %@", [reportedBadShips componentsJoinedByString:@", "]);
+				[reportedBadShips addObject:key];
 			}
-			break;
+			[ioData removeObjectForKey:key];
+		}
+		
+		if ([reportedBadShips count] != 0)
+		{
+			[reportedBadShips sortUsingSelector:@selector(caseInsensitiveCompare:)];
+			OOLogERR(@"shipData.merge.failed", @"one or more shipdata.plist entries have like_ship references that cannot be resolved: %@", [reportedBadShips componentsJoinedByString:@", "]);
 		}
-		lastCount = count;
 	}
 	
 	return YES;
@@ -862,27 +936,66 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 }
 
 
+/*	-reifyShipClasses:
+	
+	Build an OOShipClass for each ship. The classes are independent of each
+	other, so they are built in parallel by OORunIndexedTasks(). Problems are
+	reported in ship key order, so the log doesn't depend on thread timing.
+	A ship whose class raises an exception while it is built is reported and
+	left out, rather than abandoning the whole load.
+*/
 - (BOOL) reifyShipClasses:(NSMutableDictionary *)ioData
 {
-	NSString						*shipKey = nil;
+	NSArray							*shipKeys = nil;
 	NSMutableDictionary				*shipClasses = [NSMutableDictionary dictionaryWithCapacity:[ioData count]];
 	OOSimpleProblemReportManager	*issues = [[[OOSimpleProblemReportManager alloc] init] autorelease];
+	OOShipClassJob					job;
+	NSUInteger						i, count;
+	BOOL							OK = YES;
+	
+	shipKeys = [[ioData allKeys] sortedArrayUsingSelector:@selector(compare:)];
+	count = [shipKeys count];
+	
+	job.shipKeys = shipKeys;
+	job.shipData = ioData;
+	job.classes = calloc(count, sizeof *job.classes);
+	job.problems = calloc(count, sizeof *job.problems);
+	job.failed = calloc(count, sizeof *job.failed);
+	if (EXPECT_NOT((job.classes == NULL || job.problems == NULL || job.failed == NULL) && count != 0))
+	{
+		free(job.classes);
+		free(job.problems);
+		free(job.failed);
+		return NO;
+	}
+	
+	OORunIndexedTasks(count, 1, MIN((NSUInteger)SHIP_CLASS_BATCH_MAX_WORKERS, count / SHIP_CLASS_BATCH_MIN_PER_WORKER), BuildShipClass, &job);
 	
-	foreachkey (shipKey, ioData)
+	for (i = 0; i < count; i++)
 	{
-		OOShipClass *shipClass = [[OOShipClass alloc] initWithKey:shipKey
-													  legacyPList:[ioData oo_dictionaryForKey:shipKey]
-												   legacyShipData:ioData
-												  problemReporter:issues];
-		if (shipClass == nil)  return NO;
+		[job.problems[i] replayToProblemReporter:issues];
 		
-		[shipClasses setObject:shipClass forKey:shipKey];
-		[shipClass release];
+		if (job.failed[i])
+		{
+			// The problem has been reported; leave this ship out rather than abandoning the whole load.
+			[ioData removeObjectForKey:[shipKeys objectAtIndex:i]];
+		}
+		else
+		{
+			if (job.classes[i] == nil)  OK = NO;
+			if (OK)  [shipClasses setObject:job.classes[i] forKey:[shipKeys objectAtIndex:i]];
+		}
+		
+		[job.classes[i] release];
+		[job.problems[i] release];
 	}
+	free(job.classes);
+	free(job.problems);
+	free(job.failed);
 	
-	_shipClasses = [shipClasses copy];
+	if (OK)  _shipClasses = [shipClasses copy];
 	
-	return YES;
+	return OK;
 }
 
 
@@ -1355,3 +1468,27 @@ static NSString * const	kDefaultDemoShip = @"coriolis-station";
 }
 
 @end
+
+
+static void BuildShipClass(NSUInteger index, void *context)
+{
+	OOShipClassJob			*job = context;
+	NSString				*shipKey = [job->shipKeys objectAtIndex:index];
+
+	job->problems[index] = [[OODeferredProblemReporter alloc] init];
+	NS_DURING
+		job->classes[index] = [[OOShipClass alloc] initWithKey:shipKey
+												  legacyPList:[job->shipData oo_dictionaryForKey:shipKey]
+											   legacyShipData:job->shipData
+											  problemReporter:job->problems[index]];
+	NS_HANDLER
+		OOReportError(job->problems[index], @"Could not build ship class for ship \"%@\": %@: %@", shipKey, [localException name], [localException reason]);
+		job->failed[index] = YES;
+	NS_ENDHANDLER
+}
+
+
+static void ReportLoadStage(NSMutableString *report, NSString *stage, OOProfilingStopwatch *stopwatch)
+{
+	[report appendFormat:@"\n    %-28s %9.2f ms", [stage UTF8String], [stopwatch reset] * 1000.0];
+}
@@ -0,0 +1,107 @@
+/*
+
+OOSpatialIndex.h
+
+k-d tree over the slots of an OOEntityHotState, for range and nearest
+neighbour queries which don't have to look at every entity.
+
+The universe rebuilds its index once per frame, at the end of -update:.
+Queries made between rebuilds are still exact with respect to the hot state:
+each node's bounds are widened by the hot state's drift (the furthest any
+slot has moved or grown since the rebuild), slots freed since the rebuild
+are skipped, and slots allocated since the rebuild are tested one by one.
+If something moves a long way between rebuilds, such as a teleport, queries
+just get slower until the next rebuild.
+
+Range queries use the same test as
+-[OOUniverse findEntitiesMatchingPredicate:parameter:inRange:ofEntity:]: a
+slot is in range if the distance between centres is less than the range
+plus the slot's collision radius. Nearest neighbour queries use the distance
+between centres.
+
+This class is *not* thread-safe.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+#import "OOEntityHotState.h"
+
+
+#define SPATIAL_INDEX_LEAF_SIZE			8
+
+
+/*	Filter for nearest neighbour queries. Return YES to accept the slot.
+	Called in no particular order, during the traversal, so it must not
+	change the hot state or anything else the index depends on.
+*/
+typedef BOOL (*OOSpatialIndexFilter)(OOEntityStateSlot slot, void *context);
+
+
+@interface OOSpatialIndex: NSObject
+{
+@private
+	OOEntityHotState		*_hotState;
+
+	struct OOSpatialIndexRecord *_records;
+	NSUInteger				_recordCount,
+							_recordCapacity;
+
+	struct OOSpatialIndexNode *_nodes;
+	NSUInteger				_nodeCount,
+							_nodeCapacity;
+}
+
+- (id) initWithHotState:(OOEntityHotState *)hotState;
+
+/*	Rebuild from the given live slots, and mark them in the hot state. The
+	slots must be every live slot, as the universe's sortedSlots are.
+*/
+- (void) rebuildWithSlots:(const OOEntityStateSlot *)slots count:(NSUInteger)count;
+
+/*	Write the slots within range of point to outSlots, which must have room
+	for -[OOEntityHotState slotLimit] slots, and return the number written.
+	Order is unspecified.
+*/
+- (NSUInteger) getSlotsWithinRange:(GLfloat)range ofPoint:(Vector)point into:(OOEntityStateSlot *)outSlots;
+
+/*	Write up to count of the slots nearest point, closer than range (which may
+	be INFINITY) and passing filter (which may be NULL), to outSlots, nearest
+	first, and return the number written. If outDistancesSquared is not NULL,
+	it receives the squared distances.
+*/
+- (NSUInteger) getNearestSlots:(NSUInteger)count
+					   toPoint:(Vector)point
+				   withinRange:(GLfloat)range
+						filter:(OOSpatialIndexFilter)filter
+					   context:(void *)context
+						  into:(OOEntityStateSlot *)outSlots
+			  distancesSquared:(GLfloat *)outDistancesSquared;
+
+// Nearest slot passing filter, or kOOEntityStateNoSlot.
+- (OOEntityStateSlot) nearestSlotToPoint:(Vector)point
+								  filter:(OOSpatialIndexFilter)filter
+								 context:(void *)context;
+
+- (NSUInteger) recordCount;
+- (NSUInteger) nodeCount;
+
+@end
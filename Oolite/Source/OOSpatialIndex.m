@@ -0,0 +1,439 @@
+/*
+
+OOSpatialIndex.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOSpatialIndex.h"
+
+
+enum
+{
+	kMinCapacity				= 64,
+	kMaxTraversalDepth			= 64,
+	kNoChild					= UINT32_MAX
+};
+
+
+struct OOSpatialIndexRecord
+{
+	GLfloat					pos[3];
+	GLfloat					radius;
+	OOEntityStateSlot		slot;
+};
+typedef struct OOSpatialIndexRecord OOSpatialIndexRecord;
+
+
+// Bounds include each record's radius, so they also bound the centres.
+struct OOSpatialIndexNode
+{
+	GLfloat					min[3], max[3];
+	uint32_t				start, count;
+	uint32_t				left, right;		// kNoChild for leaves.
+};
+typedef struct OOSpatialIndexNode OOSpatialIndexNode;
+
+
+static void GrowBuffer(void **buffer, NSUInteger *capacity, NSUInteger needed, size_t elementSize);
+static uint32_t BuildNode(OOSpatialIndexRecord *records, OOSpatialIndexNode *nodes, NSUInteger *nodeCount, uint32_t start, uint32_t count);
+static void SelectMedian(OOSpatialIndexRecord *records, uint32_t count, uint32_t nth, unsigned axis);
+
+OOINLINE GLfloat BoxDistanceSquared(const OOSpatialIndexNode *node, const GLfloat point[3], GLfloat margin) INLINE_PURE_FUNC;
+
+
+@implementation OOSpatialIndex
+
+- (id) init
+{
+	return [self initWithHotState:nil];
+}
+
+
+- (id) initWithHotState:(OOEntityHotState *)hotState
+{
+	if (hotState == nil)
+	{
+		[self release];
+		return nil;
+	}
+
+	if ((self = [super init]))
+	{
+		_hotState = [hotState retain];
+	}
+
+	return self;
+}
+
+
+- (void) dealloc
+{
+	DESTROY(_hotState);
+	free(_records);
+	free(_nodes);
+
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%lu records, %lu nodes", (unsigned long)_recordCount, (unsigned long)_nodeCount];
+}
+
+
+- (void) rebuildWithSlots:(const OOEntityStateSlot *)slots count:(NSUInteger)count
+{
+	NSUInteger				i;
+	OOEntityHotState		*hot = _hotState;
+
+	_recordCount = 0;
+	_nodeCount = 0;
+
+	if (count > _recordCapacity)
+	{
+		GrowBuffer((void **)&_records, &_recordCapacity, count, sizeof *_records);
+	}
+	// Every internal node splits at least two records, so there are fewer than 2 * count nodes.
+	if (count * 2 > _nodeCapacity)
+	{
+		GrowBuffer((void **)&_nodes, &_nodeCapacity, count * 2, sizeof *_nodes);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		OOEntityStateSlot slot = slots[i];
+		OOSpatialIndexRecord *record = &_records[i];
+		record->pos[0] = hot->x[slot];
+		record->pos[1] = hot->y[slot];
+		record->pos[2] = hot->z[slot];
+		record->radius = hot->radius[slot];
+		record->slot = slot;
+	}
+	_recordCount = count;
+
+	if (count != 0)  BuildNode(_records, _nodes, &_nodeCount, 0, count);
+
+	[hot markSlots:slots count:count];
+}
+
+
+- (NSUInteger) getSlotsWithinRange:(GLfloat)range ofPoint:(Vector)point into:(OOEntityStateSlot *)outSlots
+{
+	OOEntityHotState		*hot = _hotState;
+	const GLfloat			p[3] = { point.x, point.y, point.z };
+	GLfloat					margin = hot->drift * 2.0f;
+	GLfloat					range2 = range * range;
+	uint32_t				stack[kMaxTraversalDepth];
+	unsigned				stackSize = 0;
+	NSUInteger				i, found = 0;
+
+	if (_nodeCount != 0)  stack[stackSize++] = 0;
+
+	while (stackSize != 0)
+	{
+		const OOSpatialIndexNode *node = &_nodes[stack[--stackSize]];
+
+		// Anything that could overlap the range sphere is within range of the node's bounds.
+		if (BoxDistanceSquared(node, p, margin) > range2)  continue;
+
+		if (node->left != kNoChild)
+		{
+			stack[stackSize++] = node->left;
+			stack[stackSize++] = node->right;
+			continue;
+		}
+
+		for (i = node->start; i < node->start + node->count; i++)
+		{
+			OOEntityStateSlot slot = _records[i].slot;
+			if (!hot->marked[slot])  continue;	// Freed, and possibly reused, since the rebuild.
+
+			GLfloat dx = hot->x[slot] - p[0];
+			GLfloat dy = hot->y[slot] - p[1];
+			GLfloat dz = hot->z[slot] - p[2];
+			GLfloat cr = range + hot->radius[slot];
+			if (dx * dx + dy * dy + dz * dz < cr * cr)  outSlots[found++] = slot;
+		}
+	}
+
+	const OOEntityStateSlot *unmarked = [hot unmarkedSlots];
+	NSUInteger unmarkedCount = [hot unmarkedSlotCount];
+	for (i = 0; i < unmarkedCount; i++)
+	{
+		OOEntityStateSlot slot = unmarked[i];
+		if (!hot->live[slot])  continue;
+
+		GLfloat dx = hot->x[slot] - p[0];
+		GLfloat dy = hot->y[slot] - p[1];
+		GLfloat dz = hot->z[slot] - p[2];
+		GLfloat cr = range + hot->radius[slot];
+		if (dx * dx + dy * dy + dz * dz < cr * cr)  outSlots[found++] = slot;
+	}
+
+	return found;
+}
+
+
+- (NSUInteger) getNearestSlots:(NSUInteger)count
+					   toPoint:(Vector)point
+				   withinRange:(GLfloat)range
+						filter:(OOSpatialIndexFilter)filter
+					   context:(void *)context
+						  into:(OOEntityStateSlot *)outSlots
+			  distancesSquared:(GLfloat *)outDistancesSquared
+{
+	OOEntityHotState		*hot = _hotState;
+	const GLfloat			p[3] = { point.x, point.y, point.z };
+	GLfloat					margin = hot->drift * 2.0f;
+	GLfloat					range2 = range * range;
+	uint32_t				stack[kMaxTraversalDepth];
+	unsigned				stackSize = 0;
+	NSUInteger				i, j, found = 0;
+
+	if (count == 0)  return 0;
+	GLfloat					bestD2[count];
+
+	// The search radius: range until the best list is full, then the furthest entry in it.
+	#define BOUND() ((found < count) ? range2 : bestD2[count - 1])
+
+	// Insert a candidate into the sorted best list, dropping the furthest if it's full.
+	#define CONSIDER(slot_) \
+	do { \
+		OOEntityStateSlot cSlot = (slot_); \
+		GLfloat dx = hot->x[cSlot] - p[0], dy = hot->y[cSlot] - p[1], dz = hot->z[cSlot] - p[2]; \
+		GLfloat d2 = dx * dx + dy * dy + dz * dz; \
+		if (d2 < BOUND() && (filter == NULL || filter(cSlot, context))) \
+		{ \
+			if (found < count)  found++; \
+			for (j = found - 1; j > 0 && bestD2[j - 1] > d2; j--) \
+			{ \
+				bestD2[j] = bestD2[j - 1]; \
+				outSlots[j] = outSlots[j - 1]; \
+			} \
+			bestD2[j] = d2; \
+			outSlots[j] = cSlot; \
+		} \
+	} while (0)
+
+	if (_nodeCount != 0)  stack[stackSize++] = 0;
+
+	while (stackSize != 0)
+	{
+		const OOSpatialIndexNode *node = &_nodes[stack[--stackSize]];
+
+		if (BoxDistanceSquared(node, p, margin) > BOUND())  continue;
+
+		if (node->left != kNoChild)
+		{
+			// Push the nearer child last, so it's searched first and tightens the bound sooner.
+			GLfloat dl = BoxDistanceSquared(&_nodes[node->left], p, margin);
+			GLfloat dr = BoxDistanceSquared(&_nodes[node->right], p, margin);
+			if (dl < dr)
+			{
+				stack[stackSize++] = node->right;
+				stack[stackSize++] = node->left;
+			}
+			else
+			{
+				stack[stackSize++] = node->left;
+				stack[stackSize++] = node->right;
+			}
+			continue;
+		}
+
+		for (i = node->start; i < node->start + node->count; i++)
+		{
+			OOEntityStateSlot slot = _records[i].slot;
+			if (!hot->marked[slot])  continue;
+			CONSIDER(slot);
+		}
+	}
+
+	const OOEntityStateSlot *unmarked = [hot unmarkedSlots];
+	NSUInteger unmarkedCount = [hot unmarkedSlotCount];
+	for (i = 0; i < unmarkedCount; i++)
+	{
+		if (!hot->live[unmarked[i]])  continue;
+		CONSIDER(unmarked[i]);
+	}
+
+	#undef CONSIDER
+	#undef BOUND
+
+	if (outDistancesSquared != NULL)  memcpy(outDistancesSquared, bestD2, found * sizeof *bestD2);
+	return found;
+}
+
+
+- (OOEntityStateSlot) nearestSlotToPoint:(Vector)point
+								  filter:(OOSpatialIndexFilter)filter
+								 context:(void *)context
+{
+	OOEntityStateSlot result;
+	if ([self getNearestSlots:1 toPoint:point withinRange:INFINITY filter:filter context:context into:&result distancesSquared:NULL] == 0)
+	{
+		result = kOOEntityStateNoSlot;
+	}
+	return result;
+}
+
+
+- (NSUInteger) recordCount
+{
+	return _recordCount;
+}
+
+
+- (NSUInteger) nodeCount
+{
+	return _nodeCount;
+}
+
+@end
+
+
+static uint32_t BuildNode(OOSpatialIndexRecord *records, OOSpatialIndexNode *nodes, NSUInteger *nodeCount, uint32_t start, uint32_t count)
+{
+	uint32_t				i, index = *nodeCount;
+	unsigned				axis;
+	GLfloat					centreMin[3], centreMax[3];
+	OOSpatialIndexNode		*node = &nodes[index];
+
+	(*nodeCount)++;
+
+	node->start = start;
+	node->count = count;
+	node->left = node->right = kNoChild;
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		node->min[axis] = centreMin[axis] = INFINITY;
+		node->max[axis] = centreMax[axis] = -INFINITY;
+	}
+
+	for (i = start; i < start + count; i++)
+	{
+		const OOSpatialIndexRecord *record = &records[i];
+		for (axis = 0; axis < 3; axis++)
+		{
+			GLfloat c = record->pos[axis];
+			node->min[axis] = fminf(node->min[axis], c - record->radius);
+			node->max[axis] = fmaxf(node->max[axis], c + record->radius);
+			centreMin[axis] = fminf(centreMin[axis], c);
+			centreMax[axis] = fmaxf(centreMax[axis], c);
+		}
+	}
+
+	if (count <= SPATIAL_INDEX_LEAF_SIZE)  return index;
+
+	// Split at the median along the axis where the centres are most spread out.
+	axis = 0;
+	if (centreMax[1] - centreMin[1] > centreMax[axis] - centreMin[axis])  axis = 1;
+	if (centreMax[2] - centreMin[2] > centreMax[axis] - centreMin[axis])  axis = 2;
+
+	uint32_t half = count / 2;
+	SelectMedian(records + start, count, half, axis);
+
+	// Recursion depth is log2(UNIVERSE_MAX_ENTITIES / SPATIAL_INDEX_LEAF_SIZE) or so.
+	uint32_t left = BuildNode(records, nodes, nodeCount, start, half);
+	uint32_t right = BuildNode(records, nodes, nodeCount, start + half, count - half);
+
+	// node is still valid, since the node buffer was sized before building.
+	node->left = left;
+	node->right = right;
+
+	return index;
+}
+
+
+// Partially sort records so that records[nth] is in its sorted position on axis, with nothing greater before it or less after it.
+static void SelectMedian(OOSpatialIndexRecord *records, uint32_t count, uint32_t nth, unsigned axis)
+{
+	uint32_t				lo = 0, hi = count - 1;
+	OOSpatialIndexRecord	temp;
+
+	#define KEY(i_) (records[(i_)].pos[axis])
+	#define SWAP(a_, b_) do { temp = records[(a_)]; records[(a_)] = records[(b_)]; records[(b_)] = temp; } while (0)
+
+	while (lo < hi)
+	{
+		// Median of three pivot, moved to records[hi].
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (KEY(mid) < KEY(lo))  SWAP(mid, lo);
+		if (KEY(hi) < KEY(lo))  SWAP(hi, lo);
+		if (KEY(mid) < KEY(hi))  SWAP(mid, hi);
+		GLfloat pivot = KEY(hi);
+
+		uint32_t store = lo, i;
+		for (i = lo; i < hi; i++)
+		{
+			if (KEY(i) < pivot)
+			{
+				SWAP(i, store);
+				store++;
+			}
+		}
+		SWAP(store, hi);
+
+		if (store == nth)  break;
+		if (store < nth)  lo = store + 1;
+		else  hi = store - 1;
+	}
+
+	#undef KEY
+	#undef SWAP
+}
+
+
+static void GrowBuffer(void **buffer, NSUInteger *capacity, NSUInteger needed, size_t elementSize)
+{
+	NSUInteger newCapacity = *capacity * 3 / 2;
+	if (newCapacity < kMinCapacity)  newCapacity = kMinCapacity;
+	if (newCapacity < needed)  newCapacity = needed;
+
+	void *newBuffer = realloc(*buffer, newCapacity * elementSize);
+	if (EXPECT_NOT(newBuffer == NULL))
+	{
+		[NSException raise:NSMallocException format:@"Could not expand capacity of OOSpatialIndex."];
+	}
+
+	*buffer = newBuffer;
+	*capacity = newCapacity;
+}
+
+
+OOINLINE GLfloat BoxDistanceSquared(const OOSpatialIndexNode *node, const GLfloat point[3], GLfloat margin)
+{
+	GLfloat					result = 0.0f, d;
+	unsigned				axis;
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		GLfloat lo = node->min[axis] - margin, hi = node->max[axis] + margin;
+		if (point[axis] < lo)  d = lo - point[axis];
+		else if (point[axis] > hi)  d = point[axis] - hi;
+		else  continue;
+		result += d * d;
+	}
+
+	return result;
+}
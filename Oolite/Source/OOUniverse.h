@@ -28,6 +28,10 @@ MA 02110-1301, USA.
 #import "OOLegacyOpenGL.h"
 #import "OOTypes.h"
 #import "OOJSPropID.h"
+#import "OOBroadPhase.h"
+#import "OOEntityHotState.h"
+
+@class OOConcurrentEntityUpdater, OOSpatialIndex, OOAIThinkScheduler;
 
 
 #if OOLITE_ESPEAK
@@ -159,6 +163,8 @@ typedef uint8_t		OOEconomyID;		// 0..7
 @public
 	// use a sorted list for drawing and other activities
 	OOEntity				*sortedEntities[UNIVERSE_MAX_ENTITIES];
+	OOEntityStateSlot		sortedSlots[UNIVERSE_MAX_ENTITIES];		// sortedEntities[i]->stateSlot, kept in step with sortedEntities. Never kOOEntityStateNoSlot.
+	OOEntity				*slotEntities[UNIVERSE_MAX_ENTITIES];	// The entity in each hot state slot, or nil.
 	unsigned				n_entities;
 	
 	int						cursor_row;
@@ -276,6 +282,36 @@ typedef uint8_t		OOEconomyID;		// 0..7
 	
 	CollisionRegion			*universeRegion;
 	
+	// packed positions, velocities and radii, see OOEntityHotState.h.
+	OOEntityHotState		*entityHotState;
+	
+	// updates entities that -canUpdateConcurrently; nil if the "concurrent-entity-update" default is NO.
+	OOConcurrentEntityUpdater *concurrentUpdater;
+	
+	// range and nearest neighbour queries; nil if the "spatial-query-index" default is NO.
+	OOSpatialIndex			*spatialIndex;
+	
+	// spreads NPC AI thinking over frames, see OOAIThinkScheduler.h.
+	OOAIThinkScheduler		*thinkScheduler;
+	
+	// ship scanner results, see -updateShipScanners.
+	NSUInteger				scannerGeneration;
+	BOOL					shipScannersDirty;
+	
+	// broad phase collision detection; kOOBroadPhaseLinkedLists uses filterSortedLists instead.
+	OOBroadPhase			*broadPhase;
+	OOBroadPhaseMode		broadPhaseMode;
+	unsigned				broadPhaseCompareFrames;
+	NSUInteger				broadPhaseCompareListPairs,
+							broadPhaseCompareGridPairs;
+	OOTimeDelta				broadPhaseCompareListTime,
+							broadPhaseCompareGridTime;
+	
+	// distance-from-player ordering statistics, see UpdateZeroDistanceOrder().
+	BOOL					zeroDistanceOrderDirty;
+	NSUInteger				zeroDistanceSwaps;
+	NSUInteger				zeroDistanceResorts;
+	
 	// check and maintain linked lists occasionally
 	BOOL					doLinkedListMaintenanceThisUpdate;
 	
@@ -315,6 +351,9 @@ typedef uint8_t		OOEconomyID;		// 0..7
 - (void) reinitAndShowDemo:(BOOL)showDemo;
 
 - (int) entityCount;
+- (OOEntityHotState *) entityHotState;
+- (OOSpatialIndex *) spatialIndex;	// nil if the "spatial-query-index" default is NO.
+- (OOAIThinkScheduler *) thinkScheduler;
 #ifndef NDEBUG
 - (void) debugDumpEntities;
 - (NSArray *) entityList;
@@ -512,6 +551,29 @@ typedef uint8_t		OOEconomyID;		// 0..7
 - (void) setTimeAccelerationFactor:(double)newTimeAccelerationFactor;
 
 - (void) filterSortedLists;
+- (void) findBroadPhasePairs;
+
+// Distance-from-player ordering: entity moves in the last update, and number of full re-sorts since startup.
+- (NSUInteger) zeroDistanceSwapCount;
+- (NSUInteger) zeroDistanceResortCount;
+
+/*	Fill in the scanner results of every ship in the universe in one pass over
+	the spatial index, if that hasn't been done since the index was last
+	rebuilt at the end of -update:. Returns NO if there is no spatial index, in
+	which case ships have to scan for themselves.
+	
+	Ships added since the pass have no results, and use
+	-updateScannerForShip: to scan alone. Ships removed since the pass are
+	still listed in other ships' results; -[OOShipEntity checkScanner] drops
+	them.
+*/
+- (BOOL) updateShipScanners;
+- (BOOL) updateScannerForShip:(OOShipEntity *)ship;
+- (NSUInteger) scannerGeneration;	// Passed to -[OOShipEntity setScannedShips:...] by the last -updateShipScanners.
+
+// Broad phase selection, initially from the "collision-broad-phase" default ("linked-lists", "grid" or "compare").
+- (OOBroadPhaseMode) broadPhaseMode;
+- (void) setBroadPhaseMode:(OOBroadPhaseMode)mode;
 
 ///////////////////////////////////////
 
@@ -43,6 +43,11 @@ MA 02110-1301, USA.
 
 #import "Octree.h"
 #import "CollisionRegion.h"
+#import "OOProfilingStopwatch.h"
+#import "OOUpdateBenchmark.h"
+#import "OOConcurrentEntityUpdater.h"
+#import "OOSpatialIndex.h"
+#import "OOAIThinkScheduler.h"
 #import "OOGraphicsResetManager.h"
 #import "OODebugSupport.h"
 #import "OOEntityFilterPredicate.h"
@@ -73,6 +78,7 @@ MA 02110-1301, USA.
 
 #import "OOMusicController.h"
 #import "OOAsyncWorkManager.h"
+#import "OOOctreeBatchBuilder.h"
 #import "OODebugFlags.h"
 #import "OOJSEngineTimeManagement.h"
 #import "OOJoystickManager.h"
@@ -222,6 +228,23 @@ static OOComparisonResult comparePrice(id dict1, id dict2, void * context);
 
 - (void) verifyEntitySessionIDs;
 
+- (void) runBroadPhase;
+- (void) compareBroadPhases;
+
+- (void) sortEntitiesByZeroDistance;
+
+- (unsigned) countEntitiesMatchingPredicateLinear:(EntityFilterPredicate)predicate
+										parameter:(void *)parameter
+										  inRange:(double)range
+										 ofEntity:(OOEntity *)e1;
+- (NSMutableArray *) findEntitiesMatchingPredicateLinear:(EntityFilterPredicate)predicate
+											   parameter:(void *)parameter
+												 inRange:(double)range
+												ofEntity:(OOEntity *)e1;
+- (id) nearestEntityMatchingPredicateLinear:(EntityFilterPredicate)predicate
+								  parameter:(void *)parameter
+						   relativeToEntity:(OOEntity *)entity;
+
 @end
 
 
@@ -292,8 +315,23 @@ static OOComparisonResult comparePrice(id dict1, id dict2, void * context);
 	[[OOGameController sharedController] logProgress:DESC(@"loading-ships")];
 	// Load ship data
 	[OOShipRegistry sharedRegistry];
+	if ([prefs oo_boolForKey:@"batch-octree-generation" defaultValue:YES])
+	{
+		[OOOctreeBatchBuilder buildMissingOctreesForShipRegistry:[OOShipRegistry sharedRegistry]];
+	}
 	
 	entities = [[NSMutableArray arrayWithCapacity:MAX_NUMBER_OF_ENTITIES] retain];
+	entityHotState = [[OOEntityHotState alloc] initWithCapacity:UNIVERSE_MAX_ENTITIES];
+	if ([prefs oo_boolForKey:@"concurrent-entity-update" defaultValue:YES])
+	{
+		concurrentUpdater = [[OOConcurrentEntityUpdater alloc] init];
+	}
+	if ([prefs oo_boolForKey:@"spatial-query-index" defaultValue:YES])
+	{
+		spatialIndex = [[OOSpatialIndex alloc] initWithHotState:entityHotState];
+		shipScannersDirty = YES;
+	}
+	thinkScheduler = [[OOAIThinkScheduler alloc] init];
 	
 	// this MUST have the default no. of rows else the GUI_ROW macros in OOPlayerShipEntity.h need modification
 	gui = [[GuiDisplayGen alloc] init]; // alloc retains
@@ -323,6 +361,8 @@ static OOComparisonResult comparePrice(id dict1, id dict2, void * context);
 	[self setUpInitialUniverse];
 	
 	universeRegion = [[CollisionRegion alloc] initAsUniverse];
+	broadPhase = [[OOBroadPhase alloc] init];
+	broadPhaseMode = OOBroadPhaseModeFromString([prefs oo_stringForKey:@"collision-broad-phase" defaultValue:@"linked-lists"]);
 	entitiesDeadThisUpdate = [[NSMutableSet alloc] init];
 	framesDoneThisUpdate = 0;
 	
@@ -374,6 +414,11 @@ static OOComparisonResult comparePrice(id dict1, id dict2, void * context);
 	[activeWormholes release];				
 	[characterPool release];
 	[universeRegion release];
+	[entityHotState release];
+	[concurrentUpdater release];
+	[spatialIndex release];
+	[thinkScheduler release];
+	[broadPhase release];
 	
 	DESTROY(_firstBeacon);
 	DESTROY(_lastBeacon);
@@ -423,6 +468,24 @@ static OOComparisonResult comparePrice(id dict1, id dict2, void * context);
 }
 
 
+- (OOEntityHotState *) entityHotState
+{
+	return entityHotState;
+}
+
+
+- (OOSpatialIndex *) spatialIndex
+{
+	return spatialIndex;
+}
+
+
+- (OOAIThinkScheduler *) thinkScheduler
+{
+	return thinkScheduler;
+}
+
+
 #ifndef NDEBUG
 - (void) debugDumpEntities
 {
@@ -3613,6 +3676,13 @@ static BOOL MaintainLinkedLists(OOUniverse *uni)
 			return NO;
 		}
 		
+		OOEntityStateSlot slot = [entityHotState allocateSlot];
+		if (slot == kOOEntityStateNoSlot)
+		{
+			OOLog(@"universe.addEntity.failed", @"***** OOUniverse cannot addEntity:%@ -- no free entity state slot.", entity);
+			return NO;
+		}
+		
 		if (![entity isEffect])
 		{
 			unsigned limiter = UNIVERSE_MAX_ENTITIES;
@@ -3627,6 +3697,7 @@ static BOOL MaintainLinkedLists(OOUniverse *uni)
 				{
 					// Every slot has been tried! This should not happen due to previous test, but there was a problem here in 1.70.
 					OOLog(@"universe.addEntity.failed", @"***** OOUniverse cannot addEntity:%@ -- Could not find free slot for entity.", entity);
+					[entityHotState freeSlot:slot];
 					return NO;
 				}
 			}
@@ -3687,15 +3758,23 @@ static BOOL MaintainLinkedLists(OOUniverse *uni)
 		Vector delta = vector_between(entity_pos, PLAYER->position);
 		double z_distance = magnitude2(delta);
 		entity->zero_distance = z_distance;
+		entity->stateSlot = slot;
+		[entity storeHotState:entityHotState];
+		slotEntities[slot] = entity;
+		// Until the next per-frame scan, a new ship scans alone when it first checks its scanner.
+		if (entity->isShip)  [(OOShipEntity *)entity setScannedShips:NULL distancesSquared:NULL count:0 generation:0];
 		unsigned index = n_entities;
 		sortedEntities[index] = entity;
+		sortedSlots[index] = entity->stateSlot;
 		entity->zero_index = index;
 		while ((index > 0)&&(z_distance < sortedEntities[index - 1]->zero_distance))	// bubble into place
 		{
 			sortedEntities[index] = sortedEntities[index - 1];
+			sortedSlots[index] = sortedSlots[index - 1];
 			sortedEntities[index]->zero_index = index;
 			index--;
 			sortedEntities[index] = entity;
+			sortedSlots[index] = entity->stateSlot;
 			entity->zero_index = index;
 		}
 		
@@ -3733,6 +3812,13 @@ static BOOL MaintainLinkedLists(OOUniverse *uni)
 {
 	if (entity != nil && ![entity isPlayer])
 	{
+		if (EXPECT_NOT([concurrentUpdater isUpdating]))
+		{
+			// Called from a concurrent -update:; removed by -update: when the batch is done.
+			[concurrentUpdater deferRemovalOfEntity:entity];
+			return YES;
+		}
+		
 		/*	Ensure entity won't actually be dealloced until the end of this
 			update (or the next update if none is in progress), because
 			there may be things pointing to it but not retaining it.
@@ -4339,33 +4425,142 @@ static BOOL MaintainLinkedLists(OOUniverse *uni)
 }
 
 
+/*	Fill rangeTests, indexed by state slot, with values that are negative for
+	entities within range of p1. Negative range means infinity.
+	Every entity in sortedEntities has a slot, since the hot state has room
+	for UNIVERSE_MAX_ENTITIES.
+*/
+static void GetRangeTests(OOEntityHotState *hotState, Vector p1, double range, GLfloat *rangeTests)
+{
+	NSUInteger slotLimit = [hotState slotLimit];
+	
+	if (range < 0)
+	{
+		NSUInteger i;
+		for (i = 0; i < slotLimit; i++)  rangeTests[i] = -1.0f;
+	}
+	else
+	{
+		[hotState getRangeTestsFrom:p1 range:range into:rangeTests];
+	}
+}
+
+
+static int CompareEntitiesByZeroIndex(const void *a, const void *b)
+{
+	int ia = (*(OOEntity * const *)a)->zero_index;
+	int ib = (*(OOEntity * const *)b)->zero_index;
+	return (ia > ib) - (ia < ib);
+}
+
+
+/*	Fill candidates with the entities within range of p1, using the spatial
+	index, and return the number found. If sorted, they're put in
+	distance-from-player order, as the linear sweeps return them.
+	candidates must have room for -[OOEntityHotState slotLimit] entities.
+*/
+static unsigned GetIndexedRangeCandidates(OOUniverse *uni, Vector p1, double range, BOOL sorted, OOEntity **candidates)
+{
+	OOEntityStateSlot	slots[[uni->entityHotState slotLimit]];
+	NSUInteger			i, count;
+	unsigned			found = 0;
+	
+	count = [uni->spatialIndex getSlotsWithinRange:range ofPoint:p1 into:slots];
+	for (i = 0; i < count; i++)
+	{
+		OOEntity *e2 = uni->slotEntities[slots[i]];
+		if (e2 != nil)  candidates[found++] = e2;
+	}
+	
+	if (sorted)  qsort(candidates, found, sizeof *candidates, CompareEntitiesByZeroIndex);
+	
+	return found;
+}
+
+
+typedef struct
+{
+	OOEntity				**slotEntities;
+	OOEntity				*reference;
+} NearestEntityFilterContext;
+
+
+// Spatial index filters run during the traversal, so they mustn't call anything that could change the universe.
+static BOOL NearestEntityFilter(OOEntityStateSlot slot, void *context)
+{
+	NearestEntityFilterContext *filterContext = context;
+	OOEntity *e2 = filterContext->slotEntities[slot];
+	
+	return e2 != nil && e2 != filterContext->reference;
+}
+
+
+static BOOL ScannedShipFilter(OOEntityStateSlot slot, void *context)
+{
+	NearestEntityFilterContext *filterContext = context;
+	OOEntity *e2 = filterContext->slotEntities[slot];
+	
+	return e2 != nil && e2 != filterContext->reference && e2->isShip;
+}
+
+
 - (unsigned) countEntitiesMatchingPredicate:(EntityFilterPredicate)predicate
 								  parameter:(void *)parameter
 									inRange:(double)range
 								   ofEntity:(OOEntity *)e1
+{
+	unsigned		i, count, found = 0;
+	Vector			p1;
+	
+	// Unlimited range has to look at everything anyway.
+	if (spatialIndex == nil || range < 0)
+	{
+		return [self countEntitiesMatchingPredicateLinear:predicate parameter:parameter inRange:range ofEntity:e1];
+	}
+	
+	OOEntity		*candidates[[entityHotState slotLimit]];
+	
+	if (predicate == NULL)  predicate = YESPredicate;
+	
+	if (e1 != nil)  p1 = e1->position;
+	else  p1 = kZeroVector;
+	
+	count = GetIndexedRangeCandidates(self, p1, range, NO, candidates);
+	for (i = 0; i < count; i++)
+	{
+		OOEntity *e2 = candidates[i];
+		if (e2 != e1 && predicate(e2, parameter))
+		{
+			found++;
+		}
+	}
+	
+	return found;
+}
+
+
+- (unsigned) countEntitiesMatchingPredicateLinear:(EntityFilterPredicate)predicate
+										parameter:(void *)parameter
+										  inRange:(double)range
+										 ofEntity:(OOEntity *)e1
 {
 	unsigned		i, found = 0;
-	Vector			p1, p2;
-	double			distance, cr;
+	Vector			p1;
+	GLfloat			rangeTests[[entityHotState slotLimit]];
 	
 	if (predicate == NULL)  predicate = YESPredicate;
 	
 	if (e1 != nil)  p1 = e1->position;
 	else  p1 = kZeroVector;
 	
+	GetRangeTests(entityHotState, p1, range, rangeTests);
+	
 	for (i = 0; i < n_entities; i++)
 	{
-		OOEntity *e2 = sortedEntities[i];
-		if (e2 != e1 && predicate(e2, parameter))
+		if (rangeTests[sortedSlots[i]] < 0)
 		{
-			if (range < 0)  distance = -1;	// Negative range means infinity
-			else
-			{
-				p2 = vector_subtract(e2->position, p1);
-				cr = range + e2->collision_radius;
-				distance = magnitude2(p2) - cr * cr;
-			}
-			if (distance < 0)
+			OOEntity *e2 = sortedEntities[i];
+			if (e2 != e1 && predicate(e2, parameter))
 			{
 				found++;
 			}
@@ -4404,15 +4599,6 @@ static BOOL MaintainLinkedLists(OOUniverse *uni)
 }
 
 
-OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
-{
-	if (range < 0)  return YES;
-	Vector p2 = vector_subtract(e2->position, p1);
-	float cr = range + e2->collision_radius;
-	return magnitude2(p2) < cr * cr;
-}
-
-
 // NOTE: OOJSSystem relies on this returning entities in distance-from-player order.
 // This can be easily changed by removing the [reference isPlayer] conditions in FindJSVisibleEntities().
 - (NSMutableArray *) findEntitiesMatchingPredicate:(EntityFilterPredicate)predicate
@@ -4422,9 +4608,56 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 {
 	OOJS_PROFILE_ENTER
 	
+	unsigned		i, count;
+	Vector			p1;
+	NSMutableArray	*result = nil;
+	
+	if (spatialIndex == nil || range < 0)
+	{
+		return [self findEntitiesMatchingPredicateLinear:predicate parameter:parameter inRange:range ofEntity:e1];
+	}
+	
+	OOEntity		*candidates[[entityHotState slotLimit]];
+	
+	OOJSPauseTimeLimiter();
+	
+	if (predicate == NULL)  predicate = YESPredicate;
+	
+	if (e1 != nil)  p1 = [e1 position];
+	else  p1 = kZeroVector;
+	
+	count = GetIndexedRangeCandidates(self, p1, range, YES, candidates);
+	result = [NSMutableArray arrayWithCapacity:count];
+	
+	for (i = 0; i < count; i++)
+	{
+		OOEntity *e2 = candidates[i];
+		
+		if (e1 != e2 && predicate(e2, parameter))
+		{
+			[result addObject:e2];
+		}
+	}
+	
+	OOJSResumeTimeLimiter();
+	
+	return result;
+	
+	OOJS_PROFILE_EXIT
+}
+
+
+- (NSMutableArray *) findEntitiesMatchingPredicateLinear:(EntityFilterPredicate)predicate
+											   parameter:(void *)parameter
+												 inRange:(double)range
+												ofEntity:(OOEntity *)e1
+{
+	OOJS_PROFILE_ENTER
+	
 	unsigned		i;
 	Vector			p1;
 	NSMutableArray	*result = nil;
+	GLfloat			rangeTests[[entityHotState slotLimit]];
 	
 	OOJSPauseTimeLimiter();
 	
@@ -4435,15 +4668,18 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 	if (e1 != nil)  p1 = [e1 position];
 	else  p1 = kZeroVector;
 	
+	GetRangeTests(entityHotState, p1, range, rangeTests);
+	
 	for (i = 0; i < n_entities; i++)
 	{
-		OOEntity *e2 = sortedEntities[i];
-		
-		if (e1 != e2 &&
-			EntityInRange(p1, e2, range) &&
-			predicate(e2, parameter))
+		if (rangeTests[sortedSlots[i]] < 0)
 		{
-			[result addObject:e2];
+			OOEntity *e2 = sortedEntities[i];
+			
+			if (e1 != e2 && predicate(e2, parameter))
+			{
+				[result addObject:e2];
+			}
 		}
 	}
 	
@@ -4505,31 +4741,128 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 }
 
 
+#define NEAREST_QUERY_BATCH_SIZE		8
+
+
+typedef struct
+{
+	OOEntity				*entity;
+	GLfloat					distanceSquared;
+} NearestCandidate;
+
+
+// Nearest first, then in distance-from-player order, as the linear sweep meets them.
+static int CompareNearestCandidates(const void *a, const void *b)
+{
+	const NearestCandidate *ca = a, *cb = b;
+	
+	if (ca->distanceSquared != cb->distanceSquared)  return (ca->distanceSquared > cb->distanceSquared) ? 1 : -1;
+	return (ca->entity->zero_index > cb->entity->zero_index) - (ca->entity->zero_index < cb->entity->zero_index);
+}
+
+
 - (id) nearestEntityMatchingPredicate:(EntityFilterPredicate)predicate
 							parameter:(void *)parameter
 					 relativeToEntity:(OOEntity *)entity
+{
+	Vector			p1;
+	NSUInteger		i, count, candidateCount, batchSize, slotLimit;
+	GLfloat			tested = 0.0f, limit;
+	BOOL			complete;
+	
+	if (spatialIndex == nil)
+	{
+		return [self nearestEntityMatchingPredicateLinear:predicate parameter:parameter relativeToEntity:entity];
+	}
+	
+	if (predicate == NULL)  predicate = YESPredicate;
+	
+	if (entity != nil)  p1 = [entity position];
+	else  p1 = kZeroVector;
+	
+	slotLimit = [entityHotState slotLimit];
+	OOEntityStateSlot	slots[slotLimit];
+	GLfloat				distances2[slotLimit];
+	NearestCandidate	candidates[slotLimit];
+	
+	NearestEntityFilterContext context =
+	{
+		slotEntities, entity
+	};
+	
+	/*	The predicate may call into JavaScript and change the universe, so it
+		isn't run as a filter during the index traversal. Instead, take the
+		nearest few entities and test them in the order the linear sweep
+		would prefer them, so ties are broken the same way. If none match,
+		take twice as many and test the ones not yet seen.
+	
+		When a batch is full, the furthest entries in it may be only some of
+		those at that distance, so they're left for the next batch.
+	*/
+	for (batchSize = NEAREST_QUERY_BATCH_SIZE; ; batchSize *= 2)
+	{
+		if (batchSize > slotLimit)  batchSize = slotLimit;
+		
+		count = [spatialIndex getNearestSlots:batchSize
+									  toPoint:p1
+								  withinRange:INFINITY
+									   filter:NearestEntityFilter
+									  context:&context
+										 into:slots
+							 distancesSquared:distances2];
+		complete = count < batchSize || batchSize == slotLimit;
+		limit = complete ? INFINITY : distances2[count - 1];
+		
+		candidateCount = 0;
+		for (i = 0; i < count && distances2[i] < limit; i++)
+		{
+			if (distances2[i] < tested)  continue;
+			candidates[candidateCount].entity = slotEntities[slots[i]];
+			candidates[candidateCount].distanceSquared = distances2[i];
+			candidateCount++;
+		}
+		qsort(candidates, candidateCount, sizeof *candidates, CompareNearestCandidates);
+		
+		for (i = 0; i < candidateCount; i++)
+		{
+			if (predicate(candidates[i].entity, parameter))  return [[candidates[i].entity retain] autorelease];
+		}
+		
+		if (complete)  return nil;
+		tested = limit;
+	}
+}
+
+
+- (id) nearestEntityMatchingPredicateLinear:(EntityFilterPredicate)predicate
+								  parameter:(void *)parameter
+						   relativeToEntity:(OOEntity *)entity
 {
 	unsigned		i;
 	Vector			p1;
 	float			rangeSq = INFINITY;
 	id				result = nil;
+	GLfloat			distances[[entityHotState slotLimit]];
 	
 	if (predicate == NULL)  predicate = YESPredicate;
 	
 	if (entity != nil)  p1 = [entity position];
 	else  p1 = kZeroVector;
 	
+	[entityHotState getDistancesSquaredFrom:p1 into:distances];
+	
 	for (i = 0; i < n_entities; i++)
 	{
-		OOEntity *e2 = sortedEntities[i];
-		float distanceToReferenceEntitySquared = (float)distance2(p1, [e2 position]);
+		float distanceToReferenceEntitySquared = distances[sortedSlots[i]];
 		
-		if (entity != e2 &&
-			distanceToReferenceEntitySquared < rangeSq &&
-			predicate(e2, parameter))
+		if (distanceToReferenceEntitySquared < rangeSq)
 		{
-			result = e2;
-			rangeSq = distanceToReferenceEntitySquared;
+			OOEntity *e2 = sortedEntities[i];
+			if (entity != e2 && predicate(e2, parameter))
+			{
+				result = e2;
+				rangeSq = distanceToReferenceEntitySquared;
+			}
 		}
 	}
 	
@@ -4589,7 +4922,10 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 	for (i = 0; i < n_entities; i++)
 		[universeRegion checkEntity: sortedEntities[i]];	//	sorts out which region it's in
 	
-	[universeRegion findCollisions];
+	if (broadPhaseMode == kOOBroadPhaseGrid)
+		[universeRegion findCollisionsWithPairs:[broadPhase pairs] count:[broadPhase pairCount] entities:sortedEntities];
+	else
+		[universeRegion findCollisions];
 	
 	// do check for entities that can't see the sun!
 	[universeRegion findShadowedEntities];
@@ -4946,6 +5282,50 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 }
 
 
+/*	Bubble an entity that has just been updated into place in the
+	distance-from-player list. If it has to move more than
+	ZERO_DISTANCE_BUBBLE_LIMIT places, the list is badly out of order (after a
+	witchspace jump or a teleport, for instance) and bubbling every entity
+	would be quadratic, so stop bubbling for the rest of this update and
+	re-sort the whole list with -sortEntitiesByZeroDistance afterwards.
+*/
+#define ZERO_DISTANCE_BUBBLE_LIMIT		32
+
+static void UpdateZeroDistanceOrder(OOUniverse *uni, OOEntity *thing)
+{
+	OOEntity			**sortedEntities = uni->sortedEntities;
+	OOEntityStateSlot	*sortedSlots = uni->sortedSlots;
+	unsigned			swaps = 0;
+	
+	[thing storeHotState:uni->entityHotState];
+	if (uni->zeroDistanceOrderDirty)  return;
+	
+	GLfloat z_distance = thing->zero_distance;
+	const GLfloat *zeroDistances = uni->entityHotState->zeroDistance;
+	
+	int index = thing->zero_index;
+	while (index > 0 && z_distance < zeroDistances[sortedSlots[index - 1]])
+	{
+		if (EXPECT_NOT(swaps == ZERO_DISTANCE_BUBBLE_LIMIT))
+		{
+			uni->zeroDistanceOrderDirty = YES;
+			break;
+		}
+		
+		sortedEntities[index] = sortedEntities[index - 1];	// bubble up the list, usually by just one position
+		sortedSlots[index] = sortedSlots[index - 1];
+		sortedEntities[index - 1] = thing;
+		sortedSlots[index - 1] = thing->stateSlot;
+		thing->zero_index = index - 1;
+		sortedEntities[index]->zero_index = index;
+		index--;
+		swaps++;
+	}
+	
+	uni->zeroDistanceSwaps += swaps;
+}
+
+
 - (void) update:(OOTimeDelta)inDeltaT
 {
 	_realTime += inDeltaT;	// PRIOR to TAF scaling.
@@ -4985,6 +5365,7 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 			universal_time += delta_t;
 			
 			update_stage = @"demo management";
+			OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageDemo);
 			if ([player showDemoShips] && [player guiScreen] == GUI_SCREEN_INTRO2)
 			{
 				if (universal_time >= demo_stage_time)
@@ -5058,6 +5439,9 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 			
 			update_stage = @"update:entity";
 			NSMutableSet *zombies = nil;
+			OOEntity *concurrentEntities[ent_count];
+			unsigned concurrentCount = 0;
+			zeroDistanceSwaps = 0;
 			
 			for (i = 0; i < ent_count; i++)
 			{
@@ -5066,6 +5450,7 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 				update_stage_param = thing;
 				update_stage = @"update:entity [%@]";
 #endif
+				OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageEntity);
 				// Game Over code depends on regular delta_t updates to the dead player entity. Ignore the player entity, even when dead.
 				if (EXPECT_NOT([thing status] == STATUS_DEAD && ![entitiesDeadThisUpdate containsObject:thing] && ![thing isPlayer]))
 				{
@@ -5074,6 +5459,12 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 					continue;
 				}
 				
+				if (concurrentUpdater != nil && [thing canUpdateConcurrently])
+				{
+					concurrentEntities[concurrentCount++] = thing;
+					continue;
+				}
+				
 				[thing update:delta_t];
 				if (sessionID != _sessionID)
 				{
@@ -5084,34 +5475,33 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 #ifndef NDEBUG
 				update_stage = @"update:list maintenance [%@]";
 #endif
+				OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageListMaintenance);
 				
 				// maintain distance-from-player list
-				GLfloat z_distance = thing->zero_distance;
+				UpdateZeroDistanceOrder(self, thing);
 				
-				int index = thing->zero_index;
-				while (index > 0 && z_distance < sortedEntities[index - 1]->zero_distance)
-				{
-					sortedEntities[index] = sortedEntities[index - 1];	// bubble up the list, usually by just one position
-					sortedEntities[index - 1] = thing;
-					thing->zero_index = index - 1;
-					sortedEntities[index]->zero_index = index;
-					index--;
-				}
-				
-				// update deterministic AI
+				// update deterministic AI; NPCs think after the entity loop, within the frame's AI budget
 				if ([thing isShip])
 				{
-#ifndef NDEBUG
-					update_stage = @"update:think [%@]";
-#endif
 					AI* theShipsAI = [(OOShipEntity *)thing getAI];
 					if (theShipsAI)
 					{
-						double thinkTime = [theShipsAI nextThinkTime];
-						if ((universal_time > thinkTime)||(thinkTime == 0.0))
+						if ([thing isPlayer])
+						{
+#ifndef NDEBUG
+							update_stage = @"update:think [%@]";
+#endif
+							OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageThink);
+							double thinkTime = [theShipsAI nextThinkTime];
+							if ((universal_time > thinkTime)||(thinkTime == 0.0))
+							{
+								[theShipsAI setNextThinkTime:universal_time + [theShipsAI thinkTimeInterval]];
+								[theShipsAI think];
+							}
+						}
+						else
 						{
-							[theShipsAI setNextThinkTime:universal_time + [theShipsAI thinkTimeInterval]];
-							[theShipsAI think];
+							[thinkScheduler addAI:theShipsAI ifDueAtTime:universal_time];
 						}
 					}
 				}
@@ -5120,9 +5510,54 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 		update_stage_param = nil;
 #endif
 			
+			if (sessionID == _sessionID)
+			{
+				update_stage = @"update:think";
+				OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageThink);
+				[thinkScheduler runThinksAtTime:universal_time];
+			}
+			else
+			{
+				// Game was reset; forget the thinks queued before it.
+				[thinkScheduler cancelThinks];
+			}
+			
+			/*	Entities that don't interact with anything are updated after
+				everything else, so that they see the player in its new
+				position as before, and may be spread over several threads.
+			*/
+			if (concurrentCount != 0 && sessionID == _sessionID)
+			{
+				update_stage = @"update:entity (concurrent)";
+				OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageEntity);
+				[concurrentUpdater updateEntities:concurrentEntities count:concurrentCount delta:delta_t];
+				
+				NSEnumerator *removalEnum = nil;
+				OOEntity *removal = nil;
+				for (removalEnum = [[concurrentUpdater takeDeferredRemovals] objectEnumerator]; (removal = [removalEnum nextObject]); )
+				{
+					[self removeEntity:removal];
+				}
+				
+				update_stage = @"update:list maintenance (concurrent)";
+				OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageListMaintenance);
+				for (i = 0; i < concurrentCount; i++)
+				{
+					UpdateZeroDistanceOrder(self, concurrentEntities[i]);
+				}
+			}
+			
+			if (zeroDistanceOrderDirty)
+			{
+				update_stage = @"update:list maintenance (full sort)";
+				OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageListMaintenance);
+				[self sortEntitiesByZeroDistance];
+			}
+			
 			if (zombies != nil)
 			{
 				update_stage = @"shootin' zombies";
+				OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageZombies);
 				NSEnumerator *zombieEnum = nil;
 				OOEntity *zombie = nil;
 				for (zombieEnum = [zombies objectEnumerator]; (zombie = [zombieEnum nextObject]); )
@@ -5134,6 +5569,7 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 			
 			// Maintain x/y/z order lists
 			update_stage = @"updating linked lists";
+			OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageLinkedLists);
 			for (i = 0; i < ent_count; i++)
 			{
 				[my_entities[i] updateLinkedLists];
@@ -5142,8 +5578,15 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 			// detect collisions and light ships that can see the sun
 			
 			update_stage = @"collision and shadow detection";
-			[self filterSortedLists];
+			OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageBroadPhase);
+			[self runBroadPhase];
+			OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageCollisionsAndShadows);
 			[self findCollisionsAndShadows];
+			OO_UPDATE_BENCHMARK_MARK(kOOUpdateStageOther);
+			
+			// positions set during collision handling went through the setters, so the hot state is current
+			[spatialIndex rebuildWithSlots:sortedSlots count:n_entities];
+			shipScannersDirty = YES;
 			
 			// do any required check and maintenance of linked lists
 			
@@ -5154,6 +5597,7 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 			}
 
 		NS_HANDLER
+			[thinkScheduler cancelThinks];
 			if ([[localException name] hasPrefix:@"Oolite"])
 				[self handleOoliteException:localException];
 			else
@@ -5474,6 +5918,137 @@ OOINLINE BOOL EntityInRange(Vector p1, OOEntity *e2, float range)
 }
 
 
+- (void) findBroadPhasePairs
+{
+	unsigned			i;
+	NSUInteger			pairCount;
+	const OOBroadPhasePair *pairs = NULL;
+	OOEntity			*e0 = nil;
+	OOEntityHotState	*hot = entityHotState;
+	
+	[broadPhase removeAllRecords];
+	for (i = 0; i < n_entities; i++)
+	{
+		/*	Ask the entity rather than trusting the stored flag: status changes
+			and fuse or arrival times can change it after the state was stored.
+		*/
+		OOEntityStateSlot slot = sortedSlots[i];
+		hot->canCollide[slot] = [sortedEntities[i] canCollide];
+		if (hot->canCollide[slot])
+			[broadPhase addRecordAtPosition:OOEntityHotStateGetPosition(hot, slot) radius:hot->radius[slot] index:i];
+	}
+	for (i = 0; i < n_entities; i++)
+	{
+		e0 = sortedEntities[i];
+		e0->collision_chain = nil;
+		// As with filterSortedLists, anything without a candidate partner is filtered out.
+		e0->collisionTestFilter = YES;
+	}
+	
+	[broadPhase findPairs];
+	
+	pairs = [broadPhase pairs];
+	pairCount = [broadPhase pairCount];
+	for (i = 0; i < pairCount; i++)
+	{
+		sortedEntities[pairs[i].a]->collisionTestFilter = NO;
+		sortedEntities[pairs[i].b]->collisionTestFilter = NO;
+	}
+}
+
+
+- (NSUInteger) zeroDistanceSwapCount
+{
+	return zeroDistanceSwaps;
+}
+
+
+- (NSUInteger) zeroDistanceResortCount
+{
+	return zeroDistanceResorts;
+}
+
+
+static void ScanForShip(OOUniverse *uni, OOShipEntity *ship)
+{
+	unsigned			i, count;
+	OOEntityStateSlot	slots[MAX_SCAN_NUMBER];
+	GLfloat				distances2[MAX_SCAN_NUMBER];
+	OOShipEntity		*ships[MAX_SCAN_NUMBER];
+	
+	NearestEntityFilterContext context =
+	{
+		uni->slotEntities, ship
+	};
+	
+	count = [uni->spatialIndex getNearestSlots:MAX_SCAN_NUMBER
+									   toPoint:ship->position
+								   withinRange:MIN([ship scannerRange], SCANNER_MAX_RANGE)
+										filter:ScannedShipFilter
+									   context:&context
+										  into:slots
+							  distancesSquared:distances2];
+	
+	for (i = 0; i < count; i++)  ships[i] = (OOShipEntity *)uni->slotEntities[slots[i]];
+	[ship setScannedShips:ships distancesSquared:distances2 count:count generation:uni->scannerGeneration];
+}
+
+
+- (BOOL) updateShipScanners
+{
+	unsigned			i;
+	
+	if (spatialIndex == nil)  return NO;
+	if (!shipScannersDirty)  return YES;
+	
+	scannerGeneration++;
+	shipScannersDirty = NO;
+	
+	for (i = 0; i < n_entities; i++)
+	{
+		OOEntity *e1 = sortedEntities[i];
+		if (e1->isShip)  ScanForShip(self, (OOShipEntity *)e1);
+	}
+	
+	return YES;
+}
+
+
+- (BOOL) updateScannerForShip:(OOShipEntity *)ship
+{
+	if (spatialIndex == nil || ship->stateSlot == kOOEntityStateNoSlot)  return NO;
+	
+	ScanForShip(self, ship);
+	return YES;
+}
+
+
+- (NSUInteger) scannerGeneration
+{
+	return scannerGeneration;
+}
+
+
+- (OOBroadPhaseMode) broadPhaseMode
+{
+	return broadPhaseMode;
+}
+
+
+- (void) setBroadPhaseMode:(OOBroadPhaseMode)mode
+{
+	if (mode != broadPhaseMode)
+	{
+		broadPhaseMode = mode;
+		broadPhaseCompareFrames = 0;
+		broadPhaseCompareListPairs = 0;
+		broadPhaseCompareGridPairs = 0;
+		broadPhaseCompareListTime = 0;
+		broadPhaseCompareGridTime = 0;
+	}
+}
+
+
 - (void) setGalaxySeed:(Random_Seed) gal_seed
 {
 	[self setGalaxySeed:gal_seed andReinit:NO];
@@ -8422,6 +8997,147 @@ OOEntity *gOOJSPlayerIfStale = nil;
 }
 
 
+- (void) runBroadPhase
+{
+	switch (broadPhaseMode)
+	{
+		case kOOBroadPhaseLinkedLists:
+			[self filterSortedLists];
+			break;
+			
+		case kOOBroadPhaseGrid:
+			[self findBroadPhasePairs];
+			break;
+			
+		case kOOBroadPhaseCompare:
+			[self compareBroadPhases];
+			break;
+	}
+}
+
+
+/*	Run both broad phases on the same scene and accumulate pair counts and
+	timings. The grid runs first because filterSortedLists must have the last
+	word on collisionTestFilter and collision_chain, which the narrow phase
+	uses in this mode.
+*/
+#define BROAD_PHASE_COMPARE_INTERVAL	300
+
+- (void) compareBroadPhases
+{
+	OOProfilingStopwatch	*stopwatch = [OOProfilingStopwatch stopwatch];
+	OOEntity				*e0 = nil, *e1 = nil;
+	
+	[self findBroadPhasePairs];
+	broadPhaseCompareGridTime += [stopwatch reset];
+	
+	[self filterSortedLists];
+	broadPhaseCompareListTime += [stopwatch reset];
+	
+	broadPhaseCompareGridPairs += [broadPhase pairCount];
+	for (e0 = z_list_start; e0 != nil; e0 = e0->z_next)
+	{
+		if (e0->collisionTestFilter)  continue;
+		for (e1 = e0->collision_chain; e1 != nil; e1 = e1->collision_chain)
+		{
+			broadPhaseCompareListPairs++;
+		}
+	}
+	
+	if (++broadPhaseCompareFrames == BROAD_PHASE_COMPARE_INTERVAL)
+	{
+		double frames = broadPhaseCompareFrames;
+		OOLog(@"universe.broadPhase.compare", @"Broad phase over %u frames with %u entities: linked lists %.1f pairs/frame, %.3f ms/frame; grid %.1f pairs/frame, %.3f ms/frame (%lu large records, %lu box tests last frame).",
+			  broadPhaseCompareFrames, n_entities,
+			  broadPhaseCompareListPairs / frames, broadPhaseCompareListTime * 1000.0 / frames,
+			  broadPhaseCompareGridPairs / frames, broadPhaseCompareGridTime * 1000.0 / frames,
+			  (unsigned long)[broadPhase largeRecordCount], (unsigned long)[broadPhase boxTestCount]);
+		
+		broadPhaseCompareFrames = 0;
+		broadPhaseCompareListPairs = 0;
+		broadPhaseCompareGridPairs = 0;
+		broadPhaseCompareListTime = 0;
+		broadPhaseCompareGridTime = 0;
+	}
+}
+
+
+OOINLINE uint32_t RadixKeyForFloat(GLfloat value)
+{
+	union { GLfloat f; uint32_t u; } bits = { value };
+	
+	// Flip all the bits of negative values and the sign bit of positive ones, so that unsigned order is float order.
+	return (bits.u & 0x80000000) ? ~bits.u : (bits.u | 0x80000000);
+}
+
+
+/*	Stable LSD radix sort of sortedEntities on the packed zero distances,
+	linear in the number of entities. Entities with equal distances keep
+	their existing order.
+*/
+- (void) sortEntitiesByZeroDistance
+{
+	unsigned			i, pass, count = n_entities;
+	const GLfloat		*zeroDistances = entityHotState->zeroDistance;
+	uint32_t			keysA[count], keysB[count];
+	unsigned			orderA[count], orderB[count];
+	uint32_t			*keys = keysA, *keysOut = keysB, *keysSwap = NULL;
+	unsigned			*order = orderA, *orderOut = orderB, *orderSwap = NULL;
+	OOEntity			*oldEntities[count];
+	OOEntityStateSlot	oldSlots[count];
+	
+	zeroDistanceOrderDirty = NO;
+	if (count < 2)  return;
+	
+	for (i = 0; i < count; i++)
+	{
+		keys[i] = RadixKeyForFloat(zeroDistances[sortedSlots[i]]);
+		order[i] = i;
+	}
+	
+	for (pass = 0; pass < 4; pass++)
+	{
+		unsigned shift = pass * 8;
+		unsigned offsets[256] = {0};
+		unsigned total = 0;
+		
+		for (i = 0; i < count; i++)  offsets[(keys[i] >> shift) & 0xFF]++;
+		
+		// Distances are often close in magnitude, so whole passes can often be skipped.
+		if (offsets[(keys[0] >> shift) & 0xFF] == count)  continue;
+		
+		for (i = 0; i < 256; i++)
+		{
+			unsigned bucketCount = offsets[i];
+			offsets[i] = total;
+			total += bucketCount;
+		}
+		
+		for (i = 0; i < count; i++)
+		{
+			unsigned dest = offsets[(keys[i] >> shift) & 0xFF]++;
+			keysOut[dest] = keys[i];
+			orderOut[dest] = order[i];
+		}
+		
+		keysSwap = keys; keys = keysOut; keysOut = keysSwap;
+		orderSwap = order; order = orderOut; orderOut = orderSwap;
+	}
+	
+	memcpy(oldEntities, sortedEntities, count * sizeof *oldEntities);
+	memcpy(oldSlots, sortedSlots, count * sizeof *oldSlots);
+	for (i = 0; i < count; i++)
+	{
+		if (order[i] != i)  zeroDistanceSwaps++;
+		sortedEntities[i] = oldEntities[order[i]];
+		sortedSlots[i] = oldSlots[order[i]];
+		sortedEntities[i]->zero_index = i;
+	}
+	
+	zeroDistanceResorts++;
+}
+
+
 - (void) verifyEntitySessionIDs
 {
 #ifndef NDEBUG
@@ -8672,6 +9388,7 @@ OOEntity *gOOJSPlayerIfStale = nil;
 				while (((unsigned)index + n < n_entities)&&(sortedEntities[index + n] == entity))
 					n++;	// ie there's a duplicate entry for this entity
 				sortedEntities[index] = sortedEntities[index + n];	// copy entity[index + n] -> entity[index] (preserves sort order)
+				sortedSlots[index] = sortedSlots[index + n];
 				if (sortedEntities[index])
 					sortedEntities[index]->zero_index = index;				// give it its correct position
 				index++;
@@ -8682,11 +9399,19 @@ OOEntity *gOOJSPlayerIfStale = nil;
 			{
 				n_entities--;
 				sortedEntities[n_entities] = nil;
+				sortedSlots[n_entities] = kOOEntityStateNoSlot;
 			}
 		}
 		entity->zero_index = -1;	// it's GONE!
 	}
 	
+	if (entity->stateSlot != kOOEntityStateNoSlot)
+	{
+		slotEntities[entity->stateSlot] = nil;
+		[entityHotState freeSlot:entity->stateSlot];
+		entity->stateSlot = kOOEntityStateNoSlot;
+	}
+	
 	// remove from the definitive list
 	if ([entities containsObject:entity])
 	{
@@ -4,6 +4,16 @@ Octtree.h
 
 Octtree class for collision detection.
 
+The octree is stored as an array of ints, one per cell: 0 for empty, -1 for
+solid, or otherwise the offset from the cell to its eight children. This is
+the form that is cached and archived. For hit testing, a flat copy of the
+subdivided cells is built when the octree is created: each node has a mask
+of non-empty children, a mask of solid children, and the index of its first
+subdivided child, the others following in octant order. The tests walk this
+with an explicit stack instead of recursing, visiting cells in the same
+order and doing the same arithmetic as the original recursive tests, so the
+results are identical.
+
 Oolite
 Copyright (C) 2004-2011 Giles C Williams and contributors
 
@@ -28,6 +38,7 @@ MA 02110-1301, USA.
 #import "OOTriangle.h"
 
 #define	OCTREE_MIN_RADIUS	1.0
+#define OCTREE_MAX_DEPTH	16		// Deeper subdivision is treated as solid. Meshes use up to 7.
 
 
 #if !defined(OODEBUGLDRAWING_DISABLE) && defined(NDEBUG)
@@ -51,6 +62,11 @@ typedef struct
 	BOOL			hasCollision;
 	
 	unsigned char	*octree_collision;
+	BOOL			collisionMarksDirty;
+	
+	struct OOOctreeNode *nodes;
+	unsigned		nodeCount;
+	int				rootNode;		// 0, or kOctreeCellEmpty/kOctreeCellSolid if the root isn't subdivided.
 }
 
 - (GLfloat)	radius;
@@ -90,6 +106,10 @@ Vector offsetForOctant(int oct, GLfloat r);
 
 #ifndef NDEBUG
 - (size_t) totalSize;
+
+// The original recursive tests, kept as a reference for OOOctreeBenchmark.
+- (GLfloat) legacyIsHitByLine:(Vector)v0 :(Vector)v1;
+- (BOOL) legacyIsHitByOctree:(Octree *)other withOrigin:(Vector)v0 andIJK:(Triangle)ijk andScales:(GLfloat)s1 :(GLfloat)s2;
 #endif
 
 @end
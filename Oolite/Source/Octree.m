@@ -30,6 +30,10 @@ MA 02110-1301, USA.
 #import "OODebugFlags.h"
 #import "OOVoxel.h"
 
+#ifndef NDEBUG
+#import "OOOctreeBenchmark.h"
+#endif
+
 
 #ifndef NDEBUG
 #define OctreeDebugLog(format, ...) do { if (EXPECT_NOT(gDebugFlags & DEBUG_OCTREE_LOGGING))  OOLog(@"octree.debug", format, ## __VA_ARGS__); } while (0)
@@ -41,6 +45,8 @@ MA 02110-1301, USA.
 
 @interface Octree (Private)
 
+- (void) priv_buildNodes;
+
 #ifndef OODEBUGLDRAWING_DISABLE
 
 - (void) drawOctreeFromLocation:(int) loc :(GLfloat) scale :(Vector) offset;
@@ -51,11 +57,90 @@ MA 02110-1301, USA.
 @end
 
 
-static BOOL isHitByLine(int* octbuffer, unsigned char* collbuffer, int level, GLfloat rad, Vector v0, Vector v1, Vector off, int face_hit);
 static GLfloat volumeOfOctree(Octree_details octree_details, unsigned depthLimit);
 static Vector randomFullNodeFrom(Octree_details details, Vector offset);
 
-static BOOL	isHitByOctree(Octree_details axialDetails, Octree_details otherDetails, Vector delta, Triangle other_ijk);
+
+/*	Flat node layout used for hit testing; see Octree.h. Cells which aren't
+	nodes (solid leaves) are identified by their slot in octree[] alone.
+*/
+typedef struct OOOctreeNode
+{
+	uint8_t				childMask;		// Non-empty children.
+	uint8_t				solidMask;		// Solid children; the rest of childMask is subdivided.
+	uint16_t			depth;			// Only used while building.
+	uint32_t			firstChild;		// Index in nodes of the first subdivided child.
+	uint32_t			firstSlot;		// Index in octree[] and octree_collision[] of the eight children.
+} OOOctreeNode;
+
+
+enum
+{
+	kOctreeCellEmpty	= -2,
+	kOctreeCellSolid	= -1
+};
+
+
+typedef struct
+{
+	int					node;			// Index in nodes, or kOctreeCellSolid.
+	uint32_t			slot;
+} OctreeCell;
+
+
+typedef struct
+{
+	const OOOctreeNode	*nodes;
+	unsigned char		*collision;
+	BOOL				hasCollided;
+	GLfloat				hitDistance;
+} LineQuery;
+
+
+typedef struct
+{
+	int					node;
+	Vector				u0, u1;
+	GLfloat				rad;
+	uint8_t				nearest;
+	uint8_t				next;
+} LineFrame;
+
+
+typedef struct
+{
+	OctreeCell			axial, other;
+	Vector				position;
+	GLfloat				axialRadius, otherRadius;
+	uint8_t				otherLevel;
+	uint8_t				nearest;
+	uint8_t				next;
+	BOOL				descendOther;
+} PairFrame;
+
+
+typedef struct
+{
+	const OOOctreeNode	*axialNodes, *otherNodes;
+	unsigned char		*axialCollision, *otherCollision;
+	Triangle			ijk;
+	
+	// Other octree's octant offsets resolved in the axial frame, by level, filled in as needed.
+	uint8_t				otherOffsetReady[OCTREE_MAX_DEPTH];
+	Vector				otherOffsets[OCTREE_MAX_DEPTH][8];
+} PairQuery;
+
+
+enum
+{
+	kCellMiss,
+	kCellHit,
+	kCellDescend
+};
+
+
+// Order in which the line test visits children, XORed with the octant the line enters first.
+static const uint8_t kLineOrder[8] = { 0, 1, 2, 4, 6, 5, 3, 7 };
 
 
 @implementation Octree
@@ -70,6 +155,7 @@ static BOOL	isHitByOctree(Octree_details axialDetails, Octree_details otherDetai
 	octree[0] = 0;
 	octree_collision[0] = (char)0;
 	hasCollision = NO;
+	[self priv_buildNodes];
 	return self;
 }
 
@@ -77,6 +163,7 @@ static BOOL	isHitByOctree(Octree_details axialDetails, Octree_details otherDetai
 {
 	free(octree);
 	free(octree_collision);
+	free(nodes);
 	[super dealloc];
 }
 
@@ -137,6 +224,7 @@ static BOOL	isHitByOctree(Octree_details axialDetails, Octree_details otherDetai
 	}
 	
 	copyRepresentationIntoOctree( octreeArray, octree, 0, 1);
+	[self priv_buildNodes];
 	
 	return self;
 }
@@ -158,6 +246,7 @@ static BOOL	isHitByOctree(Octree_details axialDetails, Octree_details otherDetai
 		octree[i] = data[i];
 		octree_collision[i] = (char)0;
 	}
+	[self priv_buildNodes];
 	
 	return self;
 }
@@ -171,6 +260,90 @@ static BOOL	isHitByOctree(Octree_details axialDetails, Octree_details otherDetai
 	return [result autorelease];
 }
 
+
+- (void) priv_buildNodes
+{
+	unsigned			i, capacity = 0, next, badCells = 0;
+	
+	free(nodes);
+	nodes = NULL;
+	nodeCount = 0;
+	collisionMarksDirty = NO;
+	
+	if (leafs < 1 || octree[0] == 0)
+	{
+		rootNode = kOctreeCellEmpty;
+		return;
+	}
+	if (octree[0] < 0 || (size_t)octree[0] + 8 > (size_t)leafs)
+	{
+		// Anything negative other than -1 is bad data, and like a bad offset is treated as solid.
+		if (octree[0] != -1)  OOLogERR(@"octree.build.failed", @"Octree has a malformed root cell; treating it as solid.");
+		rootNode = kOctreeCellSolid;
+		return;
+	}
+	
+	for (i = 0; i < (unsigned)leafs; i++)
+	{
+		if (octree[i] > 0)  capacity++;
+	}
+	
+	nodes = malloc(capacity * sizeof *nodes);
+	if (EXPECT_NOT(nodes == NULL))
+	{
+		OOLogERR(@"octree.build.failed", @"Could not allocate %u octree nodes; treating octree as solid.", capacity);
+		rootNode = kOctreeCellSolid;
+		return;
+	}
+	
+	/*	Breadth-first, so that each node's subdivided children are contiguous.
+		Until a node is processed, its firstSlot is its own slot in octree[].
+	*/
+	rootNode = 0;
+	nodes[0].firstSlot = 0;
+	nodes[0].depth = 0;
+	next = 1;
+	
+	for (i = 0; i < next; i++)
+	{
+		OOOctreeNode	*node = &nodes[i];
+		size_t			base = node->firstSlot + octree[node->firstSlot];
+		unsigned		oct;
+		
+		node->childMask = 0;
+		node->solidMask = 0;
+		node->firstChild = next;
+		node->firstSlot = base;
+		
+		for (oct = 0; oct < 8; oct++)
+		{
+			size_t		childSlot = base + oct;
+			int			value = octree[childSlot];
+			
+			if (value == 0)  continue;
+			node->childMask |= 1U << oct;
+			
+			if (value > 0 && node->depth + 1 < OCTREE_MAX_DEPTH && childSlot + value + 8 <= (size_t)leafs && next < capacity)
+			{
+				nodes[next].firstSlot = childSlot;
+				nodes[next].depth = node->depth + 1;
+				next++;
+			}
+			else
+			{
+				if (value != -1)  badCells++;
+				node->solidMask |= 1U << oct;
+			}
+		}
+	}
+	
+	nodeCount = next;
+	if (badCells != 0)
+	{
+		OOLogERR(@"octree.build.failed", @"Octree has %u cells which are malformed or subdivided more than %u levels deep; treating them as solid.", badCells, OCTREE_MAX_DEPTH);
+	}
+}
+
 int copyRepresentationIntoOctree(NSObject* theRep, int* theBuffer, int atLocation, int nextFreeLocation)
 {
 	if ([theRep isKindOfClass:[NSNumber class]])	// ie. a terminating leaf
@@ -384,37 +557,360 @@ BOOL drawTestForCollisions;
 #endif // OODEBUGLDRAWING_DISABLE
 
 
-OOINLINE BOOL isHitByLineSub(int* octbuffer, unsigned char* collbuffer, int nextLevel, GLfloat rad, GLfloat rd2, Vector v0, Vector v1, int octantMask)
+int change_oct[] = {	0,	1,	2,	4,	3,	5,	6,	7};	// used to move from nearest to furthest octant
+
+
+OOINLINE OctreeCell ChildCell(const OOOctreeNode *node, unsigned oct)
+{
+	OctreeCell			result = { kOctreeCellSolid, node->firstSlot + oct };
+	
+	if (!(node->solidMask & (1U << oct)))
+	{
+		unsigned subdividedBefore = node->childMask & ~node->solidMask & ((1U << oct) - 1);
+		result.node = node->firstChild + __builtin_popcount(subdividedBefore);
+	}
+	return result;
+}
+
+
+static int EnterLineCell(LineQuery *query, OctreeCell cell, Vector u0, Vector u1, GLfloat rad, LineFrame *outFrame)
+{
+	if (cell.node == kOctreeCellSolid)
+	{
+		OctreeDebugLog(@"DEBUG Hit a solid octant: [%u]", cell.slot);
+		query->collision[cell.slot] = 2;	// green
+		query->hitDistance = sqrt( u0.x * u0.x + u0.y * u0.y + u0.z * u0.z);
+		return kCellHit;
+	}
+	
+	int faces = lineCubeIntersection( u0, u1, rad);
+	if (faces == 0)
+	{
+		OctreeDebugLog(@"----> Line misses octant: [%u].", cell.slot);
+		return kCellMiss;
+	}
+	
+	int octantIntersected = 0;
+	if (faces > 0)
+	{
+		Vector vi = lineIntersectionWithFace( u0, u1, faces, rad);
+		
+		if (CUBE_FACE_FRONT & faces)
+			octantIntersected = ((vi.x < 0.0)? 1: 5) + ((vi.y < 0.0)? 0: 2);
+		if (CUBE_FACE_BACK & faces)
+			octantIntersected = ((vi.x < 0.0)? 0: 4) + ((vi.y < 0.0)? 0: 2);
+		
+		if (CUBE_FACE_RIGHT & faces)
+			octantIntersected = ((vi.y < 0.0)? 4: 6) + ((vi.z < 0.0)? 0: 1);
+		if (CUBE_FACE_LEFT & faces)
+			octantIntersected = ((vi.y < 0.0)? 0: 2) + ((vi.z < 0.0)? 0: 1);
+		
+		if (CUBE_FACE_TOP & faces)
+			octantIntersected = ((vi.x < 0.0)? 2: 6) + ((vi.z < 0.0)? 0: 1);
+		if (CUBE_FACE_BOTTOM & faces)
+			octantIntersected = ((vi.x < 0.0)? 0: 4) + ((vi.z < 0.0)? 0: 1);
+	}
+	
+	query->hasCollided = YES;
+	query->collision[cell.slot] = 1;	// red
+	
+	outFrame->node = cell.node;
+	outFrame->u0 = u0;
+	outFrame->u1 = u1;
+	outFrame->rad = rad;
+	outFrame->nearest = octantIntersected;
+	outFrame->next = 0;
+	return kCellDescend;
+}
+
+
+/*	Walks the cells crossed by the line, starting with the octant it enters
+	first, then the three adjacent octants, then the three beyond those, and
+	finally the diagonally opposite one, and stops at the first solid cell.
+*/
+static BOOL IsHitByLine(LineQuery *query, OctreeCell root, GLfloat radius, Vector v0, Vector v1)
+{
+	LineFrame			stack[OCTREE_MAX_DEPTH];
+	unsigned			depth = 0;
+	Vector				u0 = make_vector(v0.x + kZeroVector.x, v0.y + kZeroVector.y, v0.z + kZeroVector.z);
+	Vector				u1 = make_vector(v1.x + kZeroVector.x, v1.y + kZeroVector.y, v1.z + kZeroVector.z);
+	
+	int result = EnterLineCell(query, root, u0, u1, radius, &stack[0]);
+	if (result != kCellDescend)  return result == kCellHit;
+	depth = 1;
+	
+	while (depth != 0)
+	{
+		LineFrame *frame = &stack[depth - 1];
+		if (frame->next == 8)
+		{
+			depth--;
+			continue;
+		}
+		
+		unsigned oct = frame->nearest ^ kLineOrder[frame->next++];
+		const OOOctreeNode *node = &query->nodes[frame->node];
+		if (!(node->childMask & (1U << oct)))  continue;
+		
+		GLfloat rd2 = 0.5 * frame->rad;
+		Vector off = offsetForOctant(oct, frame->rad);
+		u0 = make_vector(frame->u0.x + off.x, frame->u0.y + off.y, frame->u0.z + off.z);
+		u1 = make_vector(frame->u1.x + off.x, frame->u1.y + off.y, frame->u1.z + off.z);
+		
+		result = EnterLineCell(query, ChildCell(node, oct), u0, u1, rd2, &stack[depth]);
+		if (result == kCellHit)  return YES;
+		if (result == kCellDescend)  depth++;
+	}
+	
+	return NO;
+}
+
+
+- (GLfloat) isHitByLine: (Vector) v0: (Vector) v1
+{
+#ifndef NDEBUG
+	OOOctreeBenchmarkRecordLineQuery(self, v0, v1);
+#endif
+	
+	if (collisionMarksDirty)
+	{
+		memset(octree_collision, 0, leafs);
+		collisionMarksDirty = NO;
+	}
+	
+	if (rootNode == kOctreeCellEmpty)
+	{
+		OctreeDebugLog(@"DEBUG Hit an empty octant: [0]");
+		hasCollision = NO;
+		return 0.0;
+	}
+	
+	LineQuery query = { nodes, octree_collision, NO, 0.0f };
+	OctreeCell root = { rootNode, 0 };
+	BOOL hit = IsHitByLine(&query, root, radius, v0, v1);
+	
+	collisionMarksDirty = query.hasCollided || hit;
+	hasCollision = query.hasCollided;
+	if (hit)
+	{
+		OctreeDebugLog(@"DEBUG Hit at distance %.2f", query.hitDistance);
+		return query.hitDistance;
+	}
+	else
+	{
+		OctreeDebugLog(@"DEBUG Missed!");
+		return 0.0;
+	}
+}
+
+
+OOINLINE Vector OtherOffset(PairQuery *query, unsigned level, unsigned oct, GLfloat otherRadius)
+{
+	if (!(query->otherOffsetReady[level] & (1U << oct)))
+	{
+		query->otherOffsets[level][oct] = resolveVectorInIJK( offsetForOctant( oct, otherRadius), query->ijk);
+		query->otherOffsetReady[level] |= 1U << oct;
+	}
+	return query->otherOffsets[level][oct];
+}
+
+
+static int EnterCellPair(PairQuery *query, OctreeCell axial, GLfloat axialRadius, OctreeCell other, GLfloat otherRadius, unsigned otherLevel, Vector otherPosition, PairFrame *outFrame)
+{
+	if (otherRadius < axialRadius) // test axial cube against other sphere
+	{
+		// 'crude and simple' - test sphere against cube...
+		if ((otherPosition.x + otherRadius < -axialRadius)||(otherPosition.x - otherRadius > axialRadius)||
+			(otherPosition.y + otherRadius < -axialRadius)||(otherPosition.y - otherRadius > axialRadius)||
+			(otherPosition.z + otherRadius < -axialRadius)||(otherPosition.z - otherRadius > axialRadius))
+		{
+			return kCellMiss;
+		}
+	}
+	else	// test axial sphere against other cube
+	{
+		Vector	d2 = make_vector( - otherPosition.x, - otherPosition.y, -otherPosition.z);
+		Vector	axialPosition = resolveVectorInIJK( d2, query->ijk);
+		if ((axialPosition.x + axialRadius < -otherRadius)||(axialPosition.x - axialRadius > otherRadius)||
+			(axialPosition.y + axialRadius < -otherRadius)||(axialPosition.y - axialRadius > otherRadius)||
+			(axialPosition.z + axialRadius < -otherRadius)||(axialPosition.z - axialRadius > otherRadius))
+		{
+			return kCellMiss;
+		}
+	}
+	
+	outFrame->axial = axial;
+	outFrame->other = other;
+	outFrame->position = otherPosition;
+	outFrame->axialRadius = axialRadius;
+	outFrame->otherRadius = otherRadius;
+	outFrame->otherLevel = otherLevel;
+	outFrame->next = 0;
+	
+	if (axial.node == kOctreeCellSolid)
+	{
+		if (other.node == kOctreeCellSolid)
+		{
+			query->axialCollision[axial.slot] = (unsigned char)255;	// mark
+			query->otherCollision[other.slot] = (unsigned char)255;	// mark
+			OctreeDebugLog(@"DEBUG Octrees collide!");
+			return kCellHit;
+		}
+		
+		// Decompose the other octree, working from its octant nearest the axial octree.
+		outFrame->descendOther = YES;
+		outFrame->nearest = ((otherPosition.x > 0.0)? 0:4)|((otherPosition.y > 0.0)? 0:2)|((otherPosition.z > 0.0)? 0:1);
+	}
+	else
+	{
+		// Decompose the axial octree, working from its octant nearest the other octree.
+		outFrame->descendOther = NO;
+		outFrame->nearest = ((otherPosition.x > 0.0)? 4:0)|((otherPosition.y > 0.0)? 2:0)|((otherPosition.z > 0.0)? 1:0);
+	}
+	
+	return kCellDescend;
+}
+
+
+static BOOL IsHitByOctree(PairQuery *query, OctreeCell axialRoot, GLfloat axialRadius, OctreeCell otherRoot, GLfloat otherRadius, Vector otherPosition)
+{
+	PairFrame			stack[2 * OCTREE_MAX_DEPTH];
+	unsigned			depth;
+	
+	int result = EnterCellPair(query, axialRoot, axialRadius, otherRoot, otherRadius, 0, otherPosition, &stack[0]);
+	if (result != kCellDescend)  return result == kCellHit;
+	depth = 1;
+	
+	while (depth != 0)
+	{
+		PairFrame *frame = &stack[depth - 1];
+		if (frame->next == 8)
+		{
+			depth--;
+			continue;
+		}
+		
+		unsigned oct = frame->nearest ^ change_oct[frame->next++];
+		Vector nextPosition;
+		
+		if (frame->descendOther)
+		{
+			const OOOctreeNode *node = &query->otherNodes[frame->other.node];
+			if (!(node->childMask & (1U << oct)))  continue;	// don't test empty octants
+			
+			Vector voff = OtherOffset(query, frame->otherLevel, oct, frame->otherRadius);
+			nextPosition.x = frame->position.x - voff.x;
+			nextPosition.y = frame->position.y - voff.y;
+			nextPosition.z = frame->position.z - voff.z;
+			result = EnterCellPair(query, frame->axial, frame->axialRadius, ChildCell(node, oct), 0.5 * frame->otherRadius, frame->otherLevel + 1, nextPosition, &stack[depth]);
+		}
+		else
+		{
+			const OOOctreeNode *node = &query->axialNodes[frame->axial.node];
+			if (!(node->childMask & (1U << oct)))  continue;	// don't test empty octants
+			
+			Vector voff = offsetForOctant(oct, frame->axialRadius);
+			nextPosition.x = frame->position.x + voff.x;
+			nextPosition.y = frame->position.y + voff.y;
+			nextPosition.z = frame->position.z + voff.z;
+			result = EnterCellPair(query, ChildCell(node, oct), 0.5 * frame->axialRadius, frame->other, frame->otherRadius, frame->otherLevel, nextPosition, &stack[depth]);
+		}
+		
+		if (result == kCellHit)  return YES;
+		if (result == kCellDescend)  depth++;
+	}
+	
+	return NO;
+}
+
+
+- (BOOL) isHitByOctree:(Octree*) other withOrigin: (Vector) v0 andIJK: (Triangle) ijk
+{
+	return [self isHitByOctree:other withOrigin:v0 andIJK:ijk andScales:1.0f :1.0f];
+}
+
+
+- (BOOL) isHitByOctree:(Octree*) other withOrigin: (Vector) v0 andIJK: (Triangle) ijk andScales: (GLfloat) s1: (GLfloat) s2
+{
+	if (other == nil)  return NO;
+	
+#ifndef NDEBUG
+	OOOctreeBenchmarkRecordPairQuery(self, other, v0, ijk, s1, s2);
+#endif
+	
+	if (rootNode == kOctreeCellEmpty)
+	{
+		OctreeDebugLog(@"DEBUG Axial octree is empty.");
+		return NO;
+	}
+	if (other->rootNode == kOctreeCellEmpty)
+	{
+		OctreeDebugLog(@"DEBUG Other octree is empty.");
+		return NO;
+	}
+	
+	PairQuery query;
+	query.axialNodes = nodes;
+	query.otherNodes = other->nodes;
+	query.axialCollision = octree_collision;
+	query.otherCollision = other->octree_collision;
+	query.ijk = ijk;
+	memset(query.otherOffsetReady, 0, sizeof query.otherOffsetReady);
+	
+	OctreeCell axialRoot = { rootNode, 0 };
+	OctreeCell otherRoot = { other->rootNode, 0 };
+	GLfloat axialRadius = radius * s1;
+	GLfloat otherRadius = other->radius * s2;
+	
+	BOOL hit = IsHitByOctree(&query, axialRoot, axialRadius, otherRoot, otherRadius, v0);
+	
+	if (hit)
+	{
+		collisionMarksDirty = YES;
+		other->collisionMarksDirty = YES;
+	}
+	hasCollision = hasCollision | hit;
+	[other setHasCollision: [other hasCollision] | hit];
+	
+	return hit; 
+}
+
+
+#ifndef NDEBUG
+/*	The original recursive tests, kept as a reference for OOOctreeBenchmark.
+	These work on octree[] directly.
+*/
+
+static BOOL LegacyIsHitByLine(int* octbuffer, unsigned char* collbuffer, int level, GLfloat rad, Vector v0, Vector v1, Vector off, int face_hit);
+static BOOL LegacyIsHitByOctree(Octree_details axialDetails, Octree_details otherDetails, Vector otherPosition, Triangle other_ijk);
+
+
+OOINLINE BOOL LegacyIsHitByLineSub(int* octbuffer, unsigned char* collbuffer, int nextLevel, GLfloat rad, GLfloat rd2, Vector v0, Vector v1, int octantMask)
 {
 	if (octbuffer[nextLevel + octantMask])
 	{
 		Vector moveLine = offsetForOctant(octantMask, rad);
-		return isHitByLine(octbuffer, collbuffer, nextLevel + octantMask, rd2, v0, v1, moveLine, 0);
+		return LegacyIsHitByLine(octbuffer, collbuffer, nextLevel + octantMask, rd2, v0, v1, moveLine, 0);
 	}
 	else  return NO;
 }
 
 
-BOOL hasCollided = NO;
-GLfloat hit_dist = 0.0;
-static BOOL isHitByLine(int* octbuffer, unsigned char* collbuffer, int level, GLfloat rad, Vector v0, Vector v1, Vector off, int face_hit)
+static BOOL hasCollided = NO;
+static GLfloat hit_dist = 0.0;
+static BOOL LegacyIsHitByLine(int* octbuffer, unsigned char* collbuffer, int level, GLfloat rad, Vector v0, Vector v1, Vector off, int face_hit)
 {
 	// displace the line by the offset
 	Vector u0 = make_vector( v0.x + off.x, v0.y + off.y, v0.z + off.z);
 	Vector u1 = make_vector( v1.x + off.x, v1.y + off.y, v1.z + off.z);
 	
-	OctreeDebugLog(@"DEBUG octant: [%d] radius: %.2f vs. line: ( %.2f, %.2f, %.2f) - ( %.2f, %.2f, %.2f)", 
-		level, rad, u0.x, u0.y, u0.z, u1.x, u1.y, u1.z);
-
 	if (octbuffer[level] == 0)
 	{
-		OctreeDebugLog(@"DEBUG Hit an empty octant: [%d]", level);
 		return NO;
 	}
 	
 	if (octbuffer[level] == -1)
 	{
-		OctreeDebugLog(@"DEBUG Hit a solid octant: [%d]", level);
 		collbuffer[level] = 2;	// green
 		hit_dist = sqrt( u0.x * u0.x + u0.y * u0.y + u0.z * u0.z);
 		return YES;
@@ -426,7 +922,6 @@ static BOOL isHitByLine(int* octbuffer, unsigned char* collbuffer, int level, GL
 
 	if (faces == 0)
 	{
-		OctreeDebugLog(@"----> Line misses octant: [%d].", level);
 		return NO;
 	}
 	
@@ -450,21 +945,12 @@ static BOOL isHitByLine(int* octbuffer, unsigned char* collbuffer, int level, GL
 			octantIntersected = ((vi.x < 0.0)? 2: 6) + ((vi.z < 0.0)? 0: 1);
 		if (CUBE_FACE_BOTTOM & faces)
 			octantIntersected = ((vi.x < 0.0)? 0: 4) + ((vi.z < 0.0)? 0: 1);
-
-		OctreeDebugLog(@"----> found intersection with face 0x%2x of cube of radius %.2f at ( %.2f, %.2f, %.2f) octant:%d",
-				faces, rad, vi.x, vi.y, vi.z, octantIntersected);
-	}
-	else
-	{	
-		OctreeDebugLog(@"----> inside cube of radius %.2f octant:%d", rad, octantIntersected);
 	}
 	
 	hasCollided = YES;
 	
 	collbuffer[level] = 1;	// red
 	
-	OctreeDebugLog(@"----> testing octants...");
-	
 	int nextLevel = level + octbuffer[level];
 		
 	GLfloat rd2 = 0.5 * rad;
@@ -476,77 +962,49 @@ static BOOL isHitByLine(int* octbuffer, unsigned char* collbuffer, int level, GL
 	oct2 = oct0 ^ 0x02;	// adjacent y
 	oct3 = oct0 ^ 0x04;	// adjacent z
 	
-	OctreeDebugLog(@"----> testing first octant hit [+%d]", oct0);
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct0))  return YES;	// first octant
-		
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct0))  return YES;	// first octant
+	
 	// test the three adjacent octants
-
-	OctreeDebugLog(@"----> testing next three octants [+%d] [+%d] [+%d]", oct1, oct2, oct3);
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct1))  return YES;	// second octant
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct2))  return YES;	// third octant
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct3))  return YES;	// fourth octant
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct1))  return YES;	// second octant
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct2))  return YES;	// third octant
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct3))  return YES;	// fourth octant
 	
 	// go to the next four octants
 	
 	oct0 ^= 0x07;	oct1 ^= 0x07;	oct2 ^= 0x07;	oct3 ^= 0x07;
 	
-	OctreeDebugLog(@"----> testing back three octants [+%d] [+%d] [+%d]", oct1, oct2, oct3);
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct1))  return YES;	// fifth octant
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct2))  return YES;	// sixth octant
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct3))  return YES;	// seventh octant
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct1))  return YES;	// fifth octant
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct2))  return YES;	// sixth octant
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct3))  return YES;	// seventh octant
 	
 	// and check the last octant
-	OctreeDebugLog(@"----> testing final octant [+%d]", oct0);
-	if (isHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct0))  return YES;	// last octant
+	if (LegacyIsHitByLineSub(octbuffer, collbuffer, nextLevel, rad, rd2, u0, u1, oct0))  return YES;	// last octant
 	
 	return NO;
 }
 
-- (GLfloat) isHitByLine: (Vector) v0: (Vector) v1
+
+- (GLfloat) legacyIsHitByLine:(Vector)v0 :(Vector)v1
 {
 	int i;
 	for (i = 0; i< leafs; i++) octree_collision[i] = (char)0;
+	collisionMarksDirty = YES;
 	hasCollided = NO;
 	
-	if (isHitByLine(octree, octree_collision, 0, radius, v0, v1, kZeroVector, 0))
-	{
-		OctreeDebugLog(@"DEBUG Hit at distance %.2f", hit_dist);
-		hasCollision = hasCollided;
-		return hit_dist;
-	}
-	else
-	{
-		OctreeDebugLog(@"DEBUG Missed!", hit_dist);
-		hasCollision = hasCollided;
-		return 0.0;
-	}
+	BOOL hit = LegacyIsHitByLine(octree, octree_collision, 0, radius, v0, v1, kZeroVector, 0);
+	hasCollision = hasCollided;
+	return hit ? hit_dist : 0.0;
 }
 
-int change_oct[] = {	0,	1,	2,	4,	3,	5,	6,	7};	// used to move from nearest to furthest octant
 
-BOOL	isHitByOctree(	Octree_details axialDetails,
-						Octree_details otherDetails, Vector otherPosition, Triangle other_ijk)
+static BOOL LegacyIsHitByOctree(Octree_details axialDetails, Octree_details otherDetails, Vector otherPosition, Triangle other_ijk)
 {
 	int*	axialBuffer = axialDetails.octree;
 	int*	otherBuffer = otherDetails.octree;
 
-	if (axialBuffer[0] == 0)
-	{
-		OctreeDebugLog(@"DEBUG Axial octree is empty.");
-		return NO;
-	}
-	
-	if (!otherBuffer)
-	{
-		OctreeDebugLog(@"DEBUG Other octree is undefined.");
-		return NO;
-	}
-	
-	if (otherBuffer[0] == 0)
-	{
-		OctreeDebugLog(@"DEBUG Other octree is empty.");
-		return NO;
-	}
+	if (axialBuffer[0] == 0)  return NO;
+	if (!otherBuffer)  return NO;
+	if (otherBuffer[0] == 0)  return NO;
 	
 	GLfloat axialRadius = axialDetails.radius;
 	GLfloat otherRadius = otherDetails.radius;
@@ -558,7 +1016,6 @@ BOOL	isHitByOctree(	Octree_details axialDetails,
 			(otherPosition.y + otherRadius < -axialRadius)||(otherPosition.y - otherRadius > axialRadius)||
 			(otherPosition.z + otherRadius < -axialRadius)||(otherPosition.z - otherRadius > axialRadius))
 		{
-			OctreeDebugLog(@"----> Other sphere does not intersect axial cube");
 			return NO;
 		}
 	}
@@ -570,7 +1027,6 @@ BOOL	isHitByOctree(	Octree_details axialDetails,
 			(axialPosition.y + axialRadius < -otherRadius)||(axialPosition.y - axialRadius > otherRadius)||
 			(axialPosition.z + axialRadius < -otherRadius)||(axialPosition.z - axialRadius > otherRadius))
 		{
-			OctreeDebugLog(@"----> Axial sphere does not intersect other cube");
 			return NO;
 		}
 	}
@@ -587,18 +1043,10 @@ BOOL	isHitByOctree(	Octree_details axialDetails,
 			// YES so octrees collide
 			axialCollisionBuffer[0] = (unsigned char)255;	// mark
 			otherCollisionBuffer[0] = (unsigned char)255;	// mark
-			
-			OctreeDebugLog(@"DEBUG Octrees collide!");
 			return YES;
 		}
-		// the other octree must be decomposed
-		// and each of its octants tested against the axial octree
-		// if any of them collides with this octant
-		// then we have a solid collision
-		
-		OctreeDebugLog(@"----> testing other octants...");
 		
-		// work out the nearest octant to the axial octree
+		// the other octree must be decomposed, working from the octant nearest the axial octree
 		int	nearest_oct = ((otherPosition.x > 0.0)? 0:4)|((otherPosition.y > 0.0)? 0:2)|((otherPosition.z > 0.0)? 0:1);
 		
 		int				nextLevel			= otherBuffer[0];
@@ -619,7 +1067,7 @@ BOOL	isHitByOctree(	Octree_details axialDetails,
 				nextPosition.x = otherPosition.x - voff.x;
 				nextPosition.y = otherPosition.y - voff.y;
 				nextPosition.z = otherPosition.z - voff.z;
-				if (isHitByOctree(	axialDetails, nextDetails, nextPosition, other_ijk))	// test octant
+				if (LegacyIsHitByOctree(	axialDetails, nextDetails, nextPosition, other_ijk))	// test octant
 					return YES;
 			}
 		}
@@ -627,14 +1075,8 @@ BOOL	isHitByOctree(	Octree_details axialDetails,
 		// otherwise
 		return NO;
 	}
-	// we are not solid
-	// we must test each of our octants against
-	// the other octree, if any of them collide
-	// we have a solid collision
-	
-	OctreeDebugLog(@"----> testing axial octants...");
 	
-	// work out the nearest octant to the other octree
+	// we are not solid, so test each of our octants, working from the one nearest the other octree
 	int	nearest_oct = ((otherPosition.x > 0.0)? 4:0)|((otherPosition.y > 0.0)? 2:0)|((otherPosition.z > 0.0)? 1:0);
 	
 	int		nextLevel = axialBuffer[0];
@@ -655,7 +1097,7 @@ BOOL	isHitByOctree(	Octree_details axialDetails,
 			nextPosition.x = otherPosition.x + voff.x;
 			nextPosition.y = otherPosition.y + voff.y;
 			nextPosition.z = otherPosition.z + voff.z;
-			if (isHitByOctree(	nextDetails, otherDetails, nextPosition, other_ijk))
+			if (LegacyIsHitByOctree(	nextDetails, otherDetails, nextPosition, other_ijk))
 				return YES;	// test octant
 		}
 	}
@@ -663,34 +1105,30 @@ BOOL	isHitByOctree(	Octree_details axialDetails,
 	return NO;
 }
 
-- (BOOL) isHitByOctree:(Octree*) other withOrigin: (Vector) v0 andIJK: (Triangle) ijk
+
+- (BOOL) legacyIsHitByOctree:(Octree *)other withOrigin:(Vector)v0 andIJK:(Triangle)ijk andScales:(GLfloat)s1 :(GLfloat)s2
 {
 	if (other == nil)  return NO;
 	
-	BOOL hit = isHitByOctree( [self octreeDetails], [other octreeDetails], v0, ijk);
-	
-	hasCollision = hasCollision | hit;
-	[other setHasCollision: [other hasCollision] | hit];
-	
-	return hit; 
-}
-
-- (BOOL) isHitByOctree:(Octree*) other withOrigin: (Vector) v0 andIJK: (Triangle) ijk andScales: (GLfloat) s1: (GLfloat) s2
-{
 	Octree_details details1 = [self octreeDetails];
 	Octree_details details2 = [other octreeDetails];
 	
 	details1.radius *= s1;
 	details2.radius *= s2;
 	
-	BOOL hit = isHitByOctree( details1, details2, v0, ijk);
+	BOOL hit = LegacyIsHitByOctree( details1, details2, v0, ijk);
 	
+	if (hit)
+	{
+		collisionMarksDirty = YES;
+		other->collisionMarksDirty = YES;
+	}
 	hasCollision = hasCollision | hit;
 	[other setHasCollision: [other hasCollision] | hit];
 	
 	return hit; 
 }
-
+#endif
 
 
 - (NSDictionary *) dictionaryRepresentation
@@ -799,7 +1237,7 @@ static Vector randomFullNodeFrom(Octree_details details, Vector offset)
 #ifndef NDEBUG
 - (size_t) totalSize
 {
-	return [self oo_objectSize] + leafs * (sizeof *octree + sizeof *octree_collision);
+	return [self oo_objectSize] + leafs * (sizeof *octree + sizeof *octree_collision) + nodeCount * sizeof *nodes;
 }
 #endif
 
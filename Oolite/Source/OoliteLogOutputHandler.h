@@ -40,12 +40,15 @@ SOFTWARE.
 #import <OoliteBase/OoliteBase.h>
 
 
+struct OOLogFilterSnapshot;
+
+
 @interface OoliteLogOutputHandler: OOLogOutputHandler
 {
 @private
-	NSLock					*_lock;
+	NSLock					*_lock;				// Serializes changes to settings; not taken when filtering.
 	NSMutableDictionary		*_explicitSettings;
-	NSMutableDictionary		*_derivedSettings;
+	struct OOLogFilterSnapshot * volatile _filterSnapshot;
 	
 	NSString				*_default;
 	BOOL					_overrideInEffect;
@@ -54,6 +57,19 @@ SOFTWARE.
 
 + (id) sharedLogOutputHandler;
 
+/*	Frees filter settings replaced more than a few seconds ago. Called once a
+	frame; see "Filter settings snapshot" in OoliteLogOutputHandler.m.
+*/
+- (void) reclaimRetiredFilterSnapshots;
+
+/*	A handler which only filters, using the given settings (in the format of
+	logcontrol.plist) instead of loading them. It is not installed, so its
+	settings don't affect logging. Unlike the shared handler it is reference
+	counted normally, and frees its settings snapshots when deallocated, by
+	which time no thread may be using it. Used by OOLogFilterBenchmark.
+*/
+- (id) initWithExplicitSettings:(NSDictionary *)settings;
+
 @end
 
 
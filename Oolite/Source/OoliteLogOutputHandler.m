@@ -44,24 +44,87 @@ static void OOLogOutputHandlerPrint(NSString *string);
 static OoliteLogOutputHandler	*sSingleton;
 
 
-// These specific values are used for true, false and inherit in the cache and explicitSettings dictionaries so we can use pointer comparison.
+// These specific values are used for true, false and inherit in the explicitSettings dictionary so we can use pointer comparison.
 static NSString * const			kTrueToken = @"on";
 static NSString * const			kFalseToken = @"off";
 static NSString * const			kInheritToken = @"inherit";
 
 
+/*	Filter settings snapshot.
+
+	-shouldShowMessageInClass: is called for every OOLog() on every thread,
+	so it must not take a lock. Instead, the settings it needs are copied into
+	a snapshot which is never modified once published, except for its cache.
+	Changing a setting builds a new snapshot under _lock and swaps the
+	pointer.
+
+	The cache is an open-addressed hash table of message classes, filled in
+	by readers with compare-and-swap. A reader claims one of the snapshot's
+	cells, fills in a retained copy of the message class and its display
+	setting, then swaps a pointer to the cell into an empty slot, so a slot
+	is always read and written as a single word. Once the cells run out,
+	further classes are resolved each time instead of cached.
+
+	Readers don't announce themselves, so a snapshot that has been replaced
+	can't be freed straight away. Retired snapshots are linked from their
+	replacement, newest first, and stamped with the time they were replaced.
+	-reclaimRetiredFilterSnapshots, called once a frame, frees those retired
+	more than kFilterSnapshotGracePeriod ago; a reader only holds on to a
+	snapshot for the length of one -shouldShowMessageInClass: call. Handlers
+	made with -initWithExplicitSettings: free all of theirs when deallocated.
+
+	Atomic operations use the GCC __sync builtins, which are available in all
+	the compilers we support on both Mac OS X and GNUstep.
+*/
+enum
+{
+	kFilterCacheSize			= 1024,		// Must be a power of two.
+	kFilterCacheMaxCount		= kFilterCacheSize / 2
+};
+
+#define kFilterSnapshotGracePeriod	5.0			// Seconds.
+
+
+typedef struct OOLogFilterCacheCell
+{
+	NSString					*messageClass;
+	BOOL						value;
+} OOLogFilterCacheCell;
+
+
+typedef struct OOLogFilterSnapshot
+{
+	NSDictionary				*explicitSettings;
+	NSString					*defaultValue;
+	BOOL						overrideInEffect;
+	BOOL						overrideValue;
+	struct OOLogFilterSnapshot	*retired;
+	NSTimeInterval				retiredTime;	// When this snapshot was replaced.
+	volatile int				cellCount;		// Cells claimed; may overshoot kFilterCacheMaxCount.
+	OOLogFilterCacheCell		cells[kFilterCacheMaxCount];
+	OOLogFilterCacheCell * volatile cache[kFilterCacheSize];
+} OOLogFilterSnapshot;
+
+
 @interface OoliteLogOutputHandler (OOPrivate)
 
 - (void) loadExplicitSettings;
 - (void) loadExplicitSettingsFromDictionary:(NSDictionary *)dictionary;
 
-- (id) resolveDisplaySettingForMessageClass:(NSString *)messageClass;
-- (id) resolveMetaClassReference:(NSString *)metaClass withSeenMetaClasses:(NSMutableSet *)ioSeenMetaClasses;
+// Must be called with _lock held, or from -init.
+- (void) publishFilterSnapshot;
 
 @end
 
 
-// Given a boolean, return the appropriate value for the cache dictionary.
+static void FreeFilterSnapshot(OOLogFilterSnapshot *snapshot);
+static BOOL LookUpCachedSetting(OOLogFilterSnapshot *snapshot, NSString *messageClass, NSUInteger hash, BOOL *outValue);
+static void CacheSetting(OOLogFilterSnapshot *snapshot, NSString *messageClass, NSUInteger hash, BOOL value);
+static id ResolveDisplaySetting(OOLogFilterSnapshot *snapshot, NSString *messageClass);
+static id ResolveMetaClassReference(OOLogFilterSnapshot *snapshot, NSString *metaClass, NSMutableSet *ioSeenMetaClasses);
+
+
+// Given a boolean, return the appropriate value for the explicit settings dictionary.
 static inline id CacheValue(BOOL inValue) __attribute__((pure));
 static inline id CacheValue(BOOL inValue)
 {
@@ -90,10 +153,12 @@ static inline id CacheValue(BOOL inValue)
 	{
 		_lock = [[NSLock alloc] init];
 		_explicitSettings = [[NSMutableDictionary alloc] init];
-		_derivedSettings = [[NSMutableDictionary alloc] init];
 		_default = kTrueToken;
 		
+		// Anything logged while loading the settings sees the defaults.
+		[self publishFilterSnapshot];
 		[self loadExplicitSettings];
+		[self publishFilterSnapshot];
 		
 		OOLogOutputHandlerInit();
 	}
@@ -102,26 +167,65 @@ static inline id CacheValue(BOOL inValue)
 }
 
 
+- (id) initWithExplicitSettings:(NSDictionary *)settings
+{
+	if ((self = [super init]))
+	{
+		_lock = [[NSLock alloc] init];
+		_explicitSettings = [[NSMutableDictionary alloc] init];
+		_default = kTrueToken;
+		
+		[self loadExplicitSettingsFromDictionary:settings];
+		[self publishFilterSnapshot];
+	}
+	
+	return self;
+}
+
+
+- (void) dealloc
+{
+	OOLogFilterSnapshot		*snapshot = _filterSnapshot;
+	OOLogFilterSnapshot		*retired = NULL;
+	
+	while (snapshot != NULL)
+	{
+		retired = snapshot->retired;
+		FreeFilterSnapshot(snapshot);
+		snapshot = retired;
+	}
+	
+	DESTROY(_lock);
+	DESTROY(_explicitSettings);
+	
+	[super dealloc];
+}
+
+
+// The shared handler is never deallocated; see "Filter settings snapshot" above.
 - (id) retain
 {
+	if (self != sSingleton)  return [super retain];
 	return self;
 }
 
 
 - (oneway void) release
 {
-	
+	if (self != sSingleton)  [super release];
 }
 
 
 - (id) autorelease
 {
+	if (self != sSingleton)  return [super autorelease];
 	return self;
 }
 
 
 - (NSUInteger) retainCount
 {
+	if (self != sSingleton)  return [super retainCount];
 	return UINT_MAX;
 }
 
@@ -141,44 +245,80 @@ static inline id CacheValue(BOOL inValue)
 }
 
 /*	Used to determine which messages to show.
-	This is called very often, from any thread, and is IMP cached.
+	This is called very often, from any thread, and is IMP cached. It doesn't
+	lock; see "Filter settings snapshot" above.
 */
 - (BOOL) shouldShowMessageInClass:(NSString *)messageClass
 {
-	if (EXPECT_NOT(_overrideInEffect))  return _overrideValue;
+	OOLogFilterSnapshot		*snapshot = _filterSnapshot;
+	BOOL					value;
+	
+	if (EXPECT_NOT(snapshot->overrideInEffect))  return snapshot->overrideValue;
+	if (EXPECT_NOT(messageClass == nil))  return snapshot->defaultValue == kTrueToken;
+	
+	NSUInteger hash = [messageClass hash];
+	if (EXPECT(LookUpCachedSetting(snapshot, messageClass, hash, &value)))  return value;
+	
+	// No cached value.
+	value = ResolveDisplaySetting(snapshot, messageClass) == kTrueToken;
+	CacheSetting(snapshot, messageClass, hash, value);
+	
+	return value;
+}
+
+
+- (void) reclaimRetiredFilterSnapshots
+{
+	// Unlocked check for the usual case; only this method and -publishFilterSnapshot change links, under _lock.
+	if (EXPECT(_filterSnapshot->retired == NULL))  return;
+	
+	NSTimeInterval			cutoff = [NSDate timeIntervalSinceReferenceDate] - kFilterSnapshotGracePeriod;
+	OOLogFilterSnapshot		*newer = NULL;
+	OOLogFilterSnapshot		*snapshot = NULL;
+	OOLogFilterSnapshot		*retired = NULL;
 	
 	[_lock lock];
 	
-	// Look for cached value.
-	id value = [_derivedSettings objectForKey:messageClass];
-	if (EXPECT_NOT(value == nil))
+	// Anything retired before the first old enough snapshot was retired even earlier.
+	newer = _filterSnapshot;
+	snapshot = newer->retired;
+	while (snapshot != NULL && snapshot->retiredTime > cutoff)
 	{
-		@try
-		{
-			// No cached value.
-			value = [self resolveDisplaySettingForMessageClass:messageClass];
-			
-			if (value != nil)
-			{
-				[_derivedSettings setObject:value forKey:messageClass];
-			}
-		}
-		@finally
-		{
-			[_lock unlock];
-		}
+		newer = snapshot;
+		snapshot = snapshot->retired;
 	}
-	else
+	newer->retired = NULL;
+	
+	[_lock unlock];
+	
+	while (snapshot != NULL)
 	{
-		[_lock unlock];
+		retired = snapshot->retired;
+		FreeFilterSnapshot(snapshot);
+		snapshot = retired;
 	}
-	
-	return value == kTrueToken;
 }
 
 
 - (void) setShouldShowMessage:(BOOL)flag inClass:(NSString *)messageClass
 {
+	if (messageClass == nil)  return;
+	
+	id value = CacheValue(flag);
+	
+	[_lock lock];
+	@try
+	{
+		if ([_explicitSettings objectForKey:messageClass] != value)
+		{
+			[_explicitSettings setObject:value forKey:messageClass];
+			[self publishFilterSnapshot];
+		}
+	}
+	@finally
+	{
+		[_lock unlock];
+	}
 }
 
 
@@ -338,14 +478,112 @@ static inline id CacheValue(BOOL inValue)
 }
 
 
+- (void) publishFilterSnapshot
+{
+	OOLogFilterSnapshot *snapshot = calloc(1, sizeof *snapshot);
+	if (snapshot == NULL)  [NSException raise:NSMallocException format:@"Could not allocate log filter settings."];
+	
+	snapshot->explicitSettings = [_explicitSettings copy];
+	snapshot->defaultValue = _default;
+	snapshot->overrideInEffect = _overrideInEffect;
+	snapshot->overrideValue = _overrideValue;
+	snapshot->retired = _filterSnapshot;
+	if (snapshot->retired != NULL)  snapshot->retired->retiredTime = [NSDate timeIntervalSinceReferenceDate];
+	
+	// Make the contents visible to other threads before the pointer is.
+	__sync_synchronize();
+	_filterSnapshot = snapshot;
+}
+
+@end
+
+
+OOINLINE NSUInteger CacheIndex(NSUInteger hash)
+{
+	return hash & (kFilterCacheSize - 1);
+}
+
+
+static void FreeFilterSnapshot(OOLogFilterSnapshot *snapshot)
+{
+	int						i, cellCount = MIN(snapshot->cellCount, (int)kFilterCacheMaxCount);
+	
+	for (i = 0; i < cellCount; i++)
+	{
+		[snapshot->cells[i].messageClass release];
+	}
+	[snapshot->explicitSettings release];
+	free(snapshot);
+}
+
+
+OOINLINE BOOL CacheCellMatches(const OOLogFilterCacheCell *cell, NSString *messageClass)
+{
+	return cell->messageClass == messageClass || [cell->messageClass isEqualToString:messageClass];
+}
+
+
+static BOOL LookUpCachedSetting(OOLogFilterSnapshot *snapshot, NSString *messageClass, NSUInteger hash, BOOL *outValue)
+{
+	NSUInteger				i, index = CacheIndex(hash);
+	OOLogFilterCacheCell	*cell = NULL;
+	
+	for (i = 0; i < kFilterCacheSize; i++)
+	{
+		cell = snapshot->cache[index];
+		if (cell == NULL)  return NO;
+		if (EXPECT(CacheCellMatches(cell, messageClass)))
+		{
+			*outValue = cell->value;
+			return YES;
+		}
+		index = CacheIndex(index + 1);
+	}
+	
+	return NO;
+}
+
+
+static void CacheSetting(OOLogFilterSnapshot *snapshot, NSString *messageClass, NSUInteger hash, BOOL value)
+{
+	NSUInteger				i, index = CacheIndex(hash);
+	OOLogFilterCacheCell	*cell = NULL;
+	int						cellIndex;
+	
+	if (snapshot->cellCount >= kFilterCacheMaxCount)  return;
+	
+	// Another thread may have taken the last cell since the check above.
+	cellIndex = __sync_fetch_and_add(&snapshot->cellCount, 1);
+	if (EXPECT_NOT(cellIndex >= kFilterCacheMaxCount))  return;
+	
+	// The snapshot owns the class, and may outlive the caller's string.
+	cell = &snapshot->cells[cellIndex];
+	cell->messageClass = [messageClass copy];
+	cell->value = value;
+	
+	for (i = 0; i < kFilterCacheSize; i++)
+	{
+		// The swap is a full barrier, so the cell is filled in before any reader can find it.
+		if (__sync_bool_compare_and_swap(&snapshot->cache[index], NULL, cell))  return;
+		
+		// Slot taken; if by another thread caching the same class, we're done.
+		if (CacheCellMatches(snapshot->cache[index], messageClass))  break;
+		index = CacheIndex(index + 1);
+	}
+	
+	// The cell is left unused.
+	DESTROY(cell->messageClass);
+}
+
+
 /*	Look up setting for a message class in explicit settings, resolving
 	inheritance and metaclasses.
 */
-- (id) resolveDisplaySettingForMessageClass:(NSString *)messageClass
+static id ResolveDisplaySetting(OOLogFilterSnapshot *snapshot, NSString *messageClass)
 {
-	if (EXPECT_NOT(messageClass == nil))  return _default;
+	if (EXPECT_NOT(messageClass == nil))  return snapshot->defaultValue;
 	
-	id value = [_explicitSettings objectForKey:messageClass];
+	id value = [snapshot->explicitSettings objectForKey:messageClass];
 	
 	// Simple case: explicit setting for this value.
 	if (value == kTrueToken || value == kFalseToken)
@@ -356,48 +594,46 @@ static inline id CacheValue(BOOL inValue)
 	// Simplish case: use inherited value.
 	if (value == nil || value == kInheritToken)
 	{
-		return [self resolveDisplaySettingForMessageClass:OOLogGetParentMessageClass(messageClass)];
+		return ResolveDisplaySetting(snapshot, OOLogGetParentMessageClass(messageClass));
 	}
 	
 	// Less simple case: should be a metaclass.
 	NSMutableSet *seenMetaClasses = [NSMutableSet set];
-	return [self resolveMetaClassReference:value withSeenMetaClasses:seenMetaClasses];
+	return ResolveMetaClassReference(snapshot, value, seenMetaClasses);
 }
 
 
 /*	Resolve a metaclass reference, recursively if necessary. The
 	ioSeenMetaClasses dictionary is used to avoid loops.
 */
-- (id) resolveMetaClassReference:(NSString *)metaClass withSeenMetaClasses:(NSMutableSet *)ioSeenMetaClasses
+static id ResolveMetaClassReference(OOLogFilterSnapshot *snapshot, NSString *metaClass, NSMutableSet *ioSeenMetaClasses)
 {
 	// All values should have been checked at load time, but what the hey.
 	if (![metaClass isKindOfClass:[NSString class]] || ![metaClass hasPrefix:@"$"])
 	{
-		return _default;
+		return snapshot->defaultValue;
 	}
 	
 	if ([ioSeenMetaClasses containsObject:metaClass])
 	{
 		// Avoid infinite recusion.
-		return _default;
+		return snapshot->defaultValue;
 	}
 	
 	[ioSeenMetaClasses addObject:metaClass];
 	
-	id value = [_explicitSettings objectForKey:metaClass];
+	id value = [snapshot->explicitSettings objectForKey:metaClass];
 	
 	if (value == kTrueToken || value == kFalseToken)  return value;
 	if (value == nil)
 	{
-		return _default;
+		return snapshot->defaultValue;
 	}
 	
 	// If we get here, it should be a recursive metaclass reference.
-	return [self resolveMetaClassReference:value withSeenMetaClasses:ioSeenMetaClasses];
+	return ResolveMetaClassReference(snapshot, value, ioSeenMetaClasses);
 }
 
-@end
-
 
 #define OOLOG_POISON_NSLOG 0
 #define DLOPEN_NO_WARN
@@ -9,6 +9,23 @@ The cache manager stores arbitrary property lists in separate namespaces
 different verison of Oolite, or if it was created on a system with a different
 byte sex.
 
+Each cache is stored in its own file (see OOCacheShard), in a folder along
+with a manifest recording the Oolite version. Cache files are only opened when
+their cache is first used, and only caches that have changed are written.
+A cache is only marked clean once a write including its changes has
+succeeded, so a failed write is retried at the next flush.
+A data cache in the old single-plist format is imported and then deleted.
+
+An entry may be set along with the files it was built from. The first time
+such an entry is retrieved in a session, each file is checked against the
+size and modification date recorded for it; if they differ, the file's
+contents are hashed and compared. The entry is discarded if any file has
+changed or gone. In a cache with dependency records, an entry set without
+any is discarded too, since it can't be checked. Caches whose entries are all set this way are kept by
+-clearCachesWithoutDependencies, which ResourceManager uses instead of
+-clearAllCaches when expansion packs are added, removed or updated, so that
+meshes or scripts that haven't changed don't need to be rebuilt.
+
 Oolite
 Copyright (C) 2004-2011 Giles C Williams and contributors
 
@@ -35,19 +52,29 @@ MA 02110-1301, USA.
 @interface OOCacheManager: NSObject
 {
 @private
-	NSMutableDictionary		*_caches;
+	NSMutableDictionary		*_caches;			// Cache name -> OOCacheShard, for caches in use.
+	NSMutableSet			*_checkedCaches;	// Caches whose files have been looked for, or must not be.
+	NSMutableSet			*_removedCaches;	// Caches whose files are to be deleted at the next write.
 	id						_scheduledWrite;
 	BOOL					_permitWrites;
 	BOOL					_dirty;
+	BOOL					_ignoreCacheFiles;	// Files on disk are stale or incomplete.
+	BOOL					_removeAllCacheFiles;
+	BOOL					_removeLegacyCache;
+	
+	NSMutableDictionary		*_fileFingerprints;	// Path -> fingerprint of file as it is now.
+	NSMutableDictionary		*_validatedKeys;	// Cache name -> set of keys whose dependencies have been checked.
 }
 
 + (id)sharedCache;
 
 - (id)objectForKey:(NSString *)inKey inCache:(NSString *)inCacheKey;
 - (void)setObject:(id)inElement forKey:(NSString *)inKey inCache:(NSString *)inCacheKey;
+- (void)setObject:(id)inElement forKey:(NSString *)inKey inCache:(NSString *)inCacheKey dependingOnFiles:(NSArray *)inPaths;
 - (void)removeObjectForKey:(NSString *)inKey inCache:(NSString *)inCacheKey;
 - (void)clearCache:(NSString *)inCacheKey;
 - (void)clearAllCaches;
+- (void)clearCachesWithoutDependencies;
 - (void) reloadAllCaches;
 
 - (void)setAllowCacheWrites:(BOOL)flag;
@@ -55,4 +82,9 @@ MA 02110-1301, USA.
 - (void)flush;
 - (void)finishOngoingFlush;	// Wait for flush to complete. Does nothing if async flushing is disabled.
 
+#ifndef NDEBUG
+// Contents of every cache, including ones not yet used. For benchmarking.
+- (NSDictionary *)contentsOfAllCaches;
+#endif
+
 @end
@@ -23,6 +23,7 @@ MA 02110-1301, USA.
 */
 
 #import "OOCacheManager.h"
+#import "OOCacheShard.h"
 #import "OOVersion.h"
 
 
@@ -38,9 +39,7 @@ MA 02110-1301, USA.
 #endif
 
 
-#if WRITE_ASYNC
 #import "OOAsyncWorkManager.h"
-#endif
 #if PROFILE_WRITES
 #import "OOProfilingStopwatch.h"
 #endif
@@ -49,6 +48,7 @@ MA 02110-1301, USA.
 static NSString * const kOOLogDataCacheFound				= @"dataCache.found";
 static NSString * const kOOLogDataCacheNotFound				= @"dataCache.notFound";
 static NSString * const kOOLogDataCacheRebuild				= @"dataCache.rebuild";
+static NSString * const kOOLogDataCacheImport				= @"dataCache.import";
 static NSString * const kOOLogDataCacheWriteSuccess			= @"dataCache.write.success";
 static NSString * const kOOLogDataCacheWriteFailed			= @"dataCache.write.failed";
 static NSString * const kOOLogDataCacheRetrieveSuccess		= @"dataCache.retrieve.success";
@@ -57,6 +57,7 @@ static NSString * const kOOLogDataCacheSetSuccess			= @"dataCache.set.success";
 static NSString * const kOOLogDataCacheSetFailed			= @"dataCache.set.failed";
 static NSString * const kOOLogDataCacheRemoveSuccess		= @"dataCache.remove.success";
 static NSString * const kOOLogDataCacheClearSuccess			= @"dataCache.clear.success";
+static NSString * const kOOLogDataCacheDependencyChanged	= @"dataCache.dependencyChanged";
 static NSString * const kOOLogDataCacheParamError			= @"general.error.parameterError.OOCacheManager";
 static NSString * const kOOLogDataCacheBuildPathError		= @"dataCache.write.buildPath.failed";
 static NSString * const kOOLogDataCacheSerializationError	= @"dataCache.write.serialize.failed";
@@ -66,30 +67,68 @@ static NSString * const kCacheKeyEndianTag					= @"endian tag";
 static NSString * const kCacheKeyFormatVersion				= @"format version";
 static NSString * const kCacheKeyCaches						= @"caches";
 
+static NSString * const kManifestFileName					= @"Manifest.plist";
+
+// Dependencies of entries in cache X are kept in cache "X (dependencies)", under the same keys.
+static NSString * const kDependencyCacheSuffix				= @" (dependencies)";
+
+static NSString * const kFingerprintKeyPath					= @"path";
+static NSString * const kFingerprintKeySize					= @"size";
+static NSString * const kFingerprintKeyModified				= @"modified";
+static NSString * const kFingerprintKeyHash					= @"hash";
+
 
 enum
 {
 	kEndianTagValue			= 0x0123456789ABCDEFULL,
-	kFormatVersionValue		= 0
+	kLegacyFormatVersion	= 0,	// Single plist, with the caches under kCacheKeyCaches.
+	kFormatVersionValue		= 1		// Manifest plist and one OOCacheShard file per cache.
 };
 
 
 static OOCacheManager *sSingleton = nil;
 
 
+OOINLINE NSString *DependencyCacheName(NSString *cacheKey)
+{
+	return [cacheKey stringByAppendingString:kDependencyCacheSuffix];
+}
+
+
+OOINLINE BOOL IsDependencyCache(NSString *cacheKey)
+{
+	return [cacheKey hasSuffix:kDependencyCacheSuffix];
+}
+
+
+static NSString *HashOfFileAtPath(NSString *path);
+
+
+@class OOAsyncCacheWriter;
+
+
 @interface OOCacheManager (Private)
 
 - (void)loadCache;
 - (void)write;
+- (void)writeCompleted:(OOAsyncCacheWriter *)writer;
 - (void)clear;
 - (BOOL)dirty;
 - (void)markClean;
 
-- (NSDictionary *)loadDict;
-- (BOOL)writeDict:(NSDictionary *)inDict;
+- (OOCacheShard *)shardForCache:(NSString *)inCacheKey create:(BOOL)inCreate;
+- (void)loadAllCaches;
+- (BOOL)cacheExists:(NSString *)inCacheKey;
+- (NSSet *)unopenedCacheNames;
 
-- (void)buildCachesFromDictionary:(NSDictionary *)inDict;
-- (NSDictionary *)dictionaryOfCaches;
+- (BOOL)dependenciesAreCurrentForKey:(NSString *)inKey inCache:(NSString *)inCacheKey;
+- (void)removeDependenciesForKey:(NSString *)inKey inCache:(NSString *)inCacheKey;
+- (NSDictionary *)fingerprintOfFile:(NSString *)inPath withHash:(BOOL)inHash;
+
+- (NSDictionary *)manifest;
+- (BOOL)acceptCacheHeader:(NSDictionary *)inHeader formatVersion:(unsigned)inFormatVersion;
+- (NSDictionary *)loadDictFromPath:(NSString *)inPath;
+- (void)importLegacyCaches:(NSDictionary *)inDict;
 
 - (BOOL)directoryExists:(NSString *)inPath create:(BOOL)inCreate;
 
@@ -99,21 +138,47 @@ static OOCacheManager *sSingleton = nil;
 @interface OOCacheManager (PlatformSpecific)
 
 - (NSString *)cachePathCreatingIfNecessary:(BOOL)inCreate;
+- (NSString *)legacyCachePath;
 
 @end
 
 
-#if WRITE_ASYNC
 @interface OOAsyncCacheWriter: NSObject <OOAsyncWorkTask>
 {
 @private
-	NSDictionary			*_cacheContents;
+	NSString				*_folder;
+	NSString				*_legacyPath;
+	NSDictionary			*_manifest;
+	NSDictionary			*_caches;			// Main thread only.
+	NSDictionary			*_snapshots;
+	NSArray					*_removedCaches;
+	BOOL					_removeAll;
+	BOOL					_succeeded;
 }
 
-- (id) initWithCacheContents:(NSDictionary *)cacheContents;
+/*	Write snapshots of caches (cache name -> OOCacheShard) into folder, after
+	deleting the files of removedCaches, or of all caches if removeAll is set.
+	If legacyPath is not nil, the file there is deleted. Must be created on
+	the main thread; the snapshots are taken then.
+*/
+- (id) initWithFolder:(NSString *)folder
+			 manifest:(NSDictionary *)manifest
+			   caches:(NSDictionary *)caches
+		removedCaches:(NSArray *)removedCaches
+			removeAll:(BOOL)removeAll
+		   legacyPath:(NSString *)legacyPath;
+
+- (BOOL) writeCaches;
+
+- (BOOL) succeeded;
+- (NSArray *) removedCaches;
+- (BOOL) removeAll;
+- (NSString *) legacyPath;
+
+// Mark the changes included in the snapshots as written. Main thread only.
+- (void) markCachesClean;
 
 @end
-#endif
 
 
 @implementation OOCacheManager
@@ -158,16 +223,22 @@ static OOCacheManager *sSingleton = nil;
 
 - (id)objectForKey:(NSString *)inKey inCache:(NSString *)inCacheKey
 {
-	NSMutableDictionary		*cache = nil;
+	OOCacheShard			*cache = nil;
 	id						result = nil;
 	
 	NSParameterAssert(inKey != nil && inCacheKey != nil);
 	
-	cache = [_caches objectForKey:inCacheKey];
+	cache = [self shardForCache:inCacheKey create:NO];
 	if (cache != nil)
 	{
 		result = [cache objectForKey:inKey];
-		if (result != nil)
+		if (result != nil && ![self dependenciesAreCurrentForKey:inKey inCache:inCacheKey])
+		{
+			OOLog(kOOLogDataCacheDependencyChanged, @"Discarding \"%@\" cache object %@ because the files it was built from have changed or weren't recorded.", inCacheKey, inKey);
+			[self removeObjectForKey:inKey inCache:inCacheKey];
+			result = nil;
+		}
+		else if (result != nil)
 		{
 			OODebugLog(kOOLogDataCacheRetrieveSuccess, @"Retrieved \"%@\" cache object %@.", inCacheKey, inKey);
 		}
@@ -188,42 +259,77 @@ static OOCacheManager *sSingleton = nil;
 
 - (void)setObject:(id)inObject forKey:(NSString *)inKey inCache:(NSString *)inCacheKey
 {
-	NSMutableDictionary		*cache = nil;
+	OOCacheShard			*cache = nil;
 	
 	NSParameterAssert(inObject != nil && inKey != nil && inCacheKey != nil);
 	
 	if (EXPECT_NOT(_caches == nil))  return;
 	
-	cache = [_caches objectForKey:inCacheKey];
+	cache = [self shardForCache:inCacheKey create:YES];
 	if (cache == nil)
 	{
-		cache = [NSMutableDictionary dictionary];
-		if (cache == nil)
-		{
-			OODebugLog(kOOLogDataCacheSetFailed, @"Failed to create cache for key \"%@\".", inCacheKey);
-			return;
-		}
-		[_caches setObject:cache forKey:inCacheKey];
+		OODebugLog(kOOLogDataCacheSetFailed, @"Failed to create cache for key \"%@\".", inCacheKey);
+		return;
 	}
 	
 	[cache setObject:inObject forKey:inKey];
+	[self removeDependenciesForKey:inKey inCache:inCacheKey];
 	_dirty = YES;
 	OODebugLog(kOOLogDataCacheSetSuccess, @"Updated entry %@ in cache \"%@\".", inKey, inCacheKey);
 }
 
 
+- (void)setObject:(id)inObject forKey:(NSString *)inKey inCache:(NSString *)inCacheKey dependingOnFiles:(NSArray *)inPaths
+{
+	NSMutableArray			*dependencies = nil;
+	NSString				*path = nil;
+	NSDictionary			*fingerprint = nil;
+	
+	NSParameterAssert(inObject != nil && inKey != nil && inCacheKey != nil && !IsDependencyCache(inCacheKey));
+	
+	if (EXPECT_NOT(_caches == nil))  return;
+	
+	dependencies = [NSMutableArray arrayWithCapacity:[inPaths count]];
+	foreach (path, inPaths)
+	{
+		fingerprint = [self fingerprintOfFile:path withHash:YES];
+		if (fingerprint == nil)
+		{
+			// It would be discarded on retrieval anyway.
+			OODebugLog(kOOLogDataCacheSetFailed, @"Not caching entry %@ in cache \"%@\" because %@ can't be read.", inKey, inCacheKey, path);
+			[self removeObjectForKey:inKey inCache:inCacheKey];
+			return;
+		}
+		[dependencies addObject:fingerprint];
+	}
+	
+	[self setObject:inObject forKey:inKey inCache:inCacheKey];
+	[[self shardForCache:DependencyCacheName(inCacheKey) create:YES] setObject:dependencies forKey:inKey];
+	
+	if (_validatedKeys == nil)  _validatedKeys = [[NSMutableDictionary alloc] init];
+	NSMutableSet *validated = [_validatedKeys objectForKey:inCacheKey];
+	if (validated == nil)
+	{
+		validated = [NSMutableSet set];
+		[_validatedKeys setObject:validated forKey:inCacheKey];
+	}
+	[validated addObject:inKey];
+}
+
+
 - (void)removeObjectForKey:(NSString *)inKey inCache:(NSString *)inCacheKey
 {
-	NSMutableDictionary		*cache = nil;
+	OOCacheShard			*cache = nil;
 	
 	NSParameterAssert(inKey != nil && inCacheKey != nil);
 	
-	cache = [_caches objectForKey:inCacheKey];
+	cache = [self shardForCache:inCacheKey create:NO];
 	if (cache != nil)
 	{
 		if (nil != [cache objectForKey:inKey])
 		{
 			[cache removeObjectForKey:inKey];
+			[self removeDependenciesForKey:inKey inCache:inCacheKey];
 			_dirty = YES;
 			OODebugLog(kOOLogDataCacheRemoveSuccess, @"Removed entry keyed %@ from cache \"%@\".", inKey, inCacheKey);
 		}
@@ -243,9 +349,12 @@ static OOCacheManager *sSingleton = nil;
 {
 	NSParameterAssert(inCacheKey != nil);
 	
-	if (nil != [_caches objectForKey:inCacheKey])
+	if ([self cacheExists:inCacheKey])
 	{
 		[_caches removeObjectForKey:inCacheKey];
+		[_checkedCaches addObject:inCacheKey];
+		[_removedCaches addObject:inCacheKey];
+		[_validatedKeys removeObjectForKey:inCacheKey];
 		_dirty = YES;
 		OODebugLog(kOOLogDataCacheClearSuccess, @"Cleared cache \"%@\".", inCacheKey);
 	}
@@ -253,6 +362,11 @@ static OOCacheManager *sSingleton = nil;
 	{
 		OODebugLog(kOOLogDataCacheClearSuccess, @"No need to clear non-existent cache \"%@\".", inCacheKey);
 	}
+	
+	if (!IsDependencyCache(inCacheKey) && [self cacheExists:DependencyCacheName(inCacheKey)])
+	{
+		[self clearCache:DependencyCacheName(inCacheKey)];
+	}
 }
 
 
@@ -260,10 +374,33 @@ static OOCacheManager *sSingleton = nil;
 {
 	[self clear];
 	_caches = [[NSMutableDictionary alloc] init];
+	_checkedCaches = [[NSMutableSet alloc] init];
+	_removedCaches = [[NSMutableSet alloc] init];
+	_ignoreCacheFiles = YES;
+	_removeAllCacheFiles = YES;
 	_dirty = YES;
 }
 
 
+- (void)clearCachesWithoutDependencies
+{
+	NSMutableSet			*cacheKeys = nil;
+	NSString				*cacheKey = nil;
+	
+	// Caches that haven't been used yet are found from the names of their files, without opening them.
+	cacheKeys = [NSMutableSet setWithArray:[_caches allKeys]];
+	[cacheKeys unionSet:[self unopenedCacheNames]];
+	
+	foreach (cacheKey, [cacheKeys allObjects])
+	{
+		if (!IsDependencyCache(cacheKey) && ![cacheKeys containsObject:DependencyCacheName(cacheKey)])
+		{
+			[self clearCache:cacheKey];
+		}
+	}
+}
+
+
 - (void) reloadAllCaches
 {
 	[self clear];
@@ -276,7 +413,6 @@ static OOCacheManager *sSingleton = nil;
 	if (_permitWrites && [self dirty] && _scheduledWrite == nil)
 	{
 		[self write];
-		[self markClean];
 	}
 }
 
@@ -294,6 +430,25 @@ static OOCacheManager *sSingleton = nil;
 	_permitWrites = (flag != NO);
 }
 
+
+#ifndef NDEBUG
+- (NSDictionary *)contentsOfAllCaches
+{
+	NSString				*cacheKey = nil;
+	NSMutableDictionary		*result = nil;
+	
+	[self loadAllCaches];
+	
+	result = [NSMutableDictionary dictionaryWithCapacity:[_caches count]];
+	foreach (cacheKey, [_caches allKeys])
+	{
+		[result setObject:[[_caches objectForKey:cacheKey] dictionaryRepresentation] forKey:cacheKey];
+	}
+	
+	return result;
+}
+#endif
+
 @end
 
 
@@ -301,86 +456,76 @@ static OOCacheManager *sSingleton = nil;
 
 - (void)loadCache
 {
-	NSDictionary			*cache = nil;
-	NSString				*cacheVersion = nil;
-	NSString				*ooliteVersion = nil;
-	NSData					*endianTag = nil;
-	NSNumber				*formatVersion = nil;
-	BOOL					accept = YES;
-	uint64_t				endianTagValue = 0;
-	
-	ooliteVersion = OoliteVersion();
+	NSString				*folder = nil;
+	NSDictionary			*manifest = nil;
+	NSDictionary			*legacyCache = nil;
 	
 	[self clear];
+	_caches = [[NSMutableDictionary alloc] init];
+	_checkedCaches = [[NSMutableSet alloc] init];
+	_removedCaches = [[NSMutableSet alloc] init];
 	
-	cache = [self loadDict];
-	if (cache != nil)
+	folder = [self cachePathCreatingIfNecessary:NO];
+	if (folder != nil)  manifest = [self loadDictFromPath:[folder stringByAppendingPathComponent:kManifestFileName]];
+	
+	if (manifest != nil)
 	{
 		// We have a cache
 		OOLog(kOOLogDataCacheFound, @"Found data cache.");
 		OOLogIndentIf(kOOLogDataCacheFound);
 		
-		cacheVersion = [cache objectForKey:kCacheKeyVersion];
-		if (![cacheVersion isEqual:ooliteVersion])
+		if ([self acceptCacheHeader:manifest formatVersion:kFormatVersionValue])
 		{
-			OOLog(kOOLogDataCacheRebuild, @"Data cache version (%@) does not match Oolite version (%@), rebuilding cache.", cacheVersion, ooliteVersion);
-			accept = NO;
-		}
-		
-		formatVersion = [cache objectForKey:kCacheKeyFormatVersion];
-		if (accept && [formatVersion unsignedIntValue] != kFormatVersionValue)
-		{
-			OOLog(kOOLogDataCacheRebuild, @"Data cache format (%@) is not supported format (%u), rebuilding cache.", formatVersion, kFormatVersionValue);
-			accept = NO;
+			// We have a cache, and it's the right format. Individual caches are loaded when first used.
+			OOLogOutdentIf(kOOLogDataCacheFound);
+			[self markClean];
+			return;
 		}
 		
-		if (accept)
+		OOLogOutdentIf(kOOLogDataCacheFound);
+	}
+	
+	// Anything in the cache folder is stale, or was never completely written.
+	_ignoreCacheFiles = YES;
+	_removeAllCacheFiles = (folder != nil);
+	[self markClean];
+	
+	if (manifest == nil)
+	{
+		legacyCache = [self loadDictFromPath:[self legacyCachePath]];
+		if (legacyCache != nil)
 		{
-			endianTag = [cache objectForKey:kCacheKeyEndianTag];
-			if (![endianTag isKindOfClass:[NSData class]] || [endianTag length] != sizeof endianTagValue)
-			{
-				OOLog(kOOLogDataCacheRebuild, @"Data cache endian tag is invalid, rebuilding cache.");
-				accept = NO;
-			}
-			else
+			OOLog(kOOLogDataCacheFound, @"Found data cache in old format.");
+			OOLogIndentIf(kOOLogDataCacheFound);
+			
+			if ([self acceptCacheHeader:legacyCache formatVersion:kLegacyFormatVersion])
 			{
-				endianTagValue = *(const uint64_t *)[endianTag bytes];
-				if (endianTagValue != kEndianTagValue)
-				{
-					OOLog(kOOLogDataCacheRebuild, @"Data cache endianness is inappropriate for this system, rebuilding cache.");
-					accept = NO;
-				}
+				[self importLegacyCaches:[legacyCache oo_dictionaryForKey:kCacheKeyCaches]];
 			}
+			
+			OOLogOutdentIf(kOOLogDataCacheFound);
+			
+			// Either way, the old cache is no longer needed.
+			_removeLegacyCache = YES;
+			_dirty = YES;
 		}
-		
-		if (accept)
+		else
 		{
-			// We have a cache, and it's the right format.
-			[self buildCachesFromDictionary:[cache objectForKey:kCacheKeyCaches]];
+			// No cache
+			OOLog(kOOLogDataCacheNotFound, @"No data cache found, starting from scratch.");
 		}
-		
-		OOLogOutdentIf(kOOLogDataCacheFound);
 	}
-	else
-	{
-		// No cache
-		OOLog(kOOLogDataCacheNotFound, @"No data cache found, starting from scratch.");
-	}
-	
-	// If loading failed, or there was a version or endianness conflict
-	if (_caches == nil) _caches = [[NSMutableDictionary alloc] init];
-	[self markClean];
 }
 
 
 - (void)write
 {
-	NSMutableDictionary		*newCache = nil;
-	NSString				*ooliteVersion = nil;
-	NSData					*endianTag = nil;
-	NSNumber				*formatVersion = nil;
-	NSDictionary			*pListRep = nil;
-	uint64_t				endianTagValue = kEndianTagValue;
+	NSDictionary			*manifest = nil;
+	NSMutableDictionary		*dirtyCaches = nil;
+	NSString				*folder = nil;
+	NSString				*cacheKey = nil;
+	OOCacheShard			*cache = nil;
+	OOAsyncCacheWriter		*writer = nil;
 	
 	if (_caches == nil) return;
 	if (_scheduledWrite != nil)  return;
@@ -395,30 +540,43 @@ static OOCacheManager *sSingleton = nil;
 	OOLog(@"dataCache.willWrite", @"About to write cache.");
 #endif
 	
-	ooliteVersion = OoliteVersion();
-	endianTag = [NSData dataWithBytes:&endianTagValue length:sizeof endianTagValue];
-	formatVersion = [NSNumber numberWithUnsignedInt:kFormatVersionValue];
-	
-	pListRep = [self dictionaryOfCaches];
-	if (ooliteVersion == nil || endianTag == nil || formatVersion == nil || pListRep == nil)
+	folder = [self cachePathCreatingIfNecessary:YES];
+	manifest = [self manifest];
+	if (folder == nil || manifest == nil)
 	{
 		OOLog(@"dataCache.cantWrite", @"Failed to write data cache -- prerequisites not fulfilled. %@",@"This is an internal error, please report it.");
 		return;
 	}
 	
-	newCache = [NSMutableDictionary dictionaryWithCapacity:4];
-	[newCache setObject:ooliteVersion forKey:kCacheKeyVersion];
-	[newCache setObject:formatVersion forKey:kCacheKeyFormatVersion];
-	[newCache setObject:endianTag forKey:kCacheKeyEndianTag];
-	[newCache setObject:pListRep forKey:kCacheKeyCaches];
+	/*	Only caches that have changed are written. They stay dirty until the
+		write has succeeded, so that a failed write is retried.
+	*/
+	dirtyCaches = [NSMutableDictionary dictionary];
+	foreach (cacheKey, [_caches allKeys])
+	{
+		cache = [_caches objectForKey:cacheKey];
+		if ([cache isDirty])  [dirtyCaches setObject:cache forKey:cacheKey];
+	}
+	
+	writer = [[OOAsyncCacheWriter alloc] initWithFolder:folder
+											   manifest:manifest
+												 caches:dirtyCaches
+										  removedCaches:[_removedCaches allObjects]
+											  removeAll:_removeAllCacheFiles
+											 legacyPath:_removeLegacyCache ? [self legacyCachePath] : nil];
+	if (writer == nil)  return;
 	
-#if PROFILE_WRITES && !WRITE_ASYNC
-	OOTimeDelta prepareT = [stopwatch reset];
-#endif
+	/*	Everything outstanding now belongs to the writer. If it fails,
+		-writeCompleted: marks the manager dirty again; if we never got this
+		far, it stays dirty and the next flush tries again.
+	*/
+	[_removedCaches removeAllObjects];
+	_removeAllCacheFiles = NO;
+	_removeLegacyCache = NO;
+	[self markClean];
 	
 #if WRITE_ASYNC
-	NSDictionary *cacheData = newCache;
-	_scheduledWrite = [[OOAsyncCacheWriter alloc] initWithCacheContents:cacheData];
+	_scheduledWrite = writer;
 	
 #if PROFILE_WRITES
 	OOTimeDelta endT = [stopwatch reset];
@@ -428,26 +586,49 @@ static OOCacheManager *sSingleton = nil;
 	[[OOAsyncWorkManager sharedAsyncWorkManager] addTask:_scheduledWrite priority:kOOAsyncPriorityLow];
 #else
 #if PROFILE_WRITES
+	OOTimeDelta prepareT = [stopwatch reset];
 	OOLog(@"dataCache.profile", @"Time to prepare cache data: %g seconds.", prepareT);
 #endif
 	
-	if ([self writeDict:newCache])
+	[writer writeCaches];
+	[self writeCompleted:writer];
+	[writer release];
+#endif
+}
+
+
+// Called on the main thread once a write has finished.
+- (void)writeCompleted:(OOAsyncCacheWriter *)writer
+{
+	if ([writer succeeded])
 	{
-		[self markClean];
+		[writer markCachesClean];
 		OOLog(kOOLogDataCacheWriteSuccess, @"Wrote data cache.");
 	}
 	else
 	{
+		// Nothing written is marked clean; put back what was cleared when the write was scheduled, so the next flush tries again.
 		OOLog(kOOLogDataCacheWriteFailed, @"Failed to write data cache.");
+		[_removedCaches addObjectsFromArray:[writer removedCaches]];
+		if ([writer removeAll])  _removeAllCacheFiles = YES;
+		if ([writer legacyPath] != nil)  _removeLegacyCache = YES;
+		_dirty = YES;
 	}
-#endif
+	
+	if (writer == _scheduledWrite)  DESTROY(_scheduledWrite);
 }
 
 
 - (void)clear
 {
-	[_caches release];
-	_caches = nil;
+	DESTROY(_caches);
+	DESTROY(_checkedCaches);
+	DESTROY(_removedCaches);
+	DESTROY(_fileFingerprints);
+	DESTROY(_validatedKeys);
+	_ignoreCacheFiles = NO;
+	_removeAllCacheFiles = NO;
+	_removeLegacyCache = NO;
 }
 
 
@@ -463,20 +644,301 @@ static OOCacheManager *sSingleton = nil;
 }
 
 
-- (NSDictionary *)loadDict
+- (OOCacheShard *)shardForCache:(NSString *)inCacheKey create:(BOOL)inCreate
+{
+	OOCacheShard			*cache = nil;
+	NSString				*folder = nil;
+	
+	cache = [_caches objectForKey:inCacheKey];
+	if (cache != nil || _caches == nil)  return cache;
+	
+	// Files of caches that have been cleared may still be waiting to be deleted, so only look once.
+	if (!_ignoreCacheFiles && ![_checkedCaches containsObject:inCacheKey])
+	{
+		[_checkedCaches addObject:inCacheKey];
+		folder = [self cachePathCreatingIfNecessary:NO];
+		if (folder != nil)
+		{
+			NSString *path = [folder stringByAppendingPathComponent:[OOCacheShard fileNameForCacheName:inCacheKey]];
+			cache = [[[OOCacheShard alloc] initWithContentsOfFile:path name:inCacheKey] autorelease];
+		}
+	}
+	
+	if (cache == nil && inCreate)
+	{
+		cache = [[[OOCacheShard alloc] initWithName:inCacheKey] autorelease];
+	}
+	
+	if (cache != nil)  [_caches setObject:cache forKey:inCacheKey];
+	return cache;
+}
+
+
+// Open every cache that has a file and hasn't been used yet.
+- (void)loadAllCaches
+{
+	NSString				*folder = nil;
+	NSString				*file = nil;
+	NSString				*cacheKey = nil;
+	OOCacheShard			*cache = nil;
+	
+	if (_ignoreCacheFiles || _caches == nil)  return;
+	
+	folder = [self cachePathCreatingIfNecessary:NO];
+	if (folder == nil)  return;
+	
+	foreach (file, [[NSFileManager defaultManager] directoryContentsAtPath:folder])
+	{
+		if (![[file pathExtension] isEqualToString:OOCACHE_SHARD_EXTENSION])  continue;
+		
+		cache = [[OOCacheShard alloc] initWithContentsOfFile:[folder stringByAppendingPathComponent:file] name:nil];
+		cacheKey = [cache name];
+		if (cache != nil && ![_checkedCaches containsObject:cacheKey])
+		{
+			[_caches setObject:cache forKey:cacheKey];
+			[_checkedCaches addObject:cacheKey];
+		}
+		[cache release];
+	}
+}
+
+
+// YES if the cache is in use, or has a file which hasn't been opened yet.
+- (BOOL)cacheExists:(NSString *)inCacheKey
+{
+	NSString				*folder = nil;
+	
+	if ([_caches objectForKey:inCacheKey] != nil)  return YES;
+	if (_ignoreCacheFiles || _caches == nil || [_checkedCaches containsObject:inCacheKey])  return NO;
+	
+	folder = [self cachePathCreatingIfNecessary:NO];
+	if (folder == nil)  return NO;
+	
+	return [[NSFileManager defaultManager] fileExistsAtPath:[folder stringByAppendingPathComponent:[OOCacheShard fileNameForCacheName:inCacheKey]]];
+}
+
+
+// Names of caches with files that haven't been opened yet, from the folder listing.
+- (NSSet *)unopenedCacheNames
+{
+	NSMutableSet			*result = nil;
+	NSString				*folder = nil;
+	NSString				*file = nil;
+	NSString				*cacheKey = nil;
+	
+	result = [NSMutableSet set];
+	if (_ignoreCacheFiles || _caches == nil)  return result;
+	
+	folder = [self cachePathCreatingIfNecessary:NO];
+	if (folder == nil)  return result;
+	
+	foreach (file, [[NSFileManager defaultManager] directoryContentsAtPath:folder])
+	{
+		cacheKey = [OOCacheShard cacheNameForFileName:file];
+		if (cacheKey != nil && ![_checkedCaches containsObject:cacheKey])  [result addObject:cacheKey];
+	}
+	
+	return result;
+}
+
+
+- (BOOL)dependenciesAreCurrentForKey:(NSString *)inKey inCache:(NSString *)inCacheKey
+{
+	NSMutableSet			*validated = nil;
+	OOCacheShard			*dependencyCache = nil;
+	NSArray					*dependencies = nil;
+	NSMutableArray			*updated = nil;
+	NSDictionary			*recorded = nil;
+	NSDictionary			*current = nil;
+	NSUInteger				i, count;
+	
+	if (IsDependencyCache(inCacheKey))  return YES;
+	
+	validated = [_validatedKeys objectForKey:inCacheKey];
+	if ([validated containsObject:inKey])  return YES;
+	
+	// Entries of caches without dependency records are always current. In a cache that has them, an entry without one can't be checked, so it's stale.
+	dependencyCache = [self shardForCache:DependencyCacheName(inCacheKey) create:NO];
+	if (dependencyCache == nil)  return YES;
+	dependencies = [dependencyCache objectForKey:inKey];
+	if (dependencies == nil)  return NO;
+	
+	count = [dependencies count];
+	for (i = 0; i < count; i++)
+	{
+		recorded = [dependencies oo_dictionaryAtIndex:i];
+		current = [self fingerprintOfFile:[recorded oo_stringForKey:kFingerprintKeyPath] withHash:NO];
+		if (current == nil)  return NO;
+		
+		if ([[recorded objectForKey:kFingerprintKeySize] isEqual:[current objectForKey:kFingerprintKeySize]] &&
+			[[recorded objectForKey:kFingerprintKeyModified] isEqual:[current objectForKey:kFingerprintKeyModified]])
+		{
+			continue;
+		}
+		
+		// Same size but a different date, as after reinstalling an expansion pack: compare contents.
+		if (![[recorded objectForKey:kFingerprintKeySize] isEqual:[current objectForKey:kFingerprintKeySize]])  return NO;
+		current = [self fingerprintOfFile:[recorded oo_stringForKey:kFingerprintKeyPath] withHash:YES];
+		if (![[recorded objectForKey:kFingerprintKeyHash] isEqual:[current objectForKey:kFingerprintKeyHash]])  return NO;
+		
+		// Unchanged; record the new date so the file needn't be hashed again.
+		if (updated == nil)  updated = [NSMutableArray arrayWithArray:dependencies];
+		[updated replaceObjectAtIndex:i withObject:current];
+	}
+	
+	if (updated != nil)
+	{
+		[dependencyCache setObject:updated forKey:inKey];
+		_dirty = YES;
+	}
+	
+	if (_validatedKeys == nil)  _validatedKeys = [[NSMutableDictionary alloc] init];
+	if (validated == nil)
+	{
+		validated = [NSMutableSet set];
+		[_validatedKeys setObject:validated forKey:inCacheKey];
+	}
+	[validated addObject:inKey];
+	
+	return YES;
+}
+
+
+- (void)removeDependenciesForKey:(NSString *)inKey inCache:(NSString *)inCacheKey
+{
+	OOCacheShard			*dependencyCache = nil;
+	
+	if (IsDependencyCache(inCacheKey))  return;
+	
+	[[_validatedKeys objectForKey:inCacheKey] removeObject:inKey];
+	
+	dependencyCache = [self shardForCache:DependencyCacheName(inCacheKey) create:NO];
+	if ([dependencyCache objectForKey:inKey] != nil)
+	{
+		[dependencyCache removeObjectForKey:inKey];
+		_dirty = YES;
+	}
+}
+
+
+/*	Size, modification date and, if requested, content hash of a file, as it
+	is now. Remembered for the rest of the session, so a file shared by many
+	entries is only examined once.
+*/
+- (NSDictionary *)fingerprintOfFile:(NSString *)inPath withHash:(BOOL)inHash
+{
+	NSDictionary			*result = nil;
+	NSDictionary			*attributes = nil;
+	NSString				*hash = nil;
+	
+	if (inPath == nil)  return nil;
+	
+	result = [_fileFingerprints objectForKey:inPath];
+	if (result == nil)
+	{
+		attributes = [[NSFileManager defaultManager] fileAttributesAtPath:inPath traverseLink:YES];
+		if (attributes == nil)  return nil;
+		
+		result = [NSDictionary dictionaryWithObjectsAndKeys:
+				  inPath, kFingerprintKeyPath,
+				  [NSNumber numberWithUnsignedLongLong:[attributes fileSize]], kFingerprintKeySize,
+				  // As a double because the cache may not handle dates under GNUstep.
+				  [NSNumber numberWithDouble:[[attributes fileModificationDate] timeIntervalSince1970]], kFingerprintKeyModified,
+				  nil];
+		
+		if (_fileFingerprints == nil)  _fileFingerprints = [[NSMutableDictionary alloc] init];
+		[_fileFingerprints setObject:result forKey:inPath];
+	}
+	
+	if (inHash && [result objectForKey:kFingerprintKeyHash] == nil)
+	{
+		hash = HashOfFileAtPath(inPath);
+		if (hash == nil)  return nil;
+		
+		NSMutableDictionary *hashed = [NSMutableDictionary dictionaryWithDictionary:result];
+		[hashed setObject:hash forKey:kFingerprintKeyHash];
+		result = [[hashed copy] autorelease];
+		[_fileFingerprints setObject:result forKey:inPath];
+	}
+	
+	return result;
+}
+
+
+- (NSDictionary *)manifest
+{
+	NSString				*ooliteVersion = nil;
+	NSData					*endianTag = nil;
+	NSNumber				*formatVersion = nil;
+	uint64_t				endianTagValue = kEndianTagValue;
+	
+	ooliteVersion = OoliteVersion();
+	endianTag = [NSData dataWithBytes:&endianTagValue length:sizeof endianTagValue];
+	formatVersion = [NSNumber numberWithUnsignedInt:kFormatVersionValue];
+	if (ooliteVersion == nil || endianTag == nil || formatVersion == nil)  return nil;
+	
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			ooliteVersion, kCacheKeyVersion,
+			formatVersion, kCacheKeyFormatVersion,
+			endianTag, kCacheKeyEndianTag,
+			nil];
+}
+
+
+- (BOOL)acceptCacheHeader:(NSDictionary *)inHeader formatVersion:(unsigned)inFormatVersion
+{
+	NSString				*cacheVersion = nil;
+	NSString				*ooliteVersion = nil;
+	NSData					*endianTag = nil;
+	NSNumber				*formatVersion = nil;
+	uint64_t				endianTagValue = 0;
+	
+	ooliteVersion = OoliteVersion();
+	
+	cacheVersion = [inHeader objectForKey:kCacheKeyVersion];
+	if (![cacheVersion isEqual:ooliteVersion])
+	{
+		OOLog(kOOLogDataCacheRebuild, @"Data cache version (%@) does not match Oolite version (%@), rebuilding cache.", cacheVersion, ooliteVersion);
+		return NO;
+	}
+	
+	formatVersion = [inHeader objectForKey:kCacheKeyFormatVersion];
+	if ([formatVersion unsignedIntValue] != inFormatVersion)
+	{
+		OOLog(kOOLogDataCacheRebuild, @"Data cache format (%@) is not supported format (%u), rebuilding cache.", formatVersion, inFormatVersion);
+		return NO;
+	}
+	
+	endianTag = [inHeader objectForKey:kCacheKeyEndianTag];
+	if (![endianTag isKindOfClass:[NSData class]] || [endianTag length] != sizeof endianTagValue)
+	{
+		OOLog(kOOLogDataCacheRebuild, @"Data cache endian tag is invalid, rebuilding cache.");
+		return NO;
+	}
+	
+	endianTagValue = *(const uint64_t *)[endianTag bytes];
+	if (endianTagValue != kEndianTagValue)
+	{
+		OOLog(kOOLogDataCacheRebuild, @"Data cache endianness is inappropriate for this system, rebuilding cache.");
+		return NO;
+	}
+	
+	return YES;
+}
+
+
+- (NSDictionary *)loadDictFromPath:(NSString *)inPath
 {
-	NSString			*path = nil;
 	NSData				*data = nil;
 	NSString			*errorString = nil;
 	id					contents = nil;
 	
-	path = [self cachePathCreatingIfNecessary:NO];
-	if (path == nil) return nil;
+	if (inPath == nil) return nil;
 	
 	NS_DURING
-		data = [NSData dataWithContentsOfFile:path];
+		data = [NSData dataWithContentsOfFile:inPath];
 		if (data == nil)  NS_VALUERETURN(nil, NSDictionary *);
-		
+	
 		contents = [NSPropertyListSerialization propertyListFromData:data
 													mutabilityOption:NSPropertyListImmutable
 															  format:NULL
@@ -500,78 +962,28 @@ static OOCacheManager *sSingleton = nil;
 }
 
 
-- (BOOL)writeDict:(NSDictionary *)inDict
-{
-	NSString			*path = nil;
-	NSData				*plist = nil;
-	NSString			*errorDesc = nil;
-	
-	path = [self cachePathCreatingIfNecessary:YES];
-	if (path == nil) return NO;	
-	
-#if PROFILE_WRITES
-	OOProfilingStopwatch *stopwatch = [OOProfilingStopwatch stopwatch];
-#endif
-	
-	plist = [NSPropertyListSerialization dataFromPropertyList:inDict format:CACHE_PLIST_FORMAT errorDescription:&errorDesc];
-	if (plist == nil)
-	{
-#if OOLITE_RELEASE_PLIST_ERROR_STRINGS
-		[errorDesc autorelease];
-#endif
-		OOLog(kOOLogDataCacheSerializationError, @"Could not convert data cache to property list data: %@", errorDesc);
-		return NO;
-	}
-	
-#if PROFILE_WRITES
-	OOTimeDelta serializeT = [stopwatch reset];
-#endif
-	
-	BOOL result = [plist writeToFile:path atomically:NO];
-	
-#if PROFILE_WRITES
-	OOTimeDelta writeT = [stopwatch reset];
-	
-	OOLog(@"dataCache.profile", @"Time to serialize cache: %g seconds. Time to write data: %g seconds.", serializeT, writeT);
-#endif
-	
-#if WRITE_ASYNC
-	DESTROY(_scheduledWrite);
-#endif
-	return result;
-}
-
-
-- (void)buildCachesFromDictionary:(NSDictionary *)inDict
+- (void)importLegacyCaches:(NSDictionary *)inDict
 {
 	NSEnumerator				*keyEnum = nil;
 	id							key = nil;
 	id							value = nil;
-	NSMutableDictionary			*cache = nil;
-	
-	if (inDict == nil ) return;
-	
-	[_caches release];
-	_caches = [[NSMutableDictionary alloc] initWithCapacity:[inDict count]];
+	OOCacheShard				*cache = nil;
 	
 	for (keyEnum = [inDict keyEnumerator]; (key = [keyEnum nextObject]); )
 	{
 		value = [inDict oo_dictionaryForKey:key];
 		if (value != nil)
 		{
-			cache = [NSMutableDictionary dictionaryWithDictionary:value];
+			cache = [[OOCacheShard alloc] initWithName:key contents:value];
 			if (cache != nil)
 			{
 				[_caches setObject:cache forKey:key];
+				[cache release];
 			}
 		}
 	}
-}
-
-
-- (NSDictionary *)dictionaryOfCaches
-{
-	return OODeepCopy(_caches);
+	
+	OOLog(kOOLogDataCacheImport, @"Imported %lu caches from old data cache.", (unsigned long)[_caches count]);
 }
 
 
@@ -609,12 +1021,12 @@ static OOCacheManager *sSingleton = nil;
 
 #if OOLITE_MAC_OS_X
 
-- (NSString *)cachePathCreatingIfNecessary:(BOOL)inCreate
+- (NSString *)cacheBasePathCreatingIfNecessary:(BOOL)inCreate
 {
 	NSString			*cachePath = nil;
 	
-	/*	Construct the path for the cache file, which is:
-			~/Library/Caches/org.oolite/Data Cache.plist
+	/*	Construct the base path for the cache, which is:
+			~/Library/Caches/org.oolite/Data Cache
 		In addition to generally being the right place to put caches,
 		~/Library/Caches has the particular advantage of not being indexed by
 		Spotlight or, in future, backed up by Time Machine.
@@ -624,18 +1036,18 @@ static OOCacheManager *sSingleton = nil;
 	if (![self directoryExists:cachePath create:inCreate]) return nil;
 	cachePath = [cachePath stringByAppendingPathComponent:@"org.oolite"];
 	if (![self directoryExists:cachePath create:inCreate]) return nil;
-	cachePath = [cachePath stringByAppendingPathComponent:@"Data Cache.plist"];
+	cachePath = [cachePath stringByAppendingPathComponent:@"Data Cache"];
 	return cachePath;
 }
 
 #else
 
-- (NSString *)cachePathCreatingIfNecessary:(BOOL)inCreate
+- (NSString *)cacheBasePathCreatingIfNecessary:(BOOL)inCreate
 {
 	NSString			*cachePath = nil;
 	
-	/*	Construct the path for the cache file, which is:
-			~/GNUstep/Library/Caches/Oolite-cache.plist
+	/*	Construct the base path for the cache, which is:
+			~/GNUstep/Library/Caches/Oolite-cache
 		
 		FIXME: we shouldn't be hard-coding ~/GNUstep/. Does
 		NSSearchPathForDirectoriesInDomains() not work?
@@ -647,13 +1059,30 @@ static OOCacheManager *sSingleton = nil;
 	if (![self directoryExists:cachePath create:inCreate]) return nil;
 	cachePath = [cachePath stringByAppendingPathComponent:@"Caches"];
 	if (![self directoryExists:cachePath create:inCreate]) return nil;
-	cachePath = [cachePath stringByAppendingPathComponent:@"Oolite-cache.plist"];
+	cachePath = [cachePath stringByAppendingPathComponent:@"Oolite-cache"];
 	
 	return cachePath;
 }
 
 #endif
 
+
+// The cache folder holds the manifest and one file per cache.
+- (NSString *)cachePathCreatingIfNecessary:(BOOL)inCreate
+{
+	NSString			*cachePath = [self cacheBasePathCreatingIfNecessary:inCreate];
+	
+	if (cachePath == nil || ![self directoryExists:cachePath create:inCreate]) return nil;
+	return cachePath;
+}
+
+
+// The old single-file cache, which sat next to where the folder is now.
+- (NSString *)legacyCachePath
+{
+	return [[self cacheBasePathCreatingIfNecessary:NO] stringByAppendingPathExtension:@"plist"];
+}
+
 @end
 
 
@@ -707,15 +1136,68 @@ static OOCacheManager *sSingleton = nil;
 @end
 
 
-#if WRITE_ASYNC
+/*	64-bit FNV-1a. This only needs to notice that a file has changed, not
+	resist tampering.
+*/
+static NSString *HashOfFileAtPath(NSString *path)
+{
+	NSData					*data = nil;
+	const uint8_t			*bytes = NULL;
+	NSUInteger				i, length;
+	uint64_t				hash = 0xCBF29CE484222325ULL;
+	
+	data = [[NSData alloc] initWithContentsOfMappedFile:path];
+	if (data == nil)  return nil;
+	
+	bytes = [data bytes];
+	length = [data length];
+	for (i = 0; i < length; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+	[data release];
+	
+	// As a string because not every property list implementation handles unsigned 64-bit integers.
+	return [NSString stringWithFormat:@"%016llx", (unsigned long long)hash];
+}
+
+
 @implementation OOAsyncCacheWriter
 
-- (id) initWithCacheContents:(NSDictionary *)cacheContents
+- (id) initWithFolder:(NSString *)folder
+			 manifest:(NSDictionary *)manifest
+			   caches:(NSDictionary *)caches
+		removedCaches:(NSArray *)removedCaches
+			removeAll:(BOOL)removeAll
+		   legacyPath:(NSString *)legacyPath
 {
+	NSMutableDictionary		*snapshots = nil;
+	NSString				*cacheKey = nil;
+	
 	if ((self = [super init]))
 	{
-		_cacheContents = [cacheContents copy];
-		if (_cacheContents == nil)
+		_folder = [folder copy];
+		_manifest = [manifest copy];
+		_caches = [caches copy];
+		_removedCaches = [removedCaches copy];
+		_removeAll = removeAll;
+		_legacyPath = [legacyPath copy];
+		
+		snapshots = [NSMutableDictionary dictionaryWithCapacity:[caches count]];
+		foreachkey (cacheKey, caches)
+		{
+			OOCacheShard *snapshot = [[caches objectForKey:cacheKey] snapshot];
+			if (snapshot == nil)
+			{
+				snapshots = nil;
+				break;
+			}
+			[snapshots setObject:snapshot forKey:cacheKey];
+		}
+		_snapshots = [snapshots copy];
+		
+		if (_folder == nil || _manifest == nil || _caches == nil || _snapshots == nil)
 		{
 			[self release];
 			self = nil;
@@ -728,30 +1210,139 @@ static OOCacheManager *sSingleton = nil;
 
 - (void) dealloc
 {
-	DESTROY(_cacheContents);
+	DESTROY(_folder);
+	DESTROY(_manifest);
+	DESTROY(_caches);
+	DESTROY(_snapshots);
+	DESTROY(_removedCaches);
+	DESTROY(_legacyPath);
 	
 	[super dealloc];
 }
 
 
-- (void) performAsyncTask
+- (BOOL) writeCaches
 {
-	if ([[OOCacheManager sharedCache] writeDict:_cacheContents])
+	NSFileManager		*fmgr = [NSFileManager defaultManager];
+	NSString			*file = nil;
+	NSString			*cacheKey = nil;
+	NSData				*data = nil;
+	NSString			*errorDesc = nil;
+	BOOL				OK = YES;
+	
+#if PROFILE_WRITES
+	OOProfilingStopwatch *stopwatch = [OOProfilingStopwatch stopwatch];
+#endif
+	
+	/*	Stale files go first and the manifest last. Each file is replaced
+		atomically, so if writing is interrupted every cache file is either
+		old or new, never partial.
+	*/
+	if (_removeAll)
 	{
-		OOLog(kOOLogDataCacheWriteSuccess, @"Wrote data cache.");
+		foreach (file, [fmgr directoryContentsAtPath:_folder])
+		{
+			if ([[file pathExtension] isEqualToString:OOCACHE_SHARD_EXTENSION])
+			{
+				[fmgr removeFileAtPath:[_folder stringByAppendingPathComponent:file] handler:nil];
+			}
+		}
 	}
 	else
 	{
-		OOLog(kOOLogDataCacheWriteFailed, @"Failed to write data cache.");
+		foreach (cacheKey, _removedCaches)
+		{
+			[fmgr removeFileAtPath:[_folder stringByAppendingPathComponent:[OOCacheShard fileNameForCacheName:cacheKey]] handler:nil];
+		}
 	}
-	DESTROY(_cacheContents);
+	
+	foreach (cacheKey, [_snapshots allKeys])
+	{
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		
+		data = [[_snapshots objectForKey:cacheKey] data];
+		if (data == nil || ![data writeToFile:[_folder stringByAppendingPathComponent:[OOCacheShard fileNameForCacheName:cacheKey]] atomically:YES])
+		{
+			OOLog(kOOLogDataCacheWriteFailed, @"Failed to write data cache \"%@\".", cacheKey);
+			OK = NO;
+		}
+		
+		[pool release];
+	}
+	
+	if (_legacyPath != nil)  [fmgr removeFileAtPath:_legacyPath handler:nil];
+	
+	data = [NSPropertyListSerialization dataFromPropertyList:_manifest format:CACHE_PLIST_FORMAT errorDescription:&errorDesc];
+	if (data == nil)
+	{
+		OOLog(kOOLogDataCacheSerializationError, @"Could not convert data cache manifest to property list data: %@", errorDesc);
+#if OOLITE_RELEASE_PLIST_ERROR_STRINGS
+		[errorDesc autorelease];
+#endif
+		OK = NO;
+	}
+	else if (![data writeToFile:[_folder stringByAppendingPathComponent:kManifestFileName] atomically:YES])
+	{
+		OK = NO;
+	}
+	
+#if PROFILE_WRITES
+	OOTimeDelta writeT = [stopwatch reset];
+	OOLog(@"dataCache.profile", @"Time to write %lu caches: %g seconds.", (unsigned long)[_snapshots count], writeT);
+#endif
+	
+	_succeeded = OK;
+	return OK;
+}
+
+
+- (BOOL) succeeded
+{
+	return _succeeded;
+}
+
+
+- (NSArray *) removedCaches
+{
+	return _removedCaches;
+}
+
+
+- (BOOL) removeAll
+{
+	return _removeAll;
+}
+
+
+- (NSString *) legacyPath
+{
+	return _legacyPath;
+}
+
+
+- (void) markCachesClean
+{
+	NSString				*cacheKey = nil;
+	
+	foreachkey (cacheKey, _caches)
+	{
+		[[_caches objectForKey:cacheKey] markCleanAsOfSnapshot:[_snapshots objectForKey:cacheKey]];
+	}
+}
+
+
+- (void) performAsyncTask
+{
+	[self writeCaches];
 }
 
 
 - (void) completeAsyncTask
 {
-	// Don't need to do anything, but this needs to be here so we can wait on it.
+	[[OOCacheManager sharedCache] writeCompleted:self];
+	
+	// The shards belong to the main thread, so don't leave releasing them to whichever thread releases the writer.
+	DESTROY(_caches);
 }
 
 @end
-#endif	// WRITE_ASYNC
@@ -0,0 +1,122 @@
+/*
+
+OOCacheShard.h
+
+One cache of the data cache, as stored on disk by OOCacheManager.
+
+A shard file holds a single cache: a fixed header, a table of entries sorted
+by the UTF-8 bytes of their keys, the cache name, and then the keys and
+values. Each value is a separate binary property list. All integers are in
+native byte order; the header includes an endian tag so that a file from a
+machine with different byte order is rejected rather than misread.
+
+The file is memory-mapped, and values are only decoded when they are looked
+up, so opening a shard costs the same regardless of its size. Changes are
+kept in a write log on top of the mapping, so modifying an entry doesn't
+decode the others. When the shard is written out, unchanged entries are
+copied from the mapped file byte for byte and only changed entries are
+serialized.
+
+Shard files are always replaced by writing a new file and renaming it, so an
+existing mapping of an old version stays valid.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+@interface OOCacheShard: NSObject
+{
+@private
+	NSString				*_name;
+
+	// The shard file the cache was read from, if any.
+	NSData					*_mapping;
+	const struct OOCacheShardEntry *_entries;
+	uint32_t				_entryCount;
+	NSMutableDictionary		*_decoded;
+
+	// Changes since the file was read: key -> new value, or NSNull for removed entries.
+	NSMutableDictionary		*_changes;
+	NSUInteger				_count;
+
+	NSUInteger				_changeCount;		// Incremented by each change.
+	NSUInteger				_cleanChangeCount;	// _changeCount as of the last write.
+}
+
+// An empty cache.
+- (id) initWithName:(NSString *)name;
+
+// A cache with the specified contents, marked dirty.
+- (id) initWithName:(NSString *)name contents:(NSDictionary *)contents;
+
+/*	Open a shard file. Returns nil if the file doesn't exist, or is invalid.
+	If name is nil, the shard takes the name stored in the file; otherwise the
+	file must belong to the named cache.
+*/
+- (id) initWithContentsOfFile:(NSString *)path name:(NSString *)name;
+
+- (NSString *) name;
+- (NSUInteger) count;
+
+- (id) objectForKey:(NSString *)key;
+- (void) setObject:(id)object forKey:(NSString *)key;
+- (void) removeObjectForKey:(NSString *)key;
+
+// Every entry, decoding any that haven't been looked up.
+- (NSDictionary *) dictionaryRepresentation;
+
+- (BOOL) isDirty;
+
+/*	A copy of the cache as it is now, sharing the mapped file, for writing out
+	on another thread. The copy must not be modified.
+*/
+- (OOCacheShard *) snapshot;
+
+/*	Mark the changes included in a snapshot taken from this shard as written.
+	Changes made since the snapshot was taken still leave the shard dirty.
+*/
+- (void) markCleanAsOfSnapshot:(OOCacheShard *)snapshot;
+
+/*	The cache in shard file format. Doesn't touch any shared state, so it may
+	be called on any thread for a snapshot.
+*/
+- (NSData *) data;
+
+// Serialize a dictionary in shard file format. May be used on any thread.
++ (NSData *) dataWithContents:(NSDictionary *)contents name:(NSString *)name;
+
+/*	File name (without folder) of the shard file for a cache. Cache names are
+	arbitrary strings, so anything other than ASCII letters, digits, spaces
+	and hyphens is escaped.
+*/
++ (NSString *) fileNameForCacheName:(NSString *)name;
+
+/*	The cache name a shard file name was made from, without opening the file,
+	or nil if it isn't the name of a shard file.
+*/
++ (NSString *) cacheNameForFileName:(NSString *)fileName;
+
+@end
+
+
+#define OOCACHE_SHARD_EXTENSION		@"oocache"
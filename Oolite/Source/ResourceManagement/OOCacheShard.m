@@ -0,0 +1,610 @@
+/*
+
+OOCacheShard.m
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOCacheShard.h"
+
+
+// Use the (presumed) most efficient plist format for each platform.
+#if OOLITE_MAC_OS_X
+#define CACHE_PLIST_FORMAT	NSPropertyListBinaryFormat_v1_0
+#else
+#define CACHE_PLIST_FORMAT	NSPropertyListGNUstepBinaryFormat
+#endif
+
+
+static NSString * const kOOLogDataCacheShardInvalid			= @"dataCache.shard.invalid";
+static NSString * const kOOLogDataCacheShardBadValue		= @"dataCache.shard.badValue";
+static NSString * const kOOLogDataCacheSerializationError	= @"dataCache.write.serialize.failed";
+
+
+enum
+{
+	kShardMagic				= 0x4F4F4353,	// 'OOCS'
+	kShardFormatVersion		= 1
+};
+
+static const uint64_t kShardEndianTag = 0x0123456789ABCDEFULL;
+
+
+typedef struct
+{
+	uint32_t				magic;
+	uint32_t				formatVersion;
+	uint64_t				endianTag;
+	uint32_t				entryCount;
+	uint32_t				nameLength;		// UTF-8 cache name, immediately after the entry table.
+} OOCacheShardHeader;
+
+
+typedef struct OOCacheShardEntry
+{
+	uint32_t				keyOffset;
+	uint32_t				keyLength;
+	uint32_t				valueOffset;
+	uint32_t				valueLength;
+} OOCacheShardEntry;
+
+
+static NSData *PropertyListData(id plist, NSString *key, NSString *name);
+static NSData *ShardData(NSDictionary *valuesByKeyData, NSString *name);
+static NSInteger CompareKeyData(id a, id b, void *context);
+OOINLINE int CompareKeyBytes(const uint8_t *a, size_t aLength, const uint8_t *b, size_t bLength);
+
+
+@interface OOCacheShard (OOPrivate)
+
+- (BOOL) priv_validateMapping:(NSData *)mapping name:(NSString *)name;
+- (BOOL) priv_findKey:(NSString *)key index:(uint32_t *)outIndex;
+- (BOOL) priv_hasKey:(NSString *)key;
+- (NSString *) priv_keyAtIndex:(uint32_t)index;
+- (id) priv_objectAtIndex:(uint32_t)index;
+
+@end
+
+
+@implementation OOCacheShard
+
+- (id) initWithName:(NSString *)name
+{
+	return [self initWithName:name contents:nil];
+}
+
+
+- (id) initWithName:(NSString *)name contents:(NSDictionary *)contents
+{
+	NSParameterAssert(name != nil);
+	
+	if ((self = [super init]))
+	{
+		_name = [name copy];
+		_changes = (contents != nil) ? [contents mutableCopy] : [[NSMutableDictionary alloc] init];
+		_count = [_changes count];
+		if (contents != nil)  _changeCount = 1;
+	}
+	
+	return self;
+}
+
+
+- (id) initWithContentsOfFile:(NSString *)path name:(NSString *)name
+{
+	NSData					*mapping = nil;
+	
+	if ((self = [super init]))
+	{
+#if OOLITE_WINDOWS
+		// Windows won't rename over a mapped file, so read it instead.
+		mapping = [NSData dataWithContentsOfFile:path];
+#else
+		mapping = [NSData dataWithContentsOfMappedFile:path];
+#endif
+		if (mapping == nil)
+		{
+			[self release];
+			return nil;
+		}
+		
+		if (![self priv_validateMapping:mapping name:name])
+		{
+			OOLog(kOOLogDataCacheShardInvalid, @"Data cache file %@ is invalid, ignoring it.", [path lastPathComponent]);
+			[self release];
+			return nil;
+		}
+		
+		_mapping = [mapping retain];
+		_decoded = [[NSMutableDictionary alloc] init];
+		_changes = [[NSMutableDictionary alloc] init];
+		_count = _entryCount;
+	}
+	
+	return self;
+}
+
+
+- (void) dealloc
+{
+	DESTROY(_name);
+	DESTROY(_mapping);
+	DESTROY(_decoded);
+	DESTROY(_changes);
+	
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"\"%@\", %lu entries, %lu changed%s", _name, (unsigned long)_count, (unsigned long)[_changes count], [self isDirty] ? ", dirty" : ""];
+}
+
+
+- (NSString *) name
+{
+	return _name;
+}
+
+
+- (NSUInteger) count
+{
+	return _count;
+}
+
+
+- (id) objectForKey:(NSString *)key
+{
+	uint32_t				index;
+	id						result = nil;
+	
+	result = [_changes objectForKey:key];
+	if (result != nil)  return (result != [NSNull null]) ? result : nil;
+	
+	result = [_decoded objectForKey:key];
+	if (result != nil)  return result;
+	
+	if (![self priv_findKey:key index:&index])  return nil;
+	
+	result = [self priv_objectAtIndex:index];
+	if (result != nil)  [_decoded setObject:result forKey:key];
+	return result;
+}
+
+
+- (void) setObject:(id)object forKey:(NSString *)key
+{
+	NSParameterAssert(object != nil && key != nil);
+	
+	if (![self priv_hasKey:key])  _count++;
+	[_changes setObject:object forKey:key];
+	[_decoded removeObjectForKey:key];
+	_changeCount++;
+}
+
+
+- (void) removeObjectForKey:(NSString *)key
+{
+	if (![self priv_hasKey:key])  return;
+	
+	// Entries that are only in the write log can simply be dropped from it.
+	if ([self priv_findKey:key index:NULL])  [_changes setObject:[NSNull null] forKey:key];
+	else  [_changes removeObjectForKey:key];
+	[_decoded removeObjectForKey:key];
+	_count--;
+	_changeCount++;
+}
+
+
+- (NSDictionary *) dictionaryRepresentation
+{
+	NSMutableDictionary		*result = nil;
+	NSString				*key = nil;
+	id						object = nil;
+	uint32_t				i;
+	
+	result = [NSMutableDictionary dictionaryWithCapacity:_count];
+	for (i = 0; i < _entryCount; i++)
+	{
+		key = [self priv_keyAtIndex:i];
+		if (key == nil || [_changes objectForKey:key] != nil)  continue;
+		
+		object = [_decoded objectForKey:key];
+		if (object == nil)  object = [self priv_objectAtIndex:i];
+		if (object != nil)  [result setObject:object forKey:key];
+	}
+	
+	foreachkey (key, _changes)
+	{
+		object = [_changes objectForKey:key];
+		if (object != [NSNull null])  [result setObject:object forKey:key];
+	}
+	
+	return result;
+}
+
+
+- (BOOL) isDirty
+{
+	return _changeCount != _cleanChangeCount;
+}
+
+
+- (OOCacheShard *) snapshot
+{
+	OOCacheShard			*result = nil;
+	NSDictionary			*changes = nil;
+	
+	result = [[[OOCacheShard alloc] init] autorelease];
+	if (result == nil)  return nil;
+	
+	result->_name = [_name copy];
+	result->_mapping = [_mapping retain];
+	result->_entries = _entries;
+	result->_entryCount = _entryCount;
+	
+	// Changed values belong to the cache's users, who may still modify them.
+	changes = OODeepCopy(_changes);
+	result->_changes = [changes mutableCopy];
+	[changes release];
+	
+	result->_count = _count;
+	result->_changeCount = _changeCount;
+	
+	return result;
+}
+
+
+- (void) markCleanAsOfSnapshot:(OOCacheShard *)snapshot
+{
+	if (snapshot != nil && snapshot->_changeCount > _cleanChangeCount)  _cleanChangeCount = snapshot->_changeCount;
+}
+
+
+- (NSData *) data
+{
+	NSMutableDictionary		*valuesByKeyData = nil;
+	const uint8_t			*base = [_mapping bytes];
+	NSString				*key = nil;
+	NSData					*value = nil;
+	id						object = nil;
+	uint32_t				i;
+	
+	valuesByKeyData = [NSMutableDictionary dictionaryWithCapacity:_count];
+	
+	// Unchanged entries are copied as they are. The caller's reference to the shard keeps the mapping alive until the data is built.
+	for (i = 0; i < _entryCount; i++)
+	{
+		const OOCacheShardEntry *entry = &_entries[i];
+		
+		key = [self priv_keyAtIndex:i];
+		if (key == nil || [_changes objectForKey:key] != nil)  continue;
+		
+		[valuesByKeyData setObject:[NSData dataWithBytesNoCopy:(uint8_t *)base + entry->valueOffset length:entry->valueLength freeWhenDone:NO]
+							forKey:[NSData dataWithBytes:base + entry->keyOffset length:entry->keyLength]];
+	}
+	
+	foreachkey (key, _changes)
+	{
+		object = [_changes objectForKey:key];
+		if (object == [NSNull null])  continue;
+		
+		value = PropertyListData(object, key, _name);
+		if (value == nil)  return nil;
+		[valuesByKeyData setObject:value forKey:[key dataUsingEncoding:NSUTF8StringEncoding]];
+	}
+	
+	return ShardData(valuesByKeyData, _name);
+}
+
+
++ (NSData *) dataWithContents:(NSDictionary *)contents name:(NSString *)name
+{
+	NSMutableDictionary		*valuesByKeyData = nil;
+	NSString				*key = nil;
+	NSData					*value = nil;
+	
+	NSParameterAssert(name != nil);
+	
+	valuesByKeyData = [NSMutableDictionary dictionaryWithCapacity:[contents count]];
+	foreachkey (key, contents)
+	{
+		if (![key isKindOfClass:[NSString class]])  return nil;
+	
+		value = PropertyListData([contents objectForKey:key], key, name);
+		if (value == nil)  return nil;
+		[valuesByKeyData setObject:value forKey:[key dataUsingEncoding:NSUTF8StringEncoding]];
+	}
+	
+	return ShardData(valuesByKeyData, name);
+}
+
+
++ (NSString *) fileNameForCacheName:(NSString *)name
+{
+	NSMutableString			*result = nil;
+	const unsigned char		*bytes = NULL;
+	
+	/*	Escaping doesn't distinguish case, so on a case-insensitive file system
+		two caches whose names differ only in case would share a file. The
+		name stored in the file catches this; each would just keep rejecting
+		the other's file and rebuilding.
+	*/
+	result = [NSMutableString stringWithCapacity:[name length]];
+	for (bytes = (const unsigned char *)[name UTF8String]; *bytes != '\0'; bytes++)
+	{
+		unsigned char c = *bytes;
+		if (isascii(c) && (isalnum(c) || c == ' ' || c == '-'))
+		{
+			[result appendFormat:@"%c", c];
+		}
+		else
+		{
+			[result appendFormat:@"%%%02X", c];
+		}
+	}
+	
+	return [result stringByAppendingPathExtension:OOCACHE_SHARD_EXTENSION];
+}
+
+
++ (NSString *) cacheNameForFileName:(NSString *)fileName
+{
+	NSMutableData			*bytes = nil;
+	const char				*chars = NULL;
+	unsigned				escaped;
+	
+	if (![[fileName pathExtension] isEqualToString:OOCACHE_SHARD_EXTENSION])  return nil;
+	
+	chars = [[fileName stringByDeletingPathExtension] UTF8String];
+	if (chars == NULL)  return nil;
+	
+	bytes = [NSMutableData dataWithCapacity:strlen(chars)];
+	for (; *chars != '\0'; chars++)
+	{
+		uint8_t c = *chars;
+		if (c == '%')
+		{
+			if (!isxdigit((unsigned char)chars[1]) || !isxdigit((unsigned char)chars[2]) || sscanf(chars + 1, "%2x", &escaped) != 1)  return nil;
+			c = escaped;
+			chars += 2;
+		}
+		[bytes appendBytes:&c length:1];
+	}
+	
+	return [[[NSString alloc] initWithData:bytes encoding:NSUTF8StringEncoding] autorelease];
+}
+
+
+- (BOOL) priv_validateMapping:(NSData *)mapping name:(NSString *)name
+{
+	const uint8_t			*base = [mapping bytes];
+	unsigned long long		length = [mapping length];
+	OOCacheShardHeader		header;
+	unsigned long long		tableEnd;
+	uint32_t				i;
+	
+	if (length < sizeof header)  return NO;
+	memcpy(&header, base, sizeof header);
+	
+	if (header.magic != kShardMagic || header.formatVersion != kShardFormatVersion || header.endianTag != kShardEndianTag)  return NO;
+	
+	tableEnd = sizeof header + (unsigned long long)header.entryCount * sizeof (OOCacheShardEntry);
+	if (tableEnd + header.nameLength > length)  return NO;
+	
+	_entries = (const OOCacheShardEntry *)(base + sizeof header);
+	_entryCount = header.entryCount;
+	
+	for (i = 0; i < _entryCount; i++)
+	{
+		if ((unsigned long long)_entries[i].keyOffset + _entries[i].keyLength > length)  return NO;
+		if ((unsigned long long)_entries[i].valueOffset + _entries[i].valueLength > length)  return NO;
+	}
+	
+	_name = [[NSString alloc] initWithBytes:base + tableEnd length:header.nameLength encoding:NSUTF8StringEncoding];
+	if (_name == nil)  return NO;
+	if (name != nil && ![_name isEqualToString:name])  return NO;
+	
+	return YES;
+}
+
+
+- (NSString *) priv_keyAtIndex:(uint32_t)index
+{
+	const OOCacheShardEntry	*entry = &_entries[index];
+	
+	return [[[NSString alloc] initWithBytes:(const uint8_t *)[_mapping bytes] + entry->keyOffset
+									 length:entry->keyLength
+								   encoding:NSUTF8StringEncoding] autorelease];
+}
+
+
+- (id) priv_objectAtIndex:(uint32_t)index
+{
+	const OOCacheShardEntry	*entry = &_entries[index];
+	NSData					*data = nil;
+	NSString				*errorString = nil;
+	id						result = nil;
+	
+	// The property list parser copies everything it returns, so nothing refers to the mapping afterwards.
+	data = [NSData dataWithBytesNoCopy:(uint8_t *)[_mapping bytes] + entry->valueOffset
+								length:entry->valueLength
+						  freeWhenDone:NO];
+	
+	NS_DURING
+		result = [NSPropertyListSerialization propertyListFromData:data
+												  mutabilityOption:NSPropertyListImmutable
+															format:NULL
+												  errorDescription:&errorString];
+	NS_HANDLER
+		errorString = [localException reason];
+		result = nil;
+	NS_ENDHANDLER
+	
+	if (result == nil)
+	{
+		OOLog(kOOLogDataCacheShardBadValue, @"Could not read entry %@ of data cache \"%@\": %@", [self priv_keyAtIndex:index], _name, errorString);
+#if OOLITE_RELEASE_PLIST_ERROR_STRINGS
+		[errorString release];
+#endif
+	}
+	
+	return result;
+}
+
+
+- (BOOL) priv_findKey:(NSString *)key index:(uint32_t *)outIndex
+{
+	const uint8_t			*base = NULL;
+	const char				*keyBytes = NULL;
+	size_t					keyLength;
+	uint32_t				low, high;
+	
+	if (_entryCount == 0)  return NO;
+	
+	base = [_mapping bytes];
+	keyBytes = [key UTF8String];
+	if (EXPECT_NOT(keyBytes == NULL))  return NO;
+	keyLength = strlen(keyBytes);
+	
+	low = 0;
+	high = _entryCount;
+	while (low < high)
+	{
+		uint32_t mid = low + (high - low) / 2;
+		const OOCacheShardEntry *entry = &_entries[mid];
+		int order = CompareKeyBytes(base + entry->keyOffset, entry->keyLength, (const uint8_t *)keyBytes, keyLength);
+		
+		if (order < 0)  low = mid + 1;
+		else if (order > 0)  high = mid;
+		else
+		{
+			if (outIndex != NULL)  *outIndex = mid;
+			return YES;
+		}
+	}
+	
+	return NO;
+}
+
+
+- (BOOL) priv_hasKey:(NSString *)key
+{
+	id change = [_changes objectForKey:key];
+	if (change != nil)  return change != [NSNull null];
+	
+	return [self priv_findKey:key index:NULL];
+}
+
+@end
+
+
+static NSData *PropertyListData(id plist, NSString *key, NSString *name)
+{
+	NSString				*errorDesc = nil;
+	NSData					*result = nil;
+	
+	result = [NSPropertyListSerialization dataFromPropertyList:plist
+														format:CACHE_PLIST_FORMAT
+											  errorDescription:&errorDesc];
+	if (result == nil)
+	{
+		OOLog(kOOLogDataCacheSerializationError, @"Could not convert entry %@ of data cache \"%@\" to property list data: %@", key, name, errorDesc);
+#if OOLITE_RELEASE_PLIST_ERROR_STRINGS
+		[errorDesc release];
+#endif
+	}
+	
+	return result;
+}
+
+
+// valuesByKeyData: UTF-8 key -> property list data.
+static NSData *ShardData(NSDictionary *valuesByKeyData, NSString *name)
+{
+	NSArray					*sortedKeyData = nil;
+	NSData					*nameData = nil;
+	NSData					*keyData = nil;
+	NSMutableData			*result = nil;
+	OOCacheShardHeader		header;
+	OOCacheShardEntry		*entries = NULL;
+	unsigned long long		offset;
+	uint32_t				i, count;
+	
+	nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+	sortedKeyData = [[valuesByKeyData allKeys] sortedArrayUsingFunction:CompareKeyData context:NULL];
+	count = (uint32_t)[sortedKeyData count];
+	
+	entries = calloc(count != 0 ? count : 1, sizeof *entries);
+	if (entries == NULL)  return nil;
+	
+	offset = sizeof header + count * sizeof *entries + [nameData length];
+	for (i = 0; i < count; i++)
+	{
+		entries[i].keyOffset = (uint32_t)offset;
+		entries[i].keyLength = (uint32_t)[[sortedKeyData objectAtIndex:i] length];
+		offset += entries[i].keyLength;
+	}
+	for (i = 0; i < count; i++)
+	{
+		entries[i].valueOffset = (uint32_t)offset;
+		entries[i].valueLength = (uint32_t)[[valuesByKeyData objectForKey:[sortedKeyData objectAtIndex:i]] length];
+		offset += entries[i].valueLength;
+	}
+	if (offset > UINT32_MAX)
+	{
+		OOLog(kOOLogDataCacheSerializationError, @"Data cache \"%@\" is too large to write.", name);
+		free(entries);
+		return nil;
+	}
+	
+	header.magic = kShardMagic;
+	header.formatVersion = kShardFormatVersion;
+	header.endianTag = kShardEndianTag;
+	header.entryCount = count;
+	header.nameLength = (uint32_t)[nameData length];
+	
+	result = [NSMutableData dataWithCapacity:offset];
+	[result appendBytes:&header length:sizeof header];
+	[result appendBytes:entries length:count * sizeof *entries];
+	[result appendData:nameData];
+	foreach (keyData, sortedKeyData)  [result appendData:keyData];
+	foreach (keyData, sortedKeyData)  [result appendData:[valuesByKeyData objectForKey:keyData]];
+	
+	free(entries);
+	return result;
+}
+
+
+static NSInteger CompareKeyData(id a, id b, void *context)
+{
+	return CompareKeyBytes([a bytes], [a length], [b bytes], [b length]);
+}
+
+
+OOINLINE int CompareKeyBytes(const uint8_t *a, size_t aLength, const uint8_t *b, size_t bLength)
+{
+	int order = memcmp(a, b, MIN(aLength, bLength));
+	if (order != 0)  return order;
+	if (aLength < bLength)  return -1;
+	if (aLength > bLength)  return 1;
+	return 0;
+}
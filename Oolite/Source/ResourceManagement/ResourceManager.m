@@ -379,11 +379,16 @@ static NSMutableDictionary *sStringCache;
 		The strategy is to use a two-entry cache. One entry is an array
 		containing the search paths, the other an array of modification dates
 		(in the same order). If either fails to match the correct settings,
-		we delete both.
+		we delete both, along with every cache that doesn't track the files
+		its entries depend on. Entries that do track them are checked
+		individually when they are used, so unchanged meshes, octrees and
+		scripts survive installing or updating an expansion pack. An explicit
+		flush still clears everything.
 	*/
 	OOCacheManager		*cacheMgr = [OOCacheManager sharedCache];
 	NSFileManager		*fmgr = [NSFileManager defaultManager];
 	BOOL				upToDate = YES;
+	BOOL				explicitFlush = NO;
 	id					oldPaths = nil;
 	NSMutableArray		*modDates = nil;
 	NSEnumerator		*pathEnum = nil;
@@ -394,19 +399,21 @@ static NSMutableDictionary *sStringCache;
 	{
 		OOLog(kOOLogCacheExplicitFlush, @"Cache explicitly flushed with always-flush-cache preference. Rebuilding from scratch.");
 		upToDate = NO;
+		explicitFlush = YES;
 	}
 	
 	if (upToDate && [MyOpenGLView pollShiftKey])
 	{
 		OOLog(kOOLogCacheExplicitFlush, @"Cache explicitly flushed with shift key. Rebuilding from scratch.");
 		upToDate = NO;
+		explicitFlush = YES;
 	}
 	
 	oldPaths = [cacheMgr objectForKey:kOOCacheKeySearchPaths inCache:kOOCacheSearchPathModDates];
 	if (upToDate && ![oldPaths isEqual:searchPaths])
 	{
 		// Expansion packs added/removed
-		if (oldPaths != nil) OOLog(kOOLogCacheStalePaths, @"Cache is stale (search paths have changed). Rebuilding from scratch.");
+		if (oldPaths != nil) OOLog(kOOLogCacheStalePaths, @"Cache is stale (search paths have changed). Rebuilding caches that don't track dependencies.");
 		upToDate = NO;
 	}
 	
@@ -426,13 +433,14 @@ static NSMutableDictionary *sStringCache;
 		
 	if (upToDate && ![[cacheMgr objectForKey:kOOCacheKeyModificationDates inCache:kOOCacheSearchPathModDates] isEqual:modDates])
 	{
-		OOLog(kOOLogCacheStaleDates, @"Cache is stale (modification dates have changed). Rebuilding from scratch.");
+		OOLog(kOOLogCacheStaleDates, @"Cache is stale (modification dates have changed). Rebuilding caches that don't track dependencies.");
 		upToDate = NO;
 	}
 	
 	if (!upToDate)
 	{
-		[cacheMgr clearAllCaches];
+		if (explicitFlush)  [cacheMgr clearAllCaches];
+		else  [cacheMgr clearCachesWithoutDependencies];
 		[cacheMgr setObject:searchPaths forKey:kOOCacheKeySearchPaths inCache:kOOCacheSearchPathModDates];
 		[cacheMgr setObject:modDates forKey:kOOCacheKeyModificationDates inCache:kOOCacheSearchPathModDates];
 	}
@@ -41,6 +41,10 @@ JSObject		*gOOEntityJSPrototype;
 static JSBool EntityGetProperty(JSContext *context, JSObject *this, jsid propID, jsval *value);
 static JSBool EntitySetProperty(JSContext *context, JSObject *this, jsid propID, JSBool strict, jsval *value);
 
+static JSBool EntityGetHeading(JSContext *context, uintN argc, jsval *vp);
+static JSBool EntityGetOrientation(JSContext *context, uintN argc, jsval *vp);
+static JSBool EntityGetPosition(JSContext *context, uintN argc, jsval *vp);
+
 
 JSClass gOOEntityJSClass =
 {
@@ -114,6 +118,9 @@ static JSFunctionSpec sEntityMethods[] =
 {
 	// JS name					Function					min args
 	{ "toString",				OOJSObjectWrapperToString,	0 },
+	{ "getHeading",				EntityGetHeading,			0 },
+	{ "getOrientation",			EntityGetOrientation,		0 },
+	{ "getPosition",			EntityGetPosition,			0 },
 	{ 0 }
 };
 
@@ -318,3 +325,61 @@ static JSBool EntitySetProperty(JSContext *context, JSObject *this, jsid propID,
 	
 	OOJS_NATIVE_EXIT
 }
+
+
+// *** Methods ***
+
+/*	The get*() methods are equivalent to the corresponding properties, but
+	take an optional Vector3D or Quaternion to store the result in, so that
+	scripts polling an entity every frame needn't create a new object each
+	time.
+*/
+#define GET_THIS_ENTITY(THISENT) do { \
+	if (EXPECT_NOT(!OOJSEntityGetEntity(context, OOJS_THIS, &THISENT)))  return NO; /* Exception */ \
+	if (OOIsStaleEntity(THISENT))  OOJS_RETURN_VOID; \
+} while (0)
+
+
+// getHeading([result : Vector3D]) : Vector3D
+static JSBool EntityGetHeading(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	OOEntity					*thisEnt = nil;
+	
+	GET_THIS_ENTITY(thisEnt);
+	
+	OOJS_RETURN_VECTOR_WITH_RESULT(vector_forward_from_quaternion([thisEnt normalOrientation]), argc, OOJS_ARGV, 0);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// getOrientation([result : Quaternion]) : Quaternion
+static JSBool EntityGetOrientation(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	OOEntity					*thisEnt = nil;
+	
+	GET_THIS_ENTITY(thisEnt);
+	
+	OOJS_RETURN_QUATERNION_WITH_RESULT([thisEnt normalOrientation], argc, OOJS_ARGV, 0);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
+// getPosition([result : Vector3D]) : Vector3D
+static JSBool EntityGetPosition(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	OOEntity					*thisEnt = nil;
+	
+	GET_THIS_ENTITY(thisEnt);
+	
+	OOJS_RETURN_VECTOR_WITH_RESULT([thisEnt position], argc, OOJS_ARGV, 0);
+	
+	OOJS_NATIVE_EXIT
+}
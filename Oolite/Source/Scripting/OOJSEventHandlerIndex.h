@@ -0,0 +1,80 @@
+/*
+
+OOJSEventHandlerIndex.h
+
+Index of which scripts in a set handle which events, used to dispatch world
+script events without calling into scripts that don't handle them.
+
+For each event, the index lists the scripts with a property of that name,
+own or inherited, in the order the scripts were given. Lists are built the
+first time an event is looked up, and thrown away when a property of that
+name is added to or deleted from one of the scripts (see
+OOJSScriptPropertyObserver), so handlers added or removed at run time are
+picked up. All lists are thrown away when the shared Script prototype
+changes. A script counts as handling an event if it has the property,
+whatever its value; -[OOJSScript callMethod:...] still checks that it's a
+function.
+
+Changes further up the prototype chain, i.e. to Object.prototype, or
+replacing a script's prototype, aren't noticed until the index is rebuilt.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOJSScript.h"
+
+
+@interface OOJSEventHandlerIndex: NSObject <OOJSScriptPropertyObserver>
+{
+@private
+	NSArray					*_scripts;
+	NSMapTable				*_handlers;		// jsid bits -> NSArray of OOJSScripts.
+	NSUInteger				_prototypeChangeCount;
+	
+	// Statistics.
+	unsigned long long		_events;
+	unsigned long long		_calls;
+	unsigned long long		_skippedCalls;
+	unsigned long long		_rebuilds;
+}
+
+/*	scripts may contain any OOScripts; only OOJSScripts can have handlers.
+	The index is the property observer of each of them until it's
+	deallocated.
+*/
+- (id) initWithScripts:(NSArray *)scripts;
+
+/*	The scripts with a handler for eventID. The array is invalidated if a
+	property is added to or deleted from a script, which handlers may well
+	do, so callers iterating over it while calling handlers must retain it.
+	Requires a request on context.
+*/
+- (NSArray *) scriptsHandlingEvent:(jsid)eventID inContext:(JSContext *)context;
+
+/*	Keys: scripts, events, calls, skippedCalls, rebuilds. calls and
+	skippedCalls are the number of scripts that were and weren't returned by
+	-scriptsHandlingEvent:inContext:, summed over events; rebuilds is the
+	number of times a list had to be built.
+*/
+- (NSDictionary *) statistics;
+- (void) resetStatistics;
+
+@end
@@ -0,0 +1,163 @@
+/*
+
+OOJSEventHandlerIndex.m
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOJSEventHandlerIndex.h"
+
+
+/*	String jsids are interned atom pointers, which stay the same as long as
+	any object has a property with that name. An atom can only be collected
+	once no script or prototype has the property, and losing it goes through
+	-script:didAddOrDeleteProperty: or a prototype change, so a stale list
+	can't be found under a recycled atom.
+*/
+OOINLINE void *KeyForID(jsid propID)
+{
+	return (void *)(uintptr_t)JSID_BITS(propID);
+}
+
+
+@implementation OOJSEventHandlerIndex
+
+- (id) init
+{
+	return [self initWithScripts:nil];
+}
+
+
+- (id) initWithScripts:(NSArray *)scripts
+{
+	if ((self = [super init]))
+	{
+		_scripts = [scripts copy];
+		if (_scripts == nil)  _scripts = [[NSArray alloc] init];
+		
+		_handlers = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSObjectMapValueCallBacks, 0);
+		if (_handlers == NULL)
+		{
+			[self release];
+			return nil;
+		}
+		_prototypeChangeCount = [OOJSScript prototypePropertyChangeCount];
+		
+		OOScript *script = nil;
+		foreach (script, _scripts)
+		{
+			if ([script isKindOfClass:[OOJSScript class]])  [(OOJSScript *)script setPropertyObserver:self];
+		}
+	}
+	
+	return self;
+}
+
+
+- (void) dealloc
+{
+	OOScript *script = nil;
+	foreach (script, _scripts)
+	{
+		if ([script isKindOfClass:[OOJSScript class]] && [(OOJSScript *)script propertyObserver] == self)
+		{
+			[(OOJSScript *)script setPropertyObserver:nil];
+		}
+	}
+	DESTROY(_scripts);
+	
+	if (_handlers != NULL)  NSFreeMapTable(_handlers);
+	
+	[super dealloc];
+}
+
+
+- (NSString *) descriptionComponents
+{
+	return [NSString stringWithFormat:@"%lu scripts, %lu events indexed", (unsigned long)[_scripts count], (unsigned long)NSCountMapTable(_handlers)];
+}
+
+
+- (NSArray *) scriptsHandlingEvent:(jsid)eventID inContext:(JSContext *)context
+{
+	NSParameterAssert(context != NULL && JS_IsInRequest(context));
+	
+	NSUInteger prototypeChangeCount = [OOJSScript prototypePropertyChangeCount];
+	if (EXPECT_NOT(prototypeChangeCount != _prototypeChangeCount))
+	{
+		NSResetMapTable(_handlers);
+		_prototypeChangeCount = prototypeChangeCount;
+	}
+	
+	NSArray *result = NSMapGet(_handlers, KeyForID(eventID));
+	if (EXPECT_NOT(result == nil))
+	{
+		NSMutableArray *handlers = [NSMutableArray array];
+		OOScript *script = nil;
+		foreach (script, _scripts)
+		{
+			if ([script isKindOfClass:[OOJSScript class]] && [(OOJSScript *)script hasPropertyWithID:eventID inContext:context])
+			{
+				[handlers addObject:script];
+			}
+		}
+		
+		result = [[handlers copy] autorelease];
+		NSMapInsert(_handlers, KeyForID(eventID), result);
+		_rebuilds++;
+	}
+	
+	NSUInteger count = [result count];
+	_events++;
+	_calls += count;
+	_skippedCalls += [_scripts count] - count;
+	
+	return result;
+}
+
+
+- (void) script:(OOJSScript *)script didAddOrDeleteProperty:(jsid)propID
+{
+	NSMapRemove(_handlers, KeyForID(propID));
+}
+
+
+- (NSDictionary *) statistics
+{
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+			[NSNumber numberWithUnsignedInteger:[_scripts count]], @"scripts",
+			[NSNumber numberWithUnsignedLongLong:_events], @"events",
+			[NSNumber numberWithUnsignedLongLong:_calls], @"calls",
+			[NSNumber numberWithUnsignedLongLong:_skippedCalls], @"skippedCalls",
+			[NSNumber numberWithUnsignedLongLong:_rebuilds], @"rebuilds",
+			nil];
+}
+
+
+- (void) resetStatistics
+{
+	_events = 0;
+	_calls = 0;
+	_skippedCalls = 0;
+	_rebuilds = 0;
+}
+
+@end
@@ -0,0 +1,80 @@
+/*
+
+OOJSPrivatePool.h
+
+Free-list allocator for the fixed-size private storage of small JavaScript
+value objects, such as Vector3D and Quaternion.
+
+Scripts create these objects at a great rate (every position, velocity or
+arithmetic result is a new one), and each used to get its own malloc()ed
+block which was free()d again when the object was finalized. A pool hands
+out cells carved from chunks of OOJS_PRIVATE_POOL_CHUNK_CELLS, and keeps
+finalized cells on a free list for the next object, so in steady state
+creating a vector doesn't touch malloc() at all. Chunks are never returned
+to the system; the pool's size stays at the high-water mark of live
+objects, which for these types is small.
+
+The JS objects themselves are still created by SpiderMonkey and collected
+as usual; they can't be recycled behind its back, since a script may still
+hold a reference to any of them.
+
+This is *not* thread-safe. Pools are only used from the main thread, where
+all JavaScript runs and objects are finalized.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+
+
+#define OOJS_PRIVATE_POOL_CHUNK_CELLS	256
+
+
+typedef struct OOJSPrivatePoolStatistics
+{
+	NSUInteger				allocations;	// Cells handed out.
+	NSUInteger				chunks;			// Chunks obtained from malloc().
+	NSUInteger				live;			// Cells currently in use.
+} OOJSPrivatePoolStatistics;
+
+
+typedef struct OOJSPrivatePool
+{
+	size_t					cellSize;
+	void					*freeList;
+	OOJSPrivatePoolStatistics stats;
+} OOJSPrivatePool;
+
+
+//	Cells are rounded up to a whole number of pointers, so they can hold the free list link.
+#define OOJS_PRIVATE_POOL_CELL_SIZE(size)	((((size) + sizeof (void *) - 1) / sizeof (void *)) * sizeof (void *))
+
+//	Static initializer for a pool of objects of the given type.
+#define OOJS_PRIVATE_POOL_INIT(type)		{ OOJS_PRIVATE_POOL_CELL_SIZE(sizeof (type)), NULL, { 0, 0, 0 } }
+
+
+//	Returns NULL if memory can't be allocated.
+void *OOJSPrivatePoolAlloc(OOJSPrivatePool *pool)  NONNULL_FUNC;
+
+//	Cell may be NULL.
+void OOJSPrivatePoolFree(OOJSPrivatePool *pool, void *cell)  GCC_ATTR((nonnull (1)));
+
+OOJSPrivatePoolStatistics OOJSPrivatePoolGetStatistics(const OOJSPrivatePool *pool)  NONNULL_FUNC;
@@ -0,0 +1,85 @@
+/*
+
+OOJSPrivatePool.m
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOJSPrivatePool.h"
+
+
+/*	Free cells are linked through their first word. Each new chunk is
+	threaded onto the free list whole, in address order, so cells handed out
+	one after the other are also next to each other in memory.
+*/
+static BOOL AddChunk(OOJSPrivatePool *pool)
+{
+	size_t		cellSize = pool->cellSize;
+	char		*chunk = NULL;
+	NSUInteger	i;
+	
+	chunk = malloc(cellSize * OOJS_PRIVATE_POOL_CHUNK_CELLS);
+	if (EXPECT_NOT(chunk == NULL))  return NO;
+	
+	for (i = 0; i < OOJS_PRIVATE_POOL_CHUNK_CELLS - 1; i++)
+	{
+		*(void **)(chunk + i * cellSize) = chunk + (i + 1) * cellSize;
+	}
+	*(void **)(chunk + i * cellSize) = pool->freeList;
+	
+	pool->freeList = chunk;
+	pool->stats.chunks++;
+	return YES;
+}
+
+
+void *OOJSPrivatePoolAlloc(OOJSPrivatePool *pool)
+{
+	void		*cell = NULL;
+	
+	NSCParameterAssert(pool->cellSize >= sizeof (void *));
+	
+	if (EXPECT_NOT(pool->freeList == NULL) && EXPECT_NOT(!AddChunk(pool)))  return NULL;
+	
+	cell = pool->freeList;
+	pool->freeList = *(void **)cell;
+	
+	pool->stats.allocations++;
+	pool->stats.live++;
+	
+	return cell;
+}
+
+
+void OOJSPrivatePoolFree(OOJSPrivatePool *pool, void *cell)
+{
+	if (cell == NULL)  return;
+	
+	*(void **)cell = pool->freeList;
+	pool->freeList = cell;
+	pool->stats.live--;
+}
+
+
+OOJSPrivatePoolStatistics OOJSPrivatePoolGetStatistics(const OOJSPrivatePool *pool)
+{
+	return pool->stats;
+}
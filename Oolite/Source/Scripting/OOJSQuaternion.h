@@ -26,6 +26,7 @@ MA 02110-1301, USA.
 
 #import <OoliteBase/OoliteBase.h>
 #include <jsapi.h>
+#import "OOJSPrivatePool.h"
 
 
 void InitOOJSQuaternion(JSContext *context, JSObject *global);
@@ -47,6 +48,14 @@ BOOL JSObjectGetQuaternion(JSContext *context, JSObject *quaternionObj, Quaterni
 //	Set the value of a JS quaternion object.
 BOOL JSQuaternionSetQuaternion(JSContext *context, JSObject *quaternionObj, Quaternion quaternion)  GCC_ATTR((nonnull (1)));
 
+/*	Like VectorToResultArgument(), but for quaternions: if argv[index] is a
+	Quaternion, it is set to quaternion and returned instead of a new object.
+*/
+BOOL QuaternionToResultArgument(JSContext *context, Quaternion quaternion, uintN argc, jsval *argv, uintN index, jsval *outValue)  GCC_ATTR((nonnull (1, 6)));
+
+//	Statistics for the private storage of Quaternion objects.
+OOJSPrivatePoolStatistics JSQuaternionGetPoolStatistics(void);
+
 
 /*	QuaternionFromArgumentList()
 	
@@ -37,8 +37,10 @@ MA 02110-1301, USA.
 
 
 static JSObject *sQuaternionPrototype;
+static OOJSPrivatePool sQuaternionPool = OOJS_PRIVATE_POOL_INIT(Quaternion);
 
 
+static BOOL GetQuaternionFast(JSContext *context, JSObject *quaternionObj, Quaternion *outQuaternion)  GCC_ATTR((nonnull (1, 3)));
 static BOOL GetThisQuaternion(JSContext *context, JSObject *quaternionObj, Quaternion *outQuaternion, NSString *method)  NONNULL_FUNC;
 
 
@@ -61,6 +63,7 @@ static JSBool QuaternionVectorForward(JSContext *context, uintN argc, jsval *vp)
 static JSBool QuaternionVectorUp(JSContext *context, uintN argc, jsval *vp);
 static JSBool QuaternionVectorRight(JSContext *context, uintN argc, jsval *vp);
 static JSBool QuaternionToArray(JSContext *context, uintN argc, jsval *vp);
+static JSBool QuaternionSet(JSContext *context, uintN argc, jsval *vp);
 
 // Static methods
 static JSBool QuaternionStaticRandom(JSContext *context, uintN argc, jsval *vp);
@@ -83,6 +86,14 @@ static JSClass sQuaternionClass =
 };
 
 
+//	Like GetVectorPrivate() in OOJSVector.m. Returns NULL for Quaternion.prototype.
+OOINLINE Quaternion *GetQuaternionPrivate(JSContext *context, JSObject *quaternionObj)
+{
+	if (EXPECT_NOT(quaternionObj == NULL || OOJSGetClass(context, quaternionObj) != &sQuaternionClass))  return NULL;
+	return JS_GetPrivate(context, quaternionObj);
+}
+
+
 enum
 {
 	// Property IDs
@@ -116,6 +127,7 @@ static JSFunctionSpec sQuaternionMethods[] =
 	{ "rotateX",				QuaternionRotateX,			1, },
 	{ "rotateY",				QuaternionRotateY,			1, },
 	{ "rotateZ",				QuaternionRotateZ,			1, },
+	{ "set",					QuaternionSet,				1, },
 	{ "toArray",				QuaternionToArray,			0, },
 	{ "vectorForward",			QuaternionVectorForward,	0, },
 	{ "vectorRight",			QuaternionVectorRight,		0, },
@@ -147,7 +159,7 @@ JSObject *JSQuaternionWithQuaternion(JSContext *context, Quaternion quaternion)
 	JSObject				*result = NULL;
 	Quaternion				*private = NULL;
 	
-	private = malloc(sizeof *private);
+	private = OOJSPrivatePoolAlloc(&sQuaternionPool);
 	if (EXPECT_NOT(private == NULL))  return NULL;
 	
 	*private = quaternion;
@@ -158,7 +170,7 @@ JSObject *JSQuaternionWithQuaternion(JSContext *context, Quaternion quaternion)
 		if (!JS_SetPrivate(context, result, private))  result = NULL;
 	}
 	
-	if (EXPECT_NOT(result == NULL)) free(private);
+	if (EXPECT_NOT(result == NULL)) OOJSPrivatePoolFree(&sQuaternionPool, private);
 	
 	return result;
 	
@@ -188,7 +200,33 @@ BOOL JSValueToQuaternion(JSContext *context, jsval value, Quaternion *outQuatern
 {
 	if (EXPECT_NOT(!JSVAL_IS_OBJECT(value)))  return NO;
 	
-	return JSObjectGetQuaternion(context, JSVAL_TO_OBJECT(value), outQuaternion);
+	JSObject *quaternionObj = JSVAL_TO_OBJECT(value);
+	if (EXPECT(GetQuaternionFast(context, quaternionObj, outQuaternion)))  return YES;
+	
+	return JSObjectGetQuaternion(context, quaternionObj, outQuaternion);
+}
+
+
+BOOL QuaternionToResultArgument(JSContext *context, Quaternion quaternion, uintN argc, jsval *argv, uintN index, jsval *outValue)
+{
+	OOJS_PROFILE_ENTER
+	
+	Quaternion				*private = NULL;
+	
+	if (index < argc && JSVAL_IS_OBJECT(argv[index]))  private = GetQuaternionPrivate(context, JSVAL_TO_OBJECT(argv[index]));
+	if (private == NULL)  return QuaternionToJSValue(context, quaternion, outValue);
+	
+	*private = quaternion;
+	*outValue = argv[index];
+	return YES;
+	
+	OOJS_PROFILE_EXIT
+}
+
+
+OOJSPrivatePoolStatistics JSQuaternionGetPoolStatistics(void)
+{
+	return OOJSPrivatePoolGetStatistics(&sQuaternionPool);
 }
 
 
@@ -217,6 +255,7 @@ static QuaternionStatistics sQuaternionConversionStats;
 	
 	NSUInteger sum = stats->quatCount + stats->entityCount + stats->arrayCount + stats->protoCount;
 	double convFac = 100.0 / sum;
+	OOJSPrivatePoolStatistics poolStats = JSQuaternionGetPoolStatistics();
 	
 	return [NSString stringWithFormat:
 		   @"quaternion-to-quaternion conversions: %lu (%g %%)\n"
@@ -225,14 +264,16 @@ static QuaternionStatistics sQuaternionConversionStats;
 			"       prototype-to-zero conversions: %lu (%g %%)\n"
 			"                    null conversions: %lu (%g %%)\n"
 			"                  failed conversions: %lu (%g %%)\n"
-			"                               total: %lu",
+			"                               total: %lu\n"
+			"               quaternions allocated: %lu (%lu live, %lu pool chunks)",
 			(long)stats->quatCount, stats->quatCount * convFac,
 			(long)stats->entityCount, stats->entityCount * convFac,
 			(long)stats->arrayCount, stats->arrayCount * convFac,
 			(long)stats->protoCount, stats->protoCount * convFac,
 			(long)stats->nullCount, stats->nullCount * convFac,
 			(long)stats->failCount, stats->failCount * convFac,
-			(long)sum];
+			(long)sum,
+			(long)poolStats.allocations, (long)poolStats.live, (long)poolStats.chunks];
 }
 
 
@@ -271,7 +312,7 @@ BOOL JSObjectGetQuaternion(JSContext *context, JSObject *quaternionObj, Quaterni
 	}
 	
 	// If this is a (JS) Quaternion...
-	private = JS_GetInstancePrivate(context, quaternionObj, &sQuaternionClass, NULL);
+	private = GetQuaternionPrivate(context, quaternionObj);
 	if (EXPECT(private != NULL))
 	{
 		COUNT(quatCount);
@@ -336,8 +377,21 @@ BOOL JSObjectGetQuaternion(JSContext *context, JSObject *quaternionObj, Quaterni
 }
 
 
+//	Fast path for actual Quaternions, as GetVectorFast() in OOJSVector.m.
+static BOOL GetQuaternionFast(JSContext *context, JSObject *quaternionObj, Quaternion *outQuaternion)
+{
+	Quaternion *private = GetQuaternionPrivate(context, quaternionObj);
+	if (EXPECT_NOT(private == NULL))  return NO;
+	
+	COUNT(quatCount);
+	*outQuaternion = *private;
+	return YES;
+}
+
+
 static BOOL GetThisQuaternion(JSContext *context, JSObject *quaternionObj, Quaternion *outQuaternion, NSString *method)
 {
+	if (EXPECT(GetQuaternionFast(context, quaternionObj, outQuaternion)))  return YES;
 	if (EXPECT(JSObjectGetQuaternion(context, quaternionObj, outQuaternion)))  return YES;
 	
 	jsval arg = OBJECT_TO_JSVAL(quaternionObj);
@@ -354,8 +408,8 @@ BOOL JSQuaternionSetQuaternion(JSContext *context, JSObject *quaternionObj, Quat
 	
 	assert(quaternionObj != NULL);
 	
-	private = JS_GetInstancePrivate(context, quaternionObj, &sQuaternionClass, NULL);
-	if (private != NULL)	// If this is a (JS) Quaternion...
+	private = GetQuaternionPrivate(context, quaternionObj);
+	if (EXPECT(private != NULL))	// If this is a (JS) Quaternion...
 	{
 		*private = quaternion;
 		return YES;
@@ -387,7 +441,7 @@ static BOOL QuaternionFromArgumentListNoErrorInternal(JSContext *context, uintN
 	// Is first object a quaternion or entity?
 	if (JSVAL_IS_OBJECT(argv[0]))
 	{
-		if (JSObjectGetQuaternion(context, JSVAL_TO_OBJECT(argv[0]), outQuaternion))
+		if (JSValueToQuaternion(context, argv[0], outQuaternion))
 		{
 			if (outConsumed != NULL)  *outConsumed = 1;
 			return YES;
@@ -446,7 +500,7 @@ static JSBool QuaternionGetProperty(JSContext *context, JSObject *this, jsid pro
 	Quaternion			quaternion;
 	GLfloat				fValue;
 	
-	if (EXPECT_NOT(!JSObjectGetQuaternion(context, this, &quaternion))) return NO;
+	if (EXPECT_NOT(!GetQuaternionFast(context, this, &quaternion) && !JSObjectGetQuaternion(context, this, &quaternion))) return NO;
 	
 	switch (JSID_TO_INT(propID))
 	{
@@ -486,7 +540,7 @@ static JSBool QuaternionSetProperty(JSContext *context, JSObject *this, jsid pro
 	Quaternion			quaternion;
 	jsdouble			dval;
 	
-	if (EXPECT_NOT(!JSObjectGetQuaternion(context, this, &quaternion))) return NO;
+	if (EXPECT_NOT(!GetQuaternionFast(context, this, &quaternion) && !JSObjectGetQuaternion(context, this, &quaternion))) return NO;
 	if (EXPECT_NOT(!JS_ValueToNumber(context, *value, &dval)))
 	{
 		OOJSReportBadPropertyValue(context, this, propID, sQuaternionProperties, *value);
@@ -526,11 +580,8 @@ static void QuaternionFinalize(JSContext *context, JSObject *this)
 {
 	Quaternion				*private = NULL;
 	
-	private = JS_GetInstancePrivate(context, this, &sQuaternionClass, NULL);
-	if (private != NULL)
-	{
-		free(private);
-	}
+	private = GetQuaternionPrivate(context, this);
+	OOJSPrivatePoolFree(&sQuaternionPool, private);
 }
 
 
@@ -542,17 +593,21 @@ static JSBool QuaternionConstruct(JSContext *context, uintN argc, jsval *vp)
 	Quaternion				*private = NULL;
 	JSObject				*this = NULL;
 	
-	private = malloc(sizeof *private);
+	private = OOJSPrivatePoolAlloc(&sQuaternionPool);
 	if (EXPECT_NOT(private == NULL))  return NO;
 	
 	this = JS_NewObject(context, &sQuaternionClass, NULL, NULL);
-	if (EXPECT_NOT(this == NULL))  return NO;
+	if (EXPECT_NOT(this == NULL))
+	{
+		OOJSPrivatePoolFree(&sQuaternionPool, private);
+		return NO;
+	}
 	
 	if (argc != 0)
 	{
 		if (EXPECT_NOT(!QuaternionFromArgumentListNoErrorInternal(context, argc, OOJS_ARGV, &quaternion, NULL, YES)))
 		{
-			free(private);
+			OOJSPrivatePoolFree(&sQuaternionPool, private);
 			OOJSReportBadArguments(context, NULL, NULL, argc, OOJS_ARGV,
 								   @"Could not construct quaternion from parameters",
 								   @"Quaternion, Entity or array of four numbers");
@@ -564,7 +619,7 @@ static JSBool QuaternionConstruct(JSContext *context, uintN argc, jsval *vp)
 	
 	if (!JS_SetPrivate(context, this, private))
 	{
-		free(private);
+		OOJSPrivatePoolFree(&sQuaternionPool, private);
 		return NO;
 	}
 	
@@ -607,19 +662,20 @@ static JSBool QuaternionToSource(JSContext *context, uintN argc, jsval *vp)
 }
 
 
-// multiply(q : quaternionExpression) : Quaternion
+// multiply(q : quaternionExpression [, result : Quaternion]) : Quaternion
 static JSBool QuaternionMultiply(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Quaternion				thisq, thatq, result;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisQuaternion(context, OOJS_THIS, &thisq, @"multiply"))) return NO;
-	if (EXPECT_NOT(!QuaternionFromArgumentList(context, @"Quaternion", @"multiply", argc, OOJS_ARGV, &thatq, NULL)))  return NO;
+	if (EXPECT_NOT(!QuaternionFromArgumentList(context, @"Quaternion", @"multiply", argc, OOJS_ARGV, &thatq, &consumed)))  return NO;
 	
 	result = quaternion_multiply(thisq, thatq);
 	
-	OOJS_RETURN_QUATERNION(result);
+	OOJS_RETURN_QUATERNION_WITH_RESULT(result, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
@@ -644,7 +700,7 @@ static JSBool QuaternionDot(JSContext *context, uintN argc, jsval *vp)
 }
 
 
-// rotate(axis : vectorExpression, angle : Number) : Quaternion
+// rotate(axis : vectorExpression, angle : Number [, result : Quaternion]) : Quaternion
 static JSBool QuaternionRotate(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
@@ -666,70 +722,74 @@ static JSBool QuaternionRotate(JSContext *context, uintN argc, jsval *vp)
 	}
 	// Else no angle specified, so don't rotate and pass value through unchanged.
 	
-	OOJS_RETURN_QUATERNION(thisq);
+	// The result parameter, if any, follows the angle.
+	OOJS_RETURN_QUATERNION_WITH_RESULT(thisq, argc, argv, 1);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// rotateX(angle : Number) : Quaternion
+// rotateX(angle : Number [, result : Quaternion]) : Quaternion
 static JSBool QuaternionRotateX(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Quaternion				quat;
 	double					angle;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisQuaternion(context, OOJS_THIS, &quat, @"rotateX"))) return NO;
-	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Quaternion", @"rotateX", argc, OOJS_ARGV, &angle, NULL)))  return NO;
+	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Quaternion", @"rotateX", argc, OOJS_ARGV, &angle, &consumed)))  return NO;
 	
 	quaternion_rotate_about_x(&quat, angle);
 	
-	OOJS_RETURN_QUATERNION(quat);
+	OOJS_RETURN_QUATERNION_WITH_RESULT(quat, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// rotateY(angle : Number) : Quaternion
+// rotateY(angle : Number [, result : Quaternion]) : Quaternion
 static JSBool QuaternionRotateY(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Quaternion				quat;
 	double					angle;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisQuaternion(context, OOJS_THIS, &quat, @"rotateY"))) return NO;
-	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Quaternion", @"rotateY", argc, OOJS_ARGV, &angle, NULL)))  return NO;
+	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Quaternion", @"rotateY", argc, OOJS_ARGV, &angle, &consumed)))  return NO;
 	
 	quaternion_rotate_about_y(&quat, angle);
 	
-	OOJS_RETURN_QUATERNION(quat);
+	OOJS_RETURN_QUATERNION_WITH_RESULT(quat, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// rotateZ(angle : Number) : Quaternion
+// rotateZ(angle : Number [, result : Quaternion]) : Quaternion
 static JSBool QuaternionRotateZ(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Quaternion				quat;
 	double					angle;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisQuaternion(context, OOJS_THIS, &quat, @"rotateZ"))) return NO;
-	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Quaternion", @"rotateZ", argc, OOJS_ARGV, &angle, NULL)))  return NO;
+	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Quaternion", @"rotateZ", argc, OOJS_ARGV, &angle, &consumed)))  return NO;
 	
 	quaternion_rotate_about_z(&quat, angle);
 	
-	OOJS_RETURN_QUATERNION(quat);
+	OOJS_RETURN_QUATERNION_WITH_RESULT(quat, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// normalize() : Quaternion
+// normalize([result : Quaternion]) : Quaternion
 static JSBool QuaternionNormalize(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
@@ -740,13 +800,13 @@ static JSBool QuaternionNormalize(JSContext *context, uintN argc, jsval *vp)
 	
 	quaternion_normalize(&quat);
 	
-	OOJS_RETURN_QUATERNION(quat);
+	OOJS_RETURN_QUATERNION_WITH_RESULT(quat, argc, OOJS_ARGV, 0);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// vectorForward() : Vector
+// vectorForward([result : Vector3D]) : Vector
 static JSBool QuaternionVectorForward(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
@@ -758,13 +818,13 @@ static JSBool QuaternionVectorForward(JSContext *context, uintN argc, jsval *vp)
 	
 	result = vector_forward_from_quaternion(thisq);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, 0);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// vectorUp() : Vector
+// vectorUp([result : Vector3D]) : Vector
 static JSBool QuaternionVectorUp(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
@@ -776,13 +836,13 @@ static JSBool QuaternionVectorUp(JSContext *context, uintN argc, jsval *vp)
 	
 	result = vector_up_from_quaternion(thisq);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, 0);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// vectorRight() : Vector
+// vectorRight([result : Vector3D]) : Vector
 static JSBool QuaternionVectorRight(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
@@ -794,7 +854,7 @@ static JSBool QuaternionVectorRight(JSContext *context, uintN argc, jsval *vp)
 	
 	result = vector_right_from_quaternion(thisq);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, 0);
 	
 	OOJS_PROFILE_EXIT
 }
@@ -835,6 +895,40 @@ static JSBool QuaternionToArray(JSContext *context, uintN argc, jsval *vp)
 }
 
 
+// set(q : quaternionExpression) : Quaternion
+// set(w : Number, x : Number, y : Number, z : Number) : Quaternion
+static JSBool QuaternionSet(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_PROFILE_ENTER
+	
+	JSObject				*this = OOJS_THIS;
+	Quaternion				*private = NULL;
+	Quaternion				quaternion;
+	
+	private = GetQuaternionPrivate(context, this);
+	if (EXPECT_NOT(private == NULL))
+	{
+		jsval arg = OBJECT_TO_JSVAL(this);
+		OOJSReportBadArguments(context, @"Quaternion", @"set", 1, &arg, @"Invalid target object", @"Quaternion");
+		return NO;
+	}
+	
+	if (EXPECT_NOT(!QuaternionFromArgumentListNoErrorInternal(context, argc, OOJS_ARGV, &quaternion, NULL, YES)))
+	{
+		OOJSReportBadArguments(context, @"Quaternion", @"set", argc, OOJS_ARGV,
+							   @"Could not construct quaternion from parameters",
+							   @"Quaternion, Entity or four numbers");
+		return NO;
+	}
+	
+	*private = quaternion;
+	
+	OOJS_RETURN_JSOBJECT(this);
+	
+	OOJS_PROFILE_EXIT
+}
+
+
 // *** Static methods ***
 
 // random() : Quaternion
@@ -26,11 +26,14 @@ MA 02110-1301, USA.
 #import "OOScript.h"
 #import "OOJavaScriptEngine.h"
 
+@protocol OOJSScriptPropertyObserver;
+
 
 @interface OOJSScript: OOScript <OOWeakReferenceSupport>
 {
 @private
 	JSObject			*_jsSelf;
+	id <OOJSScriptPropertyObserver> _propertyObserver;	// Not retained.
 	
 	NSString			*name;
 	NSString			*description;
@@ -74,6 +77,29 @@ MA 02110-1301, USA.
 - (BOOL) setProperty:(id)value named:(NSString *)name;
 - (BOOL) defineProperty:(id)value named:(NSString *)name;
 
+// Whether the script object or its prototype chain has a property.
+- (BOOL) hasPropertyWithID:(jsid)propID inContext:(JSContext *)context;
+
+/*	The observer is told whenever a property is added to or deleted from the
+	script object, by the script or anyone else. Changing the value of an
+	existing property isn't reported.
+*/
+- (id <OOJSScriptPropertyObserver>) propertyObserver;
+- (void) setPropertyObserver:(id <OOJSScriptPropertyObserver>)observer;
+
+/*	Goes up whenever a property is added to or deleted from the prototype
+	shared by all scripts. Such changes affect every script, so they aren't
+	sent to the per-script observers.
+*/
++ (NSUInteger) prototypePropertyChangeCount;
+
+@end
+
+
+@protocol OOJSScriptPropertyObserver <NSObject>
+
+- (void) script:(OOJSScript *)script didAddOrDeleteProperty:(jsid)propID;
+
 @end
 
 
@@ -52,6 +52,7 @@ struct RunningStack
 
 static JSObject			*sScriptPrototype;
 static RunningStack		*sRunningStack = NULL;
+static NSUInteger		sPrototypePropertyChangeCount = 0;
 
 
 static void AddStackToArrayReversed(NSMutableArray *array, RunningStack *stack);
@@ -65,14 +66,16 @@ static JSScript *ScriptWithCompiledData(JSContext *context, NSData *data);
 
 static NSString *StrippedName(NSString *string);
 
+static JSBool ScriptAddOrDeleteProperty(JSContext *context, JSObject *this, jsid propID, jsval *value);
+
 
 static JSClass sScriptClass =
 {
 	"Script",
 	JSCLASS_HAS_PRIVATE,
 	
-	JS_PropertyStub,
-	JS_PropertyStub,
+	ScriptAddOrDeleteProperty,
+	ScriptAddOrDeleteProperty,
 	JS_PropertyStub,
 	JS_StrictPropertyStub,
 	JS_EnumerateStub,
@@ -93,6 +96,7 @@ static JSFunctionSpec sScriptMethods[] =
 @interface OOJSScript (OOPrivate)
 
 - (NSString *)scriptNameFromPath:(NSString *)path;
+- (void) notePropertyAddedOrDeleted:(jsid)propID;
 
 @end
 
@@ -491,6 +495,40 @@ static JSFunctionSpec sScriptMethods[] =
 }
 
 
+- (BOOL) hasPropertyWithID:(jsid)propID inContext:(JSContext *)context
+{
+	NSParameterAssert(context != NULL && JS_IsInRequest(context));
+	if (_jsSelf == NULL)  return NO;
+	
+	JSBool found = NO;
+	return JS_HasPropertyById(context, _jsSelf, propID, &found) && found;
+}
+
+
+- (id <OOJSScriptPropertyObserver>) propertyObserver
+{
+	return _propertyObserver;
+}
+
+
+- (void) setPropertyObserver:(id <OOJSScriptPropertyObserver>)observer
+{
+	_propertyObserver = observer;
+}
+
+
++ (NSUInteger) prototypePropertyChangeCount
+{
+	return sPrototypePropertyChangeCount;
+}
+
+
+- (void) notePropertyAddedOrDeleted:(jsid)propID
+{
+	[_propertyObserver script:self didAddOrDeleteProperty:propID];
+}
+
+
 - (jsval)oo_jsValueInContext:(JSContext *)context
 {
 	if (_jsSelf == NULL)  return JSVAL_VOID;
@@ -640,9 +678,9 @@ static JSScript *LoadScriptWithName(JSContext *context, NSString *path, JSObject
 #if OO_CACHE_JS_SCRIPTS
 		if (script != NULL)
 		{
-			// Write compiled script to cache
+			// Write compiled script to cache. It only depends on the source file, so it needn't be rebuilt when other expansion packs change.
 			data = CompiledScriptData(context, script);
-			[cache setObject:data forKey:path inCache:@"compiled JavaScript scripts"];
+			if (data != nil)  [cache setObject:data forKey:path inCache:@"compiled JavaScript scripts" dependingOnFiles:[NSArray arrayWithObject:path]];
 		}
 #endif
 	}
@@ -706,3 +744,23 @@ static NSString *StrippedName(NSString *string)
 	
 	return [string stringByTrimmingCharactersInSet:invalidSet];
 }
+
+
+// Used as both addProperty and delProperty hook; neither affects the property itself.
+static JSBool ScriptAddOrDeleteProperty(JSContext *context, JSObject *this, jsid propID, jsval *value)
+{
+	OOJS_PROFILE_ENTER
+	
+	// The prototype is also a Script, but has no private object.
+	if (this == sScriptPrototype)
+	{
+		sPrototypePropertyChangeCount++;
+		return YES;
+	}
+	
+	OOJSScript *script = OOJSBasicPrivateObjectConverter(context, this);
+	[script notePropertyAddedOrDeleted:propID];
+	return YES;
+	
+	OOJS_PROFILE_EXIT
+}
@@ -80,6 +80,7 @@ static JSBool ShipSetMaterials(JSContext *context, uintN argc, jsval *vp);
 static JSBool ShipSetShaders(JSContext *context, uintN argc, jsval *vp);
 static JSBool ShipExitSystem(JSContext *context, uintN argc, jsval *vp);
 static JSBool ShipUpdateEscortFormation(JSContext *context, uintN argc, jsval *vp);
+static JSBool ShipGetVelocity(JSContext *context, uintN argc, jsval *vp);
 
 static BOOL RemoveOrExplodeShip(JSContext *context, uintN argc, jsval *vp, BOOL explode);
 static JSBool ShipSetMaterialsInternal(JSContext *context, uintN argc, jsval *vp, OOShipEntity *thisEnt, BOOL fromShaders);
@@ -294,6 +295,7 @@ static JSFunctionSpec sShipMethods[] =
 	{ "explode",				ShipExplode,				0 },
 	{ "fireECM",				ShipFireECM,				0 },
 	{ "fireMissile",			ShipFireMissile,			0 },
+	{ "getVelocity",			ShipGetVelocity,			0 },
 	{ "hasRole",				ShipHasRole,				1 },
 	{ "reactToAIMessage",		ShipReactToAIMessage,		1 },
 	{ "remove",					ShipRemove,					0 },
@@ -1944,6 +1946,21 @@ static JSBool ShipUpdateEscortFormation(JSContext *context, uintN argc, jsval *v
 }
 
 
+// getVelocity([result : Vector3D]) : Vector3D
+static JSBool ShipGetVelocity(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_NATIVE_ENTER(context)
+	
+	OOShipEntity				*thisEnt = nil;
+	
+	GET_THIS_SHIP(thisEnt);
+	
+	OOJS_RETURN_VECTOR_WITH_RESULT([thisEnt velocity], argc, OOJS_ARGV, 0);
+	
+	OOJS_NATIVE_EXIT
+}
+
+
 static BOOL RemoveOrExplodeShip(JSContext *context, uintN argc, jsval *vp, BOOL explode)
 {
 	OOJS_PROFILE_ENTER
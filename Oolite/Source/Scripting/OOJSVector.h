@@ -26,6 +26,7 @@ MA 02110-1301, USA.
 
 #import <OoliteBase/OoliteBase.h>
 #include <jsapi.h>
+#import "OOJSPrivatePool.h"
 
 
 void InitOOJSVector(JSContext *context, JSObject *global);
@@ -47,6 +48,21 @@ BOOL JSObjectGetVector(JSContext *context, JSObject *vectorObj, Vector *outVecto
 //	Set the value of a JS vector object.
 BOOL JSVectorSetVector(JSContext *context, JSObject *vectorObj, Vector vector)  GCC_ATTR((nonnull (1)));
 
+/*	VectorToResultArgument()
+	
+	Support for optional result parameters, which let scripts reuse one
+	Vector3D in a loop instead of creating a new one for every call, as in
+	ship.getPosition(pos) or a.add(b, sum). If argv[index] is a Vector3D, it
+	is set to vector and returned in outValue. Otherwise, a new Vector3D is
+	returned as by VectorToJSValue(); anything else passed there is ignored,
+	as extra arguments always have been. Only for methods that document a
+	result parameter.
+*/
+BOOL VectorToResultArgument(JSContext *context, Vector vector, uintN argc, jsval *argv, uintN index, jsval *outValue)  GCC_ATTR((nonnull (1, 6)));
+
+//	Statistics for the private storage of Vector3D objects.
+OOJSPrivatePoolStatistics JSVectorGetPoolStatistics(void);
+
 
 /*	VectorFromArgumentList()
 	
@@ -37,8 +37,10 @@ MA 02110-1301, USA.
 
 
 static JSObject *sVectorPrototype;
+static OOJSPrivatePool sVectorPool = OOJS_PRIVATE_POOL_INIT(Vector);
 
 
+static BOOL GetVectorFast(JSContext *context, JSObject *vectorObj, Vector *outVector)  GCC_ATTR((nonnull (1, 3)));
 static BOOL GetThisVector(JSContext *context, JSObject *vectorObj, Vector *outVector, NSString *method)  NONNULL_FUNC;
 
 
@@ -67,6 +69,7 @@ static JSBool VectorSquaredMagnitude(JSContext *context, uintN argc, jsval *vp);
 static JSBool VectorRotationTo(JSContext *context, uintN argc, jsval *vp);
 static JSBool VectorRotateBy(JSContext *context, uintN argc, jsval *vp);
 static JSBool VectorToArray(JSContext *context, uintN argc, jsval *vp);
+static JSBool VectorSet(JSContext *context, uintN argc, jsval *vp);
 
 // Static methods
 static JSBool VectorStaticInterpolate(JSContext *context, uintN argc, jsval *vp);
@@ -92,6 +95,17 @@ static JSClass sVectorClass =
 };
 
 
+/*	The same class comparison JS_GetInstancePrivate() does, inlined to save
+	a library call on every vector argument. Returns NULL for anything else,
+	and for Vector3D.prototype, which has no private.
+*/
+OOINLINE Vector *GetVectorPrivate(JSContext *context, JSObject *vectorObj)
+{
+	if (EXPECT_NOT(vectorObj == NULL || OOJSGetClass(context, vectorObj) != &sVectorClass))  return NULL;
+	return JS_GetPrivate(context, vectorObj);
+}
+
+
 enum
 {
 	// Property IDs
@@ -127,6 +141,7 @@ static JSFunctionSpec sVectorMethods[] =
 	{ "multiply",				VectorMultiply,				1, },
 	{ "rotateBy",				VectorRotateBy,				1, },
 	{ "rotationTo",				VectorRotationTo,			1, },
+	{ "set",					VectorSet,					1, },
 	{ "squaredDistanceTo",		VectorSquaredDistanceTo,	1, },
 	{ "squaredMagnitude",		VectorSquaredMagnitude,		0, },
 	{ "subtract",				VectorSubtract,				1, },
@@ -163,7 +178,7 @@ JSObject *JSVectorWithVector(JSContext *context, Vector vector)
 	JSObject				*result = NULL;
 	Vector					*private = NULL;
 	
-	private = malloc(sizeof *private);
+	private = OOJSPrivatePoolAlloc(&sVectorPool);
 	if (EXPECT_NOT(private == NULL))  return NULL;
 	
 	*private = vector;
@@ -174,7 +189,7 @@ JSObject *JSVectorWithVector(JSContext *context, Vector vector)
 		if (EXPECT_NOT(!JS_SetPrivate(context, result, private)))  result = NULL;
 	}
 	
-	if (EXPECT_NOT(result == NULL)) free(private);
+	if (EXPECT_NOT(result == NULL)) OOJSPrivatePoolFree(&sVectorPool, private);
 	
 	return result;
 	
@@ -210,7 +225,33 @@ BOOL JSValueToVector(JSContext *context, jsval value, Vector *outVector)
 {
 	if (EXPECT_NOT(!JSVAL_IS_OBJECT(value)))  return NO;
 	
-	return JSObjectGetVector(context, JSVAL_TO_OBJECT(value), outVector);
+	JSObject *vectorObj = JSVAL_TO_OBJECT(value);
+	if (EXPECT(GetVectorFast(context, vectorObj, outVector)))  return YES;
+	
+	return JSObjectGetVector(context, vectorObj, outVector);
+}
+
+
+BOOL VectorToResultArgument(JSContext *context, Vector vector, uintN argc, jsval *argv, uintN index, jsval *outValue)
+{
+	OOJS_PROFILE_ENTER
+	
+	Vector					*private = NULL;
+	
+	if (index < argc && JSVAL_IS_OBJECT(argv[index]))  private = GetVectorPrivate(context, JSVAL_TO_OBJECT(argv[index]));
+	if (private == NULL)  return VectorToJSValue(context, vector, outValue);
+	
+	*private = vector;
+	*outValue = argv[index];
+	return YES;
+	
+	OOJS_PROFILE_EXIT
+}
+
+
+OOJSPrivatePoolStatistics JSVectorGetPoolStatistics(void)
+{
+	return OOJSPrivatePoolGetStatistics(&sVectorPool);
 }
 
 
@@ -240,6 +281,7 @@ static VectorStatistics sVectorConversionStats;
 	NSUInteger sum = stats->vectorCount + stats->entityCount + stats->arrayCount + stats->protoCount;
 	double convFac = 100.0 / sum;
 	if (sum == 0)  convFac = 0;
+	OOJSPrivatePoolStatistics poolStats = JSVectorGetPoolStatistics();
 	
 	return [NSString stringWithFormat:
 		   @" vector-to-vector conversions: %lu (%g %%)\n"
@@ -248,14 +290,16 @@ static VectorStatistics sVectorConversionStats;
 			"prototype-to-zero conversions: %lu (%g %%)\n"
 			"             null conversions: %lu (%g %%)\n"
 			"           failed conversions: %lu (%g %%)\n"
-			"                        total: %lu",
+			"                        total: %lu\n"
+			"            vectors allocated: %lu (%lu live, %lu pool chunks)",
 			(long)stats->vectorCount, stats->vectorCount * convFac,
 			(long)stats->entityCount, stats->entityCount * convFac,
 			(long)stats->arrayCount, stats->arrayCount * convFac,
 			(long)stats->protoCount, stats->protoCount * convFac,
 			(long)stats->nullCount, stats->nullCount * convFac,
 			(long)stats->failCount, stats->failCount * convFac,
-			(long)sum];
+			(long)sum,
+			(long)poolStats.allocations, (long)poolStats.live, (long)poolStats.chunks];
 }
 
 
@@ -294,7 +338,7 @@ BOOL JSObjectGetVector(JSContext *context, JSObject *vectorObj, Vector *outVecto
 	}
 	
 	// If this is a (JS) Vector...
-	private = JS_GetInstancePrivate(context, vectorObj, &sVectorClass, NULL);
+	private = GetVectorPrivate(context, vectorObj);
 	if (EXPECT(private != NULL))
 	{
 		COUNT(vectorCount);
@@ -355,8 +399,24 @@ BOOL JSObjectGetVector(JSContext *context, JSObject *vectorObj, Vector *outVecto
 }
 
 
+/*	Fast path for the common case where a vector is wanted and a Vector3D
+	is supplied, which skips the profiling and conversion cascade of
+	JSObjectGetVector().
+*/
+static BOOL GetVectorFast(JSContext *context, JSObject *vectorObj, Vector *outVector)
+{
+	Vector *private = GetVectorPrivate(context, vectorObj);
+	if (EXPECT_NOT(private == NULL))  return NO;
+	
+	COUNT(vectorCount);
+	*outVector = *private;
+	return YES;
+}
+
+
 static BOOL GetThisVector(JSContext *context, JSObject *vectorObj, Vector *outVector, NSString *method)
 {
+	if (EXPECT(GetVectorFast(context, vectorObj, outVector)))  return YES;
 	if (EXPECT(JSObjectGetVector(context, vectorObj, outVector)))  return YES;
 	
 	jsval arg = OBJECT_TO_JSVAL(vectorObj);
@@ -373,8 +433,8 @@ BOOL JSVectorSetVector(JSContext *context, JSObject *vectorObj, Vector vector)
 	
 	if (EXPECT_NOT(vectorObj == NULL))  return NO;
 	
-	private = JS_GetInstancePrivate(context, vectorObj, &sVectorClass, NULL);
-	if (private != NULL)	// If this is a (JS) Vector...
+	private = GetVectorPrivate(context, vectorObj);
+	if (EXPECT(private != NULL))	// If this is a (JS) Vector...
 	{
 		*private = vector;
 		return YES;
@@ -406,7 +466,7 @@ static BOOL VectorFromArgumentListNoErrorInternal(JSContext *context, uintN argc
 	// Is first object a vector, array or entity?
 	if (JSVAL_IS_OBJECT(argv[0]))
 	{
-		if (JSObjectGetVector(context, JSVAL_TO_OBJECT(argv[0]), outVector))
+		if (JSValueToVector(context, argv[0], outVector))
 		{
 			if (outConsumed != NULL)  *outConsumed = 1;
 			return YES;
@@ -464,7 +524,7 @@ static JSBool VectorGetProperty(JSContext *context, JSObject *this, jsid propID,
 	Vector				vector;
 	GLfloat				fValue;
 	
-	if (EXPECT_NOT(!JSObjectGetVector(context, this, &vector)))  return NO;
+	if (EXPECT_NOT(!GetVectorFast(context, this, &vector) && !JSObjectGetVector(context, this, &vector)))  return NO;
 	
 	switch (JSID_TO_INT(propID))
 	{
@@ -500,7 +560,7 @@ static JSBool VectorSetProperty(JSContext *context, JSObject *this, jsid propID,
 	Vector				vector;
 	jsdouble			dval;
 	
-	if (EXPECT_NOT(!JSObjectGetVector(context, this, &vector)))  return NO;
+	if (EXPECT_NOT(!GetVectorFast(context, this, &vector) && !JSObjectGetVector(context, this, &vector)))  return NO;
 	if (EXPECT_NOT(!JS_ValueToNumber(context, *value, &dval)))
 	{
 		OOJSReportBadPropertyValue(context, this, propID, sVectorProperties, *value);
@@ -538,11 +598,8 @@ static void VectorFinalize(JSContext *context, JSObject *this)
 	
 	Vector					*private = NULL;
 	
-	private = JS_GetInstancePrivate(context, this, &sVectorClass, NULL);
-	if (private != NULL)
-	{
-		free(private);
-	}
+	private = GetVectorPrivate(context, this);
+	OOJSPrivatePoolFree(&sVectorPool, private);
 	
 	OOJS_PROFILE_EXIT_VOID
 }
@@ -556,17 +613,21 @@ static JSBool VectorConstruct(JSContext *context, uintN argc, jsval *vp)
 	Vector					*private = NULL;
 	JSObject				*this = NULL;
 	
-	private = malloc(sizeof *private);
+	private = OOJSPrivatePoolAlloc(&sVectorPool);
 	if (EXPECT_NOT(private == NULL))  return NO;
 	
 	this = JS_NewObject(context, &sVectorClass, NULL, NULL);
-	if (EXPECT_NOT(this == NULL))  return NO;
+	if (EXPECT_NOT(this == NULL))
+	{
+		OOJSPrivatePoolFree(&sVectorPool, private);
+		return NO;
+	}
 	
 	if (argc != 0)
 	{
 		if (EXPECT_NOT(!VectorFromArgumentListNoErrorInternal(context, argc, OOJS_ARGV, &vector, NULL, YES)))
 		{
-			free(private);
+			OOJSPrivatePoolFree(&sVectorPool, private);
 			OOJSReportBadArguments(context, NULL, NULL, argc, OOJS_ARGV,
 								   @"Could not construct vector from parameters",
 								   @"Vector, Entity or array of three numbers");
@@ -578,7 +639,7 @@ static JSBool VectorConstruct(JSContext *context, uintN argc, jsval *vp)
 	
 	if (EXPECT_NOT(!JS_SetPrivate(context, this, private)))
 	{
-		free(private);
+		OOJSPrivatePoolFree(&sVectorPool, private);
 		return NO;
 	}
 	
@@ -621,37 +682,39 @@ static JSBool VectorToSource(JSContext *context, uintN argc, jsval *vp)
 }
 
 
-// add(v : vectorExpression) : Vector3D
+// add(v : vectorExpression [, result : Vector3D]) : Vector3D
 static JSBool VectorAdd(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Vector					thisv, thatv, result;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisVector(context, OOJS_THIS, &thisv, @"add"))) return NO;
-	if (EXPECT_NOT(!VectorFromArgumentList(context, @"Vector3D", @"add", argc, OOJS_ARGV, &thatv, NULL)))  return NO;
+	if (EXPECT_NOT(!VectorFromArgumentList(context, @"Vector3D", @"add", argc, OOJS_ARGV, &thatv, &consumed)))  return NO;
 	
 	result = vector_add(thisv, thatv);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
 
 
-// subtract(v : vectorExpression) : Vector3D
+// subtract(v : vectorExpression [, result : Vector3D]) : Vector3D
 static JSBool VectorSubtract(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Vector					thisv, thatv, result;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisVector(context, OOJS_THIS, &thisv, @"subtract"))) return NO;
-	if (EXPECT_NOT(!VectorFromArgumentList(context, @"Vector3D", @"subtract", argc, OOJS_ARGV, &thatv, NULL)))  return NO;
+	if (EXPECT_NOT(!VectorFromArgumentList(context, @"Vector3D", @"subtract", argc, OOJS_ARGV, &thatv, &consumed)))  return NO;
 	
 	result = vector_subtract(thisv, thatv);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
@@ -695,20 +758,21 @@ static JSBool VectorSquaredDistanceTo(JSContext *context, uintN argc, jsval *vp)
 }
 
 
-// multiply(n : Number) : Vector3D
+// multiply(n : Number [, result : Vector3D]) : Vector3D
 static JSBool VectorMultiply(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Vector					thisv, result;
 	double					scalar;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisVector(context, OOJS_THIS, &thisv, @"multiply"))) return NO;
-	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Vector3D", @"multiply", argc, OOJS_ARGV, &scalar, NULL)))  return NO;
+	if (EXPECT_NOT(!OOJSArgumentListGetNumber(context, @"Vector3D", @"multiply", argc, OOJS_ARGV, &scalar, &consumed)))  return NO;
 	
 	result = vector_multiply_scalar(thisv, scalar);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
@@ -752,19 +816,20 @@ static JSBool VectorAngleTo(JSContext *context, uintN argc, jsval *vp)
 }
 
 
-// cross(v : vectorExpression) : Vector3D
+// cross(v : vectorExpression [, result : Vector3D]) : Vector3D
 static JSBool VectorCross(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Vector					thisv, thatv, result;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisVector(context, OOJS_THIS, &thisv, @"cross"))) return NO;
-	if (EXPECT_NOT(!VectorFromArgumentList(context, @"Vector3D", @"cross", argc, OOJS_ARGV, &thatv, NULL)))  return NO;
+	if (EXPECT_NOT(!VectorFromArgumentList(context, @"Vector3D", @"cross", argc, OOJS_ARGV, &thatv, &consumed)))  return NO;
 	
 	result = true_cross_product(thisv, thatv);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
@@ -794,7 +859,7 @@ static JSBool VectorTripleProduct(JSContext *context, uintN argc, jsval *vp)
 }
 
 
-// direction() : Vector3D
+// direction([result : Vector3D]) : Vector3D
 static JSBool VectorDirection(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
@@ -805,7 +870,7 @@ static JSBool VectorDirection(JSContext *context, uintN argc, jsval *vp)
 	
 	result = vector_normal(thisv);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, 0);
 	
 	OOJS_PROFILE_EXIT
 }
@@ -880,20 +945,21 @@ static JSBool VectorRotationTo(JSContext *context, uintN argc, jsval *vp)
 }
 
 
-// rotateBy(q : quaternionExpression) : Vector3D
+// rotateBy(q : quaternionExpression [, result : Vector3D]) : Vector3D
 static JSBool VectorRotateBy(JSContext *context, uintN argc, jsval *vp)
 {
 	OOJS_PROFILE_ENTER
 	
 	Vector					thisv, result;
 	Quaternion				q;
+	uintN					consumed;
 	
 	if (EXPECT_NOT(!GetThisVector(context, OOJS_THIS, &thisv, @"rotateBy"))) return NO;
-	if (EXPECT_NOT(!QuaternionFromArgumentList(context, @"Vector3D", @"rotateBy", argc, OOJS_ARGV, &q, NULL)))  return NO;
+	if (EXPECT_NOT(!QuaternionFromArgumentList(context, @"Vector3D", @"rotateBy", argc, OOJS_ARGV, &q, &consumed)))  return NO;
 	
 	result = quaternion_rotate_vector(q, thisv);
 	
-	OOJS_RETURN_VECTOR(result);
+	OOJS_RETURN_VECTOR_WITH_RESULT(result, argc, OOJS_ARGV, consumed);
 	
 	OOJS_PROFILE_EXIT
 }
@@ -932,6 +998,40 @@ static JSBool VectorToArray(JSContext *context, uintN argc, jsval *vp)
 }
 
 
+// set(v : vectorExpression) : Vector3D
+// set(x : Number, y : Number, z : Number) : Vector3D
+static JSBool VectorSet(JSContext *context, uintN argc, jsval *vp)
+{
+	OOJS_PROFILE_ENTER
+	
+	JSObject				*this = OOJS_THIS;
+	Vector					*private = NULL;
+	Vector					vector;
+	
+	private = GetVectorPrivate(context, this);
+	if (EXPECT_NOT(private == NULL))
+	{
+		jsval arg = OBJECT_TO_JSVAL(this);
+		OOJSReportBadArguments(context, @"Vector3D", @"set", 1, &arg, @"Invalid target object", @"Vector3D");
+		return NO;
+	}
+	
+	if (EXPECT_NOT(!VectorFromArgumentListNoErrorInternal(context, argc, OOJS_ARGV, &vector, NULL, YES)))
+	{
+		OOJSReportBadArguments(context, @"Vector3D", @"set", argc, OOJS_ARGV,
+							   @"Could not construct vector from parameters",
+							   @"Vector, Entity, array of three numbers or three numbers");
+		return NO;
+	}
+	
+	*private = vector;
+	
+	OOJS_RETURN_JSOBJECT(this);
+	
+	OOJS_PROFILE_EXIT
+}
+
+
 // toCoordinateSystem(coordScheme : String)
 static JSBool VectorToCoordinateSystem(JSContext *context, uintN argc, jsval *vp)
 {
@@ -685,3 +685,21 @@ do { \
 #define OOJS_RETURN_VECTOR(value)		OOJS_RETURN_WITH_HELPER(VectorToJSValue, value)
 #define OOJS_RETURN_QUATERNION(value)	OOJS_RETURN_WITH_HELPER(QuaternionToJSValue, value)
 #define OOJS_RETURN_DOUBLE(value)		OOJS_RETURN_WITH_HELPER(JS_NewNumberValue, value)
+
+/*	Return a vector or quaternion in the optional result parameter argv[index]
+	if the script passed one, or as a new object otherwise. See
+	VectorToResultArgument().
+*/
+#define OOJS_RETURN_VECTOR_WITH_RESULT(value, argc, argv, index) \
+do { \
+	jsval jsresult; \
+	BOOL OK = VectorToResultArgument(context, value, argc, argv, index, &jsresult); \
+	JS_SET_RVAL(context, vp, jsresult); return OK; \
+} while (0)
+
+#define OOJS_RETURN_QUATERNION_WITH_RESULT(value, argc, argv, index) \
+do { \
+	jsval jsresult; \
+	BOOL OK = QuaternionToResultArgument(context, value, argc, argv, index, &jsresult); \
+	JS_SET_RVAL(context, vp, jsresult); return OK; \
+} while (0)
@@ -11,6 +11,11 @@ inited will cause the timer to fire after the specified interval. A persistent
 timer will remain if the player dies and respawns; non-persistent timers will
 be removed.
 
+Scheduled timers are kept in a hierarchical timing wheel (see OOTimingWheel.h),
+so scheduling, unscheduling and firing take constant time. Timers due in the
+same update fire in order of next time, and timers with the same next time in
+the order they were scheduled.
+
 
 Oolite
 Copyright (C) 2004-2011 Giles C Williams and contributors
@@ -34,6 +39,7 @@ MA 02110-1301, USA.
 
 #import <OoliteBase/OoliteBase.h>
 #import "OOTypes.h"
+#import "OOTimingWheel.h"
 
 
 @interface OOScriptTimer: NSObject
@@ -43,6 +49,7 @@ MA 02110-1301, USA.
 	OOTimeDelta					_interval;
 	BOOL						_isScheduled;
 	BOOL						_hasBeenRun;	// Needed for one-shot timers.
+	OOTimingWheelEntry			_wheelEntry;	// In the wheel, or in the due or deferred list.
 }
 
 - (id) initWithNextTime:(OOTimeAbsolute)nextTime
@@ -27,11 +27,19 @@ MA 02110-1301, USA.
 #import "OOUniverse.h"
 
 
-static OOPriorityQueue	*sTimers;
+// The scheduler defers timers scheduled during an update, to avoid an infinite loop.
+static OOTimingWheelScheduler	sTimers;
 
-// During an update, new timers must be deferred to avoid an infinite loop.
-static BOOL				sUpdating;
-static NSMutableArray	*sDeferredTimers;
+
+@interface OOScriptTimer (Private)
+
+- (void) fireDueTimer;
+
+@end
+
+
+static OOTimingWheelScheduler *TimerScheduler(void);
+static void FireDueTimer(OOTimingWheelEntry *entry, void *context);
 
 
 @implementation OOScriptTimer
@@ -43,6 +51,8 @@ static NSMutableArray	*sDeferredTimers;
 	
 	if ((self = [super init]))
 	{
+		_wheelEntry.owner = self;
+		
 		if (interval <= 0.0)  interval = -1.0;
 		
 		now = [UNIVERSE gameTime];
@@ -129,16 +139,12 @@ static NSMutableArray	*sDeferredTimers;
 	if (_isScheduled)  return YES;
 	if (![self isValidForScheduling])  return NO;
 	
-	if (EXPECT(!sUpdating))
-	{
-		if (EXPECT_NOT(sTimers == nil))  sTimers = [[OOPriorityQueue alloc] initWithComparator:@selector(compareByNextFireTime:)];
-		[sTimers addObject:self];
-	}
-	else
-	{
-		if (sDeferredTimers == nil)  sDeferredTimers = [[NSMutableArray alloc] init];
-		[sDeferredTimers addObject:self];
-	}
+	OOTimingWheelScheduler *scheduler = TimerScheduler();
+	if (EXPECT_NOT(scheduler == NULL))  return NO;
+	
+	// The wheel, or whichever list the timer is in, owns this reference.
+	[self retain];
+	OOTimingWheelSchedule(scheduler, &_wheelEntry, _nextTime);
 	
 	_isScheduled = YES;
 	return YES;
@@ -147,9 +153,14 @@ static NSMutableArray	*sDeferredTimers;
 
 - (void) unscheduleTimer
 {
-	[sTimers removeExactObject:self];
+	BOOL wasLinked = OOTimingWheelEntryIsLinked(&_wheelEntry);
+	
+	// A timer that is firing is in no list; +updateTimers holds its reference.
+	OOTimingWheelEntryUnlink(&_wheelEntry);
 	_isScheduled = NO;
 	_hasBeenRun = NO;
+	
+	if (wasLinked)  [self release];
 }
 
 
@@ -161,52 +172,27 @@ static NSMutableArray	*sDeferredTimers;
 
 + (void) updateTimers
 {
-	OOScriptTimer		*timer = nil;
-	OOTimeAbsolute		now;
-	
-	sUpdating = YES;
-	
-	now = [UNIVERSE gameTime];
-	for (;;)
-	{
-		timer = [sTimers peekAtNextObject];
-		if (timer == nil || now < [timer nextTime])  break;
-		
-		[sTimers removeNextObject];
-		
-		// Must fire before rescheduling so that the timer callback can stop itself. -- Ahruman 2011-01-01
-		[timer timerFired];
-		
-		timer->_hasBeenRun = YES;
-		
-		if (timer->_isScheduled)
-		{
-			timer->_isScheduled = NO;
-			[timer scheduleTimer];
-		}
-	}
-	
-	if (sDeferredTimers != nil)
-	{
-		[sTimers addObjects:sDeferredTimers];
-		DESTROY(sDeferredTimers);
-	}
+	if (sTimers.wheel == NULL)  return;
 	
-	sUpdating = NO;
+	OOTimingWheelRunDue(&sTimers, [UNIVERSE gameTime], FireDueTimer, NULL);
 }
 
 
 + (void) noteGameReset
 {
-	NSArray				*timers = nil;
-	NSEnumerator		*timerEnum = nil;
+	OOTimingWheelList	timers = kOOTimingWheelEmptyList;
+	OOTimingWheelEntry	*entry = NULL;
 	OOScriptTimer		*timer = nil;
 	
-	// Intermediate array is required so we don't get stuck in an endless loop over reinserted timers. Note that -sortedObjects also clears the queue!
-	timers = [sTimers sortedObjects];
-	for (timerEnum = [timers objectEnumerator]; (timer = [timerEnum nextObject]); )
+	// Take every timer out first, so releasing one can't disturb the lists being emptied.
+	OOTimingWheelSchedulerRemoveAll(&sTimers, &timers);
+	
+	while ((entry = OOTimingWheelListFirst(&timers)) != NULL)
 	{
+		OOTimingWheelEntryUnlink(entry);
+		timer = entry->owner;
 		timer->_isScheduled = NO;
+		[timer release];
 	}
 }
 
@@ -248,3 +234,48 @@ static NSMutableArray	*sDeferredTimers;
 }
 
 @end
+
+
+@implementation OOScriptTimer (Private)
+
+// Called by +updateTimers for each due timer; the due list's reference to the timer is now ours.
+- (void) fireDueTimer
+{
+	// Must fire before rescheduling so that the timer callback can stop itself. -- Ahruman 2011-01-01
+	[self timerFired];
+	
+	_hasBeenRun = YES;
+	
+	// If the callback stopped and restarted the timer, it's already deferred.
+	if (_isScheduled && !OOTimingWheelEntryIsLinked(&_wheelEntry))
+	{
+		_isScheduled = NO;
+		[self scheduleTimer];
+	}
+	
+	[self release];
+}
+
+@end
+
+
+static OOTimingWheelScheduler *TimerScheduler(void)
+{
+	if (EXPECT_NOT(sTimers.wheel == NULL))
+	{
+		sTimers.wheel = OOTimingWheelCreate([UNIVERSE gameTime]);
+		if (sTimers.wheel == NULL)
+		{
+			OOLogERR(@"script.timer.wheel.failed", @"Could not allocate timer wheel. Timers will not run.");
+			return NULL;
+		}
+	}
+	
+	return &sTimers;
+}
+
+
+static void FireDueTimer(OOTimingWheelEntry *entry, void *context)
+{
+	[(OOScriptTimer *)entry->owner fireDueTimer];
+}
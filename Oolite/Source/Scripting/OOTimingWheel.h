@@ -0,0 +1,160 @@
+/*
+
+OOTimingWheel.h
+
+Hierarchical timing wheel, used by OOScriptTimer to keep scheduled timers.
+
+Time is divided into ticks of 1/TIMING_WHEEL_TICKS_PER_SECOND seconds. The
+wheel has TIMING_WHEEL_LEVELS levels of TIMING_WHEEL_SLOTS slots each; a
+slot on level 0 covers one tick, and a slot on each higher level covers a
+whole turn of the level below it. An entry goes in the lowest level whose
+span reaches its due time, and moves down ("cascades") a level at a time as
+the current tick catches up with it. Entries further ahead than the top
+level's span wait in the top level and are filed again each time it turns.
+
+Inserting and removing entries is constant time, and each entry cascades at
+most TIMING_WHEEL_LEVELS - 1 times before it's due. Due entries are
+returned in order of due time, and entries due at exactly the same time in
+the order they were inserted, so they come out in the same order as from a
+priority queue ordered by time with ties broken by insertion order.
+
+Entries are intrusive: each object that can be scheduled embeds an
+OOTimingWheelEntry, which can be in at most one wheel or list at a time.
+Lists are doubly linked and unordered, and are also used to hold due
+entries while they're processed. Neither wheels nor lists retain owners.
+
+This is *not* thread-safe.
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import <OoliteBase/OoliteBase.h>
+#import "OOTypes.h"
+
+
+#define TIMING_WHEEL_TICKS_PER_SECOND	64		// Must be a power of two, so times scale exactly.
+#define TIMING_WHEEL_LEVEL_BITS			6
+#define TIMING_WHEEL_SLOTS				(1 << TIMING_WHEEL_LEVEL_BITS)
+#define TIMING_WHEEL_LEVELS				4		// 64 ticks per second, 64 slots: 1 s, 64 s, 68 min, 72 h.
+
+
+typedef struct OOTimingWheel OOTimingWheel;
+typedef struct OOTimingWheelList OOTimingWheelList;
+typedef struct OOTimingWheelEntry OOTimingWheelEntry;
+
+
+struct OOTimingWheelEntry
+{
+	OOTimingWheelEntry		*next;
+	OOTimingWheelEntry		*prev;
+	OOTimingWheelList		*list;			// The wheel slot or list the entry is in, or NULL.
+	
+	id						owner;			// Not retained.
+	OOTimeAbsolute			time;
+	int64_t					tick;
+	uint64_t				sequence;
+};
+
+
+struct OOTimingWheelList
+{
+	OOTimingWheelEntry		*head;
+	OOTimingWheelEntry		*tail;
+	NSUInteger				*levelCount;	// Used by wheel slots; NULL for free-standing lists.
+};
+
+
+#define kOOTimingWheelEmptyList		((OOTimingWheelList){ NULL, NULL, NULL })
+
+
+/*	Create a wheel whose current time is now. Returns NULL if memory can't be
+	allocated. Freeing a wheel unlinks any entries still in it.
+*/
+OOTimingWheel *OOTimingWheelCreate(OOTimeAbsolute now);
+void OOTimingWheelFree(OOTimingWheel *wheel);
+
+NSUInteger OOTimingWheelCount(OOTimingWheel *wheel);
+
+/*	Insert an entry due at time. The entry must not be in a wheel or list.
+	Times before the wheel's current time are due at the next collection.
+*/
+void OOTimingWheelInsert(OOTimingWheel *wheel, OOTimingWheelEntry *entry, OOTimeAbsolute time);
+
+/*	Move the entries due at or before now to the end of outDue, which must be
+	empty, in order of due time and then insertion. If now is earlier than
+	the last time collected, the wheel is rebuilt around it.
+*/
+void OOTimingWheelCollectDue(OOTimingWheel *wheel, OOTimeAbsolute now, OOTimingWheelList *outDue);
+
+//	Move every entry to the end of outRemoved, in no particular order.
+void OOTimingWheelRemoveAll(OOTimingWheel *wheel, OOTimingWheelList *outRemoved);
+
+
+void OOTimingWheelListAppend(OOTimingWheelList *list, OOTimingWheelEntry *entry);
+
+//	Remove an entry from whichever wheel or list it's in. Does nothing if it isn't in one.
+void OOTimingWheelEntryUnlink(OOTimingWheelEntry *entry);
+
+
+OOINLINE OOTimingWheelEntry *OOTimingWheelListFirst(const OOTimingWheelList *list)
+{
+	return list->head;
+}
+
+
+OOINLINE BOOL OOTimingWheelEntryIsLinked(const OOTimingWheelEntry *entry)
+{
+	return entry->list != NULL;
+}
+
+
+/*	The update loop of +[OOScriptTimer updateTimers], shared with
+	OOScriptTimerBenchmark so that the benchmark times the real thing.
+	
+	A scheduler is a wheel plus the lists used while firing due entries. An
+	all-zero scheduler is valid and has no wheel; set wheel before
+	scheduling. Entries scheduled while firing are deferred until every due
+	entry has fired, so a timer that reschedules itself for now can't loop
+	forever.
+*/
+typedef struct OOTimingWheelScheduler
+{
+	OOTimingWheel			*wheel;
+	OOTimingWheelList		due;			// Entries due in the current update, in firing order.
+	OOTimingWheelList		deferred;		// Entries scheduled during the current update.
+	BOOL					updating;
+} OOTimingWheelScheduler;
+
+
+/*	Called with each due entry, already unlinked. Firing may schedule or
+	unlink any entry, including ones due later in the same update.
+*/
+typedef void (*OOTimingWheelFireFunction)(OOTimingWheelEntry *entry, void *context);
+
+
+//	Insert into the wheel, or into the deferred list during an update.
+void OOTimingWheelSchedule(OOTimingWheelScheduler *scheduler, OOTimingWheelEntry *entry, OOTimeAbsolute time);
+
+//	Fire every entry due at or before now in order, then insert deferred entries.
+void OOTimingWheelRunDue(OOTimingWheelScheduler *scheduler, OOTimeAbsolute now, OOTimingWheelFireFunction fire, void *context);
+
+//	Move every entry in the wheel, due list and deferred list to the end of outRemoved.
+void OOTimingWheelSchedulerRemoveAll(OOTimingWheelScheduler *scheduler, OOTimingWheelList *outRemoved);
@@ -0,0 +1,427 @@
+/*
+
+OOTimingWheel.m
+
+
+Oolite
+Copyright (C) 2004-2011 Giles C Williams and contributors
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+MA 02110-1301, USA.
+
+*/
+
+#import "OOTimingWheel.h"
+
+
+#define SLOT_MASK			(TIMING_WHEEL_SLOTS - 1)
+#define LEVEL_SPAN(level)	((int64_t)1 << (TIMING_WHEEL_LEVEL_BITS * ((level) + 1)))
+#define WHEEL_SPAN			LEVEL_SPAN(TIMING_WHEEL_LEVELS - 1)
+
+// Ticks are kept well inside the range where doubles hold integers exactly.
+#define MAX_TICK			((int64_t)1 << 52)
+
+
+struct OOTimingWheel
+{
+	int64_t					currentTick;
+	uint64_t				nextSequence;
+	
+	NSUInteger				levelCounts[TIMING_WHEEL_LEVELS];
+	OOTimingWheelList		slots[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+	
+	// Scratch space for sorting due entries.
+	OOTimingWheelEntry		**sortBuffer;
+	NSUInteger				sortCapacity;
+};
+
+
+static int64_t TickForTime(OOTimeAbsolute time);
+static void LinkEntry(OOTimingWheel *wheel, OOTimingWheelEntry *entry);
+static void Cascade(OOTimingWheel *wheel);
+static void Rebase(OOTimingWheel *wheel, int64_t tick);
+static BOOL MoveDue(OOTimingWheelList *slot, OOTimeAbsolute now, BOOL all, OOTimingWheelList *outDue, BOOL sorted);
+static void SortList(OOTimingWheel *wheel, OOTimingWheelList *list);
+static int CompareEntries(const void *a, const void *b);
+
+
+OOTimingWheel *OOTimingWheelCreate(OOTimeAbsolute now)
+{
+	OOTimingWheel *wheel = calloc(1, sizeof *wheel);
+	if (wheel == NULL)  return NULL;
+	
+	unsigned level, slot;
+	for (level = 0; level < TIMING_WHEEL_LEVELS; level++)
+	{
+		for (slot = 0; slot < TIMING_WHEEL_SLOTS; slot++)
+		{
+			wheel->slots[level][slot].levelCount = &wheel->levelCounts[level];
+		}
+	}
+	
+	wheel->currentTick = TickForTime(now);
+	return wheel;
+}
+
+
+void OOTimingWheelFree(OOTimingWheel *wheel)
+{
+	if (wheel == NULL)  return;
+	
+	OOTimingWheelList removed = kOOTimingWheelEmptyList;
+	OOTimingWheelRemoveAll(wheel, &removed);
+	while (removed.head != NULL)  OOTimingWheelEntryUnlink(removed.head);
+	
+	free(wheel->sortBuffer);
+	free(wheel);
+}
+
+
+NSUInteger OOTimingWheelCount(OOTimingWheel *wheel)
+{
+	NSUInteger count = 0;
+	unsigned level;
+	for (level = 0; level < TIMING_WHEEL_LEVELS; level++)
+	{
+		count += wheel->levelCounts[level];
+	}
+	
+	return count;
+}
+
+
+void OOTimingWheelInsert(OOTimingWheel *wheel, OOTimingWheelEntry *entry, OOTimeAbsolute time)
+{
+	NSCParameterAssert(wheel != NULL && entry != NULL && entry->list == NULL);
+	
+	entry->time = time;
+	entry->tick = TickForTime(time);
+	entry->sequence = wheel->nextSequence++;
+	LinkEntry(wheel, entry);
+}
+
+
+void OOTimingWheelCollectDue(OOTimingWheel *wheel, OOTimeAbsolute now, OOTimingWheelList *outDue)
+{
+	NSCParameterAssert(wheel != NULL && outDue != NULL && outDue->head == NULL);
+	
+	int64_t target = TickForTime(now);
+	if (OOTimingWheelCount(wheel) == 0)
+	{
+		wheel->currentTick = target;
+		return;
+	}
+	if (EXPECT_NOT(target < wheel->currentTick))  Rebase(wheel, target);
+	
+	/*	Every entry in a level 0 slot for a tick before target is due, since
+		times are scaled exactly. When level 0 is empty, skip ahead to the
+		next tick at which something cascades down into it.
+	*/
+	BOOL sorted = YES;
+	while (wheel->currentTick < target)
+	{
+		if (wheel->levelCounts[0] == 0)
+		{
+			unsigned level = 1;
+			while (wheel->levelCounts[level] == 0)  level++;	// Something is in the wheel, so this stops.
+			
+			int64_t span = LEVEL_SPAN(level - 1);
+			int64_t next = (wheel->currentTick & ~(span - 1)) + span;
+			if (next > target)
+			{
+				wheel->currentTick = target;
+				break;
+			}
+			wheel->currentTick = next;
+			Cascade(wheel);
+			continue;
+		}
+		
+		sorted = MoveDue(&wheel->slots[0][wheel->currentTick & SLOT_MASK], now, YES, outDue, sorted);
+		wheel->currentTick++;
+		if ((wheel->currentTick & SLOT_MASK) == 0)  Cascade(wheel);
+	}
+	
+	// Entries in the current tick's slot may not be due yet.
+	sorted = MoveDue(&wheel->slots[0][wheel->currentTick & SLOT_MASK], now, NO, outDue, sorted);
+	
+	if (!sorted)  SortList(wheel, outDue);
+}
+
+
+void OOTimingWheelRemoveAll(OOTimingWheel *wheel, OOTimingWheelList *outRemoved)
+{
+	NSCParameterAssert(wheel != NULL && outRemoved != NULL);
+	
+	unsigned level, slot;
+	for (level = 0; level < TIMING_WHEEL_LEVELS; level++)
+	{
+		if (wheel->levelCounts[level] == 0)  continue;
+		
+		for (slot = 0; slot < TIMING_WHEEL_SLOTS; slot++)
+		{
+			OOTimingWheelEntry *entry = NULL;
+			while ((entry = wheel->slots[level][slot].head) != NULL)
+			{
+				OOTimingWheelEntryUnlink(entry);
+				OOTimingWheelListAppend(outRemoved, entry);
+			}
+		}
+	}
+}
+
+
+void OOTimingWheelListAppend(OOTimingWheelList *list, OOTimingWheelEntry *entry)
+{
+	NSCParameterAssert(list != NULL && entry != NULL && entry->list == NULL);
+	
+	entry->list = list;
+	entry->next = NULL;
+	entry->prev = list->tail;
+	if (list->tail != NULL)  list->tail->next = entry;
+	else  list->head = entry;
+	list->tail = entry;
+	
+	if (list->levelCount != NULL)  (*list->levelCount)++;
+}
+
+
+void OOTimingWheelEntryUnlink(OOTimingWheelEntry *entry)
+{
+	OOTimingWheelList *list = entry->list;
+	if (list == NULL)  return;
+	
+	if (entry->prev != NULL)  entry->prev->next = entry->next;
+	else  list->head = entry->next;
+	if (entry->next != NULL)  entry->next->prev = entry->prev;
+	else  list->tail = entry->prev;
+	
+	entry->next = entry->prev = NULL;
+	entry->list = NULL;
+	
+	if (list->levelCount != NULL)  (*list->levelCount)--;
+}
+
+
+void OOTimingWheelSchedule(OOTimingWheelScheduler *scheduler, OOTimingWheelEntry *entry, OOTimeAbsolute time)
+{
+	NSCParameterAssert(scheduler != NULL && scheduler->wheel != NULL);
+	
+	if (EXPECT(!scheduler->updating))
+	{
+		OOTimingWheelInsert(scheduler->wheel, entry, time);
+	}
+	else
+	{
+		entry->time = time;
+		OOTimingWheelListAppend(&scheduler->deferred, entry);
+	}
+}
+
+
+void OOTimingWheelRunDue(OOTimingWheelScheduler *scheduler, OOTimeAbsolute now, OOTimingWheelFireFunction fire, void *context)
+{
+	NSCParameterAssert(scheduler != NULL && scheduler->wheel != NULL && fire != NULL);
+	
+	OOTimingWheelEntry *entry = NULL;
+	
+	scheduler->updating = YES;
+	
+	/*	Firing an entry can unlink ones that are due later in this update,
+		which removes them from the due list, so always take the first.
+	*/
+	OOTimingWheelCollectDue(scheduler->wheel, now, &scheduler->due);
+	while ((entry = OOTimingWheelListFirst(&scheduler->due)) != NULL)
+	{
+		OOTimingWheelEntryUnlink(entry);
+		fire(entry, context);
+	}
+	
+	while ((entry = OOTimingWheelListFirst(&scheduler->deferred)) != NULL)
+	{
+		OOTimingWheelEntryUnlink(entry);
+		OOTimingWheelInsert(scheduler->wheel, entry, entry->time);
+	}
+	
+	scheduler->updating = NO;
+}
+
+
+void OOTimingWheelSchedulerRemoveAll(OOTimingWheelScheduler *scheduler, OOTimingWheelList *outRemoved)
+{
+	NSCParameterAssert(scheduler != NULL && outRemoved != NULL);
+	
+	OOTimingWheelList *lists[] = { &scheduler->deferred, &scheduler->due };
+	OOTimingWheelEntry *entry = NULL;
+	unsigned i;
+	
+	if (scheduler->wheel != NULL)  OOTimingWheelRemoveAll(scheduler->wheel, outRemoved);
+	for (i = 0; i < sizeof lists / sizeof *lists; i++)
+	{
+		while ((entry = OOTimingWheelListFirst(lists[i])) != NULL)
+		{
+			OOTimingWheelEntryUnlink(entry);
+			OOTimingWheelListAppend(outRemoved, entry);
+		}
+	}
+}
+
+
+static int64_t TickForTime(OOTimeAbsolute time)
+{
+	double scaled = floor(time * TIMING_WHEEL_TICKS_PER_SECOND);
+	
+	// Negated comparison so that NaN ends up never due.
+	if (!(scaled < (double)MAX_TICK))  return MAX_TICK;
+	if (scaled < (double)-MAX_TICK)  return -MAX_TICK;
+	return (int64_t)scaled;
+}
+
+
+static void LinkEntry(OOTimingWheel *wheel, OOTimingWheelEntry *entry)
+{
+	int64_t					tick = entry->tick;
+	int64_t					delta = tick - wheel->currentTick;
+	unsigned				level;
+	
+	// Overdue entries go in the current tick's slot, which is always looked at.
+	if (delta < 0)
+	{
+		tick = wheel->currentTick;
+		delta = 0;
+	}
+	
+	for (level = 0; level < TIMING_WHEEL_LEVELS - 1; level++)
+	{
+		if (delta < LEVEL_SPAN(level))  break;
+	}
+	
+	// Too far ahead for the wheel: park in the slot that turns last, and refile then.
+	if (delta >= WHEEL_SPAN)  tick = wheel->currentTick + WHEEL_SPAN - 1;
+	
+	unsigned slot = ((uint64_t)tick >> (TIMING_WHEEL_LEVEL_BITS * level)) & SLOT_MASK;
+	OOTimingWheelListAppend(&wheel->slots[level][slot], entry);
+}
+
+
+/*	Called whenever the current tick reaches a multiple of TIMING_WHEEL_SLOTS.
+	Refile the entries in the slot of each level above 0 that has come
+	round, from the bottom up, stopping at the first level that hasn't
+	wrapped.
+*/
+static void Cascade(OOTimingWheel *wheel)
+{
+	unsigned level;
+	for (level = 1; level < TIMING_WHEEL_LEVELS; level++)
+	{
+		unsigned slot = ((uint64_t)wheel->currentTick >> (TIMING_WHEEL_LEVEL_BITS * level)) & SLOT_MASK;
+		OOTimingWheelList *list = &wheel->slots[level][slot];
+		
+		OOTimingWheelEntry *entry = NULL;
+		while ((entry = list->head) != NULL)
+		{
+			OOTimingWheelEntryUnlink(entry);
+			LinkEntry(wheel, entry);
+		}
+		
+		if (slot != 0)  break;
+	}
+}
+
+
+//	Time went backwards. Refile everything around the new current tick, keeping insertion order.
+static void Rebase(OOTimingWheel *wheel, int64_t tick)
+{
+	OOTimingWheelList all = kOOTimingWheelEmptyList;
+	OOTimingWheelRemoveAll(wheel, &all);
+	
+	wheel->currentTick = tick;
+	
+	OOTimingWheelEntry *entry = NULL;
+	while ((entry = all.head) != NULL)
+	{
+		OOTimingWheelEntryUnlink(entry);
+		LinkEntry(wheel, entry);
+	}
+}
+
+
+/*	Move the entries of a level 0 slot which are due (or all of them) to
+	outDue. Returns NO if outDue is now out of order, or sorted was already
+	NO.
+*/
+static BOOL MoveDue(OOTimingWheelList *slot, OOTimeAbsolute now, BOOL all, OOTimingWheelList *outDue, BOOL sorted)
+{
+	OOTimingWheelEntry *entry = slot->head, *next = NULL;
+	for (; entry != NULL; entry = next)
+	{
+		next = entry->next;
+		if (!all && now < entry->time)  continue;
+		
+		OOTimingWheelEntryUnlink(entry);
+		if (sorted && outDue->tail != NULL && CompareEntries(&outDue->tail, &entry) > 0)  sorted = NO;
+		OOTimingWheelListAppend(outDue, entry);
+	}
+	
+	return sorted;
+}
+
+
+static void SortList(OOTimingWheel *wheel, OOTimingWheelList *list)
+{
+	NSUInteger count = 0, i;
+	OOTimingWheelEntry *entry = NULL;
+	for (entry = list->head; entry != NULL; entry = entry->next)  count++;
+	
+	if (count > wheel->sortCapacity)
+	{
+		OOTimingWheelEntry **buffer = realloc(wheel->sortBuffer, count * sizeof *buffer);
+		if (EXPECT_NOT(buffer == NULL))
+		{
+			// Firing out of order is better than not firing at all.
+			OOLogERR(@"script.timer.wheel.sort.failed", @"Could not allocate sort buffer for %lu timers.", (unsigned long)count);
+			return;
+		}
+		wheel->sortBuffer = buffer;
+		wheel->sortCapacity = count;
+	}
+	
+	for (i = 0; (entry = list->head) != NULL; i++)
+	{
+		OOTimingWheelEntryUnlink(entry);
+		wheel->sortBuffer[i] = entry;
+	}
+	
+	// Sequence numbers are unique, so this is a total order and qsort's instability doesn't matter.
+	qsort(wheel->sortBuffer, count, sizeof *wheel->sortBuffer, CompareEntries);
+	
+	for (i = 0; i < count; i++)
+	{
+		OOTimingWheelListAppend(list, wheel->sortBuffer[i]);
+	}
+}
+
+
+static int CompareEntries(const void *a, const void *b)
+{
+	const OOTimingWheelEntry *entryA = *(OOTimingWheelEntry * const *)a;
+	const OOTimingWheelEntry *entryB = *(OOTimingWheelEntry * const *)b;
+	
+	if (entryA->time < entryB->time)  return -1;
+	if (entryA->time > entryB->time)  return 1;
+	if (entryA->sequence < entryB->sequence)  return -1;
+	if (entryA->sequence > entryB->sequence)  return 1;
+	return 0;
+}
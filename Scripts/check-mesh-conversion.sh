@@ -0,0 +1,103 @@
+#! /bin/sh
+
+# Converts meshes with two builds of oobasicconverter and checks that the
+# .oomesh files they write are byte for byte identical. Used to check that
+# changes to OoliteGraphics' mesh model don't change its output.
+#
+# Usage: check-mesh-conversion.sh [--binary] reference-converter converter [meshfile...]
+#
+# The reference converter is typically built from the commit before the
+# change. With --binary, .oobmesh output is also compared; both converters
+# must support --binary. If no mesh files are given, the built-in models are
+# used.
+
+
+FORMATS=oomesh
+
+if [ "$1" = "--binary" ]
+then
+	FORMATS="oomesh oobmesh"
+	shift
+fi
+
+REFERENCE=$1
+CONVERTER=$2
+
+if [ -z "$REFERENCE" -o -z "$CONVERTER" ]
+then
+	echo "Usage: $0 [--binary] reference-converter converter [meshfile...]"
+	exit 1
+fi
+
+shift 2
+
+if [ $# -eq 0 ]
+then
+	set -- `dirname "$0"`/../Oolite/Resources/Models/*.dat
+fi
+
+
+TEMPDIR=`mktemp -d "${TMPDIR:-/tmp}/check-mesh-conversion.XXXXXX"` || exit 1
+trap 'rm -rf "$TEMPDIR"' EXIT
+
+CHECKED=0
+FAILED=0
+SKIPPED=0
+
+
+# convert converter outdir meshfile [--binary]
+# Copies the mesh into outdir and converts it there, since oobasicconverter
+# writes its output next to its input.
+convert()
+{
+	cp "$3" "$2/" || return 1
+	"$1" $4 "$2/`basename "$3"`" > /dev/null
+}
+
+
+for MESH in "$@"
+do
+	NAME=`basename "$MESH"`
+	BASE=${NAME%.*}
+
+	for FORMAT in $FORMATS
+	do
+		if [ $FORMAT = oobmesh ]
+		then
+			OPTIONS=--binary
+		else
+			OPTIONS=
+		fi
+
+		rm -rf "$TEMPDIR/reference" "$TEMPDIR/test"
+		mkdir "$TEMPDIR/reference" "$TEMPDIR/test" || exit 1
+
+		if ! convert "$REFERENCE" "$TEMPDIR/reference" "$MESH" $OPTIONS ||
+		   [ ! -f "$TEMPDIR/reference/$BASE-dump.$FORMAT" ]
+		then
+			echo "warning: reference converter failed on $NAME, skipping."
+			SKIPPED=`expr $SKIPPED + 1`
+			continue
+		fi
+
+		CHECKED=`expr $CHECKED + 1`
+
+		if ! convert "$CONVERTER" "$TEMPDIR/test" "$MESH" $OPTIONS
+		then
+			echo "error: converter failed on $NAME."
+			FAILED=`expr $FAILED + 1`
+		elif ! cmp -s "$TEMPDIR/reference/$BASE-dump.$FORMAT" "$TEMPDIR/test/$BASE-dump.$FORMAT"
+		then
+			echo "error: $FORMAT output for $NAME differs from reference."
+			FAILED=`expr $FAILED + 1`
+		fi
+	done
+done
+
+
+echo "$CHECKED conversions checked, $FAILED failed, $SKIPPED skipped."
+
+if [ $FAILED -ne 0 -o $CHECKED -eq 0 ]
+then
+	exit 1
+fi
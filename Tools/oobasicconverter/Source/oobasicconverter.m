@@ -1,36 +1,109 @@
+/*
+	oobasicconverter
+
+	Usage: oobasicconverter [--binary] inputfile
+	       oobasicconverter --benchmark [--iterations=n] inputfile
+
+	Converts inputfile to <name>-dump.oomesh, or <name>-dump.oobmesh with
+	--binary.
+
+	--benchmark writes the mesh to temporary .oomesh, .oobmesh and .dat files
+	and times loading each of them as a render mesh, which is what the game
+	does.
+*/
+
 #import <OoliteGraphics/OoliteGraphics.h>
+#import <getopt.h>
 
 
 @interface OOSimpleProgressReporter: NSObject <OOProgressReporting>
 @end
 
 
+enum
+{
+	kBenchmarkDefaultIterations	= 10
+};
+
+
 static OOAbstractMesh *LoadMesh(NSString *path, id <OOProgressReporting> progressReporter, id <OOProblemReporting> issues);
+static void Benchmark(OOAbstractMesh *mesh, NSString *path, unsigned iterations);
+static NSTimeInterval BenchmarkFile(NSString *path, unsigned iterations);
 
 
-int main (int argc, const char * argv[])
+int main (int argc, char * argv[])
 {
     NSAutoreleasePool * pool = [[NSAutoreleasePool alloc] init];
-	if (argc < 2)
+	
+	const struct option		longOpts[] =
+							{
+								{ "binary",			no_argument,		NULL, 'b' },
+								{ "benchmark",		no_argument,		NULL, 'B' },
+								{ "iterations",		required_argument,	NULL, 'i' },
+								{ NULL,				0,					NULL, 0 }
+							};
+	
+	BOOL					binary = NO;
+	BOOL					benchmark = NO;
+	int						iterations = kBenchmarkDefaultIterations;
+	
+	for (;;)
+	{
+		int option = getopt_long(argc, argv, "bBi:", longOpts, NULL);
+		if (option == -1)  break;
+		
+		switch (option)
+		{
+			case 'b':
+				binary = YES;
+				break;
+			
+			case 'B':
+				benchmark = YES;
+				break;
+			
+			case 'i':
+				iterations = atoi(optarg);
+				if (iterations < 1)
+				{
+					fprintf(stderr, "Iteration count must be at least 1.\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			
+			default:
+				return EXIT_FAILURE;
+		}
+	}
+	
+	if (argc <= optind)
 	{
 		fprintf(stderr, "An input file name must be specified.\n");
 		return EXIT_FAILURE;
 	}
 	
-	NSString *path = [NSString stringWithUTF8String:argv[1]];
+	NSString *path = [NSString stringWithUTF8String:argv[optind]];
 	char buffer[PATH_MAX];
 	realpath([[path stringByExpandingTildeInPath] UTF8String], buffer);
 	path = [NSString stringWithUTF8String:buffer];
 	
-	id <OOProgressReporting> progressReporter = [[OOSimpleProgressReporter new] autorelease];
+	id <OOProgressReporting> progressReporter = benchmark ? nil : [[OOSimpleProgressReporter new] autorelease];
 	OOSimpleProblemReportManager *issues = [[[OOSimpleProblemReportManager alloc] initWithMeshFilePath:path forReading:YES] autorelease];
 	
 	OOAbstractMesh *mesh = LoadMesh(path, progressReporter, issues);
 	if (mesh == nil)  exit(EXIT_FAILURE);
 	
-	path = [[[path stringByDeletingPathExtension] stringByAppendingString:@"-dump"] stringByAppendingPathExtension:@"oomesh"];
-	issues = [[[OOSimpleProblemReportManager alloc] initWithMeshFilePath:path forReading:NO] autorelease];
-	OOWriteOOMesh(mesh, path, kOOMeshWriteWithAnnotations, issues);
+	if (benchmark)
+	{
+		Benchmark(mesh, path, iterations);
+	}
+	else
+	{
+		path = [[[path stringByDeletingPathExtension] stringByAppendingString:@"-dump"] stringByAppendingPathExtension:binary ? @"oobmesh" : @"oomesh"];
+		issues = [[[OOSimpleProblemReportManager alloc] initWithMeshFilePath:path forReading:NO] autorelease];
+		if (binary)  OOWriteBinaryMesh(mesh, path, nil, issues);
+		else  OOWriteOOMesh(mesh, path, kOOMeshWriteWithAnnotations, issues);
+	}
 	
     [pool drain];
     return 0;
@@ -41,14 +114,61 @@ static OOAbstractMesh *LoadMesh(NSString *path, id <OOProgressReporting> progres
 {
 	id <OOMeshReading> reader = OOReadMeshFromFile(path, progressReporter, issues);
 	
-#if 1
 	return [reader abstractMesh];
-#else
-	OORenderMesh *mesh = nil;
-	NSArray *materials = nil;
-	[reader getRenderMesh:&mesh andMaterialSpecs:&materials];
-	return nil;
-#endif
+}
+
+
+static void Benchmark(OOAbstractMesh *mesh, NSString *path, unsigned iterations)
+{
+	NSString *base = [NSTemporaryDirectory() stringByAppendingPathComponent:$sprintf(@"oobasicconverter-%i-%@", getpid(), [[path lastPathComponent] stringByDeletingPathExtension])];
+	NSString *oomeshPath = [base stringByAppendingPathExtension:@"oomesh"];
+	NSString *binaryPath = [base stringByAppendingPathExtension:@"oobmesh"];
+	NSString *datPath = [base stringByAppendingPathExtension:@"dat"];
+	OOSimpleProblemReportManager *issues = [[[OOSimpleProblemReportManager alloc] initWithMeshFilePath:base forReading:NO] autorelease];
+	
+	if (!OOWriteOOMesh(mesh, oomeshPath, 0, issues) ||
+		!OOWriteBinaryMesh(mesh, binaryPath, nil, issues) ||
+		!OOWriteDAT(mesh, datPath, issues))
+	{
+		exit(EXIT_FAILURE);
+	}
+	
+	NSArray *paths = [NSArray arrayWithObjects:oomeshPath, binaryPath, datPath, nil];
+	NSString *file = nil;
+	
+	printf("%-12s %14s %14s\n", "format", "size (KiB)", "load (ms)");
+	foreach (file, paths)
+	{
+		unsigned long long size = [[[NSFileManager defaultManager] attributesOfItemAtPath:file error:NULL] fileSize];
+		NSTimeInterval time = BenchmarkFile(file, iterations);
+		
+		printf("%-12s %14.1f %14.3f\n", [[file pathExtension] UTF8String], size / 1024.0, time * 1000.0 / iterations);
+		[[NSFileManager defaultManager] removeItemAtPath:file error:NULL];
+	}
+}
+
+
+static NSTimeInterval BenchmarkFile(NSString *path, unsigned iterations)
+{
+	NSTimeInterval		start, total = 0;
+	unsigned			i;
+	
+	for (i = 0; i < iterations; i++)
+	{
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		OOSimpleProblemReportManager *issues = [[[OOSimpleProblemReportManager alloc] initWithMeshFilePath:path forReading:YES] autorelease];
+		OORenderMesh *renderMesh = nil;
+		
+		start = [NSDate timeIntervalSinceReferenceDate];
+		id <OOMeshReading> reader = OOReadMeshFromFile(path, nil, issues);
+		[reader getRenderMesh:&renderMesh andMaterialSpecs:NULL];
+		total += [NSDate timeIntervalSinceReferenceDate] - start;
+		
+		if (renderMesh == nil)  exit(EXIT_FAILURE);
+		[pool release];
+	}
+	
+	return total;
 }
 
 
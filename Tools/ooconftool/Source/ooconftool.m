@@ -8,12 +8,23 @@
 	(officially) support nulls, and OOConf/JSON doesn’t support dates or
 	binary data. Unsupported plist types will cause an error, and unsupported
 	JSON types will be encoded as nulls.
+	
+	With --benchmark, it instead times parsing of one or more OOConf or
+	.oomesh files, by reading each file into memory and parsing the buffer
+	(--benchmark=read), by lexing directly over a memory mapping
+	(--benchmark=mapped, which is what the OOConf loading functions do), or
+	both. The peak resident size reported is for the whole process, so to
+	compare the two input modes, run each in a separate invocation.
 */
 
 #import <OoliteBase/OoliteBase.h>
 #import <getopt.h>
 #import "OldSchoolPropertyListWriting.h"
 
+#if !OOLITE_WINDOWS
+#import <sys/resource.h>
+#endif
+
 
 typedef enum OutFormat
 {
@@ -27,6 +38,21 @@ typedef enum OutFormat
 } Format;
 
 
+typedef enum BenchmarkMode
+{
+	kBenchmarkNone,
+	kBenchmarkBoth,
+	kBenchmarkRead,
+	kBenchmarkMapped
+} BenchmarkMode;
+
+
+enum
+{
+	kBenchmarkDefaultIterations	= 10
+};
+
+
 static void PrintUsageAndExit(const char *inCall) __attribute__((noreturn));
 static Format FormatForName(NSString *fileName);
 static NSString *FormatName(Format format);
@@ -36,6 +62,10 @@ static void Convert(NSString *inFile, Format inFormat, NSString *outFile, Format
 static id Load(NSString *inFile, Format inFormat);
 static void Write(NSString *inFile, Format inFormat, id plistValue, BOOL compact) __attribute__((noreturn));
 
+static void Benchmark(NSArray *files, BenchmarkMode mode, unsigned iterations) __attribute__((noreturn));
+static NSTimeInterval BenchmarkFile(NSString *file, BenchmarkMode mode, unsigned iterations);
+static long PeakResidentKiB(void);
+
 
 /*	Convert number literal strings to number objects.
 	
@@ -70,19 +100,24 @@ int main (int argc, char *argv[])
 								{ "json",			no_argument,	NULL, 'J' },
 								{ "compact",		no_argument,	NULL, 'c' },
 								{ "null-to-string",	no_argument,	NULL, 'n' },
-								{ "help",			no_argument,	NULL, '?' }
+								{ "benchmark",		optional_argument, NULL, 'b' },
+								{ "iterations",		required_argument, NULL, 'i' },
+								{ "help",			no_argument,	NULL, '?' },
+								{ NULL,				0,				NULL, 0 }
 							};
 	
 	BOOL					help = NO;
 	BOOL					compact = NO;
 	BOOL					nullToString = NO;
 	Format					outFormat = kFormatAuto;
+	BenchmarkMode			benchmark = kBenchmarkNone;
+	int						iterations = kBenchmarkDefaultIterations;
 	
 	if (argc < 2)  PrintUsageAndExit(argv[0]);
 	
 	for (;;)
 	{
-		int option = getopt_long(argc, argv, "PTXBOJcn?", longOpts, NULL);
+		int option = getopt_long(argc, argv, "PTXBOJcnb::i:?", longOpts, NULL);
 		if (option == -1)  break;
 		
 		switch (option)
@@ -119,12 +154,39 @@ int main (int argc, char *argv[])
 				nullToString = YES;
 				break;
 				
+			case 'b':
+				if (optarg == NULL)  benchmark = kBenchmarkBoth;
+				else if (strcmp(optarg, "read") == 0)  benchmark = kBenchmarkRead;
+				else if (strcmp(optarg, "mapped") == 0)  benchmark = kBenchmarkMapped;
+				else  Fail(@"Unknown benchmark mode \"%s\"; expected \"read\" or \"mapped\".", optarg);
+				break;
+				
+			case 'i':
+				iterations = atoi(optarg);
+				if (iterations < 1)  Fail(@"Iteration count must be at least 1.");
+				break;
+				
 			case '?':
 				help = YES;
 				break;
 		}
 	}
 	
+	if (benchmark != kBenchmarkNone)
+	{
+		if (argc <= optind)  PrintUsageAndExit(argv[0]);
+		
+		NSMutableArray *files = [NSMutableArray arrayWithCapacity:argc - optind];
+		int i;
+		for (i = optind; i < argc; i++)
+		{
+			NSString *file = [NSString stringWithUTF8String:argv[i]];
+			[files addObject:[[[file stringByStandardizingPath] stringByExpandingTildeInPath] stringByResolvingSymlinksInPath]];
+		}
+		
+		Benchmark(files, benchmark, iterations);
+	}
+	
 	if (argc != optind + 2)  PrintUsageAndExit(argv[0]);
 	
 	NSString *inFile = [NSString stringWithUTF8String:argv[optind]];
@@ -392,6 +454,100 @@ static void Write(NSString *inFile, Format inFormat, id plistValue, BOOL compact
 }
 
 
+static void Benchmark(NSArray *files, BenchmarkMode mode, unsigned iterations)
+{
+	NSString			*file = nil;
+	NSTimeInterval		readTotal = 0, mappedTotal = 0;
+	BOOL				mappedFirst = NO;
+	
+	Print(@"%-40s %14s %14s\n", "file", "read (ms)", "mapped (ms)");
+	
+	foreach (file, files)
+	{
+		NSTimeInterval readTime = 0, mappedTime = 0;
+		
+		/*	When running both, alternate which goes first, so that neither
+			consistently benefits from the other warming the file cache.
+		*/
+		if (mappedFirst && mode != kBenchmarkRead)  mappedTime = BenchmarkFile(file, kBenchmarkMapped, iterations);
+		if (mode != kBenchmarkMapped)  readTime = BenchmarkFile(file, kBenchmarkRead, iterations);
+		if (!mappedFirst && mode != kBenchmarkRead)  mappedTime = BenchmarkFile(file, kBenchmarkMapped, iterations);
+		mappedFirst = !mappedFirst;
+		
+		readTotal += readTime;
+		mappedTotal += mappedTime;
+		
+		Print(@"%-40s %14s %14s\n", [[file lastPathComponent] UTF8String],
+			  (mode != kBenchmarkMapped) ? [$sprintf(@"%.3f", readTime * 1000.0 / iterations) UTF8String] : "-",
+			  (mode != kBenchmarkRead) ? [$sprintf(@"%.3f", mappedTime * 1000.0 / iterations) UTF8String] : "-");
+	}
+	
+	Print(@"%-40s %14s %14s\n", "total",
+		  (mode != kBenchmarkMapped) ? [$sprintf(@"%.3f", readTotal * 1000.0 / iterations) UTF8String] : "-",
+		  (mode != kBenchmarkRead) ? [$sprintf(@"%.3f", mappedTotal * 1000.0 / iterations) UTF8String] : "-");
+	
+	long peak = PeakResidentKiB();
+	if (peak >= 0)  Print(@"Peak resident size: %li KiB\n", peak);
+	
+	exit(EXIT_SUCCESS);
+}
+
+
+/*	Returns total wall-clock time for all iterations. Each iteration's result
+	is released before the next one starts, so the peak resident size reflects
+	one file's input plus its parsed form.
+*/
+static NSTimeInterval BenchmarkFile(NSString *file, BenchmarkMode mode, unsigned iterations)
+{
+	NSURL				*url = [NSURL fileURLWithPath:file];
+	NSTimeInterval		start, total = 0;
+	unsigned			i;
+	
+	for (i = 0; i < iterations; i++)
+	{
+		NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+		OOSimpleProblemReportManager *issues = [[[OOSimpleProblemReportManager alloc] initWithContextString:$sprintf(@"Loading %@:", file) messageClassPrefix:@""] autorelease];
+		id result = nil;
+		
+		start = [NSDate timeIntervalSinceReferenceDate];
+		if (mode == kBenchmarkRead)
+		{
+			NSError *error = nil;
+			NSData *data = [NSData oo_dataWithContentsOfFile:file options:0 error:&error];
+			if (data == nil)  Fail(@"Could not read input file. %@", error);
+			result = [NSObject objectFromOOConfData:data problemReporter:issues];
+		}
+		else
+		{
+			result = [NSObject objectWithContentsOfOOConfURL:url problemReporter:issues];
+		}
+		total += [NSDate timeIntervalSinceReferenceDate] - start;
+		
+		if (result == nil)  exit(EXIT_FAILURE);
+		[pool release];
+	}
+	
+	return total;
+}
+
+
+static long PeakResidentKiB(void)
+{
+#if !OOLITE_WINDOWS
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+#if OOLITE_MAC_OS_X
+		return usage.ru_maxrss / 1024;	// Bytes on Mac OS X, KiB elsewhere.
+#else
+		return usage.ru_maxrss;
+#endif
+	}
+#endif
+	return -1;
+}
+
+
 static id StringsToNumbers(id object)
 {
 	if ([object isKindOfClass:[NSDictionary class]])
@@ -470,7 +626,8 @@ static id NullsToStrings(id object)
 static void PrintUsageAndExit(const char *inCall)
 {
 	Print(@"Usage: %s [--plist|--bplist|--ooconf|--json] inputfile outputfile\n"
-		  "%s --help\n", inCall, inCall);
+		  "%s --benchmark[=read|mapped] [--iterations=n] inputfile...\n"
+		  "%s --help\n", inCall, inCall, inCall);
 	
 	exit(EXIT_SUCCESS);
 }
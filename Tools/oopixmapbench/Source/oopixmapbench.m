@@ -0,0 +1,238 @@
+/*
+	oopixmapbench
+
+	Usage: oopixmapbench [--size=n] [--iterations=n]
+
+	Checks and times the pixmap scaling kernels (see OOPixMapScaling.h). For
+	each kernel set available on this machine, mip-map generation, vertical
+	stretching and vertical squeezing are run on the same pseudo-random
+	grayscale, grayscale-alpha and RGBA pixmaps, compared byte for byte with
+	the output of the scalar code, and timed. The exit status is failure if
+	any kernel set's output differs.
+
+	The pixmaps are size x size pixels (default 1024), where size is a power
+	of two. Stretching scales them to 3/2 of their height and squeezing to 2/3;
+	horizontal scaling is always scalar, so it isn't tested.
+*/
+
+#import <OoliteGraphics/OoliteGraphics.h>
+#import <OoliteGraphics/OOPixMapScaling.h>
+#import <getopt.h>
+
+
+typedef enum
+{
+	kOpMipMaps,
+	kOpStretch,
+	kOpSqueeze,
+	
+	kOpCount
+} BenchmarkOp;
+
+
+static const char * const kOpNames[kOpCount] =
+{
+	"mipmaps",
+	"stretch",
+	"squeeze"
+};
+
+
+enum
+{
+	kBenchmarkDefaultSize		= 1024,
+	kBenchmarkDefaultIterations	= 10
+};
+
+
+static OOPixMap MakeRandomPixMap(OOPixMapDimension size, OOPixMapFormat format, RANROTSeed *seed);
+static OOPixMap RunOp(BenchmarkOp op, OOPixMap source, size_t *outSize, NSTimeInterval *ioTime);
+static size_t CountMismatches(OOPixMap result, OOPixMap expected, size_t size);
+
+
+int main (int argc, char * argv[])
+{
+	NSAutoreleasePool * pool = [[NSAutoreleasePool alloc] init];
+	
+	const struct option		longOpts[] =
+							{
+								{ "size",			required_argument,	NULL, 's' },
+								{ "iterations",		required_argument,	NULL, 'i' },
+								{ NULL,				0,					NULL, 0 }
+							};
+	
+	const OOPixMapFormat	formats[] = { kOOPixMapGrayscale, kOOPixMapGrayscaleAlpha, kOOPixMapRGBA };
+	int						size = kBenchmarkDefaultSize;
+	int						iterations = kBenchmarkDefaultIterations;
+	unsigned				formatIdx, op, iteration;
+	OOPixMapScalingImplementation implementation;
+	RANROTSeed				seed = MakeRanrotSeed(12345);
+	BOOL					failed = NO;
+	
+	for (;;)
+	{
+		int option = getopt_long(argc, argv, "s:i:", longOpts, NULL);
+		if (option == -1)  break;
+		
+		switch (option)
+		{
+			case 's':
+				size = atoi(optarg);
+				if (size < 2 || (size & (size - 1)) != 0)
+				{
+					fprintf(stderr, "Size must be a power of two, at least 2.\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			
+			case 'i':
+				iterations = atoi(optarg);
+				if (iterations < 1)
+				{
+					fprintf(stderr, "Iteration count must be at least 1.\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			
+			default:
+				return EXIT_FAILURE;
+		}
+	}
+	
+	printf("%dx%d pixels, %d iterations, using %s kernels by default.\n\n", size, size, iterations, OOPixMapScalingImplementationName(OOPixMapScalingGetImplementation()));
+	printf("%-10s %-16s %-8s %12s %10s %12s\n", "operation", "format", "kernels", "time (ms)", "speedup", "mismatches");
+	
+	for (formatIdx = 0; formatIdx < sizeof formats / sizeof *formats; formatIdx++)
+	{
+		OOPixMap source = MakeRandomPixMap(size, formats[formatIdx], &seed);
+		if (OOIsNullPixMap(source))  return EXIT_FAILURE;
+		
+		for (op = 0; op < kOpCount; op++)
+		{
+			NSAutoreleasePool *opPool = [[NSAutoreleasePool alloc] init];
+			NSTimeInterval scalarTime = 0, ignored = 0;
+			size_t expectedSize;
+			
+			OOPixMapScalingSetImplementation(kOOPixMapScalingScalar);
+			OOPixMap expected = RunOp(op, source, &expectedSize, &ignored);
+			if (OOIsNullPixMap(expected))  return EXIT_FAILURE;
+			
+			for (implementation = 0; implementation < kOOPixMapScalingImplementationCount; implementation++)
+			{
+				if (!OOPixMapScalingSetImplementation(implementation))  continue;
+				
+				NSTimeInterval time = 0;
+				size_t resultSize;
+				OOPixMap result = RunOp(op, source, &resultSize, &time);
+				if (OOIsNullPixMap(result))  return EXIT_FAILURE;
+				
+				size_t mismatches = (resultSize == expectedSize) ? CountMismatches(result, expected, expectedSize) : expectedSize;
+				if (mismatches != 0)  failed = YES;
+				OOFreePixMap(&result);
+				
+				time = 0;
+				for (iteration = 0; iteration < (unsigned)iterations; iteration++)
+				{
+					result = RunOp(op, source, &resultSize, &time);
+					OOFreePixMap(&result);
+				}
+				if (implementation == kOOPixMapScalingScalar)  scalarTime = time;
+				
+				printf("%-10s %-16s %-8s %12.3f %9.2fx %12lu\n", kOpNames[op], [OOPixMapFormatName(formats[formatIdx]) UTF8String], OOPixMapScalingImplementationName(implementation), time * 1000.0 / iterations, scalarTime / time, (unsigned long)mismatches);
+			}
+			
+			OOFreePixMap(&expected);
+			[opPool release];
+		}
+		
+		OOFreePixMap(&source);
+	}
+	
+	if (failed)  fprintf(stderr, "\n***** Some kernels do not match the scalar code.\n");
+	
+	[pool drain];
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+static OOPixMap MakeRandomPixMap(OOPixMapDimension size, OOPixMapFormat format, RANROTSeed *seed)
+{
+	OOPixMap pixMap = OOAllocatePixMap(size, size, format, 0, 0);
+	if (OOIsNullPixMap(pixMap))  return kOONullPixMap;
+	
+	uint8_t *bytes = pixMap.pixels;
+	size_t i, count = OOMinimumPixMapBufferSize(pixMap);
+	for (i = 0; i < count; i++)  bytes[i] = RanrotWithSeed(seed) & 0xFF;
+	
+	return pixMap;
+}
+
+
+/*	Apply op to a copy of source, adding the time taken (excluding the copy)
+	to *ioTime. *outSize is the number of bytes of output, which for mip-maps
+	is the whole chain.
+*/
+static OOPixMap RunOp(BenchmarkOp op, OOPixMap source, size_t *outSize, NSTimeInterval *ioTime)
+{
+	OOPixMap			result = kOONullPixMap;
+	NSTimeInterval		start;
+	
+	switch (op)
+	{
+		case kOpMipMaps:
+		{
+			size_t bytesPerPixel = OOPixMapBytesPerPixel(source);
+			OOPixMapDimension w = source.width, h = source.height;
+			size_t chainSize = 0;
+			while (1 < w && 1 < h)
+			{
+				chainSize += w * h * bytesPerPixel;
+				w >>= 1;
+				h >>= 1;
+			}
+			chainSize += w * h * bytesPerPixel;
+			
+			result = OODuplicatePixMap(source, OOMinimumPixMapBufferSize(source) * 4 / 3);
+			if (OOIsNullPixMap(result))  return kOONullPixMap;
+			
+			start = [NSDate timeIntervalSinceReferenceDate];
+			OOGenerateMipMaps(result.pixels, result.width, result.height, result.format);
+			*ioTime += [NSDate timeIntervalSinceReferenceDate] - start;
+			*outSize = chainSize;
+			break;
+		}
+		
+		case kOpStretch:
+		case kOpSqueeze:
+		{
+			OOPixMap copy = OODuplicatePixMap(source, 0);
+			if (OOIsNullPixMap(copy))  return kOONullPixMap;
+			OOPixMapDimension height = (op == kOpStretch) ? source.height * 3 / 2 : source.height * 2 / 3;
+			
+			start = [NSDate timeIntervalSinceReferenceDate];
+			result = OOScalePixMap(copy, source.width, height, NO);	// Frees copy.
+			*ioTime += [NSDate timeIntervalSinceReferenceDate] - start;
+			*outSize = OOMinimumPixMapBufferSize(result);
+			break;
+		}
+		
+		case kOpCount:
+			break;
+	}
+	
+	return result;
+}
+
+
+static size_t CountMismatches(OOPixMap result, OOPixMap expected, size_t size)
+{
+	const uint8_t		*a = result.pixels, *b = expected.pixels;
+	size_t				i, count = 0;
+	
+	for (i = 0; i < size; i++)
+	{
+		if (a[i] != b[i])  count++;
+	}
+	
+	return count;
+}